@@ -0,0 +1,268 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "buildcfg.h"
+#include "config.h"
+#include "loader.h"
+#include "thumbnail.h"
+}
+
+#include <benchmark/benchmark.h>
+
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+#include <vector>
+
+// Size of generated images
+#define IMG_WIDTH  1920
+#define IMG_HEIGHT 1080
+
+typedef std::vector<uint8_t> buffer;
+
+/**
+ * Get pixel of the generated image: gradient with noise.
+ * @param x,y pixel coordinates
+ * @return pixel color
+ */
+static argb_t pixel(size_t x, size_t y)
+{
+    const size_t noise = (x * 7919 + y * 104729) & 0x1f;
+    return ARGB(0xff, x * 255 / IMG_WIDTH + noise, y * 255 / IMG_HEIGHT,
+                (x + y) & 0xff);
+}
+
+static void put_le(buffer& out, uint32_t val, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; ++i) {
+        out.push_back((val >> (i * 8)) & 0xff);
+    }
+}
+
+static void put_be(buffer& out, uint32_t val, size_t bytes)
+{
+    for (size_t i = bytes; i > 0; --i) {
+        out.push_back((val >> ((i - 1) * 8)) & 0xff);
+    }
+}
+
+static buffer encode_bmp()
+{
+    const size_t stride = (IMG_WIDTH * 3 + 3) & ~3;
+    const size_t size = 54 + stride * IMG_HEIGHT;
+    buffer out;
+
+    out.push_back('B');
+    out.push_back('M');
+    put_le(out, size, 4);
+    put_le(out, 0, 4);
+    put_le(out, 54, 4); // offset to pixel data
+    put_le(out, 40, 4); // info header size
+    put_le(out, IMG_WIDTH, 4);
+    put_le(out, IMG_HEIGHT, 4); // bottom-up
+    put_le(out, 1, 2);          // planes
+    put_le(out, 24, 2);         // bpp
+    put_le(out, 0, 4);          // BI_RGB
+    put_le(out, stride * IMG_HEIGHT, 4);
+    put_le(out, 0, 4 * 4); // resolution and palette
+    for (size_t y = IMG_HEIGHT; y > 0; --y) {
+        for (size_t x = 0; x < IMG_WIDTH; ++x) {
+            put_le(out, pixel(x, y - 1), 3);
+        }
+        out.resize(out.size() + stride - IMG_WIDTH * 3);
+    }
+
+    return out;
+}
+
+static buffer encode_farbfeld()
+{
+    const char signature[] = "farbfeld";
+    buffer out(signature, signature + sizeof(signature) - 1);
+
+    put_be(out, IMG_WIDTH, 4);
+    put_be(out, IMG_HEIGHT, 4);
+    for (size_t y = 0; y < IMG_HEIGHT; ++y) {
+        for (size_t x = 0; x < IMG_WIDTH; ++x) {
+            const argb_t c = pixel(x, y);
+            put_be(out, ARGB_GET_R(c) * 0x101, 2);
+            put_be(out, ARGB_GET_G(c) * 0x101, 2);
+            put_be(out, ARGB_GET_B(c) * 0x101, 2);
+            put_be(out, ARGB_GET_A(c) * 0x101, 2);
+        }
+    }
+
+    return out;
+}
+
+static buffer encode_pnm()
+{
+    const std::string header = "P6\n" + std::to_string(IMG_WIDTH) + " " +
+        std::to_string(IMG_HEIGHT) + "\n255\n";
+    buffer out(header.begin(), header.end());
+
+    for (size_t y = 0; y < IMG_HEIGHT; ++y) {
+        for (size_t x = 0; x < IMG_WIDTH; ++x) {
+            put_be(out, pixel(x, y), 3);
+        }
+    }
+
+    return out;
+}
+
+static buffer encode_qoi()
+{
+    const char signature[] = "qoif";
+    buffer out(signature, signature + sizeof(signature) - 1);
+
+    put_be(out, IMG_WIDTH, 4);
+    put_be(out, IMG_HEIGHT, 4);
+    out.push_back(4); // channels
+    out.push_back(0); // sRGB
+    for (size_t y = 0; y < IMG_HEIGHT; ++y) {
+        for (size_t x = 0; x < IMG_WIDTH; ++x) {
+            const argb_t c = pixel(x, y);
+            out.push_back(0xff); // QOI_OP_RGBA
+            out.push_back(ARGB_GET_R(c));
+            out.push_back(ARGB_GET_G(c));
+            out.push_back(ARGB_GET_B(c));
+            out.push_back(ARGB_GET_A(c));
+        }
+    }
+    put_be(out, 0, 4); // end marker
+    put_be(out, 1, 4);
+
+    return out;
+}
+
+static buffer encode_tga()
+{
+    buffer out;
+
+    out.push_back(0); // id length
+    out.push_back(0); // no color map
+    out.push_back(2); // uncompressed true color
+    put_le(out, 0, 5 + 4);
+    put_le(out, IMG_WIDTH, 2);
+    put_le(out, IMG_HEIGHT, 2);
+    out.push_back(32);   // bpp
+    out.push_back(0x28); // top-left origin, 8-bit alpha
+    for (size_t y = 0; y < IMG_HEIGHT; ++y) {
+        for (size_t x = 0; x < IMG_WIDTH; ++x) {
+            put_le(out, pixel(x, y), 4);
+        }
+    }
+
+    return out;
+}
+
+static buffer read_file(const char* name)
+{
+    const std::string path = std::string(BENCH_DATA_DIR "/") + name;
+    std::ifstream file(path, std::ios::binary);
+    return buffer((std::istreambuf_iterator<char>(file)),
+                  std::istreambuf_iterator<char>());
+}
+
+static void decode(benchmark::State& state, const buffer& data)
+{
+    if (data.empty()) {
+        state.SkipWithError("no image data");
+        return;
+    }
+
+    for (auto _ : state) {
+        struct image* image = image_alloc();
+        const enum loader_status status =
+            loader_decode_embedded(image, data.data(), data.size());
+        image_free(image);
+        if (status != ldr_success) {
+            state.SkipWithError("format is not supported");
+            break;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+
+static void Decode(benchmark::State& state, buffer (*encode)())
+{
+    decode(state, encode());
+}
+BENCHMARK_CAPTURE(Decode, bmp, encode_bmp)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(Decode, farbfeld, encode_farbfeld)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(Decode, pnm, encode_pnm)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(Decode, qoi, encode_qoi)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(Decode, tga, encode_tga)->Unit(benchmark::kMillisecond);
+
+static void DecodeFile(benchmark::State& state, const char* name)
+{
+    decode(state, read_file(name));
+}
+#if defined(HAVE_LIBAVIF) || defined(HAVE_LIBHEIF)
+BENCHMARK_CAPTURE(DecodeFile, avif, "image.avif");
+#endif
+BENCHMARK_CAPTURE(DecodeFile, dicom, "image.dcm");
+#ifdef HAVE_LIBGIF
+BENCHMARK_CAPTURE(DecodeFile, gif, "image.gif");
+#endif
+#ifdef HAVE_LIBHEIF
+BENCHMARK_CAPTURE(DecodeFile, heif, "image.heif");
+#endif
+#ifdef HAVE_LIBJPEG
+BENCHMARK_CAPTURE(DecodeFile, jpeg, "image.jpg");
+#endif
+#ifdef HAVE_LIBJXL
+BENCHMARK_CAPTURE(DecodeFile, jxl, "image.jxl");
+#endif
+#ifdef HAVE_LIBPNG
+BENCHMARK_CAPTURE(DecodeFile, png, "image.png");
+#endif
+#ifdef HAVE_LIBSIXEL
+BENCHMARK_CAPTURE(DecodeFile, sixel, "image.six");
+#endif
+#ifdef HAVE_LIBRSVG
+BENCHMARK_CAPTURE(DecodeFile, svg, "image.svg");
+#endif
+#ifdef HAVE_LIBTIFF
+BENCHMARK_CAPTURE(DecodeFile, tiff, "image.tiff");
+#endif
+#ifdef HAVE_LIBWEBP
+BENCHMARK_CAPTURE(DecodeFile, webp, "image.webp");
+#endif
+
+static void Thumbnail(benchmark::State& state)
+{
+    const buffer data = encode_pnm();
+    char path[] = "/tmp/swayimg_bench_XXXXXX";
+    struct config* cfg;
+    int fd;
+
+    fd = mkstemp(path);
+    if (fd == -1 || write(fd, data.data(), data.size()) !=
+            static_cast<ssize_t>(data.size())) {
+        state.SkipWithError("unable to create image file");
+        return;
+    }
+    close(fd);
+
+    cfg = config_load();
+    config_set(cfg, CFG_GALLERY, CFG_GLRY_PSTORE, CFG_NO);
+    thumbnail_init(cfg);
+
+    // load and reduce the image, the previous thumbnail is replaced
+    for (auto _ : state) {
+        struct image* image;
+        if (loader_from_source(path, &image) != ldr_success) {
+            state.SkipWithError("unable to load image");
+            break;
+        }
+        thumbnail_add(image);
+    }
+
+    thumbnail_free();
+    config_free(cfg);
+    unlink(path);
+}
+BENCHMARK(Thumbnail)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "application.h"
+#include "info.h"
+}
+
+#include <benchmark/benchmark.h>
+
+// stubs for linker (application, ui and info are not included to benchmarks)
+extern "C" {
+void app_watch(int, short, fd_callback, void*) { }
+void app_reload() { }
+void app_redraw() { }
+void app_redraw_overlay(ssize_t, ssize_t, size_t, size_t) { }
+void app_on_resize() { }
+void app_on_keyboard(xkb_keysym_t, uint8_t) { }
+void app_on_drag(int, int) { }
+void app_exit(int) { }
+void app_on_load(struct image*, size_t) { }
+void app_on_update(size_t) { }
+void app_on_progress(const struct image*, size_t) { }
+bool app_is_viewer()
+{
+    return true;
+}
+bool info_has_field(const struct config*, const char*, enum info_field)
+{
+    return false;
+}
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "pixmap.h"
+#include "pixmap_ablend.h"
+#include "pixmap_scale.h"
+#include "tpool.h"
+}
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <thread>
+
+// Size of the source image
+#define SRC_WIDTH  1024
+#define SRC_HEIGHT 768
+
+// Size of the window used as destination
+#define WND_WIDTH  1920
+#define WND_HEIGHT 1080
+
+/** Source and destination pixmaps. */
+class Pixmaps {
+public:
+    Pixmaps(size_t width, size_t height, size_t dst_width, size_t dst_height)
+    {
+        pixmap_create(&src, width, height);
+        pixmap_create(&dst, dst_width, dst_height);
+        for (size_t i = 0; i < width * height; ++i) {
+            // semi-transparent noise
+            src.data[i] = ARGB(0x80 + (i & 0x7f), i * 7, i * 13, i * 17);
+        }
+    }
+
+    ~Pixmaps()
+    {
+        pixmap_free(&src);
+        pixmap_free(&dst);
+    }
+
+    struct pixmap src;
+    struct pixmap dst;
+};
+
+/**
+ * Set total number of threads used by the pool.
+ * @param state benchmark state
+ * @param arg index of the argument with number of threads
+ */
+static void set_threads(benchmark::State& state, size_t arg)
+{
+    const size_t threads = state.range(arg);
+    tpool_destroy();
+    if (threads > 1) {
+        // the calling thread is a worker too
+        tpool_init(threads - 1);
+    }
+    state.counters["threads"] = tpool_threads();
+}
+
+/**
+ * Benchmark arguments: every scaler, up and down ratios, alpha blending on and
+ * off, and 1..N threads.
+ */
+static void scale_args(benchmark::internal::Benchmark* bench)
+{
+    const size_t max_threads = std::thread::hardware_concurrency();
+
+    bench->ArgNames({ "aa", "scale%", "alpha", "threads" });
+    for (int aa = aa_nearest; aa <= aa_mks13; ++aa) {
+        for (int scale : { 25, 50, 200 }) {
+            for (int alpha : { 0, 1 }) {
+                for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+                    bench->Args({ aa, scale, alpha,
+                                  static_cast<int64_t>(threads) });
+                }
+                if (max_threads & (max_threads - 1)) {
+                    // not a power of 2
+                    bench->Args({ aa, scale, alpha,
+                                  static_cast<int64_t>(max_threads) });
+                }
+            }
+        }
+    }
+}
+
+static void Scale(benchmark::State& state)
+{
+    const enum aa_mode aa = static_cast<enum aa_mode>(state.range(0));
+    const float scale = static_cast<float>(state.range(1)) / 100;
+    const bool alpha = state.range(2);
+    const size_t width = std::min<size_t>(SRC_WIDTH * scale, WND_WIDTH);
+    const size_t height = std::min<size_t>(SRC_HEIGHT * scale, WND_HEIGHT);
+    Pixmaps pm(SRC_WIDTH, SRC_HEIGHT, width, height);
+
+    set_threads(state, 3);
+    state.SetLabel(aa_name(aa));
+
+    for (auto _ : state) {
+        pixmap_scale(aa, &pm.src, &pm.dst, 0, 0, scale, alpha);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * width * height);
+
+    tpool_destroy();
+}
+BENCHMARK(Scale)->Apply(scale_args)->Unit(benchmark::kMillisecond);
+
+static void Copy(benchmark::State& state)
+{
+    const bool alpha = state.range(0);
+    Pixmaps pm(WND_WIDTH, WND_HEIGHT, WND_WIDTH, WND_HEIGHT);
+
+    for (auto _ : state) {
+        pixmap_copy(&pm.src, &pm.dst, 0, 0, alpha);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * WND_WIDTH * WND_HEIGHT);
+}
+BENCHMARK(Copy)->ArgName("alpha")->Arg(0)->Arg(1);
+
+static void BlendSpan(benchmark::State& state)
+{
+    Pixmaps pm(WND_WIDTH, 1, WND_WIDTH, 1);
+
+    for (auto _ : state) {
+        alpha_blend_span(pm.src.data, pm.dst.data, WND_WIDTH);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * WND_WIDTH);
+}
+BENCHMARK(BlendSpan);
+
+static void BlendFill(benchmark::State& state)
+{
+    Pixmaps pm(1, 1, WND_WIDTH, WND_HEIGHT);
+
+    for (auto _ : state) {
+        pixmap_blend(&pm.dst, 0, 0, WND_WIDTH, WND_HEIGHT, 0x80123456);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * WND_WIDTH * WND_HEIGHT);
+}
+BENCHMARK(BlendFill);
+
+static void Rotate(benchmark::State& state)
+{
+    const size_t angle = state.range(0);
+    Pixmaps pm(SRC_WIDTH, SRC_HEIGHT, 1, 1);
+
+    for (auto _ : state) {
+        pixmap_rotate(&pm.src, angle);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * SRC_WIDTH * SRC_HEIGHT);
+}
+BENCHMARK(Rotate)->ArgName("angle")->Arg(90)->Arg(180)->Arg(270);
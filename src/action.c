@@ -46,7 +46,10 @@ static const char* action_names[] = {
     [action_flip_horizontal] = "flip_horizontal",
     [action_reload] = "reload",
     [action_antialiasing] = "antialiasing",
+    [action_window_level] = "window_level",
     [action_info] = "info",
+    [action_perf] = "perf",
+    [action_trace] = "trace",
     [action_exec] = "exec",
     [action_export] = "export",
     [action_status] = "status",
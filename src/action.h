@@ -40,7 +40,10 @@ enum action_type {
     action_flip_horizontal,
     action_reload,
     action_antialiasing,
+    action_window_level,
     action_info,
+    action_perf,
+    action_trace,
     action_exec,
     action_export,
     action_status,
@@ -0,0 +1,351 @@
+// SPDX-License-Identifier: MIT
+// Animation frames decoded on demand.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "animation.h"
+
+#include "worker.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Max size of all frames decoded at once, larger animations use the ring
+#define ANIM_MEMORY_LIMIT (128 * 1024 * 1024)
+
+// Number of frames decoded ahead
+#define ANIM_RING_SIZE 4
+
+/** Decoded frame. */
+struct anim_frame {
+    struct pixmap pm;           ///< Frame data
+    size_t duration;            ///< Frame duration in milliseconds
+    struct pixmap_area changed; ///< Area changed since the previous frame
+    bool partial;               ///< Only `changed` area differs
+};
+
+/** Animation context. */
+struct animation {
+    struct anim_decoder decoder; ///< Frame decoder
+    size_t width, height;        ///< Size of the animation canvas
+    size_t frames;               ///< Total number of frames
+    size_t index;                ///< Index of the current frame
+    enum pixmap_orient orient;   ///< Transform of decoded frames
+
+    struct anim_frame ring[ANIM_RING_SIZE]; ///< Frames decoded ahead
+    size_t capacity;                        ///< Number of slots in ring
+    size_t head;                            ///< First decoded frame in ring
+    size_t ready;                           ///< Number of decoded frames
+    struct pixmap last;                     ///< Last decoded frame
+
+    bool posted;          ///< Decoding job is in the worker queue
+    bool pause;           ///< Decoding ahead is suspended
+    bool failed;          ///< Decoder failed, no more frames ahead
+    pthread_mutex_t lock; ///< Ring access lock
+};
+
+/**
+ * Combine orientation transforms.
+ * @param first transform applied first
+ * @param second transform applied after the first one
+ * @return combined transform
+ */
+static enum pixmap_orient combine_orient(enum pixmap_orient first,
+                                         enum pixmap_orient second)
+{
+    const int flips = orient_flip_x | orient_flip_y;
+    int flip = first & flips;
+
+    if (second & orient_transpose) {
+        // transpose swaps axes of the flips applied before it
+        flip = (flip & orient_flip_x ? orient_flip_y : 0) |
+            (flip & orient_flip_y ? orient_flip_x : 0);
+    }
+
+    return ((first ^ second) & orient_transpose) | (flip ^ (second & flips));
+}
+
+/**
+ * Decode next frame and apply orientation transform.
+ * @param anim animation context
+ * @param pm destination pixmap
+ * @param duration output frame duration in milliseconds
+ * @return false on errors
+ */
+static bool decode_frame(struct animation* anim, struct pixmap* pm,
+                         size_t* duration)
+{
+    // buffer may hold a transposed frame, decoder expects the canvas size
+    pm->width = anim->width;
+    pm->height = anim->height;
+
+    if (!anim->decoder.decode(anim->decoder.data, pm, duration)) {
+        return false;
+    }
+    pixmap_orient(pm, anim->orient);
+
+    return true;
+}
+
+static void decode_ahead(void* data);
+
+/**
+ * Post decoding job if there is a free slot in the ring, must be called
+ * with the ring lock held.
+ * @param anim animation context
+ */
+static void post_decoding(struct animation* anim)
+{
+    if (!anim->posted && !anim->pause && !anim->failed &&
+        anim->ready < anim->capacity) {
+        anim->posted = worker_post(decode_ahead, anim);
+    }
+}
+
+/**
+ * Worker job: decode the next frame into the ring.
+ * @param data animation context
+ */
+static void decode_ahead(void* data)
+{
+    struct animation* anim = data;
+    struct anim_frame* frame;
+    struct pixmap prev;
+    bool rc;
+
+    // slot is not visible to the consumer until it is marked as ready
+    pthread_mutex_lock(&anim->lock);
+    frame = &anim->ring[(anim->head + anim->ready) % anim->capacity];
+    prev = anim->last;
+    pthread_mutex_unlock(&anim->lock);
+
+    rc = decode_frame(anim, &frame->pm, &frame->duration);
+    if (rc) {
+        // buffer of the previous frame is not reused until this one is
+        // displayed, so it is safe to read it
+        frame->partial = pixmap_diff(&prev, &frame->pm, &frame->changed);
+    }
+
+    pthread_mutex_lock(&anim->lock);
+    anim->posted = false;
+    if (rc) {
+        anim->last = frame->pm;
+        ++anim->ready;
+    } else {
+        anim->failed = true; // keep playing already decoded frames
+    }
+    post_decoding(anim);
+    pthread_mutex_unlock(&anim->lock);
+}
+
+/**
+ * Stop decoding ahead: drop the queued job and wait for the running one.
+ * @param anim animation context
+ */
+static void suspend_decoding(struct animation* anim)
+{
+    pthread_mutex_lock(&anim->lock);
+    anim->pause = true;
+    pthread_mutex_unlock(&anim->lock);
+
+    worker_cancel(anim);
+
+    pthread_mutex_lock(&anim->lock);
+    anim->posted = false;
+    pthread_mutex_unlock(&anim->lock);
+}
+
+/**
+ * Continue decoding ahead.
+ * @param anim animation context
+ */
+static void resume_decoding(struct animation* anim)
+{
+    pthread_mutex_lock(&anim->lock);
+    anim->pause = false;
+    post_decoding(anim);
+    pthread_mutex_unlock(&anim->lock);
+}
+
+bool animation_lazy(const struct image* image, size_t width, size_t height,
+                    size_t frames)
+{
+    // only the first frame is used for thumbnails
+    return frames > 1 &&
+        (image->size_hint ||
+         width * height * sizeof(argb_t) * frames > ANIM_MEMORY_LIMIT);
+}
+
+bool animation_create(struct image* image, size_t width, size_t height,
+                      size_t frames, const struct anim_decoder* decoder)
+{
+    struct animation* anim;
+    struct image_frame* frame;
+
+    // decode the first frame
+    frame = image_create_frames(image, 1);
+    if (!frame || !pixmap_create(&frame->pm, width, height) ||
+        !decoder->decode(decoder->data, &frame->pm, &frame->duration)) {
+        image_free_frames(image);
+        decoder->free(decoder->data);
+        return false;
+    }
+
+    if (image->size_hint) {
+        decoder->free(decoder->data);
+        return true; // thumbnail
+    }
+
+    // start decoding next frames
+    anim = calloc(1, sizeof(*anim));
+    if (!anim) {
+        decoder->free(decoder->data);
+        return true;
+    }
+    pthread_mutex_init(&anim->lock, NULL);
+    anim->decoder = *decoder;
+    anim->width = width;
+    anim->height = height;
+    anim->frames = frames;
+    anim->capacity = frames < ANIM_RING_SIZE ? frames : ANIM_RING_SIZE;
+    anim->last = frame->pm;
+    image->anim = anim;
+    for (size_t i = 0; i < anim->capacity; ++i) {
+        if (!pixmap_create(&anim->ring[i].pm, width, height)) {
+            animation_free(image);
+            return true;
+        }
+    }
+
+    pthread_mutex_lock(&anim->lock);
+    post_decoding(anim);
+    pthread_mutex_unlock(&anim->lock);
+
+    return true;
+}
+
+void animation_free(struct image* image)
+{
+    struct animation* anim = image->anim;
+
+    if (!anim) {
+        return;
+    }
+
+    suspend_decoding(anim);
+    pthread_mutex_destroy(&anim->lock);
+
+    anim->decoder.free(anim->decoder.data);
+    for (size_t i = 0; i < ANIM_RING_SIZE; ++i) {
+        pixmap_free(&anim->ring[i].pm);
+    }
+    free(anim);
+
+    image->anim = NULL;
+}
+
+bool animation_next(struct image* image)
+{
+    struct animation* anim = image->anim;
+    struct image_frame* frame = &image->frames[0];
+    struct anim_frame* next;
+    struct pixmap tmp;
+    bool rc = false;
+
+    pthread_mutex_lock(&anim->lock);
+    if (anim->ready) {
+        // exchange buffers: the displayed one is reused for decoding
+        next = &anim->ring[anim->head];
+        tmp = frame->pm;
+        frame->pm = next->pm;
+        frame->duration = next->duration;
+        frame->changed = next->changed;
+        frame->partial = next->partial;
+        next->pm = tmp;
+
+        anim->head = (anim->head + 1) % anim->capacity;
+        --anim->ready;
+        if (++anim->index >= anim->frames) {
+            anim->index = 0;
+        }
+        rc = true;
+    }
+    post_decoding(anim);
+    pthread_mutex_unlock(&anim->lock);
+
+    if (rc) {
+        image_free_mipmap(image); // mipmaps belong to the previous frame
+    }
+
+    return rc;
+}
+
+bool animation_seek(struct image* image, size_t index)
+{
+    struct animation* anim = image->anim;
+    struct image_frame* frame = &image->frames[0];
+    bool rc;
+
+    if (!anim->decoder.seek || index >= anim->frames) {
+        return false;
+    }
+
+    // decoder is not used by the worker until decoding is resumed
+    suspend_decoding(anim);
+
+    rc = anim->decoder.seek(anim->decoder.data, index) &&
+        decode_frame(anim, &frame->pm, &frame->duration);
+    if (rc) {
+        anim->index = index;
+        anim->failed = false;
+        frame->partial = false;
+        image_free_mipmap(image);
+    }
+
+    // drop frames decoded ahead
+    pthread_mutex_lock(&anim->lock);
+    anim->ready = 0;
+    anim->last = frame->pm;
+    pthread_mutex_unlock(&anim->lock);
+
+    resume_decoding(anim);
+
+    return rc;
+}
+
+void animation_orient(struct image* image, enum pixmap_orient orient)
+{
+    struct animation* anim = image->anim;
+
+    suspend_decoding(anim);
+
+    pthread_mutex_lock(&anim->lock);
+    for (size_t i = 0; i < anim->ready; ++i) {
+        struct anim_frame* frame =
+            &anim->ring[(anim->head + i) % anim->capacity];
+        pixmap_orient(&frame->pm, orient);
+        frame->partial = false; // changed area is not transformed
+    }
+    anim->orient = combine_orient(anim->orient, orient);
+    // the displayed frame is transformed by the caller, so the next frame
+    // is not compared with it
+    if (anim->ready) {
+        anim->last =
+            anim->ring[(anim->head + anim->ready - 1) % anim->capacity].pm;
+    } else {
+        memset(&anim->last, 0, sizeof(anim->last));
+    }
+    pthread_mutex_unlock(&anim->lock);
+
+    resume_decoding(anim);
+}
+
+size_t animation_index(const struct image* image)
+{
+    return image->anim->index;
+}
+
+size_t animation_frames(const struct image* image)
+{
+    return image->anim->frames;
+}
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: MIT
+// Animation frames decoded on demand.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include "image.h"
+
+/**
+ * Decode next frame of the animation, called from the worker thread.
+ * Frames are requested sequentially, the first frame follows the last one.
+ * @param data decoder specific data
+ * @param pm destination pixmap, has the size of the animation canvas
+ * @param duration output frame duration in milliseconds
+ * @return false on errors
+ */
+typedef bool (*anim_decode_fn)(void* data, struct pixmap* pm,
+                               size_t* duration);
+
+/**
+ * Set position of the decoder, the next decoded frame will have the
+ * specified index.
+ * @param data decoder specific data
+ * @param index index of the frame
+ * @return false on errors
+ */
+typedef bool (*anim_seek_fn)(void* data, size_t index);
+
+/**
+ * Free decoder specific data.
+ * @param data decoder specific data
+ */
+typedef void (*anim_free_fn)(void* data);
+
+/** Animation frame decoder. */
+struct anim_decoder {
+    anim_decode_fn decode; ///< Next frame decoder
+    anim_seek_fn seek;     ///< Decoder positioning, can be NULL
+    anim_free_fn free;     ///< Decoder destructor
+    void* data;            ///< Decoder specific data
+};
+
+/**
+ * Check if frames of the animation should be decoded on demand instead of
+ * decoding all of them at once.
+ * @param image image context
+ * @param width,height size of the animation canvas
+ * @param frames total number of frames
+ * @return true if on demand decoding should be used
+ */
+bool animation_lazy(const struct image* image, size_t width, size_t height,
+                    size_t frames);
+
+/**
+ * Setup animation with frames decoded on demand: the first frame is decoded
+ * immediately into the only frame of the image, next frames are decoded
+ * ahead by the background worker.
+ * The decoder is freed by the function in any case.
+ * @param image image context
+ * @param width,height size of the animation canvas
+ * @param frames total number of frames
+ * @param decoder frame decoder
+ * @return true if the first frame was decoded
+ */
+bool animation_create(struct image* image, size_t width, size_t height,
+                      size_t frames, const struct anim_decoder* decoder);
+
+/**
+ * Free animation, the image keeps the last displayed frame.
+ * @param image image context
+ */
+void animation_free(struct image* image);
+
+/**
+ * Switch the image frame to the next one.
+ * @param image image context
+ * @return false if the next frame is not decoded yet
+ */
+bool animation_next(struct image* image);
+
+/**
+ * Switch the image frame to the specified one, the frame is decoded
+ * synchronously.
+ * @param image image context
+ * @param index index of the frame
+ * @return false if decoder doesn't support positioning or on errors
+ */
+bool animation_seek(struct image* image, size_t index);
+
+/**
+ * Apply orientation transform to the frames decoded ahead and to all frames
+ * decoded later, the current frame is not changed.
+ * @param image image context
+ * @param orient orientation transform
+ */
+void animation_orient(struct image* image, enum pixmap_orient orient);
+
+/**
+ * Get index of the current frame.
+ * @param image image context
+ * @return index of the frame displayed in the image frame
+ */
+size_t animation_index(const struct image* image);
+
+/**
+ * Get total number of frames.
+ * @param image image context
+ * @return number of animation frames
+ */
+size_t animation_frames(const struct image* image);
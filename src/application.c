@@ -6,15 +6,27 @@
 
 #include "array.h"
 #include "buildcfg.h"
+#include "dcache.h"
+#include "execcache.h"
+#include "fetcher.h"
 #include "font.h"
 #include "gallery.h"
 #include "imagelist.h"
 #include "info.h"
+#include "instance.h"
 #include "loader.h"
+#include "memcache.h"
+#include "mempress.h"
+#include "perf.h"
+#include "priority.h"
 #include "shellcmd.h"
 #include "sway.h"
+#include "tpool.h"
+#include "trace.h"
 #include "ui.h"
 #include "viewer.h"
+#include "worker.h"
+#include "zcache.h"
 
 #include <errno.h>
 #include <limits.h>
@@ -23,6 +35,8 @@
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
 #include <unistd.h>
 
 // Special ids for windows size and position
@@ -31,8 +45,17 @@
 #define SIZE_FROM_PARENT (SIZE_MAX - 2)
 #define POS_FROM_PARENT  SSIZE_MAX
 
+// Delay before applying changes of the watched directories (ms)
+#define LIST_DEBOUNCE 300
+// Max delay of the changes if the directories are modified continuously (ms)
+#define LIST_DEBOUNCE_MAX 2000
+
+// Max time for Sway IPC query on startup (ms)
+#define SWAY_DEADLINE 250
+
 /** Main loop state */
 enum loop_state {
+    loop_init,
     loop_run,
     loop_stop,
     loop_error,
@@ -41,38 +64,158 @@ enum loop_state {
 /** File descriptor and its handler. */
 struct watchfd {
     int fd;
+    short events;
     void* data;
     fd_callback callback;
 };
 
-/* Application event queue (list). */
+/* Overflow list of the application event queue. */
 struct event_queue {
     struct list list;
     struct event event;
 };
 
+/** Sway IPC query executed in background on startup. */
+struct sway_query {
+    pthread_mutex_t lock;  ///< Query state lock
+    pthread_cond_t signal; ///< Query completion notification
+    bool started;          ///< Query thread is running
+    bool done;             ///< Query completed
+    bool abandoned;        ///< Result is not needed anymore
+    int ipc;               ///< IPC context, valid if window was found
+    struct wndrect parent; ///< Geometry of currently focused window
+    int border;            ///< Size of window border
+    bool fullscreen;       ///< Current full screen mode
+    struct timespec limit; ///< Deadline for the query result
+};
+
 /** Application context */
 struct application {
     enum loop_state state; ///< Main loop state
 
     struct watchfd* wfds; ///< FD polling descriptors
     size_t wfds_num;      ///< Number of polling FD
-
-    struct event_queue* events;  ///< Event queue
-    pthread_mutex_t events_lock; ///< Event queue lock
-    int event_signal;            ///< Queue change notification
+    bool wfds_changed;    ///< Polling descriptors were added or removed
+    int mem_pressure;     ///< PSI trigger, owned by the pressure monitor
+
+    struct event_ring events;      ///< Event queue
+    struct event_queue* overflow;  ///< Events that don't fit into the queue
+    pthread_mutex_t overflow_lock; ///< Overflow list lock
+    int event_signal;              ///< Queue change notification
+    bool redraw;                   ///< Pending redraw request
+    struct drag drag;              ///< Pending drag offset
+    int list_timer;                ///< Image list update timer
+    uint64_t list_deadline;        ///< Max time of the list update (us)
 
     struct action_seq sigusr1; ///< Actions applied by USR1 signal
     struct action_seq sigusr2; ///< Actions applied by USR2 signal
+    int signals;               ///< Pending signals: bit 0 USR1, bit 1 USR2
 
     event_handler ehandler; ///< Event handler for the current mode
     struct wndrect window;  ///< Preferable window position and size
+    struct sway_query sway; ///< Sway IPC query
     bool wnd_decor;         //< Window decoration: borders and title
     char* app_id;           ///< Application id (app_id name)
 };
 
 /** Global application context. */
-static struct application ctx;
+static struct application ctx = { .mem_pressure = -1 };
+
+/**
+ * Sway IPC query thread: get geometry of currently focused window.
+ * @param data not used
+ * @return always NULL
+ */
+static void* sway_query_thread(__attribute__((unused)) void* data)
+{
+    struct wndrect parent = { 0 };
+    bool fullscreen = false;
+    int border = 0;
+    int ipc;
+
+    ipc = sway_connect();
+    if (ipc != INVALID_SWAY_IPC &&
+        !sway_current(ipc, &parent, &border, &fullscreen)) {
+        sway_disconnect(ipc);
+        ipc = INVALID_SWAY_IPC;
+    }
+
+    pthread_mutex_lock(&ctx.sway.lock);
+    if (ctx.sway.abandoned) {
+        sway_disconnect(ipc); // too late, startup finished without us
+    } else {
+        ctx.sway.ipc = ipc;
+        ctx.sway.parent = parent;
+        ctx.sway.border = border;
+        ctx.sway.fullscreen = fullscreen;
+        ctx.sway.done = true;
+        pthread_cond_signal(&ctx.sway.signal);
+    }
+    pthread_mutex_unlock(&ctx.sway.lock);
+
+    return NULL;
+}
+
+/**
+ * Start Sway IPC query in background, so it doesn't delay image loading.
+ */
+static void sway_query_start(void)
+{
+    struct timespec* limit = &ctx.sway.limit;
+    pthread_t thread;
+
+    clock_gettime(CLOCK_REALTIME, limit);
+    limit->tv_sec += SWAY_DEADLINE / 1000;
+    limit->tv_nsec += (SWAY_DEADLINE % 1000) * 1000000;
+    if (limit->tv_nsec >= 1000000000) {
+        ++limit->tv_sec;
+        limit->tv_nsec -= 1000000000;
+    }
+
+    ctx.sway.ipc = INVALID_SWAY_IPC;
+    pthread_mutex_init(&ctx.sway.lock, NULL);
+    pthread_cond_init(&ctx.sway.signal, NULL);
+
+    if (pthread_create(&thread, NULL, sway_query_thread, NULL) == 0) {
+        pthread_detach(thread);
+        ctx.sway.started = true;
+    }
+}
+
+/**
+ * Get Sway IPC query result, the query is abandoned if it is not completed.
+ * @param wait flag to wait for the result until the startup deadline
+ * @return IPC context or INVALID_SWAY_IPC if the result is not available
+ */
+static int sway_query_finish(bool wait)
+{
+    int ipc;
+
+    if (!ctx.sway.started) {
+        return INVALID_SWAY_IPC;
+    }
+
+    pthread_mutex_lock(&ctx.sway.lock);
+    while (wait && !ctx.sway.done) {
+        if (pthread_cond_timedwait(&ctx.sway.signal, &ctx.sway.lock,
+                                   &ctx.sway.limit) != 0) {
+            break;
+        }
+    }
+    // the thread closes IPC itself if it is still in progress
+    ctx.sway.abandoned = true;
+    ipc = ctx.sway.ipc;
+    ctx.sway.ipc = INVALID_SWAY_IPC;
+    pthread_mutex_unlock(&ctx.sway.lock);
+
+    ctx.sway.started = false;
+
+    if (wait && !ctx.sway.done) {
+        fprintf(stderr, "Sway IPC timed out, use default window geometry\n");
+    }
+
+    return ipc;
+}
 
 /**
  * Setup window position via Sway IPC.
@@ -80,21 +223,15 @@ static struct application ctx;
  */
 static void sway_setup(const struct config* cfg)
 {
-    struct wndrect parent;
-    bool fullscreen;
-    int border;
+    const struct sway_query* query = &ctx.sway;
     int ipc;
 
-    ipc = sway_connect();
+    ipc = sway_query_finish(true);
     if (ipc == INVALID_SWAY_IPC) {
         return; // sway not available
     }
-    if (!sway_current(ipc, &parent, &border, &fullscreen)) {
-        sway_disconnect(ipc);
-        return;
-    }
 
-    if (fullscreen) {
+    if (query->fullscreen) {
         ctx.window.width = SIZE_FULLSCREEN;
         ctx.window.height = SIZE_FULLSCREEN;
         sway_disconnect(ipc);
@@ -102,16 +239,16 @@ static void sway_setup(const struct config* cfg)
     }
 
     if (ctx.window.width == SIZE_FROM_PARENT) {
-        ctx.window.width = parent.width;
-        ctx.window.height = parent.height;
+        ctx.window.width = query->parent.width;
+        ctx.window.height = query->parent.height;
         if (config_get_bool(cfg, CFG_GENERAL, CFG_GNRL_DECOR)) {
-            ctx.window.width -= border * 2;
-            ctx.window.height -= border * 2;
+            ctx.window.width -= query->border * 2;
+            ctx.window.height -= query->border * 2;
         }
     }
     if (ctx.window.x == POS_FROM_PARENT) {
-        ctx.window.x = parent.x;
-        ctx.window.y = parent.y;
+        ctx.window.x = query->parent.x;
+        ctx.window.y = query->parent.y;
     }
 
     // set window position via sway rules
@@ -132,23 +269,41 @@ static bool apply_common_action(const struct action* action)
     switch (action->type) {
         case action_info:
             info_switch(action->params);
-            app_redraw();
+            if (info_enabled() && app_is_viewer()) {
+                // meta info of the current image is parsed on demand
+                struct image* img = fetcher_current();
+                if (img && loader_load_meta(img)) {
+                    info_update_meta(img);
+                }
+            }
+            app_redraw_overlay(0, 0, ui_get_width(), ui_get_height());
+            break;
+        case action_perf:
+            info_switch_perf();
+            break;
+        case action_trace:
+            if (!trace_enabled()) {
+                info_update(info_status, "Tracing is disabled");
+            } else if (trace_dump()) {
+                info_update(info_status, "Trace saved");
+            } else {
+                info_update(info_status, "Unable to save trace");
+            }
             break;
         case action_status:
             info_update(info_status, "%s", action->params);
-            app_redraw();
             break;
         case action_fullscreen:
             ui_toggle_fullscreen();
             break;
         case action_help:
             info_switch_help();
-            app_redraw();
+            app_redraw_overlay(0, 0, ui_get_width(), ui_get_height());
             break;
         case action_exit:
             if (info_help_active()) {
                 info_switch_help(); // remove help overlay
-                app_redraw();
+                app_redraw_overlay(0, 0, ui_get_width(), ui_get_height());
             } else {
                 app_exit(0);
             }
@@ -161,50 +316,272 @@ static bool apply_common_action(const struct action* action)
     return handled;
 }
 
+/**
+ * Free image attached to the dropped load event.
+ * @param event load event
+ */
+static void free_load(const struct event* event)
+{
+    image_free(event->param.load.image);
+}
+
+/**
+ * Merge files found by the background scanner and changes of the watched
+ * directories to the image list.
+ */
+static void update_list(void)
+{
+    const struct event event = { .type = event_list };
+
+    if (!image_list_merge()) {
+        return;
+    }
+
+    // loading results are bound to the old indices
+    loader_queue_reset();
+    event_ring_remove(&ctx.events, event_load, free_load);
+    pthread_mutex_lock(&ctx.overflow_lock);
+    list_for_each(ctx.overflow, struct event_queue, it) {
+        if (it->event.type == event_load) {
+            ctx.overflow = list_unlink(ctx.overflow, it);
+            free_load(&it->event);
+            free(it);
+        }
+    }
+    pthread_mutex_unlock(&ctx.overflow_lock);
+
+    // both modes keep indices of the images
+    viewer_handle(&event);
+    gallery_handle(&event);
+}
+
+/**
+ * Get next event from the queue.
+ * @param event pointer to output event
+ * @return false if the queue is empty
+ */
+static bool next_event(struct event* event)
+{
+    struct event_queue* entry;
+
+    if (event_ring_pop(&ctx.events, event)) {
+        return true;
+    }
+
+    // overflow list contains events appended after the ring was filled, so
+    // it is not used until events in all taken slots are handled, the
+    // producer of a pending one raises notification after publishing it
+    if (!event_ring_empty(&ctx.events) ||
+        !__atomic_load_n(&ctx.overflow, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    pthread_mutex_lock(&ctx.overflow_lock);
+    entry = ctx.overflow;
+    if (entry) {
+        __atomic_store_n(&ctx.overflow, list_remove(entry), __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&ctx.overflow_lock);
+    if (!entry) {
+        return false;
+    }
+
+    memcpy(event, &entry->event, sizeof(*event));
+    free(entry);
+
+    return true;
+}
+
+/**
+ * Apply actions bound to the signal.
+ * @param sigact sequence of actions
+ */
+static void apply_sigact(const struct action_seq* sigact)
+{
+    for (size_t i = 0; i < sigact->num && ctx.state == loop_run; ++i) {
+        const struct event event = {
+            .type = event_action,
+            .param.action = &sigact->sequence[i],
+        };
+        if (!apply_common_action(event.param.action)) {
+            ctx.ehandler(&event);
+        }
+    }
+}
+
 /** Notification callback: handle event queue. */
 static void handle_event_queue(__attribute__((unused)) void* data)
 {
+    struct event event;
+    int signals;
+
     notification_reset(ctx.event_signal);
 
-    while (ctx.events && ctx.state == loop_run) {
-        struct event_queue* entry = NULL;
-        pthread_mutex_lock(&ctx.events_lock);
-        if (ctx.events) {
-            entry = ctx.events;
-            ctx.events = list_remove(entry);
+    while (ctx.state == loop_run && next_event(&event)) {
+        if (event.type == event_list) {
+            update_list();
+        } else if (event.type != event_action ||
+                   !apply_common_action(event.param.action)) {
+            ctx.ehandler(&event);
         }
-        pthread_mutex_unlock(&ctx.events_lock);
-        if (entry) {
-            if (entry->event.type != event_action ||
-                !apply_common_action(entry->event.param.action)) {
-                ctx.ehandler(&entry->event);
-            }
-            free(entry);
+    }
+
+    // received signals
+    signals = __atomic_exchange_n(&ctx.signals, 0, __ATOMIC_ACQUIRE);
+    if (signals & 1) {
+        apply_sigact(&ctx.sigusr1);
+    }
+    if (signals & 2) {
+        apply_sigact(&ctx.sigusr2);
+    }
+
+    // coalesced events are handled after the queue
+    if (ctx.state == loop_run) {
+        event.type = event_drag;
+        event.param.drag.dx =
+            __atomic_exchange_n(&ctx.drag.dx, 0, __ATOMIC_RELAXED);
+        event.param.drag.dy =
+            __atomic_exchange_n(&ctx.drag.dy, 0, __ATOMIC_RELAXED);
+        if (event.param.drag.dx || event.param.drag.dy) {
+            ctx.ehandler(&event);
         }
     }
+    if (ctx.state == loop_run &&
+        __atomic_exchange_n(&ctx.redraw, false, __ATOMIC_ACQ_REL)) {
+        event.type = event_redraw;
+        ctx.ehandler(&event);
+    }
 }
 
 /**
- * Append event to queue.
+ * Append event to queue, can be called from any thread but not from signal
+ * handler: the overflow list is allocated and locked.
  * @param event pointer to the event
  */
 static void append_event(const struct event* event)
 {
-    struct event_queue* entry;
+    // the ring is not used until the overflow list is empty to keep order
+    if (__atomic_load_n(&ctx.overflow, __ATOMIC_ACQUIRE) ||
+        !event_ring_push(&ctx.events, event)) {
+        struct event_queue* entry = malloc(sizeof(*entry));
+        if (!entry) {
+            return;
+        }
+        memcpy(&entry->event, event, sizeof(entry->event));
+        pthread_mutex_lock(&ctx.overflow_lock);
+        __atomic_store_n(&ctx.overflow, list_append(ctx.overflow, entry),
+                         __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&ctx.overflow_lock);
+    }
 
-    // create new entry
-    entry = malloc(sizeof(*entry));
-    if (!entry) {
+    notification_raise(ctx.event_signal);
+}
+
+/**
+ * Background scanner callback: new files found.
+ */
+static void on_list_found(void)
+{
+    const struct event event = { .type = event_list };
+    append_event(&event);
+}
+
+/**
+ * Directory watcher callback: files were added or removed.
+ */
+static void on_list_changed(__attribute__((unused)) void* data)
+{
+    if (image_list_watch_read(on_list_found)) {
+        // postpone update until the changes are over, but not forever
+        const uint64_t now = perf_now();
+        uint64_t delay = LIST_DEBOUNCE * 1000;
+        struct itimerspec ts = { 0 };
+
+        if (ctx.list_deadline == 0) {
+            ctx.list_deadline = now + LIST_DEBOUNCE_MAX * 1000;
+        }
+        if (now + delay > ctx.list_deadline) {
+            delay = ctx.list_deadline > now ? ctx.list_deadline - now : 1;
+        }
+        ts.it_value.tv_sec = delay / 1000000;
+        ts.it_value.tv_nsec = (delay % 1000000) * 1000;
+        timerfd_settime(ctx.list_timer, 0, &ts, NULL);
+    }
+}
+
+/**
+ * Image list update timer callback.
+ */
+static void on_list_timer(__attribute__((unused)) void* data)
+{
+    uint64_t expirations;
+    if (read(ctx.list_timer, &expirations, sizeof(expirations)) > 0) {
+        ctx.list_deadline = 0;
+        update_list();
+    }
+}
+
+/**
+ * Connection of another instance callback: sources passed by the instance.
+ * @param data client socket file descriptor
+ */
+static void on_instance_data(void* data)
+{
+    const int fd = (int)(intptr_t)data;
+    char* sources;
+    size_t size, num, index;
+
+    if (!instance_read(fd, &sources, &size, &num)) {
+        return; // wait for more data
+    }
+    app_unwatch(fd);
+    close(fd); // acknowledge to the sender
+    if (num == 0) {
         return;
     }
-    memcpy(&entry->event, event, sizeof(entry->event));
 
-    // add to queue tail
-    pthread_mutex_lock(&ctx.events_lock);
-    ctx.events = list_append(ctx.events, entry);
-    pthread_mutex_unlock(&ctx.events_lock);
+    // single file is opened without waiting for the directory scan
+    for (const char* it = sources; it < sources + size; it += strlen(it) + 1) {
+        image_list_enqueue(it, num == 1 ? on_list_found : NULL);
+    }
+    update_list();
 
-    notification_raise(ctx.event_signal);
+    // open the first passed file, directories are just added to the list
+    index = image_list_find(sources);
+    if (index != IMGLIST_INVALID) {
+        if (ctx.ehandler == viewer_handle) {
+            viewer_open(index);
+        } else {
+            app_switch_mode(index);
+        }
+    }
+
+    free(sources);
+}
+
+/**
+ * Control socket callback: connection of another instance.
+ * @param data control socket file descriptor
+ */
+static void on_instance(void* data)
+{
+    const int fd = instance_accept((int)(intptr_t)data);
+    if (fd != -1) {
+        app_watch(fd, POLLIN, on_instance_data, (void*)(intptr_t)fd);
+    }
+}
+
+/**
+ * Memory pressure callback: a half of cached and compressed images is
+ * released.
+ */
+static void on_mem_pressure(__attribute__((unused)) void* data)
+{
+    struct memcache_stats stats;
+
+    // pixel buffers are returned to the system after both caches are shrunk
+    zcache_shrink(zcache_size() / 2);
+    memcache_stats(&stats);
+    memcache_shrink(stats.used / 2);
 }
 
 /**
@@ -213,26 +590,23 @@ static void append_event(const struct event* event)
  */
 static void on_signal(int signum)
 {
-    const struct action_seq* sigact;
+    const int err = errno;
 
+    // the event queue can't be used here as its overflow list is allocated
+    // and locked, so actions are applied by the queue handler
     switch (signum) {
         case SIGUSR1:
-            sigact = &ctx.sigusr1;
+            __atomic_or_fetch(&ctx.signals, 1, __ATOMIC_RELEASE);
             break;
         case SIGUSR2:
-            sigact = &ctx.sigusr2;
+            __atomic_or_fetch(&ctx.signals, 2, __ATOMIC_RELEASE);
             break;
         default:
             return;
     }
+    notification_raise(ctx.event_signal);
 
-    for (size_t i = 0; i < sigact->num; ++i) {
-        const struct event event = {
-            .type = event_action,
-            .param.action = &sigact->sequence[i],
-        };
-        append_event(&event);
-    }
+    errno = err;
 }
 
 /**
@@ -253,9 +627,17 @@ static struct image* load_first_file(size_t index, bool force)
 
     while (index != IMGLIST_INVALID) {
         status = loader_from_index(index, &img);
-        if (force || status == ldr_success) {
+        if (status == ldr_success) {
             break;
         }
+        if (force) {
+            // other files of the directory may still be being scanned
+            if (!image_list_scan_wait() || !image_list_merge()) {
+                break;
+            }
+            index = image_list_remap(index);
+            force = false;
+        }
         index = image_list_skip(index);
     }
 
@@ -376,9 +758,43 @@ bool app_init(const struct config* cfg, const char** sources, size_t num)
     bool force_load = false;
     struct image* first_image;
     struct sigaction sigact;
+    size_t mib;
 
     load_config(cfg);
 
+    // start worker threads, they are used by image loaders and scalers
+    tpool_init(0);
+
+    // font is loaded in background while the first image is decoded
+    font_init(cfg);
+
+    // persistent cache of decoded images
+    mib = config_get_num(cfg, CFG_GENERAL, CFG_GNRL_DCACHE, 0, 1024 * 1024);
+    dcache_init(mib * 1024 * 1024);
+
+    // cache of exec:// command output
+    mib = config_get_num(cfg, CFG_GENERAL, CFG_GNRL_ECACHE, 0, 1024 * 1024);
+    execcache_init(mib * 1024 * 1024,
+                   config_get_num(cfg, CFG_GENERAL, CFG_GNRL_ECACHE_TM, 0,
+                                  INT_MAX));
+
+    // create event queue notification, it is used by background threads
+    ctx.event_signal = notification_create();
+    if (ctx.event_signal != -1) {
+        app_watch(ctx.event_signal, POLLIN, handle_event_queue, NULL);
+    } else {
+        perror("Unable to create eventfd");
+        return false;
+    }
+    pthread_mutex_init(&ctx.overflow_lock, NULL);
+    event_ring_init(&ctx.events);
+    perf_startup("init");
+
+    // query Sway while the image list is composed and the first image loaded
+    if (ctx.window.width != SIZE_FULLSCREEN) {
+        sway_query_start();
+    }
+
     // compose image list
     if (num == 0) {
         // no input files specified, use all from the current directory
@@ -394,8 +810,13 @@ bool app_init(const struct config* cfg, const char** sources, size_t num)
         }
     }
     image_list_init(cfg);
-    for (size_t i = 0; i < num; ++i) {
-        image_list_add(sources[i]);
+    if (num == 1) {
+        // open the file without waiting for the directory scan
+        image_list_add_async(sources[0], on_list_found);
+    } else {
+        for (size_t i = 0; i < num; ++i) {
+            image_list_add(sources[i]);
+        }
     }
     if (image_list_size() == 0) {
         if (force_load) {
@@ -407,24 +828,43 @@ bool app_init(const struct config* cfg, const char** sources, size_t num)
     }
     image_list_reorder();
 
+    // watch directories for new and removed files
+    if (image_list_watch_fd() != -1) {
+        ctx.list_timer =
+            timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        if (ctx.list_timer != -1) {
+            app_watch(image_list_watch_fd(), POLLIN, on_list_changed, NULL);
+            app_watch(ctx.list_timer, POLLIN, on_list_timer, NULL);
+        }
+    }
+
+    // receive sources from other instances
+    if (config_get_bool(cfg, CFG_GENERAL, CFG_GNRL_SINGLE)) {
+        const int fd = instance_listen();
+        if (fd != -1) {
+            app_watch(fd, POLLIN, on_instance, (void*)(intptr_t)fd);
+        }
+    }
+
+    perf_startup("image list");
+
     // load the first image
     first_image = load_first_file(image_list_find(sources[0]), force_load);
     if (!first_image) {
         return false;
     }
+    perf_startup("first image");
 
     // setup window position and size
-    if (ctx.window.width != SIZE_FULLSCREEN) {
-        sway_setup(cfg); // try Sway integration
-    }
+    sway_setup(cfg); // try Sway integration
+    perf_startup("sway");
     if (ctx.window.width == SIZE_FULLSCREEN) {
         ui_toggle_fullscreen();
     } else if (ctx.window.width == SIZE_FROM_IMAGE ||
                ctx.window.width == SIZE_FROM_PARENT) {
         // determine window size from the first image
-        const struct pixmap* pm = &first_image->frames[0].pm;
-        ctx.window.width = pm->width;
-        ctx.window.height = pm->height;
+        ctx.window.width = image_get_width(first_image);
+        ctx.window.height = image_get_height(first_image);
     }
 
     // connect to wayland
@@ -432,22 +872,23 @@ bool app_init(const struct config* cfg, const char** sources, size_t num)
                  ctx.wnd_decor)) {
         return false;
     }
-
-    // create event queue notification
-    ctx.event_signal = notification_create();
-    if (ctx.event_signal != -1) {
-        app_watch(ctx.event_signal, handle_event_queue, NULL);
-    } else {
-        perror("Unable to create eventfd");
-        return false;
-    }
-    pthread_mutex_init(&ctx.events_lock, NULL);
+    perf_startup("wayland");
 
     // initialize other subsystems
-    font_init(cfg);
     keybind_init(cfg);
     info_init(cfg);
-    loader_init();
+    mib = config_get_num(cfg, CFG_GENERAL, CFG_GNRL_MEMORY, 0, 1024 * 1024);
+    memcache_init(mib * 1024 * 1024);
+    if (config_get_bool(cfg, CFG_GENERAL, CFG_GNRL_MEM_PRESS)) {
+        const int fd = mempress_init();
+        if (fd != -1) {
+            // PSI trigger is always readable, events are signaled by POLLPRI
+            ctx.mem_pressure = fd;
+            app_watch(fd, POLLPRI, on_mem_pressure, NULL);
+        }
+    }
+    priority_init(cfg);
+    loader_init(config_get_num(cfg, CFG_GENERAL, CFG_GNRL_DECODERS, 0, 64));
     viewer_init(cfg, ctx.ehandler == viewer_handle ? first_image : NULL);
     gallery_init(cfg, ctx.ehandler == gallery_handle ? first_image : NULL);
 
@@ -464,71 +905,126 @@ bool app_init(const struct config* cfg, const char** sources, size_t num)
     sigaction(SIGUSR1, &sigact, NULL);
     sigaction(SIGUSR2, &sigact, NULL);
 
+    perf_startup("subsystems");
+
     return true;
 }
 
 void app_destroy(void)
 {
+    if (ctx.sway.started) {
+        sway_disconnect(sway_query_finish(false));
+    }
+
     loader_destroy();
     gallery_destroy();
     viewer_destroy();
+    memcache_destroy();
+    if (ctx.mem_pressure != -1) {
+        app_unwatch(ctx.mem_pressure);
+        ctx.mem_pressure = -1;
+    }
+    mempress_destroy();
     ui_destroy();
     image_list_destroy();
     info_destroy();
     keybind_destroy();
     font_destroy();
+    dcache_destroy();
+    execcache_destroy();
+    instance_destroy();
+    worker_destroy();
+    tpool_destroy();
 
     for (size_t i = 0; i < ctx.wfds_num; ++i) {
         close(ctx.wfds[i].fd);
     }
     free(ctx.wfds);
 
-    list_for_each(ctx.events, struct event_queue, it) {
+    event_ring_remove(&ctx.events, event_load, free_load);
+    list_for_each(ctx.overflow, struct event_queue, it) {
         if (it->event.type == event_load) {
-            image_free(it->event.param.load.image);
+            free_load(&it->event);
         }
         free(it);
     }
     if (ctx.event_signal != -1) {
         notification_free(ctx.event_signal);
     }
-    pthread_mutex_destroy(&ctx.events_lock);
+    pthread_mutex_destroy(&ctx.overflow_lock);
 
     action_free(&ctx.sigusr1);
     action_free(&ctx.sigusr2);
 }
 
-void app_watch(int fd, fd_callback cb, void* data)
+void app_watch(int fd, short events, fd_callback cb, void* data)
 {
     const size_t sz = (ctx.wfds_num + 1) * sizeof(*ctx.wfds);
     struct watchfd* handlers = realloc(ctx.wfds, sz);
     if (handlers) {
         ctx.wfds = handlers;
         ctx.wfds[ctx.wfds_num].fd = fd;
+        ctx.wfds[ctx.wfds_num].events = events;
         ctx.wfds[ctx.wfds_num].data = data;
         ctx.wfds[ctx.wfds_num].callback = cb;
         ++ctx.wfds_num;
+        ctx.wfds_changed = true;
     }
 }
 
-bool app_run(void)
+void app_unwatch(int fd)
+{
+    for (size_t i = 0; i < ctx.wfds_num; ++i) {
+        if (ctx.wfds[i].fd == fd) {
+            --ctx.wfds_num;
+            memmove(&ctx.wfds[i], &ctx.wfds[i + 1],
+                    (ctx.wfds_num - i) * sizeof(*ctx.wfds));
+            ctx.wfds_changed = true;
+            break;
+        }
+    }
+}
+
+/**
+ * Fill poll descriptors from the list of watched descriptors.
+ * @param fds pointer to the poll descriptors array, reallocated
+ * @return false if not enough memory
+ */
+static bool update_pollfd(struct pollfd** fds)
 {
-    struct pollfd* fds;
+    struct pollfd* ptr;
 
-    // file descriptors to poll
-    fds = calloc(1, ctx.wfds_num * sizeof(struct pollfd));
-    if (!fds) {
-        perror("Failed to allocate memory");
+    ptr = realloc(*fds, (ctx.wfds_num + 1) * sizeof(*ptr));
+    if (!ptr) {
         return false;
     }
+    *fds = ptr;
+
     for (size_t i = 0; i < ctx.wfds_num; ++i) {
-        fds[i].fd = ctx.wfds[i].fd;
-        fds[i].events = POLLIN;
+        const struct watchfd* wfd = &ctx.wfds[i];
+        // negative descriptors are ignored by poll
+        ptr[i].fd = wfd->events ? wfd->fd : -1;
+        ptr[i].events = wfd->events;
+        ptr[i].revents = 0;
     }
+    ctx.wfds_changed = false;
+
+    return true;
+}
+
+bool app_run(void)
+{
+    struct pollfd* fds = NULL;
 
     // main event loop
     ctx.state = loop_run;
     while (ctx.state == loop_run) {
+        if (ctx.wfds_changed && !update_pollfd(&fds)) {
+            perror("Failed to allocate memory");
+            ctx.state = loop_error;
+            break;
+        }
+
         ui_event_prepare();
 
         // poll events
@@ -540,9 +1036,19 @@ bool app_run(void)
             }
         }
 
-        // call handlers for each active event
-        for (size_t i = 0; ctx.state == loop_run && i < ctx.wfds_num; ++i) {
-            if (fds[i].revents & POLLIN) {
+        // call handlers for each active event, the rest of events are
+        // handled on the next iteration if the watch list was changed
+        for (size_t i = 0;
+             ctx.state == loop_run && !ctx.wfds_changed && i < ctx.wfds_num;
+             ++i) {
+            const short revents = fds[i].revents;
+            const short events = fds[i].events;
+            if ((revents & POLLNVAL) ||
+                ((revents & (POLLERR | POLLHUP)) && !(events & POLLIN))) {
+                // there is nothing to read to handle the error
+                ctx.wfds[i].events = 0;
+                ctx.wfds_changed = true;
+            } else if (revents & (events | POLLERR | POLLHUP)) {
                 ctx.wfds[i].callback(ctx.wfds[i].data);
             }
         }
@@ -603,28 +1109,33 @@ void app_reload(void)
     append_event(&event);
 }
 
+/**
+ * Request redraw, it is handled after the queued events.
+ */
+static void queue_redraw(void)
+{
+    // all requests are merged into a single one
+    if (!__atomic_exchange_n(&ctx.redraw, true, __ATOMIC_ACQ_REL)) {
+        notification_raise(ctx.event_signal);
+    }
+}
+
 void app_redraw(void)
 {
-    const struct event event = {
-        .type = event_redraw,
-    };
+    ui_damage_all();
+    queue_redraw();
+}
 
-    // remove the same event to append new one to tail
-    pthread_mutex_lock(&ctx.events_lock);
-    list_for_each(ctx.events, struct event_queue, it) {
-        if (it->event.type == event_redraw) {
-            if (list_is_last(it)) {
-                pthread_mutex_unlock(&ctx.events_lock);
-                return;
-            }
-            ctx.events = list_remove(it);
-            free(it);
-            break;
-        }
-    }
-    pthread_mutex_unlock(&ctx.events_lock);
+void app_redraw_area(ssize_t x, ssize_t y, size_t width, size_t height)
+{
+    ui_damage(x, y, width, height);
+    queue_redraw();
+}
 
-    append_event(&event);
+void app_redraw_overlay(ssize_t x, ssize_t y, size_t width, size_t height)
+{
+    ui_damage_overlay(x, y, width, height);
+    queue_redraw();
 }
 
 void app_on_resize(void)
@@ -659,23 +1170,10 @@ void app_on_keyboard(xkb_keysym_t key, uint8_t mods)
 
 void app_on_drag(int dx, int dy)
 {
-    const struct event event = { .type = event_drag,
-                                 .param.drag.dx = dx,
-                                 .param.drag.dy = dy };
-
-    // merge with existing event
-    pthread_mutex_lock(&ctx.events_lock);
-    list_for_each(ctx.events, struct event_queue, it) {
-        if (it->event.type == event_drag) {
-            it->event.param.drag.dx += dx;
-            it->event.param.drag.dy += dy;
-            pthread_mutex_unlock(&ctx.events_lock);
-            return;
-        }
-    }
-    pthread_mutex_unlock(&ctx.events_lock);
-
-    append_event(&event);
+    // merge with pending drag
+    __atomic_add_fetch(&ctx.drag.dx, dx, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&ctx.drag.dy, dy, __ATOMIC_RELAXED);
+    notification_raise(ctx.event_signal);
 }
 
 void app_on_load(struct image* image, size_t index)
@@ -688,6 +1186,29 @@ void app_on_load(struct image* image, size_t index)
     append_event(&event);
 }
 
+void app_on_update(size_t generation)
+{
+    const struct event event = {
+        .type = event_update,
+        .param.update.generation = generation,
+    };
+    append_event(&event);
+}
+
+void app_on_progress(const struct image* image, size_t rows)
+{
+    const struct event event = {
+        .type = event_progress,
+        .param.progress.image = image,
+        .param.progress.rows = rows,
+    };
+
+    if (ctx.state == loop_run) {
+        ctx.ehandler(&event);
+        ui_event_pump();
+    }
+}
+
 void app_execute(const char* expr, const char* path)
 {
     int rc;
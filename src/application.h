@@ -7,6 +7,8 @@
 #include "image.h"
 #include "keybind.h"
 
+#include <poll.h>
+
 /**
  * Handler of the fd poll events.
  * @param data user data
@@ -28,12 +30,22 @@ bool app_init(const struct config* cfg, const char** sources, size_t num);
 void app_destroy(void);
 
 /**
- * Add file descriptor for polling in main loop.
+ * Add file descriptor for polling in main loop, the descriptor is closed
+ * on exit.
+ * The callback is also called on errors and hangups if the descriptor is
+ * polled for input, otherwise such a descriptor is not polled anymore.
  * @param fd file descriptor for polling
+ * @param events poll events to wait for (POLLIN, POLLPRI)
  * @param cb callback function
  * @param data user defined data to pass to callback
  */
-void app_watch(int fd, fd_callback cb, void* data);
+void app_watch(int fd, short events, fd_callback cb, void* data);
+
+/**
+ * Remove file descriptor from polling, the descriptor is not closed.
+ * @param fd file descriptor passed to `app_watch`
+ */
+void app_unwatch(int fd);
 
 /**
  * Run application.
@@ -69,6 +81,18 @@ void app_reload(void);
  */
 void app_redraw(void);
 
+/**
+ * Redraw part of the window.
+ * @param x,y,width,height changed region in window coordinates
+ */
+void app_redraw_area(ssize_t x, ssize_t y, size_t width, size_t height);
+
+/**
+ * Redraw part of the text overlay.
+ * @param x,y,width,height changed region in window coordinates
+ */
+void app_redraw_overlay(ssize_t x, ssize_t y, size_t width, size_t height);
+
 /**
  * Handler of external event: window resized.
  */
@@ -94,6 +118,22 @@ void app_on_drag(int dx, int dy);
  */
 void app_on_load(struct image* image, size_t index);
 
+/**
+ * Handler of background preparation of the image data (tiles, mipmaps),
+ * can be called from any thread.
+ * @param generation generation of the updated image instance
+ */
+void app_on_update(size_t generation);
+
+/**
+ * Handler of image decoding progress (main thread loader).
+ * The event is passed to the current mode immediately, bypassing the queue,
+ * because the main loop is blocked until the image is loaded.
+ * @param image image being decoded
+ * @param rows number of top rows of the first frame decoded so far
+ */
+void app_on_progress(const struct image* image, size_t rows);
+
 /**
  * Execute system command for the specified image.
  * @param expr command expression
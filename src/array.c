@@ -6,10 +6,17 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <wchar.h>
 
+// Initial size of the buffer used to read data from file descriptor
+#define READ_BUFFER_SIZE (64 * 1024)
+
 char* str_dup(const char* src, char** dst)
 {
     const size_t sz = strlen(src) + 1;
@@ -168,3 +175,109 @@ ssize_t str_search_index(const char** array, size_t array_sz, const char* value,
     }
     return -1;
 }
+
+int fd_read_all(int fd, uint8_t** data, size_t* size)
+{
+    uint8_t* buf = NULL;
+    size_t capacity = 0;
+    size_t len = 0;
+    int rc = 0;
+
+    while (true) {
+        ssize_t rd;
+
+        // grow buffer geometrically to keep the total cost of copying linear,
+        // large blocks are moved by realloc without copying (mremap)
+        if (len + 1 >= capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : READ_BUFFER_SIZE;
+            int avail = 0;
+            uint8_t* new_buf;
+
+            // reserve space for all data available in the pipe
+            if (ioctl(fd, FIONREAD, &avail) == 0 &&
+                len + avail + 1 > new_capacity) {
+                new_capacity = len + avail + 1;
+            }
+
+            new_buf = realloc(buf, new_capacity);
+            if (!new_buf) {
+                rc = ENOMEM;
+                break;
+            }
+            buf = new_buf;
+            capacity = new_capacity;
+        }
+
+        // read directly into the buffer, keep space for the last null
+        rd = read(fd, buf + len, capacity - len - 1);
+        if (rd == 0) {
+            break;
+        }
+        if (rd == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                // non-blocking descriptor, wait for data
+                struct pollfd pfd = { .fd = fd, .events = POLLIN };
+                poll(&pfd, 1, -1);
+                continue;
+            }
+            rc = errno;
+            break;
+        }
+        len += rd;
+    }
+
+    if (rc || len == 0) {
+        free(buf);
+        buf = NULL;
+        len = 0;
+    } else {
+        buf[len] = 0;
+    }
+
+    *data = buf;
+    *size = len;
+
+    return rc;
+}
+
+uint64_t fnv1a(uint64_t hash, const void* data, size_t size)
+{
+    const uint8_t* ptr = data;
+
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= ptr[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+bool make_dirs(const char* path)
+{
+    char* dir = NULL;
+    char* delim;
+    bool rc = true;
+
+    if (!str_dup(path, &dir)) {
+        return false;
+    }
+
+    delim = dir;
+    while (rc && delim) {
+        delim = strchr(delim + 1, '/');
+        if (delim) {
+            *delim = '\0';
+        }
+        rc = (mkdir(dir, S_IRWXU) == 0 || errno == EEXIST);
+        if (delim) {
+            *delim = '/';
+        }
+    }
+
+    free(dir);
+
+    return rc;
+}
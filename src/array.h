@@ -6,6 +6,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 #ifndef ARRAY_SIZE
@@ -74,3 +75,32 @@ size_t str_split(const char* text, char delimeter, struct str_slice* slices,
 ssize_t str_search_index(const char** array, size_t array_sz, const char* value,
                          size_t value_len);
 #define str_index(a, v, s) str_search_index((a), ARRAY_SIZE(a), v, s)
+
+/**
+ * Read all data from file descriptor (pipe, stdin, etc) until EOF.
+ * The buffer is null-terminated, the last null is not counted in the size.
+ * @param fd file descriptor to read
+ * @param data pointer to output buffer, caller must free it, NULL if no data
+ * @param size pointer to output size of the data in bytes
+ * @return 0 on success or error code
+ */
+int fd_read_all(int fd, uint8_t** data, size_t* size);
+
+/** Initial value of the FNV-1a hash. */
+#define FNV1A_INIT 0xcbf29ce484222325ULL
+
+/**
+ * Update FNV-1a hash with data.
+ * @param hash current hash value (`FNV1A_INIT` for the first chunk)
+ * @param data pointer to the data to hash
+ * @param size size of the data in bytes
+ * @return new hash value
+ */
+uint64_t fnv1a(uint64_t hash, const void* data, size_t size);
+
+/**
+ * Create directory and all its parents (`mkdir -p`).
+ * @param path absolute path to the directory
+ * @return false if directory can't be created
+ */
+bool make_dirs(const char* path);
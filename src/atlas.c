@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: MIT
+// Slab allocator of equal sized pixel blocks.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "atlas.h"
+
+#include "list.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Preferred size of the slab in bytes
+#define SLAB_SIZE (4 * 1024 * 1024)
+// Max number of slots per slab (bits in the mask)
+#define SLAB_SLOTS 64
+
+/** Slab: block of memory split into slots. */
+struct atlas_slab {
+    struct list list; ///< Links to prev/next slab
+    uint64_t mask;    ///< Bit mask of used slots
+    argb_t* data;     ///< Slots data
+};
+
+void atlas_init(struct atlas* atlas, size_t size)
+{
+    const size_t slots = SLAB_SIZE / (size * sizeof(argb_t));
+
+    atlas->slabs = NULL;
+    atlas->slot_size = size;
+    atlas->slots = max(1, min(SLAB_SLOTS, slots));
+    atlas->used = 0;
+}
+
+void atlas_free(struct atlas* atlas)
+{
+    list_for_each(atlas->slabs, struct atlas_slab, it) {
+        free(it);
+    }
+    atlas->slabs = NULL;
+    atlas->used = 0;
+}
+
+argb_t* atlas_alloc(struct atlas* atlas)
+{
+    const uint64_t full =
+        atlas->slots == SLAB_SLOTS ? UINT64_MAX : (1ULL << atlas->slots) - 1;
+    struct atlas_slab* slab = NULL;
+    size_t slot = 0;
+
+    list_for_each(atlas->slabs, struct atlas_slab, it) {
+        if (it->mask != full) {
+            slab = it;
+            break;
+        }
+    }
+
+    if (!slab) {
+        // slab header and its slots are allocated as a single block
+        const size_t slots_sz = atlas->slots * atlas->slot_size;
+        slab = malloc(sizeof(*slab) + slots_sz * sizeof(argb_t));
+        if (!slab) {
+            return NULL;
+        }
+        slab->mask = 0;
+        slab->data = (argb_t*)(slab + 1);
+        atlas->slabs = list_add(atlas->slabs, slab);
+    }
+
+    while (slab->mask & (1ULL << slot)) {
+        ++slot;
+    }
+    slab->mask |= 1ULL << slot;
+    ++atlas->used;
+
+    return slab->data + slot * atlas->slot_size;
+}
+
+bool atlas_release(struct atlas* atlas, argb_t* slot)
+{
+    const size_t slab_sz = atlas->slots * atlas->slot_size;
+
+    list_for_each(atlas->slabs, struct atlas_slab, it) {
+        if (slot >= it->data && slot < it->data + slab_sz) {
+            const size_t idx = (slot - it->data) / atlas->slot_size;
+            it->mask &= ~(1ULL << idx);
+            --atlas->used;
+            if (!it->mask) {
+                atlas->slabs = list_unlink(atlas->slabs, it);
+                free(it);
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
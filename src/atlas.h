@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: MIT
+// Slab allocator of equal sized pixel blocks.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include "pixmap.h"
+
+struct atlas_slab;
+
+/** Atlas: set of slabs split into slots, zero initialized instance is empty. */
+struct atlas {
+    struct atlas_slab* slabs; ///< List of slabs
+    size_t slot_size;         ///< Size of a single slot in pixels
+    size_t slots;             ///< Number of slots per slab
+    size_t used;              ///< Number of used slots
+};
+
+/**
+ * Initialize atlas.
+ * @param atlas atlas instance
+ * @param size size of a single slot in pixels
+ */
+void atlas_init(struct atlas* atlas, size_t size);
+
+/**
+ * Free all slabs of the atlas.
+ * @param atlas atlas instance
+ */
+void atlas_free(struct atlas* atlas);
+
+/**
+ * Allocate slot.
+ * @param atlas atlas instance
+ * @return pointer to the slot or NULL if not enough memory
+ */
+argb_t* atlas_alloc(struct atlas* atlas);
+
+/**
+ * Release slot, the slab is freed when all its slots are released.
+ * @param atlas atlas instance
+ * @param slot pointer to the slot allocated by `atlas_alloc`
+ * @return false if the pointer doesn't belong to the atlas
+ */
+bool atlas_release(struct atlas* atlas, argb_t* slot);
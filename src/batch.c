@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: MIT
+// Headless batch processing: generate thumbnails without UI.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "batch.h"
+
+#include "imagelist.h"
+#include "loader.h"
+#include "perf.h"
+#include "thumbnail.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Max number of worker threads
+#define MAX_WORKERS 64
+
+/** Batch processing context. */
+struct batch_context {
+    size_t size;    ///< Size of thumbnails, used as decoder hint
+    size_t total;   ///< Total number of images in the list
+    size_t next;    ///< Next image index to process
+    size_t created; ///< Number of created thumbnails
+    size_t cached;  ///< Number of thumbnails that are up to date
+    size_t failed;  ///< Number of images failed to load
+    bool cancel;    ///< Cancellation flag for decoders (never set)
+};
+
+/** Global batch context. */
+static struct batch_context ctx;
+
+/**
+ * Get number of worker threads.
+ * @param cfg config instance
+ * @return number of threads
+ */
+static size_t get_workers(const struct config* cfg)
+{
+    size_t workers =
+        config_get_num(cfg, CFG_GENERAL, CFG_GNRL_DECODERS, 0, MAX_WORKERS);
+
+    if (workers == 0) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? min(cpus, MAX_WORKERS) : 1;
+    }
+
+    return workers;
+}
+
+/** Thumbnail generator executed in worker threads. */
+static void* worker_thread(__attribute__((unused)) void* data)
+{
+    size_t index;
+
+    while ((index = __atomic_fetch_add(&ctx.next, 1, __ATOMIC_RELAXED)) <
+           ctx.total) {
+        const char* source = image_list_get(index);
+        struct image* image;
+
+        // the actual thumbnail is already in the persistent storage
+        if (thumbnail_stored(source)) {
+            __atomic_add_fetch(&ctx.cached, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        // shared thumbnail is put to the persistent storage on loading
+        image = thumbnail_load(source);
+        if (image) {
+            __atomic_add_fetch(&ctx.created, 1, __ATOMIC_RELAXED);
+            image_free(image);
+            continue;
+        }
+
+        if (loader_decode_source(source, ctx.size, &ctx.cancel, &image) ==
+            ldr_success) {
+            image->index = index;
+            thumbnail_prepare(image); // saves thumbnail to the pstore
+            __atomic_add_fetch(&ctx.created, 1, __ATOMIC_RELAXED);
+            image_free(image);
+        } else {
+            fprintf(stderr, "%s: Unable to load image\n", source);
+            __atomic_add_fetch(&ctx.failed, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    return NULL;
+}
+
+bool batch_thumbnails(const struct config* cfg, const char** sources,
+                      size_t num)
+{
+    const size_t workers = get_workers(cfg);
+    pthread_t threads[MAX_WORKERS];
+    size_t started = 0;
+    uint64_t start;
+    double elapsed;
+
+    // compose image list
+    image_list_init(cfg);
+    if (num == 0) {
+        image_list_add(".");
+    } else {
+        for (size_t i = 0; i < num; ++i) {
+            image_list_add(sources[i]);
+        }
+    }
+    ctx.total = image_list_size();
+    if (ctx.total == 0) {
+        fprintf(stderr, "No image files found, exit\n");
+        image_list_destroy();
+        return false;
+    }
+
+    thumbnail_init(cfg);
+    ctx.size = config_get_num(cfg, CFG_GALLERY, CFG_GLRY_SIZE, 1, 1024);
+
+    start = perf_now();
+    for (size_t i = 0; i < workers; ++i) {
+        if (pthread_create(&threads[i], NULL, worker_thread, NULL) != 0) {
+            break;
+        }
+        ++started;
+    }
+    if (started == 0) {
+        worker_thread(NULL);
+    }
+    for (size_t i = 0; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    elapsed = (double)(perf_now() - start) / 1000000;
+
+    printf("Processed %zu images in %.2f sec (%.1f images/sec, %zu threads)\n",
+           ctx.total, elapsed, elapsed > 0 ? ctx.total / elapsed : 0.0,
+           max(started, 1));
+    printf("Thumbnails created: %zu, up to date: %zu, failed: %zu\n",
+           ctx.created, ctx.cached, ctx.failed);
+
+    thumbnail_free();
+    image_list_destroy();
+
+    return true;
+}
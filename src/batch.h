@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: MIT
+// Headless batch processing: generate thumbnails without UI.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include "config.h"
+
+/**
+ * Generate thumbnails of all images and put them to the persistent storage,
+ * images are processed in parallel by all decoder threads.
+ * Statistics (number of images, throughput) are printed to stdout.
+ * @param cfg config instance
+ * @param sources list of files/directories to process
+ * @param num number of sources, 0 to use the current directory
+ * @return false if no images were found
+ */
+bool batch_thumbnails(const struct config* cfg, const char** sources,
+                      size_t num);
@@ -29,6 +29,15 @@ static const struct config_default defaults[] = {
     { CFG_GENERAL,      CFG_GNRL_SIGUSR1,   "reload"                 },
     { CFG_GENERAL,      CFG_GNRL_SIGUSR2,   "next_file"              },
     { CFG_GENERAL,      CFG_GNRL_APP_ID,    "swayimg"                },
+    { CFG_GENERAL,      CFG_GNRL_DECODERS,  "0"                      },
+    { CFG_GENERAL,      CFG_GNRL_MEMORY,    "0"                      },
+    { CFG_GENERAL,      CFG_GNRL_MEM_PRESS, CFG_YES                  },
+    { CFG_GENERAL,      CFG_GNRL_DCACHE,    "0"                      },
+    { CFG_GENERAL,      CFG_GNRL_ECACHE,    "0"                      },
+    { CFG_GENERAL,      CFG_GNRL_ECACHE_TM, "300"                    },
+    { CFG_GENERAL,      CFG_GNRL_SINGLE,    CFG_NO                   },
+    { CFG_GENERAL,      CFG_GNRL_BKG_PRIO,  "low"                    },
+    { CFG_GENERAL,      CFG_GNRL_BKG_CPUS,  "all"                    },
 
     { CFG_VIEWER,       CFG_VIEW_WINDOW,    "#00000000"              },
     { CFG_VIEWER,       CFG_VIEW_TRANSP,    "grid"                   },
@@ -37,14 +46,25 @@ static const struct config_default defaults[] = {
     { CFG_VIEWER,       CFG_VIEW_POSITION,  "center"                 },
     { CFG_VIEWER,       CFG_VIEW_FIXED,     CFG_YES                  },
     { CFG_VIEWER,       CFG_VIEW_AA,        "mks13"                  },
+    { CFG_VIEWER,       CFG_VIEW_AA_FAST,   "box"                    },
     { CFG_VIEWER,       CFG_VIEW_SSHOW,     CFG_NO                   },
     { CFG_VIEWER,       CFG_VIEW_SSHOW_TM,  "3"                      },
     { CFG_VIEWER,       CFG_VIEW_HISTORY,   "1"                      },
+    { CFG_VIEWER,       CFG_VIEW_HISTORY_M, "0"                      },
+    { CFG_VIEWER,       CFG_VIEW_HISTORY_Z, "0"                      },
     { CFG_VIEWER,       CFG_VIEW_PRELOAD,   "1"                      },
+    { CFG_VIEWER,       CFG_VIEW_PREFETCH,  "4"                      },
+    { CFG_VIEWER,       CFG_VIEW_MIPMAP,    CFG_YES                  },
+    { CFG_VIEWER,       CFG_VIEW_MIPMAP_LM, "256"                    },
+    { CFG_VIEWER,       CFG_VIEW_ANIM_MEM,  "256"                    },
+    { CFG_VIEWER,       CFG_VIEW_LAYER,     CFG_NO                   },
+    { CFG_VIEWER,       CFG_VIEW_GPU,       CFG_NO                   },
 
     { CFG_GALLERY,      CFG_GLRY_SIZE,      "200"                    },
     { CFG_GALLERY,      CFG_GLRY_CACHE,     "100"                    },
     { CFG_GALLERY,      CFG_GLRY_PSTORE,    CFG_NO                   },
+    { CFG_GALLERY,      CFG_GLRY_PSTORE_LM, "1024"                   },
+    { CFG_GALLERY,      CFG_GLRY_SHARED,    CFG_NO                   },
     { CFG_GALLERY,      CFG_GLRY_FILL,      CFG_YES                  },
     { CFG_GALLERY,      CFG_GLRY_AA,        "mks13"                  },
     { CFG_GALLERY,      CFG_GLRY_WINDOW,    "#00000000"              },
@@ -58,6 +78,8 @@ static const struct config_default defaults[] = {
     { CFG_LIST,         CFG_LIST_LOOP,      CFG_YES                  },
     { CFG_LIST,         CFG_LIST_RECURSIVE, CFG_NO                   },
     { CFG_LIST,         CFG_LIST_ALL,       CFG_NO                   },
+    { CFG_LIST,         CFG_LIST_INDEX,     CFG_NO                   },
+    { CFG_LIST,         CFG_LIST_WATCH,     CFG_NO                   },
 
     { CFG_FONT,         CFG_FONT_NAME,      "monospace"              },
     { CFG_FONT,         CFG_FONT_SIZE,      "14"                     },
@@ -119,6 +141,7 @@ static const struct config_default defaults[] = {
     { CFG_KEYS_VIEWER,  "Shift+a",          "antialiasing prev"      },
     { CFG_KEYS_VIEWER,  "r",                "reload"                 },
     { CFG_KEYS_VIEWER,  "i",                "info"                   },
+    { CFG_KEYS_VIEWER,  "Shift+i",          "perf"                   },
     { CFG_KEYS_VIEWER,  "Shift+Delete",     RM_FILE_ACTION           },
     { CFG_KEYS_VIEWER,  "Escape",           "exit"                   },
     { CFG_KEYS_VIEWER,  "q",                "exit"                   },
@@ -149,6 +172,7 @@ static const struct config_default defaults[] = {
     { CFG_KEYS_GALLERY, "Shift+a",          "antialiasing prev"      },
     { CFG_KEYS_GALLERY, "r",                "reload"                 },
     { CFG_KEYS_GALLERY, "i",                "info"                   },
+    { CFG_KEYS_GALLERY, "Shift+i",          "perf"                   },
     { CFG_KEYS_GALLERY, "Shift+Delete",     RM_FILE_ACTION           },
     { CFG_KEYS_GALLERY, "Escape",           "exit"                   },
     { CFG_KEYS_GALLERY, "q",                "exit"                   },
@@ -41,6 +41,15 @@ struct config {
 #define CFG_GNRL_SIGUSR1   "sigusr1"
 #define CFG_GNRL_SIGUSR2   "sigusr2"
 #define CFG_GNRL_APP_ID    "app_id"
+#define CFG_GNRL_DECODERS  "decoders"
+#define CFG_GNRL_MEMORY    "memory_limit"
+#define CFG_GNRL_MEM_PRESS "memory_pressure"
+#define CFG_GNRL_DCACHE    "decoded_cache"
+#define CFG_GNRL_ECACHE    "exec_cache"
+#define CFG_GNRL_ECACHE_TM "exec_cache_ttl"
+#define CFG_GNRL_SINGLE    "single_instance"
+#define CFG_GNRL_BKG_PRIO  "background_priority"
+#define CFG_GNRL_BKG_CPUS  "background_cpus"
 #define CFG_VIEW_WINDOW    "window"
 #define CFG_VIEW_TRANSP    "transparency"
 #define CFG_VIEW_SCALE     "scale"
@@ -48,13 +57,24 @@ struct config {
 #define CFG_VIEW_POSITION  "position"
 #define CFG_VIEW_FIXED     "fixed"
 #define CFG_VIEW_AA        "antialiasing"
+#define CFG_VIEW_AA_FAST   "interactive_antialiasing"
 #define CFG_VIEW_SSHOW     "slideshow"
 #define CFG_VIEW_SSHOW_TM  "slideshow_time"
 #define CFG_VIEW_HISTORY   "history"
+#define CFG_VIEW_HISTORY_M "history_memory"
+#define CFG_VIEW_HISTORY_Z "history_compressed"
 #define CFG_VIEW_PRELOAD   "preload"
+#define CFG_VIEW_PREFETCH  "prefetch"
+#define CFG_VIEW_MIPMAP    "mipmap"
+#define CFG_VIEW_MIPMAP_LM "mipmap_limit"
+#define CFG_VIEW_ANIM_MEM  "animation_cache"
+#define CFG_VIEW_LAYER     "compositor_scale"
+#define CFG_VIEW_GPU       "gpu"
 #define CFG_GLRY_SIZE      "size"
 #define CFG_GLRY_CACHE     "cache"
 #define CFG_GLRY_PSTORE    "pstore"
+#define CFG_GLRY_PSTORE_LM "pstore_limit"
+#define CFG_GLRY_SHARED    "shared"
 #define CFG_GLRY_FILL      "fill"
 #define CFG_GLRY_AA        "antialiasing"
 #define CFG_GLRY_WINDOW    "window"
@@ -67,6 +87,8 @@ struct config {
 #define CFG_LIST_LOOP      "loop"
 #define CFG_LIST_RECURSIVE "recursive"
 #define CFG_LIST_ALL       "all"
+#define CFG_LIST_INDEX     "index"
+#define CFG_LIST_WATCH     "watch"
 #define CFG_FONT_NAME      "name"
 #define CFG_FONT_SIZE      "size"
 #define CFG_FONT_COLOR     "color"
@@ -0,0 +1,519 @@
+// SPDX-License-Identifier: MIT
+// Persistent cache of decoded images.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "dcache.h"
+
+#include "array.h"
+#include "config.h"
+#include "list.h"
+#include "loader.h"
+#include "priority.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Min decoding time of images to store in the cache (ms)
+#define SLOW_DECODE 300
+
+// Max size of pixel data waiting to be written
+#define MAX_QUEUED (256 * 1024 * 1024)
+
+// Cache file signature and format version
+static const uint8_t signature[] = { 's', 'w', 'd', 'c' };
+#define VERSION 1
+
+// Cache file name extension
+#define FILE_EXT ".raw"
+
+/**
+ * Cache file footer. The file contains raw pixel data at the beginning, so
+ * it can be mapped directly, then meta data (null-terminated strings:
+ * source path, format description and pairs of meta info key/value), and
+ * the footer at the end.
+ */
+struct dcache_footer {
+    uint64_t src_size;   ///< Size of the source file
+    int64_t src_sec;     ///< Modification time of the source file
+    int64_t src_nsec;    ///< Modification time of the source file (ns)
+    uint64_t meta_size;  ///< Size of meta data
+    uint32_t width;      ///< Image width
+    uint32_t height;     ///< Image height
+    uint32_t orient;     ///< Image orientation
+    uint8_t alpha;       ///< Alpha channel flag
+    uint8_t version;     ///< File format version
+    uint8_t magic[4];    ///< Signature
+    uint8_t reserved[2]; ///< Padding
+};
+
+/** Cache file description used for trimming. */
+struct dcache_file {
+    char* name;   ///< File name
+    size_t size;  ///< File size
+    time_t mtime; ///< Last use time
+};
+
+/** Image queued for writing. */
+struct dcache_job {
+    struct list list;            ///< Links to prev/next entry
+    char* source;                ///< Path to the original image file
+    struct dcache_footer footer; ///< Footer of the cache file
+    char* meta;                  ///< Packed meta data
+    argb_t* pixels;              ///< Copy of pixel data
+};
+
+/** Persistent cache context. */
+struct dcache {
+    size_t limit;            ///< Max size of the cache
+    char* dir;               ///< Path to the cache directory
+    pthread_t tid;           ///< Writer thread
+    bool stop;               ///< Flag to stop writer thread
+    bool busy;               ///< Writer thread is saving an image
+    struct dcache_job* jobs; ///< Queue of images to write
+    size_t queued;           ///< Size of queued pixel data
+    pthread_mutex_t lock;    ///< Queue lock
+    pthread_cond_t signal;   ///< Queue state notification
+};
+
+/** Global persistent cache context. */
+static struct dcache ctx;
+
+/**
+ * Get path to the cache file.
+ * @param source path to the original image file
+ * @return path to the cache file, caller must free it
+ */
+static char* cache_path(const char* source)
+{
+    const uint64_t hash = fnv1a(FNV1A_INIT, source, strlen(source));
+    char name[32];
+    char* path = NULL;
+
+    snprintf(name, sizeof(name), "/%016llx" FILE_EXT,
+             (unsigned long long)hash);
+
+    str_dup(ctx.dir, &path);
+    str_append(name, 0, &path);
+
+    return path;
+}
+
+/**
+ * Write data to the file.
+ * @param fd file descriptor
+ * @param data data to write
+ * @param size size of the data
+ * @return true if all data was written
+ */
+static bool write_all(int fd, const void* data, size_t size)
+{
+    const uint8_t* ptr = data;
+
+    while (size) {
+        const ssize_t rc = write(fd, ptr, size);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        ptr += rc;
+        size -= rc;
+    }
+
+    return true;
+}
+
+/** Compare cache files by last use time, see `qsort`. */
+static int compare_files(const void* a, const void* b)
+{
+    const struct dcache_file* fa = a;
+    const struct dcache_file* fb = b;
+    return fa->mtime < fb->mtime ? -1 : fa->mtime > fb->mtime;
+}
+
+/**
+ * Remove the least recently used files to fit into the limit.
+ */
+static void trim(void)
+{
+    struct dcache_file* files = NULL;
+    size_t num = 0;
+    size_t total = 0;
+    struct dirent* de;
+    DIR* dir;
+
+    dir = opendir(ctx.dir);
+    if (!dir) {
+        return;
+    }
+
+    // collect cache files
+    while ((de = readdir(dir))) {
+        const size_t len = strlen(de->d_name);
+        struct dcache_file* ptr;
+        struct stat st;
+
+        if (len <= sizeof(FILE_EXT) - 1 ||
+            strcmp(de->d_name + len - (sizeof(FILE_EXT) - 1), FILE_EXT) ||
+            fstatat(dirfd(dir), de->d_name, &st, 0) == -1) {
+            continue;
+        }
+        ptr = realloc(files, (num + 1) * sizeof(*files));
+        if (!ptr) {
+            break;
+        }
+        files = ptr;
+        files[num].name = NULL;
+        files[num].size = st.st_size;
+        files[num].mtime = st.st_mtime;
+        str_dup(de->d_name, &files[num].name);
+        total += st.st_size;
+        ++num;
+    }
+
+    // remove the oldest files
+    if (total > ctx.limit) {
+        qsort(files, num, sizeof(*files), compare_files);
+        for (size_t i = 0; i < num && total > ctx.limit; ++i) {
+            if (files[i].name && unlinkat(dirfd(dir), files[i].name, 0) == 0) {
+                total -= files[i].size;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < num; ++i) {
+        free(files[i].name);
+    }
+    free(files);
+    closedir(dir);
+}
+
+/**
+ * Get size of pixel data of the queued image.
+ * @param job queued image
+ * @return size in bytes
+ */
+static size_t pixels_size(const struct dcache_job* job)
+{
+    return (size_t)job->footer.width * job->footer.height * sizeof(argb_t);
+}
+
+/**
+ * Free queued image.
+ * @param job queued image
+ */
+static void free_job(struct dcache_job* job)
+{
+    free(job->source);
+    free(job->meta);
+    free(job->pixels);
+    free(job);
+}
+
+/**
+ * Write cache file: temporary file replaces the cache file when it is
+ * complete.
+ * @param job image to write
+ */
+static void write_file(const struct dcache_job* job)
+{
+    char* path = NULL;
+    char* tmp = NULL;
+    char suffix[32];
+    int fd;
+
+    path = cache_path(job->source);
+    snprintf(suffix, sizeof(suffix), ".%d.%p", getpid(), (const void*)job);
+    if (!path || !str_dup(path, &tmp) || !str_append(suffix, 0, &tmp)) {
+        goto done;
+    }
+    fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        goto done;
+    }
+    if (!write_all(fd, job->pixels, pixels_size(job)) ||
+        !write_all(fd, job->meta, job->footer.meta_size) ||
+        !write_all(fd, &job->footer, sizeof(job->footer))) {
+        close(fd);
+        unlink(tmp);
+        goto done;
+    }
+    close(fd);
+    if (rename(tmp, path) == -1) {
+        unlink(tmp);
+        goto done;
+    }
+
+    trim();
+
+done:
+    free(path);
+    free(tmp);
+}
+
+/** Writer thread: saves queued images, so disk I/O doesn't block decoders. */
+static void* writer_thread(__attribute__((unused)) void* data)
+{
+    priority_background();
+
+    pthread_mutex_lock(&ctx.lock);
+
+    while (true) {
+        struct dcache_job* job;
+
+        while (!ctx.stop && !ctx.jobs) {
+            pthread_cond_wait(&ctx.signal, &ctx.lock);
+        }
+        if (ctx.stop) {
+            break;
+        }
+
+        job = ctx.jobs;
+        ctx.jobs = list_unlink(ctx.jobs, job);
+        ctx.busy = true;
+        pthread_mutex_unlock(&ctx.lock);
+
+        write_file(job);
+
+        pthread_mutex_lock(&ctx.lock);
+        ctx.queued -= pixels_size(job);
+        ctx.busy = false;
+        free_job(job);
+        pthread_cond_broadcast(&ctx.signal);
+    }
+
+    pthread_mutex_unlock(&ctx.lock);
+
+    return NULL;
+}
+
+void dcache_init(size_t limit)
+{
+    if (!limit) {
+        return;
+    }
+
+    ctx.dir = config_expand_path("XDG_CACHE_HOME", "/swayimg/decoded");
+    if (!ctx.dir) {
+        ctx.dir = config_expand_path("HOME", "/.cache/swayimg/decoded");
+    }
+    if (!ctx.dir) {
+        return;
+    }
+
+    if (!make_dirs(ctx.dir)) {
+        free(ctx.dir);
+        ctx.dir = NULL;
+        return;
+    }
+
+    pthread_mutex_init(&ctx.lock, NULL);
+    pthread_cond_init(&ctx.signal, NULL);
+    ctx.stop = false;
+    if (pthread_create(&ctx.tid, NULL, writer_thread, NULL)) {
+        pthread_mutex_destroy(&ctx.lock);
+        pthread_cond_destroy(&ctx.signal);
+        free(ctx.dir);
+        ctx.dir = NULL;
+        return;
+    }
+    ctx.limit = limit;
+}
+
+void dcache_destroy(void)
+{
+    if (ctx.dir) {
+        pthread_mutex_lock(&ctx.lock);
+        ctx.stop = true;
+        pthread_cond_broadcast(&ctx.signal);
+        pthread_mutex_unlock(&ctx.lock);
+        pthread_join(ctx.tid, NULL);
+
+        // images that are not written yet are dropped
+        list_for_each(ctx.jobs, struct dcache_job, it) {
+            free_job(it);
+        }
+        ctx.jobs = NULL;
+        ctx.queued = 0;
+
+        free(ctx.dir);
+        pthread_mutex_destroy(&ctx.lock);
+        pthread_cond_destroy(&ctx.signal);
+        ctx.dir = NULL;
+        ctx.limit = 0;
+    }
+}
+
+void dcache_flush(void)
+{
+    if (ctx.dir) {
+        pthread_mutex_lock(&ctx.lock);
+        while (ctx.jobs || ctx.busy) {
+            pthread_cond_wait(&ctx.signal, &ctx.lock);
+        }
+        pthread_mutex_unlock(&ctx.lock);
+    }
+}
+
+bool dcache_load(struct image* image, const char* source,
+                 const struct stat* st)
+{
+    struct dcache_footer footer;
+    struct image_frame* frame;
+    struct stat cst;
+    size_t pixels;
+    char* meta = NULL;
+    char* path;
+    void* data;
+    int fd;
+
+    if (!ctx.dir) {
+        return false;
+    }
+
+    path = cache_path(source);
+    if (!path) {
+        return false;
+    }
+    fd = open(path, O_RDWR | O_CLOEXEC);
+    free(path);
+    if (fd == -1) {
+        return false;
+    }
+
+    // check footer
+    if (fstat(fd, &cst) == -1 || (size_t)cst.st_size < sizeof(footer) ||
+        pread(fd, &footer, sizeof(footer), cst.st_size - sizeof(footer)) !=
+            sizeof(footer) ||
+        memcmp(footer.magic, signature, sizeof(signature)) ||
+        footer.version != VERSION || footer.src_size != (uint64_t)st->st_size ||
+        footer.src_sec != st->st_mtim.tv_sec ||
+        footer.src_nsec != st->st_mtim.tv_nsec) {
+        goto fail;
+    }
+    pixels = (size_t)footer.width * footer.height * sizeof(argb_t);
+    if (pixels == 0 ||
+        pixels + footer.meta_size + sizeof(footer) != (size_t)cst.st_size) {
+        goto fail;
+    }
+
+    // read meta data
+    meta = malloc(footer.meta_size);
+    if (!meta ||
+        pread(fd, meta, footer.meta_size, pixels) !=
+            (ssize_t)footer.meta_size ||
+        !image_unpack_meta(image, source, meta, footer.meta_size)) {
+        goto fail;
+    }
+    free(meta);
+    meta = NULL;
+
+    // map pixel data
+    data = mmap(NULL, pixels, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        goto fail;
+    }
+    frame = image_create_frames(image, 1);
+    if (!frame) {
+        munmap(data, pixels);
+        goto fail;
+    }
+    frame->pm.width = footer.width;
+    frame->pm.height = footer.height;
+    frame->pm.data = data;
+    frame->shm_size = pixels;
+    // private mapping of the cache file can't be shared with compositor
+    frame->shm_fd = -1;
+
+    image->alpha = footer.alpha;
+    image->orient = footer.orient;
+    image->file_size = st->st_size;
+
+    // mark file as recently used
+    futimens(fd, NULL);
+    close(fd);
+
+    return true;
+
+fail:
+    free(meta);
+    close(fd);
+    return false;
+}
+
+void dcache_save(struct image* image)
+{
+    struct dcache_job* job;
+    const struct pixmap* pm;
+    struct stat st;
+    size_t meta_size = 0;
+    size_t pixels;
+    bool queued = false;
+
+    if (!ctx.dir || image->decode_time < SLOW_DECODE || image->size_hint ||
+        image->preview || image->num_frames != 1 || image->anim ||
+        image->tiles || image->vector.render || image->gray ||
+        strcmp(image->source, LDRSRC_STDIN) == 0 ||
+        strncmp(image->source, LDRSRC_EXEC, LDRSRC_EXEC_LEN) == 0 ||
+        stat(image->source, &st) == -1) {
+        return;
+    }
+
+    pm = &image->frames[0].pm;
+    pixels = (size_t)pm->width * pm->height * sizeof(argb_t);
+    if (pixels > ctx.limit || pixels > MAX_QUEUED) {
+        return; // image doesn't fit into the cache
+    }
+
+    job = calloc(1, sizeof(*job));
+    if (!job) {
+        return;
+    }
+
+    // compose meta data
+    loader_load_meta(image);
+    if (!image_pack_meta(image, &job->meta, &meta_size) ||
+        !str_dup(image->source, &job->source)) {
+        goto done;
+    }
+
+    memcpy(job->footer.magic, signature, sizeof(signature));
+    job->footer.version = VERSION;
+    job->footer.src_size = st.st_size;
+    job->footer.src_sec = st.st_mtim.tv_sec;
+    job->footer.src_nsec = st.st_mtim.tv_nsec;
+    job->footer.meta_size = meta_size;
+    job->footer.width = pm->width;
+    job->footer.height = pm->height;
+    job->footer.orient = image->orient;
+    job->footer.alpha = image->alpha;
+
+    // the image can be freed or transformed while it is being written
+    job->pixels = malloc(pixels);
+    if (!job->pixels) {
+        goto done;
+    }
+    memcpy(job->pixels, pm->data, pixels);
+
+    pthread_mutex_lock(&ctx.lock);
+    if (ctx.queued + pixels <= MAX_QUEUED) {
+        ctx.jobs = list_append(ctx.jobs, job);
+        ctx.queued += pixels;
+        queued = true;
+        pthread_cond_broadcast(&ctx.signal);
+    }
+    pthread_mutex_unlock(&ctx.lock);
+
+done:
+    if (!queued) {
+        free_job(job);
+    }
+}
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: MIT
+// Persistent cache of decoded images.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include "image.h"
+
+#include <sys/stat.h>
+
+/**
+ * Initialize persistent cache.
+ * @param limit max size of the cache on disk in bytes, 0 to disable the cache
+ */
+void dcache_init(size_t limit);
+
+/**
+ * Free persistent cache resources, cached files are kept.
+ */
+void dcache_destroy(void);
+
+/**
+ * Load decoded image from the cache: pixel data is mapped from the cache
+ * file directly, without copying.
+ * @param image destination image
+ * @param source path to the original image file
+ * @param st status of the original image file
+ * @return true if image was loaded from the cache
+ */
+bool dcache_load(struct image* image, const char* source,
+                 const struct stat* st);
+
+/**
+ * Save decoded image to the cache if it is worth it: only static images with
+ * a single full size frame that took long to decode are stored.
+ * Copy of the image is written by the background thread, the oldest files
+ * are removed when the cache exceeds its limit. Images are skipped while too
+ * much data is waiting to be written.
+ * Deferred meta info of the stored image is parsed, so it is cached too.
+ * @param image decoded image
+ */
+void dcache_save(struct image* image);
+
+/**
+ * Wait until all queued images are written.
+ */
+void dcache_flush(void);
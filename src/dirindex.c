@@ -0,0 +1,286 @@
+// SPDX-License-Identifier: MIT
+// Persistent index of directory trees.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "dirindex.h"
+
+#include "array.h"
+#include "config.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Index file signature and format version
+static const uint8_t signature[] = { 's', 'w', 'd', 'i' };
+#define VERSION 1
+
+/**
+ * Index file header. The header is followed by the array of directory
+ * records, the array of file records and the table of null-terminated
+ * strings referenced by the records.
+ */
+struct dirindex_header {
+    uint8_t magic[4];   ///< Signature
+    uint32_t version;   ///< File format version
+    uint32_t flags;     ///< Parameters of the list
+    uint32_t reserved;  ///< Padding
+    uint64_t num_dirs;  ///< Number of directory records
+    uint64_t num_files; ///< Number of file records
+    uint64_t strings;   ///< Size of the string table
+};
+
+/** Directory record. */
+struct dirindex_drec {
+    int64_t sec;     ///< Modification time of the directory
+    int64_t nsec;    ///< Modification time of the directory (ns)
+    uint64_t path;   ///< Offset of the path in the string table
+    uint64_t parent; ///< Index of the parent directory
+};
+
+/** File record. */
+struct dirindex_frec {
+    int64_t mtime; ///< Modification time of the file
+    uint64_t size; ///< Size of the file
+    uint64_t path; ///< Offset of the path in the string table
+    uint64_t dir;  ///< Index of the parent directory
+};
+
+/**
+ * Get path to the index file.
+ * @param root absolute path to the root directory
+ * @param create flag to create the index directory
+ * @return path to the index file, caller must free it
+ */
+static char* index_path(const char* root, bool create)
+{
+    const uint64_t hash = fnv1a(FNV1A_INIT, root, strlen(root));
+    char name[32];
+    char* path;
+
+    path = config_expand_path("XDG_CACHE_HOME", "/swayimg/index");
+    if (!path) {
+        path = config_expand_path("HOME", "/.cache/swayimg/index");
+    }
+    if (!path) {
+        return NULL;
+    }
+
+    if (create && !make_dirs(path)) {
+        free(path);
+        return NULL;
+    }
+
+    snprintf(name, sizeof(name), "/%016llx.idx", (unsigned long long)hash);
+
+    return str_append(name, 0, &path);
+}
+
+bool dirindex_load(struct dirindex* index, const char* root)
+{
+    const struct dirindex_header* hdr;
+    const struct dirindex_drec* drec;
+    const struct dirindex_frec* frec;
+    const char* strings;
+    size_t rest;
+    struct stat st;
+    char* path;
+    void* map;
+    int fd;
+
+    memset(index, 0, sizeof(*index));
+
+    path = index_path(root, false);
+    if (!path) {
+        return false;
+    }
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    free(path);
+    if (fd == -1) {
+        return false;
+    }
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(*hdr)) {
+        close(fd);
+        return false;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    index->map = map;
+    index->map_size = st.st_size;
+
+    // check header and sizes of the tables
+    hdr = map;
+    rest = index->map_size - sizeof(*hdr);
+    if (memcmp(hdr->magic, signature, sizeof(signature)) ||
+        hdr->version != VERSION || hdr->num_dirs == 0 ||
+        hdr->num_dirs > rest / sizeof(*drec)) {
+        goto fail;
+    }
+    rest -= hdr->num_dirs * sizeof(*drec);
+    if (hdr->num_files > rest / sizeof(*frec)) {
+        goto fail;
+    }
+    rest -= hdr->num_files * sizeof(*frec);
+    if (hdr->strings != rest || rest == 0) {
+        goto fail;
+    }
+    drec = (const struct dirindex_drec*)(hdr + 1);
+    frec = (const struct dirindex_frec*)(drec + hdr->num_dirs);
+    strings = (const char*)(frec + hdr->num_files);
+    if (strings[rest - 1]) {
+        goto fail; // not null-terminated
+    }
+
+    index->dirs = malloc(hdr->num_dirs * sizeof(*index->dirs));
+    index->files = malloc((hdr->num_files + 1) * sizeof(*index->files));
+    if (!index->dirs || !index->files) {
+        goto fail;
+    }
+    index->num_dirs = hdr->num_dirs;
+    index->num_files = hdr->num_files;
+    index->flags = hdr->flags;
+
+    // parents are always stored before their children
+    for (size_t i = 0; i < index->num_dirs; ++i) {
+        struct dirindex_dir* dir = &index->dirs[i];
+        if (drec[i].path >= rest ||
+            (i == 0 ? drec[i].parent != DIRINDEX_ROOT
+                    : drec[i].parent >= i)) {
+            goto fail;
+        }
+        dir->path = strings + drec[i].path;
+        dir->mtime.tv_sec = drec[i].sec;
+        dir->mtime.tv_nsec = drec[i].nsec;
+        dir->parent = drec[i].parent;
+    }
+    for (size_t i = 0; i < index->num_files; ++i) {
+        struct dirindex_file* file = &index->files[i];
+        if (frec[i].path >= rest || frec[i].dir >= index->num_dirs) {
+            goto fail;
+        }
+        file->path = strings + frec[i].path;
+        file->dir = frec[i].dir;
+        file->mtime = frec[i].mtime;
+        file->size = frec[i].size;
+    }
+
+    // check for hash collision
+    if (strcmp(index->dirs[0].path, root) != 0) {
+        goto fail;
+    }
+
+    return true;
+
+fail:
+    dirindex_free(index);
+    return false;
+}
+
+void dirindex_free(struct dirindex* index)
+{
+    if (index->map) {
+        munmap(index->map, index->map_size);
+    }
+    free(index->dirs);
+    free(index->files);
+    memset(index, 0, sizeof(*index));
+}
+
+bool dirindex_save(const struct dirindex* index)
+{
+    struct dirindex_header hdr;
+    uint64_t offset = 0;
+    char suffix[32];
+    char* path;
+    char* tmp = NULL;
+    bool rc = false;
+    FILE* fp;
+    int fd;
+
+    if (index->num_dirs == 0) {
+        return false;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, signature, sizeof(signature));
+    hdr.version = VERSION;
+    hdr.flags = index->flags;
+    hdr.num_dirs = index->num_dirs;
+    hdr.num_files = index->num_files;
+    for (size_t i = 0; i < index->num_dirs; ++i) {
+        hdr.strings += strlen(index->dirs[i].path) + 1;
+    }
+    for (size_t i = 0; i < index->num_files; ++i) {
+        hdr.strings += strlen(index->files[i].path) + 1;
+    }
+
+    // write to temporary file and then replace the index file
+    path = index_path(index->dirs[0].path, true);
+    snprintf(suffix, sizeof(suffix), ".%d", getpid());
+    if (!path || !str_dup(path, &tmp) || !str_append(suffix, 0, &tmp)) {
+        goto done;
+    }
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        goto done;
+    }
+    fp = fdopen(fd, "w");
+    if (!fp) {
+        close(fd);
+        unlink(tmp);
+        goto done;
+    }
+
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+    for (size_t i = 0; i < index->num_dirs; ++i) {
+        const struct dirindex_dir* dir = &index->dirs[i];
+        const struct dirindex_drec rec = {
+            .sec = dir->mtime.tv_sec,
+            .nsec = dir->mtime.tv_nsec,
+            .path = offset,
+            .parent = dir->parent,
+        };
+        fwrite(&rec, sizeof(rec), 1, fp);
+        offset += strlen(dir->path) + 1;
+    }
+    for (size_t i = 0; i < index->num_files; ++i) {
+        const struct dirindex_file* file = &index->files[i];
+        const struct dirindex_frec rec = {
+            .mtime = file->mtime,
+            .size = file->size,
+            .path = offset,
+            .dir = file->dir,
+        };
+        fwrite(&rec, sizeof(rec), 1, fp);
+        offset += strlen(file->path) + 1;
+    }
+    for (size_t i = 0; i < index->num_dirs; ++i) {
+        fputs(index->dirs[i].path, fp);
+        fputc('\0', fp);
+    }
+    for (size_t i = 0; i < index->num_files; ++i) {
+        fputs(index->files[i].path, fp);
+        fputc('\0', fp);
+    }
+
+    rc = !ferror(fp);
+    if (fclose(fp) != 0) {
+        rc = false;
+    }
+    if (!rc || rename(tmp, path) == -1) {
+        unlink(tmp);
+        rc = false;
+    }
+
+done:
+    free(path);
+    free(tmp);
+    return rc;
+}
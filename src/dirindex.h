@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: MIT
+// Persistent index of directory trees.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Parent of the root directory
+#define DIRINDEX_ROOT SIZE_MAX
+
+/** Directory description. */
+struct dirindex_dir {
+    const char* path;      ///< Absolute path to the directory
+    struct timespec mtime; ///< Modification time of the directory
+    size_t parent;         ///< Index of the parent directory
+};
+
+/** File description. */
+struct dirindex_file {
+    const char* path; ///< Absolute path to the file
+    size_t dir;       ///< Index of the parent directory
+    time_t mtime;     ///< Modification time of the file
+    size_t size;      ///< Size of the file
+};
+
+/** Index of the directory tree. */
+struct dirindex {
+    struct dirindex_dir* dirs;   ///< Directories, the first one is the root
+    size_t num_dirs;             ///< Number of directories
+    struct dirindex_file* files; ///< Files in the list order
+    size_t num_files;            ///< Number of files
+    uint32_t flags;              ///< Parameters of the list (order etc)
+    void* map;                   ///< Mapped index file
+    size_t map_size;             ///< Size of the mapped file
+};
+
+/**
+ * Load index of the directory tree: the index file is mapped to memory,
+ * paths of the loaded entries point to the mapped data directly.
+ * @param index destination index, must be freed by `dirindex_free`
+ * @param root absolute path to the root directory
+ * @return false if there is no valid index for the directory
+ */
+bool dirindex_load(struct dirindex* index, const char* root);
+
+/**
+ * Free resources of the loaded index.
+ * @param index index to free
+ */
+void dirindex_free(struct dirindex* index);
+
+/**
+ * Save index of the directory tree, root path is taken from the first
+ * directory description.
+ * @param index index to save
+ * @return true if index was saved
+ */
+bool dirindex_save(const struct dirindex* index);
@@ -5,6 +5,7 @@
 #include "event.h"
 
 #include <errno.h>
+#include <string.h>
 #include <sys/eventfd.h>
 #include <unistd.h>
 
@@ -37,3 +38,95 @@ void notification_reset(int fd)
         len = read(fd, &value, sizeof(value));
     } while (len == -1 && errno == EINTR);
 }
+
+void event_ring_init(struct event_ring* ring)
+{
+    memset(ring, 0, sizeof(*ring));
+
+    // slot is free for producer when its sequence is equal to the position
+    for (size_t i = 0; i < EVENT_RING_SIZE; ++i) {
+        ring->slots[i].seq = i;
+    }
+}
+
+bool event_ring_push(struct event_ring* ring, const struct event* event)
+{
+    size_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    struct event_slot* slot;
+
+    while (true) {
+        size_t seq;
+        slot = &ring->slots[pos & (EVENT_RING_SIZE - 1)];
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq == pos) {
+            // slot is free, try to take it
+            if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if ((ssize_t)(seq - pos) < 0) {
+            return false; // slot is not consumed yet: ring is full
+        } else {
+            // another producer took the slot
+            pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(&slot->event, event, sizeof(slot->event));
+    slot->dropped = false;
+
+    // publish the event
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+bool event_ring_pop(struct event_ring* ring, struct event* event)
+{
+    while (true) {
+        struct event_slot* slot =
+            &ring->slots[ring->tail & (EVENT_RING_SIZE - 1)];
+        bool dropped;
+
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != ring->tail + 1) {
+            return false; // not published yet
+        }
+
+        dropped = slot->dropped;
+        if (!dropped) {
+            memcpy(event, &slot->event, sizeof(*event));
+        }
+
+        // release slot for the next round of producers
+        __atomic_store_n(&slot->seq, ring->tail + EVENT_RING_SIZE,
+                         __ATOMIC_RELEASE);
+        ++ring->tail;
+
+        if (!dropped) {
+            return true;
+        }
+    }
+}
+
+bool event_ring_empty(const struct event_ring* ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail;
+}
+
+void event_ring_remove(struct event_ring* ring, enum event_type type,
+                       void (*free_fn)(const struct event*))
+{
+    for (size_t pos = ring->tail;; ++pos) {
+        struct event_slot* slot = &ring->slots[pos & (EVENT_RING_SIZE - 1)];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1) {
+            break; // end of published events
+        }
+        if (!slot->dropped && slot->event.type == type) {
+            if (free_fn) {
+                free_fn(&slot->event);
+            }
+            slot->dropped = true;
+        }
+    }
+}
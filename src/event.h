@@ -14,7 +14,10 @@ enum event_type {
     event_resize,   ///< Window resize notification
     event_drag,     ///< Mouse or touch drag operation
     event_load,     ///< Image loaded (preload thread notification)
+    event_progress, ///< Image partially decoded (main thread loading)
     event_activate, ///< The mode is activating (viewer/gallery switch)
+    event_list,     ///< Image list changed (background scan results merged)
+    event_update,   ///< Image data prepared in background (tiles, mipmaps)
 };
 
 /** Event description. */
@@ -39,6 +42,15 @@ struct event {
             size_t index;
         } load;
 
+        struct progress {
+            const struct image* image;
+            size_t rows;
+        } progress;
+
+        struct update {
+            size_t generation;
+        } update;
+
     } param;
 };
 
@@ -48,6 +60,67 @@ struct event {
  */
 typedef void (*event_handler)(const struct event* event);
 
+// Capacity of the event ring, must be a power of 2
+#define EVENT_RING_SIZE 256
+
+/** Slot of the event ring. */
+struct event_slot {
+    size_t seq;         ///< Sequence number, defines the slot owner
+    bool dropped;       ///< Event was removed from the queue
+    struct event event; ///< Event description
+};
+
+/**
+ * Bounded lock-free queue of events: multiple producers, single consumer.
+ * Events are delivered in the order in which the slots were taken.
+ */
+struct event_ring {
+    struct event_slot slots[EVENT_RING_SIZE]; ///< Events buffer
+    size_t head;                              ///< Producers position
+    size_t tail;                              ///< Consumer position
+};
+
+/**
+ * Initialize event ring.
+ * @param ring event ring to initialize
+ */
+void event_ring_init(struct event_ring* ring);
+
+/**
+ * Put event to the ring, can be called from any thread or signal handler
+ * (lock-free, no memory allocation).
+ * @param ring event ring
+ * @param event event to copy into the ring
+ * @return false if the ring is full
+ */
+bool event_ring_push(struct event_ring* ring, const struct event* event);
+
+/**
+ * Get next event from the ring, can be called by consumer only.
+ * @param ring event ring
+ * @param event pointer to output event
+ * @return false if the ring is empty
+ */
+bool event_ring_pop(struct event_ring* ring, struct event* event);
+
+/**
+ * Check if all taken slots are consumed, can be called by consumer only.
+ * A slot is taken before the event is published, so the ring may have no
+ * events to pop but still not be empty.
+ * @param ring event ring
+ * @return true if there are no published or pending events
+ */
+bool event_ring_empty(const struct event_ring* ring);
+
+/**
+ * Remove queued events of specified type, can be called by consumer only.
+ * @param ring event ring
+ * @param type type of events to remove
+ * @param free_fn destructor of removed events, can be NULL
+ */
+void event_ring_remove(struct event_ring* ring, enum event_type type,
+                       void (*free_fn)(const struct event*));
+
 /**
  * Create notification (eventfd descriptor).
  * @return file descriptor or -1 on errors
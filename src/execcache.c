@@ -0,0 +1,208 @@
+// SPDX-License-Identifier: MIT
+// Cache of data printed by external commands (exec:// sources).
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "execcache.h"
+
+#include "buildcfg.h"
+#include "list.h"
+#include "perf.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Cache entry. */
+struct execcache_entry {
+    struct list list; ///< Links to prev/next entry
+    char* cmd;        ///< Command string
+    int fd;           ///< Shared memory file with command output
+    size_t size;      ///< Size of the data
+    time_t time;      ///< Time when the data was received
+};
+
+/** Cache context. */
+struct execcache_context {
+    pthread_mutex_t lock;            ///< Cache access lock
+    struct execcache_entry* entries; ///< Entries, the most recently used first
+    size_t limit;                    ///< Max total size of data
+    size_t used;                     ///< Current total size of data
+    size_t ttl;                      ///< Time to live in seconds
+    size_t counter;                  ///< Counter for unique file names
+};
+
+/** Global cache context. */
+static struct execcache_context ctx = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/**
+ * Free cache entry.
+ * @param entry cache entry to free
+ */
+static void free_entry(struct execcache_entry* entry)
+{
+    close(entry->fd);
+    free(entry->cmd);
+    free(entry);
+}
+
+/**
+ * Remove entry from the cache.
+ * Must be called with locked mutex.
+ * @param entry cache entry to remove
+ */
+static void remove_entry(struct execcache_entry* entry)
+{
+    ctx.entries = list_unlink(ctx.entries, entry);
+    ctx.used -= entry->size;
+    free_entry(entry);
+}
+
+/**
+ * Create shared memory file and write data to it.
+ * @param data data to write
+ * @param size size of the data
+ * @return file descriptor or -1 on errors
+ */
+static int create_file(const uint8_t* data, size_t size)
+{
+    char path[64];
+    void* mem;
+    int fd;
+
+    pthread_mutex_lock(&ctx.lock);
+    snprintf(path, sizeof(path), "/" APP_NAME "_exec_%x_%zu", getpid(),
+             ++ctx.counter);
+    pthread_mutex_unlock(&ctx.lock);
+
+    fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1) {
+        return -1;
+    }
+    shm_unlink(path);
+
+    if (ftruncate(fd, size) == -1) {
+        close(fd);
+        return -1;
+    }
+    mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    memcpy(mem, data, size);
+    munmap(mem, size);
+
+    return fd;
+}
+
+void execcache_init(size_t limit, size_t ttl)
+{
+    ctx.limit = limit;
+    ctx.ttl = ttl;
+}
+
+void execcache_destroy(void)
+{
+    pthread_mutex_lock(&ctx.lock);
+    list_for_each(ctx.entries, struct execcache_entry, it) {
+        free_entry(it);
+    }
+    ctx.entries = NULL;
+    ctx.used = 0;
+    ctx.limit = 0;
+    pthread_mutex_unlock(&ctx.lock);
+}
+
+bool execcache_get(const char* cmd, int* fd, size_t* size)
+{
+    const time_t now = perf_now() / 1000000;
+    bool found = false;
+
+    pthread_mutex_lock(&ctx.lock);
+
+    list_for_each(ctx.entries, struct execcache_entry, it) {
+        if (strcmp(it->cmd, cmd) == 0) {
+            if (ctx.ttl && now - it->time >= (time_t)ctx.ttl) {
+                remove_entry(it); // expired
+            } else {
+                // the caller gets its own descriptor, so the entry can be
+                // removed while the data is in use
+                *fd = dup(it->fd);
+                *size = it->size;
+                found = *fd != -1;
+                if (found) {
+                    // move to the head as the most recently used
+                    ctx.entries = list_unlink(ctx.entries, it);
+                    ctx.entries = list_add(ctx.entries, it);
+                }
+            }
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&ctx.lock);
+
+    return found;
+}
+
+void execcache_put(const char* cmd, const uint8_t* data, size_t size)
+{
+    struct execcache_entry* entry;
+    bool enabled;
+
+    pthread_mutex_lock(&ctx.lock);
+    enabled = size && size <= ctx.limit;
+    pthread_mutex_unlock(&ctx.lock);
+    if (!enabled) {
+        return;
+    }
+
+    entry = calloc(1, sizeof(*entry));
+    if (!entry) {
+        return;
+    }
+    entry->cmd = strdup(cmd);
+    entry->fd = create_file(data, size);
+    if (!entry->cmd || entry->fd == -1) {
+        if (entry->fd != -1) {
+            close(entry->fd);
+        }
+        free(entry->cmd);
+        free(entry);
+        return;
+    }
+    entry->size = size;
+    entry->time = perf_now() / 1000000;
+
+    pthread_mutex_lock(&ctx.lock);
+
+    // replace previous data of the same command
+    list_for_each(ctx.entries, struct execcache_entry, it) {
+        if (strcmp(it->cmd, cmd) == 0) {
+            remove_entry(it);
+            break;
+        }
+    }
+
+    // remove the least recently used entries
+    while (ctx.entries && ctx.used + size > ctx.limit) {
+        remove_entry(list_get_last(ctx.entries));
+    }
+
+    if (ctx.limit) {
+        ctx.entries = list_add(ctx.entries, entry);
+        ctx.used += size;
+        entry = NULL;
+    }
+
+    pthread_mutex_unlock(&ctx.lock);
+
+    if (entry) {
+        free_entry(entry); // cache was disabled concurrently
+    }
+}
@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: MIT
+// Cache of data printed by external commands (exec:// sources).
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Initialize cache of command output.
+ * @param limit max total size of cached data in bytes, 0 to disable the cache
+ * @param ttl time to live for cached data in seconds, 0 for unlimited
+ */
+void execcache_init(size_t limit, size_t ttl);
+
+/**
+ * Free cache resources.
+ */
+void execcache_destroy(void);
+
+/**
+ * Get cached output of the command, can be called from any thread.
+ * Data is stored in a shared memory file, so it can be mapped by the caller
+ * without copying.
+ * @param cmd command string
+ * @param fd output file descriptor, must be closed by the caller
+ * @param size output size of the data
+ * @return true if data was found in the cache
+ */
+bool execcache_get(const char* cmd, int* fd, size_t* size);
+
+/**
+ * Put output of the command to the cache, can be called from any thread.
+ * The least recently used entries are removed when the cache exceeds its
+ * limit.
+ * @param cmd command string
+ * @param data command output
+ * @param size size of the data
+ */
+void execcache_put(const char* cmd, const uint8_t* data, size_t size);
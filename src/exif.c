@@ -4,46 +4,170 @@
 
 #include "exif.h"
 
+#include "loader.h"
+
 #include <libexif/exif-data.h>
 #include <string.h>
 
+// EXIF header used in JPEG APP1 segment
+static const uint8_t exif_header[] = { 'E', 'x', 'i', 'f', 0, 0 };
+
+// JPEG markers
+#define JPEG_MARKER_SOI   0xd8
+#define JPEG_MARKER_APP0  0xe0
+#define JPEG_MARKER_APP1  0xe1
+#define JPEG_MARKER_APP15 0xef
+#define JPEG_MARKER_COM   0xfe
+
+// TIFF tag of the image orientation
+#define TIFF_TAG_ORIENTATION 0x0112
+
+/**
+ * Find EXIF data in the same way as libexif does: raw EXIF data or JPEG
+ * APP1 segment.
+ * @param data image file data
+ * @param size size of image data in bytes
+ * @param exif_size pointer to output size of EXIF data
+ * @return pointer to EXIF data (starts with EXIF header), NULL if not found
+ */
+static const uint8_t* find_exif(const uint8_t* data, size_t size,
+                                size_t* exif_size)
+{
+    if (size >= sizeof(exif_header) &&
+        memcmp(data, exif_header, sizeof(exif_header)) == 0) {
+        *exif_size = size;
+        return data;
+    }
+
+    while (size >= 3) {
+        size_t len;
+
+        // skip padding
+        while (size && *data == 0xff) {
+            ++data;
+            --size;
+        }
+        if (size < 3) {
+            break;
+        }
+        if (*data == JPEG_MARKER_SOI) {
+            ++data;
+            --size;
+            continue;
+        }
+        if (!(*data >= JPEG_MARKER_APP0 && *data <= JPEG_MARKER_APP15) &&
+            *data != JPEG_MARKER_COM) {
+            break; // EXIF must be at the beginning of JPEG
+        }
+
+        len = ((size_t)data[1] << 8) | data[2];
+        if (len < 2 || len + 1 > size) {
+            break;
+        }
+        if (*data == JPEG_MARKER_APP1 && len - 2 >= sizeof(exif_header) &&
+            memcmp(data + 3, exif_header, sizeof(exif_header)) == 0) {
+            *exif_size = len - 2;
+            return data + 3;
+        }
+
+        data += len + 1;
+        size -= len + 1;
+    }
+
+    return NULL;
+}
+
+/**
+ * Read unsigned integer from TIFF data.
+ * @param data pointer to the integer
+ * @param len size of the integer in bytes
+ * @param le little endian byte order
+ * @return integer value
+ */
+static uint32_t read_uint(const uint8_t* data, size_t len, bool le)
+{
+    uint32_t value = 0;
+    for (size_t i = 0; i < len; ++i) {
+        value = (value << 8) | data[le ? len - i - 1 : i];
+    }
+    return value;
+}
+
+/**
+ * Read orientation tag from the first IFD of TIFF data.
+ * @param tiff TIFF data
+ * @param size size of TIFF data in bytes
+ * @return orientation value, 0 if not found
+ */
+static uint32_t read_orientation(const uint8_t* tiff, size_t size)
+{
+    const size_t entry_size = 12;
+    uint32_t offset;
+    size_t num;
+    bool le;
+
+    if (size < 8) {
+        return 0;
+    }
+    if (tiff[0] == 'I' && tiff[1] == 'I') {
+        le = true;
+    } else if (tiff[0] == 'M' && tiff[1] == 'M') {
+        le = false;
+    } else {
+        return 0;
+    }
+
+    offset = read_uint(tiff + 4, 4, le);
+    if (offset > size - 2) {
+        return 0;
+    }
+    num = read_uint(tiff + offset, 2, le);
+    offset += 2;
+
+    for (size_t i = 0; i < num && offset + entry_size <= size; ++i) {
+        const uint8_t* entry = tiff + offset;
+        if (read_uint(entry, 2, le) == TIFF_TAG_ORIENTATION) {
+            return read_uint(entry + 8, 2, le); // short value
+        }
+        offset += entry_size;
+    }
+
+    return 0;
+}
+
 /**
  * Fix orientation from EXIF data.
  * @param img target image instance
- * @param exif instance of EXIF reader
+ * @param orientation EXIF orientation value
  */
-static void fix_orientation(struct image* img, ExifData* exif)
+static void fix_orientation(struct image* img, uint32_t orientation)
 {
-    const ExifEntry* entry = exif_data_get_entry(exif, EXIF_TAG_ORIENTATION);
-    if (entry) {
-        const ExifByteOrder byte_order = exif_data_get_byte_order(exif);
-        switch (exif_get_short(entry->data, byte_order)) {
-            case 2: // flipped back-to-front
-                image_flip_horizontal(img);
-                break;
-            case 3: // upside down
-                image_rotate(img, 180);
-                break;
-            case 4: // flipped back-to-front and upside down
-                image_flip_vertical(img);
-                break;
-            case 5: // flipped back-to-front and on its side
-                image_flip_horizontal(img);
-                image_rotate(img, 90);
-                break;
-            case 6: // on its side
-                image_rotate(img, 90);
-                break;
-            case 7: // flipped back-to-front and on its far side
-                image_flip_vertical(img);
-                image_rotate(img, 270);
-                break;
-            case 8: // on its far side
-                image_rotate(img, 270);
-                break;
-            default:
-                break;
-        }
+    switch (orientation) {
+        case 2: // flipped back-to-front
+            image_flip_horizontal(img);
+            break;
+        case 3: // upside down
+            image_rotate(img, 180);
+            break;
+        case 4: // flipped back-to-front and upside down
+            image_flip_vertical(img);
+            break;
+        case 5: // flipped back-to-front and on its side
+            image_flip_horizontal(img);
+            image_rotate(img, 90);
+            break;
+        case 6: // on its side
+            image_rotate(img, 90);
+            break;
+        case 7: // flipped back-to-front and on its far side
+            image_flip_vertical(img);
+            image_rotate(img, 270);
+            break;
+        case 8: // on its far side
+            image_rotate(img, 270);
+            break;
+        default:
+            break;
     }
 }
 
@@ -160,19 +284,77 @@ static void read_location(struct image* img, ExifData* exif)
 
 void process_exif(struct image* img, const uint8_t* data, size_t size)
 {
-    ExifData* exif = exif_data_new_from_data(data, (unsigned int)size);
+    size_t exif_size;
+    const uint8_t* exif = find_exif(data, size, &exif_size);
+
     if (exif) {
-        fix_orientation(img, exif);
+        fix_orientation(img, read_orientation(exif + sizeof(exif_header),
+                                              exif_size - sizeof(exif_header)));
+        image_set_exif(img, exif, exif_size);
+    }
+}
 
-        add_meta(img, exif, EXIF_TAG_DATE_TIME, "DateTime");
-        add_meta(img, exif, EXIF_TAG_MAKE, "Camera");
-        add_meta(img, exif, EXIF_TAG_MODEL, "Model");
-        add_meta(img, exif, EXIF_TAG_SOFTWARE, "Software");
-        add_meta(img, exif, EXIF_TAG_EXPOSURE_TIME, "Exposure");
-        add_meta(img, exif, EXIF_TAG_FNUMBER, "F Number");
+bool exif_load_meta(struct image* img)
+{
+    ExifData* exif;
 
-        read_location(img, exif);
+    if (!img->exif) {
+        return false;
+    }
 
-        exif_data_unref(exif);
+    exif = exif_data_new_from_data(img->exif, (unsigned int)img->exif_size);
+    image_set_exif(img, NULL, 0);
+    if (!exif) {
+        return false;
     }
+
+    add_meta(img, exif, EXIF_TAG_DATE_TIME, "DateTime");
+    add_meta(img, exif, EXIF_TAG_MAKE, "Camera");
+    add_meta(img, exif, EXIF_TAG_MODEL, "Model");
+    add_meta(img, exif, EXIF_TAG_SOFTWARE, "Software");
+    add_meta(img, exif, EXIF_TAG_EXPOSURE_TIME, "Exposure");
+    add_meta(img, exif, EXIF_TAG_FNUMBER, "F Number");
+
+    read_location(img, exif);
+
+    exif_data_unref(exif);
+
+    return true;
+}
+
+bool exif_preview(struct image* img, const uint8_t* data, size_t size)
+{
+    ExifData* exif = exif_data_new_from_data(data, (unsigned int)size);
+    const ExifEntry* width;
+    const ExifEntry* height;
+    bool rc = false;
+
+    if (!exif) {
+        return false;
+    }
+
+    // full size of the image is required to describe the thumbnail
+    width = exif_data_get_entry(exif, EXIF_TAG_PIXEL_X_DIMENSION);
+    height = exif_data_get_entry(exif, EXIF_TAG_PIXEL_Y_DIMENSION);
+
+    if (exif->data && exif->size && width && height &&
+        loader_decode_embedded(img, exif->data, exif->size) == ldr_success) {
+        const struct pixmap* pm = &img->frames[0].pm;
+        if (min(pm->width, pm->height) >= img->size_hint) {
+            const ExifByteOrder byte_order = exif_data_get_byte_order(exif);
+            img->full_width = width->format == EXIF_FORMAT_SHORT
+                ? exif_get_short(width->data, byte_order)
+                : exif_get_long(width->data, byte_order);
+            img->full_height = height->format == EXIF_FORMAT_SHORT
+                ? exif_get_short(height->data, byte_order)
+                : exif_get_long(height->data, byte_order);
+            rc = true;
+        } else {
+            image_free_frames(img);
+        }
+    }
+
+    exif_data_unref(exif);
+
+    return rc;
 }
@@ -7,9 +7,26 @@
 #include "image.h"
 
 /**
- * Read and handle EXIF data.
+ * Handle EXIF data: orientation is applied immediately, the rest of EXIF is
+ * stored in the image to be parsed by `exif_load_meta` on demand.
  * @param img target image context
  * @param data image file data
  * @param size size of image data in bytes
  */
 void process_exif(struct image* img, const uint8_t* data, size_t size);
+
+/**
+ * Parse EXIF data stored in the image to meta info.
+ * @param img target image context
+ * @return true if meta info was updated
+ */
+bool exif_load_meta(struct image* img);
+
+/**
+ * Decode EXIF thumbnail if it is not smaller than the size hint of the image.
+ * @param img target image context
+ * @param data image file data
+ * @param size size of image data in bytes
+ * @return true if preview was decoded
+ */
+bool exif_preview(struct image* img, const uint8_t* data, size_t size);
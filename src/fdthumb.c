@@ -0,0 +1,399 @@
+// SPDX-License-Identifier: MIT
+// Shared thumbnails (freedesktop.org Thumbnail Managing Standard).
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "fdthumb.h"
+
+#include "array.h"
+#include "buildcfg.h"
+#include "config.h"
+#include "formats/png.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Meta keys defined by the standard
+#define KEY_URI    "Thumb::URI"
+#define KEY_MTIME  "Thumb::MTime"
+#define KEY_SIZE   "Thumb::Size"
+#define KEY_WIDTH  "Thumb::Image::Width"
+#define KEY_HEIGHT "Thumb::Image::Height"
+#define KEY_SOFT   "Software"
+
+/** Thumbnail directory description. */
+struct fdthumb_dir {
+    const char* name; ///< Directory name
+    size_t size;      ///< Max size of thumbnails in the directory
+};
+
+// Thumbnail directories ordered by size
+static const struct fdthumb_dir dirs[] = {
+    { "normal",   128  },
+    { "large",    256  },
+    { "x-large",  512  },
+    { "xx-large", 1024 },
+};
+
+// MD5 constants (RFC 1321)
+static const uint32_t md5_k[] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a,
+    0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340,
+    0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+    0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+    0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92,
+    0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+static const uint8_t md5_r[] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9,  14, 20, 5, 9,  14, 20, 5, 9,  14, 20, 5, 9,  14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+
+/**
+ * Process single 64-byte block of MD5 message.
+ * @param state MD5 state
+ * @param block data block
+ */
+static void md5_block(uint32_t* state, const uint8_t* block)
+{
+    uint32_t a = state[0];
+    uint32_t b = state[1];
+    uint32_t c = state[2];
+    uint32_t d = state[3];
+    uint32_t m[16];
+
+    for (size_t i = 0; i < 16; ++i) {
+        m[i] = (uint32_t)block[i * 4] | ((uint32_t)block[i * 4 + 1] << 8) |
+            ((uint32_t)block[i * 4 + 2] << 16) |
+            ((uint32_t)block[i * 4 + 3] << 24);
+    }
+
+    for (size_t i = 0; i < 64; ++i) {
+        uint32_t f;
+        size_t g;
+        if (i < 16) {
+            f = (b & c) | (~b & d);
+            g = i;
+        } else if (i < 32) {
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) % 16;
+        } else if (i < 48) {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) % 16;
+        } else {
+            f = c ^ (b | ~d);
+            g = (7 * i) % 16;
+        }
+        f += a + md5_k[i] + m[g];
+        a = d;
+        d = c;
+        c = b;
+        b += (f << md5_r[i]) | (f >> (32 - md5_r[i]));
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+/**
+ * Get MD5 hash of the string.
+ * @param str source string
+ * @param hex output buffer for hex representation of the hash
+ */
+static void md5_hex(const char* str, char hex[33])
+{
+    uint32_t state[] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    const size_t len = strlen(str);
+    const uint64_t bits = (uint64_t)len * 8;
+    uint8_t tail[128];
+    size_t tail_len;
+    size_t pos = 0;
+
+    for (; pos + 64 <= len; pos += 64) {
+        md5_block(state, (const uint8_t*)str + pos);
+    }
+
+    // padding: 0x80, zeros and message length in bits
+    tail_len = len - pos;
+    memcpy(tail, str + pos, tail_len);
+    tail[tail_len++] = 0x80;
+    while (tail_len % 64 != 56) {
+        tail[tail_len++] = 0;
+    }
+    for (size_t i = 0; i < 8; ++i) {
+        tail[tail_len++] = (bits >> (i * 8)) & 0xff;
+    }
+    for (size_t i = 0; i < tail_len; i += 64) {
+        md5_block(state, tail + i);
+    }
+
+    for (size_t i = 0; i < 16; ++i) {
+        const uint8_t byte = (state[i / 4] >> ((i % 4) * 8)) & 0xff;
+        snprintf(hex + i * 2, 3, "%02x", byte);
+    }
+}
+
+/**
+ * Get URI of the file, characters are escaped in the same way as GLib does.
+ * @param path absolute path to the file
+ * @return URI, caller must free it
+ */
+static char* file_uri(const char* path)
+{
+    static const char* safe = "!$&'()*+,-./:=@_~";
+    char* uri;
+    char* ptr;
+
+    uri = malloc(sizeof("file://") + strlen(path) * 3);
+    if (!uri) {
+        return NULL;
+    }
+
+    strcpy(uri, "file://");
+    ptr = uri + sizeof("file://") - 1;
+    for (const char* ch = path; *ch; ++ch) {
+        const uint8_t byte = *ch;
+        if ((byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z') ||
+            (byte >= '0' && byte <= '9') || strchr(safe, byte)) {
+            *ptr++ = byte;
+        } else {
+            ptr += sprintf(ptr, "%%%02X", byte);
+        }
+    }
+    *ptr = '\0';
+
+    return uri;
+}
+
+/**
+ * Get path to the thumbnail file.
+ * @param dir thumbnail directory
+ * @param uri URI of the original file
+ * @param create flag to create the thumbnail directory
+ * @return path to the thumbnail, caller must free it
+ */
+static char* thumb_path(const struct fdthumb_dir* dir, const char* uri,
+                        bool create)
+{
+    char name[48];
+    char* path;
+
+    path = config_expand_path("XDG_CACHE_HOME", "/thumbnails/");
+    if (!path) {
+        path = config_expand_path("HOME", "/.cache/thumbnails/");
+    }
+    if (!path || !str_append(dir->name, 0, &path)) {
+        free(path);
+        return NULL;
+    }
+
+    if (create && !make_dirs(path)) {
+        free(path);
+        return NULL;
+    }
+
+    name[0] = '/';
+    md5_hex(uri, name + 1);
+    strcat(name, ".png");
+
+    return str_append(name, 0, &path);
+}
+
+/**
+ * Get meta value of the image.
+ * @param image image instance
+ * @param key meta key
+ * @return value or NULL if not found
+ */
+static const char* get_meta(const struct image* image, const char* key)
+{
+    list_for_each(image->info, const struct image_info, it) {
+        if (strcmp(it->key, key) == 0) {
+            return it->value;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Decode thumbnail file.
+ * @param path path to the thumbnail file
+ * @return thumbnail image or NULL on errors
+ */
+static struct image* load_png(const char* path)
+{
+    struct image* image = NULL;
+    struct stat st;
+    void* data;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    image = image_alloc();
+    if (image && (decode_png(image, data, st.st_size) != ldr_success ||
+                  image->num_frames == 0)) {
+        image_free(image);
+        image = NULL;
+    }
+
+    munmap(data, st.st_size);
+
+    return image;
+}
+
+/**
+ * Check if the thumbnail belongs to the current version of the file.
+ * @param image thumbnail image
+ * @param uri URI of the original file
+ * @param st status of the original file
+ * @return true if thumbnail is valid
+ */
+static bool is_valid(const struct image* image, const char* uri,
+                     const struct stat* st)
+{
+    const char* mtime = get_meta(image, KEY_MTIME);
+    const char* uri_val = get_meta(image, KEY_URI);
+    const char* size = get_meta(image, KEY_SIZE);
+
+    return mtime && strtoll(mtime, NULL, 10) == (long long)st->st_mtime &&
+        (!uri_val || strcmp(uri_val, uri) == 0) &&
+        (!size || strtoll(size, NULL, 10) == (long long)st->st_size);
+}
+
+struct image* fdthumb_load(const char* source, const struct stat* st,
+                           size_t size)
+{
+    struct image* image = NULL;
+    char* uri;
+
+    if (*source != '/' || !(uri = file_uri(source))) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(dirs) && !image; ++i) {
+        char* path;
+        if (dirs[i].size < size) {
+            continue; // don't upscale thumbnails
+        }
+        path = thumb_path(&dirs[i], uri, false);
+        if (path) {
+            image = load_png(path);
+            if (image && !is_valid(image, uri, st)) {
+                image_free(image);
+                image = NULL;
+            }
+            free(path);
+        }
+    }
+
+    if (image) {
+        const char* width = get_meta(image, KEY_WIDTH);
+        const char* height = get_meta(image, KEY_HEIGHT);
+        if (width && height) {
+            image->full_width = strtoul(width, NULL, 10);
+            image->full_height = strtoul(height, NULL, 10);
+        }
+
+        // meta data of the thumbnail doesn't describe the image
+        list_for_each(image->info, struct image_info, it) {
+            free(it);
+        }
+        image->info = NULL;
+        free(image->format);
+        image->format = NULL;
+        image_set_source(image, source);
+    }
+
+    free(uri);
+
+    return image;
+}
+
+size_t fdthumb_size(size_t size)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(dirs); ++i) {
+        if (dirs[i].size >= size) {
+            return dirs[i].size;
+        }
+    }
+    return 0;
+}
+
+bool fdthumb_save(const struct pixmap* pm, const char* source,
+                  const struct stat* st, size_t width, size_t height)
+{
+    const struct fdthumb_dir* dir = NULL;
+    struct image* meta = NULL;
+    char suffix[48];
+    char* path = NULL;
+    char* tmp = NULL;
+    char* uri = NULL;
+    bool rc = false;
+
+    for (size_t i = 0; i < ARRAY_SIZE(dirs) && !dir; ++i) {
+        if (dirs[i].size >= pm->width && dirs[i].size >= pm->height) {
+            dir = &dirs[i];
+        }
+    }
+    if (!dir || *source != '/') {
+        return false;
+    }
+
+    uri = file_uri(source);
+    meta = image_alloc();
+    if (!uri || !meta) {
+        goto done;
+    }
+    image_add_meta(meta, KEY_URI, "%s", uri);
+    image_add_meta(meta, KEY_MTIME, "%lld", (long long)st->st_mtime);
+    image_add_meta(meta, KEY_SIZE, "%lld", (long long)st->st_size);
+    image_add_meta(meta, KEY_WIDTH, "%zu", width);
+    image_add_meta(meta, KEY_HEIGHT, "%zu", height);
+    image_add_meta(meta, KEY_SOFT, "%s", APP_NAME " " APP_VERSION);
+
+    // write to temporary file and then replace the thumbnail
+    path = thumb_path(dir, uri, true);
+    snprintf(suffix, sizeof(suffix), ".%d.%p", getpid(), (void*)pm);
+    if (!path || !str_dup(path, &tmp) || !str_append(suffix, 0, &tmp)) {
+        goto done;
+    }
+    rc = export_png(pm, meta->info, tmp);
+    if (rc) {
+        // the standard requires private access to thumbnails
+        rc = chmod(tmp, S_IRUSR | S_IWUSR) == 0 && rename(tmp, path) == 0;
+    }
+    if (!rc) {
+        unlink(tmp);
+    }
+
+done:
+    image_free(meta);
+    free(uri);
+    free(path);
+    free(tmp);
+    return rc;
+}
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: MIT
+// Shared thumbnails (freedesktop.org Thumbnail Managing Standard).
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include "image.h"
+
+#include <sys/stat.h>
+
+/**
+ * Load shared thumbnail created by another application.
+ * @param source absolute path to the original image file
+ * @param st status of the original image file
+ * @param size min size of the thumbnail
+ * @return thumbnail image with original source and full size of the
+ *         image, or NULL if there is no valid thumbnail
+ */
+struct image* fdthumb_load(const char* source, const struct stat* st,
+                           size_t size);
+
+/**
+ * Get size of the shared thumbnail to create.
+ * @param size min size of the thumbnail
+ * @return max size of the shared thumbnail, 0 if not supported
+ */
+size_t fdthumb_size(size_t size);
+
+/**
+ * Save shared thumbnail, so it can be used by other applications.
+ * @param pm thumbnail pixmap that fits into `fdthumb_size` square
+ * @param source absolute path to the original image file
+ * @param st status of the original image file
+ * @param width,height real size of the image
+ * @return true if thumbnail was saved
+ */
+bool fdthumb_save(const struct pixmap* pm, const char* source,
+                  const struct stat* st, size_t width, size_t height);
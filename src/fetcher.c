@@ -6,21 +6,50 @@
 
 #include "application.h"
 #include "buildcfg.h"
+#include "hashmap.h"
 #include "imagelist.h"
 #include "loader.h"
+#include "memcache.h"
+#include "perf.h"
+#include "zcache.h"
 
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #ifdef HAVE_INOTIFY
 #include <sys/inotify.h>
 #endif
 
+// Images switched faster than this are browsed in one direction (ms)
+#define FAST_STEP 500
+
+/** Navigation direction. */
+enum direction {
+    dir_next_file, ///< Next file
+    dir_prev_file, ///< Previous file
+    dir_next_dir,  ///< First file of the next directory
+    dir_prev_dir,  ///< First file of the previous directory
+    dir_random,    ///< Random file
+};
+
+/** Image cache entry. */
+struct cache_entry {
+    struct list list;    ///< Links to newer/older entry
+    struct image* image; ///< Cached image
+    size_t size;         ///< Size of the image in bytes
+};
+
 /** Image cache queue. */
 struct image_cache {
-    size_t capacity;      ///< Max length of the queue
-    struct image** queue; ///< Cache queue
+    size_t capacity;          ///< Max length of the queue
+    size_t limit;             ///< Max size of images in bytes, 0=unlimited
+    size_t used;              ///< Size of images in bytes
+    bool compress;            ///< Move evicted images to compressed cache
+    struct cache_entry* head; ///< The newest entry
+    struct cache_entry* tail; ///< The oldest entry
+    struct hashmap map;       ///< Entries by image index
 };
 
 /** Image fetch context. */
@@ -28,6 +57,13 @@ struct fetch {
     struct image* current;      ///< Current image
     struct image_cache history; ///< Least recently viewed images
     struct image_cache preload; ///< Preloaded images
+    size_t prefetch;            ///< Number of next files to prefetch
+    enum direction direction;   ///< Last navigation direction
+    uint64_t step_time;         ///< Time of the last image switch
+    bool fast;                  ///< User switches images quickly
+    size_t* random;             ///< Next random files, consumed from head
+    size_t random_num;          ///< Number of entries in random list
+    size_t random_next;         ///< Last random file returned to the user
 #ifdef HAVE_INOTIFY
     int notify; ///< inotify file handler
     int watch;  ///< Current file watcher
@@ -41,18 +77,36 @@ static struct fetch ctx;
  * Initialize cache queue.
  * @param cache context
  * @param capacity max size of the queue
+ * @param limit max size of images in bytes, 0 for unlimited
  */
-static void cache_init(struct image_cache* cache, size_t capacity)
+static void cache_init(struct image_cache* cache, size_t capacity,
+                       size_t limit)
 {
+    memset(cache, 0, sizeof(*cache));
     cache->capacity = capacity;
-    cache->queue = NULL;
+    cache->limit = limit;
+}
 
-    if (capacity) {
-        cache->queue = calloc(1, capacity * sizeof(*cache->queue));
-        if (!cache->queue) {
-            cache->capacity = 0;
-        }
+/**
+ * Remove entry from cache queue.
+ * @param cache context
+ * @param entry entry to remove
+ * @return image instance
+ */
+static struct image* cache_remove(struct image_cache* cache,
+                                  struct cache_entry* entry)
+{
+    struct image* img = entry->image;
+
+    if (cache->tail == entry) {
+        cache->tail = list_prev(entry);
     }
+    cache->head = list_unlink(cache->head, entry);
+    hashmap_remove(&cache->map, img->index);
+    cache->used -= entry->size;
+    free(entry);
+
+    return img;
 }
 
 /**
@@ -61,12 +115,10 @@ static void cache_init(struct image_cache* cache, size_t capacity)
  */
 static void cache_reset(struct image_cache* cache)
 {
-    for (size_t i = 0; i < cache->capacity; ++i) {
-        struct image* img = cache->queue[i];
-        if (img) {
-            image_free(img);
-            cache->queue[i] = NULL;
-        }
+    while (cache->head) {
+        struct image* img = cache_remove(cache, cache->head);
+        memcache_remove(img);
+        image_free(img);
     }
 }
 
@@ -77,86 +129,160 @@ static void cache_reset(struct image_cache* cache)
 static void cache_free(struct image_cache* cache)
 {
     cache_reset(cache);
-    free(cache->queue);
+    hashmap_free(&cache->map);
 }
 
 /**
- * Put image handle to cache queue.
+ * Take out image handle from cache queue.
  * @param cache context
- * @param image pointer to image instance
+ * @param index index of the image in the image list
+ * @return image instance or NULL if image not in cache
  */
-static void cache_put(struct image_cache* cache, struct image* image)
+static struct image* cache_take(struct image_cache* cache, size_t index)
 {
-    if (cache->capacity == 0 || !image) {
-        return;
+    struct cache_entry* entry = hashmap_get(&cache->map, index);
+    struct image* img = NULL;
+
+    if (entry) {
+        img = cache_remove(cache, entry);
+        memcache_remove(img);
     }
 
-    // check for empty entry
-    for (size_t i = 0; i < cache->capacity; ++i) {
-        if (!cache->queue[i]) {
-            cache->queue[i] = image;
-            return;
-        }
+    return img;
+}
+
+/**
+ * Remove image from cache queue without freeing it.
+ * @param cache context
+ * @param image image to remove
+ * @return true if image was in the queue
+ */
+static bool cache_drop(struct image_cache* cache, const struct image* image)
+{
+    struct cache_entry* entry = hashmap_get(&cache->map, image->index);
+
+    if (entry && entry->image == image) {
+        cache_remove(cache, entry);
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Image eviction handler, see `memcache_evict_fn`.
+ * @param image image to evict
+ * @param pressure eviction is caused by memory pressure
+ */
+static void evict_image(struct image* image, bool pressure)
+{
+    const bool history = cache_drop(&ctx.history, image);
+
+    if (!history) {
+        cache_drop(&ctx.preload, image);
     }
+    // compression needs memory for both copies until it is done
+    if (pressure || !history || !zcache_put(image)) {
+        image_free(image);
+    }
+}
 
-    // cache is full, remove the oldest entry from head
-    image_free(cache->queue[0]);
-    for (size_t i = 0; i < cache->capacity - 1; ++i) {
-        cache->queue[i] = cache->queue[i + 1];
+/**
+ * Free image removed from cache queue or move it to compressed cache.
+ * @param cache context
+ * @param image image to evict
+ */
+static void cache_evict(const struct image_cache* cache, struct image* image)
+{
+    if (!cache->compress || !zcache_put(image)) {
+        image_free(image);
     }
-    // add new entry to tail
-    cache->queue[cache->capacity - 1] = image;
 }
 
 /**
- * Take out image handle from cache queue.
+ * Put image handle to cache queue.
  * @param cache context
- * @param index index of the image in the image list
- * @return image instance or NULL if image not in cache
+ * @param image pointer to image instance
  */
-static struct image* cache_take(struct image_cache* cache, size_t index)
+static void cache_put(struct image_cache* cache, struct image* image)
 {
-    struct image* img = NULL;
+    struct cache_entry* entry;
+    struct image* old;
+    size_t size;
 
-    for (size_t i = 0; i < cache->capacity; ++i) {
-        struct image* entry = cache->queue[i];
-        if (!entry) {
-            break; // last entry
-        }
-        if (entry->index == index) {
-            img = entry;
+    if (cache->capacity == 0 || !image) {
+        image_free(image);
+        return;
+    }
 
-            // move remaining entries
-            for (; i < cache->capacity - 1; ++i) {
-                cache->queue[i] = cache->queue[i + 1];
-            }
-            // remove last entry from queue
-            cache->queue[cache->capacity - 1] = NULL;
+    // replace the previous version of the image
+    old = cache_take(cache, image->index);
+    if (old) {
+        image_free(old);
+    }
 
-            break;
-        }
+    size = image_memory(image);
+    if (cache->limit && size > cache->limit) {
+        cache_evict(cache, image);
+        return;
     }
 
-    return img;
+    // cache is full, remove the oldest entries
+    while (cache->map.size >= cache->capacity ||
+           (cache->limit && cache->used + size > cache->limit)) {
+        old = cache_remove(cache, cache->tail);
+        memcache_remove(old);
+        cache_evict(cache, old);
+    }
+
+    entry = malloc(sizeof(*entry));
+    if (!entry || !hashmap_put(&cache->map, image->index, entry)) {
+        free(entry);
+        image_free(image);
+        return;
+    }
+    entry->image = image;
+    entry->size = size;
+    cache->used += size;
+    cache->head = list_add(cache->head, entry);
+    if (!cache->tail) {
+        cache->tail = entry;
+    }
+
+    memcache_put(image, evict_image);
 }
 
 /**
- * Remove oldest entries from cache.
+ * Update indices of cached images after the image list was reordered.
  * @param cache context
- * @param size number of entries to preserve
  */
-static void cache_trim(struct image_cache* cache, size_t size)
+static void cache_remap(struct image_cache* cache)
 {
-    if (size == 0) {
-        cache_reset(cache);
-    } else {
-        for (size_t i = cache->capacity - 1; i > size; --i) {
-            image_free(cache->queue[i]);
-            cache->queue[i] = NULL;
+    hashmap_free(&cache->map);
+
+    list_for_each(cache->head, struct cache_entry, it) {
+        struct image* img = it->image;
+        img->index = image_list_remap(img->index);
+        if (img->index == IMGLIST_INVALID ||
+            !hashmap_put(&cache->map, img->index, it)) {
+            cache_remove(cache, it);
+            memcache_remove(img);
+            image_free(img);
         }
     }
 }
 
+/**
+ * Check if image is in cache.
+ * @param cache context
+ * @param index index of the image in the image list
+ * @return true if image is in cache
+ */
+static bool cache_has(const struct image_cache* cache, size_t index)
+{
+    return !!hashmap_get(&cache->map, index);
+}
+
 #ifdef HAVE_INOTIFY
 /** inotify handler. */
 static void on_inotify(__attribute__((unused)) void* data)
@@ -191,53 +317,197 @@ static void on_inotify(__attribute__((unused)) void* data)
 }
 #endif // HAVE_INOTIFY
 
-/** Reset preloader queue. */
-static void reset_preloader(void)
+/**
+ * Update navigation direction and speed.
+ * @param prev index of the previous image
+ * @param next index of the new current image
+ */
+static void update_direction(size_t prev, size_t next)
 {
-    size_t* preload;
-    size_t preload_num = 0;
-    size_t found = 0;
-    size_t next;
+    const uint64_t now = perf_now() / 1000;
+
+    ctx.fast = (now - ctx.step_time < FAST_STEP);
+    ctx.step_time = now;
+
+    if (next == ctx.random_next) {
+        ctx.direction = dir_random;
+    } else if (next == image_list_next_file(prev)) {
+        ctx.direction = dir_next_file;
+    } else if (next == image_list_prev_file(prev)) {
+        ctx.direction = dir_prev_file;
+    } else if (next == image_list_next_dir(prev)) {
+        ctx.direction = dir_next_dir;
+    } else if (next == image_list_prev_dir(prev)) {
+        ctx.direction = dir_prev_dir;
+    } else if (ctx.direction == dir_random) {
+        ctx.random_num = 0; // random sequence was not used
+    }
+    ctx.random_next = IMGLIST_INVALID;
+}
 
-    if (ctx.preload.capacity == 0) {
-        return;
+/**
+ * Fill list of random files that will be opened next.
+ */
+static void update_random(void)
+{
+    const size_t current = ctx.current->index;
+
+    // drop the current and invalid entries
+    for (size_t i = 0; i < ctx.random_num;) {
+        if (ctx.random[i] == current || !image_list_get(ctx.random[i])) {
+            --ctx.random_num;
+            memmove(&ctx.random[i], &ctx.random[i + 1],
+                    (ctx.random_num - i) * sizeof(*ctx.random));
+        } else {
+            ++i;
+        }
     }
 
-    loader_queue_reset();
+    while (ctx.random && ctx.random_num < ctx.preload.capacity) {
+        const size_t next = image_list_rand_file(current);
+        if (next == IMGLIST_INVALID) {
+            break;
+        }
+        ctx.random[ctx.random_num++] = next;
+    }
+}
 
-    preload = malloc(ctx.preload.capacity * sizeof(*preload));
-    if (!preload) {
-        return;
+/**
+ * Predict images that will be opened next.
+ * @param predict output array of predicted indices
+ * @param max max number of entries to predict
+ * @return number of predicted entries
+ */
+static size_t predict_next(size_t* predict, size_t max)
+{
+    const size_t current = ctx.current->index;
+    const bool backward =
+        (ctx.direction == dir_prev_file || ctx.direction == dir_prev_dir);
+    size_t num = 0;
+    size_t next = current;
+    size_t ahead = max;
+
+    if (max == 0) {
+        return 0;
     }
 
-    // reorder preloads and create list of preloads
-    next = ctx.current->index;
-    for (size_t i = 0; i < ctx.preload.capacity; ++i) {
-        struct image* img;
+    if (ctx.direction == dir_random) {
+        update_random();
+        memcpy(predict, ctx.random, ctx.random_num * sizeof(*predict));
+        return ctx.random_num;
+    }
 
-        next = image_list_next_file(next);
-        if (next == IMGLIST_INVALID) {
+    // slow browsing: the user may step back to compare images
+    if (!ctx.fast && max > 2) {
+        --ahead;
+    }
+
+    // the same jump is likely repeated
+    if (ctx.direction == dir_next_dir || ctx.direction == dir_prev_dir) {
+        next = backward ? image_list_prev_dir(current)
+                        : image_list_next_dir(current);
+        if (next != IMGLIST_INVALID && next != current) {
+            predict[num++] = next;
+        }
+        next = current;
+    }
+
+    // files in the current direction, directories are browsed forward
+    while (num < ahead) {
+        next = ctx.direction == dir_prev_file ? image_list_prev_file(next)
+                                              : image_list_next_file(next);
+        if (next == IMGLIST_INVALID || next == current) {
             break;
         }
+        predict[num++] = next;
+    }
 
-        img = cache_take(&ctx.preload, next);
-        if (img) {
-            cache_put(&ctx.preload, img);
-            ++found;
-        } else if (next != ctx.current->index) {
-            preload[preload_num++] = next;
+    // the opposite direction
+    if (num < max) {
+        next = ctx.direction == dir_prev_file ? image_list_next_file(current)
+                                              : image_list_prev_file(current);
+        if (next != IMGLIST_INVALID && next != current) {
+            predict[num++] = next;
         }
     }
 
-    // remove images that don't fit into cache size
-    cache_trim(&ctx.preload, found);
+    // remove duplicates (short lists in loop mode)
+    for (size_t i = 1; i < num; ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            if (predict[i] == predict[j]) {
+                predict[i--] = predict[--num];
+                break;
+            }
+        }
+    }
+
+    return num;
+}
+
+/** Reset preloader queue. */
+static void reset_preloader(void)
+{
+    const size_t capacity = ctx.preload.capacity;
+    struct image** keep;
+    size_t* predict;
+    size_t* load;
+    size_t predict_num = 0;
+    size_t keep_num = 0;
+    size_t load_num = 0;
+
+    // predicted entries and entries to load (plus the current image)
+    predict = malloc((capacity * 2 + 1) * sizeof(*predict));
+    keep = malloc((capacity + 1) * sizeof(*keep));
+    if (!predict || !keep) {
+        free(predict);
+        free(keep);
+        loader_queue_reset();
+        return;
+    }
+    load = predict + capacity;
+
+    // full quality version of the current image has the highest priority
+    if (ctx.current->preview) {
+        load[load_num++] = ctx.current->index;
+    }
+
+    predict_num = predict_next(predict, capacity);
 
-    // add preloads to queue
-    for (size_t i = 0; i < preload_num; ++i) {
-        loader_queue_append(preload[i]);
+    // keep already preloaded images, load the rest
+    for (size_t i = 0; i < predict_num; ++i) {
+        struct image* img = cache_take(&ctx.preload, predict[i]);
+        if (img) {
+            keep[keep_num++] = img;
+        } else if (!cache_has(&ctx.history, predict[i]) &&
+                   !zcache_has(predict[i])) {
+            load[load_num++] = predict[i];
+        }
     }
+    cache_reset(&ctx.preload);
+    for (size_t i = 0; i < keep_num; ++i) {
+        cache_put(&ctx.preload, keep[i]);
+    }
+
+    // images that are being decoded are not cancelled if still needed
+    loader_queue_set(load, load_num, ctx.current->index);
+
+    free(predict);
+    free(keep);
+}
+
+/** Read next files into the page cache. */
+static void prefetch_files(void)
+{
+    size_t next = ctx.current->index;
 
-    free(preload);
+    for (size_t i = 0; i < ctx.prefetch; ++i) {
+        next = ctx.direction == dir_prev_file ? image_list_prev_file(next)
+                                              : image_list_next_file(next);
+        if (next == IMGLIST_INVALID || next == ctx.current->index) {
+            break;
+        }
+        loader_prefetch(next);
+    }
 }
 
 /**
@@ -248,15 +518,18 @@ static void set_current(struct image* image)
 {
     // put current image to history cache
     if (ctx.current) {
+        update_direction(ctx.current->index, image->index);
         if (ctx.history.capacity) {
             cache_put(&ctx.history, ctx.current);
-        } else {
+        } else if (!zcache_put(ctx.current)) {
             image_free(ctx.current);
         }
     }
 
     ctx.current = image;
+    memcache_trim();
     reset_preloader();
+    prefetch_files();
 
 #ifdef HAVE_INOTIFY
     // register inotify watcher
@@ -270,15 +543,25 @@ static void set_current(struct image* image)
 #endif
 }
 
-void fetcher_init(struct image* image, size_t history, size_t preload)
+void fetcher_init(struct image* image, size_t history, size_t history_mem,
+                  size_t history_zip, size_t preload, size_t prefetch)
 {
-    cache_init(&ctx.history, history);
-    cache_init(&ctx.preload, preload);
+    cache_init(&ctx.history, history, history_mem);
+    cache_init(&ctx.preload, preload, 0);
+    ctx.history.compress = true;
+    zcache_init(history_zip);
+    ctx.prefetch = prefetch;
+    ctx.direction = dir_next_file;
+    ctx.random = ctx.preload.capacity
+        ? malloc(ctx.preload.capacity * sizeof(*ctx.random))
+        : NULL;
+    ctx.random_num = 0;
+    ctx.random_next = IMGLIST_INVALID;
 
 #ifdef HAVE_INOTIFY
     ctx.notify = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
     if (ctx.notify >= 0) {
-        app_watch(ctx.notify, on_inotify, NULL);
+        app_watch(ctx.notify, POLLIN, on_inotify, NULL);
         ctx.watch = -1;
     }
 #endif // HAVE_INOTIFY
@@ -292,6 +575,8 @@ void fetcher_destroy(void)
 {
     cache_free(&ctx.history);
     cache_free(&ctx.preload);
+    zcache_destroy();
+    free(ctx.random);
     image_free(ctx.current);
 }
 
@@ -300,8 +585,10 @@ bool fetcher_reset(size_t index, bool force)
     loader_queue_reset();
     cache_reset(&ctx.history);
     cache_reset(&ctx.preload);
+    zcache_reset();
     image_free(ctx.current);
     ctx.current = NULL;
+    ctx.random_num = 0;
 
     if (force && index != IMGLIST_INVALID) {
         fetcher_open(index);
@@ -317,6 +604,19 @@ bool fetcher_reset(size_t index, bool force)
     return !!ctx.current;
 }
 
+void fetcher_remap(void)
+{
+    cache_remap(&ctx.history);
+    cache_remap(&ctx.preload);
+    zcache_reset();
+    ctx.random_num = 0;
+
+    if (ctx.current) {
+        ctx.current->index = image_list_remap(ctx.current->index);
+        reset_preloader();
+    }
+}
+
 bool fetcher_open(size_t index)
 {
     struct image* img;
@@ -329,7 +629,12 @@ bool fetcher_open(size_t index)
     img = cache_take(&ctx.history, index);
     if (!img) {
         img = cache_take(&ctx.preload, index);
+        perf_preload(!!img);
+    }
+    if (!img) {
+        img = zcache_take(index);
     }
+    memcache_account(!!img);
 
     if (!img) {
         loader_from_index(index, &img);
@@ -341,18 +646,60 @@ bool fetcher_open(size_t index)
     return !!img;
 }
 
-void fetcher_attach(struct image* image, size_t index)
+bool fetcher_attach(struct image* image, size_t index)
 {
+    if (image && image->thumbnail) {
+        image_free(image); // decoded for gallery before switching the mode
+        return false;
+    }
+
+    if (ctx.current && ctx.current->preview && ctx.current->index == index) {
+        // full quality version of the current image
+        ctx.current->preview = false;
+        if (!image) {
+            return false; // keep preview
+        }
+        image_free(ctx.current);
+        ctx.current = image;
+        return true;
+    }
+
     if (image) {
         cache_put(&ctx.preload, image);
+        memcache_trim();
     } else {
         loader_queue_reset();
         image_list_skip(index);
         reset_preloader();
     }
+
+    return false;
+}
+
+size_t fetcher_rand_file(void)
+{
+    size_t next;
+
+    if (ctx.random_num) {
+        next = ctx.random[0];
+        --ctx.random_num;
+        memmove(ctx.random, ctx.random + 1,
+                ctx.random_num * sizeof(*ctx.random));
+    } else {
+        next = image_list_rand_file(ctx.current->index);
+    }
+    ctx.random_next = next;
+
+    return next;
 }
 
 struct image* fetcher_current(void)
 {
     return ctx.current;
 }
+
+const struct image* fetcher_peek(size_t index)
+{
+    const struct cache_entry* entry = hashmap_get(&ctx.preload.map, index);
+    return entry ? entry->image : NULL;
+}
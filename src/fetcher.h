@@ -10,9 +10,13 @@
  * Initialize global fetch context.
  * @param image initial image
  * @param history max number of images in history
+ * @param history_mem max size of images in history in bytes, 0=unlimited
+ * @param history_zip max size of compressed history in bytes, 0=disable
  * @param preload max number of preloaded images
+ * @param prefetch number of next files to read into the page cache
  */
-void fetcher_init(struct image* image, size_t history, size_t preload);
+void fetcher_init(struct image* image, size_t history, size_t history_mem,
+                  size_t history_zip, size_t preload, size_t prefetch);
 
 /**
  * Destroy global fetch context.
@@ -27,6 +31,12 @@ void fetcher_destroy(void);
  */
 bool fetcher_reset(size_t index, bool force);
 
+/**
+ * Update indices of the current and cached images after the image list
+ * was changed by merging background scan results.
+ */
+void fetcher_remap(void);
+
 /**
  * Open image and set it as the current one.
  * @param index index of the image to fetch
@@ -35,14 +45,30 @@ bool fetcher_reset(size_t index, bool force);
 bool fetcher_open(size_t index);
 
 /**
- * Attach image to preload cache.
+ * Attach image to preload cache or replace the current image if it is a
+ * preview of the loaded one.
  * @param image loaded image instance, NULL if load error
  * @param index index of the image in the image list
+ * @return true if the current image was replaced
+ */
+bool fetcher_attach(struct image* image, size_t index);
+
+/**
+ * Get random image to open next, the random sequence is generated ahead to
+ * preload images.
+ * @return index of the image or IMGLIST_INVALID if not found
  */
-void fetcher_attach(struct image* image, size_t index);
+size_t fetcher_rand_file(void);
 
 /**
  * Get current image.
  * @return current image or NULL if no image loaded yet
  */
 struct image* fetcher_current(void);
+
+/**
+ * Get preloaded image without taking it out of the cache.
+ * @param index index of the image in the image list
+ * @return image instance or NULL if image is not preloaded yet
+ */
+const struct image* fetcher_peek(size_t index);
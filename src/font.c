@@ -5,6 +5,9 @@
 #include "font.h"
 
 #include "array.h"
+#include "hashmap.h"
+
+#include <pthread.h>
 
 // font related
 #include <fontconfig/fontconfig.h>
@@ -17,6 +20,17 @@
 
 #define BACKGROUND_PADDING 5
 
+/** Rasterized glyph. */
+struct glyph {
+    FT_Pos advance; ///< Horizontal advance in 26.6 format
+    FT_Int left;    ///< Left side bearing
+    FT_Int top;     ///< Top side bearing
+    size_t width;   ///< Bitmap width
+    size_t rows;    ///< Bitmap height
+    size_t offset;  ///< Offset of the bitmap in the atlas
+    bool valid;     ///< Glyph is available in the font
+};
+
 /** Font context. */
 struct font {
     FT_Library lib;    ///< Font lib instance
@@ -25,6 +39,14 @@ struct font {
     argb_t color;      ///< Font color
     argb_t shadow;     ///< Font shadow color
     argb_t background; ///< Font background
+    pthread_t loader;  ///< Background font loader thread
+    bool loading;      ///< Loader thread is not joined yet
+
+    // glyphs of the current font size
+    struct hashmap glyphs; ///< Rasterized glyphs by code point
+    uint8_t* atlas;        ///< Bitmaps of all glyphs
+    size_t atlas_size;     ///< Size of used atlas space
+    size_t atlas_cap;      ///< Size of allocated atlas space
 };
 
 /** Global font context instance. */
@@ -73,6 +95,90 @@ static bool search_font_file(const char* name, char* font_file, size_t len)
     return *font_file;
 }
 
+/**
+ * Free all cached glyphs.
+ */
+static void reset_glyphs(void)
+{
+    for (size_t i = 0; i < ctx.glyphs.capacity; ++i) {
+        free(ctx.glyphs.slots[i].value);
+    }
+    hashmap_free(&ctx.glyphs);
+    memset(&ctx.glyphs, 0, sizeof(ctx.glyphs));
+    free(ctx.atlas);
+    ctx.atlas = NULL;
+    ctx.atlas_size = 0;
+    ctx.atlas_cap = 0;
+}
+
+/**
+ * Rasterize glyph and put it to the cache.
+ * @param glyph glyph description to fill
+ * @param code character code point
+ * @return false if glyph is not available
+ */
+static bool rasterize_glyph(struct glyph* glyph, wchar_t code)
+{
+    const FT_Bitmap* bmp;
+    size_t size;
+
+    if (FT_Load_Char(ctx.face, code, FT_LOAD_RENDER) != 0) {
+        return false;
+    }
+
+    bmp = &ctx.face->glyph->bitmap;
+    size = bmp->width * bmp->rows;
+    if (ctx.atlas_size + size > ctx.atlas_cap) {
+        const size_t cap = max(ctx.atlas_cap * 2, ctx.atlas_size + size);
+        uint8_t* atlas = realloc(ctx.atlas, cap);
+        if (!atlas) {
+            return false;
+        }
+        ctx.atlas = atlas;
+        ctx.atlas_cap = cap;
+    }
+
+    // bitmap is stored without padding
+    for (size_t y = 0; y < bmp->rows; ++y) {
+        memcpy(ctx.atlas + ctx.atlas_size + y * bmp->width,
+               &bmp->buffer[y * bmp->pitch], bmp->width);
+    }
+
+    glyph->advance = ctx.face->glyph->advance.x;
+    glyph->left = ctx.face->glyph->bitmap_left;
+    glyph->top = ctx.face->glyph->bitmap_top;
+    glyph->width = bmp->width;
+    glyph->rows = bmp->rows;
+    glyph->offset = ctx.atlas_size;
+    ctx.atlas_size += size;
+
+    return true;
+}
+
+/**
+ * Get glyph, it is rasterized only on the first request.
+ * @param code character code point
+ * @return glyph description or NULL if not available
+ */
+static const struct glyph* get_glyph(wchar_t code)
+{
+    struct glyph* glyph = hashmap_get(&ctx.glyphs, code);
+
+    if (!glyph) {
+        glyph = calloc(1, sizeof(*glyph));
+        if (!glyph) {
+            return NULL;
+        }
+        glyph->valid = rasterize_glyph(glyph, code);
+        if (!hashmap_put(&ctx.glyphs, code, glyph)) {
+            free(glyph);
+            return NULL;
+        }
+    }
+
+    return glyph->valid ? glyph : NULL;
+}
+
 /**
  * Calc size of the surface and allocate memory for the mask.
  * @param text string to print
@@ -93,13 +199,13 @@ static size_t allocate_surface(const wchar_t* text,
 
     // get total width
     while (*text) {
+        const struct glyph* glyph;
         if (*text == L' ') {
             width += space_size;
-        } else if (FT_Load_Char(ctx.face, *text, FT_LOAD_RENDER) == 0) {
-            const FT_GlyphSlot glyph = ctx.face->glyph;
-            width += glyph->advance.x / POINT_FACTOR;
-            if ((FT_Int)base_offset < glyph->bitmap_top) {
-                base_offset = glyph->bitmap_top;
+        } else if ((glyph = get_glyph(*text))) {
+            width += glyph->advance / POINT_FACTOR;
+            if ((FT_Int)base_offset < glyph->top) {
+                base_offset = glyph->top;
             }
         }
         ++text;
@@ -121,37 +227,75 @@ static size_t allocate_surface(const wchar_t* text,
     return base_offset;
 }
 
-void font_init(const struct config* cfg)
+/**
+ * Load font face, executed in background thread.
+ * @param data font name, freed by the function
+ * @return always NULL
+ */
+static void* load_font(void* data)
 {
+    char* font_name = data;
     char font_file[256];
-    const char* font_name;
 
-    // load font
-    font_name = config_get(cfg, CFG_FONT, CFG_FONT_NAME);
     if (!search_font_file(font_name, font_file, sizeof(font_file)) ||
         FT_Init_FreeType(&ctx.lib) != 0 ||
         FT_New_Face(ctx.lib, font_file, 0, &ctx.face) != 0) {
         fprintf(stderr, "WARNING: Unable to load font %s\n", font_name);
-        return;
+    } else {
+        FT_Set_Char_Size(ctx.face, ctx.size * POINT_FACTOR, 0, 96, 0);
     }
 
-    // set font size
+    free(font_name);
+
+    return NULL;
+}
+
+/**
+ * Wait for the background font loader.
+ */
+static void wait_font(void)
+{
+    if (ctx.loading) {
+        pthread_join(ctx.loader, NULL);
+        ctx.loading = false;
+    }
+}
+
+void font_init(const struct config* cfg)
+{
+    char* font_name;
+
     ctx.size = config_get_num(cfg, CFG_FONT, CFG_FONT_SIZE, 1, 256);
-    FT_Set_Char_Size(ctx.face, ctx.size * POINT_FACTOR, 0, 96, 0);
 
     // color/background/shadow parameters
     ctx.color = config_get_color(cfg, CFG_FONT, CFG_FONT_COLOR);
     ctx.background = config_get_color(cfg, CFG_FONT, CFG_FONT_BKG);
     ctx.shadow = config_get_color(cfg, CFG_FONT, CFG_FONT_SHADOW);
+
+    // fontconfig lookup is slow, so the font is loaded in background and
+    // awaited on the first use
+    font_name = strdup(config_get(cfg, CFG_FONT, CFG_FONT_NAME));
+    if (!font_name) {
+        return;
+    }
+    if (pthread_create(&ctx.loader, NULL, load_font, font_name) == 0) {
+        ctx.loading = true;
+    } else {
+        load_font(font_name);
+    }
 }
 
 void font_set_scale(double scale)
 {
+    wait_font();
     FT_Set_Char_Size(ctx.face, ctx.size * POINT_FACTOR, 0, 96 * scale, 0);
+    reset_glyphs();
 }
 
 void font_destroy(void)
 {
+    wait_font();
+    reset_glyphs();
     if (ctx.face) {
         FT_Done_Face(ctx.face);
     }
@@ -168,6 +312,7 @@ bool font_render(const char* text, struct text_surface* surface)
     wchar_t* it;
     size_t x = 0;
 
+    wait_font();
     if (!ctx.face) {
         return false;
     }
@@ -188,29 +333,29 @@ bool font_render(const char* text, struct text_surface* surface)
     // draw glyphs
     it = wide;
     while (*it) {
+        const struct glyph* glyph;
         if (*it == L' ') {
             x += space_size;
-        } else if (FT_Load_Char(ctx.face, *it, FT_LOAD_RENDER) == 0) {
-            const FT_GlyphSlot glyph = ctx.face->glyph;
-            const FT_Bitmap* bmp = &glyph->bitmap;
-            const size_t off_y = base_offset - glyph->bitmap_top;
+        } else if ((glyph = get_glyph(*it))) {
+            const uint8_t* bmp = ctx.atlas + glyph->offset;
+            const size_t off_y = base_offset - glyph->top;
             size_t size;
 
             // calc line width, floating point math doesn't match bmp width
-            if (x + bmp->width < surface->width) {
-                size = bmp->width;
+            if (x + glyph->width < surface->width) {
+                size = glyph->width;
             } else {
                 size = surface->width - x;
             }
 
             // put glyph's bitmap on the surface
-            for (size_t y = 0; y < bmp->rows; ++y) {
+            for (size_t y = 0; y < glyph->rows; ++y) {
                 const size_t offset = (y + off_y) * surface->width + x;
-                uint8_t* dst = &surface->data[offset + glyph->bitmap_left];
-                memcpy(dst, &bmp->buffer[y * bmp->pitch], size);
+                uint8_t* dst = &surface->data[offset + glyph->left];
+                memcpy(dst, &bmp[y * glyph->width], size);
             }
 
-            x += glyph->advance.x / POINT_FACTOR;
+            x += glyph->advance / POINT_FACTOR;
         }
         ++it;
     }
@@ -220,6 +365,11 @@ bool font_render(const char* text, struct text_surface* surface)
     return true;
 }
 
+size_t font_margin(const struct text_surface* text)
+{
+    return max(BACKGROUND_PADDING, max(1, text->height / 16));
+}
+
 void font_print(struct pixmap* wnd, ssize_t x, ssize_t y,
                 const struct text_surface* text)
 {
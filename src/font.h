@@ -38,6 +38,13 @@ void font_destroy(void);
  */
 bool font_render(const char* text, struct text_surface* surface);
 
+/**
+ * Get size of the margin around printed text (background and shadow).
+ * @param text text surface
+ * @return margin size in pixels
+ */
+size_t font_margin(const struct text_surface* text);
+
 /**
  * Print surface line on the window.
  * @param wnd destination window
@@ -2,9 +2,11 @@
 // AV1 (AVIF/AVIFS) format decoder.
 // Copyright (C) 2023 Artem Senichev <artemsen@gmail.com>
 
+#include "../animation.h"
 #include "../loader.h"
 
 #include <avif/avif.h>
+#include <stdlib.h>
 #include <string.h>
 
 // AVI signature
@@ -70,6 +72,11 @@ static int decode_frames(struct image* ctx, avifDecoder* decoder)
     }
 
     for (size_t i = 0; i < ctx->num_frames; ++i) {
+        if (image_cancelled(ctx)) {
+            rc = AVIF_RESULT_UNKNOWN_ERROR;
+            break;
+        }
+
         rc = avifDecoderNthImage(decoder, i);
         if (rc != AVIF_RESULT_OK) {
             break;
@@ -119,6 +126,112 @@ static int decode_frames(struct image* ctx, avifDecoder* decoder)
     return rc;
 }
 
+/** Animation decoded on demand. */
+struct avif_anim {
+    avifDecoder* decoder; ///< AV1 decoder
+    size_t size;          ///< Size of the raw image data
+    uint8_t data[];       ///< Raw image data used by the decoder
+};
+
+/** Decode next frame of the animation, see `anim_decode_fn`. */
+static bool anim_decode(void* data, struct pixmap* pm, size_t* duration)
+{
+    struct avif_anim* anim = data;
+    avifDecoder* decoder = anim->decoder;
+    avifRGBImage rgb = { 0 };
+    avifResult rc;
+
+    rc = avifDecoderNextImage(decoder);
+    if (rc == AVIF_RESULT_NO_IMAGES_REMAINING) {
+        rc = avifDecoderReset(decoder);
+        if (rc == AVIF_RESULT_OK) {
+            rc = avifDecoderNextImage(decoder);
+        }
+    }
+    if (rc != AVIF_RESULT_OK) {
+        return false;
+    }
+
+    avifRGBImageSetDefaults(&rgb, decoder->image);
+    rgb.depth = 8;
+    rgb.format = AVIF_RGB_FORMAT_BGRA;
+#if AVIF_VERSION_MAJOR > 0
+    rc =
+#endif
+        avifRGBImageAllocatePixels(&rgb);
+#if AVIF_VERSION_MAJOR > 0
+    if (rc != AVIF_RESULT_OK) {
+        return false;
+    }
+#endif
+
+    rc = avifImageYUVToRGB(decoder->image, &rgb);
+    if (rc == AVIF_RESULT_OK && rgb.width == pm->width &&
+        rgb.height == pm->height) {
+        memcpy(pm->data, rgb.pixels, rgb.width * rgb.height * sizeof(argb_t));
+        *duration = (size_t)(decoder->imageTiming.duration * 1000.0);
+    } else {
+        rc = AVIF_RESULT_UNKNOWN_ERROR;
+    }
+
+    avifRGBImageFreePixels(&rgb);
+
+    return rc == AVIF_RESULT_OK;
+}
+
+/** Free animation decoder, see `anim_free_fn`. */
+static void anim_free(void* data)
+{
+    struct avif_anim* anim = data;
+    if (anim->decoder) {
+        avifDecoderDestroy(anim->decoder);
+    }
+    free(anim);
+}
+
+/**
+ * Setup animation with frames decoded on demand.
+ * @param ctx image context
+ * @param data raw image data
+ * @param size size of image data in bytes
+ * @param width,height size of the animation canvas
+ * @param frames total number of frames
+ * @return true if completed successfully
+ */
+static bool decode_lazy(struct image* ctx, const uint8_t* data, size_t size,
+                        size_t width, size_t height, size_t frames)
+{
+    struct avif_anim* anim;
+    struct anim_decoder decoder = {
+        .decode = anim_decode,
+        .free = anim_free,
+    };
+
+    // decoder refers to the raw data, which is released after loading
+    anim = calloc(1, sizeof(*anim) + size);
+    if (!anim) {
+        return false;
+    }
+    anim->size = size;
+    memcpy(anim->data, data, size);
+
+    anim->decoder = avifDecoderCreate();
+    if (anim->decoder) {
+        // frames are decoded ahead in background, one thread is enough
+        anim->decoder->maxThreads = 1;
+    }
+    if (!anim->decoder ||
+        avifDecoderSetIOMemory(anim->decoder, anim->data, anim->size) !=
+            AVIF_RESULT_OK ||
+        avifDecoderParse(anim->decoder) != AVIF_RESULT_OK) {
+        anim_free(anim);
+        return false;
+    }
+    decoder.data = anim;
+
+    return animation_create(ctx, width, height, frames, &decoder);
+}
+
 // AV1 loader implementation
 enum loader_status decode_avif(struct image* ctx, const uint8_t* data,
                                size_t size)
@@ -138,6 +251,7 @@ enum loader_status decode_avif(struct image* ctx, const uint8_t* data,
     if (!decoder) {
         return ldr_fmterror;
     }
+    decoder->maxThreads = image_threads(ctx);
     rc = avifDecoderSetIOMemory(decoder, data, size);
     if (rc != AVIF_RESULT_OK) {
         goto fail;
@@ -147,7 +261,13 @@ enum loader_status decode_avif(struct image* ctx, const uint8_t* data,
         goto fail;
     }
 
-    if (decoder->imageCount > 1) {
+    if (animation_lazy(ctx, decoder->image->width, decoder->image->height,
+                       decoder->imageCount)) {
+        ret = decode_lazy(ctx, data, size, decoder->image->width,
+                          decoder->image->height, decoder->imageCount)
+            ? 0
+            : -1;
+    } else if (decoder->imageCount > 1) {
         ret = decode_frames(ctx, decoder);
     } else {
         ret = decode_frame(ctx, decoder);
@@ -3,6 +3,7 @@
 // Copyright (C) 2020 Artem Senichev <artemsen@gmail.com>
 
 #include "../loader.h"
+#include "../pixconv.h"
 
 #include <stdlib.h>
 
@@ -303,7 +304,40 @@ static bool decode_rle(struct image* ctx, const struct bmp_info* bmp,
 }
 
 /**
- * Decode uncompressed bitmap.
+ * Decode uncompressed 24/32-bit bitmap.
+ * Rows are written in the final order, the bitmap doesn't need to be flipped.
+ * @param img decoded image context
+ * @param bmp bitmap info
+ * @param fn row converter
+ * @param buffer input bitmap buffer
+ * @param buffer_sz size of buffer
+ * @return false if input buffer has errors
+ */
+static bool decode_direct(struct image* ctx, const struct bmp_info* bmp,
+                          pixconv_fn fn, const uint8_t* buffer,
+                          size_t buffer_sz)
+{
+    const struct pixmap* pm = &ctx->frames[0].pm;
+    const size_t stride = 4 * ((bmp->width * bmp->bpp + 31) / 32);
+
+    // check size of source buffer
+    if (buffer_sz < pm->height * stride) {
+        return false;
+    }
+
+    if (bmp->height > 0) {
+        // bottom-up bitmap
+        pixconv_image(ctx, buffer + (pm->height - 1) * stride,
+                      -(ssize_t)stride, fn);
+    } else {
+        pixconv_image(ctx, buffer, stride, fn);
+    }
+
+    return true;
+}
+
+/**
+ * Decode uncompressed indexed bitmap.
  * @param img decoded image context
  * @param palette color palette
  * @param buffer input bitmap buffer
@@ -327,12 +361,7 @@ static bool decode_rgb(struct image* ctx, const struct bmp_info* bmp,
         argb_t* dst = &pm->data[y * pm->width];
         const uint8_t* src_y = buffer + y * stride;
         for (size_t x = 0; x < pm->width; ++x) {
-            const uint8_t* src = src_y + x * (bmp->bpp / BITS_PER_BYTE);
-            if (bmp->bpp == 32) {
-                dst[x] = ARGB_SET_A(0xff) | *(uint32_t*)src;
-            } else if (bmp->bpp == 24) {
-                dst[x] = ARGB_SET_A(0xff) | *(uint32_t*)src;
-            } else if (bmp->bpp == 8 || bmp->bpp == 4 || bmp->bpp == 1) {
+            if (bmp->bpp == 8 || bmp->bpp == 4 || bmp->bpp == 1) {
                 // indexed colors
                 const size_t bits_offset = x * bmp->bpp;
                 const size_t byte_offset = bits_offset / BITS_PER_BYTE;
@@ -366,6 +395,7 @@ enum loader_status decode_bmp(struct image* ctx, const uint8_t* data,
     struct bmp_palette palette;
     const uint32_t* mask_location;
     struct bmp_mask mask;
+    bool flip;
     bool rc;
 
     hdr = (const struct bmp_file*)data;
@@ -383,10 +413,6 @@ enum loader_status decode_bmp(struct image* ctx, const uint8_t* data,
         return ldr_fmterror;
     }
 
-    if (!image_allocate_frame(ctx, abs(bmp->width), abs(bmp->height))) {
-        return ldr_fmterror;
-    }
-
     color_data = (const uint8_t*)bmp + bmp->dib_size;
     color_data_sz = hdr->offset - sizeof(struct bmp_file) - bmp->dib_size;
     palette.table = color_data;
@@ -410,8 +436,21 @@ enum loader_status decode_bmp(struct image* ctx, const uint8_t* data,
             bmp->dib_size > BITMAPINFOV2HEADER_SIZE ? mask_location[3] : 0;
     }
 
+    if (!image_allocate_frame(ctx, abs(bmp->width), abs(bmp->height))) {
+        return ldr_fmterror;
+    }
+
     // decode bitmap
-    if (bmp->compression == BI_BITFIELDS || bmp->bpp == 16) {
+    flip = bmp->height > 0;
+    if (bmp->compression == BI_BITFIELDS && bmp->bpp == 32 &&
+        mask.red == 0x00ff0000 && mask.green == 0x0000ff00 &&
+        mask.blue == 0x000000ff && mask.alpha == 0xff000000) {
+        // masks describe the ARGB layout, rows are copied as is
+        rc = decode_direct(ctx, bmp, pixconv_bgra32, data + hdr->offset,
+                           size - hdr->offset);
+        flip = false;
+        image_set_format(ctx, "BMP %dbit masked", bmp->bpp);
+    } else if (bmp->compression == BI_BITFIELDS || bmp->bpp == 16) {
         rc = decode_masked(ctx, bmp, &mask, data + hdr->offset,
                            size - hdr->offset);
         image_set_format(ctx, "BMP %dbit masked", bmp->bpp);
@@ -419,6 +458,13 @@ enum loader_status decode_bmp(struct image* ctx, const uint8_t* data,
         rc = decode_rle(ctx, bmp, &palette, data + hdr->offset,
                         size - hdr->offset);
         image_set_format(ctx, "BMP %dbit RLE", bmp->bpp);
+    } else if (bmp->compression == BI_RGB &&
+               (bmp->bpp == 24 || bmp->bpp == 32)) {
+        rc = decode_direct(ctx, bmp,
+                           bmp->bpp == 24 ? pixconv_bgr24 : pixconv_bgrx32,
+                           data + hdr->offset, size - hdr->offset);
+        flip = false;
+        image_set_format(ctx, "BMP %dbit uncompressed", bmp->bpp);
     } else if (bmp->compression == BI_RGB) {
         rc = decode_rgb(ctx, bmp, &palette, data + hdr->offset,
                         size - hdr->offset);
@@ -428,8 +474,8 @@ enum loader_status decode_bmp(struct image* ctx, const uint8_t* data,
     }
 
     if (rc) {
-        if (bmp->height > 0) {
-            image_flip_vertical(ctx);
+        if (flip) {
+            pixmap_flip_vertical(&ctx->frames[0].pm);
         }
         ctx->alpha = bmp->bpp == 32;
     } else {
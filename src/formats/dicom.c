@@ -3,6 +3,7 @@
 // Copyright (C) 2024 Artem Senichev <artemsen@gmail.com>
 
 #include "../loader.h"
+#include "../grayscale.h"
 
 #include <limits.h>
 #include <string.h>
@@ -195,9 +196,6 @@ enum loader_status decode_dicom(struct image* ctx, const uint8_t* data,
 {
     struct dicom_image dicom;
     struct stream stream;
-    struct pixmap* pm;
-    size_t total_pixels;
-    double pixel_coeff;
 
     // check signature
     if (size < DICOM_SIGNATURE_OFFSET + sizeof(signature) ||
@@ -228,28 +226,12 @@ enum loader_status decode_dicom(struct image* ctx, const uint8_t* data,
         }
     }
 
-    // Calculate coefficient for converting 16-bit color to 8-bit
-    if (dicom.px_max <= dicom.px_min) {
-        pixel_coeff = 1.0;
-    } else {
-        pixel_coeff = 256.0 / (dicom.px_max - dicom.px_min);
-    }
-
-    // allocate image buffer
-    pm = image_allocate_frame(ctx, dicom.width, dicom.height);
-    if (!pm) {
+    // samples are kept to change window/level without decoding
+    if (!grayscale_create(ctx, (const int16_t*)dicom.data, dicom.width,
+                          dicom.height, dicom.px_min, dicom.px_max)) {
         return ldr_fmterror;
     }
 
-    // decode image
-    total_pixels = dicom.width * dicom.height;
-    for (size_t i = 0; i < total_pixels; ++i) {
-        int16_t color = *((const int16_t*)dicom.data + i);
-        color -= dicom.px_min;
-        color *= pixel_coeff;
-        pm->data[i] = ARGB(0xff, color, color, color);
-    }
-
     image_set_format(ctx, "DICOM");
 
     return ldr_success;
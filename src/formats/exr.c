@@ -2,8 +2,12 @@
 // EXR format decoder.
 // Copyright (C) 2023 Artem Senichev <artemsen@gmail.com>
 
+#include "../array.h"
 #include "../loader.h"
+#include "../tiles.h"
+#include "../tpool.h"
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -19,7 +23,7 @@ static const uint8_t signature[] = { 0x76, 0x2f, 0x31, 0x01 };
 // EXR data buffer
 struct data_buffer {
     const uint8_t* data;
-    const size_t size;
+    size_t size;
 };
 
 // EXR data reader
@@ -82,240 +86,432 @@ static exr_result_t decode_chunk(const exr_context_t ectx,
     return exr_decoding_run(ectx, 0, decoder);
 }
 
+/** Channel of the unpacked pixel. */
+struct exr_channel {
+    size_t offset;         ///< Offset inside the pixel
+    exr_pixel_type_t type; ///< Data type
+    size_t shift;          ///< Position in ARGB value
+};
+
+/** Parallel decoding task. */
+struct exr_task {
+    exr_context_t ectx;      ///< EXR context
+    const struct image* img; ///< Image context
+    struct pixmap* pm;       ///< Destination pixmap
+    exr_attr_box2i_t dwnd;   ///< Data window
+    bool tiled;              ///< Storage type: tiles or scanlines
+    int32_t scanlines;       ///< Number of scanlines per chunk
+    int32_t tile_w, tile_h;  ///< Size of a single tile
+    size_t tiles_x;          ///< Number of tiles per line
+    uint64_t chunk_size;     ///< Max size of unpacked chunk
+    bool failed;             ///< Decoding error flag
+};
+
+// Half float to 8-bit intensity conversion table
+static uint8_t half_lut[1 << 16];
+static pthread_once_t half_lut_once = PTHREAD_ONCE_INIT;
+
 /**
- * Decode pixel.
- * @param decoder EXR decoder instance
- * @param unpacked pointer to unpacked data
- * @param size max number of bytes in unpacked buffer
- * @return ARGB value of the pixel
+ * Convert float intensity to 8-bit value.
+ * @param intensity color intensity
+ * @return color value
  */
-static argb_t decode_pixel(const exr_decode_pipeline_t* decoder,
-                           const uint8_t* unpacked, size_t size)
+static inline uint8_t intensity_to_color(float intensity)
 {
-    uint8_t a = 0xff, r = 0, g = 0, b = 0;
+    if (!(intensity > 0.0f)) {
+        return 0; // negative or NaN
+    }
+    if (intensity >= 1.0f) {
+        return 0xff;
+    }
+    return intensity * 0xff;
+}
 
-    for (int16_t i = 0; i < decoder->channel_count; ++i) {
-        const exr_coding_channel_info_t* channel = &decoder->channels[i];
-        float intensity = 0;
-        size_t color;
-
-        // it's all a dirty hack =)
-        switch (channel->data_type) {
-            case EXR_PIXEL_UINT:
-                break; // not supported
-            case EXR_PIXEL_HALF:
-                if (size >= sizeof(uint16_t)) {
-                    // convert half to float
-                    // todo
-                    // NOLINTNEXTLINE(clang-analyzer-core.uninitialized.Assign)
-                    const uint16_t half = *(const uint16_t*)unpacked;
-                    union {
-                        uint32_t i;
-                        float f;
-                    } hf;
-                    hf.i = (half & 0x8000) << 16;
-                    hf.i |= ((half & 0x7c00) + 0x1c000) << 13;
-                    hf.i |= (half & 0x03ff) << 13;
-                    intensity = hf.f;
-                }
-                break;
-            case EXR_PIXEL_FLOAT:
-                if (size >= sizeof(float)) {
-                    // todo
-                    // NOLINTNEXTLINE(clang-analyzer-core.uninitialized.Assign)
-                    intensity = *(const float*)unpacked;
-                }
-                break;
-            default:
-                break; // not supported
-        }
-        color = intensity * 0xff;
-        if (color > 0xff) {
-            color = 0xff;
+/** Fill the half float conversion table. */
+static void init_half_lut(void)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(half_lut); ++i) {
+        const uint32_t sign = (i & 0x8000) << 16;
+        const uint32_t exp = (i >> 10) & 0x1f;
+        uint32_t mant = i & 0x03ff;
+        union {
+            uint32_t i;
+            float f;
+        } hf;
+
+        if (exp == 0x1f) {
+            hf.i = sign | 0x7f800000 | (mant << 13); // inf or NaN
+        } else if (exp != 0) {
+            hf.i = sign | ((exp + 112) << 23) | (mant << 13);
+        } else if (mant != 0) {
+            // subnormal: normalize mantissa
+            uint32_t e = 113;
+            while (!(mant & 0x0400)) {
+                mant <<= 1;
+                --e;
+            }
+            hf.i = sign | (e << 23) | ((mant & 0x03ff) << 13);
+        } else {
+            hf.i = sign; // zero
         }
 
-        switch (*channel->channel_name) {
+        half_lut[i] = intensity_to_color(hf.f);
+    }
+}
+
+/**
+ * Get layout of unpacked pixel.
+ * @param decoder EXR decoder instance
+ * @param channels array of channels to fill
+ * @return number of supported channels
+ */
+static size_t get_layout(const exr_decode_pipeline_t* decoder,
+                         struct exr_channel* channels)
+{
+    size_t offset = 0;
+    size_t num = 0;
+
+    for (int16_t i = 0; i < decoder->channel_count && num < 4; ++i) {
+        const exr_coding_channel_info_t* cci = &decoder->channels[i];
+        struct exr_channel* ch = &channels[num];
+
+        ch->offset = offset;
+        ch->type = cci->data_type;
+        offset += cci->bytes_per_element;
+
+        if (ch->type != EXR_PIXEL_HALF && ch->type != EXR_PIXEL_FLOAT) {
+            continue; // not supported
+        }
+        switch (*cci->channel_name) {
             case 'A':
-                a = color;
+                ch->shift = ARGB_A_SHIFT;
                 break;
             case 'R':
-                r = color;
+                ch->shift = ARGB_R_SHIFT;
                 break;
             case 'G':
-                g = color;
+                ch->shift = ARGB_G_SHIFT;
                 break;
             case 'B':
-                b = color;
+                ch->shift = ARGB_B_SHIFT;
                 break;
             default:
-                break; // not supported
+                continue; // not supported
         }
-
-        unpacked += channel->bytes_per_element;
-        if (size <= (size_t)channel->bytes_per_element) {
-            break;
-        }
-        size -= channel->bytes_per_element;
+        ++num;
     }
 
-    return ARGB_SET_A(a) | ARGB_SET_R(r) | ARGB_SET_G(g) | ARGB_SET_B(b);
+    return num;
 }
 
 /**
- * Load scanlined EXR image.
- * @param ectx EXR context
- * @param pm destination pixmap
- * @return result code
+ * Put decoded chunk to the pixmap.
+ * @param task decoding task
+ * @param decoder EXR decoder instance
+ * @param chunk decoded chunk info
+ * @param buffer unpacked chunk data
+ * @param x,y position of the chunk in the pixmap
  */
-static exr_result_t load_scanlined(const exr_context_t ectx, struct pixmap* pm)
+static void put_chunk(const struct exr_task* task,
+                      const exr_decode_pipeline_t* decoder,
+                      const exr_chunk_info_t* chunk, const uint8_t* buffer,
+                      size_t x, size_t y)
 {
-    exr_result_t rc;
-    int32_t scanlines;
-    uint64_t chunk_size;
-    uint8_t* buffer = NULL;
-    exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
-    argb_t* dst = pm->data;
-    exr_attr_box2i_t dwnd;
+    struct pixmap* pm = task->pm;
+    struct exr_channel channels[4];
+    const size_t num = get_layout(decoder, channels);
+    size_t bpp = 0;
+    size_t width, height;
+    argb_t base = ARGB_SET_A(0xff);
 
-    // temporary buffer for decoded chunk's scanlines
-    rc = exr_get_chunk_unpacked_size(ectx, 0, &chunk_size);
-    if (rc != EXR_ERR_SUCCESS) {
-        return rc;
+    for (int16_t i = 0; i < decoder->channel_count; ++i) {
+        bpp += decoder->channels[i].bytes_per_element;
     }
-    buffer = malloc(chunk_size);
-    if (!buffer) {
-        return EXR_ERR_OUT_OF_MEMORY;
+    for (size_t i = 0; i < num; ++i) {
+        if (channels[i].shift == ARGB_A_SHIFT) {
+            base = 0; // alpha is set by the image
+        }
     }
 
-    // get image properties
-    rc = exr_get_data_window(ectx, 0, &dwnd);
-    if (rc != EXR_ERR_SUCCESS) {
-        goto done;
+    if (x >= pm->width || y >= pm->height) {
+        return;
     }
-    rc = exr_get_scanlines_per_chunk(ectx, 0, &scanlines);
-    if (rc != EXR_ERR_SUCCESS) {
-        goto done;
+    width = min((size_t)chunk->width, pm->width - x);
+    height = min((size_t)chunk->height, pm->height - y);
+
+    for (size_t row = 0; row < height; ++row) {
+        const uint8_t* src = buffer + row * chunk->width * bpp;
+        argb_t* dst = &pm->data[(y + row) * pm->width + x];
+
+        for (size_t col = 0; col < width; ++col) {
+            argb_t pixel = base;
+            for (size_t i = 0; i < num; ++i) {
+                const struct exr_channel* ch = &channels[i];
+                const uint8_t* ptr = src + ch->offset;
+                uint8_t color;
+                if (ch->type == EXR_PIXEL_HALF) {
+                    uint16_t half;
+                    memcpy(&half, ptr, sizeof(half));
+                    color = half_lut[half];
+                } else {
+                    float intensity;
+                    memcpy(&intensity, ptr, sizeof(intensity));
+                    color = intensity_to_color(intensity);
+                }
+                pixel |= (argb_t)color << ch->shift;
+            }
+            dst[col] = pixel;
+            src += bpp;
+        }
+    }
+}
+
+/**
+ * Decode range of chunks, see `tpool_fn`.
+ * @param data pointer to the decoding task
+ * @param low,high range of chunk indices
+ */
+static void decode_chunks(void* data, size_t low, size_t high)
+{
+    struct exr_task* task = data;
+    exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
+    exr_result_t rc = EXR_ERR_SUCCESS;
+    uint8_t* buffer;
+
+    // every thread has its own decoder and temporary buffer
+    buffer = malloc(task->chunk_size);
+    if (!buffer) {
+        __atomic_store_n(&task->failed, true, __ATOMIC_RELAXED);
+        return;
     }
 
-    // decode chunks
-    for (int32_t y = dwnd.min.y; y <= dwnd.max.y; y += scanlines) {
+    for (size_t i = low; i < high && rc == EXR_ERR_SUCCESS; ++i) {
         exr_chunk_info_t chunk;
-        int8_t bpp = 0;
+        size_t x, y;
 
-        rc = exr_read_scanline_chunk_info(ectx, 0, y, &chunk);
-        if (rc != EXR_ERR_SUCCESS) {
-            break;
-        }
-        rc = decode_chunk(ectx, &chunk, &decoder, buffer);
-        if (rc != EXR_ERR_SUCCESS) {
+        if (image_cancelled(task->img) ||
+            __atomic_load_n(&task->failed, __ATOMIC_RELAXED)) {
             break;
         }
 
-        // put pixels to final image
-        for (int16_t i = 0; i < decoder.channel_count; ++i) {
-            bpp += decoder.channels[i].bytes_per_element;
+        if (task->tiled) {
+            const size_t tx = i % task->tiles_x;
+            const size_t ty = i / task->tiles_x;
+            x = tx * task->tile_w;
+            y = ty * task->tile_h;
+            rc = exr_read_tile_chunk_info(task->ectx, 0, tx, ty, 0, 0, &chunk);
+        } else {
+            const int32_t line = task->dwnd.min.y + i * task->scanlines;
+            x = 0;
+            y = i * task->scanlines;
+            rc = exr_read_scanline_chunk_info(task->ectx, 0, line, &chunk);
         }
-        for (size_t i = 0; i < chunk_size; i += bpp) {
-            if (dst >= pm->data + (pm->width * pm->height)) {
-                goto done;
-            }
-            *dst = decode_pixel(&decoder, buffer + i, chunk_size - i);
-            ++dst;
+        if (rc == EXR_ERR_SUCCESS) {
+            rc = decode_chunk(task->ectx, &chunk, &decoder, buffer);
+        }
+        if (rc == EXR_ERR_SUCCESS) {
+            put_chunk(task, &decoder, &chunk, buffer, x, y);
         }
     }
 
-done:
-    exr_decoding_destroy(ectx, &decoder);
+    if (rc != EXR_ERR_SUCCESS) {
+        __atomic_store_n(&task->failed, true, __ATOMIC_RELAXED);
+    }
+
+    exr_decoding_destroy(task->ectx, &decoder);
     free(buffer);
-    return rc;
 }
 
 /**
- * Load tailed EXR image.
+ * Decode image, chunks are processed in parallel.
+ * @param ctx image context
  * @param ectx EXR context
  * @param pm destination pixmap
+ * @param storage storage type
  * @return result code
  */
-static exr_result_t load_tailed(const exr_context_t ectx, struct pixmap* pm)
+static exr_result_t decode_image(const struct image* ctx,
+                                 const exr_context_t ectx, struct pixmap* pm,
+                                 exr_storage_t storage)
 {
+    struct exr_task task = {
+        .ectx = ectx,
+        .img = ctx,
+        .pm = pm,
+        .tiled = (storage == EXR_STORAGE_TILED),
+    };
+    size_t chunks;
     exr_result_t rc;
-    uint64_t chunk_size;
-    uint8_t* buffer = NULL;
-    int32_t levels_x, levels_y;
-    exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
 
-    // temporary buffer for decoded chunk's scanlines
-    rc = exr_get_chunk_unpacked_size(ectx, 0, &chunk_size);
+    rc = exr_get_data_window(ectx, 0, &task.dwnd);
     if (rc != EXR_ERR_SUCCESS) {
         return rc;
     }
-    buffer = malloc(chunk_size);
-    if (!buffer) {
-        return EXR_ERR_OUT_OF_MEMORY;
+    rc = exr_get_chunk_unpacked_size(ectx, 0, &task.chunk_size);
+    if (rc != EXR_ERR_SUCCESS) {
+        return rc;
     }
 
-    rc = exr_get_tile_levels(ectx, 0, &levels_x, &levels_y);
-    if (rc != EXR_ERR_SUCCESS) {
-        goto done;
+    if (task.tiled) {
+        // only the full resolution level is used
+        int32_t lvl_w, lvl_h;
+        rc = exr_get_level_sizes(ectx, 0, 0, 0, &lvl_w, &lvl_h);
+        if (rc == EXR_ERR_SUCCESS) {
+            rc = exr_get_tile_sizes(ectx, 0, 0, 0, &task.tile_w,
+                                    &task.tile_h);
+        }
+        if (rc != EXR_ERR_SUCCESS) {
+            return rc;
+        }
+        if (task.tile_w <= 0 || task.tile_h <= 0) {
+            return EXR_ERR_BAD_CHUNK_LEADER;
+        }
+        task.tiles_x = (lvl_w + task.tile_w - 1) / task.tile_w;
+        chunks = task.tiles_x * ((lvl_h + task.tile_h - 1) / task.tile_h);
+    } else {
+        rc = exr_get_scanlines_per_chunk(ectx, 0, &task.scanlines);
+        if (rc != EXR_ERR_SUCCESS) {
+            return rc;
+        }
+        if (task.scanlines <= 0) {
+            return EXR_ERR_BAD_CHUNK_LEADER;
+        }
+        chunks = (pm->height + task.scanlines - 1) / task.scanlines;
     }
 
-    for (int32_t lvl_y = 0; lvl_y < levels_y; ++lvl_y) {
-        for (int32_t lvl_x = 0; lvl_x < levels_x; ++lvl_x) {
-            int32_t lvl_w, lvl_h;
-            int32_t tile_w, tile_h;
-            int tile_x, tile_y;
-            exr_chunk_info_t chunk;
-            exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
+    pthread_once(&half_lut_once, init_half_lut);
 
-            rc = exr_get_level_sizes(ectx, 0, lvl_x, lvl_y, &lvl_w, &lvl_h);
-            if (rc != EXR_ERR_SUCCESS) {
-                goto done;
-            }
-            rc = exr_get_tile_sizes(ectx, 0, lvl_x, lvl_y, &tile_w, &tile_h);
-            if (rc != EXR_ERR_SUCCESS) {
-                goto done;
-            }
+    if (image_threads(ctx) > 1) {
+        tpool_run(decode_chunks, &task, chunks, 1);
+    } else {
+        decode_chunks(&task, 0, chunks);
+    }
 
-            tile_y = 0;
-            for (int64_t img_y = 0; img_y < lvl_h; img_y += tile_h) {
-                tile_x = 0;
-                for (int64_t img_x = 0; img_x < lvl_w; img_x += tile_w) {
-                    int8_t bpp = 0;
-
-                    rc = exr_read_tile_chunk_info(ectx, 0, tile_x, tile_y,
-                                                  lvl_x, lvl_y, &chunk);
-                    if (rc != EXR_ERR_SUCCESS) {
-                        goto done;
-                    }
-                    rc = decode_chunk(ectx, &chunk, &decoder, buffer);
-                    if (rc != EXR_ERR_SUCCESS) {
-                        goto done;
-                    }
-
-                    // put pixels to final image
-                    for (int16_t i = 0; i < decoder.channel_count; ++i) {
-                        bpp += decoder.channels[i].bytes_per_element;
-                    }
-                    for (int32_t y = 0; y < chunk.height; ++y) {
-                        const uint8_t* src_line =
-                            &buffer[y * chunk.width * bpp];
-                        argb_t* dst_line = &pm->data[(img_y + y) * pm->width];
-                        for (int32_t x = 0; x < chunk.width; ++x) {
-                            dst_line[img_x + x] =
-                                decode_pixel(&decoder, src_line + x * bpp, 42);
-                        }
-                    }
-                    ++tile_x;
-                }
-                ++tile_y;
-            }
+    if (task.failed || image_cancelled(ctx)) {
+        return EXR_ERR_CORRUPT_CHUNK;
+    }
+
+    return EXR_ERR_SUCCESS;
+}
+
+/** Tile source of huge image. */
+struct exr_tiles {
+    struct tiles_data raw;         ///< Raw image data
+    struct data_buffer buf;        ///< Reader buffer
+    exr_context_t ectx;            ///< EXR context
+    exr_decode_pipeline_t decoder; ///< EXR decoder instance
+    uint8_t* buffer;               ///< Unpacked chunk data
+};
+
+/** Decode single tile, see `tiles_decode_fn`. */
+static bool tiles_decode(void* data, size_t level, size_t col, size_t row,
+                         struct pixmap* pm)
+{
+    struct exr_tiles* et = data;
+    const struct exr_task task = { .pm = pm };
+    exr_chunk_info_t chunk;
+    exr_result_t rc;
+
+    rc = exr_read_tile_chunk_info(et->ectx, 0, col, row, level, level,
+                                  &chunk);
+    if (rc == EXR_ERR_SUCCESS) {
+        rc = decode_chunk(et->ectx, &chunk, &et->decoder, et->buffer);
+    }
+    if (rc == EXR_ERR_SUCCESS) {
+        put_chunk(&task, &et->decoder, &chunk, et->buffer, 0, 0);
+    }
+
+    return rc == EXR_ERR_SUCCESS;
+}
+
+/** Free tile source, see `tiles_free_fn`. */
+static void tiles_release(void* data)
+{
+    struct exr_tiles* et = data;
+    if (et->ectx) {
+        exr_decoding_destroy(et->ectx, &et->decoder);
+        exr_finish(&et->ectx);
+    }
+    tiles_data_free(&et->raw);
+    free(et->buffer);
+    free(et);
+}
+
+/**
+ * Setup huge tiled image decoded by tiles on demand.
+ * @param ctx image context
+ * @param data,size raw image data
+ * @return true if completed successfully
+ */
+static bool decode_tiles(struct image* ctx, const uint8_t* data, size_t size)
+{
+    static const exr_decode_pipeline_t decoder =
+        EXR_DECODE_PIPELINE_INITIALIZER;
+    exr_context_initializer_t einit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    struct tiles_source source = {
+        .decode = tiles_decode,
+        .free = tiles_release,
+    };
+    struct exr_tiles* et;
+    int32_t levels_x, levels_y;
+    uint64_t chunk_size;
+
+    et = calloc(1, sizeof(*et));
+    if (!et) {
+        return false;
+    }
+    et->decoder = decoder;
+    source.data = et;
+    if (!tiles_data_init(&et->raw, ctx, data, size)) {
+        free(et);
+        return false;
+    }
+    et->buf.data = et->raw.data;
+    et->buf.size = et->raw.size;
+    einit.user_data = &et->buf;
+    einit.read_fn = exr_reader;
+    if (exr_start_read(&et->ectx, "exr", &einit) != EXR_ERR_SUCCESS) {
+        et->ectx = NULL;
+        tiles_release(et);
+        return false;
+    }
+
+    if (exr_get_chunk_unpacked_size(et->ectx, 0, &chunk_size) !=
+            EXR_ERR_SUCCESS ||
+        exr_get_tile_levels(et->ectx, 0, &levels_x, &levels_y) !=
+            EXR_ERR_SUCCESS) {
+        tiles_release(et);
+        return false;
+    }
+    et->buffer = malloc(chunk_size);
+    if (!et->buffer) {
+        tiles_release(et);
+        return false;
+    }
+
+    // mipmap levels (diagonal for ripmap images)
+    for (int32_t i = 0; i < levels_x && i < levels_y &&
+         source.num_levels < TILES_MAX_LEVELS;
+         ++i) {
+        struct tiles_level* lvl = &source.levels[source.num_levels];
+        int32_t width, height, tile_w, tile_h;
+        if (exr_get_level_sizes(et->ectx, 0, i, i, &width, &height) !=
+                EXR_ERR_SUCCESS ||
+            exr_get_tile_sizes(et->ectx, 0, i, i, &tile_w, &tile_h) !=
+                EXR_ERR_SUCCESS ||
+            width <= 0 || height <= 0 || tile_w <= 0 || tile_h <= 0) {
+            break;
         }
+        lvl->width = width;
+        lvl->height = height;
+        lvl->tile_width = tile_w;
+        lvl->tile_height = tile_h;
+        ++source.num_levels;
     }
 
-done:
-    exr_decoding_destroy(ectx, &decoder);
-    free(buffer);
-    return rc;
+    pthread_once(&half_lut_once, init_half_lut);
+
+    return tiles_create(ctx, &source);
 }
 
 // EXR loader implementation
@@ -353,13 +549,6 @@ enum loader_status decode_exr(struct image* ctx, const uint8_t* data,
         goto done;
     }
 
-    pm = image_allocate_frame(ctx, dwnd.max.x - dwnd.min.x + 1,
-                              dwnd.max.y - dwnd.min.y + 1);
-    if (!pm) {
-        rc = EXR_ERR_OUT_OF_MEMORY;
-        goto done;
-    }
-
     rc = exr_get_storage(exr, 0, &storage);
     if (rc != EXR_ERR_SUCCESS) {
         goto done;
@@ -368,10 +557,22 @@ enum loader_status decode_exr(struct image* ctx, const uint8_t* data,
     image_set_format(ctx, "EXR");
     ctx->alpha = true;
 
-    if (storage == EXR_STORAGE_SCANLINE) {
-        rc = load_scanlined(exr, pm);
-    } else if (storage == EXR_STORAGE_TILED) {
-        rc = load_tailed(exr, pm);
+    // huge tiled image is decoded by tiles on demand
+    if (storage == EXR_STORAGE_TILED &&
+        tiles_lazy(dwnd.max.x - dwnd.min.x + 1, dwnd.max.y - dwnd.min.y + 1) &&
+        decode_tiles(ctx, data, size)) {
+        goto done;
+    }
+
+    pm = image_allocate_frame(ctx, dwnd.max.x - dwnd.min.x + 1,
+                              dwnd.max.y - dwnd.min.y + 1);
+    if (!pm) {
+        rc = EXR_ERR_OUT_OF_MEMORY;
+        goto done;
+    }
+
+    if (storage == EXR_STORAGE_SCANLINE || storage == EXR_STORAGE_TILED) {
+        rc = decode_image(ctx, exr, pm, storage);
     } else {
         rc = EXR_ERR_FEATURE_NOT_IMPLEMENTED;
     }
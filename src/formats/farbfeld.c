@@ -2,6 +2,7 @@
 // Farbfeld format decoder
 
 #include "../loader.h"
+#include "../pixconv.h"
 
 #include <arpa/inet.h>
 #include <string.h>
@@ -28,9 +29,7 @@ enum loader_status decode_farbfeld(struct image* ctx, const uint8_t* data,
                                    size_t size)
 {
     const struct farbfeld_header* header = (const struct farbfeld_header*)data;
-    size_t width, height, total;
-    struct farbfeld_rgba* src;
-    argb_t* dst;
+    size_t width, height, stride;
 
     // check signature
     if (size < sizeof(*header) ||
@@ -49,13 +48,13 @@ enum loader_status decode_farbfeld(struct image* ctx, const uint8_t* data,
     data += sizeof(struct farbfeld_header);
 
     // decode image
-    dst = ctx->frames[0].pm.data;
-    src = (struct farbfeld_rgba*)data;
-    total = min(width * height, size / sizeof(struct farbfeld_rgba));
-    for (size_t i = 0; i < total; ++i) {
-        *dst = ARGB(src->a, src->r, src->g, src->b);
-        ++dst;
-        ++src;
+    stride = width * sizeof(struct farbfeld_rgba);
+    if (size >= stride * height) {
+        pixconv_image(ctx, data, stride, pixconv_rgba64be);
+    } else {
+        // truncated file, decode the available part only
+        pixconv_rgba64be(ctx->frames[0].pm.data, data,
+                         size / sizeof(struct farbfeld_rgba));
     }
 
     image_set_format(ctx, "Farbfeld");
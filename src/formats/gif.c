@@ -2,9 +2,11 @@
 // GIF format decoder.
 // Copyright (C) 2020 Artem Senichev <artemsen@gmail.com>
 
+#include "../animation.h"
 #include "../loader.h"
 
 #include <gif_lib.h>
+#include <stdlib.h>
 #include <string.h>
 
 // GIF signature
@@ -13,7 +15,7 @@ static const uint8_t signature[] = { 'G', 'I', 'F' };
 // Buffer description for GIF reader
 struct buffer {
     const uint8_t* data;
-    const size_t size;
+    size_t size;
     size_t position;
 };
 
@@ -29,67 +31,445 @@ static int gif_reader(GifFileType* gif, GifByteType* dst, int sz)
     return -1;
 }
 
+/** Frame area on the canvas. */
+struct area {
+    size_t x, y;          ///< Left top corner
+    size_t width, height; ///< Size of the area
+};
+
 /**
- * Decode single GIF frame.
- * @param ctx image context
- * @param gif gif context
- * @param index number of the frame to load
- * @return true if completed successfully
+ * Animation state: frames are composited on the canvas at playback time.
+ * Large animations are decoded frame by frame from the copy of the file
+ * data, others are stored as sub-rectangles of indexed pixels by libgif.
+ */
+struct gif_anim {
+    GifFileType* gif;     ///< GIF decoder
+    struct pixmap canvas; ///< Composition of the frames
+    struct pixmap saved;  ///< Canvas area saved before `DISPOSE_PREVIOUS`
+    size_t index;         ///< Index of the next frame to compose
+    size_t frames;        ///< Total number of frames
+    int disposal;         ///< Disposal mode of the previous frame
+    struct area area;     ///< Area of the previous frame
+    struct buffer buf;    ///< File data for decoding frame by frame
+    GifByteType* line;    ///< Line of indexed pixels
+    size_t line_size;     ///< Size of the line buffer
+};
+
+/**
+ * Get frame area clipped by the canvas.
+ * @param anim animation state
+ * @param desc frame description
+ * @return frame area
+ */
+static struct area frame_area(const struct gif_anim* anim,
+                              const GifImageDesc* desc)
+{
+    const size_t cw = anim->canvas.width;
+    const size_t ch = anim->canvas.height;
+    struct area area = { 0 };
+
+    if (desc->Left >= 0 && desc->Top >= 0 && (size_t)desc->Left < cw &&
+        (size_t)desc->Top < ch) {
+        area.x = desc->Left;
+        area.y = desc->Top;
+        area.width = (size_t)desc->Width > cw - area.x ? cw - area.x
+                                                       : (size_t)desc->Width;
+        area.height = (size_t)desc->Height > ch - area.y
+            ? ch - area.y
+            : (size_t)desc->Height;
+    }
+
+    return area;
+}
+
+/**
+ * Copy area between pixmaps of the same size.
+ * @param src source pixmap
+ * @param dst destination pixmap
+ * @param area area to copy
+ */
+static void copy_area(const struct pixmap* src, struct pixmap* dst,
+                      const struct area* area)
+{
+    for (size_t y = area->y; y < area->y + area->height; ++y) {
+        const size_t offset = y * src->width + area->x;
+        memcpy(dst->data + offset, src->data + offset,
+               area->width * sizeof(argb_t));
+    }
+}
+
+/**
+ * Prepare the canvas for the next frame: dispose the previous one.
+ * @param anim animation state
+ * @param ctl control block of the next frame
+ * @param area area of the next frame
+ */
+static void begin_frame(struct gif_anim* anim, const GraphicsControlBlock* ctl,
+                        const struct area* area)
+{
+    struct pixmap* canvas = &anim->canvas;
+
+    if (anim->index == 0) {
+        memset(canvas->data, 0,
+               canvas->width * canvas->height * sizeof(argb_t));
+    } else if (anim->disposal == DISPOSE_BACKGROUND) {
+        for (size_t y = anim->area.y; y < anim->area.y + anim->area.height;
+             ++y) {
+            memset(canvas->data + y * canvas->width + anim->area.x, 0,
+                   anim->area.width * sizeof(argb_t));
+        }
+    } else if (anim->disposal == DISPOSE_PREVIOUS && anim->saved.data) {
+        copy_area(&anim->saved, canvas, &anim->area);
+    }
+
+    if (ctl->DisposalMode == DISPOSE_PREVIOUS) {
+        if (anim->saved.data ||
+            pixmap_create(&anim->saved, canvas->width, canvas->height)) {
+            copy_area(canvas, &anim->saved, area);
+        }
+    }
+}
+
+/**
+ * Put line of the frame on the canvas.
+ * @param anim animation state
+ * @param ctl control block of the frame
+ * @param area area of the frame
+ * @param color_map palette of the frame
+ * @param y line number in the frame
+ * @param raster indexed pixels of the line
+ */
+static void put_line(struct gif_anim* anim, const GraphicsControlBlock* ctl,
+                     const struct area* area, const ColorMapObject* color_map,
+                     size_t y, const uint8_t* raster)
+{
+    struct pixmap* canvas = &anim->canvas;
+    argb_t* pixel = canvas->data + (area->y + y) * canvas->width + area->x;
+
+    for (size_t x = 0; x < area->width; ++x) {
+        const uint8_t color = raster[x];
+        if (color != ctl->TransparentColor && color < color_map->ColorCount) {
+            const GifColorType* rgb = &color_map->Colors[color];
+            *pixel = ARGB_SET_A(0xff) | ARGB_SET_R(rgb->Red) |
+                ARGB_SET_G(rgb->Green) | ARGB_SET_B(rgb->Blue);
+        }
+        ++pixel;
+    }
+}
+
+/**
+ * Finish composition of the frame.
+ * @param anim animation state
+ * @param ctl control block of the frame
+ * @param area area of the frame
+ * @return frame duration in milliseconds
+ */
+static size_t end_frame(struct gif_anim* anim, const GraphicsControlBlock* ctl,
+                        const struct area* area)
+{
+    anim->disposal = ctl->DisposalMode;
+    anim->area = *area;
+    if (++anim->index >= anim->frames) {
+        anim->index = 0;
+    }
+
+    // hundreds of second to ms
+    return ctl->DelayTime != 0 ? ctl->DelayTime * 10 : 100;
+}
+
+/**
+ * Compose the next frame loaded by libgif on the canvas.
+ * @param anim animation state
+ * @return frame duration in milliseconds
  */
-static bool decode_frame(struct image* ctx, GifFileType* gif, size_t index)
+static size_t compose_frame(struct gif_anim* anim)
 {
-    const SavedImage* img = &gif->SavedImages[index];
+    const SavedImage* img = &anim->gif->SavedImages[anim->index];
     const GifImageDesc* desc = &img->ImageDesc;
     const ColorMapObject* color_map =
-        desc->ColorMap ? desc->ColorMap : gif->SColorMap;
+        desc->ColorMap ? desc->ColorMap : anim->gif->SColorMap;
+    GraphicsControlBlock ctl = { .TransparentColor = NO_TRANSPARENT_COLOR };
+    const struct area area = frame_area(anim, desc);
+
+    DGifSavedExtensionToGCB(anim->gif, anim->index, &ctl);
+
+    begin_frame(anim, &ctl, &area);
+    for (size_t y = 0; y < area.height; ++y) {
+        put_line(anim, &ctl, &area, color_map, y,
+                 &img->RasterBits[y * desc->Width]);
+    }
+
+    return end_frame(anim, &ctl, &area);
+}
+
+/**
+ * Read the next frame from the file data and compose it on the canvas.
+ * @param anim animation state
+ * @param duration output frame duration in milliseconds
+ * @return false on errors
+ */
+static bool read_frame(struct gif_anim* anim, size_t* duration)
+{
+    // interlaced lines are stored in 4 passes
+    static const size_t offsets[] = { 0, 4, 2, 1 };
+    static const size_t steps[] = { 8, 8, 4, 2 };
+
     GraphicsControlBlock ctl = { .TransparentColor = NO_TRANSPARENT_COLOR };
-    struct image_frame* frame = &ctx->frames[index];
-
-    const size_t width = (size_t)desc->Width > frame->pm.width - desc->Left
-        ? frame->pm.width - desc->Left
-        : (size_t)desc->Width;
-    const size_t height = (size_t)desc->Height > frame->pm.height - desc->Top
-        ? frame->pm.height - desc->Top
-        : (size_t)desc->Height;
-
-    DGifSavedExtensionToGCB(gif, index, &ctl);
-
-    if (ctl.DisposalMode == DISPOSE_PREVIOUS && index < ctx->num_frames - 1) {
-        struct pixmap* next = &ctx->frames[index + 1].pm;
-        pixmap_copy(&frame->pm, next, 0, 0, false);
-    }
-
-    for (size_t y = 0; y < height; ++y) {
-        const uint8_t* raster = &img->RasterBits[y * desc->Width];
-        argb_t* pixel = frame->pm.data + desc->Top * frame->pm.width +
-            y * frame->pm.width + desc->Left;
-
-        for (size_t x = 0; x < width; ++x) {
-            const uint8_t color = raster[x];
-            if (color != ctl.TransparentColor &&
-                color < color_map->ColorCount) {
-                const GifColorType* rgb = &color_map->Colors[color];
-                *pixel = ARGB_SET_A(0xff) | ARGB_SET_R(rgb->Red) |
-                    ARGB_SET_G(rgb->Green) | ARGB_SET_B(rgb->Blue);
+    const GifImageDesc* desc;
+    const ColorMapObject* color_map;
+    struct area area;
+    size_t passes;
+    GifRecordType type;
+    GifByteType* ext;
+    int code, err;
+
+    // start from the beginning of the data
+    if (anim->index == 0) {
+        if (anim->gif) {
+            DGifCloseFile(anim->gif, NULL);
+        }
+        anim->buf.position = 0;
+        anim->gif = DGifOpen(&anim->buf, gif_reader, &err);
+        if (!anim->gif) {
+            return false;
+        }
+    }
+
+    // skip extensions up to the frame description
+    do {
+        if (DGifGetRecordType(anim->gif, &type) != GIF_OK ||
+            type == TERMINATE_RECORD_TYPE) {
+            return false;
+        }
+        if (type == EXTENSION_RECORD_TYPE) {
+            if (DGifGetExtension(anim->gif, &code, &ext) != GIF_OK) {
+                return false;
+            }
+            if (code == GRAPHICS_EXT_FUNC_CODE && ext) {
+                DGifExtensionToGCB(ext[0], ext + 1, &ctl);
+            }
+            while (ext) {
+                if (DGifGetExtensionNext(anim->gif, &ext) != GIF_OK) {
+                    return false;
+                }
             }
-            ++pixel;
         }
+    } while (type != IMAGE_DESC_RECORD_TYPE);
+
+    if (DGifGetImageDesc(anim->gif) != GIF_OK) {
+        return false;
+    }
+    desc = &anim->gif->Image;
+    color_map = desc->ColorMap ? desc->ColorMap : anim->gif->SColorMap;
+    if (!color_map || desc->Width <= 0 || desc->Height <= 0) {
+        return false;
     }
+    if ((size_t)desc->Width > anim->line_size) {
+        GifByteType* line = realloc(anim->line, desc->Width);
+        if (!line) {
+            return false;
+        }
+        anim->line = line;
+        anim->line_size = desc->Width;
+    }
+
+    area = frame_area(anim, desc);
+    begin_frame(anim, &ctl, &area);
 
-    if (ctl.DisposalMode == DISPOSE_DO_NOT && index < ctx->num_frames - 1) {
-        struct pixmap* next = &ctx->frames[index + 1].pm;
-        pixmap_copy(&frame->pm, next, 0, 0, false);
+    passes = desc->Interlace ? sizeof(offsets) / sizeof(offsets[0]) : 1;
+    for (size_t pass = 0; pass < passes; ++pass) {
+        const size_t step = desc->Interlace ? steps[pass] : 1;
+        for (size_t y = offsets[pass]; y < (size_t)desc->Height; y += step) {
+            if (DGifGetLine(anim->gif, anim->line, desc->Width) != GIF_OK) {
+                return false;
+            }
+            if (y < area.height) {
+                put_line(anim, &ctl, &area, color_map, y, anim->line);
+            }
+        }
     }
 
-    if (ctl.DelayTime != 0) {
-        frame->duration = ctl.DelayTime * 10; // hundreds of second to ms
-    } else {
-        frame->duration = 100;
+    *duration = end_frame(anim, &ctl, &area);
+
+    return true;
+}
+
+/** Decode next frame of the animation, see `anim_decode_fn`. */
+static bool anim_decode(void* data, struct pixmap* pm, size_t* duration)
+{
+    struct gif_anim* anim = data;
+    *duration = compose_frame(anim);
+    memcpy(pm->data, anim->canvas.data,
+           pm->width * pm->height * sizeof(argb_t));
+    return true;
+}
+
+/** Set position of the animation, see `anim_seek_fn`. */
+static bool anim_seek(void* data, size_t index)
+{
+    struct gif_anim* anim = data;
+    anim->index = 0;
+    while (anim->index != index) {
+        compose_frame(anim);
+    }
+    return true;
+}
+
+/** Decode next frame from the file data, see `anim_decode_fn`. */
+static bool stream_decode(void* data, struct pixmap* pm, size_t* duration)
+{
+    struct gif_anim* anim = data;
+    if (!read_frame(anim, duration)) {
+        return false;
     }
+    memcpy(pm->data, anim->canvas.data,
+           pm->width * pm->height * sizeof(argb_t));
+    return true;
+}
+
+/** Set position in the file data, see `anim_seek_fn`. */
+static bool stream_seek(void* data, size_t index)
+{
+    struct gif_anim* anim = data;
+    size_t duration;
 
+    anim->index = 0;
+    while (anim->index != index) {
+        if (!read_frame(anim, &duration)) {
+            return false;
+        }
+    }
     return true;
 }
 
+/** Free animation decoder, see `anim_free_fn`. */
+static void anim_free(void* data)
+{
+    struct gif_anim* anim = data;
+    pixmap_free(&anim->canvas);
+    pixmap_free(&anim->saved);
+    if (anim->gif) {
+        DGifCloseFile(anim->gif, NULL);
+    }
+    free((void*)anim->buf.data);
+    free(anim->line);
+    free(anim);
+}
+
+/**
+ * Setup animation, frames are composed on demand.
+ * @param ctx image context
+ * @param gif gif context, ownership is passed to the animation
+ * @return true if completed successfully
+ */
+static bool decode_animation(struct image* ctx, GifFileType* gif)
+{
+    struct gif_anim* anim;
+    struct anim_decoder decoder = {
+        .decode = anim_decode,
+        .seek = anim_seek,
+        .free = anim_free,
+    };
+
+    anim = calloc(1, sizeof(*anim));
+    if (!anim) {
+        DGifCloseFile(gif, NULL);
+        return false;
+    }
+    anim->gif = gif;
+    anim->frames = gif->ImageCount;
+    if (!pixmap_create(&anim->canvas, gif->SWidth, gif->SHeight)) {
+        anim_free(anim);
+        return false;
+    }
+    decoder.data = anim;
+
+    return animation_create(ctx, gif->SWidth, gif->SHeight, gif->ImageCount,
+                            &decoder);
+}
+
+/**
+ * Setup animation decoded frame by frame from the copy of the file data.
+ * @param ctx image context
+ * @param data,size file data
+ * @param width,height size of the canvas
+ * @param frames total number of frames
+ * @return true if completed successfully
+ */
+static bool decode_stream(struct image* ctx, const uint8_t* data, size_t size,
+                          size_t width, size_t height, size_t frames)
+{
+    struct gif_anim* anim;
+    uint8_t* copy;
+    struct anim_decoder decoder = {
+        .decode = stream_decode,
+        .seek = stream_seek,
+        .free = anim_free,
+    };
+
+    anim = calloc(1, sizeof(*anim));
+    copy = malloc(size);
+    if (!anim || !copy) {
+        free(anim);
+        free(copy);
+        return false;
+    }
+    memcpy(copy, data, size);
+    anim->buf.data = copy;
+    anim->buf.size = size;
+    anim->frames = frames;
+    if (!pixmap_create(&anim->canvas, width, height)) {
+        anim_free(anim);
+        return false;
+    }
+    decoder.data = anim;
+
+    return animation_create(ctx, width, height, frames, &decoder);
+}
+
+/**
+ * Count frames without decoding them.
+ * @param gif gif context at the beginning of the data
+ * @return number of frames, 0 on errors
+ */
+static size_t count_frames(GifFileType* gif)
+{
+    size_t frames = 0;
+    GifRecordType type;
+    GifByteType* block;
+    int code;
+
+    do {
+        if (DGifGetRecordType(gif, &type) != GIF_OK) {
+            return 0;
+        }
+        if (type == IMAGE_DESC_RECORD_TYPE) {
+            // skip compressed pixels
+            if (DGifGetImageDesc(gif) != GIF_OK ||
+                DGifGetCode(gif, &code, &block) != GIF_OK) {
+                return 0;
+            }
+            while (block) {
+                if (DGifGetCodeNext(gif, &block) != GIF_OK) {
+                    return 0;
+                }
+            }
+            ++frames;
+        } else if (type == EXTENSION_RECORD_TYPE) {
+            if (DGifGetExtension(gif, &code, &block) != GIF_OK) {
+                return 0;
+            }
+            while (block) {
+                if (DGifGetExtensionNext(gif, &block) != GIF_OK) {
+                    return 0;
+                }
+            }
+        }
+    } while (type != TERMINATE_RECORD_TYPE);
+
+    return frames;
+}
+
 //  GIF loader implementation
 enum loader_status decode_gif(struct image* ctx, const uint8_t* data,
                               size_t size)
@@ -100,6 +480,9 @@ enum loader_status decode_gif(struct image* ctx, const uint8_t* data,
         .size = size,
         .position = 0,
     };
+    struct gif_anim still = { 0 };
+    struct pixmap* pm;
+    size_t width, height, frames;
     int err;
 
     // check signature
@@ -108,42 +491,63 @@ enum loader_status decode_gif(struct image* ctx, const uint8_t* data,
         return ldr_unsupported;
     }
 
-    // decode
+    // get number of frames
     gif = DGifOpen(&buf, gif_reader, &err);
     if (!gif) {
         return ldr_fmterror;
     }
-    if (DGifSlurp(gif) != GIF_OK) {
-        goto fail;
+    width = gif->SWidth;
+    height = gif->SHeight;
+    frames = count_frames(gif);
+    DGifCloseFile(gif, NULL);
+    if (frames == 0) {
+        return ldr_fmterror;
     }
 
-    // allocate frame sequence
-    if (!image_create_frames(ctx, gif->ImageCount)) {
-        goto fail;
-    }
-    for (size_t i = 0; i < ctx->num_frames; ++i) {
-        struct pixmap* pm = &ctx->frames[i].pm;
-        if (!pixmap_create(pm, gif->SWidth, gif->SHeight)) {
-            goto fail;
+    ctx->alpha = true;
+
+    if (animation_lazy(ctx, width, height, frames)) {
+        if (!decode_stream(ctx, data, size, width, height, frames)) {
+            return ldr_fmterror;
         }
+        image_set_format(ctx, "GIF animation");
+        return ldr_success;
     }
 
-    // decode every frame
-    for (size_t i = 0; i < ctx->num_frames; ++i) {
-        if (!decode_frame(ctx, gif, i)) {
-            goto fail;
-        }
+    // decode all frames
+    buf.position = 0;
+    gif = DGifOpen(&buf, gif_reader, &err);
+    if (!gif) {
+        return ldr_fmterror;
     }
+    if (DGifSlurp(gif) != GIF_OK || gif->ImageCount <= 0) {
+        DGifCloseFile(gif, NULL);
+        return ldr_fmterror;
+    }
+    gif->UserData = NULL; // all data is read, buffer is no longer valid
 
-    image_set_format(ctx, "GIF%s", gif->ImageCount > 1 ? " animation" : "");
-    ctx->alpha = true;
+    if (gif->ImageCount > 1) {
+        if (!decode_animation(ctx, gif)) {
+            return ldr_fmterror;
+        }
+        image_set_format(ctx, "GIF animation");
+        return ldr_success;
+    }
 
+    // single frame
+    pm = image_allocate_frame(ctx, gif->SWidth, gif->SHeight);
+    if (!pm) {
+        DGifCloseFile(gif, NULL);
+        return ldr_fmterror;
+    }
+    still.gif = gif;
+    still.canvas = *pm;
+    still.frames = 1;
+    ctx->frames[0].duration = compose_frame(&still);
+    pixmap_free(&still.saved);
     DGifCloseFile(gif, NULL);
 
-    return ldr_success;
+    image_set_format(ctx, "GIF");
 
-fail:
-    DGifCloseFile(gif, NULL);
-    image_free_frames(ctx);
-    return ldr_fmterror;
+    return ldr_success;
 }
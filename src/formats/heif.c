@@ -2,6 +2,7 @@
 // HEIF and AVIF formats decoder.
 // Copyright (C) 2022 Artem Senichev <artemsen@gmail.com>
 
+#include "../array.h"
 #include "../exif.h"
 #include "../loader.h"
 #include "buildcfg.h"
@@ -36,13 +37,63 @@ static void read_exif(struct image* ctx, struct heif_image_handle* pih)
 }
 #endif // HAVE_LIBEXIF
 
+#if LIBHEIF_NUMERIC_VERSION >= 0x01130000
+// Decoding cancellation callback, see `heif_decoding_options`
+static int heif_cancel(void* data)
+{
+    return image_cancelled(data) ? 1 : 0;
+}
+#endif
+
+/**
+ * Get the smallest embedded thumbnail that is not smaller than the size hint.
+ * @param ctx image context
+ * @param pih handle of the primary image
+ * @return handle of the thumbnail or NULL if not found
+ */
+static struct heif_image_handle* get_thumbnail(const struct image* ctx,
+                                               struct heif_image_handle* pih)
+{
+    struct heif_image_handle* thumb = NULL;
+    heif_item_id ids[8];
+    int count;
+
+    count = heif_image_handle_get_list_of_thumbnail_IDs(pih, ids,
+                                                        ARRAY_SIZE(ids));
+    for (int i = 0; i < count; ++i) {
+        struct heif_image_handle* handle;
+        int width, height;
+
+        if (heif_image_handle_get_thumbnail(pih, ids[i], &handle).code !=
+            heif_error_Ok) {
+            continue;
+        }
+        width = heif_image_handle_get_width(handle);
+        height = heif_image_handle_get_height(handle);
+
+        if ((size_t)min(width, height) >= ctx->size_hint &&
+            (!thumb || width < heif_image_handle_get_width(thumb))) {
+            if (thumb) {
+                heif_image_handle_release(thumb);
+            }
+            thumb = handle;
+        } else {
+            heif_image_handle_release(handle);
+        }
+    }
+
+    return thumb;
+}
+
 // HEIF/AVIF loader implementation
 enum loader_status decode_heif(struct image* ctx, const uint8_t* data,
                                size_t size)
 {
     struct heif_context* heif = NULL;
     struct heif_image_handle* pih = NULL;
+    struct heif_image_handle* thumb = NULL;
     struct heif_image* img = NULL;
+    struct heif_decoding_options* options;
     struct heif_error err;
     const uint8_t* decoded;
     struct pixmap* pm;
@@ -57,6 +108,9 @@ enum loader_status decode_heif(struct image* ctx, const uint8_t* data,
     if (!heif) {
         goto done;
     }
+#if LIBHEIF_NUMERIC_VERSION >= 0x010d0000
+    heif_context_set_max_decoding_threads(heif, image_threads(ctx));
+#endif
     err = heif_context_read_from_memory(heif, data, size, NULL);
     if (err.code != heif_error_Ok) {
         goto done;
@@ -65,8 +119,24 @@ enum loader_status decode_heif(struct image* ctx, const uint8_t* data,
     if (err.code != heif_error_Ok) {
         goto done;
     }
-    err = heif_decode_image(pih, &img, heif_colorspace_RGB,
-                            heif_chroma_interleaved_RGBA, NULL);
+    if (ctx->size_hint) {
+        // use embedded thumbnail instead of the full image
+        thumb = get_thumbnail(ctx, pih);
+        if (thumb) {
+            ctx->full_width = heif_image_handle_get_width(pih);
+            ctx->full_height = heif_image_handle_get_height(pih);
+        }
+    }
+    options = heif_decoding_options_alloc();
+#if LIBHEIF_NUMERIC_VERSION >= 0x01130000
+    if (options) {
+        options->cancel_decoding = heif_cancel;
+        options->progress_user_data = ctx;
+    }
+#endif
+    err = heif_decode_image(thumb ? thumb : pih, &img, heif_colorspace_RGB,
+                            heif_chroma_interleaved_RGBA, options);
+    heif_decoding_options_free(options);
     if (err.code != heif_error_Ok) {
         goto done;
     }
@@ -107,6 +177,9 @@ done:
     if (img) {
         heif_image_release(img);
     }
+    if (thumb) {
+        heif_image_handle_release(thumb);
+    }
     if (pih) {
         heif_image_handle_release(pih);
     }
@@ -3,14 +3,22 @@
 // Copyright (C) 2020 Artem Senichev <artemsen@gmail.com>
 
 #include "../loader.h"
+#include "../tiles.h"
 
 #include <setjmp.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 // depends on stdio.h, uses FILE but doesn't include the header
 #include <jpeglib.h>
 
+// Region decoding: jpeg_crop_scanline() and jpeg_skip_scanlines()
+#if defined(LIBJPEG_TURBO_VERSION_NUMBER) && \
+    LIBJPEG_TURBO_VERSION_NUMBER >= 1005000
+#define HAVE_JPEG_CROP
+#endif
+
 // JPEG signature
 static const uint8_t signature[] = { 0xff, 0xd8 };
 
@@ -27,6 +35,206 @@ static void jpg_error_exit(j_common_ptr jpg)
     longjmp(err->setjmp, 1);
 }
 
+#ifdef HAVE_JPEG_CROP
+// Size of the tile on levels decoded by regions
+#define TILE_SIZE 1024
+// Number of levels produced by DCT scaling: 1/1, 1/2, 1/4 and 1/8
+#define DCT_LEVELS 4
+// Max number of columns of tiles with decoders kept opened
+#define CURSORS 8
+
+/** Decoder positioned inside a column of tiles. */
+struct jpeg_cursor {
+    struct jpeg_decompress_struct jpg; ///< Decompressor
+    struct jpg_error_manager err;      ///< Error handler
+    bool active;                       ///< Decompressor is created
+    size_t level;                      ///< Index of the level
+    size_t col;                        ///< Column of tiles
+    size_t crop_x;                     ///< First decoded column
+};
+
+/** Tile source of huge image. */
+struct jpeg_tiles {
+    struct tiles_data raw;                 ///< Raw image data
+    struct tiles_level levels[DCT_LEVELS]; ///< Pyramid levels
+    struct jpeg_cursor cursors[CURSORS];   ///< Opened decoders
+    uint8_t* line;                         ///< Buffer for decoded line
+};
+
+/**
+ * Start decoding column of tiles.
+ * @param jt tile source
+ * @param cur decoder to start
+ * @param level index of the level
+ * @param col column of tiles
+ */
+static void start_cursor(const struct jpeg_tiles* jt, struct jpeg_cursor* cur,
+                         size_t level, size_t col)
+{
+    const struct tiles_level* lvl = &jt->levels[level];
+    const size_t x = col * lvl->tile_width;
+    const size_t width = min(lvl->tile_width, lvl->width - x);
+    // neighbor columns are included for correct chroma upsampling on edges
+    JDIMENSION crop_x = x ? x - 1 : x;
+    JDIMENSION crop_width = min(x + width + 1, lvl->width) - crop_x;
+
+    cur->jpg.err = jpeg_std_error(&cur->err.mgr);
+    cur->err.mgr.error_exit = jpg_error_exit;
+    jpeg_create_decompress(&cur->jpg);
+    cur->active = true;
+    cur->level = level;
+    cur->col = col;
+
+    jpeg_mem_src(&cur->jpg, jt->raw.data, jt->raw.size);
+    jpeg_read_header(&cur->jpg, TRUE);
+    cur->jpg.scale_num = 1;
+    cur->jpg.scale_denom = 1 << level;
+    cur->jpg.out_color_space = JCS_EXT_BGRA;
+    jpeg_start_decompress(&cur->jpg);
+
+    // decode only columns of the tile, crop is aligned to iMCU boundaries
+    jpeg_crop_scanline(&cur->jpg, &crop_x, &crop_width);
+    cur->crop_x = crop_x;
+}
+
+/**
+ * Stop decoding column of tiles.
+ * @param cur decoder to stop
+ */
+static void stop_cursor(struct jpeg_cursor* cur)
+{
+    if (cur->active) {
+        jpeg_destroy_decompress(&cur->jpg);
+        cur->active = false;
+    }
+}
+
+/** Decode single tile, see `tiles_decode_fn`. */
+static bool tiles_decode(void* data, size_t level, size_t col, size_t row,
+                         struct pixmap* pm)
+{
+    struct jpeg_tiles* jt = data;
+    struct jpeg_cursor* cur = &jt->cursors[col % CURSORS];
+    const struct tiles_level* lvl = &jt->levels[level];
+    const size_t x = col * lvl->tile_width;
+    const size_t y = row * lvl->tile_height;
+    const size_t width = min(lvl->tile_width, lvl->width - x);
+    const size_t height = min(lvl->tile_height, lvl->height - y);
+
+    if (setjmp(cur->err.setjmp)) {
+        stop_cursor(cur);
+        return false;
+    }
+
+    // tiles are composed from top to bottom, so the decoder opened for the
+    // upper tile continues from its position instead of skipping all rows
+    // again, but the rows above can't be decoded again
+    if (cur->active &&
+        (cur->level != level || cur->col != col ||
+         cur->jpg.output_scanline > y)) {
+        stop_cursor(cur);
+    }
+    if (!cur->active) {
+        start_cursor(jt, cur, level, col);
+    }
+
+    // skipped rows are entropy decoded only
+    if (cur->jpg.output_scanline < y) {
+        const JDIMENSION skip = y - cur->jpg.output_scanline;
+        if (jpeg_skip_scanlines(&cur->jpg, skip) != skip) {
+            longjmp(cur->err.setjmp, 1);
+        }
+    }
+
+    for (size_t i = 0; i < height; ++i) {
+        if (jpeg_read_scanlines(&cur->jpg, &jt->line, 1) != 1) {
+            longjmp(cur->err.setjmp, 1);
+        }
+        memcpy(&pm->data[i * pm->width],
+               jt->line + (x - cur->crop_x) * sizeof(argb_t),
+               width * sizeof(argb_t));
+    }
+
+    if (cur->jpg.output_scanline >= cur->jpg.output_height) {
+        stop_cursor(cur); // the last tile in the column
+    }
+
+    return true;
+}
+
+/** Free tile source, see `tiles_free_fn`. */
+static void tiles_release(void* data)
+{
+    struct jpeg_tiles* jt = data;
+    for (size_t i = 0; i < CURSORS; ++i) {
+        stop_cursor(&jt->cursors[i]);
+    }
+    tiles_data_free(&jt->raw);
+    free(jt->line);
+    free(jt);
+}
+
+/**
+ * Setup huge image decoded by regions on demand.
+ * @param ctx image context
+ * @param jpg decompressor with read header
+ * @param data,size raw image data
+ * @return true if completed successfully
+ */
+static bool decode_tiles(struct image* ctx,
+                         const struct jpeg_decompress_struct* jpg,
+                         const uint8_t* data, size_t size)
+{
+    struct tiles_source source = {
+        .decode = tiles_decode,
+        .free = tiles_release,
+        .num_levels = DCT_LEVELS,
+    };
+    struct jpeg_tiles* jt;
+
+    // the rest of color spaces can't be converted to BGRA by the library,
+    // progressive image is entirely decoded on start of decompression
+    if ((jpg->jpeg_color_space != JCS_GRAYSCALE &&
+         jpg->jpeg_color_space != JCS_YCbCr &&
+         jpg->jpeg_color_space != JCS_RGB) ||
+        jpg->progressive_mode) {
+        return false;
+    }
+
+    jt = calloc(1, sizeof(*jt));
+    if (!jt) {
+        return false;
+    }
+    source.data = jt;
+    jt->line = malloc(jpg->image_width * sizeof(argb_t));
+    if (!jt->line || !tiles_data_init(&jt->raw, ctx, data, size)) {
+        free(jt->line);
+        free(jt);
+        return false;
+    }
+
+    for (size_t i = 0; i < DCT_LEVELS; ++i) {
+        struct tiles_level* lvl = &source.levels[i];
+        const size_t div = (size_t)1 << i;
+        lvl->width = (jpg->image_width + div - 1) / div;
+        lvl->height = (jpg->image_height + div - 1) / div;
+        if (i + 1 < DCT_LEVELS) {
+            lvl->tile_width = min(lvl->width, TILE_SIZE);
+            lvl->tile_height = min(lvl->height, TILE_SIZE);
+        } else {
+            // skipped rows still have to be entropy decoded, so the smallest
+            // level (used as overview) is decoded at once
+            lvl->tile_width = lvl->width;
+            lvl->tile_height = lvl->height;
+        }
+    }
+
+    memcpy(jt->levels, source.levels, sizeof(jt->levels));
+
+    return tiles_create(ctx, &source);
+}
+#endif // HAVE_JPEG_CROP
+
 // JPEG loader implementation
 enum loader_status decode_jpeg(struct image* ctx, const uint8_t* data,
                                size_t size)
@@ -34,6 +242,7 @@ enum loader_status decode_jpeg(struct image* ctx, const uint8_t* data,
     struct pixmap* pm;
     struct jpeg_decompress_struct jpg;
     struct jpg_error_manager err;
+    double scale;
 
     // check signature
     if (size < sizeof(signature) ||
@@ -52,11 +261,41 @@ enum loader_status decode_jpeg(struct image* ctx, const uint8_t* data,
     jpeg_create_decompress(&jpg);
     jpeg_mem_src(&jpg, data, size);
     jpeg_read_header(&jpg, TRUE);
-    jpeg_start_decompress(&jpg);
+
+#ifdef HAVE_JPEG_CROP
+    // huge image is decoded by regions on demand
+    if (tiles_lazy(jpg.image_width, jpg.image_height) &&
+        decode_tiles(ctx, &jpg, data, size)) {
+        image_set_format(ctx, "JPEG %dbit", jpg.num_components * 8);
+        jpeg_destroy_decompress(&jpg);
+        return ldr_success;
+    }
+#endif // HAVE_JPEG_CROP
+
+    // use DCT scaling to reduce the image
+    scale = image_hint_scale(ctx, jpg.image_width, jpg.image_height);
+    if (scale < 1.0) {
+        jpg.scale_num = 1;
+        jpg.scale_denom = 1;
+        while (jpg.scale_denom < 8 && scale * jpg.scale_denom * 2 <= 1.0) {
+            jpg.scale_denom *= 2;
+        }
+        if (jpg.scale_denom > 1) {
+            ctx->full_width = jpg.image_width;
+            ctx->full_height = jpg.image_height;
+        }
+    }
+
 #ifdef LIBJPEG_TURBO_VERSION
-    jpg.out_color_space = JCS_EXT_BGRA;
+    // the library writes final pixels, gray and RGB are expanded to BGRA
+    if (jpg.jpeg_color_space == JCS_GRAYSCALE ||
+        jpg.jpeg_color_space == JCS_YCbCr || jpg.jpeg_color_space == JCS_RGB) {
+        jpg.out_color_space = JCS_EXT_BGRA;
+    }
 #endif // LIBJPEG_TURBO_VERSION
 
+    jpeg_start_decompress(&jpg);
+
     pm = image_allocate_frame(ctx, jpg.output_width, jpg.output_height);
     if (!pm) {
         jpeg_destroy_decompress(&jpg);
@@ -65,9 +304,16 @@ enum loader_status decode_jpeg(struct image* ctx, const uint8_t* data,
 
     while (jpg.output_scanline < jpg.output_height) {
         uint8_t* line = (uint8_t*)&pm->data[jpg.output_scanline * pm->width];
+
+        if (image_cancelled(ctx)) {
+            image_free_frames(ctx);
+            jpeg_destroy_decompress(&jpg);
+            return ldr_fmterror;
+        }
+
         jpeg_read_scanlines(&jpg, &line, 1);
 
-        // convert grayscale to argb
+        // expand pixels in place, the line is still in the CPU cache
         if (jpg.out_color_components == 1) {
             uint32_t* pixel = (uint32_t*)line;
             for (int x = jpg.output_width - 1; x >= 0; --x) {
@@ -88,9 +334,11 @@ enum loader_status decode_jpeg(struct image* ctx, const uint8_t* data,
             }
         }
 #endif // LIBJPEG_TURBO_VERSION
+
+        image_progress(ctx, jpg.output_scanline);
     }
 
-    image_set_format(ctx, "JPEG %dbit", jpg.out_color_components * 8);
+    image_set_format(ctx, "JPEG %dbit", jpg.num_components * 8);
 
     jpeg_finish_decompress(&jpg);
     jpeg_destroy_decompress(&jpg);
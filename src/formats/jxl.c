@@ -3,9 +3,66 @@
 // Copyright (C) 2021 Artem Senichev <artemsen@gmail.com>
 
 #include "../loader.h"
+#include "../tpool.h"
 
 #include <jxl/decode.h>
 #include <stdlib.h>
+#include <string.h>
+
+/** Parallel task of the JPEG XL decoder. */
+struct jxl_task {
+    void* opaque;                ///< Decoder data
+    JxlParallelRunFunction func; ///< Task handler
+    uint32_t next;               ///< Next value to process
+    uint32_t end;                ///< End of the value range
+};
+
+/**
+ * Thread pool handler: each range of the pool is a decoder thread that
+ * processes values of the task until all of them are taken.
+ * @param data pointer to the task
+ * @param low,high decoder thread id range
+ */
+static void run_task(void* data, size_t low, size_t high)
+{
+    struct jxl_task* task = data;
+
+    for (size_t thread = low; thread < high; ++thread) {
+        uint32_t value;
+        while ((value = __atomic_fetch_add(&task->next, 1,
+                                           __ATOMIC_RELAXED)) < task->end) {
+            task->func(task->opaque, value, thread);
+        }
+    }
+}
+
+/**
+ * Parallel runner based on the common thread pool, see `JxlParallelRunner`.
+ */
+static JxlParallelRetCode run_parallel(__attribute__((unused)) void* runner,
+                                       void* opaque, JxlParallelRunInit init,
+                                       JxlParallelRunFunction func,
+                                       uint32_t start, uint32_t end)
+{
+    struct jxl_task task = {
+        .opaque = opaque,
+        .func = func,
+        .next = start,
+        .end = end,
+    };
+    size_t threads = tpool_threads();
+    JxlParallelRetCode rc;
+
+    if (end > start && threads > end - start) {
+        threads = end - start;
+    }
+    rc = init(opaque, threads);
+    if (rc == 0) {
+        tpool_run(run_task, &task, threads, 1);
+    }
+
+    return rc;
+}
 
 // JPEG XL loader implementation
 enum loader_status decode_jxl(struct image* ctx, const uint8_t* data,
@@ -41,6 +98,12 @@ enum loader_status decode_jxl(struct image* ctx, const uint8_t* data,
     if (status != JXL_DEC_SUCCESS) {
         goto fail;
     }
+    if (image_threads(ctx) > 1) {
+        status = JxlDecoderSetParallelRunner(jxl, run_parallel, NULL);
+        if (status != JXL_DEC_SUCCESS) {
+            goto fail;
+        }
+    }
 
     // process decoding
     status = JxlDecoderSubscribeEvents(
@@ -79,6 +142,7 @@ enum loader_status decode_jxl(struct image* ctx, const uint8_t* data,
                     goto fail;
                 }
                 ctx->frames = frames;
+                memset(&ctx->frames[frame_num], 0, sizeof(*ctx->frames));
                 if (!pixmap_create(&ctx->frames[frame_num].pm, info.xsize,
                                    info.ysize)) {
                     goto fail;
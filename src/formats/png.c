@@ -14,13 +14,16 @@ struct mem_reader {
     const uint8_t* data;
     const size_t size;
     size_t position;
+    const struct image* image;
 };
 
 // PNG reader callback, see `png_rw_ptr` in png.h
 static void png_reader(png_structp png, png_bytep buffer, size_t size)
 {
     struct mem_reader* reader = (struct mem_reader*)png_get_io_ptr(png);
-    if (reader && reader->position + size < reader->size) {
+    if (image_cancelled(reader->image)) {
+        png_error(png, "Decoding cancelled");
+    } else if (reader->position + size < reader->size) {
         memcpy(buffer, reader->data + reader->position, size);
         reader->position += size;
     } else {
@@ -28,6 +31,15 @@ static void png_reader(png_structp png, png_bytep buffer, size_t size)
     }
 }
 
+// PNG row callback, see `png_read_status_ptr` in png.h
+static void png_row(png_structp png, png_uint_32 row,
+                    __attribute__((unused)) int pass)
+{
+    const struct mem_reader* reader =
+        (const struct mem_reader*)png_get_io_ptr(png);
+    image_progress(reader->image, row);
+}
+
 /**
  * Bind pixmap with PNG line-reading decoder.
  * @param pm pixmap to bind
@@ -74,7 +86,14 @@ static bool decode_single(struct image* ctx, png_struct* png, png_info* info)
         return false;
     }
 
+    // interlaced image is filled in several passes, so only the final
+    // result can be displayed
+    if (png_get_interlace_type(png, info) == PNG_INTERLACE_NONE) {
+        png_set_read_status_fn(png, png_row);
+    }
+
     png_read_image(png, bind);
+    png_set_read_status_fn(png, NULL);
 
     free(bind);
 
@@ -239,6 +258,7 @@ enum loader_status decode_png(struct image* ctx, const uint8_t* data,
         .data = data,
         .size = size,
         .position = 0,
+        .image = ctx,
     };
 
     // check signature
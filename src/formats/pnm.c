@@ -3,6 +3,8 @@
 // Copyright (C) 2023 Abe Wieland <abe.wieland@gmail.com>
 
 #include "../loader.h"
+#include "../pixconv.h"
+#include "../tpool.h"
 
 #include <limits.h>
 
@@ -34,6 +36,20 @@ struct pnm_iter {
 // Digits in INT_MAX
 #define INT_MAX_DIGITS 10
 
+// Min number of pixels decoded by a single thread
+#define TASK_MIN_PIXELS (64 * 1024)
+
+// Raw image decoding task
+struct pnm_task {
+    struct pixmap* pm;  // destination pixmap
+    const uint8_t* src; // first raw row
+    size_t rowsz;       // size of raw row in bytes
+    enum pnm_type type; // type of PNM file
+    size_t bpc;         // bytes per channel
+    int maxval;         // maximum value for each sample
+    int error;          // error code, 0 if all rows are decoded
+};
+
 /**
  * Read an integer, ignoring leading whitespace and comments
  * @param it image iterator
@@ -86,15 +102,17 @@ static int pnm_readint(struct pnm_iter* it, size_t digits)
 
 /**
  * Decode a plain/ASCII PNM file
- * @param pm pixel map to write data to
+ * @param ctx image context
  * @param it image iterator
  * @param type type of PNM file
  * @param maxval maximum value for each sample
  * @return 0 on success, error code on failure
  */
-static int decode_plain(struct pixmap* pm, struct pnm_iter* it,
+static int decode_plain(const struct image* ctx, struct pnm_iter* it,
                         enum pnm_type type, int maxval)
 {
+    struct pixmap* pm = &ctx->frames[0].pm;
+
     for (size_t y = 0; y < pm->height; ++y) {
         argb_t* dst = pm->data + y * pm->width;
         for (size_t x = 0; x < pm->width; ++x) {
@@ -151,71 +169,142 @@ static int decode_plain(struct pixmap* pm, struct pnm_iter* it,
             }
             dst[x] = pix;
         }
+        image_progress(ctx, y + 1);
+    }
+    return 0;
+}
+
+/**
+ * Decode a single row of raw/binary PNM file
+ * @param task decoding task
+ * @param y number of the row
+ * @return 0 on success, error code on failure
+ */
+static int decode_raw_row(const struct pnm_task* task, size_t y)
+{
+    const struct pixmap* pm = task->pm;
+    const int maxval = task->maxval;
+    const size_t bpc = task->bpc;
+    argb_t* dst = pm->data + y * pm->width;
+    const uint8_t* src = task->src + y * task->rowsz;
+
+    for (size_t x = 0; x < pm->width; ++x) {
+        argb_t pix = ARGB_SET_A(0xff);
+        if (task->type == pnm_pbm) {
+            const int bit = (src[x / 8] >> (7 - x % 8)) & 1;
+            pix |= bit - 1;
+        } else if (task->type == pnm_pgm) {
+            int v = bpc == 1 ? src[x] : src[x * 2] << 8 | src[x * 2 + 1];
+            if (v > maxval) {
+                return PNM_EOVF;
+            }
+            if (maxval != UINT8_MAX) {
+                v = div_near(v * UINT8_MAX, maxval);
+            }
+            pix |= ARGB_SET_R(v) | ARGB_SET_G(v) | ARGB_SET_B(v);
+        } else {
+            int r, g, b;
+            if (bpc == 1) {
+                r = src[x * 3];
+                g = src[x * 3 + 1];
+                b = src[x * 3 + 2];
+            } else {
+                r = src[x * 6] << 8 | src[x * 6 + 1];
+                g = src[x * 6 + 2] << 8 | src[x * 6 + 3];
+                b = src[x * 6 + 4] << 8 | src[x * 6 + 5];
+            }
+            if (r > maxval || g > maxval || b > maxval) {
+                return PNM_EOVF;
+            }
+            if (maxval != UINT8_MAX) {
+                r = div_near(r * UINT8_MAX, maxval);
+                g = div_near(g * UINT8_MAX, maxval);
+                b = div_near(b * UINT8_MAX, maxval);
+            }
+            pix |= ARGB_SET_R(r) | ARGB_SET_G(g) | ARGB_SET_B(b);
+        }
+        dst[x] = pix;
     }
+
     return 0;
 }
 
+/**
+ * Decode a band of rows of raw/binary PNM file, tpool handler
+ * @param data decoding task
+ * @param low,high range of rows to decode
+ */
+static void decode_raw_rows(void* data, size_t low, size_t high)
+{
+    struct pnm_task* task = data;
+
+    for (size_t y = low; y < high; ++y) {
+        int rc;
+        if (__atomic_load_n(&task->error, __ATOMIC_RELAXED)) {
+            break; // stop on errors in other bands
+        }
+        rc = decode_raw_row(task, y);
+        if (rc) {
+            __atomic_store_n(&task->error, rc, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+}
+
 /**
  * Decode a raw/binary PNM file
- * @param f image frame to write data to
+ * @param ctx image context
  * @param it image iterator
  * @param type type of PNM file
  * @param maxval maximum value for each sample
  * @return 0 on success, error code on failure
  */
-static int decode_raw(struct pixmap* pm, struct pnm_iter* it,
+static int decode_raw(const struct image* ctx, struct pnm_iter* it,
                       enum pnm_type type, int maxval)
 {
+    struct pixmap* pm = &ctx->frames[0].pm;
+
     // PGM and PPM use bpc (bytes per channel) bytes for each channel depending
     // on the max, with 1 channel for PGM and 3 for PPM; PBM pads each row to
     // the nearest whole byte
-    size_t bpc = maxval <= UINT8_MAX ? 1 : 2;
-    size_t rowsz = type == pnm_pbm
+    struct pnm_task task = {
+        .pm = pm,
+        .src = it->pos,
+        .type = type,
+        .bpc = maxval <= UINT8_MAX ? 1 : 2,
+        .maxval = maxval,
+    };
+    task.rowsz = type == pnm_pbm
         ? div_ceil(pm->width, 8)
-        : pm->width * bpc * (type == pnm_pgm ? 1 : 3);
-    if (it->end < it->pos + pm->height * rowsz) {
+        : pm->width * task.bpc * (type == pnm_pgm ? 1 : 3);
+    if (it->end < it->pos + pm->height * task.rowsz) {
         return PNM_EEOF;
     }
+
+    // 8-bit samples are always in range and don't need to be scaled
+    if (maxval == UINT8_MAX) {
+        if (type == pnm_pgm) {
+            pixconv_image(ctx, it->pos, task.rowsz, pixconv_gray8);
+            return 0;
+        }
+        if (type == pnm_ppm) {
+            pixconv_image(ctx, it->pos, task.rowsz, pixconv_rgb24);
+            return 0;
+        }
+    }
+
+    if (image_threads(ctx) > 1) {
+        const size_t min_rows = max(1, TASK_MIN_PIXELS / pm->width);
+        tpool_run(decode_raw_rows, &task, pm->height, min_rows);
+        return task.error;
+    }
+
     for (size_t y = 0; y < pm->height; ++y) {
-        argb_t* dst = pm->data + y * pm->width;
-        const uint8_t* src = it->pos + y * rowsz;
-        for (size_t x = 0; x < pm->width; ++x) {
-            argb_t pix = ARGB_SET_A(0xff);
-            if (type == pnm_pbm) {
-                const int bit = (src[x / 8] >> (7 - x % 8)) & 1;
-                pix |= bit - 1;
-            } else if (type == pnm_pgm) {
-                int v = bpc == 1 ? src[x] : src[x] << 8 | src[x + 1];
-                if (v > maxval) {
-                    return PNM_EOVF;
-                }
-                if (maxval != UINT8_MAX) {
-                    v = div_near(v * UINT8_MAX, maxval);
-                }
-                pix |= ARGB_SET_R(v) | ARGB_SET_G(v) | ARGB_SET_B(v);
-            } else {
-                int r, g, b;
-                if (bpc == 1) {
-                    r = src[x * 3];
-                    g = src[x * 3 + 1];
-                    b = src[x * 3 + 2];
-                } else {
-                    r = src[x * 3] << 8 | src[x * 3 + 1];
-                    g = src[x * 3 + 2] << 8 | src[x * 3 + 3];
-                    b = src[x * 3 + 4] << 8 | src[x * 3 + 5];
-                }
-                if (r > maxval || g > maxval || b > maxval) {
-                    return PNM_EOVF;
-                }
-                if (maxval != UINT8_MAX) {
-                    r = div_near(r * UINT8_MAX, maxval);
-                    g = div_near(g * UINT8_MAX, maxval);
-                    b = div_near(b * UINT8_MAX, maxval);
-                }
-                pix |= ARGB_SET_R(r) | ARGB_SET_G(g) | ARGB_SET_B(b);
-            }
-            dst[x] = pix;
+        const int rc = decode_raw_row(&task, y);
+        if (rc) {
+            return rc;
         }
+        image_progress(ctx, y + 1);
     }
     return 0;
 }
@@ -295,8 +384,8 @@ enum loader_status decode_pnm(struct image* ctx, const uint8_t* data,
         return ldr_fmterror;
     }
 
-    ret = plain ? decode_plain(&ctx->frames[0].pm, &it, type, maxval)
-                : decode_raw(&ctx->frames[0].pm, &it, type, maxval);
+    ret = plain ? decode_plain(ctx, &it, type, maxval)
+                : decode_raw(ctx, &it, type, maxval);
     if (ret < 0) {
         image_free_frames(ctx);
         return ldr_fmterror;
@@ -45,6 +45,7 @@ enum loader_status decode_qoi(struct image* ctx, const uint8_t* data,
     struct pixmap* pm;
     uint8_t a, r, g, b;
     size_t total_pixels;
+    size_t row_end;
     size_t rlen;
     size_t pos;
 
@@ -73,6 +74,7 @@ enum loader_status decode_qoi(struct image* ctx, const uint8_t* data,
     rlen = 0;
     pos = sizeof(struct qoi_header);
     total_pixels = pm->width * pm->height;
+    row_end = pm->width;
     memset(color_map, 0, sizeof(color_map));
 
     // decode image
@@ -128,6 +130,11 @@ enum loader_status decode_qoi(struct image* ctx, const uint8_t* data,
             color_map[QOI_CLRMAP_INDEX(r, g, b, a)] = ARGB(a, r, g, b);
         }
         pm->data[i] = ARGB(a, r, g, b);
+
+        if (i + 1 == row_end) {
+            image_progress(ctx, row_end / pm->width);
+            row_end += pm->width;
+        }
     }
 
     image_set_format(ctx, "QOI %dbpp", qoi->channels * 8);
@@ -11,6 +11,67 @@
 #include <libraw.h>
 #pragma GCC diagnostic pop
 
+// Min size of embedded preview displayed while the full image is decoding
+#define PREVIEW_MIN_SIZE 1024
+
+// libraw progress callback, see `progress_callback` in libraw_types.h
+static int raw_progress(void* data,
+                        __attribute__((unused)) enum LibRaw_progress stage,
+                        __attribute__((unused)) int iteration,
+                        __attribute__((unused)) int expected)
+{
+    // non-zero return value cancels processing
+    return image_cancelled(data) ? 1 : 0;
+}
+
+/**
+ * Decode embedded preview if it is not smaller than the specified size.
+ * @param ctx image context
+ * @param decoder libraw decoder with opened image
+ * @param min_size min size of the preview
+ * @return true if preview was decoded
+ */
+static bool decode_preview(struct image* ctx, libraw_data_t* decoder,
+                           size_t min_size)
+{
+    const libraw_thumbnail_t* thumb = &decoder->thumbnail;
+    const struct pixmap* pm;
+
+    if (libraw_unpack_thumb(decoder) != LIBRAW_SUCCESS ||
+        thumb->tformat != LIBRAW_THUMBNAIL_JPEG ||
+        min(thumb->twidth, thumb->theight) < min_size) {
+        return false;
+    }
+    if (loader_decode_embedded(ctx, (const uint8_t*)thumb->thumb,
+                               thumb->tlength) != ldr_success) {
+        return false;
+    }
+    pm = &ctx->frames[0].pm;
+    if (min(pm->width, pm->height) < min_size) {
+        image_free_frames(ctx);
+        return false;
+    }
+
+    // preview is stored without rotation, as the full size raw data
+    ctx->full_width = decoder->sizes.width;
+    ctx->full_height = decoder->sizes.height;
+    switch (decoder->sizes.flip) {
+        case 3:
+            image_rotate(ctx, 180);
+            break;
+        case 5:
+            image_rotate(ctx, 270);
+            break;
+        case 6:
+            image_rotate(ctx, 90);
+            break;
+        default:
+            break;
+    }
+
+    return true;
+}
+
 // Raw loader implementation
 enum loader_status decode_raw(struct image* ctx, const uint8_t* data,
                               size_t size)
@@ -24,12 +85,27 @@ enum loader_status decode_raw(struct image* ctx, const uint8_t* data,
     if (!decoder) {
         return ldr_unsupported;
     }
+    libraw_set_progress_handler(decoder, raw_progress, ctx);
 
     rc = libraw_open_buffer(decoder, data, size);
     if (rc != LIBRAW_SUCCESS) {
         goto fail;
     }
 
+    if (ctx->size_hint && decode_preview(ctx, decoder, ctx->size_hint)) {
+        image_set_format(ctx, "RAW (preview)");
+        libraw_close(decoder);
+        return ldr_success;
+    }
+
+    // show preview while the full image is decoding in background
+    ctx->preview = ctx->allow_preview;
+    if (ctx->preview && decode_preview(ctx, decoder, PREVIEW_MIN_SIZE)) {
+        image_set_format(ctx, "RAW (preview)");
+        libraw_close(decoder);
+        return ldr_success;
+    }
+
     rc = libraw_unpack(decoder);
     if (rc != LIBRAW_SUCCESS) {
         goto fail;
@@ -37,6 +113,17 @@ enum loader_status decode_raw(struct image* ctx, const uint8_t* data,
 
     decoder->params.output_bps = 8;
 
+    // skip demosaicing to get an image of half size
+    if (ctx->preview ||
+        image_hint_scale(ctx, decoder->sizes.width, decoder->sizes.height) <=
+            0.5) {
+        // output image is rotated by libraw
+        const bool swap = decoder->sizes.flip & 4;
+        decoder->params.half_size = 1;
+        ctx->full_width = swap ? decoder->sizes.height : decoder->sizes.width;
+        ctx->full_height = swap ? decoder->sizes.width : decoder->sizes.height;
+    }
+
     rc = libraw_dcraw_process(decoder);
     if (rc != LIBRAW_SUCCESS) {
         goto fail;
@@ -65,7 +152,7 @@ enum loader_status decode_raw(struct image* ctx, const uint8_t* data,
         ++pos;
     }
 
-    image_set_format(ctx, "RAW");
+    image_set_format(ctx, ctx->preview ? "RAW (preview)" : "RAW");
 
     libraw_dcraw_clear_mem(raw_img);
     libraw_close(decoder);
@@ -5,6 +5,8 @@
 #include "../loader.h"
 
 #include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
 #pragma GCC diagnostic push
@@ -49,6 +51,63 @@ static bool is_svg(const uint8_t* data, size_t size)
     return false;
 }
 
+/** Renderer of the scalable image. */
+struct svg_vector {
+    RsvgHandle* svg; ///< SVG handle
+    double width;    ///< Width of the document at scale 1.0
+    double height;   ///< Height of the document at scale 1.0
+};
+
+/**
+ * Render SVG document.
+ * @param svg SVG handle
+ * @param pm destination pixmap
+ * @param viewport position and size of the document on the pixmap
+ * @return true if document was rendered
+ */
+static bool render(RsvgHandle* svg, struct pixmap* pm,
+                   const RsvgRectangle* viewport)
+{
+    cairo_surface_t* surface;
+    cairo_t* cr;
+    bool rc = false;
+
+    surface = cairo_image_surface_create_for_data(
+        (uint8_t*)pm->data, CAIRO_FORMAT_ARGB32, pm->width, pm->height,
+        pm->width * sizeof(argb_t));
+    if (cairo_surface_status(surface) == CAIRO_STATUS_SUCCESS) {
+        cr = cairo_create(surface);
+        rc = rsvg_handle_render_document(svg, cr, viewport, NULL);
+        cairo_destroy(cr);
+    }
+    cairo_surface_destroy(surface);
+
+    return rc;
+}
+
+/** Render visible part of the document, see `image_render_fn`. */
+static bool vector_render(void* data, struct pixmap* pm, ssize_t x,
+                          ssize_t y, double scale)
+{
+    const struct svg_vector* vec = data;
+    const RsvgRectangle viewport = {
+        .x = x,
+        .y = y,
+        .width = vec->width * scale,
+        .height = vec->height * scale,
+    };
+    // everything outside the pixmap is clipped by cairo
+    return render(vec->svg, pm, &viewport);
+}
+
+/** Free renderer, see `image_vector`. */
+static void vector_free(void* data)
+{
+    struct svg_vector* vec = data;
+    g_object_unref(vec->svg);
+    free(vec);
+}
+
 // SVG loader implementation
 enum loader_status decode_svg(struct image* ctx, const uint8_t* data,
                               size_t size)
@@ -58,10 +117,8 @@ enum loader_status decode_svg(struct image* ctx, const uint8_t* data,
     RsvgRectangle vb_real;
     RsvgRectangle vb_render;
     GError* err = NULL;
-    cairo_surface_t* surface = NULL;
-    cairo_t* cr = NULL;
     struct pixmap* pm;
-    cairo_status_t status;
+    double scale;
 
     if (!is_svg(data, size)) {
         return ldr_unsupported;
@@ -90,23 +147,21 @@ enum loader_status decode_svg(struct image* ctx, const uint8_t* data,
         vb_render.height = RENDER_SIZE;
     }
 
-    // allocate and bind buffer
+    // render in requested size
+    scale = image_hint_scale(ctx, vb_render.width, vb_render.height);
+    if (scale < 1.0) {
+        ctx->full_width = vb_render.width;
+        ctx->full_height = vb_render.height;
+        vb_render.width = ceil(vb_render.width * scale);
+        vb_render.height = ceil(vb_render.height * scale);
+    }
+
+    // allocate buffer and render svg, the frame is already transparent
     pm = image_allocate_frame(ctx, vb_render.width, vb_render.height);
     if (!pm) {
         goto fail;
     }
-    memset(pm->data, 0, pm->width * pm->height * sizeof(argb_t));
-    surface = cairo_image_surface_create_for_data(
-        (uint8_t*)pm->data, CAIRO_FORMAT_ARGB32, pm->width, pm->height,
-        pm->width * sizeof(argb_t));
-    status = cairo_surface_status(surface);
-    if (status != CAIRO_STATUS_SUCCESS) {
-        goto fail;
-    }
-
-    // render svg to surface
-    cr = cairo_create(surface);
-    if (!rsvg_handle_render_document(svg, cr, &vb_render, &err)) {
+    if (!render(svg, pm, &vb_render)) {
         goto fail;
     }
 
@@ -117,19 +172,25 @@ enum loader_status decode_svg(struct image* ctx, const uint8_t* data,
     }
     ctx->alpha = true;
 
-    cairo_destroy(cr);
-    cairo_surface_destroy(surface);
+    // keep document to render it with the exact output resolution
+    if (!ctx->size_hint) {
+        struct svg_vector* vec = malloc(sizeof(*vec));
+        if (vec) {
+            vec->svg = svg;
+            vec->width = vb_render.width;
+            vec->height = vb_render.height;
+            ctx->vector.render = vector_render;
+            ctx->vector.free = vector_free;
+            ctx->vector.data = vec;
+            return ldr_success;
+        }
+    }
+
     g_object_unref(svg);
 
     return ldr_success;
 
 fail:
-    if (cr) {
-        cairo_destroy(cr);
-    }
-    if (surface) {
-        cairo_surface_destroy(surface);
-    }
     image_free_frames(ctx);
     g_object_unref(svg);
     return ldr_fmterror;
@@ -3,8 +3,7 @@
 // Copyright (C) 2024 Artem Senichev <artemsen@gmail.com>
 
 #include "../loader.h"
-
-#include <string.h>
+#include "../pixconv.h"
 
 /** TGA file header. */
 struct __attribute__((__packed__)) tga_header {
@@ -74,39 +73,57 @@ static inline argb_t get_pixel(const uint8_t* data, size_t bpp)
 
 /**
  * Decode uncompressed image.
- * @param pm destination pixmap
+ * Rows are written in the final order, the image doesn't need to be flipped
+ * vertically.
+ * @param ctx image context with allocated frame
  * @param tga source image descriptor
  * @param colormap color map
  * @param data pointer to image data
  * @param size size of image data in bytes
  * @return true if image decoded successfully
  */
-static bool decode_unc(struct pixmap* pm, const struct tga_header* tga,
+static bool decode_unc(const struct image* ctx, const struct tga_header* tga,
                        const uint8_t* colormap, const uint8_t* data,
                        size_t size)
 {
+    struct pixmap* pm = &ctx->frames[0].pm;
     const uint8_t bytes_per_pixel = tga->bpp / 8 + (tga->bpp % 8 ? 1 : 0);
-    const size_t num_pixels = pm->width * pm->height;
-    const size_t data_size = num_pixels * bytes_per_pixel;
+    const uint8_t cm_bpp = tga->cm_bpc / 8 + (tga->cm_bpc % 8 ? 1 : 0);
+    const size_t stride = pm->width * bytes_per_pixel;
+    const bool bottom_up = !(tga->desc & TGA_ORDER_T2B);
+    const uint8_t* top = bottom_up ? data + (pm->height - 1) * stride : data;
+    const ssize_t step = bottom_up ? -(ssize_t)stride : (ssize_t)stride;
+    pixconv_fn fn = NULL;
 
-    if (data_size > size) {
+    if (pm->height * stride > size) {
         return false;
     }
 
     if (tga->bpp == 32) {
-        memcpy(pm->data, data, data_size);
-    } else {
-        const uint8_t cm_bpp = tga->cm_bpc / 8 + (tga->cm_bpc % 8 ? 1 : 0);
-        for (size_t i = 0; i < num_pixels; ++i) {
-            const uint8_t* src = data + i * bytes_per_pixel;
+        fn = pixconv_bgra32;
+    } else if (!colormap && tga->bpp == 24) {
+        fn = pixconv_bgr24;
+    } else if (!colormap && tga->bpp == 8) {
+        fn = pixconv_gray8;
+    }
+    if (fn) {
+        pixconv_image(ctx, top, step, fn);
+        return true;
+    }
+
+    for (size_t y = 0; y < pm->height; ++y) {
+        const uint8_t* src_y = top + (ssize_t)y * step;
+        argb_t* dst = &pm->data[y * pm->width];
+        for (size_t x = 0; x < pm->width; ++x) {
+            const uint8_t* src = src_y + x * bytes_per_pixel;
             if (!colormap) {
-                pm->data[i] = get_pixel(src, tga->bpp);
+                dst[x] = get_pixel(src, tga->bpp);
             } else {
                 const uint8_t* entry = colormap + cm_bpp * (*src);
                 if (entry + cm_bpp > data) {
                     return false;
                 }
-                pm->data[i] = get_pixel(entry, tga->cm_bpc);
+                dst[x] = get_pixel(entry, tga->cm_bpc);
             }
         }
     }
@@ -177,6 +194,7 @@ enum loader_status decode_tga(struct image* ctx, const uint8_t* data,
     size_t colormap_sz = 0;
     const char* type_name = NULL;
     bool rc = false;
+    bool flip = false;
     size_t data_offset;
     struct pixmap* pm;
 
@@ -231,12 +249,13 @@ enum loader_status decode_tga(struct image* ctx, const uint8_t* data,
         case TGA_UNC_CM:
         case TGA_UNC_TC:
         case TGA_UNC_GS:
-            rc = decode_unc(pm, tga, colormap, data, size);
+            rc = decode_unc(ctx, tga, colormap, data, size);
             break;
         case TGA_RLE_CM:
         case TGA_RLE_TC:
         case TGA_RLE_GS:
             rc = decode_rle(pm, tga, colormap, data, size);
+            flip = !(tga->desc & TGA_ORDER_T2B);
             break;
     }
     if (!rc) {
@@ -245,7 +264,7 @@ enum loader_status decode_tga(struct image* ctx, const uint8_t* data,
     }
 
     // fix orientation
-    if (!(tga->desc & TGA_ORDER_T2B)) {
+    if (flip) {
         pixmap_flip_vertical(pm);
     }
     if (tga->desc & TGA_ORDER_R2L) {
@@ -3,7 +3,10 @@
 // Copyright (C) 2022 Artem Senichev <artemsen@gmail.com>
 
 #include "../loader.h"
+#include "../tiles.h"
+#include "../tpool.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <tiffio.h>
 
@@ -84,6 +87,387 @@ static void tiff_unmap(__attribute__((unused)) thandle_t data,
 {
 }
 
+/**
+ * Open TIFF from memory.
+ * @param reader memory reader
+ * @return TIFF handle or NULL on errors
+ */
+static TIFF* tiff_open(struct mem_reader* reader)
+{
+    return TIFFClientOpen("", "r", reader, tiff_read, tiff_write, tiff_seek,
+                          tiff_close, tiff_size, tiff_map, tiff_unmap);
+}
+
+/** Parallel decoding task. */
+struct tiff_task {
+    const struct image* img; ///< Image context
+    const uint8_t* data;     ///< Raw image data
+    size_t size;             ///< Size of raw image data
+    struct pixmap* pm;       ///< Destination pixmap
+    bool tiled;              ///< Storage type: tiles or strips
+    uint32_t chunk_w;        ///< Width of tile or strip
+    uint32_t chunk_h;        ///< Height of tile or strip
+    size_t chunks_x;         ///< Number of chunks per line
+    bool failed;             ///< Decoding error flag
+};
+
+/**
+ * Decode range of tiles or strips, see `tpool_fn`.
+ * @param data pointer to the decoding task
+ * @param low,high range of chunk indices
+ */
+static void decode_chunks(void* data, size_t low, size_t high)
+{
+    struct tiff_task* task = data;
+    struct pixmap* pm = task->pm;
+    struct mem_reader reader = {
+        .data = task->data,
+        .size = task->size,
+    };
+    uint32_t* raster;
+    TIFF* tiff;
+    bool rc = true;
+
+    // TIFF handle can't be shared between threads
+    tiff = tiff_open(&reader);
+    raster = malloc((size_t)task->chunk_w * task->chunk_h * sizeof(argb_t));
+
+    for (size_t i = low; i < high && tiff && raster && rc; ++i) {
+        const size_t x = (i % task->chunks_x) * task->chunk_w;
+        const size_t y = (i / task->chunks_x) * task->chunk_h;
+        const size_t width = min(task->chunk_w, pm->width - x);
+        const size_t height = min(task->chunk_h, pm->height - y);
+        size_t rows;
+
+        if (image_cancelled(task->img) ||
+            __atomic_load_n(&task->failed, __ATOMIC_RELAXED)) {
+            break;
+        }
+
+        // raster is filled from bottom to top, last tiles are aligned to the
+        // bottom of the raster, last strip is not
+        if (task->tiled) {
+            rc = TIFFReadRGBATile(tiff, x, y, raster);
+            rows = task->chunk_h;
+        } else {
+            rc = TIFFReadRGBAStrip(tiff, y, raster);
+            rows = height;
+        }
+
+        for (size_t row = 0; rc && row < height; ++row) {
+            const uint32_t* src = &raster[(rows - row - 1) * task->chunk_w];
+            argb_t* dst = &pm->data[(y + row) * pm->width + x];
+            for (size_t col = 0; col < width; ++col) {
+                dst[col] = ABGR_TO_ARGB(src[col]);
+            }
+        }
+    }
+
+    if (!tiff || !raster || !rc) {
+        __atomic_store_n(&task->failed, true, __ATOMIC_RELAXED);
+    }
+
+    free(raster);
+    if (tiff) {
+        TIFFClose(tiff);
+    }
+}
+
+/**
+ * Decode tiled or stripped image in parallel.
+ * @param ctx image context
+ * @param tiff TIFF handle
+ * @param data raw image data
+ * @param size size of raw image data
+ * @param pm destination pixmap
+ * @return false if image can't be decoded by chunks
+ */
+static bool decode_parallel(const struct image* ctx, TIFF* tiff,
+                            const uint8_t* data, size_t size,
+                            struct pixmap* pm)
+{
+    struct tiff_task task = {
+        .img = ctx,
+        .data = data,
+        .size = size,
+        .pm = pm,
+        .tiled = TIFFIsTiled(tiff),
+        .chunk_w = pm->width,
+    };
+    size_t chunks;
+
+    if (image_threads(ctx) <= 1) {
+        return false;
+    }
+
+    if (task.tiled) {
+        if (!TIFFGetField(tiff, TIFFTAG_TILEWIDTH, &task.chunk_w) ||
+            !TIFFGetField(tiff, TIFFTAG_TILELENGTH, &task.chunk_h)) {
+            return false;
+        }
+    } else if (!TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP,
+                                      &task.chunk_h)) {
+        return false;
+    }
+    if (task.chunk_w == 0 || task.chunk_h == 0) {
+        return false;
+    }
+    if (!task.tiled && task.chunk_h > pm->height) {
+        // rows per strip are unlimited by default, but a tile is always
+        // read in full size, even if it is taller than the image
+        task.chunk_h = pm->height;
+    }
+
+    task.chunks_x = (pm->width + task.chunk_w - 1) / task.chunk_w;
+    chunks = task.chunks_x * ((pm->height + task.chunk_h - 1) / task.chunk_h);
+    if (chunks <= 1) {
+        return false;
+    }
+
+    tpool_run(decode_chunks, &task, chunks, 1);
+
+    return !task.failed;
+}
+
+// Min number of rows decoded at once by bands
+#define BAND_MIN_ROWS 64
+
+/**
+ * Decode top-left oriented image by bands of rows: each band is read in the
+ * final order and converted to ARGB while it is still in the CPU cache.
+ * @param ctx image context
+ * @param tiff TIFF handle
+ * @param timg RGBA image reader
+ * @param pm destination pixmap
+ * @return false on errors
+ */
+static bool decode_bands(const struct image* ctx, TIFF* tiff,
+                         TIFFRGBAImage* timg, struct pixmap* pm)
+{
+    uint32_t band = 0;
+
+    // bands are aligned to strips or tiles, so each of them is read once
+    if (TIFFIsTiled(tiff)) {
+        TIFFGetField(tiff, TIFFTAG_TILELENGTH, &band);
+    } else {
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, &band);
+    }
+    if (band == 0 || band > pm->height) {
+        band = pm->height;
+    } else if (band < BAND_MIN_ROWS) {
+        band *= (BAND_MIN_ROWS + band - 1) / band;
+    }
+
+    timg->req_orientation = ORIENTATION_TOPLEFT;
+
+    for (size_t y = 0; y < pm->height; y += band) {
+        const size_t rows = min(band, pm->height - y);
+        argb_t* dst = &pm->data[y * pm->width];
+
+        if (image_cancelled(ctx)) {
+            return false;
+        }
+
+        timg->row_offset = y;
+        if (!TIFFRGBAImageGet(timg, dst, pm->width, rows)) {
+            return false;
+        }
+        for (size_t i = 0; i < rows * pm->width; ++i) {
+            dst[i] = ABGR_TO_ARGB(dst[i]);
+        }
+
+        image_progress(ctx, y + rows);
+    }
+
+    return true;
+}
+
+// Min height of the tile for stripped images
+#define STRIPS_TILE_HEIGHT 256
+// Width of the tile for stripped images
+#define STRIPS_TILE_WIDTH 1024
+
+/** Tile source of huge image. */
+struct tiff_tiles {
+    struct tiles_data raw;                       ///< Raw image data
+    struct mem_reader reader;                    ///< Memory reader
+    TIFF* tiff;                                  ///< TIFF handle
+    tdir_t dirs[TILES_MAX_LEVELS];               ///< Directories of levels
+    struct tiles_level levels[TILES_MAX_LEVELS]; ///< Pyramid levels
+    uint32_t strip_rows;                         ///< Rows per strip, 0 if tiled
+    uint32_t* raster;                            ///< Temporary buffer
+};
+
+/**
+ * Copy pixels from bottom-up raster to the tile.
+ * @param raster source raster
+ * @param stride number of pixels per raster line
+ * @param rows number of lines in the raster
+ * @param pm destination pixmap
+ * @param y first line in the pixmap to fill
+ * @param width,height size of the area to copy
+ */
+static void put_raster(const uint32_t* raster, size_t stride, size_t rows,
+                       struct pixmap* pm, size_t y, size_t width,
+                       size_t height)
+{
+    for (size_t row = 0; row < height; ++row) {
+        const uint32_t* src = &raster[(rows - row - 1) * stride];
+        argb_t* dst = &pm->data[(y + row) * pm->width];
+        for (size_t col = 0; col < width; ++col) {
+            dst[col] = ABGR_TO_ARGB(src[col]);
+        }
+    }
+}
+
+/** Decode single tile, see `tiles_decode_fn`. */
+static bool tiles_decode(void* data, size_t level, size_t col, size_t row,
+                         struct pixmap* pm)
+{
+    struct tiff_tiles* tt = data;
+    const struct tiles_level* lvl = &tt->levels[level];
+    const size_t x = col * lvl->tile_width;
+    const size_t y = row * lvl->tile_height;
+    const size_t width = min(lvl->tile_width, lvl->width - x);
+    const size_t height = min(lvl->tile_height, lvl->height - y);
+
+    if (TIFFCurrentDirectory(tt->tiff) != tt->dirs[level] &&
+        !TIFFSetDirectory(tt->tiff, tt->dirs[level])) {
+        return false;
+    }
+
+    if (tt->strip_rows == 0) {
+        // last tiles are aligned to the bottom of the raster
+        if (!TIFFReadRGBATile(tt->tiff, x, y, tt->raster)) {
+            return false;
+        }
+        put_raster(tt->raster, lvl->tile_width, lvl->tile_height, pm, 0,
+                   width, height);
+        return true;
+    }
+
+    // stripped image: read all strips covered by the tile
+    for (size_t line = 0; line < height; line += tt->strip_rows) {
+        const size_t rows = min(tt->strip_rows, lvl->height - y - line);
+        if (!TIFFReadRGBAStrip(tt->tiff, y + line, tt->raster)) {
+            return false;
+        }
+        put_raster(tt->raster + x, lvl->width, rows, pm, line, width,
+                   min(rows, height - line));
+    }
+
+    return true;
+}
+
+/** Free tile source, see `tiles_free_fn`. */
+static void tiles_release(void* data)
+{
+    struct tiff_tiles* tt = data;
+    if (tt->tiff) {
+        TIFFClose(tt->tiff);
+    }
+    tiles_data_free(&tt->raw);
+    free(tt->raster);
+    free(tt);
+}
+
+/**
+ * Setup huge image decoded by tiles on demand.
+ * @param ctx image context
+ * @param data,size raw image data
+ * @return true if completed successfully
+ */
+static bool decode_tiles(struct image* ctx, const uint8_t* data, size_t size)
+{
+    struct tiles_source source = {
+        .decode = tiles_decode,
+        .free = tiles_release,
+    };
+    struct tiff_tiles* tt;
+    size_t raster = 0;
+
+    tt = calloc(1, sizeof(*tt));
+    if (!tt) {
+        return false;
+    }
+    source.data = tt;
+    if (!tiles_data_init(&tt->raw, ctx, data, size)) {
+        free(tt);
+        return false;
+    }
+    tt->reader.data = tt->raw.data;
+    tt->reader.size = tt->raw.size;
+    tt->tiff = tiff_open(&tt->reader);
+    if (!tt->tiff) {
+        tiles_release(tt);
+        return false;
+    }
+
+    // get pyramid levels: subsequent directories with reduced copies
+    do {
+        struct tiles_level* lvl = &source.levels[source.num_levels];
+        uint32_t width, height, tile_w, tile_h;
+
+        if (!TIFFGetField(tt->tiff, TIFFTAG_IMAGEWIDTH, &width) ||
+            !TIFFGetField(tt->tiff, TIFFTAG_IMAGELENGTH, &height)) {
+            break;
+        }
+        if (!TIFFIsTiled(tt->tiff) ||
+            !TIFFGetField(tt->tiff, TIFFTAG_TILEWIDTH, &tile_w) ||
+            !TIFFGetField(tt->tiff, TIFFTAG_TILELENGTH, &tile_h)) {
+            if (source.num_levels == 0) {
+                // use virtual tiles of stripped image
+                if (!TIFFGetFieldDefaulted(tt->tiff, TIFFTAG_ROWSPERSTRIP,
+                                           &tt->strip_rows) ||
+                    tt->strip_rows == 0) {
+                    break;
+                }
+                tt->strip_rows = min(tt->strip_rows, height);
+                tile_w = min(width, STRIPS_TILE_WIDTH);
+                tile_h = tt->strip_rows;
+                if (tile_h < STRIPS_TILE_HEIGHT) {
+                    tile_h *= (STRIPS_TILE_HEIGHT + tile_h - 1) / tile_h;
+                }
+                raster = (size_t)width * tt->strip_rows;
+                tt->dirs[0] = TIFFCurrentDirectory(tt->tiff);
+                lvl->width = width;
+                lvl->height = height;
+                lvl->tile_width = tile_w;
+                lvl->tile_height = tile_h;
+                ++source.num_levels;
+                break; // no pyramid for stripped images
+            }
+            continue;
+        }
+        if (tile_w == 0 || tile_h == 0) {
+            continue;
+        }
+        if (source.num_levels && (width >= lvl[-1].width ||
+                                  height >= lvl[-1].height)) {
+            continue; // not a reduced copy
+        }
+
+        tt->dirs[source.num_levels] = TIFFCurrentDirectory(tt->tiff);
+        lvl->width = width;
+        lvl->height = height;
+        lvl->tile_width = tile_w;
+        lvl->tile_height = tile_h;
+        ++source.num_levels;
+        raster = max(raster, (size_t)tile_w * tile_h);
+    } while (source.num_levels < TILES_MAX_LEVELS &&
+             !tt->strip_rows && TIFFReadDirectory(tt->tiff));
+
+    tt->raster = malloc(raster * sizeof(*tt->raster));
+    if (!tt->raster || source.num_levels == 0) {
+        tiles_release(tt);
+        return false;
+    }
+
+    memcpy(tt->levels, source.levels, sizeof(tt->levels));
+
+    return tiles_create(ctx, &source);
+}
+
 // TIFF loader implementation
 enum loader_status decode_tiff(struct image* ctx, const uint8_t* data,
                                size_t size)
@@ -108,8 +492,7 @@ enum loader_status decode_tiff(struct image* ctx, const uint8_t* data,
     TIFFSetErrorHandler(NULL);
     TIFFSetWarningHandler(NULL);
 
-    tiff = TIFFClientOpen("", "r", &reader, tiff_read, tiff_write, tiff_seek,
-                          tiff_close, tiff_size, tiff_map, tiff_unmap);
+    tiff = tiff_open(&reader);
     if (!tiff) {
         return ldr_fmterror;
     }
@@ -119,26 +502,41 @@ enum loader_status decode_tiff(struct image* ctx, const uint8_t* data,
         goto fail;
     }
 
+    image_set_format(ctx, "TIFF %dbpp",
+                     timg.bitspersample * timg.samplesperpixel);
+    ctx->alpha = true;
+
+    // huge image is decoded by tiles on demand
+    if (timg.orientation == ORIENTATION_TOPLEFT &&
+        tiles_lazy(timg.width, timg.height) &&
+        decode_tiles(ctx, data, size)) {
+        TIFFRGBAImageEnd(&timg);
+        TIFFClose(tiff);
+        return ldr_success;
+    }
+
     pm = image_allocate_frame(ctx, timg.width, timg.height);
     if (!pm) {
         goto fail;
     }
-    if (!TIFFRGBAImageGet(&timg, pm->data, timg.width, timg.height)) {
-        goto fail;
-    }
-
-    // convert ABGR -> ARGB
-    for (size_t i = 0; i < pm->width * pm->height; ++i) {
-        pm->data[i] = ABGR_TO_ARGB(pm->data[i]);
-    }
 
+    // decode by tiles or strips in parallel if possible
     if (timg.orientation == ORIENTATION_TOPLEFT) {
-        image_flip_vertical(ctx);
-    }
+        if (!decode_parallel(ctx, tiff, data, size, pm) &&
+            !decode_bands(ctx, tiff, &timg, pm)) {
+            goto fail;
+        }
+    } else {
+        if (image_cancelled(ctx) ||
+            !TIFFRGBAImageGet(&timg, pm->data, timg.width, timg.height)) {
+            goto fail;
+        }
 
-    image_set_format(ctx, "TIFF %dbpp",
-                     timg.bitspersample * timg.samplesperpixel);
-    ctx->alpha = true;
+        // convert ABGR -> ARGB
+        for (size_t i = 0; i < pm->width * pm->height; ++i) {
+            pm->data[i] = ABGR_TO_ARGB(pm->data[i]);
+        }
+    }
 
     TIFFRGBAImageEnd(&timg);
     TIFFClose(tiff);
@@ -2,16 +2,176 @@
 // WebP format decoder.
 // Copyright (C) 2020 Artem Senichev <artemsen@gmail.com>
 
+#include "../animation.h"
 #include "../exif.h"
 #include "../loader.h"
 #include "buildcfg.h"
 
+#include <math.h>
+#include <stdlib.h>
 #include <string.h>
 #include <webp/demux.h>
 
 // WebP signature
 static const uint8_t signature[] = { 'R', 'I', 'F', 'F' };
 
+#ifdef HAVE_LIBEXIF
+/**
+ * Read Exif info.
+ * @param ctx image context
+ * @param dmx WebP demuxer
+ */
+static void read_exif(struct image* ctx, const WebPDemuxer* dmx)
+{
+    if (WebPDemuxGetI(dmx, WEBP_FF_FORMAT_FLAGS) & EXIF_FLAG) {
+        WebPChunkIterator it;
+        if (WebPDemuxGetChunk(dmx, "EXIF", 1, &it)) {
+            process_exif(ctx, it.chunk.bytes, it.chunk.size);
+            WebPDemuxReleaseChunkIterator(&it);
+        }
+    }
+}
+#endif // HAVE_LIBEXIF
+
+/**
+ * Decode still image straight to the frame buffer, reduction is done by
+ * libwebp.
+ * @param ctx image context
+ * @param raw raw image data
+ * @param prop image properties
+ * @param scale scale factor, 1.0 for full size
+ * @return true if image was decoded
+ */
+static bool decode_still(struct image* ctx, const WebPData* raw,
+                         const WebPBitstreamFeatures* prop, double scale)
+{
+    const size_t width = ceil(prop->width * scale);
+    const size_t height = ceil(prop->height * scale);
+    const size_t stride = width * sizeof(argb_t);
+    WebPDecoderConfig config;
+    struct pixmap* pm;
+
+    if (!WebPInitDecoderConfig(&config)) {
+        return false;
+    }
+    pm = image_allocate_frame(ctx, width, height);
+    if (!pm) {
+        return false;
+    }
+
+    if (scale < 1.0) {
+        config.options.use_scaling = 1;
+        config.options.scaled_width = width;
+        config.options.scaled_height = height;
+    }
+    config.options.use_threads = image_threads(ctx) > 1;
+    config.output.colorspace = MODE_BGRA;
+    config.output.is_external_memory = 1;
+    config.output.u.RGBA.rgba = (uint8_t*)pm->data;
+    config.output.u.RGBA.stride = stride;
+    config.output.u.RGBA.size = stride * height;
+
+    if (WebPDecode(raw->bytes, raw->size, &config) != VP8_STATUS_OK) {
+        image_free_frames(ctx);
+        return false;
+    }
+
+#ifdef HAVE_LIBEXIF
+    WebPDemuxer* dmx = WebPDemux(raw);
+    if (dmx) {
+        read_exif(ctx, dmx);
+        WebPDemuxDelete(dmx);
+    }
+#endif // HAVE_LIBEXIF
+
+    if (scale < 1.0) {
+        ctx->full_width = prop->width;
+        ctx->full_height = prop->height;
+    }
+
+    return true;
+}
+
+/** Animation decoded on demand. */
+struct webp_anim {
+    WebPAnimDecoder* decoder; ///< WebP animation decoder
+    int timestamp;            ///< Timestamp of the previous frame
+    size_t size;              ///< Size of the raw image data
+    uint8_t data[];           ///< Raw image data used by the decoder
+};
+
+/** Decode next frame of the animation, see `anim_decode_fn`. */
+static bool anim_decode(void* data, struct pixmap* pm, size_t* duration)
+{
+    struct webp_anim* anim = data;
+    uint8_t* buffer;
+    int timestamp;
+
+    if (!WebPAnimDecoderHasMoreFrames(anim->decoder)) {
+        WebPAnimDecoderReset(anim->decoder);
+        anim->timestamp = 0;
+    }
+    if (!WebPAnimDecoderGetNext(anim->decoder, &buffer, &timestamp)) {
+        return false;
+    }
+    memcpy(pm->data, buffer, pm->width * pm->height * sizeof(argb_t));
+
+    *duration = timestamp > anim->timestamp ? timestamp - anim->timestamp : 100;
+    anim->timestamp = timestamp;
+
+    return true;
+}
+
+/** Free animation decoder, see `anim_free_fn`. */
+static void anim_free(void* data)
+{
+    struct webp_anim* anim = data;
+    if (anim->decoder) {
+        WebPAnimDecoderDelete(anim->decoder);
+    }
+    free(anim);
+}
+
+/**
+ * Setup animation with frames decoded on demand.
+ * @param ctx image context
+ * @param raw raw image data
+ * @param opts decoder options
+ * @param info animation info
+ * @return true if completed successfully
+ */
+static bool decode_lazy(struct image* ctx, const WebPData* raw,
+                        const WebPAnimDecoderOptions* opts,
+                        const WebPAnimInfo* info)
+{
+    struct webp_anim* anim;
+    WebPData copy;
+    struct anim_decoder decoder = {
+        .decode = anim_decode,
+        .free = anim_free,
+    };
+
+    // decoder refers to the raw data, which is released after loading
+    anim = calloc(1, sizeof(*anim) + raw->size);
+    if (!anim) {
+        return false;
+    }
+    anim->size = raw->size;
+    memcpy(anim->data, raw->bytes, raw->size);
+    copy.bytes = anim->data;
+    copy.size = anim->size;
+
+    anim->decoder = WebPAnimDecoderNew(&copy, opts);
+    if (!anim->decoder) {
+        anim_free(anim);
+        return false;
+    }
+    decoder.data = anim;
+
+    return animation_create(ctx, info->canvas_width, info->canvas_height,
+                            info->frame_count, &decoder);
+}
+
 // WebP loader implementation
 enum loader_status decode_webp(struct image* ctx, const uint8_t* data,
                                size_t size)
@@ -22,6 +182,7 @@ enum loader_status decode_webp(struct image* ctx, const uint8_t* data,
     WebPAnimInfo webp_info;
     WebPBitstreamFeatures prop;
     int prev_timestamp = 0;
+    double scale;
 
     // check signature
     if (size < sizeof(signature) ||
@@ -34,6 +195,12 @@ enum loader_status decode_webp(struct image* ctx, const uint8_t* data,
         return ldr_fmterror;
     }
 
+    // decode still image without intermediate canvas
+    scale = image_hint_scale(ctx, prop.width, prop.height);
+    if (!prop.has_animation && decode_still(ctx, &raw, &prop, scale)) {
+        goto done;
+    }
+
     // open decoder
     WebPAnimDecoderOptionsInit(&webp_opts);
     webp_opts.color_mode = MODE_BGRA;
@@ -45,6 +212,19 @@ enum loader_status decode_webp(struct image* ctx, const uint8_t* data,
         goto fail;
     }
 
+    // decode large animation on demand
+    if (animation_lazy(ctx, webp_info.canvas_width, webp_info.canvas_height,
+                       webp_info.frame_count)) {
+        if (!decode_lazy(ctx, &raw, &webp_opts, &webp_info)) {
+            goto fail;
+        }
+#ifdef HAVE_LIBEXIF
+        read_exif(ctx, WebPAnimDecoderGetDemuxer(webp_dec));
+#endif // HAVE_LIBEXIF
+        WebPAnimDecoderDelete(webp_dec);
+        goto done;
+    }
+
     // allocate frame sequence
     if (!image_create_frames(ctx, webp_info.frame_count)) {
         goto fail;
@@ -76,18 +256,12 @@ enum loader_status decode_webp(struct image* ctx, const uint8_t* data,
     }
 
 #ifdef HAVE_LIBEXIF
-    const WebPDemuxer* webp_dmx = WebPAnimDecoderGetDemuxer(webp_dec);
-    if (WebPDemuxGetI(webp_dmx, WEBP_FF_FORMAT_FLAGS) & EXIF_FLAG) {
-        WebPChunkIterator it;
-        if (WebPDemuxGetChunk(webp_dmx, "EXIF", 1, &it)) {
-            process_exif(ctx, it.chunk.bytes, it.chunk.size);
-            WebPDemuxReleaseChunkIterator(&it);
-        }
-    }
+    read_exif(ctx, WebPAnimDecoderGetDemuxer(webp_dec));
 #endif // HAVE_LIBEXIF
 
     WebPAnimDecoderDelete(webp_dec);
 
+done:
     image_set_format(
         ctx, "WebP %s %s%s", prop.format == 1 ? "lossy" : "lossless",
         prop.has_alpha ? "+alpha" : "", prop.has_animation ? "+animation" : "");
@@ -8,18 +8,31 @@
 #include "imagelist.h"
 #include "info.h"
 #include "loader.h"
+#include "memcache.h"
 #include "thumbnail.h"
 #include "ui.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 // Scale for selected thumbnail
 #define THUMB_SELECTED_SCALE 1.15f
+// Number of rows loaded ahead in the scroll direction
+#define LOOKAHEAD_ROWS 2
+
+/** Rendered selected tile. */
+struct selection {
+    struct pixmap pm;  ///< Enlarged tile with background and border
+    size_t index;      ///< Image index of the tile
+    size_t generation; ///< Generation of the thumbnail, 0 for none
+    enum aa_mode aa;   ///< Scale filter used for rendering
+};
 
 /** Gallery context. */
 struct gallery {
     size_t thumb_size;  ///< Size of thumbnail
     size_t thumb_cache; ///< Max number of thumbnails in cache
+    bool prefetch;      ///< Prefetch files of the visible images
 
     argb_t clr_window;     ///< Window background
     argb_t clr_background; ///< Tile background
@@ -27,8 +40,17 @@ struct gallery {
     argb_t clr_border;     ///< Selected tile border
     argb_t clr_shadow;     ///< Selected tile shadow
 
-    size_t top;      ///< Index of the first displayed image
-    size_t selected; ///< Index of the selected image
+    size_t top;       ///< Index of the first displayed image
+    size_t selected;  ///< Index of the selected image
+    size_t drawn_top; ///< Index of the first image on the last redraw
+    size_t queue_top; ///< Index of the first image on the last queue reset
+    bool forward;     ///< Scroll direction
+
+    struct pixmap grid; ///< Rendered tiles without selection
+    size_t grid_top;    ///< Index of the first image on the grid
+
+    struct selection selection; ///< Rendered selected tile
+    struct pixmap shadow;       ///< Rendered shadow of the selected tile
 };
 
 /** Global gallery context. */
@@ -57,6 +79,26 @@ static void get_layout(size_t* cols, size_t* rows, size_t* gap)
     }
 }
 
+/** Reset rendered tiles, they will be redrawn on the next redraw. */
+static void reset_tiles(void)
+{
+    ctx.grid_top = IMGLIST_INVALID;
+    ctx.selection.index = IMGLIST_INVALID;
+}
+
+/**
+ * Check if thumbnail is in cache and account the request in statistics.
+ * Probing doesn't raise eviction priority, only drawn thumbnails do.
+ * @param index index of the image
+ * @return true if thumbnail is cached
+ */
+static bool cached(size_t index)
+{
+    const bool hit = thumbnail_cached(index);
+    memcache_account(hit);
+    return hit;
+}
+
 /** Reset loader queue. */
 static void reset_loader(void)
 {
@@ -66,6 +108,14 @@ static void reset_loader(void)
     ++rows;
     const size_t total = cols * rows;
 
+    // number of thumbnails to load ahead, it must fit into the cache
+    size_t ahead = cols * LOOKAHEAD_ROWS;
+    if (ctx.thumb_cache != 0) {
+        ahead = ctx.thumb_cache > total
+            ? min(ahead, (ctx.thumb_cache - total) / 2)
+            : 0;
+    }
+
     // search for nearest to selected
     const size_t last = image_list_jump(ctx.top, total - 1, true);
     const size_t max_f = image_list_distance(ctx.selected, last);
@@ -73,27 +123,65 @@ static void reset_loader(void)
 
     size_t next_f = ctx.selected;
     size_t next_b = ctx.selected;
+    size_t next_a;
+    size_t* queue;
+    size_t queued = 0;
+
+    if (ctx.queue_top != IMGLIST_INVALID && ctx.queue_top != ctx.top) {
+        ctx.forward = ctx.top > ctx.queue_top;
+    }
+    ctx.queue_top = ctx.top;
 
-    loader_queue_reset();
-    if (!thumbnail_get(ctx.selected)) {
-        loader_queue_append(ctx.selected);
+    queue = malloc((max_f + max_b + ahead + 1) * sizeof(*queue));
+    if (!queue) {
+        loader_queue_reset();
+        return;
     }
 
+    if (!cached(ctx.selected)) {
+        queue[queued++] = ctx.selected;
+    }
+
+    // files of visible thumbnails are prefetched, so decoders don't wait
+    // for I/O when they get to the entry
     for (size_t i = 0; i < max(max_f, max_b); ++i) {
         if (i < max_f) {
             next_f = image_list_nearest(next_f, true, false);
-            if (!thumbnail_get(next_f)) {
-                loader_queue_append(next_f);
+            if (!cached(next_f)) {
+                queue[queued++] = next_f;
+                if (ctx.prefetch) {
+                    loader_prefetch(next_f);
+                }
             }
         }
         if (i < max_b) {
             next_b = image_list_nearest(next_b, false, false);
-            if (!thumbnail_get(next_b)) {
-                loader_queue_append(next_b);
+            if (!cached(next_b)) {
+                queue[queued++] = next_b;
+                if (ctx.prefetch) {
+                    loader_prefetch(next_b);
+                }
             }
         }
     }
 
+    // then a few rows after the screen in the scroll direction
+    next_a = ctx.forward ? last : ctx.top;
+    for (size_t i = 0; i < ahead; ++i) {
+        next_a = image_list_nearest(next_a, ctx.forward, false);
+        if (next_a == IMGLIST_INVALID) {
+            break;
+        }
+        if (!thumbnail_cached(next_a)) {
+            queue[queued++] = next_a;
+        }
+    }
+
+    // visible thumbnails are loaded in order of distance from the selected
+    // one, decoding of those that are still needed is continued
+    loader_queue_set(queue, queued, IMGLIST_INVALID);
+    free(queue);
+
     // remove the furthest thumbnails from the cache
     if (ctx.thumb_cache != 0 && total < ctx.thumb_cache) {
         const size_t half = (ctx.thumb_cache - total) / 2;
@@ -134,7 +222,7 @@ static void update_layout(void)
  */
 static void update_info(void)
 {
-    const struct thumbnail* th = thumbnail_get(ctx.selected);
+    const struct thumbnail* th = thumbnail_get_meta(ctx.selected);
 
     if (th) {
         info_reset(th->image);
@@ -142,8 +230,74 @@ static void update_info(void)
         info_update(info_index, "%zu of %zu", th->image->index + 1,
                     image_list_size());
     }
+}
 
-    app_redraw();
+/**
+ * Get position of the thumbnail tile on the window.
+ * @param index image index
+ * @param x,y pointers to get top left coordinates of the tile
+ * @return false if the tile is out of the screen
+ */
+static bool get_tile(size_t index, ssize_t* x, ssize_t* y)
+{
+    size_t cols, rows, gap;
+    size_t distance, col, row;
+
+    get_layout(&cols, &rows, &gap);
+    if (cols == 0 || index == IMGLIST_INVALID || index < ctx.top) {
+        return false;
+    }
+
+    distance = image_list_distance(ctx.top, index);
+    col = distance % cols;
+    row = distance / cols;
+    if (row > rows) {
+        return false; // last row is partially visible
+    }
+
+    *x = col * ctx.thumb_size + gap * (col + 1);
+    *y = row * ctx.thumb_size + gap * (row + 1);
+
+    return true;
+}
+
+/**
+ * Get position of the selected (enlarged) tile.
+ * @param x,y top left coordinates of the tile, updated in place
+ * @return size of the selected tile
+ */
+static size_t get_selected_tile(ssize_t* x, ssize_t* y)
+{
+    const size_t thumb_size = THUMB_SELECTED_SCALE * ctx.thumb_size;
+    const size_t thumb_offset = (thumb_size - ctx.thumb_size) / 2;
+    const ssize_t wnd_width = ui_get_width();
+
+    *x = max(0, *x - (ssize_t)thumb_offset);
+    *y = max(0, *y - (ssize_t)thumb_offset);
+    if (*x + (ssize_t)thumb_size >= wnd_width) {
+        *x = wnd_width - thumb_size;
+    }
+
+    return thumb_size;
+}
+
+/**
+ * Request redraw of the thumbnail tile.
+ * @param index image index
+ * @param selected flag to use area of the selected (enlarged) tile
+ */
+static void redraw_tile(size_t index, bool selected)
+{
+    ssize_t x, y;
+    size_t size = ctx.thumb_size;
+
+    if (get_tile(index, &x, &y)) {
+        if (selected) {
+            size = get_selected_tile(&x, &y);
+            size += size / 15 + 2; // shadow
+        }
+        app_redraw_area(x, y, size, size);
+    }
 }
 
 /**
@@ -152,10 +306,19 @@ static void update_info(void)
  */
 static void select_thumbnail(size_t index)
 {
+    const size_t prev = ctx.selected;
+
     ctx.selected = index;
     update_info();
     update_layout();
-    app_redraw();
+
+    if (ctx.top == ctx.drawn_top) {
+        // layout is not changed, redraw old and new selection only
+        redraw_tile(prev, true);
+        redraw_tile(index, true);
+    } else {
+        app_redraw();
+    }
 }
 
 /**
@@ -184,6 +347,10 @@ static bool skip_thumbnail(size_t index)
         update_layout();
     }
 
+    // all tiles after the removed one are shifted
+    reset_tiles();
+    app_redraw();
+
     return true;
 }
 
@@ -270,121 +437,246 @@ static void scroll_page(bool forward)
 
 /**
  * Draw thumbnail.
- * @param window destination window
- * @param x,y top left coordinate
+ * @param window destination canvas
+ * @param x,y top left coordinate of the tile on the canvas
  * @param image thumbnail image
- * @param selected flag to highlight current thumbnail
  */
 static void draw_thumbnail(struct pixmap* window, ssize_t x, ssize_t y,
-                           const struct image* image, bool selected)
+                           const struct image* image)
 {
     const struct pixmap* thumb = image ? &image->frames[0].pm : NULL;
 
-    if (!selected) {
-        pixmap_fill(window, x, y, ctx.thumb_size, ctx.thumb_size,
-                    ctx.clr_background);
-        if (thumb) {
-            x += ctx.thumb_size / 2 - thumb->width / 2;
-            y += ctx.thumb_size / 2 - thumb->height / 2;
-            pixmap_copy(thumb, window, x, y, image->alpha);
-        }
-    } else {
-        // currently selected item
-        const size_t thumb_size = THUMB_SELECTED_SCALE * ctx.thumb_size;
-        const size_t thumb_offset = (thumb_size - ctx.thumb_size) / 2;
-
-        x = max(0, x - (ssize_t)thumb_offset);
-        y = max(0, y - (ssize_t)thumb_offset);
-        if (x + thumb_size >= window->width) {
-            x = window->width - thumb_size;
-        }
+    pixmap_fill(window, x, y, ctx.thumb_size, ctx.thumb_size,
+                ctx.clr_background);
+    if (thumb) {
+        x += ctx.thumb_size / 2 - thumb->width / 2;
+        y += ctx.thumb_size / 2 - thumb->height / 2;
+        pixmap_copy(thumb, window, x, y, image->alpha);
+    }
+}
 
-        pixmap_fill(window, x, y, thumb_size, thumb_size, ctx.clr_select);
+/**
+ * Render shadow of the selected tile, it doesn't depend on the image.
+ * @param size size of the selected tile
+ * @return false if shadow is not available
+ */
+static bool render_shadow(size_t size)
+{
+    const argb_t base = ctx.clr_shadow & 0x00ffffff;
+    const uint8_t alpha = ARGB_GET_A(ctx.clr_shadow);
+    const size_t width = max(1, (double)size / 15.0 * ((double)alpha / 255.0));
+    const size_t alpha_step = alpha / width;
+    struct pixmap* pm = &ctx.shadow;
+
+    if (pm->width == size + width) {
+        return true; // already rendered
+    }
 
-        if (thumb) {
-            const ssize_t thumb_w = thumb->width * THUMB_SELECTED_SCALE;
-            const ssize_t thumb_h = thumb->height * THUMB_SELECTED_SCALE;
-            const ssize_t tx = x + thumb_size / 2 - thumb_w / 2;
-            const ssize_t ty = y + thumb_size / 2 - thumb_h / 2;
-            pixmap_scale(thumbnail_get_aa(), thumb, window, tx, ty,
-                         THUMB_SELECTED_SCALE, image->alpha);
-        }
+    pixmap_free(pm);
+    if (!pixmap_create(pm, size + width, size + width)) {
+        memset(pm, 0, sizeof(*pm));
+        return false;
+    }
 
-        // shadow
-        if (ARGB_GET_A(ctx.clr_shadow)) {
-            const argb_t base = ctx.clr_shadow & 0x00ffffff;
-            const uint8_t alpha = ARGB_GET_A(ctx.clr_shadow);
-            const size_t width =
-                max(1, (double)thumb_size / 15.0 * ((double)alpha / 255.0));
-            const size_t alpha_step = alpha / width;
-
-            for (size_t i = 0; i < width; ++i) {
-                const ssize_t lx = i + x + thumb_size;
-                const ssize_t ly = y + width;
-                const ssize_t lh = thumb_size - (width - i);
-                const argb_t color = base | ARGB_SET_A(alpha - i * alpha_step);
-                pixmap_vline(window, lx, ly, lh, color);
-            }
-            for (size_t i = 0; i < width; ++i) {
-                const ssize_t lx = x + width;
-                const ssize_t ly = y + thumb_size + i;
-                const ssize_t lw = thumb_size - (width - i) + 1;
-                const argb_t color = base | ARGB_SET_A(alpha - i * alpha_step);
-                pixmap_hline(window, lx, ly, lw, color);
-            }
-        }
+    for (size_t i = 0; i < width; ++i) {
+        const ssize_t lx = i + size;
+        const ssize_t lh = size - (width - i);
+        const argb_t color = base | ARGB_SET_A(alpha - i * alpha_step);
+        pixmap_vline(pm, lx, width, lh, color);
+    }
+    for (size_t i = 0; i < width; ++i) {
+        const ssize_t ly = size + i;
+        const ssize_t lw = size - (width - i) + 1;
+        const argb_t color = base | ARGB_SET_A(alpha - i * alpha_step);
+        pixmap_hline(pm, width, ly, lw, color);
+    }
 
-        // border
-        if (ARGB_GET_A(ctx.clr_border)) {
-            pixmap_rect(window, x, y, thumb_size, thumb_size, ctx.clr_border);
+    return true;
+}
+
+/**
+ * Render selected (enlarged) tile, the last one is reused.
+ * @param index image index
+ * @param image thumbnail image
+ * @param size size of the selected tile
+ * @return false if tile is not available
+ */
+static bool render_selected(size_t index, const struct image* image,
+                            size_t size)
+{
+    const struct pixmap* thumb = image ? &image->frames[0].pm : NULL;
+    const enum aa_mode aa = thumbnail_get_aa();
+    // address of a freed thumbnail can be reused by a new one
+    const size_t generation = image ? image->generation : 0;
+    struct selection* sel = &ctx.selection;
+
+    if (sel->pm.width == size && sel->index == index &&
+        sel->generation == generation && sel->aa == aa) {
+        return true; // already rendered
+    }
+
+    if (sel->pm.width != size) {
+        pixmap_free(&sel->pm);
+        if (!pixmap_create(&sel->pm, size, size)) {
+            memset(&sel->pm, 0, sizeof(sel->pm));
+            return false;
         }
     }
+
+    pixmap_fill(&sel->pm, 0, 0, size, size, ctx.clr_select);
+    if (thumb) {
+        const ssize_t thumb_w = thumb->width * THUMB_SELECTED_SCALE;
+        const ssize_t thumb_h = thumb->height * THUMB_SELECTED_SCALE;
+        const ssize_t tx = size / 2 - thumb_w / 2;
+        const ssize_t ty = size / 2 - thumb_h / 2;
+        pixmap_scale(aa, thumb, &sel->pm, tx, ty, THUMB_SELECTED_SCALE,
+                     image->alpha);
+    }
+    if (ARGB_GET_A(ctx.clr_border)) {
+        pixmap_rect(&sel->pm, 0, 0, size, size, ctx.clr_border);
+    }
+
+    sel->index = index;
+    sel->generation = generation;
+    sel->aa = aa;
+
+    return true;
 }
 
 /**
- * Draw thumbnails.
- * @param window destination window
+ * Draw selected (enlarged) thumbnail.
+ * @param window destination canvas
+ * @param x,y top left coordinate of the tile on the canvas, already adjusted
+ * @param index image index
+ * @param image thumbnail image
  */
-static void draw_thumbnails(struct pixmap* window)
+static void draw_selected(struct pixmap* window, ssize_t x, ssize_t y,
+                          size_t index, const struct image* image)
+{
+    const size_t size = THUMB_SELECTED_SCALE * ctx.thumb_size;
+
+    if (ARGB_GET_A(ctx.clr_shadow) && render_shadow(size)) {
+        pixmap_copy(&ctx.shadow, window, x, y, true);
+    }
+    if (render_selected(index, image, size)) {
+        pixmap_copy(&ctx.selection.pm, window, x, y, false);
+    }
+}
+
+/**
+ * Draw rows of unselected thumbnails on the grid.
+ * @param first,last range of rows to draw
+ */
+static void draw_rows(size_t first, size_t last)
 {
     size_t cols, rows, gap;
-    size_t index = ctx.top;
-    ssize_t select_x = 0;
-    ssize_t select_y = 0;
-    const struct thumbnail* select_th = NULL;
+    size_t pitch, index;
+    ssize_t top, bottom;
 
-    // thumbnail layout
     get_layout(&cols, &rows, &gap);
-    ++rows;
+    pitch = ctx.thumb_size + gap;
+
+    // clear the rows including gaps, the last one is partially visible
+    top = first * pitch;
+    bottom = last < rows ? (last + 1) * pitch : ctx.grid.height;
+    pixmap_fill(&ctx.grid, 0, top, ctx.grid.width, bottom - top,
+                ctx.clr_window);
 
-    // draw
-    for (size_t row = 0; row < rows; ++row) {
-        const ssize_t y = row * ctx.thumb_size + gap * (row + 1);
+    if (first * cols > image_list_distance(ctx.top, image_list_last())) {
+        return; // rows after the end of the list
+    }
+
+    index = image_list_jump(ctx.top, first * cols, true);
+    for (size_t row = first; row <= last; ++row) {
+        const ssize_t y = row * pitch + gap;
         for (size_t col = 0; col < cols; ++col) {
-            const ssize_t x = col * ctx.thumb_size + gap * (col + 1);
+            const ssize_t x = col * pitch + gap;
             const struct thumbnail* th = thumbnail_get(index);
 
-            // draw preview, but postpone the selected item
-            if (index == ctx.selected) {
-                select_x = x;
-                select_y = y;
-                select_th = th;
-            } else {
-                draw_thumbnail(window, x, y, th ? th->image : NULL, false);
-            }
+            draw_thumbnail(&ctx.grid, x, y, th ? th->image : NULL);
 
-            // get next thumbnail index
             index = image_list_nearest(index, true, false);
             if (index == IMGLIST_INVALID) {
-                goto done;
+                return;
             }
         }
     }
+}
+
+/**
+ * Update grid of unselected thumbnails to the current layout.
+ * Rows that stay visible after scrolling are moved instead of redrawing,
+ * only the newly exposed rows are drawn.
+ * @return false if grid is not available
+ */
+static bool update_grid(void)
+{
+    const size_t width = ui_get_width();
+    const size_t height = ui_get_height();
+    size_t cols, rows, gap;
+    size_t pitch;
+    size_t shift = 0;
+
+    if (ctx.grid.width != width || ctx.grid.height != height) {
+        pixmap_free(&ctx.grid);
+        ctx.grid_top = IMGLIST_INVALID;
+        if (!pixmap_create(&ctx.grid, width, height)) {
+            memset(&ctx.grid, 0, sizeof(ctx.grid));
+            return false;
+        }
+    }
+    if (ctx.grid_top == ctx.top) {
+        return true;
+    }
+
+    get_layout(&cols, &rows, &gap);
+    pitch = ctx.thumb_size + gap;
+
+    // number of rows scrolled since the last update
+    if (ctx.grid_top != IMGLIST_INVALID && cols != 0) {
+        const size_t distance = image_list_distance(ctx.grid_top, ctx.top);
+        if (distance % cols == 0) {
+            shift = distance / cols;
+        }
+    }
+
+    if (shift == 0 || shift > rows || shift * pitch >= height) {
+        draw_rows(0, rows);
+    } else {
+        const size_t offset = shift * pitch * width;
+        const size_t size = (height - shift * pitch) * width * sizeof(argb_t);
+        if (ctx.top > ctx.grid_top) {
+            // scroll down: move rows up and draw the bottom ones
+            memmove(ctx.grid.data, ctx.grid.data + offset, size);
+            draw_rows((height - shift * pitch) / pitch, rows);
+        } else {
+            // scroll up: move rows down and draw the top ones
+            memmove(ctx.grid.data + offset, ctx.grid.data, size);
+            draw_rows(0, shift - 1);
+        }
+    }
 
-done:
-    // draw selected thumbnail
-    draw_thumbnail(window, select_x, select_y,
-                   select_th ? select_th->image : NULL, true);
+    ctx.grid_top = ctx.top;
+
+    return true;
+}
+
+/**
+ * Draw thumbnail tile on the grid.
+ * @param index image index
+ */
+static void draw_tile(size_t index)
+{
+    const struct thumbnail* th;
+    ssize_t x, y;
+
+    // invalid grid will be completely redrawn anyway, thumbnails that are
+    // out of the screen are only put to the cache
+    if (ctx.grid_top != IMGLIST_INVALID && get_tile(index, &x, &y) &&
+        update_grid()) {
+        th = thumbnail_get(index);
+        draw_thumbnail(&ctx.grid, x, y, th ? th->image : NULL);
+    }
 }
 
 /**
@@ -393,6 +685,7 @@ done:
 static void redraw(void)
 {
     struct pixmap* wnd;
+    ssize_t x, y;
 
     if (image_list_first() == IMGLIST_INVALID) {
         printf("No more images, exit\n");
@@ -400,14 +693,31 @@ static void redraw(void)
         return;
     }
 
-    wnd = ui_draw_begin();
-    if (!wnd) {
+    if (!ui_draw_begin()) {
         return;
     }
 
-    pixmap_fill(wnd, 0, 0, wnd->width, wnd->height, ctx.clr_window);
-    draw_thumbnails(wnd);
-    info_print(wnd);
+    wnd = ui_draw_window(&x, &y);
+    if (wnd) {
+        if (update_grid()) {
+            // put the grid and the selected tile above it
+            const struct thumbnail* th = thumbnail_get(ctx.selected);
+            ssize_t sx, sy;
+            pixmap_copy(&ctx.grid, wnd, -x, -y, false);
+            if (get_tile(ctx.selected, &sx, &sy)) {
+                get_selected_tile(&sx, &sy);
+                draw_selected(wnd, sx - x, sy - y, ctx.selected,
+                              th ? th->image : NULL);
+            }
+        } else {
+            pixmap_fill(wnd, 0, 0, wnd->width, wnd->height, ctx.clr_window);
+        }
+        ctx.drawn_top = ctx.top;
+    }
+    wnd = ui_draw_overlay(&x, &y);
+    if (wnd) {
+        info_print(wnd, x, y);
+    }
 
     ui_draw_commit();
 }
@@ -424,6 +734,7 @@ static void apply_action(const struct action* action)
                         aa_name(thumbnail_switch_aa(action->params)));
             thumbnail_clear(IMGLIST_INVALID, IMGLIST_INVALID);
             reset_loader();
+            reset_tiles();
             app_redraw();
             break;
         case action_first_file:
@@ -446,6 +757,7 @@ static void apply_action(const struct action* action)
         case action_reload:
             thumbnail_clear(IMGLIST_INVALID, IMGLIST_INVALID);
             reset_loader();
+            reset_tiles();
             app_redraw();
             break;
         case action_exec:
@@ -453,7 +765,6 @@ static void apply_action(const struct action* action)
             break;
         case action_status:
             info_update(info_status, "%s", action->params);
-            app_redraw();
             break;
         case action_mode:
             app_switch_mode(ctx.selected);
@@ -463,6 +774,31 @@ static void apply_action(const struct action* action)
     }
 }
 
+/**
+ * Image list change handler: the same images stay selected and displayed.
+ */
+static void on_list_update(void)
+{
+    ctx.top = image_list_remap_nearest(ctx.top);
+    ctx.selected = image_list_remap_nearest(ctx.selected);
+    ctx.drawn_top = IMGLIST_INVALID;
+    ctx.queue_top = IMGLIST_INVALID;
+    reset_tiles();
+    if (ctx.selected == IMGLIST_INVALID) {
+        ctx.selected = image_list_first();
+    }
+    if (ctx.top == IMGLIST_INVALID) {
+        ctx.top = ctx.selected;
+    }
+    thumbnail_remap();
+
+    if (!app_is_viewer()) {
+        update_info();
+        update_layout();
+        app_redraw();
+    }
+}
+
 /**
  * Background loader thread callback.
  * @param image loaded image instance, NULL if load error
@@ -474,16 +810,17 @@ static void on_image_load(struct image* image, size_t index)
         loader_queue_reset();
         skip_thumbnail(index);
     } else {
-        if (thumbnail_get(index)) {
+        if (thumbnail_cached(index)) {
             image_free(image);
         } else {
             thumbnail_add(image);
             if (index == ctx.selected) {
                 update_info();
             }
+            draw_tile(index);
+            redraw_tile(index, index == ctx.selected);
         }
     }
-    app_redraw();
 }
 
 void gallery_init(const struct config* cfg, struct image* image)
@@ -492,6 +829,9 @@ void gallery_init(const struct config* cfg, struct image* image)
 
     ctx.thumb_size = config_get_num(cfg, CFG_GALLERY, CFG_GLRY_SIZE, 1, 1024);
     ctx.thumb_cache = config_get_num(cfg, CFG_GALLERY, CFG_GLRY_CACHE, 0, 1024);
+    // most of thumbnails are read from the persistent storage, reading of
+    // the original files is a waste of I/O
+    ctx.prefetch = !config_get_bool(cfg, CFG_GALLERY, CFG_GLRY_PSTORE);
 
     ctx.clr_window = config_get_color(cfg, CFG_GALLERY, CFG_GLRY_WINDOW);
     ctx.clr_background = config_get_color(cfg, CFG_GALLERY, CFG_GLRY_BKG);
@@ -501,7 +841,13 @@ void gallery_init(const struct config* cfg, struct image* image)
 
     ctx.top = image_list_first();
     ctx.selected = ctx.top;
+    ctx.queue_top = IMGLIST_INVALID;
+    ctx.forward = true;
+    reset_tiles();
     if (image) {
+        loader_set_size_hint(ctx.thumb_size);
+        loader_set_hook(thumbnail_prepare);
+        loader_set_cache(thumbnail_load);
         thumbnail_add(image);
         select_thumbnail(image->index);
     }
@@ -509,6 +855,9 @@ void gallery_init(const struct config* cfg, struct image* image)
 
 void gallery_destroy(void)
 {
+    pixmap_free(&ctx.grid);
+    pixmap_free(&ctx.selection.pm);
+    pixmap_free(&ctx.shadow);
     thumbnail_free();
 }
 
@@ -522,6 +871,12 @@ void gallery_handle(const struct event* event)
             redraw();
             break;
         case event_activate:
+            loader_set_shared(false);
+            loader_set_size_hint(ctx.thumb_size);
+            loader_set_hook(thumbnail_prepare);
+            loader_set_cache(thumbnail_load);
+            // thumbnails could be changed in viewer mode
+            reset_tiles();
             select_thumbnail(event->param.activate.index);
             break;
         case event_load:
@@ -530,7 +885,12 @@ void gallery_handle(const struct event* event)
         case event_resize:
             update_layout();
             break;
+        case event_list:
+            on_list_update();
+            break;
         case event_drag:
+        case event_progress:
+        case event_update:
             break; // unused in gallery mode
     }
 }
@@ -0,0 +1,361 @@
+// SPDX-License-Identifier: MIT
+// GPU renderer: draw scaled image with OpenGL ES.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "gpu.h"
+
+#include "pixmap_ablend.h"
+
+#define WL_EGL_PLATFORM 1
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-egl.h>
+
+// Shader sources
+static const char* vertex_shader = "attribute vec2 pos;\n"
+                                   "attribute vec2 tex;\n"
+                                   "varying vec2 uv;\n"
+                                   "void main() {\n"
+                                   "  uv = tex;\n"
+                                   "  gl_Position = vec4(pos, 0.0, 1.0);\n"
+                                   "}\n";
+
+// Texture is uploaded as is (BGRA in memory), so channels are swizzled in
+// the shader; bicubic filter uses Catmull-Rom spline, the same as CPU scaler
+static const char* fragment_shader =
+    "precision highp float;\n"
+    "uniform sampler2D img;\n"
+    "uniform vec2 size;\n"
+    "uniform bool bicubic;\n"
+    "varying vec2 uv;\n"
+    "vec4 weights(float t) {\n"
+    "  return vec4(((-0.5 * t + 1.0) * t - 0.5) * t,\n"
+    "              (1.5 * t - 2.5) * t * t + 1.0,\n"
+    "              ((-1.5 * t + 2.0) * t + 0.5) * t,\n"
+    "              (0.5 * t - 0.5) * t * t);\n"
+    "}\n"
+    "void main() {\n"
+    "  if (!bicubic) {\n"
+    "    gl_FragColor = texture2D(img, uv).bgra;\n"
+    "    return;\n"
+    "  }\n"
+    "  vec2 pos = uv * size - 0.5;\n"
+    "  vec2 base = floor(pos) + 0.5;\n"
+    "  vec4 wx = weights(pos.x - floor(pos.x));\n"
+    "  vec4 wy = weights(pos.y - floor(pos.y));\n"
+    "  vec4 color = vec4(0.0);\n"
+    "  for (int j = 0; j < 4; ++j) {\n"
+    "    vec4 row = vec4(0.0);\n"
+    "    for (int i = 0; i < 4; ++i) {\n"
+    "      vec2 pt = (base + vec2(float(i - 1), float(j - 1))) / size;\n"
+    "      row += texture2D(img, pt) * wx[i];\n"
+    "    }\n"
+    "    color += row * wy[j];\n"
+    "  }\n"
+    "  color = clamp(color, 0.0, 1.0);\n"
+    "  color.rgb = min(color.rgb, vec3(color.a));\n"
+    "  gl_FragColor = color.bgra;\n"
+    "}\n";
+
+/** GPU renderer context. */
+struct gpu {
+    EGLDisplay display;
+    EGLContext context;
+    EGLSurface surface;
+    struct wl_egl_window* window;
+    size_t width, height; ///< Size of the window buffer
+
+    GLuint program;
+    GLint pos;     ///< Attribute: vertex position
+    GLint tex;     ///< Attribute: texture coordinates
+    GLint size;    ///< Uniform: image size
+    GLint bicubic; ///< Uniform: bicubic filter flag
+
+    GLuint texture;
+    size_t tex_width, tex_height; ///< Size of the uploaded image
+    bool mipmap;                  ///< Mipmaps are supported (GLES 3)
+    bool mipmap_valid;            ///< Mipmaps are generated for the texture
+    GLint max_size;               ///< Max texture size
+};
+
+/** Global GPU renderer context. */
+static struct gpu ctx;
+
+/**
+ * Compile shader.
+ * @param type shader type
+ * @param source shader source
+ * @return shader id or 0 on errors
+ */
+static GLuint compile_shader(GLenum type, const char* source)
+{
+    GLint status;
+    const GLuint shader = glCreateShader(type);
+
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status) {
+        char log[512];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        fprintf(stderr, "Unable to compile shader: %s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+/**
+ * Create shader program.
+ * @return true if program was linked
+ */
+static bool create_program(void)
+{
+    GLuint vs, fs;
+    GLint status;
+
+    vs = compile_shader(GL_VERTEX_SHADER, vertex_shader);
+    fs = compile_shader(GL_FRAGMENT_SHADER, fragment_shader);
+    if (!vs || !fs) {
+        glDeleteShader(vs);
+        glDeleteShader(fs);
+        return false;
+    }
+
+    ctx.program = glCreateProgram();
+    glAttachShader(ctx.program, vs);
+    glAttachShader(ctx.program, fs);
+    glLinkProgram(ctx.program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    glGetProgramiv(ctx.program, GL_LINK_STATUS, &status);
+    if (!status) {
+        fprintf(stderr, "Unable to link shader program\n");
+        return false;
+    }
+
+    ctx.pos = glGetAttribLocation(ctx.program, "pos");
+    ctx.tex = glGetAttribLocation(ctx.program, "tex");
+    ctx.size = glGetUniformLocation(ctx.program, "size");
+    ctx.bicubic = glGetUniformLocation(ctx.program, "bicubic");
+
+    return true;
+}
+
+/**
+ * Create EGL context, GLES 3 is preferred for NPOT mipmaps.
+ * @param config EGL frame buffer configuration
+ * @return true if context was created
+ */
+static bool create_context(EGLConfig config)
+{
+    for (EGLint version = 3; version >= 2; --version) {
+        const EGLint attrs[] = { EGL_CONTEXT_CLIENT_VERSION, version,
+                                 EGL_NONE };
+        ctx.context =
+            eglCreateContext(ctx.display, config, EGL_NO_CONTEXT, attrs);
+        if (ctx.context != EGL_NO_CONTEXT) {
+            ctx.mipmap = (version >= 3);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool gpu_init(struct wl_display* display, struct wl_surface* surface)
+{
+    static const EGLint config_attrs[] = {
+        EGL_SURFACE_TYPE,
+        EGL_WINDOW_BIT,
+        EGL_RED_SIZE,
+        8,
+        EGL_GREEN_SIZE,
+        8,
+        EGL_BLUE_SIZE,
+        8,
+        EGL_ALPHA_SIZE,
+        8,
+        EGL_RENDERABLE_TYPE,
+        EGL_OPENGL_ES2_BIT,
+        EGL_NONE,
+    };
+    EGLConfig config;
+    EGLint num;
+
+    ctx.display = eglGetDisplay(display);
+    if (ctx.display == EGL_NO_DISPLAY ||
+        !eglInitialize(ctx.display, NULL, NULL)) {
+        fprintf(stderr, "Unable to initialize EGL\n");
+        ctx.display = EGL_NO_DISPLAY;
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_ES_API) ||
+        !eglChooseConfig(ctx.display, config_attrs, &config, 1, &num) ||
+        num == 0 || !create_context(config)) {
+        fprintf(stderr, "Unable to create EGL context\n");
+        gpu_destroy();
+        return false;
+    }
+
+    ctx.width = 1;
+    ctx.height = 1;
+    ctx.window = wl_egl_window_create(surface, ctx.width, ctx.height);
+    if (!ctx.window) {
+        gpu_destroy();
+        return false;
+    }
+    ctx.surface = eglCreateWindowSurface(
+        ctx.display, config, (EGLNativeWindowType)ctx.window, NULL);
+    if (ctx.surface == EGL_NO_SURFACE ||
+        !eglMakeCurrent(ctx.display, ctx.surface, ctx.surface, ctx.context)) {
+        fprintf(stderr, "Unable to create EGL surface\n");
+        gpu_destroy();
+        return false;
+    }
+
+    // surface is committed by the main window, don't wait for frame callback
+    eglSwapInterval(ctx.display, 0);
+
+    if (!create_program()) {
+        gpu_destroy();
+        return false;
+    }
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &ctx.max_size);
+
+    glGenTextures(1, &ctx.texture);
+    glBindTexture(GL_TEXTURE_2D, ctx.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    return true;
+}
+
+void gpu_destroy(void)
+{
+    if (ctx.display != EGL_NO_DISPLAY) {
+        if (ctx.context != EGL_NO_CONTEXT) {
+            if (ctx.texture) {
+                glDeleteTextures(1, &ctx.texture);
+            }
+            if (ctx.program) {
+                glDeleteProgram(ctx.program);
+            }
+            eglMakeCurrent(ctx.display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                           EGL_NO_CONTEXT);
+            eglDestroyContext(ctx.display, ctx.context);
+        }
+        if (ctx.surface != EGL_NO_SURFACE) {
+            eglDestroySurface(ctx.display, ctx.surface);
+        }
+        eglTerminate(ctx.display);
+    }
+    if (ctx.window) {
+        wl_egl_window_destroy(ctx.window);
+    }
+    memset(&ctx, 0, sizeof(ctx));
+}
+
+size_t gpu_max_size(void)
+{
+    return ctx.max_size > 0 ? ctx.max_size : 0;
+}
+
+bool gpu_upload(const struct pixmap* pm, bool alpha)
+{
+    struct pixmap tmp = *pm;
+
+    if (pm->width > gpu_max_size() || pm->height > gpu_max_size()) {
+        return false;
+    }
+
+    // premultiply before upload: filtering must be done on premultiplied
+    // colors, otherwise transparent pixels bleed into edges
+    if (alpha) {
+        if (!pixmap_create(&tmp, pm->width, pm->height)) {
+            return false;
+        }
+        alpha_premultiply(pm->data, tmp.data, pm->width * pm->height);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, ctx.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (ctx.tex_width == pm->width && ctx.tex_height == pm->height) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, pm->width, pm->height,
+                        GL_RGBA, GL_UNSIGNED_BYTE, tmp.data);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, pm->width, pm->height, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, tmp.data);
+        ctx.tex_width = pm->width;
+        ctx.tex_height = pm->height;
+    }
+    ctx.mipmap_valid = false;
+
+    if (alpha) {
+        pixmap_free(&tmp);
+    }
+
+    return glGetError() == GL_NO_ERROR;
+}
+
+bool gpu_draw(size_t width, size_t height, double x, double y, double scale,
+              enum aa_mode aa)
+{
+    const GLfloat u0 = x / ctx.tex_width;
+    const GLfloat v0 = y / ctx.tex_height;
+    const GLfloat u1 = (x + width / scale) / ctx.tex_width;
+    const GLfloat v1 = (y + height / scale) / ctx.tex_height;
+    const GLfloat pos[] = { -1, 1, -1, -1, 1, 1, 1, -1 };
+    const GLfloat tex[] = { u0, v0, u0, v1, u1, v0, u1, v1 };
+    GLint min_filter, mag_filter;
+    bool bicubic = false;
+
+    if (!ctx.tex_width || !ctx.tex_height) {
+        return false;
+    }
+
+    if (ctx.width != width || ctx.height != height) {
+        wl_egl_window_resize(ctx.window, width, height, 0, 0);
+        ctx.width = width;
+        ctx.height = height;
+    }
+
+    // setup filters
+    mag_filter = (aa == aa_nearest || aa == aa_box) ? GL_NEAREST : GL_LINEAR;
+    min_filter = (aa == aa_nearest) ? GL_NEAREST : GL_LINEAR;
+    if (scale < 1.0 && aa != aa_nearest && ctx.mipmap) {
+        if (!ctx.mipmap_valid) {
+            glGenerateMipmap(GL_TEXTURE_2D);
+            ctx.mipmap_valid = true;
+        }
+        min_filter = GL_LINEAR_MIPMAP_LINEAR;
+    }
+    if (scale > 1.0 && (aa == aa_bicubic || aa == aa_mks13)) {
+        bicubic = true;
+        mag_filter = GL_NEAREST;
+    }
+    glBindTexture(GL_TEXTURE_2D, ctx.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
+
+    glViewport(0, 0, width, height);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glUseProgram(ctx.program);
+    glUniform2f(ctx.size, ctx.tex_width, ctx.tex_height);
+    glUniform1i(ctx.bicubic, bicubic);
+    glVertexAttribPointer(ctx.pos, 2, GL_FLOAT, GL_FALSE, 0, pos);
+    glVertexAttribPointer(ctx.tex, 2, GL_FLOAT, GL_FALSE, 0, tex);
+    glEnableVertexAttribArray(ctx.pos);
+    glEnableVertexAttribArray(ctx.tex);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glDisableVertexAttribArray(ctx.pos);
+    glDisableVertexAttribArray(ctx.tex);
+
+    return eglSwapBuffers(ctx.display, ctx.surface);
+}
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: MIT
+// GPU renderer: draw scaled image with OpenGL ES.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include "pixmap_scale.h"
+
+// forward declarations to avoid including wayland headers
+struct wl_display;
+struct wl_surface;
+
+/**
+ * Initialize GPU renderer for the surface.
+ * @param display wayland display
+ * @param surface target surface
+ * @return true if renderer is ready to use
+ */
+bool gpu_init(struct wl_display* display, struct wl_surface* surface);
+
+/**
+ * Destroy GPU renderer.
+ */
+void gpu_destroy(void);
+
+/**
+ * Get max size of the image supported by GPU.
+ * @return max width/height of the texture in pixels
+ */
+size_t gpu_max_size(void);
+
+/**
+ * Upload image to the GPU memory.
+ * @param pm image pixmap
+ * @param alpha true if image has transparent pixels
+ * @return true if image was uploaded
+ */
+bool gpu_upload(const struct pixmap* pm, bool alpha);
+
+/**
+ * Draw uploaded image on the surface and commit it.
+ * @param width,height size of the surface buffer in pixels
+ * @param x,y position of the surface left top corner on the image
+ * @param scale image scale factor
+ * @param aa scale filter to use
+ * @return true if surface was drawn
+ */
+bool gpu_draw(size_t width, size_t height, double x, double y, double scale,
+              enum aa_mode aa);
@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: MIT
+// High dynamic range grayscale images with adjustable window/level.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "grayscale.h"
+
+#include "tpool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Number of entries in the color table: one per each 16-bit sample value
+#define LUT_SIZE 65536
+
+// Min number of rows processed by a single thread
+#define MIN_ROWS 64
+
+/** Area of the frame. */
+struct area {
+    size_t x, y;
+    size_t width, height;
+};
+
+/** Grayscale image context. */
+struct grayscale {
+    const int16_t* samples; ///< Pixel samples
+    size_t width, height;   ///< Image size
+    int16_t min, max;       ///< Range of sample values
+
+    ssize_t win_center; ///< Window center
+    ssize_t win_width;  ///< Window width
+
+    argb_t lut[LUT_SIZE]; ///< Colors of the current window by sample value
+    struct area valid;    ///< Area of the frame drawn with the current window
+};
+
+/** Color conversion task. */
+struct gray_task {
+    const struct grayscale* gs; ///< Grayscale context
+    struct pixmap* pm;          ///< Destination frame
+    struct area area;           ///< Area to update
+};
+
+/**
+ * Rebuild color table for the current window.
+ * @param gs grayscale context
+ */
+static void update_lut(struct grayscale* gs)
+{
+    const ssize_t low = gs->win_center - gs->win_width / 2;
+
+    for (size_t i = 0; i < LUT_SIZE; ++i) {
+        const ssize_t value = (int16_t)i; // index is the raw sample bits
+        ssize_t color = ((value - low) * 255) / gs->win_width;
+        if (color < 0) {
+            color = 0;
+        } else if (color > 255) {
+            color = 255;
+        }
+        gs->lut[i] = ARGB(0xff, color, color, color);
+    }
+
+    gs->valid.width = 0;
+    gs->valid.height = 0;
+}
+
+/** Color conversion handler, see `tpool_fn`. */
+static void convert(void* data, size_t low, size_t high)
+{
+    const struct gray_task* task = data;
+    const struct grayscale* gs = task->gs;
+    const argb_t* lut = gs->lut;
+
+    for (size_t y = task->area.y + low; y < task->area.y + high; ++y) {
+        const size_t offset = y * gs->width + task->area.x;
+        const uint16_t* src = (const uint16_t*)&gs->samples[offset];
+        argb_t* dst = &task->pm->data[offset];
+        for (size_t x = 0; x < task->area.width; ++x) {
+            dst[x] = lut[src[x]];
+        }
+    }
+}
+
+/**
+ * Apply color table to the area of the frame.
+ * @param gs grayscale context
+ * @param pm destination frame
+ * @param area area to update
+ * @param parallel flag to use thread pool
+ */
+static void apply_lut(const struct grayscale* gs, struct pixmap* pm,
+                      const struct area* area, bool parallel)
+{
+    struct gray_task task = {
+        .gs = gs,
+        .pm = pm,
+        .area = *area,
+    };
+    if (parallel) {
+        tpool_run(convert, &task, area->height, MIN_ROWS);
+    } else {
+        convert(&task, 0, area->height);
+    }
+}
+
+bool grayscale_create(struct image* image, const int16_t* samples,
+                      size_t width, size_t height, int16_t min, int16_t max)
+{
+    const size_t size = width * height * sizeof(*samples);
+    const struct area whole = { 0, 0, width, height };
+    struct grayscale* gs;
+    struct pixmap* pm;
+    int16_t* copy;
+
+    gs = malloc(sizeof(*gs));
+    if (!gs) {
+        return false;
+    }
+    pm = image_allocate_frame(image, width, height);
+    if (!pm) {
+        free(gs);
+        return false;
+    }
+
+    gs->samples = samples;
+    gs->width = width;
+    gs->height = height;
+    gs->min = min;
+    gs->max = max;
+    image->gray = gs;
+    grayscale_reset(image);
+    apply_lut(gs, pm, &whole, image_threads(image) > 1);
+
+    // keep samples for the full size image only
+    copy = image->size_hint ? NULL : malloc(size);
+    if (!copy) {
+        free(gs);
+        image->gray = NULL;
+        return true;
+    }
+    memcpy(copy, samples, size);
+    gs->samples = copy;
+    gs->valid = whole;
+
+    return true;
+}
+
+void grayscale_free(struct image* image)
+{
+    struct grayscale* gs = image->gray;
+
+    if (gs) {
+        free((void*)gs->samples);
+        free(gs);
+        image->gray = NULL;
+    }
+}
+
+void grayscale_adjust(struct image* image, ssize_t center, ssize_t width)
+{
+    struct grayscale* gs = image->gray;
+
+    gs->win_center += center;
+    if (gs->win_center < INT16_MIN) {
+        gs->win_center = INT16_MIN;
+    } else if (gs->win_center > INT16_MAX) {
+        gs->win_center = INT16_MAX;
+    }
+
+    gs->win_width += width;
+    if (gs->win_width < 1) {
+        gs->win_width = 1;
+    } else if (gs->win_width > LUT_SIZE) {
+        gs->win_width = LUT_SIZE;
+    }
+
+    update_lut(gs);
+    image_free_mipmap(image); // mipmaps are not updated with the window
+}
+
+void grayscale_reset(struct image* image)
+{
+    struct grayscale* gs = image->gray;
+
+    gs->win_width = gs->max > gs->min ? gs->max - gs->min : 1;
+    gs->win_center = gs->min + gs->win_width / 2;
+
+    update_lut(gs);
+    image_free_mipmap(image);
+}
+
+void grayscale_window(const struct image* image, ssize_t* center,
+                      ssize_t* width)
+{
+    const struct grayscale* gs = image->gray;
+    *center = gs->win_center;
+    *width = gs->win_width;
+}
+
+void grayscale_update(struct image* image, size_t x, size_t y, size_t width,
+                      size_t height)
+{
+    struct grayscale* gs = image->gray;
+    struct area* valid = &gs->valid;
+    struct area area;
+
+    area.x = x < gs->width ? x : gs->width;
+    area.y = y < gs->height ? y : gs->height;
+    area.width = min(width, gs->width - area.x);
+    area.height = min(height, gs->height - area.y);
+
+    if (area.width == 0 || area.height == 0) {
+        return;
+    }
+    if (area.x >= valid->x && area.y >= valid->y &&
+        area.x + area.width <= valid->x + valid->width &&
+        area.y + area.height <= valid->y + valid->height) {
+        return; // already up to date
+    }
+
+    apply_lut(gs, &image->frames[0].pm, &area, true);
+    *valid = area;
+}
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: MIT
+// High dynamic range grayscale images with adjustable window/level.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include "image.h"
+
+/**
+ * Setup grayscale image from 16-bit samples: the first frame of the image is
+ * created and filled using the window that covers the whole range of values.
+ * Samples are kept in the image to change the window later, except for
+ * thumbnails.
+ * @param image image context
+ * @param samples array of pixel samples
+ * @param width,height size of the image
+ * @param min,max range of sample values
+ * @return true if frame was created
+ */
+bool grayscale_create(struct image* image, const int16_t* samples,
+                      size_t width, size_t height, int16_t min, int16_t max);
+
+/**
+ * Free samples, the image keeps the frame as it is.
+ * @param image image context
+ */
+void grayscale_free(struct image* image);
+
+/**
+ * Change window/level of the image.
+ * The frame is not updated, see `grayscale_update`.
+ * @param image image context
+ * @param center delta for the window center
+ * @param width delta for the window width
+ */
+void grayscale_adjust(struct image* image, ssize_t center, ssize_t width);
+
+/**
+ * Reset window to the whole range of sample values.
+ * @param image image context
+ */
+void grayscale_reset(struct image* image);
+
+/**
+ * Get current window.
+ * @param image image context
+ * @param center,width output window center and width
+ */
+void grayscale_window(const struct image* image, ssize_t* center,
+                      ssize_t* width);
+
+/**
+ * Apply current window to the area of the frame, does nothing if the area
+ * is already up to date.
+ * @param image image context
+ * @param x,y,width,height area of the frame to update
+ */
+void grayscale_update(struct image* image, size_t x, size_t y, size_t width,
+                      size_t height);
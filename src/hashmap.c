@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: MIT
+// Hash map with integer keys.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "hashmap.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Initial number of slots
+#define INITIAL_CAPACITY 16
+
+/**
+ * Get home slot of the key.
+ * @param map hash map instance
+ * @param key key of the entry
+ * @return index of the slot
+ */
+static size_t home_slot(const struct hashmap* map, size_t key)
+{
+    // Fibonacci hashing: spread sequential indices and aligned pointers
+    uint64_t hash = (uint64_t)key * 0x9e3779b97f4a7c15ULL;
+    hash ^= hash >> 32;
+    return hash & (map->capacity - 1);
+}
+
+/**
+ * Find slot of the key.
+ * @param map hash map instance
+ * @param key key of the entry
+ * @return index of the slot with the key or of the empty slot
+ */
+static size_t find_slot(const struct hashmap* map, size_t key)
+{
+    size_t pos = home_slot(map, key);
+
+    while (map->slots[pos].value && map->slots[pos].key != key) {
+        pos = (pos + 1) & (map->capacity - 1);
+    }
+
+    return pos;
+}
+
+/**
+ * Reallocate slots.
+ * @param map hash map instance
+ * @param capacity new number of slots
+ * @return false if not enough memory
+ */
+static bool rehash(struct hashmap* map, size_t capacity)
+{
+    struct hashmap_slot* old = map->slots;
+    const size_t old_capacity = map->capacity;
+
+    map->slots = calloc(capacity, sizeof(*map->slots));
+    if (!map->slots) {
+        map->slots = old;
+        return false;
+    }
+    map->capacity = capacity;
+
+    for (size_t i = 0; i < old_capacity; ++i) {
+        if (old[i].value) {
+            map->slots[find_slot(map, old[i].key)] = old[i];
+        }
+    }
+    free(old);
+
+    return true;
+}
+
+void hashmap_free(struct hashmap* map)
+{
+    free(map->slots);
+    map->slots = NULL;
+    map->capacity = 0;
+    map->size = 0;
+}
+
+bool hashmap_put(struct hashmap* map, size_t key, void* value)
+{
+    size_t pos;
+
+    // keep load factor below 3/4
+    if ((map->size + 1) * 4 > map->capacity * 3 &&
+        !rehash(map, map->capacity ? map->capacity * 2 : INITIAL_CAPACITY)) {
+        return false;
+    }
+
+    pos = find_slot(map, key);
+    if (!map->slots[pos].value) {
+        ++map->size;
+    }
+    map->slots[pos].key = key;
+    map->slots[pos].value = value;
+
+    return true;
+}
+
+void* hashmap_get(const struct hashmap* map, size_t key)
+{
+    return map->size ? map->slots[find_slot(map, key)].value : NULL;
+}
+
+void* hashmap_remove(struct hashmap* map, size_t key)
+{
+    const size_t mask = map->capacity - 1;
+    size_t pos, next;
+    void* value;
+
+    if (!map->size) {
+        return NULL;
+    }
+
+    pos = find_slot(map, key);
+    value = map->slots[pos].value;
+    if (!value) {
+        return NULL;
+    }
+    --map->size;
+
+    // shift back the following entries of the probe sequence
+    next = pos;
+    while (true) {
+        size_t home;
+        next = (next + 1) & mask;
+        if (!map->slots[next].value) {
+            break;
+        }
+        home = home_slot(map, map->slots[next].key);
+        // move the entry if its home slot is not in (pos, next]
+        if (((next - home) & mask) >= ((next - pos) & mask)) {
+            map->slots[pos] = map->slots[next];
+            pos = next;
+        }
+    }
+    map->slots[pos].value = NULL;
+
+    return value;
+}
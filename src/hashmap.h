@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: MIT
+// Hash map with integer keys.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Hash map slot. */
+struct hashmap_slot {
+    size_t key;  ///< Key of the entry
+    void* value; ///< Value of the entry, NULL for empty slot
+};
+
+/** Hash map, zero initialized instance is an empty map. */
+struct hashmap {
+    struct hashmap_slot* slots; ///< Array of slots
+    size_t capacity;            ///< Number of slots (power of 2)
+    size_t size;                ///< Number of entries
+};
+
+/**
+ * Free hash map resources, values are not freed.
+ * @param map hash map instance
+ */
+void hashmap_free(struct hashmap* map);
+
+/**
+ * Put value to the map, the previous value of the key is replaced.
+ * @param map hash map instance
+ * @param key key of the entry
+ * @param value value of the entry, can't be NULL
+ * @return false if not enough memory
+ */
+bool hashmap_put(struct hashmap* map, size_t key, void* value);
+
+/**
+ * Get value from the map.
+ * @param map hash map instance
+ * @param key key of the entry
+ * @return value or NULL if key not found
+ */
+void* hashmap_get(const struct hashmap* map, size_t key);
+
+/**
+ * Remove entry from the map.
+ * @param map hash map instance
+ * @param key key of the entry
+ * @return removed value or NULL if key not found
+ */
+void* hashmap_remove(struct hashmap* map, size_t key);
@@ -4,16 +4,56 @@
 
 #include "image.h"
 
+#include "animation.h"
+#include "application.h"
 #include "array.h"
+#include "buildcfg.h"
+#include "grayscale.h"
+#include "pixmap_scale.h"
+#include "tiles.h"
+#include "tpool.h"
+#include "worker.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Min size of mipmap level
+#define MIPMAP_MIN_SIZE 64
+
+/** Mipmap levels of the frame. */
+struct mipmap_levels {
+    struct pixmap* levels; ///< Reduced copies (each is 2x smaller)
+    size_t num;            ///< Number of levels
+};
+
+/** Mipmaps created in background. */
+struct mipmap {
+    const struct image* image;     ///< Image to reduce
+    size_t limit;                  ///< Max total size of mipmaps in bytes
+    bool ready;                    ///< Levels are created
+    bool attached;                 ///< Levels are moved to the frames
+    size_t num_frames;             ///< Number of frames
+    struct mipmap_levels frames[]; ///< Levels of each frame
+};
 
 struct image* image_alloc(void)
 {
-    return calloc(1, sizeof(struct image));
+    static size_t generation;
+    struct image* ctx = calloc(1, sizeof(struct image));
+
+    if (ctx) {
+        // distinguishes instances allocated at the same address
+        ctx->generation =
+            __atomic_add_fetch(&generation, 1, __ATOMIC_RELAXED);
+    }
+
+    return ctx;
 }
 
 void image_free(struct image* ctx)
@@ -23,11 +63,7 @@ void image_free(struct image* ctx)
 
         free(ctx->source);
         free(ctx->parent_dir);
-        free(ctx->format);
-
-        list_for_each(ctx->info, struct image_info, it) {
-            free(it);
-        }
+        image_free_meta(ctx);
 
         free(ctx);
     }
@@ -61,24 +97,405 @@ void image_set_source(struct image* ctx, const char* source)
     }
 }
 
+size_t image_get_width(const struct image* ctx)
+{
+    const struct pixmap* pm = &ctx->frames[0].pm;
+    const size_t width = ctx->tiles ? ctx->full_width : pm->width;
+    const size_t height = ctx->tiles ? ctx->full_height : pm->height;
+    return ctx->orient & orient_transpose ? height : width;
+}
+
+size_t image_get_height(const struct image* ctx)
+{
+    const struct pixmap* pm = &ctx->frames[0].pm;
+    const size_t width = ctx->tiles ? ctx->full_width : pm->width;
+    const size_t height = ctx->tiles ? ctx->full_height : pm->height;
+    return ctx->orient & orient_transpose ? width : height;
+}
+
 void image_flip_vertical(struct image* ctx)
 {
+    ctx->orient ^= orient_flip_y;
+}
+
+void image_flip_horizontal(struct image* ctx)
+{
+    ctx->orient ^= orient_flip_x;
+}
+
+void image_rotate(struct image* ctx, size_t angle)
+{
+    for (; angle >= 90; angle -= 90) {
+        // the new displayed x axis is the old y axis from bottom to top,
+        // the new y axis is the old x axis
+        enum pixmap_orient orient = orient_normal;
+        if (!(ctx->orient & orient_transpose)) {
+            orient |= orient_transpose;
+        }
+        if (!(ctx->orient & orient_flip_y)) {
+            orient |= orient_flip_x;
+        }
+        if (ctx->orient & orient_flip_x) {
+            orient |= orient_flip_y;
+        }
+        ctx->orient = orient;
+    }
+}
+
+/**
+ * Allocate frame buffer in shared memory.
+ * @param frame destination frame
+ * @param width,height frame size in px
+ * @return true if buffer was allocated
+ */
+static bool create_shared(struct image_frame* frame, size_t width,
+                          size_t height)
+{
+    const size_t size = width * height * sizeof(argb_t);
+    char path[64];
+    void* data;
+    int fd;
+
+    // frame address is unique while the file exists
+    snprintf(path, sizeof(path), "/" APP_NAME "_%x_%p", getpid(),
+             (void*)frame);
+
+    fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1) {
+        const int err = errno;
+        fprintf(stderr, "Unable to create shared file %s: [%i] %s\n", path, err,
+                strerror(err));
+        return false;
+    }
+    shm_unlink(path);
+
+    if (ftruncate(fd, size) == -1) {
+        close(fd);
+        return false;
+    }
+    data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    frame->pm.width = width;
+    frame->pm.height = height;
+    frame->pm.data = data;
+    frame->shm_size = size;
+    frame->shm_fd = fd;
+
+    return true;
+}
+
+/**
+ * Free frame buffer.
+ * @param frame frame to free
+ */
+static void free_frame(struct image_frame* frame)
+{
+    if (frame->shm_size) {
+        munmap(frame->pm.data, frame->shm_size);
+        if (frame->shm_fd != -1) {
+            close(frame->shm_fd);
+        }
+        frame->shm_size = 0;
+    } else {
+        pixmap_free(&frame->pm);
+    }
+    frame->pm.data = NULL;
+}
+
+/**
+ * Move frame buffer from shared to heap memory, transformations can
+ * reallocate pixel data.
+ * @param frame frame to convert
+ * @return true if frame data is on the heap now
+ */
+static bool unshare_frame(struct image_frame* frame)
+{
+    struct pixmap pm;
+
+    if (!frame->shm_size) {
+        return true;
+    }
+    if (!pixmap_create(&pm, frame->pm.width, frame->pm.height)) {
+        return false;
+    }
+    memcpy(pm.data, frame->pm.data, frame->shm_size);
+    free_frame(frame);
+    frame->pm = pm;
+
+    return true;
+}
+
+static void orient_task(void* data, size_t low, size_t high)
+{
+    // Each range is a set of frames
+    const struct image* image = data;
+
+    for (size_t i = low; i < high; ++i) {
+        pixmap_orient(&image->frames[i].pm, image->orient);
+    }
+}
+
+double image_hint_scale(const struct image* ctx, size_t width, size_t height)
+{
+    const size_t min_side = min(width, height);
+    if (ctx->size_hint == 0 || min_side <= ctx->size_hint) {
+        return 1.0;
+    }
+    return (double)ctx->size_hint / min_side;
+}
+
+bool image_cancelled(const struct image* ctx)
+{
+    return ctx->cancel && __atomic_load_n(ctx->cancel, __ATOMIC_RELAXED);
+}
+
+size_t image_threads(const struct image* ctx)
+{
+    return ctx->cancel ? 1 : tpool_threads();
+}
+
+void image_progress(const struct image* ctx, size_t rows)
+{
+    if (ctx->progress) {
+        ctx->progress(ctx, rows);
+    }
+}
+
+bool image_render(const struct image* ctx, struct pixmap* dst, ssize_t x,
+                  ssize_t y, double scale)
+{
+    const struct pixmap* pm = &ctx->frames[0].pm;
+    const ssize_t x0 = max(0, x);
+    const ssize_t y0 = max(0, y);
+    const ssize_t x1 = min((ssize_t)dst->width, x + pm->width * scale);
+    const ssize_t y1 = min((ssize_t)dst->height, y + pm->height * scale);
+    struct pixmap area;
+    bool rc;
+
+    if (!ctx->vector.render) {
+        return false;
+    }
+    if (x0 >= x1 || y0 >= y1) {
+        return true; // image is not visible
+    }
+
+    // render visible area only
+    if (!pixmap_create(&area, x1 - x0, y1 - y0)) {
+        return false;
+    }
+    rc = ctx->vector.render(ctx->vector.data, &area, x - x0, y - y0, scale);
+    if (rc) {
+        pixmap_copy(&area, dst, x0, y0, ctx->alpha);
+    }
+    pixmap_free(&area);
+
+    return rc;
+}
+
+void image_free_vector(struct image* ctx)
+{
+    if (ctx->vector.free) {
+        ctx->vector.free(ctx->vector.data);
+    }
+    memset(&ctx->vector, 0, sizeof(ctx->vector));
+}
+
+size_t image_memory(const struct image* ctx)
+{
+    size_t size = 0;
+
     for (size_t i = 0; i < ctx->num_frames; ++i) {
-        pixmap_flip_vertical(&ctx->frames[i].pm);
+        const struct image_frame* frame = &ctx->frames[i];
+        size += frame->pm.width * frame->pm.height *
+            pixmap_bpp(frame->pm.format);
+        for (size_t j = 0; j < frame->mipmap_levels; ++j) {
+            size += frame->mipmap[j].width * frame->mipmap[j].height *
+                sizeof(argb_t);
+        }
     }
+
+    return size;
 }
 
-void image_flip_horizontal(struct image* ctx)
+void image_apply_orient(struct image* ctx)
+{
+    if (ctx->orient != orient_normal) {
+        if (ctx->anim) {
+            // frames decoded ahead get the same transform
+            animation_orient(ctx, ctx->orient);
+        }
+        // tiles and samples kept for redraw would not be transformed
+        tiles_free(ctx);
+        image_free_vector(ctx);
+        if (ctx->gray) {
+            // whole frame must be drawn with the current window
+            grayscale_update(ctx, 0, 0, SIZE_MAX, SIZE_MAX);
+            grayscale_free(ctx);
+        }
+        // stop background jobs before the frames are changed
+        worker_cancel(ctx);
+        image_free_mipmap(ctx);
+        for (size_t i = 0; i < ctx->num_frames; ++i) {
+            if (!unshare_frame(&ctx->frames[i])) {
+                return;
+            }
+        }
+        tpool_run(orient_task, ctx, ctx->num_frames, 1);
+        ctx->orient = orient_normal;
+    }
+}
+
+/**
+ * Create chain of 2x reduced copies of the frame.
+ * @param pm frame to reduce
+ * @param mm levels to fill
+ * @param total total size of created levels in bytes, updated
+ * @param limit max total size of levels in bytes
+ * @return false if the limit is reached or on errors
+ */
+static bool reduce_frame(const struct pixmap* pm, struct mipmap_levels* mm,
+                         size_t* total, size_t limit)
 {
+    const struct pixmap* prev = pm;
+
+    while (prev->width / 2 >= MIPMAP_MIN_SIZE &&
+           prev->height / 2 >= MIPMAP_MIN_SIZE) {
+        const size_t width = (prev->width + 1) / 2;
+        const size_t height = (prev->height + 1) / 2;
+        const size_t size = width * height * sizeof(argb_t);
+        struct pixmap* levels;
+
+        if (*total + size > limit) {
+            return false;
+        }
+        levels = realloc(mm->levels, (mm->num + 1) * sizeof(*levels));
+        if (!levels) {
+            return false;
+        }
+        mm->levels = levels;
+        if (!pixmap_reduce(prev, &levels[mm->num])) {
+            return false;
+        }
+        prev = &levels[mm->num++];
+        *total += size;
+    }
+
+    return true;
+}
+
+bool image_create_mipmap(struct image* ctx, size_t limit)
+{
+    size_t total = 0;
+
     for (size_t i = 0; i < ctx->num_frames; ++i) {
-        pixmap_flip_horizontal(&ctx->frames[i].pm);
+        struct image_frame* frame = &ctx->frames[i];
+        struct mipmap_levels mm;
+        bool rc;
+
+        if (frame->mipmap) {
+            continue; // already created
+        }
+
+        mm.levels = NULL;
+        mm.num = 0;
+        rc = reduce_frame(&frame->pm, &mm, &total, limit);
+        frame->mipmap = mm.levels;
+        frame->mipmap_levels = mm.num;
+        if (!rc) {
+            break;
+        }
     }
+
+    return total != 0;
 }
 
-void image_rotate(struct image* ctx, size_t angle)
+/** Create mipmaps in background, see `worker_fn`. */
+static void build_mipmap(void* data)
+{
+    struct mipmap* mm = data;
+    size_t total = 0;
+
+    for (size_t i = 0; i < mm->num_frames; ++i) {
+        if (!reduce_frame(&mm->image->frames[i].pm, &mm->frames[i], &total,
+                          mm->limit)) {
+            break;
+        }
+    }
+
+    __atomic_store_n(&mm->ready, true, __ATOMIC_RELEASE);
+    app_on_update(mm->image->generation);
+}
+
+bool image_build_mipmap(struct image* ctx, size_t limit)
+{
+    struct mipmap* mm = ctx->mipmap;
+
+    if (!mm) {
+        mm = calloc(1, sizeof(*mm) + ctx->num_frames * sizeof(mm->frames[0]));
+        if (!mm) {
+            return false;
+        }
+        mm->image = ctx;
+        mm->limit = limit;
+        mm->num_frames = ctx->num_frames;
+        ctx->mipmap = mm;
+        if (!worker_post(build_mipmap, mm)) {
+            mm->attached = true; // draw without mipmaps
+        }
+        return false;
+    }
+
+    return !mm->attached && __atomic_load_n(&mm->ready, __ATOMIC_ACQUIRE);
+}
+
+void image_attach_mipmap(struct image* ctx)
 {
+    struct mipmap* mm = ctx->mipmap;
+
+    if (!mm || mm->attached || !__atomic_load_n(&mm->ready, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
     for (size_t i = 0; i < ctx->num_frames; ++i) {
-        pixmap_rotate(&ctx->frames[i].pm, angle);
+        struct image_frame* frame = &ctx->frames[i];
+        if (!frame->mipmap) {
+            frame->mipmap = mm->frames[i].levels;
+            frame->mipmap_levels = mm->frames[i].num;
+            mm->frames[i].levels = NULL;
+            mm->frames[i].num = 0;
+        }
+    }
+    mm->attached = true;
+}
+
+void image_free_mipmap(struct image* ctx)
+{
+    struct mipmap* mm = ctx->mipmap;
+
+    if (mm) {
+        worker_cancel(mm);
+        for (size_t i = 0; i < mm->num_frames; ++i) {
+            for (size_t j = 0; j < mm->frames[i].num; ++j) {
+                pixmap_free(&mm->frames[i].levels[j]);
+            }
+            free(mm->frames[i].levels);
+        }
+        free(mm);
+        ctx->mipmap = NULL;
+    }
+
+    for (size_t i = 0; i < ctx->num_frames; ++i) {
+        struct image_frame* frame = &ctx->frames[i];
+        for (size_t j = 0; j < frame->mipmap_levels; ++j) {
+            pixmap_free(&frame->mipmap[j]);
+        }
+        free(frame->mipmap);
+        frame->mipmap = NULL;
+        frame->mipmap_levels = 0;
     }
 }
 
@@ -140,12 +557,136 @@ void image_add_meta(struct image* ctx, const char* key, const char* fmt, ...)
     ctx->info = list_append(ctx->info, entry);
 }
 
+bool image_set_exif(struct image* ctx, const uint8_t* data, size_t size)
+{
+    uint8_t* copy = NULL;
+
+    if (data && size) {
+        copy = malloc(size);
+        if (!copy) {
+            return false;
+        }
+        memcpy(copy, data, size);
+    }
+
+    free(ctx->exif);
+    ctx->exif = copy;
+    ctx->exif_size = copy ? size : 0;
+
+    return true;
+}
+
+void image_free_meta(struct image* ctx)
+{
+    image_set_exif(ctx, NULL, 0);
+
+    free(ctx->format);
+    ctx->format = NULL;
+
+    list_for_each(ctx->info, struct image_info, it) {
+        free(it);
+    }
+    ctx->info = NULL;
+}
+
+/**
+ * Append string to the meta data buffer.
+ * @param str string to append, NULL is stored as an empty string
+ * @param meta pointer to the buffer
+ * @param size pointer to the size of the buffer
+ * @return false if not enough memory
+ */
+static bool meta_append(const char* str, char** meta, size_t* size)
+{
+    const size_t len = (str ? strlen(str) : 0) + 1;
+    char* buf = realloc(*meta, *size + len);
+
+    if (!buf) {
+        return false;
+    }
+    memcpy(buf + *size, str ? str : "", len);
+    *meta = buf;
+    *size += len;
+
+    return true;
+}
+
+bool image_pack_meta(const struct image* ctx, char** meta, size_t* size)
+{
+    *meta = NULL;
+    *size = 0;
+
+    if (!meta_append(ctx->source, meta, size) ||
+        !meta_append(ctx->format, meta, size)) {
+        goto fail;
+    }
+    list_for_each(ctx->info, const struct image_info, it) {
+        if (!meta_append(it->key, meta, size) ||
+            !meta_append(it->value, meta, size)) {
+            goto fail;
+        }
+    }
+
+    return true;
+
+fail:
+    free(*meta);
+    *meta = NULL;
+    *size = 0;
+    return false;
+}
+
+bool image_unpack_meta(struct image* ctx, const char* source,
+                       const char* meta, size_t size)
+{
+    const char* end = meta + size;
+    const char* format;
+    const char* ptr;
+
+    if (size == 0 || meta[size - 1]) {
+        return false; // not null-terminated
+    }
+
+    // source path (check for hash collision)
+    if (strcmp(meta, source) != 0) {
+        return false;
+    }
+    ptr = meta + strlen(meta) + 1;
+
+    // format description
+    if (ptr >= end) {
+        return false;
+    }
+    format = ptr;
+    ptr += strlen(ptr) + 1;
+
+    // meta info
+    while (ptr < end) {
+        const char* key = ptr;
+        const char* value;
+        ptr += strlen(ptr) + 1;
+        if (ptr >= end) {
+            return false;
+        }
+        value = ptr;
+        ptr += strlen(ptr) + 1;
+        image_add_meta(ctx, key, "%s", value);
+    }
+
+    image_set_format(ctx, "%s", format);
+
+    return true;
+}
+
 struct pixmap* image_allocate_frame(struct image* ctx, size_t width,
                                     size_t height)
 {
-    if (image_create_frames(ctx, 1) &&
-        pixmap_create(&ctx->frames[0].pm, width, height)) {
-        return &ctx->frames[0].pm;
+    if (image_create_frames(ctx, 1)) {
+        struct image_frame* frame = &ctx->frames[0];
+        if ((ctx->shared && create_shared(frame, width, height)) ||
+            pixmap_create(&frame->pm, width, height)) {
+            return &frame->pm;
+        }
     }
     image_free_frames(ctx);
     return NULL;
@@ -166,10 +707,29 @@ struct image_frame* image_create_frames(struct image* ctx, size_t num)
 
 void image_free_frames(struct image* ctx)
 {
+    worker_cancel(ctx); // jobs owned by the image read its frames
+    animation_free(ctx);
+    tiles_free(ctx);
+    image_free_vector(ctx);
+    grayscale_free(ctx);
+    image_free_mipmap(ctx);
     for (size_t i = 0; i < ctx->num_frames; ++i) {
-        pixmap_free(&ctx->frames[i].pm);
+        free_frame(&ctx->frames[i]);
     }
     free(ctx->frames);
     ctx->frames = NULL;
     ctx->num_frames = 0;
 }
+
+void image_diff_frames(struct image* ctx)
+{
+    if (ctx->num_frames < 2) {
+        return;
+    }
+    for (size_t i = 0; i < ctx->num_frames; ++i) {
+        struct image_frame* frame = &ctx->frames[i];
+        const size_t prev = (i == 0 ? ctx->num_frames : i) - 1;
+        frame->partial =
+            pixmap_diff(&ctx->frames[prev].pm, &frame->pm, &frame->changed);
+    }
+}
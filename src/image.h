@@ -17,8 +17,14 @@
 
 /** Image frame. */
 struct image_frame {
-    struct pixmap pm; ///< Frame data
-    size_t duration;  ///< Frame duration in milliseconds (animation)
+    struct pixmap pm;           ///< Frame data
+    size_t duration;            ///< Frame duration in milliseconds (animation)
+    struct pixmap* mipmap;      ///< Reduced copies (each is 2x smaller)
+    size_t mipmap_levels;       ///< Number of levels in mipmap
+    size_t shm_size;            ///< Shared memory size, 0 if heap
+    int shm_fd;                 ///< Shared memory file descriptor, can be -1
+    struct pixmap_area changed; ///< Area changed since the previous frame
+    bool partial;               ///< Only `changed` area differs, whole if not
 };
 
 /** Image meta info. */
@@ -28,9 +34,41 @@ struct image_info {
     char* value;      ///< Meta value
 };
 
+struct animation;
+struct grayscale;
+struct image;
+struct mipmap;
+struct tiles;
+
+/**
+ * Decoding progress handler.
+ * @param image image being decoded, the first frame is already allocated
+ * @param rows number of top rows of the first frame decoded so far
+ */
+typedef void (*image_progress_fn)(const struct image* image, size_t rows);
+
+/**
+ * Render scalable image.
+ * @param data renderer specific data
+ * @param pm destination pixmap, filled with transparent color
+ * @param x,y position of the image on the destination pixmap
+ * @param scale scale of the image relative to the size of the first frame
+ * @return false on errors
+ */
+typedef bool (*image_render_fn)(void* data, struct pixmap* pm, ssize_t x,
+                                ssize_t y, double scale);
+
+/** Renderer of scalable (vector) image. */
+struct image_vector {
+    image_render_fn render;   ///< Render function, NULL if not scalable
+    void (*free)(void* data); ///< Renderer destructor
+    void* data;               ///< Renderer specific data
+};
+
 /** Image context. */
 struct image {
     size_t index;               ///< Index of the entry in the image list
+    size_t generation;          ///< Unique number of the image instance
     char* source;               ///< Image source (e.g. path to the image file)
     const char* name;           ///< Name of the image file
     char* parent_dir;           ///< Parent directory name
@@ -38,8 +76,26 @@ struct image {
     char* format;               ///< Format description
     struct image_frame* frames; ///< Image frames
     size_t num_frames;          ///< Total number of frames
+    struct animation* anim;     ///< Frames decoded on demand, can be NULL
+    struct tiles* tiles;        ///< Tiles decoded on demand, can be NULL
+    struct mipmap* mipmap;      ///< Mipmaps created in background or NULL
+    struct image_vector vector; ///< Renderer of scalable image
+    struct grayscale* gray;     ///< Samples with adjustable window, can be NULL
     bool alpha;                 ///< Image has alpha channel
+    bool shared;                ///< Allocate frame in shared memory
+    const bool* cancel;         ///< Decoding cancellation flag
+    image_progress_fn progress; ///< Decoding progress handler
+    size_t size_hint;           ///< Min size of decoded frame, 0 for full size
+    bool allow_preview;         ///< Decoder may produce a fast preview
+    bool preview;               ///< Image is a preview, full size is pending
+    size_t full_width;          ///< Width before reduction on decoding
+    size_t full_height;         ///< Height before reduction on decoding
+    bool thumbnail;             ///< Frame is reduced to thumbnail
+    size_t decode_time;         ///< Time spent on decoding in milliseconds
+    enum pixmap_orient orient;  ///< Orientation applied on drawing
     struct image_info* info;    ///< Image meta info
+    uint8_t* exif;              ///< Raw EXIF data, parsed to meta on demand
+    size_t exif_size;           ///< Size of raw EXIF data in bytes
 };
 
 /**
@@ -61,25 +117,136 @@ void image_free(struct image* ctx);
  */
 void image_set_source(struct image* ctx, const char* source);
 
+/**
+ * Get width of the image as it is displayed (with orientation applied).
+ * @param ctx image context
+ * @return image width in px
+ */
+size_t image_get_width(const struct image* ctx);
+
+/**
+ * Get height of the image as it is displayed (with orientation applied).
+ * @param ctx image context
+ * @return image height in px
+ */
+size_t image_get_height(const struct image* ctx);
+
 /**
  * Flip image vertically.
+ * The pixel data is not changed, only the orientation transform is updated.
  * @param ctx image context
  */
 void image_flip_vertical(struct image* ctx);
 
 /**
  * Flip image horizontally.
+ * The pixel data is not changed, only the orientation transform is updated.
  * @param ctx image context
  */
 void image_flip_horizontal(struct image* ctx);
 
 /**
- * Rotate image.
+ * Rotate image clockwise.
+ * The pixel data is not changed, only the orientation transform is updated.
  * @param ctx image context
  * @param angle rotation angle (only 90, 180, or 270)
  */
 void image_rotate(struct image* ctx, size_t angle);
 
+/**
+ * Get scale factor to reduce the image on decoding according to the size
+ * hint: both sides of the reduced image are not less than the hint.
+ * Decoders that apply the reduction must set the full size of the image.
+ * @param ctx image context
+ * @param width,height full size of the image
+ * @return scale factor in range (0, 1], 1 means full size
+ */
+double image_hint_scale(const struct image* ctx, size_t width, size_t height);
+
+/**
+ * Check if decoding of the image was cancelled, decoders should stop and
+ * return an error as soon as possible.
+ * @param ctx image context
+ * @return true if decoding is not necessary anymore
+ */
+bool image_cancelled(const struct image* ctx);
+
+/**
+ * Get number of threads the decoder may use: the image being opened in the
+ * foreground gets the whole CPU budget, background decoders (preloading,
+ * thumbnails) run in parallel with each other and use a single thread.
+ * @param ctx image context
+ * @return number of decoding threads
+ */
+size_t image_threads(const struct image* ctx);
+
+/**
+ * Report decoding progress, called by decoders that fill the first frame
+ * row by row from top to bottom.
+ * @param ctx image context
+ * @param rows number of top rows decoded so far
+ */
+void image_progress(const struct image* ctx, size_t rows);
+
+/**
+ * Render visible part of scalable image with the specified scale.
+ * @param ctx image context
+ * @param dst destination pixmap
+ * @param x,y position of the image on the destination pixmap
+ * @param scale scale of the image
+ * @return false if image is not scalable or on errors
+ */
+bool image_render(const struct image* ctx, struct pixmap* dst, ssize_t x,
+                  ssize_t y, double scale);
+
+/**
+ * Free renderer of scalable image, the image keeps its pixel data.
+ * @param ctx image context
+ */
+void image_free_vector(struct image* ctx);
+
+/**
+ * Get size of memory used by the pixel data of all frames and mipmaps.
+ * @param ctx image context
+ * @return size in bytes
+ */
+size_t image_memory(const struct image* ctx);
+
+/**
+ * Apply orientation transform to the pixel data of all frames.
+ * @param ctx image context
+ */
+void image_apply_orient(struct image* ctx);
+
+/**
+ * Create mipmaps (chain of 2x reduced copies) for all frames.
+ * @param ctx image context
+ * @param limit max total size of mipmaps in bytes
+ * @return true if at least one level was created
+ */
+bool image_create_mipmap(struct image* ctx, size_t limit);
+
+/**
+ * Create mipmaps for all frames in background, the request is made once,
+ * the worker notifies about the result with `app_on_update`.
+ * @param ctx image context
+ * @param limit max total size of mipmaps in bytes
+ * @return true if the mipmaps are ready to be attached to the frames
+ */
+bool image_build_mipmap(struct image* ctx, size_t limit);
+
+/**
+ * Attach mipmaps created in background to the frames.
+ * @param ctx image context
+ */
+void image_attach_mipmap(struct image* ctx);
+
+/**
+ * Free mipmaps of all frames, creating in background is cancelled.
+ * @param ctx image context
+ */
+void image_free_mipmap(struct image* ctx);
+
 /**
  * Set image format description.
  * @param ctx image context
@@ -97,8 +264,46 @@ void image_set_format(struct image* ctx, const char* fmt, ...)
 void image_add_meta(struct image* ctx, const char* key, const char* fmt, ...)
     __attribute__((format(printf, 3, 4)));
 
+/**
+ * Set raw EXIF data to parse it later when meta info is really needed.
+ * @param ctx image context
+ * @param data EXIF data to copy, NULL to free the current one
+ * @param size size of EXIF data in bytes
+ * @return false if not enough memory
+ */
+bool image_set_exif(struct image* ctx, const uint8_t* data, size_t size);
+
+/**
+ * Free format description, meta info and raw EXIF data.
+ * @param ctx image context
+ */
+void image_free_meta(struct image* ctx);
+
+/**
+ * Pack source path, format description and meta info of the image to the
+ * buffer of null-terminated strings.
+ * @param ctx image context
+ * @param meta pointer to the output buffer, caller must free it
+ * @param size pointer to the size of the output buffer
+ * @return false if not enough memory
+ */
+bool image_pack_meta(const struct image* ctx, char** meta, size_t* size);
+
+/**
+ * Unpack format description and meta info packed by `image_pack_meta`.
+ * @param ctx image context
+ * @param source expected source path of the image
+ * @param meta buffer of packed meta data
+ * @param size size of the buffer
+ * @return false if meta data is invalid or belongs to another source
+ */
+bool image_unpack_meta(struct image* ctx, const char* source,
+                       const char* meta, size_t size);
+
 /**
  * Create single frame, allocate buffer and add frame to the image.
+ * If the shared flag is set, the buffer is allocated in shared memory, so it
+ * can be passed to the compositor without copying.
  * @param width frame width in px
  * @param height frame height in px
  * @return pointer to the pixmap associated with the frame, or NULL on errors
@@ -115,7 +320,15 @@ struct pixmap* image_allocate_frame(struct image* ctx, size_t width,
 struct image_frame* image_create_frames(struct image* ctx, size_t num);
 
 /**
- * Free image frames.
+ * Free image frames, waits for background jobs owned by the image (see
+ * `worker_post`).
  * @param ctx image context
  */
 void image_free_frames(struct image* ctx);
+
+/**
+ * Find areas changed between sequential animation frames, the first frame is
+ * compared with the last one.
+ * @param ctx image context
+ */
+void image_diff_frames(struct image* ctx);
@@ -2,16 +2,27 @@
 // List of images.
 // Copyright (C) 2022 Artem Senichev <artemsen@gmail.com>
 
+// d_type field of the directory entry
+#define _DEFAULT_SOURCE
+
 #include "imagelist.h"
 
 #include "array.h"
+#include "buildcfg.h"
+#include "dirindex.h"
+#include "hashmap.h"
 #include "image.h"
+#include "tpool.h"
+#include "worker.h"
 
 #include <assert.h>
 #include <ctype.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,11 +30,131 @@
 #include <time.h>
 #include <unistd.h>
 
+#ifdef HAVE_INOTIFY
+#include <sys/inotify.h>
+#endif
+
+// Size of the string arena block
+#define ARENA_BLOCK (64 * 1024)
+
 /** Image list array entry. */
 struct image_src {
-    char* source; ///< Entry name
+    char* source; ///< Entry name, allocated in the string arena
+    size_t dir;   ///< Id of the parent directory
     time_t time;
     size_t size;
+    size_t index; ///< Index of the entry before merging
+};
+
+/** Block of the string arena. */
+struct arena_block {
+    struct arena_block* prev; ///< Previously allocated block
+    size_t size;              ///< Size of the data buffer
+    size_t used;              ///< Number of used bytes
+    char data[];              ///< Strings
+};
+
+/** Directory part of the entry path. */
+struct dir_entry {
+    const char* path; ///< Path of the first entry in this directory
+    size_t len;       ///< Length of the directory part of the path
+};
+
+/** Interned directories, ids are used to compare entry locations. */
+struct dir_set {
+    struct dir_entry* dirs; ///< Known directories, id is the array index
+    size_t num;             ///< Number of known directories
+    size_t* slots;          ///< Hash set: directory id + 1, 0 for empty slot
+    size_t capacity;        ///< Number of slots (power of 2)
+};
+
+/** Directory entry found by the scanner. */
+struct scan_item {
+    char* path;           ///< Absolute path to the entry
+    struct scan_dir* dir; ///< Sub directory, NULL for regular files
+    time_t time;          ///< Modification time of the file
+    size_t size;          ///< Size of the file
+};
+
+/** Directory being scanned. */
+struct scan_dir {
+    char* path;              ///< Absolute path to the directory
+    struct scan_item* items; ///< Entries in the order of reading
+    size_t num_items;        ///< Number of entries
+    struct timespec mtime;   ///< Modification time of the directory
+    bool stale;              ///< Entries were loaded from outdated index
+    struct scan_dir* next;   ///< Next directory in the watcher queue
+};
+
+/** Background directory scanner. */
+struct scanner {
+    pthread_t thread;          ///< Scanner thread
+    bool active;               ///< Scanner thread is started
+    bool joined;               ///< Scanner thread is finished and joined
+    bool done;                 ///< Scanner thread has finished its work
+    bool stop;                 ///< Stop request
+    char* path;                ///< Absolute path to the directory to scan
+    image_list_notify notify;  ///< New files notification
+    pthread_mutex_t lock;      ///< Lock of the found files array
+    struct scan_item* found;   ///< Files found but not added to the list yet
+    size_t found_num;          ///< Number of found files
+    size_t found_cap;          ///< Capacity of the found files array
+};
+
+/** Change of the watched directory. */
+struct watch_change {
+    char* path;   ///< Absolute path, directories end with '/'
+    bool removed; ///< Entry was removed, otherwise added
+    time_t time;  ///< Modification time of the added file
+    size_t size;  ///< Size of the added file
+};
+
+/** Watcher of the scanned directories. */
+struct watcher {
+    bool enable;                  ///< Watcher is enabled
+    int fd;                       ///< inotify file descriptor
+    pthread_mutex_t lock;         ///< Lock of the directory map
+    struct hashmap dirs;          ///< Directory paths by watch descriptors
+    struct watch_change* changes; ///< Changes to apply on merge
+    size_t changes_num;           ///< Number of changes
+    size_t changes_cap;           ///< Capacity of the changes array
+    struct scan_dir* queue;       ///< New directories to scan in background
+    struct scan_dir* scanned;     ///< Scanned directories to apply on merge
+    bool posted;                  ///< Scan job is posted to the worker
+    image_list_notify notify;     ///< Scanned directories notification
+};
+
+/** Source added at runtime. */
+struct pending_src {
+    char* source;             ///< Image source
+    image_list_notify notify; ///< Background scan notification or NULL
+};
+
+/** Hash set of sources, used to search entries without a full scan. */
+struct source_set {
+    size_t* slots;   ///< Entry index + 1 for each slot, 0 for empty slot
+    size_t capacity; ///< Number of slots (power of 2)
+};
+
+/** Fenwick tree of live (not skipped) entries. */
+struct live_tree {
+    size_t* nodes;   ///< Tree nodes, 1-based
+    size_t capacity; ///< Number of allocated nodes
+    size_t size;     ///< Number of entries covered by the tree
+    size_t total;    ///< Total number of live entries
+    bool valid;      ///< Tree is up to date
+};
+
+/** Persistent directory index state. */
+struct index_state {
+    bool enable;               ///< Persistent index is enabled
+    size_t sources;            ///< Number of sources added to the list
+    char* root;                ///< Root directory of the indexed list
+    struct dirindex_dir* dirs; ///< Directories of the indexed tree
+    size_t num_dirs;           ///< Number of directories
+    size_t dirs_cap;           ///< Capacity of the directories array
+    bool dirty;                ///< Index must be saved on reorder
+    bool sorted;               ///< List is loaded from index in sort order
 };
 
 /** Context of the image list (which is actually an array). */
@@ -31,6 +162,17 @@ struct image_list {
     struct image_src* sources; ///< Array of entries
     size_t capacity;           ///< Number of allocated entries (size of array)
     size_t size;               ///< Number of entries in array
+    struct source_set set;     ///< Index of the entries
+    struct arena_block* arena; ///< Storage of the entry paths
+    struct dir_set dirs;       ///< Parent directories of the entries
+    struct live_tree live;     ///< Counters of live entries
+    size_t* remap;             ///< Map of indices before the last merge
+    size_t remap_size;         ///< Number of entries in the map
+    struct scanner scan;       ///< Background directory scanner
+    struct watcher watch;      ///< Directory watcher
+    struct index_state index;  ///< Persistent directory index
+    struct pending_src* pending; ///< Sources to add on the next merge
+    size_t pending_num;          ///< Number of pending sources
     enum list_order order;     ///< File list order
     bool reverse;              ///< Reverse order flag
     bool loop;                 ///< File list loop mode
@@ -139,17 +281,270 @@ static size_t absolute_path(const char* source, char* path, size_t path_max)
     return pos;
 }
 
+/**
+ * Get hash of the string (FNV-1a).
+ * @param str string to hash
+ * @param len length of the string
+ * @return hash value
+ */
+static size_t hash_str(const char* str, size_t len)
+{
+    return fnv1a(FNV1A_INIT, str, len);
+}
+
+/**
+ * Copy string to the arena, strings are freed all together on destroy.
+ * @param str string to copy
+ * @return pointer to the copy or NULL if not enough memory
+ */
+static char* arena_dup(const char* str)
+{
+    const size_t len = strlen(str) + 1;
+    struct arena_block* block = ctx.arena;
+    char* copy;
+
+    if (!block || block->used + len > block->size) {
+        const size_t size = max(len, ARENA_BLOCK - sizeof(*block));
+        block = malloc(sizeof(*block) + size);
+        if (!block) {
+            return NULL;
+        }
+        block->prev = ctx.arena;
+        block->size = size;
+        block->used = 0;
+        ctx.arena = block;
+    }
+
+    copy = block->data + block->used;
+    memcpy(copy, str, len);
+    block->used += len;
+
+    return copy;
+}
+
+/**
+ * Search for the directory in the hash set.
+ * @param path directory path (not null-terminated)
+ * @param len length of the path
+ * @return pointer to the slot with the directory or to the empty slot
+ */
+static size_t* dir_find(const char* path, size_t len)
+{
+    const size_t mask = ctx.dirs.capacity - 1;
+    size_t pos = hash_str(path, len) & mask;
+
+    while (ctx.dirs.slots[pos]) {
+        const struct dir_entry* dir = &ctx.dirs.dirs[ctx.dirs.slots[pos] - 1];
+        if (dir->len == len && memcmp(dir->path, path, len) == 0) {
+            break;
+        }
+        pos = (pos + 1) & mask;
+    }
+
+    return &ctx.dirs.slots[pos];
+}
+
+/**
+ * Get id of the entry parent directory, register new directory if needed.
+ * @param path path to the entry
+ * @param id pointer to store directory id
+ * @return false if not enough memory
+ */
+static bool dir_intern(const char* path, size_t* id)
+{
+    const char* delim = strrchr(path, '/');
+    const size_t len = delim ? (size_t)(delim - path) : 0;
+    size_t* slot;
+
+    // keep the hash set at most 3/4 full, the array grows along with it
+    if ((ctx.dirs.num + 1) * 4 > ctx.dirs.capacity * 3) {
+        const size_t cap = ctx.dirs.capacity ? ctx.dirs.capacity * 2 : 16;
+        size_t* slots = calloc(cap, sizeof(*slots));
+        struct dir_entry* dirs =
+            realloc(ctx.dirs.dirs, cap * sizeof(*dirs));
+        if (!slots || !dirs) {
+            free(slots);
+            if (dirs) {
+                ctx.dirs.dirs = dirs;
+            }
+            return false;
+        }
+        free(ctx.dirs.slots);
+        ctx.dirs.dirs = dirs;
+        ctx.dirs.slots = slots;
+        ctx.dirs.capacity = cap;
+        for (size_t i = 0; i < ctx.dirs.num; ++i) {
+            const struct dir_entry* dir = &ctx.dirs.dirs[i];
+            *dir_find(dir->path, dir->len) = i + 1;
+        }
+    }
+
+    slot = dir_find(path, len);
+    if (!*slot) {
+        ctx.dirs.dirs[ctx.dirs.num].path = path;
+        ctx.dirs.dirs[ctx.dirs.num].len = len;
+        *slot = ++ctx.dirs.num;
+    }
+    *id = *slot - 1;
+
+    return true;
+}
+
+/**
+ * Search for the source in the hash set.
+ * @param source image data source
+ * @return pointer to the slot with the source or to the empty slot to put it
+ */
+static size_t* set_find(const char* source)
+{
+    const size_t mask = ctx.set.capacity - 1;
+    size_t pos = hash_str(source, strlen(source)) & mask;
+
+    while (ctx.set.slots[pos]) {
+        const char* src = ctx.sources[ctx.set.slots[pos] - 1].source;
+        if (src && strcmp(src, source) == 0) {
+            break;
+        }
+        pos = (pos + 1) & mask;
+    }
+
+    return &ctx.set.slots[pos];
+}
+
+/**
+ * Rebuild hash set of sources, the set is kept at most 3/4 full.
+ * @param entries number of entries to hold
+ * @return false if not enough memory
+ */
+static bool set_rebuild(size_t entries)
+{
+    size_t capacity = 16;
+    size_t* slots;
+
+    while (entries * 4 > capacity * 3) {
+        capacity *= 2;
+    }
+    slots = calloc(capacity, sizeof(*slots));
+
+    free(ctx.set.slots);
+    ctx.set.slots = NULL;
+    ctx.set.capacity = 0;
+    if (!slots) {
+        return false;
+    }
+
+    ctx.set.slots = slots;
+    ctx.set.capacity = capacity;
+
+    for (size_t i = 0; i < ctx.size; ++i) {
+        const char* src = ctx.sources[i].source;
+        if (src) {
+            *set_find(src) = i + 1;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Rebuild tree of live entries if it is outdated.
+ */
+static void live_update(void)
+{
+    struct live_tree* live = &ctx.live;
+
+    if (live->valid) {
+        return;
+    }
+
+    if (live->capacity < ctx.size + 1) {
+        size_t* nodes = realloc(live->nodes, (ctx.size + 1) * sizeof(*nodes));
+        if (!nodes) {
+            return;
+        }
+        live->nodes = nodes;
+        live->capacity = ctx.size + 1;
+    }
+
+    memset(live->nodes, 0, (ctx.size + 1) * sizeof(*live->nodes));
+    live->size = ctx.size;
+    live->total = 0;
+    for (size_t i = 1; i <= ctx.size; ++i) {
+        const size_t parent = i + (i & -i);
+        if (ctx.sources[i - 1].source) {
+            ++live->nodes[i];
+            ++live->total;
+        }
+        if (parent <= ctx.size) {
+            live->nodes[parent] += live->nodes[i];
+        }
+    }
+    live->valid = true;
+}
+
+/**
+ * Get number of live entries before specified position.
+ * @param index position in the list
+ * @return number of live entries in range [0, index)
+ */
+static size_t live_count(size_t index)
+{
+    size_t count = 0;
+
+    for (size_t i = min(index, ctx.live.size); i; i -= i & -i) {
+        count += ctx.live.nodes[i];
+    }
+
+    return count;
+}
+
+/**
+ * Find live entry by its rank.
+ * @param rank number of live entries before the one to find
+ * @return index of the entry or IMGLIST_INVALID if not found
+ */
+static size_t live_find(size_t rank)
+{
+    size_t pos = 0;
+    size_t step = 1;
+
+    if (rank >= ctx.live.total) {
+        return IMGLIST_INVALID;
+    }
+
+    while (step * 2 <= ctx.live.size) {
+        step *= 2;
+    }
+    for (; step; step /= 2) {
+        const size_t next = pos + step;
+        if (next <= ctx.live.size && ctx.live.nodes[next] <= rank) {
+            pos = next;
+            rank -= ctx.live.nodes[next];
+        }
+    }
+
+    return pos;
+}
+
 /**
  * Add new entry to the list.
  * @param source image data source to add
  */
 static void add_entry(const char* source, struct stat* st)
 {
+    size_t* slot;
+
+    ctx.index.sorted = false;
+
+    if ((ctx.size + 1) * 4 > ctx.set.capacity * 3 &&
+        !set_rebuild((ctx.size + 1) * 2)) {
+        return;
+    }
+
     // check for duplicates
-    for (size_t i = 0; i < ctx.size; ++i) {
-        if (strcmp(ctx.sources[i].source, source) == 0) {
-            return;
-        }
+    slot = set_find(source);
+    if (*slot) {
+        return;
     }
 
     // relocate array, if needed
@@ -165,217 +560,1413 @@ static void add_entry(const char* source, struct stat* st)
     }
 
     // add new entry
-    ctx.sources[ctx.size].source = str_dup(source, NULL);
-    if (ctx.sources[ctx.size].source) {
-        switch (ctx.order) {
-            case order_mtime:
-                ctx.sources[ctx.size].time = st->st_mtime;
-                break;
-            case order_size:
-                ctx.sources[ctx.size].size = st->st_size;
-                break;
-            // avoid compiler warning
-            case order_alpha:
-            case order_numeric:
-            case order_random:
-            case order_none:
+    ctx.sources[ctx.size].source = arena_dup(source);
+    ctx.sources[ctx.size].index = IMGLIST_INVALID;
+    if (ctx.sources[ctx.size].source &&
+        dir_intern(ctx.sources[ctx.size].source,
+                   &ctx.sources[ctx.size].dir)) {
+        ctx.sources[ctx.size].time = st->st_mtime;
+        ctx.sources[ctx.size].size = st->st_size;
+        *slot = ++ctx.size;
+        ctx.live.valid = false;
+    }
+}
+
+/**
+ * Add file to the list.
+ * @param file path to the file
+ */
+static void add_file(const char* path, struct stat* st)
+{
+    char abspath[PATH_MAX];
+    if (absolute_path(path, abspath, sizeof(abspath))) {
+        add_entry(abspath, st);
+    }
+}
+
+/**
+ * Start watching the directory for new and removed files.
+ * @param path absolute path to the directory
+ */
+static void watch_dir(__attribute__((unused)) const char* path)
+{
+#ifdef HAVE_INOTIFY
+    const uint32_t mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+        IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+    int wd;
+
+    if (!ctx.watch.enable) {
+        return;
+    }
+    wd = inotify_add_watch(ctx.watch.fd, path, mask);
+    if (wd == -1) {
+        return;
+    }
+
+    // the same directory can be registered more than once
+    pthread_mutex_lock(&ctx.watch.lock);
+    if (!hashmap_get(&ctx.watch.dirs, wd)) {
+        char* copy = str_dup(path, NULL);
+        if (copy && !hashmap_put(&ctx.watch.dirs, wd, copy)) {
+            free(copy);
+        }
+    }
+    pthread_mutex_unlock(&ctx.watch.lock);
+#endif // HAVE_INOTIFY
+}
+
+/**
+ * Read entries of the directory: file type is taken from the directory entry
+ * if possible, `stat` is called only if the file list order requires it.
+ * @param dir directory to scan
+ */
+static void scan_dir(struct scan_dir* dir)
+{
+    const bool need_stat =
+        (ctx.order == order_mtime || ctx.order == order_size);
+    const bool root = (strcmp(dir->path, "/") == 0);
+    size_t capacity = 0;
+    struct dirent* de;
+    struct stat st;
+    DIR* handle;
+    int fd;
+
+    fd = open(dir->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) {
+        return;
+    }
+    if (fstat(fd, &st) == 0) {
+        dir->mtime = st.st_mtim;
+    }
+    watch_dir(dir->path);
+    handle = fdopendir(fd);
+    if (!handle) {
+        close(fd);
+        return;
+    }
+
+    while ((de = readdir(handle)) &&
+           !__atomic_load_n(&ctx.scan.stop, __ATOMIC_RELAXED)) {
+        const char* name = de->d_name;
+        struct scan_item item = { 0 };
+        bool is_dir = (de->d_type == DT_DIR);
+        bool is_reg = (de->d_type == DT_REG);
+
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+            continue; // skip link to self/parent dirs
+        }
+        if (is_dir && !ctx.recursive) {
+            continue;
+        }
+
+        if ((!is_dir && !is_reg) || (is_reg && need_stat)) {
+            // unknown type or symlink, or file info is needed for sorting
+            if (fstatat(fd, name, &st, 0) != 0) {
+                continue;
+            }
+            is_dir = S_ISDIR(st.st_mode) && ctx.recursive;
+            is_reg = S_ISREG(st.st_mode);
+            item.time = st.st_mtime;
+            item.size = st.st_size;
+        }
+        if (!is_dir && !is_reg) {
+            continue;
+        }
+
+        // compose full path
+        if (!str_dup(dir->path, &item.path) ||
+            (!root && !str_append("/", 1, &item.path)) ||
+            !str_append(name, 0, &item.path)) {
+            free(item.path);
+            continue;
+        }
+
+        if (is_dir) {
+            item.dir = calloc(1, sizeof(*item.dir));
+            if (!item.dir) {
+                free(item.path);
+                continue;
+            }
+            item.dir->path = item.path;
+            item.path = NULL;
+        }
+
+        if (dir->num_items == capacity) {
+            const size_t cap = capacity ? capacity * 2 : 64;
+            struct scan_item* items =
+                realloc(dir->items, cap * sizeof(*items));
+            if (!items) {
+                free(item.path);
+                free(item.dir);
                 break;
+            }
+            dir->items = items;
+            capacity = cap;
+        }
+        dir->items[dir->num_items++] = item;
+    }
+
+    closedir(handle);
+}
+
+/**
+ * Directory scanner handler for thread pool.
+ * @param data array of directories to scan
+ * @param low,high range of directories to scan
+ */
+static void scan_dirs(void* data, size_t low, size_t high)
+{
+    struct scan_dir** dirs = data;
+    for (size_t i = low; i < high; ++i) {
+        scan_dir(dirs[i]);
+    }
+}
+
+/**
+ * Add files from the scanned directory tree to the list and free it.
+ * Files already passed to the background scanner are skipped.
+ * @param dir root of the directory tree
+ */
+static void scan_commit(struct scan_dir* dir)
+{
+    for (size_t i = 0; i < dir->num_items; ++i) {
+        struct scan_item* item = &dir->items[i];
+        if (item->dir) {
+            scan_commit(item->dir);
+        } else if (item->path) {
+            struct stat st;
+            memset(&st, 0, sizeof(st));
+            st.st_mtime = item->time;
+            st.st_size = item->size;
+            add_entry(item->path, &st);
+            free(item->path);
+        }
+    }
+    free(dir->items);
+    free(dir->path);
+    free(dir);
+}
+
+/**
+ * Pass files found on the current scan level to the list.
+ * @param dirs scanned directories
+ * @param num number of directories
+ */
+static void scan_deliver(struct scan_dir** dirs, size_t num)
+{
+    bool found = false;
+
+    pthread_mutex_lock(&ctx.scan.lock);
+    for (size_t i = 0; i < num; ++i) {
+        struct scan_dir* dir = dirs[i];
+        for (size_t j = 0; j < dir->num_items; ++j) {
+            struct scan_item* item = &dir->items[j];
+            if (item->dir) {
+                continue;
+            }
+            if (ctx.scan.found_num == ctx.scan.found_cap) {
+                const size_t cap =
+                    ctx.scan.found_cap ? ctx.scan.found_cap * 2 : 256;
+                struct scan_item* ptr =
+                    realloc(ctx.scan.found, cap * sizeof(*ptr));
+                if (!ptr) {
+                    free(item->path);
+                    item->path = NULL;
+                    continue;
+                }
+                ctx.scan.found = ptr;
+                ctx.scan.found_cap = cap;
+            }
+            ctx.scan.found[ctx.scan.found_num++] = *item;
+            item->path = NULL; // moved
+            found = true;
+        }
+    }
+    pthread_mutex_unlock(&ctx.scan.lock);
+
+    if (found) {
+        ctx.scan.notify();
+    }
+}
+
+/**
+ * Scan directory tree level by level, directories of the same level are
+ * read in parallel.
+ * @param root root of the directory tree
+ * @param deliver handler called for each scanned level, can be NULL
+ */
+static void scan_tree(struct scan_dir* root,
+                      void (*deliver)(struct scan_dir**, size_t))
+{
+    struct scan_dir** level;
+    size_t level_size;
+
+    level = malloc(sizeof(*level));
+    if (!level) {
+        return;
+    }
+    level[0] = root;
+    level_size = 1;
+
+    while (level_size) {
+        struct scan_dir** next = NULL;
+        size_t next_size = 0;
+        size_t next_cap = 0;
+
+        tpool_run(scan_dirs, level, level_size, 1);
+        if (deliver) {
+            deliver(level, level_size);
+        }
+
+        // collect sub directories to scan on the next step
+        for (size_t i = 0; i < level_size; ++i) {
+            const struct scan_dir* dir = level[i];
+            for (size_t j = 0; j < dir->num_items; ++j) {
+                struct scan_dir* sub = dir->items[j].dir;
+                if (sub && next_size == next_cap) {
+                    const size_t cap = next_cap ? next_cap * 2 : 16;
+                    struct scan_dir** ptr =
+                        realloc(next, cap * sizeof(*next));
+                    if (!ptr) {
+                        continue; // left empty
+                    }
+                    next = ptr;
+                    next_cap = cap;
+                }
+                if (sub) {
+                    next[next_size++] = sub;
+                }
+            }
         }
-        ++ctx.size;
+
+        free(level);
+        level = next;
+        level_size = next_size;
+    }
+}
+
+/**
+ * Create root of the directory tree to scan.
+ * @param path path to the directory
+ * @return root directory or NULL on errors
+ */
+static struct scan_dir* scan_root(const char* path)
+{
+    char abspath[PATH_MAX];
+    struct scan_dir* root;
+
+    if (!absolute_path(path, abspath, sizeof(abspath))) {
+        return NULL;
+    }
+    root = calloc(1, sizeof(*root));
+    if (root && !str_dup(abspath, &root->path)) {
+        free(root);
+        root = NULL;
+    }
+
+    return root;
+}
+
+/**
+ * Free the directory tree without adding files to the list.
+ * @param dir root of the directory tree
+ */
+static void scan_free(struct scan_dir* dir)
+{
+    for (size_t i = 0; i < dir->num_items; ++i) {
+        if (dir->items[i].dir) {
+            scan_free(dir->items[i].dir);
+        } else {
+            free(dir->items[i].path);
+        }
+    }
+    free(dir->items);
+    free(dir->path);
+    free(dir);
+}
+
+/** Compare directories by path, see `qsort`. */
+static int compare_dirs(const void* a, const void* b)
+{
+    const struct scan_dir* da = *(const struct scan_dir* const*)a;
+    const struct scan_dir* db = *(const struct scan_dir* const*)b;
+    return strcmp(da->path, db->path);
+}
+
+/**
+ * Get list parameters the index depends on.
+ * @return index flags
+ */
+static uint32_t index_flags(void)
+{
+    return (uint32_t)ctx.order | (ctx.reverse ? 1 << 8 : 0) |
+        (ctx.recursive ? 1 << 9 : 0);
+}
+
+/**
+ * Remember directories of the tree to save them to the index.
+ * @param dir root of the directory tree
+ * @param parent index of the parent directory
+ */
+static void index_track(const struct scan_dir* dir, size_t parent)
+{
+    struct dirindex_dir* entry;
+    size_t id;
+
+    if (ctx.index.num_dirs == ctx.index.dirs_cap) {
+        const size_t cap = ctx.index.dirs_cap ? ctx.index.dirs_cap * 2 : 16;
+        struct dirindex_dir* dirs =
+            realloc(ctx.index.dirs, cap * sizeof(*dirs));
+        if (!dirs) {
+            ctx.index.enable = false; // incomplete index is useless
+            return;
+        }
+        ctx.index.dirs = dirs;
+        ctx.index.dirs_cap = cap;
+    }
+
+    entry = &ctx.index.dirs[ctx.index.num_dirs];
+    entry->path = arena_dup(dir->path);
+    if (!entry->path) {
+        ctx.index.enable = false;
+        return;
+    }
+    entry->mtime = dir->mtime;
+    entry->parent = parent;
+    id = ctx.index.num_dirs++;
+
+    for (size_t i = 0; i < dir->num_items; ++i) {
+        if (dir->items[i].dir) {
+            index_track(dir->items[i].dir, id);
+        }
+    }
+}
+
+/**
+ * Build the directory tree from the index. Changed directories are marked
+ * as stale, their files are not loaded.
+ * @param idx loaded index
+ * @param root root of the directory tree
+ * @param stale flags of changed directories
+ */
+static void index_tree(const struct dirindex* idx, struct scan_dir* root,
+                       const bool* stale)
+{
+    struct scan_dir** nodes;
+    size_t* counts;
+
+    nodes = calloc(idx->num_dirs, sizeof(*nodes));
+    counts = calloc(idx->num_dirs, sizeof(*counts));
+    if (!nodes || !counts) {
+        root->stale = true; // read the whole tree again
+        goto done;
+    }
+
+    for (size_t i = 1; i < idx->num_dirs; ++i) {
+        ++counts[idx->dirs[i].parent];
+    }
+    for (size_t i = 0; i < idx->num_files; ++i) {
+        ++counts[idx->files[i].dir];
+    }
+
+    // directories, parents are always stored before their children;
+    // on errors the parent is marked as stale to read it again
+    for (size_t i = 0; i < idx->num_dirs; ++i) {
+        const struct dirindex_dir* entry = &idx->dirs[i];
+        struct scan_dir* node = root;
+
+        if (i) {
+            struct scan_dir* parent = nodes[entry->parent];
+            if (!parent || !parent->items) {
+                continue;
+            }
+            node = calloc(1, sizeof(*node));
+            if (!node || !str_dup(entry->path, &node->path)) {
+                free(node);
+                parent->stale = true;
+                continue;
+            }
+            parent->items[parent->num_items++].dir = node;
+        }
+
+        node->mtime = entry->mtime;
+        node->stale = stale[i];
+        if (counts[i]) {
+            node->items = calloc(counts[i], sizeof(*node->items));
+            if (!node->items) {
+                node->stale = true;
+            }
+        }
+        nodes[i] = node;
+    }
+
+    // files
+    for (size_t i = 0; i < idx->num_files; ++i) {
+        const struct dirindex_file* file = &idx->files[i];
+        struct scan_dir* node = nodes[file->dir];
+        struct scan_item* item;
+
+        if (!node || !node->items || node->stale) {
+            continue; // will be read again
+        }
+        item = &node->items[node->num_items];
+        if (str_dup(file->path, &item->path)) {
+            item->time = file->mtime;
+            item->size = file->size;
+            ++node->num_items;
+        } else {
+            node->stale = true;
+        }
+    }
+
+done:
+    free(nodes);
+    free(counts);
+}
+
+/**
+ * Read again stale directories of the tree loaded from the index.
+ * Sub directories already known are reused, new ones are scanned.
+ * @param dir root of the directory tree
+ */
+static void index_refresh(struct scan_dir* dir)
+{
+    struct scan_dir** known = NULL;
+    bool* used = NULL;
+    size_t known_num = 0;
+    bool rescan = dir->stale;
+
+    if (rescan) {
+        if (dir->num_items) {
+            known = malloc(dir->num_items * sizeof(*known));
+            used = calloc(dir->num_items, sizeof(*used));
+        }
+        for (size_t i = 0; i < dir->num_items; ++i) {
+            struct scan_item* item = &dir->items[i];
+            if (!item->dir) {
+                free(item->path);
+            } else if (known && used) {
+                known[known_num++] = item->dir;
+            } else {
+                scan_free(item->dir);
+            }
+        }
+        free(dir->items);
+        dir->items = NULL;
+        dir->num_items = 0;
+        dir->stale = false;
+        scan_dir(dir);
+        if (known_num) {
+            qsort(known, known_num, sizeof(*known), compare_dirs);
+        }
+    }
+
+    for (size_t i = 0; i < dir->num_items; ++i) {
+        struct scan_item* item = &dir->items[i];
+        struct scan_dir** found = NULL;
+
+        if (!item->dir) {
+            continue;
+        }
+        if (!rescan) {
+            index_refresh(item->dir);
+            continue;
+        }
+
+        if (known_num) {
+            found = bsearch(&item->dir, known, known_num, sizeof(*known),
+                            compare_dirs);
+        }
+        if (found) {
+            scan_free(item->dir);
+            item->dir = *found;
+            used[found - known] = true;
+            index_refresh(item->dir);
+        } else {
+            scan_tree(item->dir, NULL); // new directory
+        }
+    }
+
+    // remove directories that no longer exist
+    for (size_t i = 0; i < known_num; ++i) {
+        if (!used[i]) {
+            scan_free(known[i]);
+        }
+    }
+    free(known);
+    free(used);
+}
+
+/**
+ * Load the directory tree from the persistent index. If nothing has been
+ * changed since the index was saved, files are added to the list in sort
+ * order directly from the index, otherwise only changed directories are
+ * read again.
+ * @param root root of the directory tree
+ * @return false if there is no valid index for the directory
+ */
+static bool index_restore(struct scan_dir* root)
+{
+    struct dirindex idx;
+    bool modified = false;
+    bool* stale;
+
+    if (!dirindex_load(&idx, root->path)) {
+        return false;
+    }
+    stale = calloc(idx.num_dirs, sizeof(*stale));
+    if (!stale || idx.flags != index_flags()) {
+        free(stale);
+        dirindex_free(&idx);
+        return false;
+    }
+
+    // check directories for changes
+    for (size_t i = 0; i < idx.num_dirs; ++i) {
+        const struct dirindex_dir* dir = &idx.dirs[i];
+        struct stat st;
+        stale[i] = stat(dir->path, &st) != 0 || !S_ISDIR(st.st_mode) ||
+            st.st_mtim.tv_sec != dir->mtime.tv_sec ||
+            st.st_mtim.tv_nsec != dir->mtime.tv_nsec;
+        modified |= stale[i];
+        if (!stale[i]) {
+            watch_dir(dir->path); // stale ones are watched on rescan
+        }
+    }
+
+    if (modified) {
+        index_tree(&idx, root, stale);
+        index_refresh(root);
+        ctx.index.dirty = true;
+    } else {
+        set_rebuild(idx.num_files);
+        for (size_t i = 0; i < idx.num_files; ++i) {
+            const struct dirindex_file* file = &idx.files[i];
+            struct stat st;
+            memset(&st, 0, sizeof(st));
+            st.st_mtime = file->mtime;
+            st.st_size = file->size;
+            add_entry(file->path, &st);
+        }
+        ctx.index.sorted = (ctx.order != order_random);
+    }
+
+    free(stale);
+    dirindex_free(&idx);
+
+    return true;
+}
+
+/**
+ * Save the list to the persistent index.
+ */
+static void index_save(void)
+{
+    struct dirindex idx = { 0 };
+    size_t* ids;
+
+    ids = malloc(ctx.dirs.num * sizeof(*ids));
+    idx.files = malloc(ctx.size * sizeof(*idx.files));
+    if (!ids || !idx.files || !ctx.dirs.capacity) {
+        goto done;
+    }
+
+    // map interned directories of the entries to the indexed ones
+    for (size_t i = 0; i < ctx.dirs.num; ++i) {
+        ids[i] = IMGLIST_INVALID;
+    }
+    for (size_t i = 0; i < ctx.index.num_dirs; ++i) {
+        const char* path = ctx.index.dirs[i].path;
+        const size_t len = path[1] ? strlen(path) : 0; // "/" is empty
+        const size_t* slot = dir_find(path, len);
+        if (*slot) {
+            ids[*slot - 1] = i;
+        }
+    }
+
+    for (size_t i = 0; i < ctx.size; ++i) {
+        const struct image_src* src = &ctx.sources[i];
+        struct dirindex_file* file = &idx.files[idx.num_files];
+        if (src->source && ids[src->dir] != IMGLIST_INVALID) {
+            file->path = src->source;
+            file->dir = ids[src->dir];
+            file->mtime = src->time;
+            file->size = src->size;
+            ++idx.num_files;
+        }
+    }
+
+    idx.dirs = ctx.index.dirs;
+    idx.num_dirs = ctx.index.num_dirs;
+    idx.flags = index_flags();
+    dirindex_save(&idx);
+
+done:
+    free(ids);
+    free(idx.files);
+}
+
+/**
+ * Add files from the directory to the list.
+ * @param path path to the directory
+ */
+static void add_dir(const char* path)
+{
+    struct scan_dir* root = scan_root(path);
+    if (!root) {
+        return;
+    }
+
+    // persistent index is used only for a single directory
+    if (ctx.index.enable && ctx.index.sources == 1 && ctx.size == 0) {
+        if (!index_restore(root)) {
+            scan_tree(root, NULL);
+            ctx.index.dirty = true;
+        }
+        if (ctx.index.dirty) {
+            index_track(root, DIRINDEX_ROOT);
+        }
+    } else {
+        scan_tree(root, NULL);
+    }
+
+    scan_commit(root);
+}
+
+/**
+ * Add change of the watched directory.
+ * @param path absolute path to the entry, the change takes ownership
+ * @param removed flag of removed entry
+ * @param time modification time of the added file
+ * @param size size of the added file
+ */
+static void watch_push(char* path, bool removed, time_t time, size_t size)
+{
+    struct watch_change* change;
+
+    if (ctx.watch.changes_num == ctx.watch.changes_cap) {
+        const size_t cap =
+            ctx.watch.changes_cap ? ctx.watch.changes_cap * 2 : 64;
+        struct watch_change* changes =
+            realloc(ctx.watch.changes, cap * sizeof(*changes));
+        if (!changes) {
+            free(path);
+            return;
+        }
+        ctx.watch.changes = changes;
+        ctx.watch.changes_cap = cap;
+    }
+
+    change = &ctx.watch.changes[ctx.watch.changes_num++];
+    change->path = path;
+    change->removed = removed;
+    change->time = time;
+    change->size = size;
+}
+
+/**
+ * Move files of the scanned directory tree to the changes and free it.
+ * @param dir root of the directory tree
+ */
+static void watch_collect(struct scan_dir* dir)
+{
+    for (size_t i = 0; i < dir->num_items; ++i) {
+        struct scan_item* item = &dir->items[i];
+        if (item->dir) {
+            watch_collect(item->dir);
+        } else if (item->path) {
+            watch_push(item->path, false, item->time, item->size);
+        }
+    }
+    free(dir->items);
+    free(dir->path);
+    free(dir);
+}
+
+#ifdef HAVE_INOTIFY
+/**
+ * Scan new directories of the watched tree, handler for the worker.
+ * @param data watcher context
+ */
+static void watch_scan(__attribute__((unused)) void* data)
+{
+    image_list_notify notify;
+
+    pthread_mutex_lock(&ctx.watch.lock);
+    while (ctx.watch.queue) {
+        struct scan_dir* root = ctx.watch.queue;
+        ctx.watch.queue = root->next;
+        pthread_mutex_unlock(&ctx.watch.lock);
+
+        scan_tree(root, NULL);
+
+        pthread_mutex_lock(&ctx.watch.lock);
+        root->next = ctx.watch.scanned;
+        ctx.watch.scanned = root;
+    }
+    ctx.watch.posted = false;
+    notify = ctx.watch.notify;
+    pthread_mutex_unlock(&ctx.watch.lock);
+
+    if (notify) {
+        notify();
+    }
+}
+
+/**
+ * Handle inotify event of the watched directory.
+ * @param event inotify event
+ */
+static void watch_event(const struct inotify_event* event)
+{
+    const char* dir;
+    char* path = NULL;
+    struct stat st;
+
+    pthread_mutex_lock(&ctx.watch.lock);
+    if (event->mask & IN_IGNORED) {
+        free(hashmap_remove(&ctx.watch.dirs, event->wd));
+    } else if (event->len) {
+        dir = hashmap_get(&ctx.watch.dirs, event->wd);
+        if (dir &&
+            (!str_dup(dir, &path) ||
+             (strcmp(dir, "/") != 0 && !str_append("/", 1, &path)) ||
+             !str_append(event->name, 0, &path))) {
+            free(path);
+            path = NULL;
+        }
+    }
+    pthread_mutex_unlock(&ctx.watch.lock);
+
+    if (!path) {
+        return;
+    }
+
+    if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        if ((event->mask & IN_ISDIR) && !str_append("/", 1, &path)) {
+            free(path);
+            return;
+        }
+        watch_push(path, true, 0, 0);
+    } else if (event->mask & IN_ISDIR) {
+        struct scan_dir* root = NULL;
+        bool queued;
+        if (ctx.recursive) {
+            root = calloc(1, sizeof(*root));
+        }
+        if (!root) {
+            free(path);
+            return;
+        }
+        root->path = path;
+        // large trees are scanned in background, don't block the UI
+        pthread_mutex_lock(&ctx.watch.lock);
+        if (!ctx.watch.posted) {
+            ctx.watch.posted = worker_post(watch_scan, &ctx.watch);
+        }
+        queued = ctx.watch.posted;
+        if (queued) {
+            root->next = ctx.watch.queue;
+            ctx.watch.queue = root;
+        }
+        pthread_mutex_unlock(&ctx.watch.lock);
+        if (!queued) {
+            scan_tree(root, NULL);
+            watch_collect(root);
+        }
+    } else if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) &&
+               stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+        // new files are added only when they are completely written
+        watch_push(path, false, st.st_mtime, st.st_size);
+    } else {
+        free(path);
+    }
+}
+#endif // HAVE_INOTIFY
+
+/**
+ * Remove entry from the list, the list is compacted by merge.
+ * @param path absolute path to the file, directories end with '/'
+ */
+static void watch_remove(const char* path)
+{
+    const size_t len = strlen(path);
+
+    if (len && path[len - 1] == '/') {
+        for (size_t i = 0; i < ctx.size; ++i) {
+            const char* src = ctx.sources[i].source;
+            if (src && strncmp(src, path, len) == 0) {
+                ctx.sources[i].source = NULL;
+            }
+        }
+    } else if (ctx.set.capacity) {
+        const size_t* slot = set_find(path);
+        if (*slot) {
+            ctx.sources[*slot - 1].source = NULL;
+        }
+    }
+}
+
+/** Background scanner thread. */
+static void* scan_thread(__attribute__((unused)) void* data)
+{
+    struct scan_dir* root = scan_root(ctx.scan.path);
+    if (root) {
+        scan_tree(root, scan_deliver);
+        scan_commit(root); // free only, files were already delivered
+    }
+    __atomic_store_n(&ctx.scan.done, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/**
+ * Stop background scanner and free its resources.
+ */
+static void scan_stop(void)
+{
+    if (ctx.scan.active) {
+        __atomic_store_n(&ctx.scan.stop, true, __ATOMIC_RELAXED);
+        if (!ctx.scan.joined) {
+            pthread_join(ctx.scan.thread, NULL);
+        }
+        pthread_mutex_destroy(&ctx.scan.lock);
+        ctx.scan.active = false;
+    }
+    for (size_t i = 0; i < ctx.scan.found_num; ++i) {
+        free(ctx.scan.found[i].path);
+    }
+    free(ctx.scan.found);
+    free(ctx.scan.path);
+    memset(&ctx.scan, 0, sizeof(ctx.scan));
+}
+
+/**
+ * Get next directory entry index (works only for paths as source).
+ * @param start index of the start position
+ * @param forward step direction
+ * @return index of the next entry or IMGLIST_INVALID if not found
+ */
+static size_t next_dir(size_t start, bool forward)
+{
+    size_t index = start;
+
+    if (start == IMGLIST_INVALID) {
+        return image_list_first();
+    }
+
+    // search for another directory in file list
+    while (true) {
+        index = image_list_nearest(index, forward, ctx.loop);
+        if (index == IMGLIST_INVALID || index == start) {
+            break; // not found
+        }
+        if (ctx.sources[index].dir != ctx.sources[start].dir) {
+            return index;
+        }
+    };
+
+    return IMGLIST_INVALID;
+}
+
+/** Sort key of the entry. */
+struct sort_key {
+    const uint8_t* str; ///< String key (alpha/numeric order)
+    size_t len;         ///< Length of the string key
+    int64_t num;        ///< Number key (mtime/size order)
+    size_t index;       ///< Index of the entry in the list
+};
+
+/** Parallel sort context. */
+struct sort_ctx {
+    struct image_src* src; ///< Entries to sort
+    struct sort_key* keys; ///< Sorted keys
+    struct sort_key* tmp;  ///< Buffer used for merging
+    uint8_t** buffers;     ///< String keys storage, one per chunk
+    size_t num;            ///< Total number of keys
+    size_t chunk;          ///< Number of keys in a chunk
+    size_t width;          ///< Size of the sorted runs on the merge step
+};
+
+/**
+ * Compose natural sort key: digit runs are replaced with their numeric
+ * values, so the keys are compared by `memcmp` in the same order as
+ * numbers in the names.
+ * @param src source string
+ * @param key destination buffer, NULL to get the key length only
+ * @return length of the key
+ */
+static size_t numeric_key(const char* src, uint8_t* key)
+{
+    // characters are compared as `char`, which may be signed
+    const uint8_t flip = CHAR_MIN < 0 ? 0x80 : 0;
+    size_t len = 0;
+
+    while (*src) {
+        if (isdigit((unsigned char)*src)) {
+            char* end;
+            const unsigned long num = strtoul(src, &end, 10);
+            uint8_t bytes = 0;
+            for (unsigned long val = num; val; val >>= 8) {
+                ++bytes;
+            }
+            if (key) {
+                // number of bytes in the range of digits: the number is
+                // placed between other characters as its first digit
+                key[len] = ('0' + bytes) ^ flip;
+                for (uint8_t i = 0; i < bytes; ++i) {
+                    key[len + bytes - i] = (num >> (i * 8)) & 0xff;
+                }
+            }
+            len += bytes + 1;
+            src = end;
+        } else {
+            if (key) {
+                key[len] = (uint8_t)*src ^ flip;
+            }
+            ++len;
+            ++src;
+        }
+    }
+
+    // end of the string is compared as a character too
+    if (key) {
+        key[len] = flip;
+    }
+    ++len;
+
+    return len;
+}
+
+/**
+ * Get string key of the entry.
+ * @param src entry source
+ * @param key destination buffer, NULL to get the key length only
+ * @param max size of the destination buffer
+ * @return length of the key
+ */
+static size_t string_key(const char* src, uint8_t* key, size_t max)
+{
+    if (ctx.order == order_numeric) {
+        return numeric_key(src, key);
+    }
+    // locale specific collation key, same order as `strcoll`
+    return strxfrm((char*)key, src, key ? max : 0);
+}
+
+/**
+ * Compare string keys.
+ * @return negative if a < b, positive if a > b, 0 otherwise
+ */
+static int compare_str(const struct sort_key* a, const struct sort_key* b)
+{
+    int cmp = memcmp(a->str, b->str, min(a->len, b->len));
+    if (cmp == 0 && a->len != b->len) {
+        cmp = a->len < b->len ? -1 : 1;
     }
+    return cmp;
 }
 
 /**
- * Add file to the list.
- * @param file path to the file
+ * Compare number keys.
+ * @return negative if a < b, positive if a > b, 0 otherwise
  */
-static void add_file(const char* path, struct stat* st)
+static int compare_num(const struct sort_key* a, const struct sort_key* b)
 {
-    char abspath[PATH_MAX];
-    if (absolute_path(path, abspath, sizeof(abspath))) {
-        add_entry(abspath, st);
+    if (a->num == b->num) {
+        return 0;
     }
+    return a->num < b->num ? -1 : 1;
 }
 
 /**
- * Add files from the directory to the list.
- * @param dir full path to the directory
+ * Compare keys callback for `qsort`, entries with the same key keep their
+ * order.
+ * @return negative if a < b, positive if a > b, 0 otherwise
  */
-static void add_dir(const char* dir)
+static int compare_keys(const void* a, const void* b)
 {
-    DIR* dir_handle;
-    struct dirent* dir_entry;
-    char* path = NULL;
+    const struct sort_key* ka = a;
+    const struct sort_key* kb = b;
+    int cmp;
 
-    dir_handle = opendir(dir);
-    if (!dir_handle) {
-        return;
+    if (ctx.order == order_mtime || ctx.order == order_size) {
+        cmp = compare_num(ka, kb);
+    } else {
+        cmp = compare_str(ka, kb);
+    }
+    if (cmp) {
+        return ctx.reverse ? -cmp : cmp;
     }
 
-    while ((dir_entry = readdir(dir_handle))) {
-        const char* name = dir_entry->d_name;
-        struct stat st;
-
-        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
-            continue; // skip link to self/parent dirs
-        }
+    return ka->index < kb->index ? -1 : 1;
+}
 
-        // compose full path
-        if (!str_dup(dir, &path) || !str_append("/", 1, &path) ||
-            !str_append(name, 0, &path)) {
-            continue;
+/**
+ * Create keys and sort chunks, handler for thread pool.
+ * @param data sort context
+ * @param low,high range of chunks to process
+ */
+static void sort_chunks(void* data, size_t low, size_t high)
+{
+    struct sort_ctx* sc = data;
+
+    for (size_t chunk = low; chunk < high; ++chunk) {
+        const size_t first = chunk * sc->chunk;
+        const size_t last = min(first + sc->chunk, sc->num);
+        struct sort_key* keys = sc->keys;
+
+        for (size_t i = first; i < last; ++i) {
+            keys[i].index = i;
+            keys[i].str = NULL;
+            keys[i].len = 0;
+            if (ctx.order == order_mtime) {
+                keys[i].num = sc->src[i].time;
+            } else {
+                keys[i].num = sc->src[i].size;
+            }
         }
 
-        if (stat(path, &st) == 0) {
-            if (S_ISDIR(st.st_mode)) {
-                if (ctx.recursive) {
-                    add_dir(path);
+        if (ctx.order == order_alpha || ctx.order == order_numeric) {
+            // all string keys of the chunk are stored in a single buffer
+            size_t total = 0;
+            uint8_t* buf;
+            for (size_t i = first; i < last; ++i) {
+                const char* src = sc->src[i].source;
+                keys[i].len = src ? string_key(src, NULL, 0) : 0;
+                total += keys[i].len + 1;
+            }
+            buf = malloc(total);
+            sc->buffers[chunk] = buf;
+            if (!buf) {
+                continue; // keys are left empty
+            }
+            for (size_t i = first; i < last; ++i) {
+                const char* src = sc->src[i].source;
+                if (src) {
+                    string_key(src, buf, keys[i].len + 1);
                 }
-            } else if (S_ISREG(st.st_mode)) {
-                add_file(path, &st);
+                keys[i].str = buf;
+                buf += keys[i].len + 1;
             }
         }
+
+        qsort(&keys[first], last - first, sizeof(*keys), compare_keys);
     }
+}
 
-    free(path);
-    closedir(dir_handle);
+/**
+ * Merge pairs of sorted runs, handler for thread pool.
+ * @param data sort context
+ * @param low,high range of pairs to merge
+ */
+static void sort_merge(void* data, size_t low, size_t high)
+{
+    struct sort_ctx* sc = data;
+
+    for (size_t pair = low; pair < high; ++pair) {
+        const size_t first = pair * sc->width * 2;
+        const size_t middle = min(first + sc->width, sc->num);
+        const size_t last = min(middle + sc->width, sc->num);
+        size_t left = first;
+        size_t right = middle;
+        size_t dst = first;
+
+        while (left < middle && right < last) {
+            if (compare_keys(&sc->keys[right], &sc->keys[left]) < 0) {
+                sc->tmp[dst++] = sc->keys[right++];
+            } else {
+                sc->tmp[dst++] = sc->keys[left++];
+            }
+        }
+        while (left < middle) {
+            sc->tmp[dst++] = sc->keys[left++];
+        }
+        while (right < last) {
+            sc->tmp[dst++] = sc->keys[right++];
+        }
+    }
 }
 
 /**
- * Get next directory entry index (works only for paths as source).
- * @param start index of the start position
- * @param forward step direction
- * @return index of the next entry or IMGLIST_INVALID if not found
+ * Sort range of the list: keys are created once for each entry, chunks of
+ * the range are sorted and then merged in parallel.
+ * @param first index of the first entry to sort
+ * @param num number of entries to sort
  */
-static size_t next_dir(size_t start, bool forward)
+static void sort_list(size_t first, size_t num)
 {
-    const char* cur_path = ctx.sources[start].source;
-    size_t cur_len;
-    size_t index = start;
+    struct sort_ctx sc = { .src = &ctx.sources[first], .num = num };
+    struct image_src* sorted;
+    size_t chunks;
 
-    if (start == IMGLIST_INVALID) {
-        return image_list_first();
+    if (num < 2) {
+        return;
     }
 
-    // directory part of the current file path
-    cur_len = strlen(cur_path) - 1;
-    while (cur_len && cur_path[cur_len] != '/') {
-        --cur_len;
+    chunks = min(tpool_threads(), sc.num);
+    sc.chunk = (sc.num + chunks - 1) / chunks;
+    chunks = (sc.num + sc.chunk - 1) / sc.chunk;
+
+    sc.keys = malloc(sc.num * sizeof(*sc.keys));
+    sc.tmp = malloc(sc.num * sizeof(*sc.tmp));
+    sc.buffers = calloc(chunks, sizeof(*sc.buffers));
+    sorted = malloc(sc.num * sizeof(*sorted));
+    if (!sc.keys || !sc.tmp || !sc.buffers || !sorted) {
+        goto done;
     }
 
-    // search for another directory in file list
-    while (true) {
-        const char* next_path;
-        size_t next_len;
+    tpool_run(sort_chunks, &sc, chunks, 1);
 
-        index = image_list_nearest(index, forward, ctx.loop);
-        if (index == IMGLIST_INVALID || index == start) {
-            break; // not found
-        }
+    for (sc.width = sc.chunk; sc.width < sc.num; sc.width *= 2) {
+        struct sort_key* swap;
+        const size_t pairs = (sc.num + sc.width * 2 - 1) / (sc.width * 2);
+        tpool_run(sort_merge, &sc, pairs, 1);
+        swap = sc.keys;
+        sc.keys = sc.tmp;
+        sc.tmp = swap;
+    }
 
-        next_path = ctx.sources[index].source;
-        next_len = strlen(next_path) - 1;
-        while (next_len && next_path[next_len] != '/') {
-            --next_len;
-        }
-        if (cur_len != next_len || strncmp(cur_path, next_path, next_len)) {
-            return index;
-        }
-    };
+    for (size_t i = 0; i < sc.num; ++i) {
+        sorted[i] = sc.src[sc.keys[i].index];
+    }
+    memcpy(sc.src, sorted, sc.num * sizeof(*sorted));
 
-    return IMGLIST_INVALID;
+done:
+    if (sc.buffers) {
+        for (size_t i = 0; i < chunks; ++i) {
+            free(sc.buffers[i]);
+        }
+    }
+    free(sc.buffers);
+    free(sc.keys);
+    free(sc.tmp);
+    free(sorted);
 }
 
 /**
- * Compare sources callback for `qsort`.
- * @return negative if a < b, positive if a > b, 0 otherwise
+ * Shuffle range of the list (Fisher-Yates).
+ * @param first index of the first entry to shuffle
+ * @param num number of entries to shuffle
  */
-static int compare_alpha(const void* a, const void* b)
+static void shuffle_list(size_t first, size_t num)
 {
-    int cmp =
-        strcoll(((struct image_src*)a)->source, ((struct image_src*)b)->source);
+    struct image_src* src = &ctx.sources[first];
+    struct timespec ts;
 
-    return ctx.reverse ? -cmp : cmp;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    srand(ts.tv_nsec);
+
+    for (size_t i = num; i-- > 1;) {
+        const size_t j = rand() % (i + 1);
+        const struct image_src swap = src[i];
+        src[i] = src[j];
+        src[j] = swap;
+    }
 }
 
 /**
- * Perform a "natural" numeric comparison of two null-terminated strings
+ * Compare sources by natural sort keys.
  * @return negative if a < b, positive if a > b, 0 otherwise
  */
-static int strnumcmp(char* a, char* b)
+static int compare_numeric(const char* a, const char* b)
 {
-    while (!(*a == '\0' && *b == '\0')) {
-        if (isdigit(*a) && isdigit(*b)) {
-            unsigned long a_num = strtoul(a, &a, 10);
-            unsigned long b_num = strtoul(b, &b, 10);
+    struct sort_key ka = { .len = numeric_key(a, NULL) };
+    struct sort_key kb = { .len = numeric_key(b, NULL) };
+    uint8_t* buf = malloc(ka.len + kb.len);
+    int cmp;
 
-            if (a_num < b_num) {
-                return -1;
-            }
-            if (a_num > b_num) {
-                return 1;
-            }
-        } else {
-            if (*a < *b) {
-                return -1;
-            }
-            if (*a > *b) {
-                return 1;
-            }
-            ++a;
-            ++b;
-        }
+    if (!buf) {
+        return strcmp(a, b);
     }
-
-    return 0;
+    numeric_key(a, buf);
+    numeric_key(b, buf + ka.len);
+    ka.str = buf;
+    kb.str = buf + ka.len;
+    cmp = compare_str(&ka, &kb);
+    free(buf);
+
+    return cmp;
 }
 
 /**
- * Compare sources callback for `qsort`.
+ * Compare entries in the list order, same as `compare_keys` does for the
+ * sort keys, but without the position of the entry.
  * @return negative if a < b, positive if a > b, 0 otherwise
  */
-static int compare_numeric(const void* a, const void* b)
+static int compare_entries(const struct image_src* a,
+                           const struct image_src* b)
 {
-    int cmp =
-        strnumcmp(((struct image_src*)a)->source, ((struct image_src*)b)->source);
+    int cmp = 0;
+
+    switch (ctx.order) {
+        case order_alpha:
+            cmp = strcoll(a->source, b->source);
+            break;
+        case order_numeric:
+            cmp = compare_numeric(a->source, b->source);
+            break;
+        case order_mtime:
+            cmp = (a->time > b->time) - (a->time < b->time);
+            break;
+        case order_size:
+            cmp = (a->size > b->size) - (a->size < b->size);
+            break;
+        case order_none:
+        case order_random:
+            break;
+    }
 
     return ctx.reverse ? -cmp : cmp;
 }
 
+/** Compare positions, see `qsort`. */
+static int compare_pos(const void* a, const void* b)
+{
+    const size_t pa = *(const size_t*)a;
+    const size_t pb = *(const size_t*)b;
+    return (pa > pb) - (pa < pb);
+}
+
 /**
- * Compare sources callback for `qsort`.
- * @return negative if a < b, positive if a > b, 0 otherwise
+ * Move new entries from the end of the list to their places, existing
+ * entries keep their order, so the whole list is not reordered on merge.
+ * @param first number of existing (already ordered) entries
  */
-static int compare_time(const void* a, const void* b)
+static void insert_entries(size_t first)
 {
-    time_t ta = ((struct image_src*)a)->time;
-    time_t tb = ((struct image_src*)b)->time;
+    const size_t num = ctx.size - first;
+    struct image_src* added;
+    size_t* pos;
 
-    if (ta < tb) {
-        return ctx.reverse ? 1 : -1;
+    if (num == 0 || ctx.order == order_none) {
+        return;
+    }
+
+    pos = malloc(num * sizeof(*pos));
+    added = malloc(num * sizeof(*added));
+    if (!pos || !added) {
+        free(pos);
+        free(added);
+        return; // left at the end of the list
+    }
+
+    // order the new entries and find their places among the existing ones
+    if (ctx.order == order_random) {
+        shuffle_list(first, num);
+        for (size_t i = 0; i < num; ++i) {
+            pos[i] = rand() % (first + 1);
+        }
+        qsort(pos, num, sizeof(*pos), compare_pos);
+    } else {
+        size_t low = 0;
+        sort_list(first, num);
+        for (size_t i = 0; i < num; ++i) {
+            // upper bound: the new entry follows the equal existing ones
+            const struct image_src* entry = &ctx.sources[first + i];
+            size_t high = first;
+            while (low < high) {
+                const size_t mid = low + (high - low) / 2;
+                if (compare_entries(entry, &ctx.sources[mid]) < 0) {
+                    high = mid;
+                } else {
+                    low = mid + 1;
+                }
+            }
+            pos[i] = low;
+        }
     }
-    if (ta > tb) {
-        return ctx.reverse ? -1 : 1;
+    memcpy(added, &ctx.sources[first], num * sizeof(*added));
+
+    // shift existing entries from the end to make room for the new ones
+    for (size_t dst = ctx.size, src = first, i = num; i-- > 0;) {
+        while (src > pos[i]) {
+            ctx.sources[--dst] = ctx.sources[--src];
+        }
+        ctx.sources[--dst] = added[i];
     }
-    return 0;
+
+    free(pos);
+    free(added);
 }
 
 /**
- * Compare sources callback for `qsort`.
- * @return negative if a < b, positive if a > b, 0 otherwise
+ * Update search structures after changing positions of the entries.
+ */
+static void reindex_list(void)
+{
+    set_rebuild(ctx.size);
+    ctx.live.valid = false;
+
+    if (ctx.index.enable && ctx.index.dirty && ctx.index.sources == 1) {
+        index_save();
+    }
+    ctx.index.dirty = false;
+}
+
+/**
+ * Add file to the list and scan the rest of its directory in background
+ * (`all` mode).
+ * @param source path to the file
+ * @param notify new files notification
+ * @return false if the source can't be added in this way
  */
-static int compare_size(const void* a, const void* b)
+static bool scan_start(const char* source, image_list_notify notify)
 {
-    size_t sa = ((struct image_src*)a)->size;
-    size_t sb = ((struct image_src*)b)->size;
+    struct stat st;
+    const char* delim;
+    char* dir;
+
+    if (!ctx.all_files || stat(source, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
 
-    if (sa < sb) {
-        return ctx.reverse ? 1 : -1;
+    // only one scanner at a time, the finished one is replaced
+    if (ctx.scan.active) {
+        if (!__atomic_load_n(&ctx.scan.done, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        image_list_scan_wait();
+        // files delivered after the last merge
+        for (size_t i = 0; i < ctx.scan.found_num; ++i) {
+            struct stat found;
+            memset(&found, 0, sizeof(found));
+            found.st_mtime = ctx.scan.found[i].time;
+            found.st_size = ctx.scan.found[i].size;
+            add_entry(ctx.scan.found[i].path, &found);
+            free(ctx.scan.found[i].path);
+        }
+        ctx.scan.found_num = 0;
+        scan_stop();
+    }
+
+    ++ctx.index.sources;
+    add_file(source, &st);
+
+    // scan the rest of the directory in background
+    delim = strrchr(source, '/');
+    if (!delim) {
+        dir = str_dup(".", NULL);
+    } else if (delim == source) {
+        dir = str_dup("/", NULL);
+    } else {
+        dir = str_append(source, delim - source, NULL);
     }
-    if (sa > sb) {
-        return ctx.reverse ? -1 : 1;
+    if (!dir) {
+        return true;
     }
-    return 0;
+    free(ctx.scan.path);
+    ctx.scan.path = dir;
+
+    ctx.scan.notify = notify;
+    pthread_mutex_init(&ctx.scan.lock, NULL);
+    ctx.scan.active =
+        (pthread_create(&ctx.scan.thread, NULL, scan_thread, NULL) == 0);
+    if (!ctx.scan.active) {
+        pthread_mutex_destroy(&ctx.scan.lock);
+        add_dir(ctx.scan.path);
+    }
+
+    return true;
 }
 
 void image_list_init(const struct config* cfg)
@@ -386,17 +1977,74 @@ void image_list_init(const struct config* cfg)
     ctx.loop = config_get_bool(cfg, CFG_LIST, CFG_LIST_LOOP);
     ctx.recursive = config_get_bool(cfg, CFG_LIST, CFG_LIST_RECURSIVE);
     ctx.all_files = config_get_bool(cfg, CFG_LIST, CFG_LIST_ALL);
+    ctx.index.enable = config_get_bool(cfg, CFG_LIST, CFG_LIST_INDEX);
+
+#ifdef HAVE_INOTIFY
+    if (config_get_bool(cfg, CFG_LIST, CFG_LIST_WATCH)) {
+        ctx.watch.fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+        ctx.watch.enable = (ctx.watch.fd != -1);
+        if (ctx.watch.enable) {
+            pthread_mutex_init(&ctx.watch.lock, NULL);
+        }
+    }
+#endif // HAVE_INOTIFY
 }
 
 void image_list_destroy(void)
 {
-    for (size_t i = 0; i < ctx.size; ++i) {
-        free(ctx.sources[i].source);
+    scan_stop();
+    if (ctx.watch.enable) {
+        worker_cancel(&ctx.watch);
+        while (ctx.watch.queue) {
+            struct scan_dir* next = ctx.watch.queue->next;
+            scan_free(ctx.watch.queue);
+            ctx.watch.queue = next;
+        }
+        while (ctx.watch.scanned) {
+            struct scan_dir* next = ctx.watch.scanned->next;
+            scan_free(ctx.watch.scanned);
+            ctx.watch.scanned = next;
+        }
+        close(ctx.watch.fd);
+        for (size_t i = 0; i < ctx.watch.dirs.capacity; ++i) {
+            free(ctx.watch.dirs.slots[i].value);
+        }
+        hashmap_free(&ctx.watch.dirs);
+        pthread_mutex_destroy(&ctx.watch.lock);
+    }
+    for (size_t i = 0; i < ctx.watch.changes_num; ++i) {
+        free(ctx.watch.changes[i].path);
+    }
+    free(ctx.watch.changes);
+    memset(&ctx.watch, 0, sizeof(ctx.watch));
+    free(ctx.remap);
+    ctx.remap = NULL;
+    ctx.remap_size = 0;
+    while (ctx.arena) {
+        struct arena_block* prev = ctx.arena->prev;
+        free(ctx.arena);
+        ctx.arena = prev;
     }
+    free(ctx.dirs.dirs);
+    free(ctx.dirs.slots);
+    memset(&ctx.dirs, 0, sizeof(ctx.dirs));
     free(ctx.sources);
     ctx.sources = NULL;
     ctx.capacity = 0;
     ctx.size = 0;
+    free(ctx.set.slots);
+    ctx.set.slots = NULL;
+    ctx.set.capacity = 0;
+    free(ctx.live.nodes);
+    memset(&ctx.live, 0, sizeof(ctx.live));
+    free(ctx.index.dirs);
+    memset(&ctx.index, 0, sizeof(ctx.index));
+    for (size_t i = 0; i < ctx.pending_num; ++i) {
+        free(ctx.pending[i].source);
+    }
+    free(ctx.pending);
+    ctx.pending = NULL;
+    ctx.pending_num = 0;
 }
 
 void image_list_add(const char* source)
@@ -404,6 +2052,7 @@ void image_list_add(const char* source)
     struct stat st;
 
     memset(&st, 0, sizeof(struct stat));
+    ++ctx.index.sources;
 
     // special url
     if (strncmp(source, LDRSRC_STDIN, LDRSRC_STDIN_LEN) == 0 ||
@@ -440,42 +2089,266 @@ void image_list_add(const char* source)
     }
 }
 
+void image_list_add_async(const char* source, image_list_notify notify)
+{
+    if (!scan_start(source, notify)) {
+        image_list_add(source);
+    }
+}
+
+bool image_list_scan_wait(void)
+{
+    if (ctx.scan.active && !ctx.scan.joined) {
+        pthread_join(ctx.scan.thread, NULL);
+        ctx.scan.joined = true;
+    }
+    return ctx.scan.active;
+}
+
+void image_list_enqueue(const char* source, image_list_notify notify)
+{
+    struct pending_src* pending;
+    char* dup;
+
+    pending = realloc(ctx.pending, (ctx.pending_num + 1) * sizeof(*pending));
+    if (!pending) {
+        return;
+    }
+    ctx.pending = pending;
+
+    dup = str_dup(source, NULL);
+    if (dup) {
+        ctx.pending[ctx.pending_num].source = dup;
+        ctx.pending[ctx.pending_num].notify = notify;
+        ++ctx.pending_num;
+    }
+}
+
+bool image_list_merge(void)
+{
+    struct watch_change* changes;
+    size_t changes_num;
+    struct pending_src* pending = ctx.pending;
+    const size_t pending_num = ctx.pending_num;
+    struct scan_item* found = NULL;
+    size_t found_num = 0;
+    size_t* remap;
+    size_t size = 0;
+    size_t first = 0;
+
+    // directories scanned in background
+    if (ctx.watch.enable) {
+        struct scan_dir* scanned;
+        pthread_mutex_lock(&ctx.watch.lock);
+        scanned = ctx.watch.scanned;
+        ctx.watch.scanned = NULL;
+        pthread_mutex_unlock(&ctx.watch.lock);
+        while (scanned) {
+            struct scan_dir* next = scanned->next;
+            watch_collect(scanned);
+            scanned = next;
+        }
+    }
+    changes = ctx.watch.changes;
+    changes_num = ctx.watch.changes_num;
+
+    if (ctx.scan.active) {
+        pthread_mutex_lock(&ctx.scan.lock);
+        found = ctx.scan.found;
+        found_num = ctx.scan.found_num;
+        ctx.scan.found = NULL;
+        ctx.scan.found_num = 0;
+        ctx.scan.found_cap = 0;
+        pthread_mutex_unlock(&ctx.scan.lock);
+    }
+    ctx.watch.changes = NULL;
+    ctx.watch.changes_num = 0;
+    ctx.watch.changes_cap = 0;
+    ctx.pending = NULL;
+    ctx.pending_num = 0;
+
+    if (found_num == 0 && changes_num == 0 && pending_num == 0) {
+        free(found);
+        free(changes);
+        free(pending);
+        return false;
+    }
+
+    remap = realloc(ctx.remap, ctx.size * sizeof(*remap));
+    if (!remap && ctx.size) {
+        for (size_t i = 0; i < found_num; ++i) {
+            free(found[i].path);
+        }
+        free(found);
+        for (size_t i = 0; i < changes_num; ++i) {
+            free(changes[i].path);
+        }
+        free(changes);
+        for (size_t i = 0; i < pending_num; ++i) {
+            free(pending[i].source);
+        }
+        free(pending);
+        return false;
+    }
+    ctx.remap = remap;
+    ctx.remap_size = ctx.size;
+
+    // remember original positions
+    for (size_t i = 0; i < ctx.size; ++i) {
+        ctx.remap[i] = IMGLIST_INVALID;
+        ctx.sources[i].index = i;
+    }
+
+    // files found by the background scanner
+    for (size_t i = 0; i < found_num; ++i) {
+        struct stat st;
+        memset(&st, 0, sizeof(st));
+        st.st_mtime = found[i].time;
+        st.st_size = found[i].size;
+        add_entry(found[i].path, &st);
+        free(found[i].path);
+    }
+    free(found);
+
+    // changes of the watched directories in the order of arrival
+    for (size_t i = 0; i < changes_num; ++i) {
+        const struct watch_change* change = &changes[i];
+        if (change->removed) {
+            watch_remove(change->path);
+        } else {
+            struct stat st;
+            memset(&st, 0, sizeof(st));
+            st.st_mtime = change->time;
+            st.st_size = change->size;
+            add_entry(change->path, &st);
+        }
+        free(change->path);
+    }
+    free(changes);
+
+    // sources added at runtime
+    for (size_t i = 0; i < pending_num; ++i) {
+        if (!pending[i].notify || !scan_start(pending[i].source,
+                                              pending[i].notify)) {
+            image_list_add(pending[i].source);
+        }
+        free(pending[i].source);
+    }
+    free(pending);
+
+    // remove skipped entries, existing ones are followed by the new
+    for (size_t i = 0; i < ctx.size; ++i) {
+        if (ctx.sources[i].source) {
+            if (ctx.sources[i].index != IMGLIST_INVALID) {
+                ++first;
+            }
+            ctx.sources[size++] = ctx.sources[i];
+        }
+    }
+    ctx.size = size;
+
+    // the list is already ordered, only the new entries need their places
+    insert_entries(first);
+    reindex_list();
+
+    for (size_t i = 0; i < ctx.size; ++i) {
+        const size_t prev = ctx.sources[i].index;
+        if (prev != IMGLIST_INVALID) {
+            ctx.remap[prev] = i;
+        }
+        ctx.sources[i].index = IMGLIST_INVALID;
+    }
+
+    return true;
+}
+
+size_t image_list_remap(size_t index)
+{
+    return index < ctx.remap_size ? ctx.remap[index] : IMGLIST_INVALID;
+}
+
+size_t image_list_remap_nearest(size_t index)
+{
+    if (index >= ctx.remap_size) {
+        return IMGLIST_INVALID;
+    }
+    for (size_t i = index; i < ctx.remap_size; ++i) {
+        if (ctx.remap[i] != IMGLIST_INVALID) {
+            return ctx.remap[i];
+        }
+    }
+    for (size_t i = index; i-- > 0;) {
+        if (ctx.remap[i] != IMGLIST_INVALID) {
+            return ctx.remap[i];
+        }
+    }
+    return IMGLIST_INVALID;
+}
+
+int image_list_watch_fd(void)
+{
+    return ctx.watch.enable ? ctx.watch.fd : -1;
+}
+
+bool image_list_watch_read(__attribute__((unused)) image_list_notify notify)
+{
+#ifdef HAVE_INOTIFY
+    const size_t prev = ctx.watch.changes_num;
+
+    if (!ctx.watch.enable) {
+        return false;
+    }
+    pthread_mutex_lock(&ctx.watch.lock);
+    ctx.watch.notify = notify;
+    pthread_mutex_unlock(&ctx.watch.lock);
+
+    while (ctx.watch.enable) {
+        uint8_t buffer[4096]
+            __attribute__((aligned(__alignof__(struct inotify_event))));
+        const ssize_t len = read(ctx.watch.fd, buffer, sizeof(buffer));
+        ssize_t pos = 0;
+
+        if (len <= 0) {
+            if (len < 0 && errno == EINTR) {
+                continue;
+            }
+            break; // no more events
+        }
+        while (pos + sizeof(struct inotify_event) <= (size_t)len) {
+            const struct inotify_event* event =
+                (struct inotify_event*)&buffer[pos];
+            watch_event(event);
+            pos += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    return ctx.watch.changes_num > prev;
+#else
+    return false;
+#endif // HAVE_INOTIFY
+}
+
 void image_list_reorder(void)
 {
     assert(ctx.size);
 
-    switch (ctx.order) {
+    // list loaded from the index is already sorted
+    switch (ctx.index.sorted ? order_none : ctx.order) {
         case order_none:
             break;
         case order_alpha:
-            qsort(ctx.sources, ctx.size, sizeof(*ctx.sources), compare_alpha);
-            break;
         case order_numeric:
-            qsort(ctx.sources, ctx.size, sizeof(*ctx.sources), compare_numeric);
-            break;
         case order_mtime:
-            qsort(ctx.sources, ctx.size, sizeof(*ctx.sources), compare_time);
-            break;
         case order_size:
-            qsort(ctx.sources, ctx.size, sizeof(*ctx.sources), compare_size);
+            sort_list(0, ctx.size);
             break;
         case order_random:
-            for (size_t i = 0; i < ctx.size; ++i) {
-                if (i == 0) {
-                    // init random sequence
-                    struct timespec ts;
-                    clock_gettime(CLOCK_MONOTONIC, &ts);
-                    srand(ts.tv_nsec);
-                }
-                const size_t j = rand() % ctx.size;
-                if (i != j) {
-                    struct image_src swap = ctx.sources[i];
-                    ctx.sources[i] = ctx.sources[j];
-                    ctx.sources[j] = swap;
-                }
-            }
+            shuffle_list(0, ctx.size);
             break;
     }
+
+    // entry indices have been changed
+    reindex_list();
 }
 
 size_t image_list_size(void)
@@ -491,12 +2364,11 @@ const char* image_list_get(size_t index)
 size_t image_list_find(const char* source)
 {
     char abspath[PATH_MAX];
-    if (absolute_path(source, abspath, sizeof(abspath))) {
-        for (size_t i = 0; i < ctx.size; ++i) {
-            if (ctx.sources[i].source &&
-                strcmp(ctx.sources[i].source, abspath) == 0) {
-                return i;
-            }
+    if (ctx.set.capacity &&
+        absolute_path(source, abspath, sizeof(abspath))) {
+        const size_t slot = *set_find(abspath);
+        if (slot) {
+            return slot - 1;
         }
     }
     return IMGLIST_INVALID;
@@ -505,6 +2377,7 @@ size_t image_list_find(const char* source)
 size_t image_list_nearest(size_t start, bool forward, bool loop)
 {
     size_t index = start;
+    size_t rank;
 
     if (index == IMGLIST_INVALID) {
         if (forward) {
@@ -525,35 +2398,27 @@ size_t image_list_nearest(size_t start, bool forward, bool loop)
         return IMGLIST_INVALID;
     }
 
-    while (true) {
-        if (forward) {
-            if (index + 1 < ctx.size) {
-                ++index;
-            } else if (!loop) {
-                index = IMGLIST_INVALID; // already at last entry
-                break;
-            } else {
-                index = 0;
-            }
+    live_update();
+
+    if (forward) {
+        rank = live_count(start + 1);
+        if (rank < ctx.live.total) {
+            index = live_find(rank);
         } else {
-            if (index > 0) {
-                --index;
-            } else if (!loop) {
-                index = IMGLIST_INVALID; // already at first entry
-                break;
-            } else {
-                index = ctx.size - 1;
-            }
+            index = loop ? live_find(0) : IMGLIST_INVALID;
         }
-
-        if (index == start) {
-            index = IMGLIST_INVALID; // only one valid entry in the list
-            break;
+    } else {
+        rank = live_count(start);
+        if (rank) {
+            index = live_find(rank - 1);
+        } else {
+            index = loop && ctx.live.total ? live_find(ctx.live.total - 1)
+                                           : IMGLIST_INVALID;
         }
+    }
 
-        if (ctx.sources[index].source) {
-            break;
-        }
+    if (index == start) {
+        index = IMGLIST_INVALID; // only one valid entry in the list
     }
 
     return index;
@@ -561,27 +2426,38 @@ size_t image_list_nearest(size_t start, bool forward, bool loop)
 
 size_t image_list_jump(size_t start, size_t distance, bool forward)
 {
-    size_t index = start;
-    if (index == IMGLIST_INVALID || index >= ctx.size) {
+    size_t rank;
+
+    if (start == IMGLIST_INVALID || start >= ctx.size) {
         return IMGLIST_INVALID;
     }
+    if (distance == 0) {
+        return start;
+    }
 
-    while (distance) {
-        const size_t next = image_list_nearest(index, forward, false);
-        if (next == IMGLIST_INVALID) {
-            break;
+    live_update();
+
+    if (forward) {
+        // rank of the first live entry after the start
+        rank = live_count(start + 1);
+        if (rank >= ctx.live.total) {
+            return start;
+        }
+        rank = min(rank + distance - 1, ctx.live.total - 1);
+    } else {
+        rank = live_count(start);
+        if (rank == 0) {
+            return start;
         }
-        index = next;
-        --distance;
+        rank = rank > distance ? rank - distance : 0;
     }
 
-    return index;
+    return live_find(rank);
 }
 
 size_t image_list_distance(size_t start, size_t end)
 {
-    size_t distance = 0;
-    size_t index;
+    size_t after;
 
     if (start == IMGLIST_INVALID) {
         start = image_list_first();
@@ -589,19 +2465,23 @@ size_t image_list_distance(size_t start, size_t end)
     if (end == IMGLIST_INVALID) {
         end = image_list_last();
     }
-    if (start <= end) {
-        index = start;
-    } else {
-        index = end;
-        end = start;
+    if (start == IMGLIST_INVALID || end == IMGLIST_INVALID) {
+        return 0;
     }
-
-    while (index != IMGLIST_INVALID && index != end) {
-        ++distance;
-        index = image_list_nearest(index, true, false);
+    if (start > end) {
+        const size_t swap = start;
+        start = end;
+        end = swap;
     }
 
-    return distance;
+    live_update();
+
+    // number of live entries after the start up to the end
+    after = live_count(start + 1);
+    if (end < ctx.size && ctx.sources[end].source) {
+        return live_count(end + 1) - after;
+    }
+    return ctx.live.total - after;
 }
 
 size_t image_list_next_file(size_t start)
@@ -657,8 +2537,14 @@ size_t image_list_skip(size_t index)
 
     // remove current entry from list
     if (index < ctx.size && ctx.sources[index].source) {
-        free(ctx.sources[index].source);
+        // the path stays in the arena until the list is destroyed
         ctx.sources[index].source = NULL;
+        if (ctx.live.valid) {
+            for (size_t i = index + 1; i <= ctx.live.size; i += i & -i) {
+                --ctx.live.nodes[i];
+            }
+            --ctx.live.total;
+        }
     }
 
     // get next entry
@@ -9,6 +9,9 @@
 // Invalid index of the entry
 #define IMGLIST_INVALID SIZE_MAX
 
+/** Notification about new files found by the background scanner. */
+typedef void (*image_list_notify)(void);
+
 /** Order of file list. */
 enum list_order {
     order_none,    ///< Unsorted (system depended)
@@ -36,6 +39,71 @@ void image_list_destroy(void);
  */
 void image_list_add(const char* source);
 
+/**
+ * Add image source to the list, other files from the same directory (`all`
+ * mode) are added in background: the scanner calls `notify` from its own
+ * thread when new files are found, they are added by `image_list_merge`.
+ * @param source image source to add (file path or special prefix)
+ * @param notify new files notification
+ */
+void image_list_add_async(const char* source, image_list_notify notify);
+
+/**
+ * Wait for the background scanner started by `image_list_add_async`, found
+ * files are added by `image_list_merge`.
+ * @return false if there is no background scanner
+ */
+bool image_list_scan_wait(void);
+
+/**
+ * Queue image source to be added to the list by the next `image_list_merge`,
+ * used to add sources after the list was composed.
+ * @param source image source to add (file path or special prefix)
+ * @param notify new files notification to scan the rest of the directory in
+ *               background as `image_list_add_async` does, NULL to scan it
+ *               on merge
+ */
+void image_list_enqueue(const char* source, image_list_notify notify);
+
+/**
+ * Add files found by the background scanner, sources from
+ * `image_list_enqueue` and apply changes of the watched directories to the
+ * list, then reorder it.
+ * Indices of the entries are changed, use `image_list_remap` to convert them.
+ * @return true if the list was changed
+ */
+bool image_list_merge(void);
+
+/**
+ * Get index of the entry after the last merge.
+ * @param index index of the entry before the merge
+ * @return new index of the entry or IMGLIST_INVALID if the entry was removed
+ */
+size_t image_list_remap(size_t index);
+
+/**
+ * Get index of the entry after the last merge, if the entry was removed from
+ * the list, index of the nearest remaining entry is returned.
+ * @param index index of the entry before the merge
+ * @return index of the entry or IMGLIST_INVALID if the list is empty
+ */
+size_t image_list_remap_nearest(size_t index);
+
+/**
+ * Get file descriptor of the directory watcher, it becomes readable when
+ * files are added to or removed from the scanned directories.
+ * @return file descriptor or -1 if watching is disabled
+ */
+int image_list_watch_fd(void);
+
+/**
+ * Read changes of the watched directories, they are applied to the list by
+ * `image_list_merge`. New sub directories are scanned in background.
+ * @param notify scanned sub directories callback (from worker), can be NULL
+ * @return true if new changes were read
+ */
+bool image_list_watch_read(image_list_notify notify);
+
 /**
  * Reorder image list (sort/random/...).
  */
@@ -9,6 +9,8 @@
 #include "font.h"
 #include "keybind.h"
 #include "loader.h"
+#include "memcache.h"
+#include "perf.h"
 #include "ui.h"
 
 #include <stdarg.h>
@@ -77,6 +79,12 @@ static const char* position_names[] = {
 // Space between text layout and window edge
 #define TEXT_PADDING 10
 
+// Max number of lines in performance HUD
+#define PERF_LINES (PERF_FORMATS + 7)
+
+// Refresh period of performance HUD (seconds)
+#define PERF_PERIOD 1
+
 /** Scheme of displayed field (line(s) of text). */
 struct field_scheme {
     enum info_field type; ///< Field type
@@ -87,6 +95,8 @@ struct field_scheme {
 struct keyval {
     struct text_surface key;
     struct text_surface value;
+    char* key_text;   ///< Source text of the key
+    char* value_text; ///< Source text of the value
 };
 
 /** Info scheme: set of fields in one of screen positions. */
@@ -95,6 +105,14 @@ struct block_scheme {
     size_t fields_num;           ///< Size of array
 };
 
+/** Window area occupied by text block. */
+struct block_area {
+    ssize_t x;     ///< Left position
+    ssize_t y;     ///< Top position
+    size_t width;  ///< Width, 0 if block is empty
+    size_t height; ///< Height
+};
+
 /** Info timeout description. */
 struct info_timeout {
     int fd;         ///< Timer FD
@@ -102,6 +120,15 @@ struct info_timeout {
     bool active;    ///< Current state
 };
 
+/** Performance HUD. */
+struct info_perf {
+    int fd;                          ///< Refresh timer FD
+    bool active;                     ///< HUD is visible
+    struct keyval lines[PERF_LINES]; ///< HUD lines
+    size_t lines_num;                ///< Number of lines
+    struct block_area area;          ///< Last printed area
+};
+
 /** Info data context. */
 struct info_context {
     enum info_mode mode; ///< Currently active mode
@@ -115,73 +142,32 @@ struct info_context {
     struct keyval* exif_lines; ///< EXIF data lines
     size_t exif_num;           ///< Number of lines in EXIF data
 
+    struct info_perf perf; ///< Performance HUD
+
     struct keyval fields[FIELDS_NUM];                    ///< Info data
     struct block_scheme scheme[MODES_NUM][POSITION_NUM]; ///< Info scheme
+
+    // last printed blocks, used to repaint the changed lines only
+    struct block_area area[POSITION_NUM];                ///< Blocks
+    struct block_area line_area[POSITION_NUM][MAX_LINES]; ///< Lines
+    enum info_field line_field[POSITION_NUM][MAX_LINES];  ///< Line fields
+    size_t lines_num[POSITION_NUM];                       ///< Lines number
 };
 
 /** Global info context. */
 static struct info_context ctx;
 
-/** Notification callback: handle timer event. */
-static void on_timeout(void* data)
-{
-    struct info_timeout* timeout = data;
-    struct itimerspec ts = { 0 };
-
-    timeout->active = false;
-    timerfd_settime(timeout->fd, 0, &ts, NULL);
-    app_redraw();
-}
-
-/**
- * Initialize timer.
- * @param timeout timer instance
- */
-static void timeout_init(struct info_timeout* timeout)
-{
-    timeout->fd = -1;
-    timeout->active = true;
-    if (timeout->timeout != 0) {
-        timeout->fd =
-            timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-        if (timeout->fd != -1) {
-            app_watch(timeout->fd, on_timeout, timeout);
-        }
-    }
-}
-
-/**
- * Reset/restart timer.
- * @param timeout timer instance
- */
-static void timeout_reset(struct info_timeout* timeout)
-{
-    timeout->active = true;
-    if (timeout->fd != -1) {
-        struct itimerspec ts = { .it_value.tv_sec = timeout->timeout };
-        timerfd_settime(timeout->fd, 0, &ts, NULL);
-    }
-}
-
-/**
- * Close timer FD.
- * @param timeout timer instance
- */
-static void timeout_close(struct info_timeout* timeout)
-{
-    if (timeout->fd != -1) {
-        close(timeout->fd);
-    }
-}
-
 /**
  * Print centered text block.
- * @param wnd destination window
+ * @param wnd destination canvas
+ * @param x,y position of the canvas on the window
  */
-static void print_help(struct pixmap* window)
+static void print_help(struct pixmap* wnd, ssize_t x, ssize_t y)
 {
+    const size_t wnd_width = ui_get_width();
+    const size_t wnd_height = ui_get_height();
     const size_t line_height = ctx.help[0].height;
-    const size_t row_max = (window->height - TEXT_PADDING * 2) / line_height;
+    const size_t row_max = (wnd_height - TEXT_PADDING * 2) / line_height;
     const size_t columns =
         (ctx.help_num / row_max) + (ctx.help_num % row_max ? 1 : 0);
     const size_t rows =
@@ -208,27 +194,28 @@ static void print_help(struct pixmap* window)
     total_width += col_space * (columns - 1);
 
     // top left corner of the centered text block
-    if (total_width < ui_get_width()) {
-        left = window->width / 2 - total_width / 2;
+    if (total_width < wnd_width) {
+        left = wnd_width / 2 - total_width / 2;
     }
-    if (rows * line_height < ui_get_height()) {
-        top = window->height / 2 - (rows * line_height) / 2;
+    if (rows * line_height < wnd_height) {
+        top = wnd_height / 2 - (rows * line_height) / 2;
     }
 
     // put text on window
     for (size_t col = 0; col < columns; ++col) {
-        size_t y = top;
+        size_t line_y = top;
         size_t col_width = 0;
         for (size_t row = 0; row < rows; ++row) {
             const size_t index = row + col * rows;
             if (index >= ctx.help_num) {
                 break;
             }
-            font_print(window, left, y, &ctx.help[index]);
+            font_print(wnd, (ssize_t)left - x, (ssize_t)line_y - y,
+                       &ctx.help[index]);
             if (col_width < ctx.help[index].width) {
                 col_width = ctx.help[index].width;
             }
-            y += line_height;
+            line_y += line_height;
         }
         left += col_width + col_space;
     }
@@ -236,39 +223,65 @@ static void print_help(struct pixmap* window)
 
 /**
  * Print info block with key/value text.
- * @param wnd destination window
+ * @param wnd destination canvas, NULL to calculate the block area only
+ * @param x,y position of the canvas on the window
  * @param pos block position
  * @param lines array of key/value lines to print
  * @param lines_num total number of lines
+ * @param area pointer to get window area occupied by the block
+ * @param line_area array to get areas occupied by each line, can be NULL
  */
-static void print_keyval(struct pixmap* wnd, enum block_position pos,
-                         const struct keyval* lines, size_t lines_num)
+static void print_keyval(struct pixmap* wnd, ssize_t x, ssize_t y,
+                         enum block_position pos, const struct keyval* lines,
+                         size_t lines_num, struct block_area* area,
+                         struct block_area* line_area)
 {
-    size_t max_key_width = 0;
+    const ssize_t wnd_width = ui_get_width();
+    const ssize_t wnd_height = ui_get_height();
     const size_t height = lines[0].value.height;
-
-    // calc max width of keys, used if block on the left side
+    size_t max_key_width = 0;
+    size_t max_val_width = 0;
+    ssize_t center_x;
+    ssize_t left = wnd_width;
+    ssize_t right = 0;
+    ssize_t top = wnd_height;
+    ssize_t bottom = 0;
+
+    // calc max width of keys, used if block on the left side or centered
     for (size_t i = 0; i < lines_num; ++i) {
         if (lines[i].key.width > max_key_width) {
             max_key_width = lines[i].key.width;
         }
+        if (lines[i].value.width > max_val_width) {
+            max_val_width = lines[i].value.width;
+        }
     }
     max_key_width += height / 2;
+    center_x = (wnd_width - (ssize_t)(max_key_width + max_val_width)) / 2;
 
     // draw info block
     for (size_t i = 0; i < lines_num; ++i) {
         const struct text_surface* key = &lines[i].key;
         const struct text_surface* value = &lines[i].value;
-        size_t y = 0;
-        size_t x_key = 0;
-        size_t x_val = 0;
+        const ssize_t margin = font_margin(value);
+        ssize_t line_y = 0;
+        ssize_t x_key = 0;
+        ssize_t x_val = 0;
 
         // calculate line position
         switch (pos) {
             case pos_center:
-                return; // not supported (not used anywhere)
+                line_y = (wnd_height - (ssize_t)(height * lines_num)) / 2 +
+                    i * height;
+                if (key->data) {
+                    x_key = center_x;
+                    x_val = center_x + max_key_width;
+                } else {
+                    x_val = center_x;
+                }
+                break;
             case pos_top_left:
-                y = TEXT_PADDING + i * height;
+                line_y = TEXT_PADDING + i * height;
                 if (key->data) {
                     x_key = TEXT_PADDING;
                     x_val = TEXT_PADDING + max_key_width;
@@ -277,14 +290,14 @@ static void print_keyval(struct pixmap* wnd, enum block_position pos,
                 }
                 break;
             case pos_top_right:
-                y = TEXT_PADDING + i * height;
-                x_val = wnd->width - TEXT_PADDING - value->width;
+                line_y = TEXT_PADDING + i * height;
+                x_val = wnd_width - TEXT_PADDING - value->width;
                 if (key->data) {
                     x_key = x_val - key->width - TEXT_PADDING;
                 }
                 break;
             case pos_bottom_left:
-                y = wnd->height - TEXT_PADDING - height * lines_num +
+                line_y = wnd_height - TEXT_PADDING - height * lines_num +
                     i * height;
                 if (key->data) {
                     x_key = TEXT_PADDING;
@@ -294,52 +307,328 @@ static void print_keyval(struct pixmap* wnd, enum block_position pos,
                 }
                 break;
             case pos_bottom_right:
-                y = wnd->height - TEXT_PADDING - height * lines_num +
+                line_y = wnd_height - TEXT_PADDING - height * lines_num +
                     i * height;
-                x_val = wnd->width - TEXT_PADDING - value->width;
+                x_val = wnd_width - TEXT_PADDING - value->width;
                 if (key->data) {
                     x_key = x_val - key->width - TEXT_PADDING;
                 }
                 break;
         }
 
-        if (key->data) {
-            font_print(wnd, x_key, y, key);
+        // update occupied area
+        if (line_area) {
+            struct block_area* la = &line_area[i];
+            la->x = (key->data ? x_key : x_val) - margin;
+            la->y = line_y - margin;
+            la->width = x_val + value->width + margin - la->x;
+            la->height = value->height + margin * 2;
+        }
+        left = min(left, (key->data ? x_key : x_val) - margin);
+        right = max(right, x_val + (ssize_t)value->width + margin);
+        top = min(top, line_y - margin);
+        bottom = max(bottom, line_y + (ssize_t)value->height + margin);
+
+        if (wnd) {
+            if (key->data) {
+                font_print(wnd, x_key - x, line_y - y, key);
+            }
+            font_print(wnd, x_val - x, line_y - y, value);
         }
-        font_print(wnd, x_val, y, value);
     }
+
+    area->x = left;
+    area->y = top;
+    area->width = right > left ? right - left : 0;
+    area->height = bottom > top ? bottom - top : 0;
 }
 
 /**
- * Import meta data from image.
- * @param image source image
+ * Get lines of the text block to display.
+ * @param pos block position
+ * @param lines array to fill, must have at least MAX_LINES elements
+ * @param fields array to get field types of the lines, same size as lines
+ * @return number of lines in block
  */
-static void import_meta(const struct image* image)
+static size_t get_lines(enum block_position pos, struct keyval* lines,
+                        enum info_field* fields)
 {
-    struct keyval* lines;
-    const size_t num_entries = list_size(&image->info->list);
-    const size_t buf_size = num_entries * sizeof(*lines);
+    size_t lnum = 0;
 
-    // free previous lines
-    for (size_t i = 0; i < ctx.exif_num; ++i) {
-        free(ctx.exif_lines[i].key.data);
-        free(ctx.exif_lines[i].value.data);
+    if (ctx.mode == mode_off || !ctx.info.active) {
+        // print only status
+        if (ctx.fields[info_status].value.width && ctx.status.active) {
+            const size_t btype = app_is_viewer() ? mode_viewer : mode_gallery;
+            const struct block_scheme* block = &ctx.scheme[btype][pos];
+            for (size_t i = 0; i < block->fields_num; ++i) {
+                const struct field_scheme* field = &block->fields[i];
+                if (field->type == info_status) {
+                    lines[0] = ctx.fields[info_status];
+                    if (!field->title) {
+                        memset(&lines[0].key, 0, sizeof(lines[0].key));
+                    }
+                    fields[0] = info_status;
+                    lnum = 1;
+                    break;
+                }
+            }
+        }
+        return lnum;
     }
-    ctx.exif_num = 0;
 
-    if (num_entries == 0) {
-        return;
+    const struct block_scheme* block = &ctx.scheme[ctx.mode][pos];
+    for (size_t i = 0; i < block->fields_num; ++i) {
+        const struct field_scheme* field = &block->fields[i];
+        const struct keyval* origin = &ctx.fields[field->type];
+
+        switch (field->type) {
+            case info_exif:
+                for (size_t n = 0; n < ctx.exif_num; ++n) {
+                    if (lnum < MAX_LINES) {
+                        memset(&lines[lnum], 0, sizeof(lines[lnum]));
+                        if (field->title) {
+                            lines[lnum].key = ctx.exif_lines[n].key;
+                        }
+                        fields[lnum] = info_exif;
+                        lines[lnum++].value = ctx.exif_lines[n].value;
+                    }
+                }
+                break;
+            case info_status:
+                if (origin->value.width && ctx.status.active) {
+                    memset(&lines[lnum], 0, sizeof(lines[lnum]));
+                    if (field->title) {
+                        lines[lnum].key = origin->key;
+                    }
+                    fields[lnum] = field->type;
+                    lines[lnum++].value = origin->value;
+                }
+                break;
+            default:
+                if (origin->value.width) {
+                    memset(&lines[lnum], 0, sizeof(lines[lnum]));
+                    if (field->title) {
+                        lines[lnum].key = origin->key;
+                    }
+                    fields[lnum] = field->type;
+                    lines[lnum++].value = origin->value;
+                }
+                break;
+        }
+        if (lnum >= MAX_LINES) {
+            break;
+        }
     }
 
-    lines = realloc(ctx.exif_lines, buf_size);
-    if (!lines) {
-        return;
+    return lnum;
+}
+
+/**
+ * Request redraw of text blocks that can contain the specified field.
+ * @param field changed field, FIELDS_NUM to redraw all blocks
+ */
+static void redraw_blocks(enum info_field field)
+{
+    for (size_t i = 0; i < POSITION_NUM; ++i) {
+        struct block_area* prev = &ctx.area[i];
+        struct block_area next = { 0 };
+        struct block_area next_lines[MAX_LINES];
+        enum info_field fields[MAX_LINES];
+        struct keyval lines[MAX_LINES];
+        size_t lnum;
+
+        if (field != FIELDS_NUM && field != info_status &&
+            ctx.mode != mode_off) {
+            // check if the field is displayed in this block
+            const struct block_scheme* block = &ctx.scheme[ctx.mode][i];
+            bool found = false;
+            for (size_t j = 0; !found && j < block->fields_num; ++j) {
+                found = (block->fields[j].type == field);
+            }
+            if (!found) {
+                continue;
+            }
+        }
+
+        lnum = get_lines(i, lines, fields);
+        if (lnum) {
+            print_keyval(NULL, 0, 0, i, lines, lnum, &next, next_lines);
+        }
+
+        if (field != FIELDS_NUM && lnum == ctx.lines_num[i] &&
+            memcmp(fields, ctx.line_field[i], lnum * sizeof(*fields)) == 0) {
+            // the same set of lines, repaint the changed and moved ones
+            for (size_t j = 0; j < lnum; ++j) {
+                const struct block_area* pl = &ctx.line_area[i][j];
+                const struct block_area* nl = &next_lines[j];
+                if (fields[j] == field || pl->x != nl->x || pl->y != nl->y ||
+                    pl->width != nl->width) {
+                    app_redraw_overlay(pl->x, pl->y, pl->width, pl->height);
+                    app_redraw_overlay(nl->x, nl->y, nl->width, nl->height);
+                }
+            }
+            continue;
+        }
+
+        if (prev->width) {
+            app_redraw_overlay(prev->x, prev->y, prev->width, prev->height);
+        }
+        if (next.width) {
+            app_redraw_overlay(next.x, next.y, next.width, next.height);
+        }
+    }
+}
+
+/** Notification callback: handle timer event. */
+static void on_timeout(void* data)
+{
+    struct info_timeout* timeout = data;
+    struct itimerspec ts = { 0 };
+
+    timeout->active = false;
+    timerfd_settime(timeout->fd, 0, &ts, NULL);
+
+    if (timeout == &ctx.status) {
+        redraw_blocks(info_status);
+    } else {
+        redraw_blocks(FIELDS_NUM);
+    }
+}
+
+/**
+ * Initialize timer.
+ * @param timeout timer instance
+ */
+static void timeout_init(struct info_timeout* timeout)
+{
+    timeout->fd = -1;
+    timeout->active = true;
+    if (timeout->timeout != 0) {
+        timeout->fd =
+            timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        if (timeout->fd != -1) {
+            app_watch(timeout->fd, POLLIN, on_timeout, timeout);
+        }
+    }
+}
+
+/**
+ * Reset/restart timer.
+ * @param timeout timer instance
+ */
+static void timeout_reset(struct info_timeout* timeout)
+{
+    timeout->active = true;
+    if (timeout->fd != -1) {
+        struct itimerspec ts = { .it_value.tv_sec = timeout->timeout };
+        timerfd_settime(timeout->fd, 0, &ts, NULL);
+    }
+}
+
+/**
+ * Close timer FD.
+ * @param timeout timer instance
+ */
+static void timeout_close(struct info_timeout* timeout)
+{
+    if (timeout->fd != -1) {
+        close(timeout->fd);
+    }
+}
+
+/**
+ * Render text if it differs from the text already rendered on the surface.
+ * @param text text to render, NULL to clear the surface
+ * @param cache pointer to the source text of the surface
+ * @param surface text surface to update
+ * @return true if surface was changed
+ */
+static bool render_text(const char* text, char** cache,
+                        struct text_surface* surface)
+{
+    if (!text || !*text) {
+        if (!*cache && !surface->data) {
+            return false;
+        }
+        free(*cache);
+        *cache = NULL;
+        free(surface->data);
+        memset(surface, 0, sizeof(*surface));
+        return true;
+    }
+
+    if (*cache && strcmp(*cache, text) == 0) {
+        return false;
     }
-    memset(lines, 0, buf_size);
 
-    ctx.exif_num = num_entries;
-    ctx.exif_lines = lines;
+    str_dup(text, cache);
+    font_render(text, surface);
+
+    return true;
+}
 
+/**
+ * Free key/value text surfaces.
+ * @param kv key/value to free
+ */
+static void free_keyval(struct keyval* kv)
+{
+    free(kv->key.data);
+    free(kv->value.data);
+    free(kv->key_text);
+    free(kv->value_text);
+}
+
+/**
+ * Set text of the field value and request redraw if it was changed.
+ * @param field field to update
+ * @param text value text, NULL to clear the field
+ * @return true if value was changed
+ */
+static bool set_field(enum info_field field, const char* text)
+{
+    struct keyval* kv = &ctx.fields[field];
+    const bool changed = render_text(text, &kv->value_text, &kv->value);
+
+    if (changed) {
+        redraw_blocks(field);
+    }
+
+    return changed;
+}
+
+/**
+ * Import meta data from image, only changed lines are rendered.
+ * @param image source image
+ * @return true if meta data was changed
+ */
+static bool import_meta(const struct image* image)
+{
+    const size_t num_entries = list_size(&image->info->list);
+    bool changed = (num_entries != ctx.exif_num);
+    struct keyval* line;
+
+    // free lines that are not used anymore
+    for (size_t i = num_entries; i < ctx.exif_num; ++i) {
+        free_keyval(&ctx.exif_lines[i]);
+    }
+    if (num_entries < ctx.exif_num) {
+        ctx.exif_num = num_entries;
+    }
+
+    if (num_entries > ctx.exif_num) {
+        struct keyval* lines =
+            realloc(ctx.exif_lines, num_entries * sizeof(*lines));
+        if (!lines) {
+            return changed;
+        }
+        memset(lines + ctx.exif_num, 0,
+               (num_entries - ctx.exif_num) * sizeof(*lines));
+        ctx.exif_num = num_entries;
+        ctx.exif_lines = lines;
+    }
+
+    line = ctx.exif_lines;
     list_for_each(image->info, const struct image_info, it) {
         char key[MAX_META_KEY_LEN];
         char value[MAX_META_VALUE_LEN];
@@ -365,9 +654,127 @@ static void import_meta(const struct image* image)
             memcpy(value + len, elipsis, sizeof(elipsis));
         }
 
-        font_render(key, &lines->key);
-        font_render(value, &lines->value);
-        ++lines;
+        changed |= render_text(key, &line->key_text, &line->key);
+        changed |= render_text(value, &line->value_text, &line->value);
+        ++line;
+    }
+
+    return changed;
+}
+
+/**
+ * Set text of the performance HUD line.
+ * @param line index of the line
+ * @param key,value text of the line
+ */
+static void set_perf_line(size_t line, const char* key, const char* value)
+{
+    struct keyval* kv = &ctx.perf.lines[line];
+    render_text(key, &kv->key_text, &kv->key);
+    render_text(value, &kv->value_text, &kv->value);
+}
+
+/**
+ * Get hit rate description.
+ * @param text output buffer
+ * @param size size of the buffer
+ * @param hits,misses number of hits and misses
+ */
+static void hit_rate(char* text, size_t size, size_t hits, size_t misses)
+{
+    const size_t total = hits + misses;
+    snprintf(text, size, "%.0f%% (%zu of %zu)",
+             total ? 100.0 * hits / total : 0.0, hits, total);
+}
+
+/**
+ * Fill performance HUD with the current counters.
+ */
+static void update_perf(void)
+{
+    const double mib = 1024 * 1024;
+    struct perf_stats ps;
+    struct memcache_stats ms;
+    char key[32], text[64];
+    size_t num = 0;
+
+    perf_collect(&ps);
+    memcache_stats(&ms);
+
+    snprintf(text, sizeof(text), "%.1f ms (max %.1f ms), %.0f fps",
+             ps.frame_avg / 1000.0, ps.frame_max / 1000.0,
+             ps.period ? ps.frames * 1000000.0 / ps.period : 0.0);
+    set_perf_line(num++, "Frame time:", text);
+
+    snprintf(text, sizeof(text), "%.1f ms (%s)", ps.scale_time / 1000.0,
+             aa_name(ps.scale_aa));
+    set_perf_line(num++, "Scale time:", text);
+
+    for (size_t i = 0; i < ps.decode_num; ++i) {
+        snprintf(key, sizeof(key), "Decode %s:", ps.decode[i].format);
+        snprintf(text, sizeof(text), "%zu ms", ps.decode[i].time);
+        set_perf_line(num++, key, text);
+    }
+
+    hit_rate(text, sizeof(text), ps.preload_hits, ps.preload_misses);
+    set_perf_line(num++, "Preload hits:", text);
+
+    hit_rate(text, sizeof(text), ms.hits, ms.misses);
+    set_perf_line(num++, "Cache hits:", text);
+
+    snprintf(text, sizeof(text), "%zu", loader_queue_size());
+    set_perf_line(num++, "Loader queue:", text);
+
+    if (ms.limit) {
+        snprintf(text, sizeof(text), "%.1f of %.0f MiB", ms.used / mib,
+                 ms.limit / mib);
+    } else {
+        snprintf(text, sizeof(text), "%.1f MiB", ms.used / mib);
+    }
+    set_perf_line(num++, "Image memory:", text);
+
+    if (ms.shrinks) {
+        snprintf(text, sizeof(text), "%zu", ms.shrinks);
+        set_perf_line(num++, "Memory shrinks:", text);
+    }
+
+    for (size_t i = num; i < ctx.perf.lines_num; ++i) {
+        free_keyval(&ctx.perf.lines[i]);
+        memset(&ctx.perf.lines[i], 0, sizeof(ctx.perf.lines[i]));
+    }
+    ctx.perf.lines_num = num;
+}
+
+/**
+ * Request redraw of the performance HUD.
+ */
+static void redraw_perf(void)
+{
+    const struct block_area* prev = &ctx.perf.area;
+    struct block_area next = { 0 };
+
+    if (ctx.perf.active) {
+        print_keyval(NULL, 0, 0, pos_center, ctx.perf.lines,
+                     ctx.perf.lines_num, &next, NULL);
+    }
+
+    if (prev->width) {
+        app_redraw_overlay(prev->x, prev->y, prev->width, prev->height);
+    }
+    if (next.width) {
+        app_redraw_overlay(next.x, next.y, next.width, next.height);
+    }
+}
+
+/** Notification callback: refresh performance HUD. */
+static void on_perf_timer(__attribute__((unused)) void* data)
+{
+    uint64_t expirations;
+
+    if (read(ctx.perf.fd, &expirations, sizeof(expirations)) > 0 &&
+        ctx.perf.active) {
+        update_perf();
+        redraw_perf();
     }
 }
 
@@ -428,19 +835,38 @@ static bool parse_scheme(const char* config, struct block_scheme* scheme)
     return true;
 }
 
+/**
+ * Load scheme of the block from config, the default scheme is used if the
+ * config value is invalid.
+ * @param cfg config instance
+ * @param mode display mode
+ * @param position block position
+ * @param report flag to report invalid config value
+ * @param scheme destination scheme description
+ */
+static void load_scheme(const struct config* cfg, enum info_mode mode,
+                        size_t position, bool report,
+                        struct block_scheme* scheme)
+{
+    const char* section =
+        (mode == mode_viewer ? CFG_INFO_VIEWER : CFG_INFO_GALLERY);
+    const char* key = position_names[position];
+    const char* format = config_get(cfg, section, key);
+
+    if (!parse_scheme(format, scheme)) {
+        if (report) {
+            config_error_val(section, format);
+        }
+        format = config_get_default(section, key);
+        parse_scheme(format, scheme);
+    }
+}
+
 void info_init(const struct config* cfg)
 {
     for (size_t i = 0; i < MODES_NUM; ++i) {
-        const char* section;
-        section = (i == mode_viewer ? CFG_INFO_VIEWER : CFG_INFO_GALLERY);
         for (size_t j = 0; j < POSITION_NUM; ++j) {
-            const char* position = position_names[j];
-            const char* format = config_get(cfg, section, position);
-            if (!parse_scheme(format, &ctx.scheme[i][j])) {
-                config_error_val(section, format);
-                format = config_get_default(section, position);
-                parse_scheme(format, &ctx.scheme[i][j]);
-            }
+            load_scheme(cfg, i, j, true, &ctx.scheme[i][j]);
         }
     }
 
@@ -454,11 +880,38 @@ void info_init(const struct config* cfg)
         config_get_num(cfg, CFG_INFO, CFG_INFO_STIMEOUT, 0, 1024);
     timeout_init(&ctx.status);
 
+    ctx.perf.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (ctx.perf.fd != -1) {
+        app_watch(ctx.perf.fd, POLLIN, on_perf_timer, NULL);
+    }
+
     info_on_scale();
 }
 
 void info_on_scale(void)
 {
+    // glyphs have another size now
+    for (size_t i = 0; i < FIELDS_NUM; ++i) {
+        const struct keyval* kv = &ctx.fields[i];
+        if (kv->value_text) {
+            font_render(kv->value_text, &ctx.fields[i].value);
+        }
+    }
+    for (size_t i = 0; i < ctx.exif_num; ++i) {
+        struct keyval* kv = &ctx.exif_lines[i];
+        if (kv->key_text) {
+            font_render(kv->key_text, &kv->key);
+        }
+        if (kv->value_text) {
+            font_render(kv->value_text, &kv->value);
+        }
+    }
+    for (size_t i = 0; i < ctx.perf.lines_num; ++i) {
+        struct keyval* kv = &ctx.perf.lines[i];
+        font_render(kv->key_text, &kv->key);
+        font_render(kv->value_text, &kv->value);
+    }
+
     font_render("File name:", &ctx.fields[info_file_name].key);
     font_render("Directory:", &ctx.fields[info_file_dir].key);
     font_render("File path:", &ctx.fields[info_file_path].key);
@@ -475,11 +928,17 @@ void info_destroy(void)
 {
     timeout_close(&ctx.info);
     timeout_close(&ctx.status);
+    if (ctx.perf.fd != -1) {
+        close(ctx.perf.fd);
+    }
+    for (size_t i = 0; i < ctx.perf.lines_num; ++i) {
+        free_keyval(&ctx.perf.lines[i]);
+    }
 
     for (size_t i = 0; i < ctx.exif_num; ++i) {
-        free(ctx.exif_lines[i].key.data);
-        free(ctx.exif_lines[i].value.data);
+        free_keyval(&ctx.exif_lines[i]);
     }
+    free(ctx.exif_lines);
 
     for (size_t i = 0; i < MODES_NUM; ++i) {
         for (size_t j = 0; j < POSITION_NUM; ++j) {
@@ -488,8 +947,7 @@ void info_destroy(void)
     }
 
     for (size_t i = 0; i < FIELDS_NUM; ++i) {
-        free(ctx.fields[i].key.data);
-        free(ctx.fields[i].value.data);
+        free_keyval(&ctx.fields[i]);
     }
 
     for (size_t i = 0; i < ctx.help_num; i++) {
@@ -558,45 +1016,95 @@ bool info_help_active(void)
     return !!ctx.help_num;
 }
 
+void info_switch_perf(void)
+{
+    struct itimerspec ts = { 0 };
+
+    ctx.perf.active = !ctx.perf.active;
+    if (ctx.perf.active) {
+        update_perf();
+        ts.it_value.tv_sec = PERF_PERIOD;
+        ts.it_interval.tv_sec = PERF_PERIOD;
+    }
+    if (ctx.perf.fd != -1) {
+        timerfd_settime(ctx.perf.fd, 0, &ts, NULL);
+    }
+
+    redraw_perf();
+}
+
 bool info_enabled(void)
 {
     return (ctx.mode != mode_off);
 }
 
+bool info_has_field(const struct config* cfg, const char* mode,
+                    enum info_field field)
+{
+    const ssize_t mode_num = str_index(mode_names, mode, 0);
+    struct block_scheme block = { 0 };
+    bool found = false;
+
+    if (mode_num < 0 || mode_num >= MODES_NUM) {
+        return false;
+    }
+
+    for (size_t i = 0; i < POSITION_NUM && !found; ++i) {
+        load_scheme(cfg, mode_num, i, false, &block);
+        for (size_t j = 0; j < block.fields_num && !found; ++j) {
+            found = (block.fields[j].type == field);
+        }
+    }
+    free(block.fields);
+
+    return found;
+}
+
 void info_reset(const struct image* image)
 {
     const size_t mib = 1024 * 1024;
     const char unit = image->file_size >= mib ? 'M' : 'K';
     const float sz =
         (float)image->file_size / (image->file_size >= mib ? mib : 1024);
+    const bool active = ctx.info.active;
+
+    timeout_reset(&ctx.info);
 
-    font_render(image->name, &ctx.fields[info_file_name].value);
-    font_render(image->parent_dir, &ctx.fields[info_file_dir].value);
-    font_render(image->source, &ctx.fields[info_file_path].value);
-    font_render(image->format, &ctx.fields[info_image_format].value);
+    // only changed fields are rendered and repainted
+    set_field(info_file_name, image->name);
+    set_field(info_file_dir, image->parent_dir);
+    set_field(info_file_path, image->source);
+    set_field(info_image_format, image->format);
 
     info_update(info_file_size, "%.02f %ciB", sz, unit);
-    info_update(info_image_size, "%zux%zu", image->frames[0].pm.width,
-                image->frames[0].pm.height);
+    info_update(info_image_size, "%zux%zu", image_get_width(image),
+                image_get_height(image));
 
-    import_meta(image);
+    info_update_meta(image);
 
-    info_update(info_frame, NULL);
-    info_update(info_scale, NULL);
+    set_field(info_frame, NULL);
+    set_field(info_scale, NULL);
 
-    timeout_reset(&ctx.info);
+    if (!active) {
+        redraw_blocks(FIELDS_NUM);
+    }
+}
+
+void info_update_meta(const struct image* image)
+{
+    if (import_meta(image)) {
+        redraw_blocks(info_exif);
+    }
 }
 
 void info_update(enum info_field field, const char* fmt, ...)
 {
-    struct text_surface* surface = &ctx.fields[field].value;
     va_list args;
     int len;
     char* text;
 
     if (!fmt) {
-        free(surface->data);
-        memset(surface, 0, sizeof(*surface));
+        set_field(field, NULL);
         return;
     }
 
@@ -615,87 +1123,42 @@ void info_update(enum info_field field, const char* fmt, ...)
     vsprintf(text, fmt, args);
     va_end(args);
 
-    font_render(text, surface);
-
-    free(text);
-
     if (field == info_status) {
+        // the same message is shown again after the timeout
+        const bool active = ctx.status.active;
         timeout_reset(&ctx.status);
+        if (!set_field(field, text) && !active) {
+            redraw_blocks(field);
+        }
+    } else {
+        set_field(field, text);
     }
+
+    free(text);
 }
 
-void info_print(struct pixmap* window)
+void info_print(struct pixmap* window, ssize_t x, ssize_t y)
 {
     if (info_help_active()) {
-        print_help(window);
-    }
-
-    if (ctx.mode == mode_off || !ctx.info.active) {
-        // print only status
-        if (ctx.fields[info_status].value.width && ctx.status.active) {
-            const size_t btype = app_is_viewer() ? mode_viewer : mode_gallery;
-            for (size_t i = 0; i < POSITION_NUM; ++i) {
-                const struct block_scheme* block = &ctx.scheme[btype][i];
-                for (size_t j = 0; j < block->fields_num; ++j) {
-                    const struct field_scheme* field = &block->fields[j];
-                    if (field->type == info_status) {
-                        struct keyval status = ctx.fields[info_status];
-                        if (!field->title) {
-                            memset(&status.key, 0, sizeof(status.key));
-                        }
-                        print_keyval(window, i, &status, 1);
-                        break;
-                    }
-                }
-            }
-        }
-        return;
+        print_help(window, x, y);
     }
 
     for (size_t i = 0; i < POSITION_NUM; ++i) {
-        struct keyval lines[MAX_LINES] = { 0 };
-        const struct block_scheme* block = &ctx.scheme[ctx.mode][i];
-        size_t lnum = 0;
-
-        for (size_t j = 0; j < block->fields_num; ++j) {
-            const struct field_scheme* field = &block->fields[j];
-            const struct keyval* origin = &ctx.fields[field->type];
-
-            switch (field->type) {
-                case info_exif:
-                    for (size_t n = 0; n < ctx.exif_num; ++n) {
-                        if (lnum < ARRAY_SIZE(lines)) {
-                            if (field->title) {
-                                lines[lnum].key = ctx.exif_lines[n].key;
-                            }
-                            lines[lnum++].value = ctx.exif_lines[n].value;
-                        }
-                    }
-                    break;
-                case info_status:
-                    if (origin->value.width && ctx.status.active) {
-                        if (field->title) {
-                            lines[lnum].key = origin->key;
-                        }
-                        lines[lnum++].value = origin->value;
-                    }
-                    break;
-                default:
-                    if (origin->value.width) {
-                        if (field->title) {
-                            lines[lnum].key = origin->key;
-                        }
-                        lines[lnum++].value = origin->value;
-                    }
-                    break;
-            }
-            if (lnum >= ARRAY_SIZE(lines)) {
-                break;
-            }
-        }
-
+        struct keyval lines[MAX_LINES];
+        const size_t lnum = get_lines(i, lines, ctx.line_field[i]);
+        ctx.lines_num[i] = lnum;
         if (lnum) {
-            print_keyval(window, i, lines, lnum);
+            print_keyval(window, x, y, i, lines, lnum, &ctx.area[i],
+                         ctx.line_area[i]);
+        } else {
+            memset(&ctx.area[i], 0, sizeof(ctx.area[i]));
         }
     }
+
+    if (ctx.perf.active && !info_help_active()) {
+        print_keyval(window, x, y, pos_center, ctx.perf.lines,
+                     ctx.perf.lines_num, &ctx.perf.area, NULL);
+    } else {
+        memset(&ctx.perf.area, 0, sizeof(ctx.perf.area));
+    }
 }
@@ -50,18 +50,40 @@ void info_switch_help(void);
  */
 bool info_help_active(void);
 
+/**
+ * Show/hide performance HUD.
+ */
+void info_switch_perf(void);
+
 /**
  * Check if info enabled.
  * @param true if info text layer is enabled
  */
 bool info_enabled(void);
 
+/**
+ * Check if the field is a part of the info scheme, the scheme is read from
+ * the config, so the info module doesn't have to be initialized.
+ * @param cfg config instance
+ * @param mode name of the info mode (viewer/gallery)
+ * @param field info field id
+ * @return true if the field can be displayed in the specified mode
+ */
+bool info_has_field(const struct config* cfg, const char* mode,
+                    enum info_field field);
+
 /**
  * Compose info data from image.
  * @param image image instance
  */
 void info_reset(const struct image* image);
 
+/**
+ * Update meta info (EXIF) of the image.
+ * @param image image instance
+ */
+void info_update_meta(const struct image* image);
+
 /**
  * Update info text.
  * @param field info field id
@@ -72,8 +94,9 @@ void info_update(enum info_field field, const char* fmt, ...)
 
 /**
  * Print info text.
- * @param window target window surface
+ * @param window target canvas
+ * @param x,y position of the canvas on the window
  */
-void info_print(struct pixmap* window);
+void info_print(struct pixmap* window, ssize_t x, ssize_t y);
 
 void info_on_scale(void);
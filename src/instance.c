@@ -0,0 +1,383 @@
+// SPDX-License-Identifier: MIT
+// Single instance mode: control socket to pass sources to running process.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+// realpath()
+#define _DEFAULT_SOURCE
+
+#include "instance.h"
+
+#include "buildcfg.h"
+#include "list.h"
+#include "loader.h"
+#include "perf.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Max time to wait for sources from connected instance (ms)
+#define RECV_TIMEOUT 1000
+// Initial size of the receive buffer
+#define RECV_BUFFER 4096
+// Max size of sources passed by one instance
+#define RECV_LIMIT (PATH_MAX * 1024)
+// Max number of connections being read at the same time
+#define MAX_CLIENTS 8
+
+/** Connection of another instance. */
+struct client {
+    struct list list;  ///< Links to prev/next entry
+    int fd;            ///< Client socket
+    uint64_t deadline; ///< Time limit of the transfer (ms), see `perf_now`
+    uint8_t* data;     ///< Received data
+    size_t size;       ///< Size of received data
+    size_t capacity;   ///< Size of the buffer
+    bool eof;          ///< Peer finished the transfer
+};
+
+/** Path to the control socket of the listening instance. */
+static char* socket_path;
+/** Connections being read. */
+static struct client* clients;
+static size_t clients_num;
+
+/**
+ * Get address of the control socket.
+ * @param sa output socket address
+ * @return false if address can not be composed
+ */
+static bool socket_address(struct sockaddr_un* sa)
+{
+    const char* dir = getenv("XDG_RUNTIME_DIR");
+    const char* display = getenv("WAYLAND_DISPLAY");
+    int len;
+
+    if (!dir || !*dir) {
+        return false;
+    }
+    if (!display || !*display || strchr(display, '/')) {
+        display = "wayland-0";
+    }
+
+    memset(sa, 0, sizeof(*sa));
+    sa->sun_family = AF_UNIX;
+    len = snprintf(sa->sun_path, sizeof(sa->sun_path),
+                   "%s/" APP_NAME "-%s.sock", dir, display);
+
+    return len > 0 && (size_t)len < sizeof(sa->sun_path);
+}
+
+/**
+ * Connect to the control socket.
+ * @param sa socket address
+ * @return socket file descriptor or -1 if no one is listening
+ */
+static int socket_connect(const struct sockaddr_un* sa)
+{
+    int fd;
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    if (connect(fd, (const struct sockaddr*)sa, sizeof(*sa)) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * Write the whole buffer to the socket.
+ * @param fd socket file descriptor
+ * @param data buffer to write
+ * @param size size of the buffer
+ * @return true if all data written
+ */
+static bool socket_write(int fd, const void* data, size_t size)
+{
+    while (size) {
+        const ssize_t wr = write(fd, data, size);
+        if (wr == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        size -= wr;
+        data = (const uint8_t*)data + wr;
+    }
+    return true;
+}
+
+/**
+ * Write source to the socket, paths are sent as absolute ones.
+ * @param fd socket file descriptor
+ * @param source image source to send
+ * @return true if source was sent
+ */
+static bool send_source(int fd, const char* source)
+{
+    char path[PATH_MAX];
+
+    if (strncmp(source, LDRSRC_EXEC, LDRSRC_EXEC_LEN) != 0) {
+        if (!realpath(source, path)) {
+            fprintf(stderr, "%s: Unable to open: %s\n", source,
+                    strerror(errno));
+            return true; // skip it, the same as the image list does
+        }
+        source = path;
+    }
+
+    return socket_write(fd, source, strlen(source) + 1);
+}
+
+/**
+ * Find connection by its socket.
+ * @param fd client socket
+ * @return pointer to the connection or NULL if not found
+ */
+static struct client* find_client(int fd)
+{
+    list_for_each(clients, struct client, it) {
+        if (it->fd == fd) {
+            return it;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Free connection, the socket is closed by the caller.
+ * @param client connection to free
+ */
+static void free_client(struct client* client)
+{
+    clients = list_unlink(clients, client);
+    --clients_num;
+    free(client->data);
+    free(client);
+}
+
+/**
+ * Read available data from the client socket.
+ * @param client connection to read
+ * @return false if transfer must be aborted
+ */
+static bool client_read(struct client* client)
+{
+    while (true) {
+        ssize_t rd;
+
+        if (client->size == client->capacity) {
+            const size_t cap =
+                client->capacity ? client->capacity * 2 : RECV_BUFFER;
+            uint8_t* ptr;
+            if (client->capacity >= RECV_LIMIT) {
+                return false; // too much data
+            }
+            ptr = realloc(client->data, cap);
+            if (!ptr) {
+                return false;
+            }
+            client->data = ptr;
+            client->capacity = cap;
+        }
+
+        rd = read(client->fd, client->data + client->size,
+                  client->capacity - client->size);
+        if (rd == 0) {
+            client->eof = true;
+            return true;
+        }
+        if (rd == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // no more data for now, wait for the next poll event
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        client->size += rd;
+    }
+}
+
+bool instance_forward(const char** sources, size_t num)
+{
+    static const char* current_dir = ".";
+    struct sockaddr_un sa;
+    bool rc = true;
+    char ack;
+    int fd;
+
+    // stdin can not be passed to another process
+    for (size_t i = 0; i < num; ++i) {
+        if (strcmp(sources[i], "-") == 0) {
+            return false;
+        }
+    }
+    if (num == 0) {
+        sources = &current_dir;
+        num = 1;
+    }
+
+    if (!socket_address(&sa)) {
+        return false;
+    }
+    fd = socket_connect(&sa);
+    if (fd == -1) {
+        return false; // no running instance
+    }
+
+    for (size_t i = 0; rc && i < num; ++i) {
+        rc = send_source(fd, sources[i]);
+    }
+    // the running instance closes connection when sources are accepted
+    if (rc) {
+        shutdown(fd, SHUT_WR);
+        rc = read(fd, &ack, sizeof(ack)) == 0;
+    }
+
+    close(fd);
+
+    return rc;
+}
+
+int instance_listen(void)
+{
+    struct sockaddr_un sa;
+    int fd;
+
+    if (!socket_address(&sa)) {
+        return -1;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd == -1) {
+        return -1;
+    }
+
+    if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) == -1) {
+        int active;
+        if (errno != EADDRINUSE) {
+            goto fail;
+        }
+        // remove socket file left by crashed instance
+        active = socket_connect(&sa);
+        if (active != -1) {
+            close(active);
+            goto fail; // another instance is already running
+        }
+        unlink(sa.sun_path);
+        if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) == -1) {
+            goto fail;
+        }
+    }
+    if (listen(fd, 4) == -1) {
+        unlink(sa.sun_path);
+        goto fail;
+    }
+
+    socket_path = strdup(sa.sun_path);
+
+    return fd;
+
+fail:
+    fprintf(stderr, "Unable to create control socket %s: %s\n", sa.sun_path,
+            strerror(errno));
+    close(fd);
+    return -1;
+}
+
+void instance_destroy(void)
+{
+    list_for_each(clients, struct client, it) {
+        free_client(it);
+    }
+
+    if (socket_path) {
+        unlink(socket_path);
+        free(socket_path);
+        socket_path = NULL;
+    }
+}
+
+int instance_accept(int fd)
+{
+    const uint64_t now = perf_now() / 1000;
+    struct client* client;
+    int sock;
+
+    // wake up expired clients that don't send anything, they are dropped
+    // on the next read
+    list_for_each(clients, struct client, it) {
+        if (now >= it->deadline) {
+            shutdown(it->fd, SHUT_RDWR);
+        }
+    }
+
+    sock = accept(fd, NULL, NULL);
+    if (sock == -1) {
+        return -1;
+    }
+
+    // limit resources used by clients that don't finish transfer
+    if (clients_num >= MAX_CLIENTS ||
+        fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK) == -1 ||
+        fcntl(sock, F_SETFD, FD_CLOEXEC) == -1) {
+        close(sock);
+        return -1;
+    }
+    client = calloc(1, sizeof(*client));
+    if (!client) {
+        close(sock);
+        return -1;
+    }
+    client->fd = sock;
+    client->deadline = now + RECV_TIMEOUT;
+    clients = list_append(clients, client);
+    ++clients_num;
+
+    return sock;
+}
+
+bool instance_read(int fd, char** sources, size_t* size, size_t* num)
+{
+    struct client* client = find_client(fd);
+
+    *num = 0;
+
+    if (!client) {
+        return true;
+    }
+    // don't let a slow client hold the connection
+    if (!client_read(client) || perf_now() / 1000 >= client->deadline) {
+        free_client(client);
+        return true;
+    }
+    if (!client->eof) {
+        return false; // wait for more data
+    }
+
+    if (client->size && client->data[client->size - 1] == 0) {
+        for (size_t i = 0; i < client->size; ++i) {
+            if (!client->data[i]) {
+                ++*num;
+            }
+        }
+        *sources = (char*)client->data;
+        *size = client->size;
+        client->data = NULL;
+    }
+    free_client(client);
+
+    return true;
+}
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: MIT
+// Single instance mode: control socket to pass sources to running process.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Pass image sources to the already running instance.
+ * Relative paths are converted to absolute ones, because the running
+ * instance has its own working directory.
+ * @param sources array of image sources, current directory if empty
+ * @param num number of sources in the array
+ * @return true if sources were accepted by the running instance
+ */
+bool instance_forward(const char** sources, size_t num);
+
+/**
+ * Create control socket to receive sources from other instances.
+ * @return socket file descriptor to watch, -1 on errors
+ */
+int instance_listen(void);
+
+/**
+ * Remove control socket file and free connections, the sockets themselves are
+ * closed by the caller.
+ */
+void instance_destroy(void);
+
+/**
+ * Accept connection on the control socket.
+ * The client socket is non-blocking and must be watched for input, data is
+ * read by `instance_read`.
+ * @param fd control socket file descriptor
+ * @return client socket or -1 if connection is not accepted
+ */
+int instance_accept(int fd);
+
+/**
+ * Read sources passed by another instance, data is accumulated between calls
+ * until the peer closes connection. Transfer is aborted if it is too slow or
+ * too large.
+ * @param fd client socket returned by `instance_accept`
+ * @param sources output array of null-terminated sources, stored one after
+ *                another, caller must free it
+ * @param size output size of the sources array in bytes
+ * @param num output number of received sources, 0 if transfer failed
+ * @return true if transfer is finished and the socket must be closed
+ */
+bool instance_read(int fd, char** sources, size_t* size, size_t* num);
@@ -72,6 +72,25 @@ struct list* list_remove_entry(struct list* entry)
     return head;
 }
 
+struct list* list_unlink_entry(struct list* head, struct list* entry)
+{
+    if (head == entry) {
+        head = entry->next;
+    }
+
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    }
+
+    entry->next = NULL;
+    entry->prev = NULL;
+
+    return head;
+}
+
 struct list* list_get_last_entry(struct list* head)
 {
     list_for_each(head, struct list, it) {
@@ -85,6 +85,16 @@ struct list* list_insert_entry(struct list* before, struct list* entry);
 struct list* list_remove_entry(struct list* entry);
 #define list_remove(entry) (void*)list_remove_entry((struct list*)entry)
 
+/**
+ * Remove entry from the list in constant time.
+ * @param head pointer to the list head
+ * @param entry pointer to entry
+ * @return new head pointer
+ */
+struct list* list_unlink_entry(struct list* head, struct list* entry);
+#define list_unlink(head, entry) \
+    (void*)list_unlink_entry((struct list*)head, (struct list*)entry)
+
 /**
  * Get the last entry from the list.
  * @param entry pointer to the head entry
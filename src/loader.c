@@ -7,9 +7,16 @@
 #include "application.h"
 #include "array.h"
 #include "buildcfg.h"
+#include "dcache.h"
+#include "execcache.h"
 #include "exif.h"
 #include "imagelist.h"
+#include "perf.h"
+#include "priority.h"
 #include "shellcmd.h"
+#include "tpool.h"
+#include "trace.h"
+#include "worker.h"
 
 #include <errno.h>
 #include <fcntl.h>
@@ -20,6 +27,14 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+// Max number of background decoders
+#define MAX_DECODERS 16
+
+// Delay before the first display of partially decoded image (ms)
+#define PROGRESS_DELAY 100
+// Min interval between progress notifications (ms)
+#define PROGRESS_INTERVAL 10
+
 // Construct function name of loader
 #define LOADER_FUNCTION(name) decode_##name
 // Declaration of loader function
@@ -159,25 +174,136 @@ static const image_decoder decoders[] = {
     &LOADER_FUNCTION(farbfeld),
     &LOADER_FUNCTION(tga) // should be the last one
 };
+
+/** Format signature: magic bytes at the fixed offset. */
+struct signature {
+    size_t offset;         ///< Offset of the magic bytes
+    const char* magic;     ///< Magic bytes
+    size_t size;           ///< Size of the magic bytes
+    image_decoder decoder; ///< Format decoder
+};
+#define SIGNATURE(offset, magic, name) \
+    { offset, magic, sizeof(magic) - 1, &LOADER_FUNCTION(name) }
+
+// list of signatures to select decoder without probing, formats with
+// heuristic detection (svg, tga, pnm, etc) are handled by the decoders list
+static const struct signature signatures[] = {
+#ifdef HAVE_LIBJPEG
+    SIGNATURE(0, "\xff\xd8", jpeg),
+#endif
+#ifdef HAVE_LIBPNG
+    SIGNATURE(0, "\x89PNG", png),
+#endif
+#ifdef HAVE_LIBGIF
+    SIGNATURE(0, "GIF", gif),
+#endif
+    SIGNATURE(0, "BM", bmp),
+    SIGNATURE(128, "DICM", dicom),
+#ifdef HAVE_LIBWEBP
+    SIGNATURE(0, "RIFF", webp),
+#endif
+#ifdef HAVE_LIBHEIF
+    SIGNATURE(4, "ftyp", heif),
+#endif
+#ifdef HAVE_LIBAVIF
+    SIGNATURE(4, "ftyp", avif),
+#endif
+#ifdef HAVE_LIBJXL
+    SIGNATURE(0, "\xff\x0a", jxl),
+    SIGNATURE(0, "\0\0\0\x0cJXL ", jxl),
+#endif
+#ifdef HAVE_LIBEXR
+    SIGNATURE(0, "\x76\x2f\x31\x01", exr),
+#endif
+#ifdef HAVE_LIBRAW // TIFF based raw formats
+    SIGNATURE(0, "II*\0", raw),
+    SIGNATURE(0, "MM\0*", raw),
+#endif
+#ifdef HAVE_LIBTIFF
+    SIGNATURE(0, "II*\0", tiff),
+    SIGNATURE(0, "MM\0*", tiff),
+#endif
+    SIGNATURE(0, "qoif", qoi),
+    SIGNATURE(0, "farbfeld", farbfeld),
+};
 // clang-format on
 
 /** Background thread loader queue. */
 struct loader_queue {
     struct list list; ///< Links to prev/next entry
     size_t index;     ///< Index of the image to load
+    size_t priority;  ///< Load priority, lower value is loaded first
+    bool foreground;  ///< Image is displayed, loaded at normal priority
+    char* source;     ///< Image source, image list can be changed while loading
+    uint64_t queued;  ///< Time when the entry was queued, see `perf_now`
+};
+
+/** Background decoder. */
+struct decoder {
+    pthread_t tid;     ///< Thread id
+    bool cancel;       ///< Cancellation flag of the current decoding
+    size_t index;      ///< Index of the image being decoded
+    size_t generation; ///< Queue generation of the current decoding
+    bool foreground;   ///< Decoder of displayed images, priority is normal
+};
+
+/** File to read ahead. */
+struct prefetch_file {
+    struct list list; ///< Links to prev/next entry
+    char* source;     ///< Path to the file
+};
+
+/** Read ahead queue handled by the background worker. */
+struct prefetch {
+    struct prefetch_file* queue; ///< Files to read ahead
+    bool posted;                 ///< Read ahead job is posted to the worker
+    pthread_mutex_t lock;        ///< Queue access lock
 };
 
 /** Loader context. */
 struct loader {
-    pthread_t tid;              ///< Background loader thread id
-    struct loader_queue* queue; ///< Background thread loader queue
+    struct decoder* decoders;   ///< Background decoders
+    size_t num_decoders;        ///< Number of decoders
+    bool stop;                  ///< Stop flag for decoder threads
+    struct loader_queue* queue; ///< Queue sorted by priority
+    size_t generation;          ///< Queue generation, changed on reset
     pthread_mutex_t lock;       ///< Queue access lock
     pthread_cond_t signal;      ///< Queue notification
-    pthread_cond_t ready;       ///< Thread ready signal
+    bool shared;                ///< Decode images into shared memory
+    size_t size_hint;           ///< Min size of decoded images, 0 for full
+    loader_hook hook;           ///< Handler of images loaded in background
+    loader_cache cache;         ///< Source of ready images
+    uint64_t progress_time;     ///< Time of the next progress notification
+    struct prefetch prefetch;   ///< Read ahead queue
 };
 
 /** Global loader context instance. */
-static struct loader ctx;
+static struct loader ctx = {
+    .prefetch.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+enum loader_status loader_decode_embedded(struct image* img,
+                                          const uint8_t* data, size_t size)
+{
+    enum loader_status status = ldr_unsupported;
+    size_t i;
+
+    // select decoder by signature
+    for (i = 0; i < ARRAY_SIZE(signatures) && status == ldr_unsupported; ++i) {
+        const struct signature* sig = &signatures[i];
+        if (size >= sig->offset + sig->size &&
+            memcmp(data + sig->offset, sig->magic, sig->size) == 0) {
+            status = sig->decoder(img, data, size);
+        }
+    }
+
+    // probe all decoders
+    for (i = 0; i < ARRAY_SIZE(decoders) && status == ldr_unsupported; ++i) {
+        status = decoders[i](img, data, size);
+    }
+
+    return status;
+}
 
 /**
  * Load image from memory buffer.
@@ -190,21 +316,61 @@ static enum loader_status image_from_memory(struct image* img,
                                             const uint8_t* data, size_t size)
 {
     enum loader_status status = ldr_unsupported;
-    size_t i;
+    uint64_t start = perf_now();
 
-    for (i = 0; i < ARRAY_SIZE(decoders) && status == ldr_unsupported; ++i) {
-        status = decoders[i](img, data, size);
+#ifdef HAVE_LIBEXIF
+    // embedded preview is enough for thumbnails
+    if (img->size_hint && exif_preview(img, data, size)) {
+        status = ldr_success;
     }
+#endif
+
+    if (status == ldr_unsupported) {
+        status = loader_decode_embedded(img, data, size);
+    }
+    trace_span("decode", img->format, start);
 
     img->file_size = size;
 
 #ifdef HAVE_LIBEXIF
+    // only orientation is applied, meta info is parsed on demand
+    start = perf_now();
     process_exif(img, data, size);
+    trace_span("exif", NULL, start);
 #endif
 
     return status;
 }
 
+/**
+ * Load image from regular file mapped to memory.
+ * @param img destination image
+ * @param fd file descriptor
+ * @param size size of the file
+ * @return loader status
+ */
+static enum loader_status image_from_mapped(struct image* img, int fd,
+                                            size_t size)
+{
+    const uint64_t start = perf_now();
+    enum loader_status status;
+    void* data;
+
+    data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        return ldr_ioerror;
+    }
+    // read the whole file at once instead of faulting page by page
+    posix_madvise(data, size, POSIX_MADV_WILLNEED);
+    trace_span("map", NULL, start);
+
+    status = image_from_memory(img, data, size);
+
+    munmap(data, size);
+
+    return status;
+}
+
 /**
  * Load image from file.
  * @param img destination image
@@ -213,8 +379,7 @@ static enum loader_status image_from_memory(struct image* img,
  */
 static enum loader_status image_from_file(struct image* img, const char* file)
 {
-    enum loader_status status = ldr_ioerror;
-    void* data = MAP_FAILED;
+    enum loader_status status;
     struct stat st;
     int fd;
 
@@ -223,21 +388,17 @@ static enum loader_status image_from_file(struct image* img, const char* file)
         return ldr_ioerror;
     }
 
+    // decoded image from persistent cache
+    if (dcache_load(img, file, &st)) {
+        return ldr_success;
+    }
+
     // open file and map it to memory
     fd = open(file, O_RDONLY);
     if (fd == -1) {
         return ldr_ioerror;
     }
-    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    if (data == MAP_FAILED) {
-        close(fd);
-        return ldr_ioerror;
-    }
-
-    // load from mapped memory
-    status = image_from_memory(img, data, st.st_size);
-
-    munmap(data, st.st_size);
+    status = image_from_mapped(img, fd, st.st_size);
     close(fd);
 
     return status;
@@ -252,35 +413,24 @@ static enum loader_status image_from_file(struct image* img, const char* file)
 static enum loader_status image_from_stream(struct image* img, int fd)
 {
     enum loader_status status = ldr_ioerror;
-    uint8_t* data = NULL;
-    size_t size = 0;
-    size_t capacity = 0;
-
-    while (true) {
-        ssize_t rc;
-
-        if (size == capacity) {
-            const size_t new_capacity = capacity + 256 * 1024;
-            uint8_t* new_buf = realloc(data, new_capacity);
-            if (!new_buf) {
-                break;
-            }
-            data = new_buf;
-            capacity = new_capacity;
-        }
+    uint64_t start;
+    uint8_t* data;
+    size_t size;
+    struct stat st;
 
-        rc = read(fd, data + size, capacity - size);
-        if (rc == 0) {
-            status = image_from_memory(img, data, size);
-            break;
-        }
-        if (rc == -1 && errno != EAGAIN) {
-            break;
-        }
-        size += rc;
+    // stdin redirected from regular file can be mapped without copying
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+        lseek(fd, 0, SEEK_CUR) == 0) {
+        return image_from_mapped(img, fd, st.st_size);
     }
 
+    start = perf_now();
+    if (fd_read_all(fd, &data, &size) == 0 && data) {
+        trace_span("read", NULL, start);
+        status = image_from_memory(img, data, size);
+    }
     free(data);
+
     return status;
 }
 
@@ -294,13 +444,25 @@ static enum loader_status image_from_exec(struct image* img, const char* cmd)
 {
     uint8_t* data = NULL;
     size_t data_sz = 0;
+    const uint64_t start = perf_now();
     enum loader_status status;
-    int rc;
+    int rc, fd;
+
+    // output from the previous execution is mapped without copying
+    if (execcache_get(cmd, &fd, &data_sz)) {
+        status = image_from_mapped(img, fd, data_sz);
+        close(fd);
+        return status;
+    }
 
     rc = shellcmd_exec(cmd, &data, &data_sz);
+    trace_span("exec", NULL, start);
 
     if (rc == 0 && data) {
         status = image_from_memory(img, data, data_sz);
+        if (status == ldr_success) {
+            execcache_put(cmd, data, data_sz);
+        }
     } else {
         status = ldr_ioerror;
     }
@@ -310,18 +472,35 @@ static enum loader_status image_from_exec(struct image* img, const char* cmd)
     return status;
 }
 
-enum loader_status loader_from_source(const char* source, struct image** image)
+/**
+ * Decoding progress handler of images loaded in the main thread.
+ * @param image image being decoded
+ * @param rows number of decoded rows
+ */
+static void on_progress(const struct image* image, size_t rows)
 {
-    enum loader_status status;
-    struct image* img;
-
-    // create image instance
-    img = image_alloc();
-    if (!img) {
-        return ldr_ioerror;
+    const uint64_t now = perf_now() / 1000;
+    if (now >= ctx.progress_time) {
+        ctx.progress_time = now + PROGRESS_INTERVAL;
+        app_on_progress(image, rows);
     }
+}
+
+/**
+ * Decode image from specified source and apply post processing.
+ * @param img image instance to decode, it is freed on errors
+ * @param source image data source
+ * @param image pointer to output image instance
+ * @return loading status
+ */
+static enum loader_status decode_image(struct image* img, const char* source,
+                                       struct image** image)
+{
+    const uint64_t trace_start = perf_now();
+    enum loader_status status;
+    uint64_t start;
 
-    // decode image
+    start = perf_now() / 1000;
     if (strcmp(source, LDRSRC_STDIN) == 0) {
         status = image_from_stream(img, STDIN_FILENO);
     } else if (strncmp(source, LDRSRC_EXEC, LDRSRC_EXEC_LEN) == 0) {
@@ -330,8 +509,20 @@ enum loader_status loader_from_source(const char* source, struct image** image)
         status = image_from_file(img, source);
     }
 
+    img->cancel = NULL;
+    img->progress = NULL;
+    img->allow_preview = false;
+    img->decode_time = perf_now() / 1000 - start;
     if (status == ldr_success) {
+        if (img->format) {
+            perf_decode(img->format, img->decode_time);
+        }
         image_set_source(img, source);
+        if (!img->size_hint) {
+            image_diff_frames(img); // thumbnails are not animated
+        }
+        dcache_save(img);
+        trace_span("load", img->format, trace_start);
         *image = img;
     } else {
         image_free(img);
@@ -340,6 +531,51 @@ enum loader_status loader_from_source(const char* source, struct image** image)
     return status;
 }
 
+/**
+ * Load image from specified source.
+ * @param source image data source
+ * @param cancel pointer to the cancellation flag, NULL for
+ *        synchronous loading in the main thread
+ * @param image pointer to output image instance
+ * @return loading status
+ */
+static enum loader_status load_image(const char* source, const bool* cancel,
+                                     struct image** image)
+{
+    struct image* img;
+
+    // create image instance
+    img = image_alloc();
+    if (!img) {
+        return ldr_ioerror;
+    }
+    img->cancel = cancel;
+    if (!cancel) {
+        // image is loaded in the main thread, partially decoded image can be
+        // displayed while the user is waiting for it
+        img->progress = on_progress;
+        ctx.progress_time = perf_now() / 1000 + PROGRESS_DELAY;
+    }
+    if (ctx.decoders) {
+        pthread_mutex_lock(&ctx.lock);
+        img->shared = ctx.shared;
+        img->size_hint = ctx.size_hint;
+        pthread_mutex_unlock(&ctx.lock);
+        // full quality image is decoded in background later, that requires
+        // the source to be readable again
+        img->allow_preview = !cancel && !img->size_hint &&
+            strcmp(source, LDRSRC_STDIN) != 0 &&
+            strncmp(source, LDRSRC_EXEC, LDRSRC_EXEC_LEN) != 0;
+    }
+
+    return decode_image(img, source, image);
+}
+
+enum loader_status loader_from_source(const char* source, struct image** image)
+{
+    return load_image(source, NULL, image);
+}
+
 enum loader_status loader_from_index(size_t index, struct image** image)
 {
     enum loader_status status = ldr_ioerror;
@@ -355,86 +591,422 @@ enum loader_status loader_from_index(size_t index, struct image** image)
     return status;
 }
 
-/** Image loader executed in background thread. */
-static void* loading_thread(__attribute__((unused)) void* data)
+enum loader_status loader_decode_source(const char* source, size_t size_hint,
+                                        const bool* cancel,
+                                        struct image** image)
 {
-    struct loader_queue* entry;
-    struct image* image;
+    struct image* img = image_alloc();
 
-    do {
-        pthread_mutex_lock(&ctx.lock);
-        pthread_cond_signal(&ctx.ready);
-        while (!ctx.queue) {
+    if (!img) {
+        return ldr_ioerror;
+    }
+    img->cancel = cancel;
+    img->size_hint = size_hint;
+
+    return decode_image(img, source, image);
+}
+
+/**
+ * Get the first queue entry suitable for the decoder, must be called with
+ * locked mutex.
+ * @param decoder background decoder
+ * @return queue entry or NULL if there is nothing to load
+ */
+static struct loader_queue* next_entry(const struct decoder* decoder)
+{
+    list_for_each(ctx.queue, struct loader_queue, it) {
+        if (it->foreground == decoder->foreground) {
+            return it;
+        }
+    }
+    return NULL;
+}
+
+/** Image decoder executed in background thread. */
+static void* loading_thread(void* data)
+{
+    struct decoder* decoder = data;
+
+    // priority can't be raised back by unprivileged process, so displayed
+    // images are loaded by the dedicated decoder
+    if (!decoder->foreground) {
+        priority_background();
+    }
+
+    pthread_mutex_lock(&ctx.lock);
+
+    while (true) {
+        struct loader_queue* entry;
+        struct image* image = NULL;
+        loader_cache cache;
+        loader_hook hook;
+        uint64_t start;
+
+        while (!ctx.stop && !(entry = next_entry(decoder))) {
             pthread_cond_wait(&ctx.signal, &ctx.lock);
-            if (!ctx.queue) {
-                pthread_cond_signal(&ctx.ready);
-            }
         }
-        entry = ctx.queue;
-        ctx.queue = list_remove(entry);
-        pthread_mutex_unlock(&ctx.lock);
+        if (ctx.stop) {
+            break;
+        }
 
-        if (entry->index == IMGLIST_INVALID) {
-            free(entry);
-            return NULL;
+        ctx.queue = list_unlink(ctx.queue, entry);
+        hook = ctx.hook;
+        cache = ctx.cache;
+        decoder->index = entry->index;
+        decoder->generation = ctx.generation;
+        __atomic_store_n(&decoder->cancel, false, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&ctx.lock);
+        trace_span("queue", NULL, entry->queued);
+
+        start = perf_now();
+        if (cache && (image = cache(entry->source))) {
+            image->index = entry->index;
+            trace_span("cache", NULL, start);
+        } else if (load_image(entry->source, &decoder->cancel, &image) ==
+                   ldr_success) {
+            image->index = entry->index;
+            // image is completely decoded, so it is still worth to cache
+            // even if it is not needed right now
+            if (hook && decoder->generation ==
+                    __atomic_load_n(&ctx.generation, __ATOMIC_RELAXED)) {
+                start = perf_now();
+                hook(image);
+                trace_span("hook", NULL, start);
+            }
         }
 
-        image = NULL;
-        loader_from_index(entry->index, &image);
-        app_on_load(image, entry->index);
+        pthread_mutex_lock(&ctx.lock);
+        decoder->index = IMGLIST_INVALID;
+        if (decoder->generation == ctx.generation &&
+            (image || !decoder->cancel)) {
+            app_on_load(image, entry->index);
+        } else {
+            image_free(image); // queue was reset, result is not needed
+        }
+        free(entry->source);
         free(entry);
-    } while (true);
+    }
+
+    pthread_mutex_unlock(&ctx.lock);
 
     return NULL;
 }
 
-void loader_init(void)
+/**
+ * Free all entries in the queue and cancel active decoders, must be called
+ * with locked mutex.
+ */
+static void reset_queue(void)
 {
-    pthread_cond_init(&ctx.signal, NULL);
-    pthread_cond_init(&ctx.ready, NULL);
+    list_for_each(ctx.queue, struct loader_queue, it) {
+        free(it->source);
+        free(it);
+    }
+    ctx.queue = NULL;
 
-    pthread_mutex_init(&ctx.lock, NULL);
-    pthread_mutex_lock(&ctx.lock);
+    __atomic_store_n(&ctx.generation, ctx.generation + 1, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < ctx.num_decoders; ++i) {
+        __atomic_store_n(&ctx.decoders[i].cancel, true, __ATOMIC_RELAXED);
+    }
+}
 
-    pthread_create(&ctx.tid, NULL, loading_thread, NULL);
+/**
+ * Create queue entry.
+ * @param index index of the image in the image list
+ * @param priority load priority
+ * @param foreground image is displayed
+ * @return queue entry or NULL on errors
+ */
+static struct loader_queue* create_entry(size_t index, size_t priority,
+                                         bool foreground)
+{
+    const char* source = image_list_get(index);
+    struct loader_queue* entry;
 
-    pthread_cond_wait(&ctx.ready, &ctx.lock);
-    pthread_mutex_unlock(&ctx.lock);
+    if (!source) {
+        return NULL;
+    }
+    entry = malloc(sizeof(*entry));
+    if (!entry) {
+        return NULL;
+    }
+    entry->source = str_dup(source, NULL);
+    if (!entry->source) {
+        free(entry);
+        return NULL;
+    }
+    entry->index = index;
+    entry->priority = priority;
+    entry->foreground = foreground;
+    entry->queued = perf_now();
+
+    return entry;
+}
+
+bool loader_load_meta(__attribute__((unused)) struct image* image)
+{
+#ifdef HAVE_LIBEXIF
+    const uint64_t start = perf_now();
+    const bool rc = exif_load_meta(image);
+    trace_span("exif_meta", NULL, start);
+    return rc;
+#else
+    return false;
+#endif
+}
+
+void loader_init(size_t threads)
+{
+    if (threads == 0) {
+        threads = tpool_threads();
+    }
+    threads = min(threads, MAX_DECODERS);
+    ++threads; // decoder of displayed images
+
+    pthread_mutex_init(&ctx.lock, NULL);
+    pthread_cond_init(&ctx.signal, NULL);
+
+    ctx.decoders = calloc(threads, sizeof(*ctx.decoders));
+    if (!ctx.decoders) {
+        return;
+    }
+    ctx.stop = false;
+
+    for (size_t i = 0; i < threads; ++i) {
+        struct decoder* decoder = &ctx.decoders[ctx.num_decoders];
+        decoder->index = IMGLIST_INVALID;
+        decoder->foreground = (i == 0);
+        if (pthread_create(&decoder->tid, NULL, loading_thread, decoder) !=
+            0) {
+            break;
+        }
+        ++ctx.num_decoders;
+    }
 }
 
 void loader_destroy(void)
 {
-    if (ctx.tid) {
-        loader_queue_reset();
-        loader_queue_append(IMGLIST_INVALID); // send stop signal
-        pthread_join(ctx.tid, NULL);
+    worker_cancel(&ctx.prefetch);
+    list_for_each(ctx.prefetch.queue, struct prefetch_file, it) {
+        free(it->source);
+        free(it);
+    }
+    ctx.prefetch.queue = NULL;
+    ctx.prefetch.posted = false;
+
+    if (ctx.decoders) {
+        pthread_mutex_lock(&ctx.lock);
+        reset_queue();
+        ctx.stop = true;
+        pthread_cond_broadcast(&ctx.signal);
+        pthread_mutex_unlock(&ctx.lock);
+
+        for (size_t i = 0; i < ctx.num_decoders; ++i) {
+            pthread_join(ctx.decoders[i].tid, NULL);
+        }
+        free(ctx.decoders);
+        ctx.decoders = NULL;
+        ctx.num_decoders = 0;
 
         pthread_mutex_destroy(&ctx.lock);
         pthread_cond_destroy(&ctx.signal);
-        pthread_cond_destroy(&ctx.ready);
     }
 }
 
-void loader_queue_append(size_t index)
+void loader_queue_append(size_t index, size_t priority)
 {
-    struct loader_queue* entry = malloc(sizeof(*entry));
-    if (entry) {
-        entry->index = index;
-        pthread_mutex_lock(&ctx.lock);
+    struct loader_queue* before = NULL;
+    struct loader_queue* entry;
+
+    entry = create_entry(index, priority, false);
+    if (!entry) {
+        return;
+    }
+
+    pthread_mutex_lock(&ctx.lock);
+
+    // keep the queue sorted, entries with the same priority are FIFO
+    list_for_each(ctx.queue, struct loader_queue, it) {
+        if (it->priority > priority) {
+            before = it;
+            break;
+        }
+    }
+    if (before) {
+        ctx.queue = list_insert(before, entry);
+    } else {
         ctx.queue = list_append(ctx.queue, entry);
-        pthread_cond_signal(&ctx.signal);
-        pthread_mutex_unlock(&ctx.lock);
     }
+
+    pthread_cond_broadcast(&ctx.signal); // only some decoders can take it
+    pthread_mutex_unlock(&ctx.lock);
 }
 
-void loader_queue_reset(void)
+void loader_queue_set(const size_t* indices, size_t num, size_t foreground)
 {
+    struct loader_queue* queue = NULL;
+
     pthread_mutex_lock(&ctx.lock);
+
     list_for_each(ctx.queue, struct loader_queue, it) {
+        free(it->source);
         free(it);
     }
     ctx.queue = NULL;
-    pthread_cond_signal(&ctx.signal);
-    pthread_cond_wait(&ctx.ready, &ctx.lock);
+
+    // cancel decoding of images that are not needed anymore, results that
+    // are ready despite the cancellation are delivered anyway
+    for (size_t i = 0; i < ctx.num_decoders; ++i) {
+        struct decoder* decoder = &ctx.decoders[i];
+        bool needed = false;
+        if (decoder->index == IMGLIST_INVALID) {
+            continue;
+        }
+        for (size_t j = 0; j < num && !needed; ++j) {
+            needed = (indices[j] == decoder->index);
+        }
+        if (!needed) {
+            __atomic_store_n(&decoder->cancel, true, __ATOMIC_RELAXED);
+        }
+    }
+
+    // queue the rest in order of priority
+    for (size_t i = 0; i < num; ++i) {
+        struct loader_queue* entry;
+        bool active = false;
+        for (size_t j = 0; j < ctx.num_decoders && !active; ++j) {
+            const struct decoder* decoder = &ctx.decoders[j];
+            active = (decoder->index == indices[i] && !decoder->cancel);
+        }
+        if (!active &&
+            (entry = create_entry(indices[i], i, indices[i] == foreground))) {
+            queue = list_append(queue, entry);
+        }
+    }
+    ctx.queue = queue;
+
+    pthread_cond_broadcast(&ctx.signal);
+    pthread_mutex_unlock(&ctx.lock);
+}
+
+void loader_set_shared(bool enable)
+{
+    pthread_mutex_lock(&ctx.lock);
+    ctx.shared = enable;
+    pthread_mutex_unlock(&ctx.lock);
+}
+
+void loader_set_size_hint(size_t size)
+{
+    pthread_mutex_lock(&ctx.lock);
+    if (ctx.size_hint != size) {
+        // images being decoded with the previous hint are not needed
+        __atomic_store_n(&ctx.generation, ctx.generation + 1,
+                         __ATOMIC_RELAXED);
+        ctx.size_hint = size;
+    }
+    pthread_mutex_unlock(&ctx.lock);
+}
+
+void loader_set_hook(loader_hook hook)
+{
+    pthread_mutex_lock(&ctx.lock);
+    if (ctx.hook != hook) {
+        // images being handled by the previous hook are not needed
+        __atomic_store_n(&ctx.generation, ctx.generation + 1,
+                         __ATOMIC_RELAXED);
+        ctx.hook = hook;
+    }
+    pthread_mutex_unlock(&ctx.lock);
+}
+
+void loader_set_cache(loader_cache cache)
+{
+    pthread_mutex_lock(&ctx.lock);
+    ctx.cache = cache;
+    pthread_mutex_unlock(&ctx.lock);
+}
+
+void loader_queue_reset(void)
+{
+    pthread_mutex_lock(&ctx.lock);
+    reset_queue();
     pthread_mutex_unlock(&ctx.lock);
 }
+
+size_t loader_queue_size(void)
+{
+    size_t size;
+
+    pthread_mutex_lock(&ctx.lock);
+    size = ctx.queue ? list_size(&ctx.queue->list) : 0;
+    pthread_mutex_unlock(&ctx.lock);
+
+    return size;
+}
+
+/**
+ * Read ahead queued files, handler for the worker.
+ * @param data prefetch context
+ */
+static void prefetch_files(__attribute__((unused)) void* data)
+{
+    pthread_mutex_lock(&ctx.prefetch.lock);
+    while (ctx.prefetch.queue) {
+        struct prefetch_file* file = ctx.prefetch.queue;
+        int fd;
+
+        ctx.prefetch.queue = list_unlink(ctx.prefetch.queue, file);
+        pthread_mutex_unlock(&ctx.prefetch.lock);
+
+        // opening can block on slow file systems, so it is done here too
+        fd = open(file->source, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd != -1) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            close(fd);
+        }
+        free(file->source);
+        free(file);
+
+        pthread_mutex_lock(&ctx.prefetch.lock);
+    }
+    ctx.prefetch.posted = false;
+    pthread_mutex_unlock(&ctx.prefetch.lock);
+}
+
+void loader_prefetch(size_t index)
+{
+    const char* source = image_list_get(index);
+    struct prefetch_file* file;
+
+    if (!source || strcmp(source, LDRSRC_STDIN) == 0 ||
+        strncmp(source, LDRSRC_EXEC, LDRSRC_EXEC_LEN) == 0) {
+        return;
+    }
+
+    file = calloc(1, sizeof(*file));
+    if (!file) {
+        return;
+    }
+    file->source = strdup(source);
+    if (!file->source) {
+        free(file);
+        return;
+    }
+
+    // read ahead is asynchronous, file pages stay in cache after closing
+    pthread_mutex_lock(&ctx.prefetch.lock);
+    if (!ctx.prefetch.posted) {
+        ctx.prefetch.posted = worker_post(prefetch_files, &ctx.prefetch);
+    }
+    if (ctx.prefetch.posted) {
+        ctx.prefetch.queue = list_append(ctx.prefetch.queue, file);
+        file = NULL;
+    }
+    pthread_mutex_unlock(&ctx.prefetch.lock);
+
+    if (file) {
+        free(file->source);
+        free(file);
+    }
+}
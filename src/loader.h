@@ -28,9 +28,29 @@ typedef enum loader_status (*image_decoder)(struct image* image,
                                             const uint8_t* data, size_t size);
 
 /**
- * Initialize background thread loader.
+ * Decode image from memory buffer without any post processing, can be used
+ * by decoders to handle embedded images (e.g. previews).
+ * @param image target image instance
+ * @param data raw image data
+ * @param size size of image data in bytes
+ * @return loader status
+ */
+enum loader_status loader_decode_embedded(struct image* image,
+                                          const uint8_t* data, size_t size);
+
+/**
+ * Parse meta info of the image that is deferred on loading (EXIF), so it is
+ * done only for images which meta info is really used (e.g. displayed).
+ * @param image target image instance
+ * @return true if meta info of the image was updated
+ */
+bool loader_load_meta(struct image* image);
+
+/**
+ * Initialize background loader.
+ * @param threads number of decoder threads, 0 to use online CPUs count
  */
-void loader_init(void);
+void loader_init(size_t threads);
 
 /**
  * Destroy background thread loader.
@@ -53,13 +73,96 @@ enum loader_status loader_from_source(const char* source, struct image** image);
  */
 enum loader_status loader_from_index(size_t index, struct image** image);
 
+/**
+ * Load image in the calling thread for batch processing, which runs its own
+ * worker threads: the progress is not reported and the decoder doesn't split
+ * the work across the thread pool.
+ * @param source image data source
+ * @param size_hint max size of the image to display, 0 for full quality
+ * @param cancel pointer to the cancellation flag
+ * @param image pointer to output image instance
+ * @return loading status
+ */
+enum loader_status loader_decode_source(const char* source, size_t size_hint,
+                                        const bool* cancel,
+                                        struct image** image);
+
 /**
  * Append image to background loader queue.
  * @param index index of the image in the image list
+ * @param priority load priority, images with lower value are loaded first
+ */
+void loader_queue_append(size_t index, size_t priority);
+
+/**
+ * Replace background loader queue with the list of images: decoding of
+ * images that are already in progress and present in the list is continued,
+ * the rest of active decoders are cancelled. Images that are completely
+ * decoded despite the cancellation are still delivered to be cached.
+ * @param indices indices of images to load, in order of priority
+ * @param num number of entries in the list
+ * @param foreground index of the displayed image, it is loaded at normal
+ * priority while the rest at background one, `IMGLIST_INVALID` if none
+ */
+void loader_queue_set(const size_t* indices, size_t num, size_t foreground);
+
+/**
+ * Enable decoding images into shared memory, such frames can be displayed
+ * without copying.
+ * @param enable flag to set
  */
-void loader_queue_append(size_t index);
+void loader_set_shared(bool enable);
 
 /**
- * Reset background loader queue.
+ * Set size hint for decoders: images can be reduced on decoding, but both
+ * sides stay not less than the hint.
+ * @param size min size of decoded images in pixels, 0 to decode in full size
+ */
+void loader_set_size_hint(size_t size);
+
+/**
+ * Handler of images loaded in background, it is called in the decoder thread
+ * before the image is passed to the application, so it can be transformed
+ * (e.g. reduced to a thumbnail) in parallel with other decoders.
+ * @param image loaded image
+ */
+typedef void (*loader_hook)(struct image* image);
+
+/**
+ * Set handler of images loaded in background.
+ * @param hook image handler, NULL to disable
+ */
+void loader_set_hook(loader_hook hook);
+
+/**
+ * Source of ready images for background loading, it is called in the decoder
+ * thread before decoding, so disk I/O of caches never blocks the main thread.
+ * @param source image source
+ * @return cached image or NULL to decode the source
+ */
+typedef struct image* (*loader_cache)(const char* source);
+
+/**
+ * Set source of ready images for background loading.
+ * @param cache cache handler, NULL to disable
+ */
+void loader_set_cache(loader_cache cache);
+
+/**
+ * Reset background loader queue, results of active decoders are dropped.
  */
 void loader_queue_reset(void);
+
+/**
+ * Get number of images waiting in the background loader queue.
+ * @return queue size
+ */
+size_t loader_queue_size(void);
+
+/**
+ * Ask kernel to read image file into the page cache in background, so the
+ * file is mapped without waiting for I/O when the image is decoded.
+ * The file is opened by the background worker, the call never blocks.
+ * @param index index of the image in the image list
+ */
+void loader_prefetch(size_t index);
@@ -4,10 +4,14 @@
 
 #include "application.h"
 #include "array.h"
+#include "batch.h"
 #include "buildcfg.h"
 #include "config.h"
 #include "imagelist.h"
+#include "instance.h"
 #include "loader.h"
+#include "perf.h"
+#include "trace.h"
 #include "viewer.h"
 
 #include <getopt.h>
@@ -26,18 +30,20 @@ struct cmdarg {
 
 // clang-format off
 static const struct cmdarg arguments[] = {
-    { 'g', "gallery",    NULL,    "start in gallery mode" },
-    { 'r', "recursive",  NULL,    "read directories recursively" },
-    { 'o', "order",      "ORDER", "set sort order for image list: none/alpha/numeric/mtime/size/random" },
-    { 's', "scale",      "SCALE", "set initial image scale: [optimal]/fit/width/height/fill/real" },
-    { 'l', "slideshow",  NULL,    "activate slideshow mode on startup" },
-    { 'p', "position",   "POS",   "set window position [parent]/X,Y" },
-    { 'w', "size",       "SIZE",  "set window size: fullscreen/[parent]/image/W,H" },
-    { 'f', "fullscreen", NULL,    "show image in full screen mode" },
-    { 'a', "class",      "NAME",  "set window class/app_id" },
-    { 'c', "config",     "S.K=V", "set configuration parameter: section.key=value" },
-    { 'v', "version",    NULL,    "print version info and exit" },
-    { 'h', "help",       NULL,    "print this help and exit" },
+    { 'g', "gallery",         NULL,    "start in gallery mode" },
+    { 'r', "recursive",       NULL,    "read directories recursively" },
+    { 'o', "order",           "ORDER", "set sort order for image list: none/alpha/numeric/mtime/size/random" },
+    { 's', "scale",           "SCALE", "set initial image scale: [optimal]/fit/width/height/fill/real" },
+    { 'l', "slideshow",       NULL,    "activate slideshow mode on startup" },
+    { 'p', "position",        "POS",   "set window position [parent]/X,Y" },
+    { 'w', "size",            "SIZE",  "set window size: fullscreen/[parent]/image/W,H" },
+    { 'f', "fullscreen",      NULL,    "show image in full screen mode" },
+    { 'a', "class",           "NAME",  "set window class/app_id" },
+    { 'c', "config",          "S.K=V", "set configuration parameter: section.key=value" },
+    { 't', "thumbnails",      NULL,    "generate gallery thumbnails and exit" },
+    { 'P', "profile-startup", NULL,    "print time spent in each startup phase" },
+    { 'v', "version",         NULL,    "print version info and exit" },
+    { 'h', "help",            NULL,    "print this help and exit" },
 };
 // clang-format on
 
@@ -61,7 +67,7 @@ static void print_help(void)
         } else {
             strncpy(lopt, arg->long_opt, sizeof(lopt) - 1);
         }
-        printf("  -%c, --%-14s %s\n", arg->short_opt, lopt, arg->help);
+        printf("  -%c, --%-15s %s\n", arg->short_opt, lopt, arg->help);
     }
 }
 
@@ -79,9 +85,13 @@ static void print_version(void)
  * Parse command line arguments.
  * @param argc number of arguments to parse
  * @param argv arguments array
+ * @param cfg config instance to fill
+ * @param batch output flag of batch mode (generate thumbnails without UI)
+ * @param profile output flag of startup profiling
  * @return index of the first non option argument
  */
-static int parse_cmdargs(int argc, char* argv[], struct config* cfg)
+static int parse_cmdargs(int argc, char* argv[], struct config* cfg,
+                         bool* batch, bool* profile)
 {
     struct option options[1 + ARRAY_SIZE(arguments)];
     char short_opts[ARRAY_SIZE(arguments) * 2];
@@ -140,6 +150,14 @@ static int parse_cmdargs(int argc, char* argv[], struct config* cfg)
                     exit(EXIT_FAILURE);
                 }
                 break;
+            case 't':
+                // thumbnails are generated for the persistent storage
+                config_set(cfg, CFG_GALLERY, CFG_GLRY_PSTORE, CFG_YES);
+                *batch = true;
+                break;
+            case 'P':
+                *profile = true;
+                break;
             case 'v':
                 print_version();
                 exit(EXIT_SUCCESS);
@@ -161,21 +179,39 @@ static int parse_cmdargs(int argc, char* argv[], struct config* cfg)
  */
 int main(int argc, char* argv[])
 {
+    const uint64_t start = perf_now();
     bool rc;
+    bool batch = false;
+    bool profile = false;
     struct config* cfg;
     int argn;
 
     setlocale(LC_ALL, "");
+    trace_init();
 
     cfg = config_load();
-    argn = parse_cmdargs(argc, argv, cfg);
-    rc = app_init(cfg, (const char**)&argv[argn], argc - argn);
-    config_free(cfg);
-
-    if (rc) {
-        rc = app_run();
-        app_destroy();
+    argn = parse_cmdargs(argc, argv, cfg, &batch, &profile);
+    if (profile) {
+        perf_startup_begin(start);
+        perf_startup("config");
     }
+    if (batch) {
+        rc = batch_thumbnails(cfg, (const char**)&argv[argn], argc - argn);
+        config_free(cfg);
+    } else if (config_get_bool(cfg, CFG_GENERAL, CFG_GNRL_SINGLE) &&
+               instance_forward((const char**)&argv[argn], argc - argn)) {
+        rc = true; // opened by the running instance
+        config_free(cfg);
+    } else {
+        rc = app_init(cfg, (const char**)&argv[argn], argc - argn);
+        config_free(cfg);
+        if (rc) {
+            rc = app_run();
+            app_destroy();
+        }
+    }
+
+    trace_destroy();
 
     return rc ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: MIT
+// Memory budget of cached images shared by viewer and gallery.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "memcache.h"
+
+#include "hashmap.h"
+#include "mempress.h"
+#include "pxalloc.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Cached image. */
+struct memcache_entry {
+    struct list list;        ///< Links to prev/next entry
+    struct image* image;     ///< Cached image
+    memcache_evict_fn evict; ///< Eviction handler
+    size_t size;             ///< Size of the image in bytes
+    double priority;         ///< Eviction priority, lower is evicted first
+};
+
+/** Global cache context. */
+struct memcache {
+    struct memcache_entry* entries; ///< Cached images
+    struct hashmap map;             ///< Entries by image address
+    struct memcache_entry* last;    ///< The most recently registered image
+    double age;                     ///< Priority of the last evicted image
+    struct memcache_stats stats;    ///< Cache statistics
+};
+
+static struct memcache ctx;
+
+/**
+ * Update eviction priority of the entry (GreedyDual-Size): images that were
+ * expensive to decode and take less memory are kept longer, the age of the
+ * cache makes recently used images more valuable than the old ones.
+ * @param entry cache entry
+ */
+static void update_priority(struct memcache_entry* entry)
+{
+    const double cost = entry->image->decode_time + 1;
+    const double kib = entry->size / 1024 + 1;
+    entry->priority = ctx.age + cost / kib;
+}
+
+/**
+ * Find entry of the image.
+ * @param image cached image
+ * @return cache entry or NULL if image is not registered
+ */
+static struct memcache_entry* find_entry(const struct image* image)
+{
+    return hashmap_get(&ctx.map, (uintptr_t)image);
+}
+
+/**
+ * Remove entry from the cache.
+ * @param entry cache entry
+ */
+static void remove_entry(struct memcache_entry* entry)
+{
+    ctx.stats.used -= entry->size;
+    --ctx.stats.entries;
+    if (ctx.last == entry) {
+        ctx.last = NULL;
+    }
+    ctx.entries = list_unlink(ctx.entries, entry);
+    hashmap_remove(&ctx.map, (uintptr_t)entry->image);
+    free(entry);
+}
+
+void memcache_init(size_t limit)
+{
+    ctx.stats.limit = limit;
+}
+
+void memcache_destroy(void)
+{
+    list_for_each(ctx.entries, struct memcache_entry, it) {
+        free(it);
+    }
+    hashmap_free(&ctx.map);
+    memset(&ctx, 0, sizeof(ctx));
+}
+
+void memcache_put(struct image* image, memcache_evict_fn evict)
+{
+    struct memcache_entry* entry = find_entry(image);
+
+    if (entry) {
+        ctx.stats.used -= entry->size;
+    } else {
+        entry = calloc(1, sizeof(*entry));
+        if (!entry) {
+            return;
+        }
+        if (!hashmap_put(&ctx.map, (uintptr_t)image, entry)) {
+            free(entry);
+            return;
+        }
+        entry->image = image;
+        ctx.entries = list_add(ctx.entries, entry);
+        ++ctx.stats.entries;
+    }
+
+    entry->evict = evict;
+    entry->size = image_memory(image);
+    ctx.stats.used += entry->size;
+    update_priority(entry);
+    ctx.last = entry;
+}
+
+void memcache_remove(struct image* image)
+{
+    struct memcache_entry* entry = find_entry(image);
+    if (entry) {
+        remove_entry(entry);
+    }
+}
+
+void memcache_touch(struct image* image)
+{
+    struct memcache_entry* entry = find_entry(image);
+    if (entry) {
+        update_priority(entry);
+    }
+}
+
+void memcache_account(bool hit)
+{
+    if (hit) {
+        ++ctx.stats.hits;
+    } else {
+        ++ctx.stats.misses;
+    }
+}
+
+/**
+ * Evict images until the total size fits into the specified size.
+ * @param target max size of cached images in bytes
+ * @param pressure eviction is caused by memory pressure
+ */
+static void evict_to(size_t target, bool pressure)
+{
+    while (ctx.stats.used > target) {
+        struct memcache_entry* victim = NULL;
+        struct image* image;
+        memcache_evict_fn evict;
+
+        list_for_each(ctx.entries, struct memcache_entry, it) {
+            if (it != ctx.last &&
+                (!victim || it->priority < victim->priority)) {
+                victim = it;
+            }
+        }
+        if (!victim) {
+            break; // the only image doesn't fit into the budget
+        }
+
+        ctx.age = victim->priority;
+        ++ctx.stats.evictions;
+
+        image = victim->image;
+        evict = victim->evict;
+        remove_entry(victim);
+        evict(image, pressure);
+    }
+}
+
+void memcache_shrink(size_t size)
+{
+    ++ctx.stats.shrinks;
+    evict_to(ctx.stats.used > size ? ctx.stats.used - size : 0, true);
+    pxalloc_trim(); // return freed pixel buffers to the system
+}
+
+void memcache_trim(void)
+{
+    const size_t excess = mempress_excess();
+
+    if (ctx.stats.limit) {
+        evict_to(ctx.stats.limit, false);
+    }
+    if (excess) {
+        // cgroup memory limit is close
+        memcache_shrink(excess);
+    }
+}
+
+void memcache_stats(struct memcache_stats* stats)
+{
+    *stats = ctx.stats;
+}
@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: MIT
+// Memory budget of cached images shared by viewer and gallery.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include "image.h"
+
+/**
+ * Eviction handler: remove the image from the owner's cache and free it.
+ * @param image image to evict
+ * @param pressure eviction is caused by memory pressure, the image must be
+ *        freed instead of moving it to another cache
+ */
+typedef void (*memcache_evict_fn)(struct image* image, bool pressure);
+
+/** Cache statistics. */
+struct memcache_stats {
+    size_t limit;     ///< Memory budget in bytes, 0 if unlimited
+    size_t used;      ///< Size of cached images in bytes
+    size_t entries;   ///< Number of cached images
+    size_t hits;      ///< Number of requests served from cache
+    size_t misses;    ///< Number of requests that required decoding
+    size_t evictions; ///< Number of images evicted to fit the budget
+    size_t shrinks;   ///< Number of shrinks caused by memory pressure
+};
+
+/**
+ * Initialize global cache context.
+ * @param limit memory budget in bytes, 0 for unlimited
+ */
+void memcache_init(size_t limit);
+
+/**
+ * Destroy global cache context, cached images are not freed.
+ */
+void memcache_destroy(void);
+
+/**
+ * Register image stored in a cache.
+ * @param image cached image
+ * @param evict handler used to evict the image from its owner
+ */
+void memcache_put(struct image* image, memcache_evict_fn evict);
+
+/**
+ * Unregister image taken out of the cache by its owner.
+ * @param image cached image, ignored if it is not registered
+ */
+void memcache_remove(struct image* image);
+
+/**
+ * Mark cached image as recently used.
+ * @param image cached image, ignored if it is not registered
+ */
+void memcache_touch(struct image* image);
+
+/**
+ * Account cache request in statistics.
+ * @param hit true if the requested image was found in cache
+ */
+void memcache_account(bool hit);
+
+/**
+ * Evict images until the total size fits into the budget. The most
+ * cost-effective images are kept: the priority of an image grows with its
+ * decoding time and falls with its size and time since the last use.
+ * The most recently registered image is never evicted.
+ * If the cgroup memory limit is close, images are evicted with
+ * `memcache_shrink` even if they fit into the budget.
+ * Owners must not hold pointers to evictable images during the call.
+ */
+void memcache_trim(void);
+
+/**
+ * Release memory on pressure: images are evicted in the same order as in
+ * `memcache_trim` until the specified amount of memory is freed, then freed
+ * pixel buffers are returned to the system.
+ * Owners must not hold pointers to evictable images during the call.
+ * @param size amount of memory to free in bytes
+ */
+void memcache_shrink(size_t size);
+
+/**
+ * Get cache statistics.
+ * @param stats output statistics
+ */
+void memcache_stats(struct memcache_stats* stats);
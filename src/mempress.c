@@ -0,0 +1,235 @@
+// SPDX-License-Identifier: MIT
+// Memory pressure monitor.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "mempress.h"
+
+#include "perf.h"
+#include "pixmap.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Mount point of the unified cgroup hierarchy
+#define CGROUP_ROOT "/sys/fs/cgroup"
+// System-wide PSI file
+#define PSI_SYSTEM "/proc/pressure/memory"
+
+// PSI trigger: total stall time (us) within a time window (us), window must
+// be a multiple of 2 seconds for unprivileged users
+#define PSI_STALL  150000
+#define PSI_WINDOW 2000000
+
+// Safe part of the cgroup limit: numerator and denominator
+#define SAFE_NUM 3
+#define SAFE_DEN 4
+
+// Min interval between reads of the cgroup usage in microseconds
+#define CHECK_INTERVAL 500000
+
+/** Memory pressure monitor context. */
+struct mempress {
+    int trigger;    ///< PSI trigger, -1 if not available
+    int cgroup;     ///< Directory of the process cgroup, -1 if not available
+    size_t limit;   ///< Memory limit of the cgroup, SIZE_MAX if not set
+    uint64_t check; ///< Time of the last usage read, see `perf_now`
+    size_t excess;  ///< Excess at the time of the last read
+};
+
+static struct mempress ctx = { .trigger = -1, .cgroup = -1, .limit = SIZE_MAX };
+
+/**
+ * Read text file from the cgroup directory.
+ * @param name file name
+ * @param buf destination buffer
+ * @param size size of the buffer
+ * @return false if file can't be read
+ */
+static bool read_cgroup(const char* name, char* buf, size_t size)
+{
+    ssize_t len;
+    int fd;
+
+    fd = openat(ctx.cgroup, name, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    len = read(fd, buf, size - 1);
+    close(fd);
+    if (len <= 0) {
+        return false;
+    }
+    buf[len] = 0;
+
+    return true;
+}
+
+/**
+ * Get memory limit of the cgroup.
+ * @param name limit file name
+ * @return limit in bytes, SIZE_MAX if the limit is not set
+ */
+static size_t get_limit(const char* name)
+{
+    char buf[32];
+    char* end;
+    unsigned long long val;
+
+    if (!read_cgroup(name, buf, sizeof(buf))) {
+        return SIZE_MAX;
+    }
+    val = strtoull(buf, &end, 10);
+    if (end == buf || val > SIZE_MAX) {
+        return SIZE_MAX; // "max"
+    }
+
+    return val;
+}
+
+/**
+ * Get value of the field in the memory.stat file.
+ * @param stat content of the file
+ * @param key field name
+ * @return field value, 0 if not found
+ */
+static size_t get_stat(const char* stat, const char* key)
+{
+    const size_t key_len = strlen(key);
+
+    while (stat) {
+        if (strncmp(stat, key, key_len) == 0 && stat[key_len] == ' ') {
+            return strtoull(stat + key_len + 1, NULL, 10);
+        }
+        stat = strchr(stat, '\n');
+        if (stat) {
+            ++stat;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Open directory of the process cgroup (unified hierarchy only).
+ * @return directory file descriptor or -1 if not available
+ */
+static int open_cgroup(void)
+{
+    char path[PATH_MAX];
+    char line[PATH_MAX];
+    size_t len;
+    FILE* fd;
+    int dir = -1;
+
+    fd = fopen("/proc/self/cgroup", "r");
+    if (!fd) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fd)) {
+        if (strncmp(line, "0::", 3) == 0) {
+            len = strlen(line);
+            if (len && line[len - 1] == '\n') {
+                line[len - 1] = 0;
+            }
+            if (snprintf(path, sizeof(path), CGROUP_ROOT "%s", line + 3) <
+                (int)sizeof(path)) {
+                dir = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            }
+            break;
+        }
+    }
+    fclose(fd);
+
+    return dir;
+}
+
+/**
+ * Register PSI trigger.
+ * @param dir directory of the PSI file, -1 for the absolute path
+ * @param path path to the PSI file
+ * @return trigger file descriptor or -1 on errors
+ */
+static int create_trigger(int dir, const char* path)
+{
+    char trigger[64];
+    int fd;
+
+    fd = openat(dir, path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+
+    snprintf(trigger, sizeof(trigger), "some %d %d", PSI_STALL, PSI_WINDOW);
+    if (write(fd, trigger, strlen(trigger) + 1) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int mempress_init(void)
+{
+    int fd = -1;
+
+    ctx.cgroup = open_cgroup();
+    if (ctx.cgroup != -1) {
+        ctx.limit = min(get_limit("memory.high"), get_limit("memory.max"));
+        fd = create_trigger(ctx.cgroup, "memory.pressure");
+    }
+    if (fd == -1) {
+        fd = create_trigger(AT_FDCWD, PSI_SYSTEM);
+    }
+    ctx.trigger = fd;
+
+    return fd;
+}
+
+void mempress_destroy(void)
+{
+    if (ctx.trigger != -1) {
+        close(ctx.trigger);
+        ctx.trigger = -1;
+    }
+    if (ctx.cgroup != -1) {
+        close(ctx.cgroup);
+        ctx.cgroup = -1;
+    }
+    ctx.limit = SIZE_MAX;
+    ctx.check = 0;
+    ctx.excess = 0;
+}
+
+size_t mempress_excess(void)
+{
+    const uint64_t now = perf_now();
+    char stat[4096];
+    size_t used, safe;
+
+    if (ctx.cgroup == -1 || ctx.limit == SIZE_MAX) {
+        return 0;
+    }
+
+    // the function is called on each cache update, the usage is read
+    // not more often than once per interval
+    if (ctx.check && now - ctx.check < CHECK_INTERVAL) {
+        return ctx.excess;
+    }
+    ctx.check = now;
+    ctx.excess = 0;
+
+    if (read_cgroup("memory.stat", stat, sizeof(stat))) {
+        used = get_stat(stat, "anon") + get_stat(stat, "shmem");
+        safe = ctx.limit / SAFE_DEN * SAFE_NUM;
+        if (used > safe) {
+            ctx.excess = used - safe;
+        }
+    }
+
+    return ctx.excess;
+}
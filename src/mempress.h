@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: MIT
+// Memory pressure monitor.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Initialize memory pressure monitor: PSI trigger is registered for the
+ * cgroup of the process (or for the whole system if cgroup doesn't provide
+ * PSI) and the cgroup memory limit is read.
+ * @return trigger file descriptor to poll for POLLPRI (it is always readable,
+ *         so POLLIN must not be polled), -1 if PSI is not available
+ */
+int mempress_init(void);
+
+/**
+ * Free resources and close the trigger file descriptor.
+ */
+void mempress_destroy(void);
+
+/**
+ * Get amount of memory above the safe part of the cgroup limit: anonymous and
+ * shared memory (that can't be reclaimed without swap) is compared with 3/4
+ * of the lowest of `memory.high` and `memory.max` read on initialization.
+ * The usage is read at most twice a second, the last value is returned in
+ * between.
+ * @return excess in bytes, 0 if limit is not set or not reached
+ */
+size_t mempress_excess(void);
@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: MIT
+// Performance counters collected at runtime.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "perf.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/** Performance counters context. */
+struct perf_context {
+    pthread_mutex_t lock;                    ///< Decoding counters lock
+    struct perf_decode decode[PERF_FORMATS]; ///< Decoding time per format
+    size_t decode_num;                       ///< Number of formats
+    size_t decode_next;                      ///< Slot to reuse for new format
+
+    // the rest is accessed from the main thread only
+    uint64_t scale_time;   ///< Last scale time (us)
+    enum aa_mode scale_aa; ///< Last used scaler
+    uint64_t frame_sum;    ///< Total time of frames in current period (us)
+    uint64_t frame_max;    ///< Max frame time in current period (us)
+    size_t frames;         ///< Number of frames in current period
+    uint64_t period;       ///< Start time of current period (us)
+    size_t preload_hits;   ///< Images found in preload
+    size_t preload_misses; ///< Images not preloaded
+
+    // startup profile
+    bool startup;                      ///< Startup profiling is active
+    uint64_t startup_begin;            ///< Start time of the application
+    uint64_t startup_last;             ///< End time of the last phase
+    const char* phases[PERF_PHASES];   ///< Names of completed phases
+    uint64_t phases_time[PERF_PHASES]; ///< Duration of completed phases
+    size_t phases_num;                 ///< Number of completed phases
+};
+
+/** Global performance counters. */
+static struct perf_context ctx = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+uint64_t perf_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void perf_decode(const char* format, size_t time)
+{
+    struct perf_decode* entry = NULL;
+
+    pthread_mutex_lock(&ctx.lock);
+
+    for (size_t i = 0; i < ctx.decode_num; ++i) {
+        if (strcmp(ctx.decode[i].format, format) == 0) {
+            entry = &ctx.decode[i];
+            break;
+        }
+    }
+    if (!entry) {
+        if (ctx.decode_num < PERF_FORMATS) {
+            entry = &ctx.decode[ctx.decode_num++];
+        } else {
+            // replace the oldest format
+            entry = &ctx.decode[ctx.decode_next];
+            ctx.decode_next = (ctx.decode_next + 1) % PERF_FORMATS;
+        }
+        strncpy(entry->format, format, sizeof(entry->format) - 1);
+        entry->format[sizeof(entry->format) - 1] = 0;
+    }
+    entry->time = time;
+
+    pthread_mutex_unlock(&ctx.lock);
+}
+
+void perf_scale(enum aa_mode aa, uint64_t start)
+{
+    ctx.scale_time = perf_now() - start;
+    ctx.scale_aa = aa;
+}
+
+/**
+ * Add completed startup phase.
+ * @param phase name of the phase
+ */
+static void add_phase(const char* phase)
+{
+    const uint64_t now = perf_now();
+
+    if (ctx.phases_num < PERF_PHASES) {
+        ctx.phases[ctx.phases_num] = phase;
+        ctx.phases_time[ctx.phases_num] = now - ctx.startup_last;
+        ++ctx.phases_num;
+    }
+    ctx.startup_last = now;
+}
+
+/**
+ * Print startup profile report.
+ */
+static void print_startup(void)
+{
+    fprintf(stderr, "Startup profile:\n");
+    for (size_t i = 0; i < ctx.phases_num; ++i) {
+        const uint64_t time = ctx.phases_time[i];
+        fprintf(stderr, "  %-14s %4" PRIu64 ".%03" PRIu64 " ms\n",
+                ctx.phases[i], time / 1000, time % 1000);
+    }
+    fprintf(stderr, "  %-14s %4" PRIu64 ".%03" PRIu64 " ms\n", "total",
+            (ctx.startup_last - ctx.startup_begin) / 1000,
+            (ctx.startup_last - ctx.startup_begin) % 1000);
+}
+
+void perf_frame(uint64_t start)
+{
+    const uint64_t time = perf_now() - start;
+
+    if (ctx.startup) {
+        add_phase("first frame");
+        print_startup();
+        ctx.startup = false;
+    }
+
+    ctx.frame_sum += time;
+    ++ctx.frames;
+    if (ctx.frame_max < time) {
+        ctx.frame_max = time;
+    }
+}
+
+void perf_preload(bool hit)
+{
+    if (hit) {
+        ++ctx.preload_hits;
+    } else {
+        ++ctx.preload_misses;
+    }
+}
+
+void perf_collect(struct perf_stats* stats)
+{
+    const uint64_t now = perf_now();
+
+    pthread_mutex_lock(&ctx.lock);
+    memcpy(stats->decode, ctx.decode, sizeof(stats->decode));
+    stats->decode_num = ctx.decode_num;
+    pthread_mutex_unlock(&ctx.lock);
+
+    stats->scale_time = ctx.scale_time;
+    stats->scale_aa = ctx.scale_aa;
+    stats->frame_avg = ctx.frames ? ctx.frame_sum / ctx.frames : 0;
+    stats->frame_max = ctx.frame_max;
+    stats->frames = ctx.frames;
+    stats->period = ctx.period ? now - ctx.period : 0;
+    stats->preload_hits = ctx.preload_hits;
+    stats->preload_misses = ctx.preload_misses;
+
+    // start new period
+    ctx.frame_sum = 0;
+    ctx.frame_max = 0;
+    ctx.frames = 0;
+    ctx.period = now;
+}
+
+void perf_startup_begin(uint64_t start)
+{
+    ctx.startup = true;
+    ctx.startup_begin = start;
+    ctx.startup_last = start;
+    ctx.phases_num = 0;
+}
+
+void perf_startup(const char* phase)
+{
+    if (ctx.startup) {
+        add_phase(phase);
+    }
+}
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: MIT
+// Performance counters collected at runtime.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include "pixmap_scale.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Max number of image formats with tracked decoding time
+#define PERF_FORMATS 8
+// Max number of tracked startup phases
+#define PERF_PHASES 16
+
+/** Decoding time of an image format. */
+struct perf_decode {
+    char format[16]; ///< Format name
+    size_t time;     ///< Last decoding time in milliseconds
+};
+
+/** Snapshot of performance counters. */
+struct perf_stats {
+    struct perf_decode decode[PERF_FORMATS]; ///< Decoding time per format
+    size_t decode_num;                       ///< Number of formats
+    uint64_t scale_time;                     ///< Last scale time (us)
+    enum aa_mode scale_aa;                   ///< Last used scaler
+    uint64_t frame_avg;                      ///< Average frame time (us)
+    uint64_t frame_max;                      ///< Max frame time (us)
+    size_t frames;                           ///< Number of frames drawn
+    uint64_t period;                         ///< Time since last snapshot (us)
+    size_t preload_hits;                     ///< Images found in preload
+    size_t preload_misses;                   ///< Images not preloaded
+};
+
+/**
+ * Get current time, used as start point of measured operation.
+ * @return monotonic time in microseconds
+ */
+uint64_t perf_now(void);
+
+/**
+ * Account image decoding, can be called from any thread.
+ * @param format image format name
+ * @param time decoding time in milliseconds
+ */
+void perf_decode(const char* format, size_t time);
+
+/**
+ * Account image scaling, called from the main thread.
+ * @param aa used scaler
+ * @param start start time of the operation, see `perf_now`
+ */
+void perf_scale(enum aa_mode aa, uint64_t start);
+
+/**
+ * Account window frame drawing, called from the main thread.
+ * @param start start time of the operation, see `perf_now`
+ */
+void perf_frame(uint64_t start);
+
+/**
+ * Account request to the image preloader, called from the main thread.
+ * @param hit true if the requested image was already preloaded
+ */
+void perf_preload(bool hit);
+
+/**
+ * Get performance counters, called from the main thread.
+ * Frame time statistics are reset after this call.
+ * @param stats output snapshot of counters
+ */
+void perf_collect(struct perf_stats* stats);
+
+/**
+ * Start profiling of the application startup, the report with time spent in
+ * each phase is printed to stderr after the first frame is drawn.
+ * @param start start time of the application, see `perf_now`
+ */
+void perf_startup_begin(uint64_t start);
+
+/**
+ * Mark completion of the startup phase, called from the main thread.
+ * Does nothing if startup profiling is not active.
+ * @param phase name of the completed phase (static string)
+ */
+void perf_startup(const char* phase);
@@ -0,0 +1,205 @@
+// SPDX-License-Identifier: MIT
+// Conversion of raw pixel rows to ARGB.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "pixconv.h"
+
+#include "tpool.h"
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86
+#endif
+
+// Min number of pixels converted by a single thread
+#define TASK_MIN_PIXELS (128 * 1024)
+
+/** Conversion task. */
+struct pixconv_task {
+    struct pixmap* pm;  ///< Destination pixmap
+    const uint8_t* src; ///< Raw row of the top line
+    ssize_t stride;     ///< Offset between raw rows in bytes
+    pixconv_fn fn;      ///< Row converter
+};
+
+#ifdef SIMD_X86
+/**
+ * Shuffle 24-bit pixels to opaque ARGB.
+ * @param dst destination pixels
+ * @param src source raw pixels
+ * @param num number of pixels to convert
+ * @param mask shuffle mask for 4 pixels, alpha positions must be zeroed
+ * @return number of converted pixels
+ */
+__attribute__((target("ssse3"))) static size_t
+ssse3_shuffle24(argb_t* dst, const uint8_t* src, size_t num, __m128i mask)
+{
+    const __m128i alpha = _mm_set1_epi32(ARGB_SET_A(0xff));
+    size_t i = 0;
+
+    // 16 bytes are loaded for each 4 pixels (12 bytes)
+    for (; i + 6 <= num; i += 4) {
+        const __m128i px = _mm_loadu_si128((const __m128i*)(src + i * 3));
+        _mm_storeu_si128((__m128i*)(dst + i),
+                         _mm_or_si128(_mm_shuffle_epi8(px, mask), alpha));
+    }
+
+    return i;
+}
+#endif
+
+void pixconv_rgb24(argb_t* dst, const uint8_t* src, size_t num)
+{
+    size_t i = 0;
+
+#ifdef SIMD_X86
+    if (__builtin_cpu_supports("ssse3")) {
+        const __m128i mask = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6,
+                                           -1, 11, 10, 9, -1);
+        i = ssse3_shuffle24(dst, src, num, mask);
+    }
+#endif
+
+    for (; i < num; ++i) {
+        const uint8_t* px = src + i * 3;
+        dst[i] = ARGB(0xff, px[0], px[1], px[2]);
+    }
+}
+
+void pixconv_bgr24(argb_t* dst, const uint8_t* src, size_t num)
+{
+    size_t i = 0;
+
+#ifdef SIMD_X86
+    if (__builtin_cpu_supports("ssse3")) {
+        const __m128i mask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8,
+                                           -1, 9, 10, 11, -1);
+        i = ssse3_shuffle24(dst, src, num, mask);
+    }
+#endif
+
+    for (; i < num; ++i) {
+        const uint8_t* px = src + i * 3;
+        dst[i] = ARGB(0xff, px[2], px[1], px[0]);
+    }
+}
+
+void pixconv_bgrx32(argb_t* dst, const uint8_t* src, size_t num)
+{
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i alpha = _mm_set1_epi32(ARGB_SET_A(0xff));
+    for (; i + 4 <= num; i += 4) {
+        const __m128i px = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(px, alpha));
+    }
+#endif
+
+    for (; i < num; ++i) {
+        const uint8_t* px = src + i * 4;
+        dst[i] = ARGB(0xff, px[2], px[1], px[0]);
+    }
+}
+
+void pixconv_bgra32(argb_t* dst, const uint8_t* src, size_t num)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // the same layout as ARGB in memory
+    memcpy(dst, src, num * sizeof(argb_t));
+#else
+    for (size_t i = 0; i < num; ++i) {
+        const uint8_t* px = src + i * 4;
+        dst[i] = ARGB(px[3], px[2], px[1], px[0]);
+    }
+#endif
+}
+
+void pixconv_rgba64be(argb_t* dst, const uint8_t* src, size_t num)
+{
+    size_t i = 0;
+
+#ifdef __SSE2__
+    // high bytes of big-endian channels are the low ones of loaded words
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    for (; i + 4 <= num; i += 4) {
+        const __m128i* ptr = (const __m128i*)(src + i * 8);
+        __m128i px0 = _mm_and_si128(_mm_loadu_si128(ptr), mask);
+        __m128i px1 = _mm_and_si128(_mm_loadu_si128(ptr + 1), mask);
+        // RGBA -> BGRA
+        px0 = _mm_shufflelo_epi16(px0, _MM_SHUFFLE(3, 0, 1, 2));
+        px0 = _mm_shufflehi_epi16(px0, _MM_SHUFFLE(3, 0, 1, 2));
+        px1 = _mm_shufflelo_epi16(px1, _MM_SHUFFLE(3, 0, 1, 2));
+        px1 = _mm_shufflehi_epi16(px1, _MM_SHUFFLE(3, 0, 1, 2));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(px0, px1));
+    }
+#endif
+
+    for (; i < num; ++i) {
+        const uint8_t* px = src + i * 8;
+        dst[i] = ARGB(px[6], px[0], px[2], px[4]);
+    }
+}
+
+void pixconv_gray8(argb_t* dst, const uint8_t* src, size_t num)
+{
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i alpha = _mm_set1_epi8((char)0xff);
+    for (; i + 16 <= num; i += 16) {
+        const __m128i px = _mm_loadu_si128((const __m128i*)(src + i));
+        const __m128i gg_lo = _mm_unpacklo_epi8(px, px);
+        const __m128i ga_lo = _mm_unpacklo_epi8(px, alpha);
+        const __m128i gg_hi = _mm_unpackhi_epi8(px, px);
+        const __m128i ga_hi = _mm_unpackhi_epi8(px, alpha);
+        __m128i* out = (__m128i*)(dst + i);
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(gg_lo, ga_lo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(gg_lo, ga_lo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(gg_hi, ga_hi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(gg_hi, ga_hi));
+    }
+#endif
+
+    for (; i < num; ++i) {
+        dst[i] = ARGB(0xff, src[i], src[i], src[i]);
+    }
+}
+
+static void convert_rows(void* data, size_t low, size_t high)
+{
+    const struct pixconv_task* task = data;
+    const size_t width = task->pm->width;
+
+    for (size_t y = low; y < high; ++y) {
+        task->fn(&task->pm->data[y * width],
+                 task->src + (ssize_t)y * task->stride, width);
+    }
+}
+
+void pixconv_image(const struct image* ctx, const uint8_t* src,
+                   ssize_t stride, pixconv_fn fn)
+{
+    struct pixmap* pm = &ctx->frames[0].pm;
+    struct pixconv_task task = {
+        .pm = pm,
+        .src = src,
+        .stride = stride,
+        .fn = fn,
+    };
+
+    if (image_threads(ctx) > 1) {
+        const size_t min_rows = max(1, TASK_MIN_PIXELS / pm->width);
+        tpool_run(convert_rows, &task, pm->height, min_rows);
+    } else {
+        for (size_t y = 0; y < pm->height; ++y) {
+            convert_rows(&task, y, y + 1);
+            image_progress(ctx, y + 1);
+        }
+    }
+}
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: MIT
+// Conversion of raw pixel rows to ARGB.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include "image.h"
+
+/**
+ * Row converter: translate raw pixels to ARGB.
+ * @param dst destination pixels
+ * @param src source raw pixels
+ * @param num number of pixels to convert
+ */
+typedef void (*pixconv_fn)(argb_t* dst, const uint8_t* src, size_t num);
+
+/** 24-bit RGB (R, G, B bytes) to opaque ARGB. */
+void pixconv_rgb24(argb_t* dst, const uint8_t* src, size_t num);
+
+/** 24-bit BGR (B, G, R bytes) to opaque ARGB. */
+void pixconv_bgr24(argb_t* dst, const uint8_t* src, size_t num);
+
+/** 32-bit BGRX (B, G, R, unused bytes) to opaque ARGB. */
+void pixconv_bgrx32(argb_t* dst, const uint8_t* src, size_t num);
+
+/** 32-bit BGRA (B, G, R, A bytes) to ARGB. */
+void pixconv_bgra32(argb_t* dst, const uint8_t* src, size_t num);
+
+/** 64-bit big-endian RGBA (16 bits per channel) to ARGB. */
+void pixconv_rgba64be(argb_t* dst, const uint8_t* src, size_t num);
+
+/** 8-bit grayscale to opaque ARGB. */
+void pixconv_gray8(argb_t* dst, const uint8_t* src, size_t num);
+
+/**
+ * Convert raw image to the first frame of the image.
+ * If the decoder may use several threads, the image is split into bands of
+ * rows converted in parallel, otherwise rows are converted one by one from top
+ * to bottom with progress reporting.
+ * @param ctx image context with allocated frame
+ * @param src pointer to the raw row that becomes the top one
+ * @param stride offset between raw rows in bytes, negative for bottom-up
+ * @param fn row converter
+ */
+void pixconv_image(const struct image* ctx, const uint8_t* src,
+                   ssize_t stride, pixconv_fn fn);
@@ -5,25 +5,41 @@
 #include "pixmap.h"
 
 #include "array.h"
+#include "pixconv.h"
 #include "pixmap_ablend.h"
+#include "pxalloc.h"
+#include "tpool.h"
 
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Size of the square block used for rotation (px)
+#define ROTATE_BLOCK 64
+
 bool pixmap_create(struct pixmap* pm, size_t width, size_t height)
 {
-    argb_t* data = calloc(1, height * width * sizeof(argb_t));
+    argb_t* data = pxalloc(height * width * sizeof(argb_t), true);
     if (data) {
         pm->width = width;
         pm->height = height;
         pm->data = data;
+        pm->format = pixfmt_argb;
     }
     return !!data;
 }
 
 void pixmap_free(struct pixmap* pm)
 {
-    free(pm->data);
+    pxfree(pm->data);
+}
+
+size_t pixmap_bpp(enum pixmap_format format)
+{
+    return format == pixfmt_gray8 ? 1 : sizeof(argb_t);
 }
 
 void pixmap_fill(struct pixmap* pm, ssize_t x, ssize_t y, size_t width,
@@ -82,11 +98,12 @@ void pixmap_blend(struct pixmap* pm, ssize_t x, ssize_t y, size_t width,
     const ssize_t right = min((ssize_t)pm->width, x + (ssize_t)width);
     const ssize_t bottom = min((ssize_t)pm->height, y + (ssize_t)height);
 
+    if (right <= left) {
+        return;
+    }
+
     for (y = top; y < bottom; ++y) {
-        argb_t* line = &pm->data[y * pm->width];
-        for (x = left; x < right; ++x) {
-            alpha_blend(color, &line[x]);
-        }
+        alpha_blend_fill(color, &pm->data[y * pm->width + left], right - left);
     }
 }
 
@@ -96,9 +113,9 @@ void pixmap_hline(struct pixmap* pm, ssize_t x, ssize_t y, size_t width,
     if (y >= 0 && y < (ssize_t)pm->height) {
         const ssize_t begin = max(0, x);
         const ssize_t end = min((ssize_t)pm->width, x + (ssize_t)width);
-        const size_t offset = y * pm->width;
-        for (ssize_t i = begin; i < end; ++i) {
-            alpha_blend(color, &pm->data[offset + i]);
+        if (begin < end) {
+            alpha_blend_fill(color, &pm->data[y * pm->width + begin],
+                             end - begin);
         }
     }
 }
@@ -135,26 +152,30 @@ void pixmap_grid(struct pixmap* pm, ssize_t x, ssize_t y, size_t width,
     const ssize_t grid_width = right - left;
     const ssize_t grid_height = bottom - top;
 
+    // pattern is aligned to the grid origin, not to the visible part
+    const size_t delta_x = left - x;
+    const size_t delta_y = top - y;
+
     const size_t template_sz = grid_width * sizeof(argb_t);
-    argb_t* templates[] = { &pm->data[top * pm->width + left],
-                            &pm->data[(top + tail_sz) * pm->width + left] };
+    argb_t* templates[] = { NULL, NULL };
 
     if (right < 0 || bottom < 0 || grid_width <= 0 || grid_height <= 0) {
         return;
     }
 
     for (y = 0; y < grid_height; ++y) {
-        const size_t shift = (y / tail_sz) % 2;
+        const size_t shift = ((y + delta_y) / tail_sz) % 2;
         argb_t* line = &pm->data[(y + top) * pm->width + left];
-        if (line != templates[0] && line != templates[1]) {
+        if (templates[shift]) {
             // put template line
             memcpy(line, templates[shift], template_sz);
         } else {
             // compose template line
             for (x = 0; x < grid_width; ++x) {
-                const size_t tail = x / tail_sz;
+                const size_t tail = (x + delta_x) / tail_sz;
                 line[x] = (tail % 2) ^ shift ? color1 : color2;
             }
+            templates[shift] = line;
         }
     }
 }
@@ -171,20 +192,15 @@ void pixmap_apply_mask(struct pixmap* pm, ssize_t x, ssize_t y,
     const ssize_t delta_x = left - x;
     const ssize_t delta_y = top - y;
 
+    if (dst_width <= 0) {
+        return; // out of destination
+    }
+
     for (ssize_t dst_y = top; dst_y < bottom; ++dst_y) {
         const size_t src_y = dst_y - top + delta_y;
         const uint8_t* mask_line = &mask[src_y * width + delta_x];
         argb_t* dst_line = &pm->data[dst_y * pm->width + left];
-
-        for (x = 0; x < dst_width; ++x) {
-            const uint8_t alpha_mask = mask_line[x];
-            if (alpha_mask != 0) {
-                const uint8_t alpha_color = ARGB_GET_A(color);
-                const uint8_t alpha = (alpha_mask * alpha_color) / 255;
-                const argb_t clr = ARGB_SET_A(alpha) | (color & 0x00ffffff);
-                alpha_blend(clr, &dst_line[x]);
-            }
-        }
+        alpha_blend_mask(color, mask_line, dst_line, dst_width);
     }
 }
 
@@ -200,21 +216,127 @@ void pixmap_copy(const struct pixmap* src, struct pixmap* dst, ssize_t x,
     const ssize_t delta_y = top - y;
     const size_t line_sz = dst_width * sizeof(argb_t);
 
+    if (dst_width <= 0) {
+        return; // out of destination
+    }
+
+    if (src->format == pixfmt_gray8) {
+        // always opaque, expand pixels right into the destination
+        const uint8_t* gray = (const uint8_t*)src->data;
+        for (ssize_t dst_y = top; dst_y < bottom; ++dst_y) {
+            const size_t src_y = dst_y - top + delta_y;
+            pixconv_gray8(&dst->data[dst_y * dst->width + left],
+                          &gray[src_y * src->width + delta_x], dst_width);
+        }
+        return;
+    }
+
     for (ssize_t dst_y = top; dst_y < bottom; ++dst_y) {
         const size_t src_y = dst_y - top + delta_y;
         const argb_t* src_line = &src->data[src_y * src->width + delta_x];
         argb_t* dst_line = &dst->data[dst_y * dst->width + left];
 
         if (alpha) {
-            for (x = 0; x < dst_width; ++x) {
-                alpha_blend(src_line[x], &dst_line[x]);
-            }
+            alpha_blend_span(src_line, dst_line, dst_width);
         } else {
             memcpy(dst_line, src_line, line_sz);
         }
     }
 }
 
+bool pixmap_compact(struct pixmap* pm)
+{
+    const size_t total = pm->width * pm->height;
+    uint8_t* gray;
+
+    if (pm->format != pixfmt_argb || !total) {
+        return false;
+    }
+
+    for (size_t i = 0; i < total; ++i) {
+        const argb_t c = pm->data[i];
+        if (ARGB_GET_A(c) != 0xff || ARGB_GET_R(c) != ARGB_GET_G(c) ||
+            ARGB_GET_G(c) != ARGB_GET_B(c)) {
+            return false;
+        }
+    }
+
+    gray = pxalloc(total, false);
+    if (!gray) {
+        return false;
+    }
+    for (size_t i = 0; i < total; ++i) {
+        gray[i] = ARGB_GET_B(pm->data[i]);
+    }
+    pxfree(pm->data);
+    pm->data = (argb_t*)gray;
+    pm->format = pixfmt_gray8;
+
+    return true;
+}
+
+bool pixmap_expand(const struct pixmap* src, struct pixmap* dst)
+{
+    if (!pixmap_create(dst, src->width, src->height)) {
+        return false;
+    }
+    pixmap_copy(src, dst, 0, 0, false);
+    return true;
+}
+
+bool pixmap_diff(const struct pixmap* a, const struct pixmap* b,
+                 struct pixmap_area* area)
+{
+    const size_t line_sz = a->width * sizeof(argb_t);
+    size_t top = 0, bottom, left, right;
+
+    memset(area, 0, sizeof(*area));
+
+    if (a->width != b->width || a->height != b->height) {
+        return false;
+    }
+
+    // find changed lines
+    while (top < a->height &&
+           memcmp(&a->data[top * a->width], &b->data[top * b->width],
+                  line_sz) == 0) {
+        ++top;
+    }
+    if (top == a->height) {
+        return true; // equal
+    }
+    bottom = a->height;
+    while (memcmp(&a->data[(bottom - 1) * a->width],
+                  &b->data[(bottom - 1) * b->width], line_sz) == 0) {
+        --bottom;
+    }
+
+    // find changed columns
+    left = a->width;
+    right = 0;
+    for (size_t y = top; y < bottom; ++y) {
+        const argb_t* line_a = &a->data[y * a->width];
+        const argb_t* line_b = &b->data[y * b->width];
+        size_t x = 0;
+        while (x < left && line_a[x] == line_b[x]) {
+            ++x;
+        }
+        left = x;
+        x = a->width;
+        while (x > right && line_a[x - 1] == line_b[x - 1]) {
+            --x;
+        }
+        right = x;
+    }
+
+    area->x = left;
+    area->y = top;
+    area->width = right - left;
+    area->height = bottom - top;
+
+    return true;
+}
+
 void pixmap_flip_vertical(struct pixmap* pm)
 {
     void* buffer;
@@ -247,6 +369,146 @@ void pixmap_flip_horizontal(struct pixmap* pm)
     }
 }
 
+/** Rotation task. */
+struct task_rotate {
+    const struct pixmap* src; ///< Source pixmap
+    struct pixmap* dst;       ///< Destination pixmap (same as source in-place)
+    size_t angle;             ///< Rotation angle (90 or 270)
+};
+
+#ifdef __SSE2__
+/**
+ * Rotate 4x4 block of pixels.
+ * @param src pointer to the top left pixel of the source block
+ * @param stride source line size (px)
+ * @param dst pointer to the first pixel of the first destination line
+ * @param dst_stride destination line offset (px), can be negative
+ * @param cw true for clockwise (90), false for counterclockwise (270)
+ */
+static inline void rotate4x4(const argb_t* src, size_t stride, argb_t* dst,
+                             ssize_t dst_stride, bool cw)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i*)&src[0]);
+    __m128i r1 = _mm_loadu_si128((const __m128i*)&src[stride]);
+    __m128i r2 = _mm_loadu_si128((const __m128i*)&src[stride * 2]);
+    __m128i r3 = _mm_loadu_si128((const __m128i*)&src[stride * 3]);
+
+    if (cw) {
+        // destination columns go from the bottom source line to the top one
+        __m128i swap = r0;
+        r0 = r3;
+        r3 = swap;
+        swap = r1;
+        r1 = r2;
+        r2 = swap;
+    }
+
+    // transpose
+    const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+    _mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128((__m128i*)(dst + dst_stride), _mm_unpackhi_epi64(t0, t1));
+    _mm_storeu_si128((__m128i*)(dst + dst_stride * 2),
+                     _mm_unpacklo_epi64(t2, t3));
+    _mm_storeu_si128((__m128i*)(dst + dst_stride * 3),
+                     _mm_unpackhi_epi64(t2, t3));
+}
+#endif
+
+/**
+ * Rotate a block of pixels into another pixmap.
+ * @param src source pixmap
+ * @param dst destination pixmap
+ * @param x0,y0 top left corner of the block in the source pixmap
+ * @param x1,y1 bottom right corner of the block (exclusive)
+ * @param cw true for clockwise (90), false for counterclockwise (270)
+ */
+static void rotate_block(const struct pixmap* src, struct pixmap* dst,
+                         size_t x0, size_t y0, size_t x1, size_t y1, bool cw)
+{
+    size_t y = y0;
+
+#ifdef __SSE2__
+    for (; y + 4 <= y1; y += 4) {
+        size_t x = x0;
+        for (; x + 4 <= x1; x += 4) {
+            const argb_t* in = &src->data[y * src->width + x];
+            if (cw) {
+                argb_t* out = &dst->data[x * dst->width + dst->width - y - 4];
+                rotate4x4(in, src->width, out, dst->width, true);
+            } else {
+                argb_t* out =
+                    &dst->data[(dst->height - x - 1) * dst->width + y];
+                rotate4x4(in, src->width, out, -(ssize_t)dst->width, false);
+            }
+        }
+        if (x < x1) {
+            // unaligned tail
+            for (size_t ty = y; ty < y + 4; ++ty) {
+                for (size_t tx = x; tx < x1; ++tx) {
+                    const size_t pos = cw
+                        ? tx * dst->width + dst->width - ty - 1
+                        : (dst->height - tx - 1) * dst->width + ty;
+                    dst->data[pos] = src->data[ty * src->width + tx];
+                }
+            }
+        }
+    }
+#endif
+
+    for (; y < y1; ++y) {
+        for (size_t x = x0; x < x1; ++x) {
+            const size_t pos = cw ? x * dst->width + dst->width - y - 1
+                                  : (dst->height - x - 1) * dst->width + y;
+            dst->data[pos] = src->data[y * src->width + x];
+        }
+    }
+}
+
+static void rotate_task(void* data, size_t low, size_t high)
+{
+    // Each range is a set of block lines of the source pixmap
+    const struct task_rotate* task = data;
+    const struct pixmap* src = task->src;
+
+    for (size_t by = low; by < high; ++by) {
+        const size_t y0 = by * ROTATE_BLOCK;
+        const size_t y1 = min(y0 + ROTATE_BLOCK, src->height);
+        for (size_t x0 = 0; x0 < src->width; x0 += ROTATE_BLOCK) {
+            const size_t x1 = min(x0 + ROTATE_BLOCK, src->width);
+            rotate_block(src, task->dst, x0, y0, x1, y1, task->angle == 90);
+        }
+    }
+}
+
+static void transpose_task(void* data, size_t low, size_t high)
+{
+    // Each range is a set of block lines, every block above main diagonal is
+    // swapped with the symmetric one
+    const struct task_rotate* task = data;
+    struct pixmap* pm = task->dst;
+    const size_t size = pm->width;
+
+    for (size_t by = low; by < high; ++by) {
+        const size_t y0 = by * ROTATE_BLOCK;
+        const size_t y1 = min(y0 + ROTATE_BLOCK, size);
+        for (size_t x0 = y0; x0 < size; x0 += ROTATE_BLOCK) {
+            const size_t x1 = min(x0 + ROTATE_BLOCK, size);
+            for (size_t y = y0; y < y1; ++y) {
+                for (size_t x = max(x0, y + 1); x < x1; ++x) {
+                    argb_t* color1 = &pm->data[y * size + x];
+                    argb_t* color2 = &pm->data[x * size + y];
+                    const argb_t swap = *color1;
+                    *color1 = *color2;
+                    *color2 = swap;
+                }
+            }
+        }
+    }
+}
+
 void pixmap_rotate(struct pixmap* pm, size_t angle)
 {
     const size_t pixels = pm->width * pm->height;
@@ -260,25 +522,49 @@ void pixmap_rotate(struct pixmap* pm, size_t angle)
             *color2 = swap;
         }
     } else if (angle == 90 || angle == 270) {
-        argb_t* data = malloc(pm->height * pm->width * sizeof(*data));
-        if (data) {
-            const size_t width = pm->height;
-            const size_t height = pm->width;
-            for (size_t y = 0; y < pm->height; ++y) {
-                for (size_t x = 0; x < pm->width; ++x) {
-                    size_t pos;
-                    if (angle == 90) {
-                        pos = x * width + (width - y - 1);
-                    } else {
-                        pos = (height - x - 1) * width + y;
-                    }
-                    data[pos] = pm->data[y * pm->width + x];
-                }
+        struct task_rotate task = {
+            .src = pm,
+            .dst = pm,
+            .angle = angle,
+        };
+        const size_t blocks = (pm->height + ROTATE_BLOCK - 1) / ROTATE_BLOCK;
+
+        if (pm->width == pm->height) {
+            // square image: transpose in-place, then flip
+            tpool_run(transpose_task, &task, blocks, 1);
+            if (angle == 90) {
+                pixmap_flip_horizontal(pm);
+            } else {
+                pixmap_flip_vertical(pm);
+            }
+        } else {
+            struct pixmap rotated;
+            rotated.width = pm->height;
+            rotated.height = pm->width;
+            rotated.data = pxalloc(pixels * sizeof(*rotated.data), false);
+            if (rotated.data) {
+                task.dst = &rotated;
+                tpool_run(rotate_task, &task, blocks, 1);
+                pxfree(pm->data);
+                *pm = rotated;
             }
-            free(pm->data);
-            pm->width = width;
-            pm->height = height;
-            pm->data = data;
         }
     }
 }
+
+void pixmap_orient(struct pixmap* pm, enum pixmap_orient orient)
+{
+    bool flip_x = orient & orient_flip_x;
+
+    if (orient & orient_transpose) {
+        // transpose is a clockwise rotation with horizontal flip
+        pixmap_rotate(pm, 90);
+        flip_x = !flip_x;
+    }
+    if (flip_x) {
+        pixmap_flip_horizontal(pm);
+    }
+    if (orient & orient_flip_y) {
+        pixmap_flip_vertical(pm);
+    }
+}
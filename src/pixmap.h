@@ -39,11 +39,42 @@ typedef uint32_t argb_t;
 #define max(a, b) ((a) > (b) ? (a) : (b))
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
+/**
+ * Orientation transform (one of 8 symmetries of a rectangle): mapping from
+ * displayed pixel coordinates to the stored ones. Displayed coordinates are
+ * mirrored first, then swapped if transpose flag is set.
+ */
+enum pixmap_orient {
+    orient_normal = 0,         ///< Pixels are displayed as is
+    orient_flip_x = 1 << 0,    ///< Mirror horizontally
+    orient_flip_y = 1 << 1,    ///< Mirror vertically
+    orient_transpose = 1 << 2, ///< Swap x and y axes
+};
+
+/**
+ * Pixel format. Compact formats are used to store images that don't need all
+ * of the channels, such pixmaps can only be the source of `pixmap_copy` and
+ * `pixmap_scale*`, pixels are expanded to ARGB on output.
+ */
+enum pixmap_format {
+    pixfmt_argb = 0, ///< 32-bit ARGB
+    pixfmt_gray8,    ///< 8-bit opaque grayscale
+};
+
 /** Pixel map. */
 struct pixmap {
-    size_t width;  ///< Width (px)
-    size_t height; ///< Height (px)
-    argb_t* data;  ///< Pixel data
+    size_t width;              ///< Width (px)
+    size_t height;             ///< Height (px)
+    argb_t* data;              ///< Pixel data
+    enum pixmap_format format; ///< Pixel format
+};
+
+/** Rectangular area of a pixel map. */
+struct pixmap_area {
+    size_t x;      ///< Left coordinate (px)
+    size_t y;      ///< Top coordinate (px)
+    size_t width;  ///< Width (px), 0 if area is empty
+    size_t height; ///< Height (px), 0 if area is empty
 };
 
 /**
@@ -60,6 +91,29 @@ bool pixmap_create(struct pixmap* pm, size_t width, size_t height);
  */
 void pixmap_free(struct pixmap* pm);
 
+/**
+ * Get size of a single pixel.
+ * @param format pixel format
+ * @return size in bytes
+ */
+size_t pixmap_bpp(enum pixmap_format format);
+
+/**
+ * Convert ARGB pixmap to the compact format if it doesn't lose any data:
+ * opaque pixmap with R=G=B in each pixel becomes grayscale.
+ * @param pm pixmap context to convert
+ * @return true if pixmap was converted
+ */
+bool pixmap_compact(struct pixmap* pm);
+
+/**
+ * Create ARGB copy of the pixmap.
+ * @param src source pixmap of any format
+ * @param dst destination pixmap to create
+ * @return true if pixmap was created
+ */
+bool pixmap_expand(const struct pixmap* src, struct pixmap* dst);
+
 /**
  * Fill area with specified color.
  * @param pm pixmap context
@@ -154,6 +208,15 @@ void pixmap_apply_mask(struct pixmap* pm, ssize_t x, ssize_t y,
 void pixmap_copy(const struct pixmap* src, struct pixmap* dst, ssize_t x,
                  ssize_t y, bool alpha);
 
+/**
+ * Get bounding box of pixels that differ between two pixel maps.
+ * @param a,b pixmaps to compare
+ * @param area output bounding box, empty if pixmaps are equal
+ * @return false if pixmaps have different sizes
+ */
+bool pixmap_diff(const struct pixmap* a, const struct pixmap* b,
+                 struct pixmap_area* area);
+
 /**
  * Flip pixel map vertically.
  * @param pm pixmap context
@@ -172,3 +235,10 @@ void pixmap_flip_horizontal(struct pixmap* pm);
  * @param angle rotation angle (only 90, 180, or 270)
  */
 void pixmap_rotate(struct pixmap* pm, size_t angle);
+
+/**
+ * Apply orientation transform to the pixel map.
+ * @param pm pixmap context
+ * @param orient orientation transform
+ */
+void pixmap_orient(struct pixmap* pm, enum pixmap_orient orient);
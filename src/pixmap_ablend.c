@@ -0,0 +1,298 @@
+// SPDX-License-Identifier: MIT
+// Alpha blending of pixel spans.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "pixmap_ablend.h"
+
+#include <string.h>
+
+// Vectorized implementation handles 4 pixels at once. Fast path covers the
+// most common case of blending over an opaque background (UI elements, text,
+// images over window background), other cases fall back to alpha_blend()
+// that produces exactly the same result.
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define PX4
+
+/** Vector of 4 pixels. */
+typedef __m128i px4_t;
+
+static inline px4_t px4_load(const argb_t* src)
+{
+    return _mm_loadu_si128((const __m128i*)src);
+}
+
+static inline void px4_store(argb_t* dst, px4_t px)
+{
+    _mm_storeu_si128((__m128i*)dst, px);
+}
+
+static inline px4_t px4_set(argb_t color)
+{
+    return _mm_set1_epi32(color);
+}
+
+/** Check if all 4 pixels are fully opaque. */
+static inline bool px4_opaque(px4_t px)
+{
+    const __m128i amask = _mm_set1_epi32(ARGB_SET_A(0xff));
+    const __m128i alpha = _mm_and_si128(px, amask);
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(alpha, amask)) == 0xffff;
+}
+
+/** Check if all 4 pixels are fully transparent. */
+static inline bool px4_transparent(px4_t px)
+{
+    const __m128i amask = _mm_set1_epi32(ARGB_SET_A(0xff));
+    const __m128i alpha = _mm_and_si128(px, amask);
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(alpha, _mm_setzero_si128())) ==
+        0xffff;
+}
+
+/** Exact division by 255 of 16-bit lanes in range [0, 65025]. */
+static inline __m128i div255_epu16(__m128i x)
+{
+    const __m128i one = _mm_set1_epi16(1);
+    x = _mm_add_epi16(_mm_add_epi16(x, one), _mm_srli_epi16(x, 8));
+    return _mm_srli_epi16(x, 8);
+}
+
+/** Blend 2 pixels (unpacked to 16-bit lanes) over opaque background. */
+static inline __m128i blend2_opaque(__m128i src, __m128i dst)
+{
+    const __m128i max = _mm_set1_epi16(255);
+    // broadcast alpha of each pixel to all its channels
+    __m128i alpha = _mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+    src = _mm_mullo_epi16(src, alpha);
+    dst = _mm_mullo_epi16(dst, _mm_sub_epi16(max, alpha));
+    return div255_epu16(_mm_add_epi16(src, dst));
+}
+
+/** Blend 4 pixels over opaque background. */
+static inline px4_t px4_blend_opaque(px4_t src, px4_t dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo = blend2_opaque(_mm_unpacklo_epi8(src, zero),
+                                     _mm_unpacklo_epi8(dst, zero));
+    const __m128i hi = blend2_opaque(_mm_unpackhi_epi8(src, zero),
+                                     _mm_unpackhi_epi8(dst, zero));
+    return _mm_or_si128(_mm_packus_epi16(lo, hi),
+                        _mm_set1_epi32(ARGB_SET_A(0xff)));
+}
+
+/** Compose 4 pixels of the same color with alpha multiplied by mask. */
+static inline px4_t px4_mask(argb_t color, const uint8_t* mask)
+{
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t m4;
+    __m128i alpha;
+
+    memcpy(&m4, mask, sizeof(m4));
+    alpha = _mm_unpacklo_epi8(_mm_cvtsi32_si128(m4), zero);
+    alpha = _mm_mullo_epi16(alpha, _mm_set1_epi16(ARGB_GET_A(color)));
+    alpha = _mm_unpacklo_epi16(div255_epu16(alpha), zero);
+    alpha = _mm_slli_epi32(alpha, ARGB_A_SHIFT);
+
+    return _mm_or_si128(alpha, _mm_set1_epi32(color & 0x00ffffff));
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#include <arm_neon.h>
+#define PX4
+
+/** Vector of 4 pixels. */
+typedef uint32x4_t px4_t;
+
+static inline px4_t px4_load(const argb_t* src)
+{
+    return vld1q_u32(src);
+}
+
+static inline void px4_store(argb_t* dst, px4_t px)
+{
+    vst1q_u32(dst, px);
+}
+
+static inline px4_t px4_set(argb_t color)
+{
+    return vdupq_n_u32(color);
+}
+
+/** Check if all 4 pixels are fully opaque. */
+static inline bool px4_opaque(px4_t px)
+{
+    return vminvq_u32(vshrq_n_u32(px, ARGB_A_SHIFT)) == 0xff;
+}
+
+/** Check if all 4 pixels are fully transparent. */
+static inline bool px4_transparent(px4_t px)
+{
+    return vmaxvq_u32(vshrq_n_u32(px, ARGB_A_SHIFT)) == 0;
+}
+
+/** Exact division by 255 of 16-bit lanes in range [0, 65025]. */
+static inline uint16x8_t div255_u16(uint16x8_t x)
+{
+    x = vaddq_u16(x, vsraq_n_u16(vdupq_n_u16(1), x, 8));
+    return vshrq_n_u16(x, 8);
+}
+
+/** Blend 4 pixels over opaque background. */
+static inline px4_t px4_blend_opaque(px4_t src, px4_t dst)
+{
+    static const uint8_t alpha_idx[] = { 3,  3,  3,  3,  7,  7,  7,  7,
+                                         11, 11, 11, 11, 15, 15, 15, 15 };
+    const uint8x16_t s = vreinterpretq_u8_u32(src);
+    const uint8x16_t d = vreinterpretq_u8_u32(dst);
+    // broadcast alpha of each pixel to all its channels
+    const uint8x16_t a = vqtbl1q_u8(s, vld1q_u8(alpha_idx));
+    const uint8x16_t ia = vmvnq_u8(a);
+    uint16x8_t lo, hi;
+
+    lo = vmlal_u8(vmull_u8(vget_low_u8(s), vget_low_u8(a)), vget_low_u8(d),
+                  vget_low_u8(ia));
+    hi = vmlal_high_u8(vmull_high_u8(s, a), d, ia);
+    lo = div255_u16(lo);
+    hi = div255_u16(hi);
+
+    return vorrq_u32(
+        vreinterpretq_u32_u8(vcombine_u8(vmovn_u16(lo), vmovn_u16(hi))),
+        vdupq_n_u32(ARGB_SET_A(0xff)));
+}
+
+/** Compose 4 pixels of the same color with alpha multiplied by mask. */
+static inline px4_t px4_mask(argb_t color, const uint8_t* mask)
+{
+    uint32_t m4;
+    uint16x8_t alpha;
+
+    memcpy(&m4, mask, sizeof(m4));
+    alpha = vmull_u8(vreinterpret_u8_u32(vdup_n_u32(m4)),
+                     vdup_n_u8(ARGB_GET_A(color)));
+    alpha = div255_u16(alpha);
+
+    return vorrq_u32(vshlq_n_u32(vmovl_u16(vget_low_u16(alpha)), ARGB_A_SHIFT),
+                     vdupq_n_u32(color & 0x00ffffff));
+}
+#endif // SIMD
+
+#ifdef PX4
+/**
+ * Blend 4 pixels.
+ * @param src top pixels
+ * @param dst pointer to bottom pixels
+ */
+static inline void px4_blend(px4_t src, argb_t* dst)
+{
+    const px4_t bg = px4_load(dst);
+    if (px4_opaque(bg)) {
+        px4_store(dst, px4_blend_opaque(src, bg));
+    } else {
+        argb_t top[4];
+        px4_store(top, src);
+        for (size_t i = 0; i < 4; ++i) {
+            alpha_blend(top[i], &dst[i]);
+        }
+    }
+}
+#endif // PX4
+
+void alpha_blend_span(const argb_t* src, argb_t* dst, size_t len)
+{
+    size_t i = 0;
+
+#ifdef PX4
+    for (; i + 4 <= len; i += 4) {
+        const px4_t px = px4_load(&src[i]);
+        if (px4_opaque(px)) {
+            px4_store(&dst[i], px);
+        } else if (!px4_transparent(px)) {
+            px4_blend(px, &dst[i]);
+        }
+    }
+#endif
+
+    for (; i < len; ++i) {
+        alpha_blend(src[i], &dst[i]);
+    }
+}
+
+void alpha_blend_fill(argb_t color, argb_t* dst, size_t len)
+{
+    const uint8_t alpha = ARGB_GET_A(color);
+    size_t i = 0;
+
+    if (alpha == 0) {
+        return;
+    }
+    if (alpha == 255) {
+        for (; i < len; ++i) {
+            dst[i] = color;
+        }
+        return;
+    }
+
+#ifdef PX4
+    const px4_t px = px4_set(color);
+    for (; i + 4 <= len; i += 4) {
+        px4_blend(px, &dst[i]);
+    }
+#endif
+
+    for (; i < len; ++i) {
+        alpha_blend(color, &dst[i]);
+    }
+}
+
+void alpha_blend_mask(argb_t color, const uint8_t* mask, argb_t* dst,
+                      size_t len)
+{
+    const uint8_t alpha = ARGB_GET_A(color);
+    const argb_t rgb = color & 0x00ffffff;
+    size_t i = 0;
+
+    if (alpha == 0) {
+        return;
+    }
+
+#ifdef PX4
+    for (; i + 4 <= len; i += 4) {
+        uint32_t m4;
+        memcpy(&m4, &mask[i], sizeof(m4));
+        if (m4 == 0) {
+            continue; // fully transparent
+        }
+        if (m4 == 0xffffffff && alpha == 255) {
+            px4_store(&dst[i], px4_set(color));
+            continue; // fully opaque
+        }
+        px4_blend(px4_mask(color, &mask[i]), &dst[i]);
+    }
+#endif
+
+    for (; i < len; ++i) {
+        const uint8_t alpha_mask = mask[i];
+        if (alpha_mask != 0) {
+            const argb_t top = ARGB_SET_A(div255(alpha_mask * alpha)) | rgb;
+            alpha_blend(top, &dst[i]);
+        }
+    }
+}
+
+void alpha_premultiply(const argb_t* src, argb_t* dst, size_t len)
+{
+    for (size_t i = 0; i < len; ++i) {
+        const argb_t c = src[i];
+        const uint32_t a = ARGB_GET_A(c);
+        if (a == 255) {
+            dst[i] = c;
+        } else {
+            dst[i] = ARGB(a, div255(ARGB_GET_R(c) * a),
+                          div255(ARGB_GET_G(c) * a),
+                          div255(ARGB_GET_B(c) * a));
+        }
+    }
+}
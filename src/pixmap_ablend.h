@@ -6,6 +6,16 @@
 
 #include "pixmap.h"
 
+/**
+ * Divide by 255 without division.
+ * @param x dividend, the result is exact (floor) for range [0, 65025]
+ * @return quotient
+ */
+static inline uint32_t div255(uint32_t x)
+{
+    return (x + 1 + (x >> 8)) >> 8;
+}
+
 /**
  * Alpha blending.
  * @param src top pixel
@@ -17,18 +27,63 @@ static inline void alpha_blend(argb_t src, argb_t* dst)
     if (a1 == 255) {
         *dst = src;
     } else if (a1 != 0) {
-        // if all quantities are in [0, 1] range, the formulas are:
-        // a_out = a_top + (1 - a_top) * a_bot
-        // c_out = a_top * c_top + (1 - a_top) * a_bot * c_bot
-        // this integer math does the same, avoiding some division
         const argb_t dp = *dst;
-        const uint32_t c1 = a1 * 255;
-        const uint32_t c2 = (255 - a1) * ARGB_GET_A(dp);
-        // guaranteed to be non-zero because a1 is nonzero
-        const uint32_t alpha = c1 + c2;
-        *dst = ARGB(alpha / 255,
-                    (ARGB_GET_R(src) * c1 + ARGB_GET_R(dp) * c2) / alpha,
-                    (ARGB_GET_G(src) * c1 + ARGB_GET_G(dp) * c2) / alpha,
-                    (ARGB_GET_B(src) * c1 + ARGB_GET_B(dp) * c2) / alpha);
+        const uint8_t a2 = ARGB_GET_A(dp);
+        if (a2 == 255) {
+            // opaque background, output alpha is always 255:
+            // c_out = a_top * c_top + (1 - a_top) * c_bot
+            const uint32_t ia1 = 255 - a1;
+            const uint32_t r = ARGB_GET_R(src) * a1 + ARGB_GET_R(dp) * ia1;
+            const uint32_t g = ARGB_GET_G(src) * a1 + ARGB_GET_G(dp) * ia1;
+            const uint32_t b = ARGB_GET_B(src) * a1 + ARGB_GET_B(dp) * ia1;
+            *dst = ARGB(255, div255(r), div255(g), div255(b));
+        } else {
+            // if all quantities are in [0, 1] range, the formulas are:
+            // a_out = a_top + (1 - a_top) * a_bot
+            // c_out = a_top * c_top + (1 - a_top) * a_bot * c_bot
+            // this integer math does the same, avoiding some division
+            const uint32_t c1 = a1 * 255;
+            const uint32_t c2 = (255 - a1) * a2;
+            // guaranteed to be non-zero because a1 is nonzero
+            const uint32_t alpha = c1 + c2;
+            *dst = ARGB(div255(alpha),
+                        (ARGB_GET_R(src) * c1 + ARGB_GET_R(dp) * c2) / alpha,
+                        (ARGB_GET_G(src) * c1 + ARGB_GET_G(dp) * c2) / alpha,
+                        (ARGB_GET_B(src) * c1 + ARGB_GET_B(dp) * c2) / alpha);
+        }
     }
 }
+
+/**
+ * Blend span of pixels: dst[i] = src[i] over dst[i].
+ * @param src top pixels
+ * @param dst bottom pixels
+ * @param len number of pixels
+ */
+void alpha_blend_span(const argb_t* src, argb_t* dst, size_t len);
+
+/**
+ * Blend solid color over span of pixels.
+ * @param color top color
+ * @param dst bottom pixels
+ * @param len number of pixels
+ */
+void alpha_blend_fill(argb_t color, argb_t* dst, size_t len);
+
+/**
+ * Blend color over span of pixels using alpha mask.
+ * @param color top color, its alpha is multiplied by the mask value
+ * @param mask alpha mask, one byte per pixel
+ * @param dst bottom pixels
+ * @param len number of pixels
+ */
+void alpha_blend_mask(argb_t color, const uint8_t* mask, argb_t* dst,
+                      size_t len);
+
+/**
+ * Convert span of pixels to premultiplied alpha (used by Wayland and GL).
+ * @param src source pixels with straight alpha
+ * @param dst destination pixels, can be the same as source
+ * @param len number of pixels
+ */
+void alpha_premultiply(const argb_t* src, argb_t* dst, size_t len);
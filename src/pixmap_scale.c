@@ -6,18 +6,17 @@
 
 #include "array.h"
 #include "loader.h"
+#include "perf.h"
 #include "pixmap_ablend.h"
+#include "pxalloc.h"
+#include "tpool.h"
+#include "trace.h"
 
 #include <math.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
-
-#ifdef __FreeBSD__
-#include <sys/sysctl.h>
-#endif
 
 #define clamp(a, low, high) (min((high), max((a), (low))))
 
@@ -34,6 +33,10 @@
 // over 1
 #define FIXED_BITS 14
 
+// Minimal number of output pixels to process in a single thread, smaller
+// outputs (e.g. thumbnails) are scaled faster without any synchronization
+#define TASK_MIN_PIXELS (64 * 1024)
+
 /** The description of a single output in a kernel. */
 struct output {
     size_t first; ///< First input for this output
@@ -49,6 +52,7 @@ struct kernel {
     size_t n_in;            ///< Number of inputs
     struct output* outputs; ///< Outputs
     int16_t* weights;       ///< Weights
+    bool narrow;            ///< Sums fit into 32-bit accumulators
 };
 
 /** Window function type. */
@@ -60,12 +64,31 @@ struct bounds {
     ssize_t last;
 };
 
-/** Values shared by all threads in a nearest-neighbor scale. */
-struct task_nn_shared {
+/** Intermediate image: premultiplied alpha, 16 bits per channel. */
+struct pixmap16 {
+    size_t width;   ///< Width (px)
+    size_t height;  ///< Height (px)
+    uint16_t* data; ///< Pixel data, channels are B, G, R, A
+};
+
+/**
+ * Output mapping: position of the scaled pixels in the destination pixmap.
+ * Scaling is always done in the source orientation, mirroring and
+ * transposition are applied by changing the order of writes.
+ */
+struct scale_dst {
+    argb_t* origin; ///< Destination of the first output pixel
+    ssize_t col;    ///< Offset to the next pixel in the output line (px)
+    ssize_t row;    ///< Offset to the next output line (px)
+};
+
+/** Nearest-neighbor scale task. */
+struct task_nn {
     const struct pixmap* src; ///< Source pixmap
-    struct pixmap* dst;       ///< Destination pixmap
+    struct scale_dst dst;     ///< Destination
     size_t x_low;             ///< x start (left)
     size_t x_high;            ///< x end (right)
+    size_t y_low;             ///< y start (top)
     size_t num;               ///< Numerator in fixed-point
     uint8_t den_bits;         ///< Amount to shift for denominator
     ssize_t x;                ///< x offset in destination
@@ -73,38 +96,16 @@ struct task_nn_shared {
     bool alpha;               ///< Use alpha blending?
 };
 
-/** Per-thread information for a nearest-neighbor scale. */
-struct task_nn_priv {
-    struct task_nn_shared* shared; ///< Shared information
-    size_t y_low;                  ///< Start row
-    size_t y_high;                 ///< One beyond end row
-    pthread_t id;                  ///< Thread id
-};
-
-/** Values shared by all threads in all other scales. */
-struct task_sc_shared {
+/** All other scales task. */
+struct task_sc {
     const struct pixmap* src; ///< Source pixmap
-    struct pixmap in;         ///< Intermediate pixmap
-    struct pixmap* dst;       ///< Destination pixmap
+    struct pixmap16 in;       ///< Intermediate pixmap
+    struct scale_dst dst;     ///< Destination
     struct kernel hk;         ///< Horizontal kernel
     struct kernel vk;         ///< Vertical kernel
     size_t yoff;              ///< y offset (for horizontal kernel)
     size_t xoff;              ///< x offset (for vertical kernel)
     bool alpha;               ///< Use alpha blending?
-    size_t threads;           ///< Total number of threads
-    size_t sync;              ///< Number of threads done with horizontal pass
-    pthread_mutex_t m;        ///< Mutex to protect sync
-    pthread_cond_t cv;        ///< CV for the same
-};
-
-/** Per-thread information for all other scales. */
-struct task_sc_priv {
-    struct task_sc_shared* shared; ///< Shared information
-    size_t hy_low;                 ///< Start row for horizontal pass
-    size_t hy_high;                ///< One beyond end row for horizontal pass
-    size_t vy_low;                 ///< Start row for vertical pass
-    size_t vy_high;                ///< One beyond end row for vertical pass
-    pthread_t id;                  ///< Thread id
 };
 
 // clang-format off
@@ -219,6 +220,7 @@ static void new_kernel(struct kernel* kernel, size_t nin, size_t nout,
     kernel->outputs = malloc(kernel->n_out * sizeof(*kernel->outputs));
 
     // Track min and max input across all outputs
+    kernel->narrow = true;
     size_t min_in = SIZE_MAX;
     size_t max_in = 0;
     size_t index = 0;
@@ -267,6 +269,17 @@ static void new_kernel(struct kernel* kernel, size_t nin, size_t nout,
         memcpy(&kernel->weights[index], &int_weights[tfirst - first],
                output->n * sizeof(*kernel->weights));
         index += output->n;
+
+        // Vectorized passes accumulate color * alpha * weight in 32 bits,
+        // which is only exact if the worst case sum (including rounding)
+        // can't overflow
+        int64_t abs_sum = 0;
+        for (size_t in = tfirst; in <= tlast; ++in) {
+            abs_sum += abs(int_weights[in - first]);
+        }
+        if (abs_sum * 255 * 255 + (1 << FIXED_BITS) > INT32_MAX) {
+            kernel->narrow = false;
+        }
     }
 
     kernel->start_in = min_in;
@@ -334,14 +347,207 @@ static void new_named_kernel(enum aa_mode scaler, struct kernel* kernel,
     }
 }
 
+// Kernels are expensive to build, but while panning a zoomed image only the
+// offset changes. Weights for each output depend on its position relative to
+// the offset only, so a kernel built for a wider range of outputs can be
+// reused for any window within that range just by translating it.
+
+/** Cached kernel. */
+struct kernel_cache {
+    struct kernel kernel; ///< Kernel covering a range of outputs
+    enum aa_mode scaler;  ///< Scale filter used to build the kernel
+    size_t n_in;          ///< Number of inputs (source size)
+    double scale;         ///< Scale factor
+    ssize_t offset;       ///< Output offset used to build the kernel
+    size_t refs;          ///< Number of active users
+    size_t stamp;         ///< Last access stamp (for LRU eviction)
+};
+
+// Number of cached kernels: horizontal and vertical for two scale tasks
+#define KERNEL_CACHE_SIZE 4
+
+static struct kernel_cache kcache[KERNEL_CACHE_SIZE];
+static size_t kcache_stamp;
+static pthread_mutex_t kcache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Fill kernel view for the specified range of outputs.
+ * @param cached cached kernel
+ * @param view destination kernel
+ * @param out number of outputs (destination size)
+ * @param offset output offset
+ * @return false if cached kernel doesn't contain requested outputs
+ */
+static bool kernel_view(const struct kernel_cache* cached, struct kernel* view,
+                        size_t out, ssize_t offset)
+{
+    const struct kernel* kernel = &cached->kernel;
+    const size_t start = max(0, offset);
+    const size_t end = min(out, (size_t)(offset + cached->n_in * cached->scale));
+
+    // translate to the outputs of cached kernel
+    const ssize_t first = start - offset + cached->offset;
+    const ssize_t last = end - offset + cached->offset;
+    if (first < (ssize_t)kernel->start_out ||
+        last > (ssize_t)(kernel->start_out + kernel->n_out) || start >= end) {
+        return false;
+    }
+
+    view->start_out = start;
+    view->n_out = end - start;
+    view->outputs = &kernel->outputs[first - kernel->start_out];
+    view->weights = kernel->weights;
+    view->narrow = kernel->narrow;
+
+    size_t min_in = SIZE_MAX;
+    size_t max_in = 0;
+    for (size_t i = 0; i < view->n_out; ++i) {
+        const struct output* output = &view->outputs[i];
+        if (output->first < min_in) {
+            min_in = output->first;
+        }
+        if (output->first + output->n - 1 > max_in) {
+            max_in = output->first + output->n - 1;
+        }
+    }
+    view->start_in = min_in;
+    view->n_in = max_in - min_in + 1;
+
+    return true;
+}
+
+/**
+ * Get kernel from cache or build a new one.
+ * @param scaler scale filter
+ * @param kernel destination kernel
+ * @param in,out number of inputs and outputs (source and destination size)
+ * @param offset output offset
+ * @param scale scale factor
+ * @return pointer to the cache entry to release or NULL if kernel is not cached
+ */
+static struct kernel_cache* get_kernel(enum aa_mode scaler,
+                                       struct kernel* kernel, size_t in,
+                                       size_t out, ssize_t offset,
+                                       double scale)
+{
+    struct kernel_cache* entry = NULL;
+
+    pthread_mutex_lock(&kcache_lock);
+
+    ++kcache_stamp;
+
+    // search for suitable kernel
+    for (size_t i = 0; i < KERNEL_CACHE_SIZE; ++i) {
+        struct kernel_cache* it = &kcache[i];
+        if (it->kernel.outputs && it->scaler == scaler && it->n_in == in &&
+            it->scale == scale && kernel_view(it, kernel, out, offset)) {
+            entry = it;
+            break;
+        }
+    }
+
+    if (!entry) {
+        // get the least recently used free entry
+        for (size_t i = 0; i < KERNEL_CACHE_SIZE; ++i) {
+            struct kernel_cache* it = &kcache[i];
+            if (it->refs == 0 && (!entry || it->stamp < entry->stamp)) {
+                entry = it;
+            }
+        }
+        if (!entry) {
+            // all entries are in use, don't cache
+            pthread_mutex_unlock(&kcache_lock);
+            new_named_kernel(scaler, kernel, in, out, offset, scale);
+            return NULL;
+        }
+
+        // build kernel with margins to cover further movements
+        if (entry->kernel.outputs) {
+            free_kernel(&entry->kernel);
+        }
+        const size_t margin = out / 2;
+        entry->scaler = scaler;
+        entry->n_in = in;
+        entry->scale = scale;
+        entry->offset = offset + margin;
+        new_named_kernel(scaler, &entry->kernel, in, out + margin * 2,
+                         entry->offset, scale);
+        if (!kernel_view(entry, kernel, out, offset)) {
+            // should never happen, but just in case
+            free_kernel(&entry->kernel);
+            entry->offset = offset;
+            new_named_kernel(scaler, &entry->kernel, in, out, offset, scale);
+            kernel_view(entry, kernel, out, offset);
+        }
+    }
+
+    ++entry->refs;
+    entry->stamp = kcache_stamp;
+
+    pthread_mutex_unlock(&kcache_lock);
+
+    return entry;
+}
+
+/**
+ * Release kernel obtained with `get_kernel`.
+ * @param kernel kernel to release
+ * @param entry cache entry returned by `get_kernel`
+ */
+static void put_kernel(struct kernel* kernel, struct kernel_cache* entry)
+{
+    if (entry) {
+        pthread_mutex_lock(&kcache_lock);
+        --entry->refs;
+        pthread_mutex_unlock(&kcache_lock);
+    } else {
+        free_kernel(kernel);
+    }
+}
+
+// The intermediate image between the horizontal and vertical passes stores
+// premultiplied colors with 16 bits per channel: each color channel is
+// (color * alpha) and the alpha channel is (alpha * 255), so all channels
+// share the same range. The horizontal pass is then a plain weighted sum
+// without any divisions, and only the vertical pass converts the result back
+// to straight alpha, using a single reciprocal per pixel.
+
+// Maximum value of the intermediate channel
+#define PREMUL_MAX (255 * 255)
+
+// Scale factor to get the output alpha from the sum of the vertical pass
+#define ALPHA_SCALE (1.0 / (255 << FIXED_BITS))
+
+/**
+ * Get the intermediate channel value from the horizontal pass sum.
+ * @param sum weighted sum in fixed point
+ * @return channel value
+ */
+static inline uint16_t premul_channel(int64_t sum)
+{
+    return clamp((sum + (1 << (FIXED_BITS - 1))) >> FIXED_BITS, 0, PREMUL_MAX);
+}
+
+/**
+ * Get the output channel value from the vertical pass sum.
+ * @param sum weighted sum
+ * @param k scale factor
+ * @return channel value
+ */
+static inline uint8_t straight_channel(int64_t sum, double k)
+{
+    return clamp(sum * k, 0.0, 255.0) + 0.5;
+}
+
 // Apply a horizontal kernel; the output pixmap is assumed to be only as tall as
 // needed by the vertical pass - yoff indicates where it begins in the source
-static void apply_hk(const struct pixmap* src, struct pixmap* dst,
+static void apply_hk(const struct pixmap* src, struct pixmap16* dst,
                      const struct kernel* kernel, size_t y_low, size_t y_high,
-                     size_t yoff, bool alpha)
+                     size_t yoff)
 {
     for (size_t y = y_low; y < y_high; ++y) {
-        argb_t* dst_line = &dst->data[y * dst->width];
+        const argb_t* src_line = &src->data[(y + yoff) * src->width];
+        uint16_t* dst_line = &dst->data[y * dst->width * 4];
         for (size_t x = 0; x < dst->width; ++x) {
             const struct output* output = &kernel->outputs[x];
             int64_t a = 0;
@@ -349,8 +555,7 @@ static void apply_hk(const struct pixmap* src, struct pixmap* dst,
             int64_t g = 0;
             int64_t b = 0;
             for (size_t i = 0; i < output->n; ++i) {
-                const argb_t c =
-                    src->data[(y + yoff) * src->width + output->first + i];
+                const argb_t c = src_line[output->first + i];
                 const int64_t wa =
                     (int64_t)ARGB_GET_A(c) * kernel->weights[output->index + i];
                 a += wa;
@@ -358,142 +563,616 @@ static void apply_hk(const struct pixmap* src, struct pixmap* dst,
                 g += ARGB_GET_G(c) * wa;
                 b += ARGB_GET_B(c) * wa;
             }
+            uint16_t* px = &dst_line[x * 4];
+            px[0] = premul_channel(b);
+            px[1] = premul_channel(g);
+            px[2] = premul_channel(r);
+            px[3] = premul_channel(a * 255);
+        }
+    }
+}
 
-            // TODO the result would likely be more accurate (without
-            // sacrificing speed) if we saved more than 8 bits between
-            // the passes
-            const uint8_t ua = clamp(a >> FIXED_BITS, 0, 255);
-            if (a == 0) {
-                a = (1 << FIXED_BITS);
-            }
-            // TODO irrespective of the above, saving the intermediate with
-            // premultiplied alpha would almost certainly improve performance
-            const uint8_t ur = clamp(r / a, 0, 255);
-            const uint8_t ug = clamp(g / a, 0, 255);
-            const uint8_t ub = clamp(b / a, 0, 255);
-            const argb_t color = ARGB(ua, ur, ug, ub);
-            if (alpha) {
-                alpha_blend(color, &dst_line[x]);
-            } else {
-                dst_line[x] = color;
+// Apply a horizontal kernel to the opaque grayscale pixmap, the output is
+// the same as from `apply_hk` for the expanded ARGB pixels
+static void apply_hk_gray8(const struct pixmap* src, struct pixmap16* dst,
+                           const struct kernel* kernel, size_t y_low,
+                           size_t y_high, size_t yoff)
+{
+    const uint8_t* gray = (const uint8_t*)src->data;
+
+    for (size_t y = y_low; y < y_high; ++y) {
+        const uint8_t* src_line = &gray[(y + yoff) * src->width];
+        uint16_t* dst_line = &dst->data[y * dst->width * 4];
+        for (size_t x = 0; x < dst->width; ++x) {
+            const struct output* output = &kernel->outputs[x];
+            int64_t a = 0;
+            int64_t v = 0;
+            for (size_t i = 0; i < output->n; ++i) {
+                const int64_t w = kernel->weights[output->index + i];
+                a += w;
+                v += src_line[output->first + i] * w;
             }
+            uint16_t* px = &dst_line[x * 4];
+            px[0] = px[1] = px[2] = premul_channel(v * 255);
+            px[3] = premul_channel(a * 255 * 255);
         }
     }
 }
 
 // Apply a vertical kernel; the input pixmap is assumed to be only as tall as
 // needed - xoff indicates where it should go in the destination
-static void apply_vk(const struct pixmap* src, struct pixmap* dst,
+static void apply_vk(const struct pixmap16* src, const struct scale_dst* dst,
                      const struct kernel* kernel, size_t y_low, size_t y_high,
                      size_t xoff, bool alpha)
 {
     for (size_t y = y_low; y < y_high; ++y) {
-        argb_t* dst_line = &dst->data[(y + kernel->start_out) * dst->width];
+        const struct output* output = &kernel->outputs[y];
+        const uint16_t* in =
+            &src->data[(output->first - kernel->start_in) * src->width * 4];
+        argb_t* dst_line = dst->origin +
+            (ssize_t)(y + kernel->start_out) * dst->row +
+            (ssize_t)xoff * dst->col;
         for (size_t x = 0; x < src->width; ++x) {
-            const struct output* output = &kernel->outputs[y];
             int64_t a = 0;
             int64_t r = 0;
             int64_t g = 0;
             int64_t b = 0;
             for (size_t i = 0; i < output->n; ++i) {
-                const argb_t c =
-                    src->data[(output->first + i - kernel->start_in) *
-                                  src->width +
-                              x];
-                const int64_t wa =
-                    (int64_t)ARGB_GET_A(c) * kernel->weights[output->index + i];
-                a += wa;
-                r += ARGB_GET_R(c) * wa;
-                g += ARGB_GET_G(c) * wa;
-                b += ARGB_GET_B(c) * wa;
+                const uint16_t* px = &in[(i * src->width + x) * 4];
+                const int64_t w = kernel->weights[output->index + i];
+                b += px[0] * w;
+                g += px[1] * w;
+                r += px[2] * w;
+                a += px[3] * w;
+            }
+
+            const double k = a > 0 ? 255.0 / a : 0.0;
+            const argb_t color =
+                ARGB(straight_channel(a, ALPHA_SCALE), straight_channel(r, k),
+                     straight_channel(g, k), straight_channel(b, k));
+            if (alpha) {
+                alpha_blend(color, &dst_line[(ssize_t)x * dst->col]);
+            } else {
+                dst_line[(ssize_t)x * dst->col] = color;
+            }
+        }
+    }
+}
+
+/** Horizontal kernel pass function. */
+typedef void (*apply_hk_fn)(const struct pixmap* src, struct pixmap16* dst,
+                            const struct kernel* kernel, size_t y_low,
+                            size_t y_high, size_t yoff);
+
+/** Vertical kernel pass function. */
+typedef void (*apply_vk_fn)(const struct pixmap16* src,
+                            const struct scale_dst* dst,
+                            const struct kernel* kernel, size_t y_low,
+                            size_t y_high, size_t xoff, bool alpha);
+
+// Vectorized versions of the passes above. In the horizontal pass each pixel
+// is unpacked into four 32-bit lanes (B, G, R, A in memory order) and the
+// alpha lane is replaced with 255, so that a single multiply by
+// (alpha * weight) gives the same sums as the scalar code. The vertical pass
+// multiplies all four intermediate channels by the weight. Conversion to the
+// straight alpha is done in double precision with exactly the same operations
+// as in the scalar code, so the results are identical. Kernels which can
+// overflow 32-bit sums are handled by the scalar passes (see kernel->narrow).
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define SIMD_X86
+
+/** Add pixel multiplied by its alpha and weight to the accumulator. */
+__attribute__((target("sse4.1"))) static inline __m128i
+sse41_madd(__m128i acc, argb_t c, int16_t weight)
+{
+    const __m128i px = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(c));
+    const __m128i wa = _mm_set1_epi32((int32_t)ARGB_GET_A(c) * weight);
+    const __m128i val = _mm_insert_epi32(px, 255, 3);
+    return _mm_add_epi32(acc, _mm_mullo_epi32(val, wa));
+}
+
+/** Store horizontal pass sums, see premul_channel for scalar version. */
+__attribute__((target("sse4.1"))) static inline void
+sse41_store_hk(__m128i acc, uint16_t* px)
+{
+    acc = _mm_add_epi32(acc, _mm_set1_epi32(1 << (FIXED_BITS - 1)));
+    acc = _mm_srai_epi32(acc, FIXED_BITS);
+    acc = _mm_max_epi32(acc, _mm_setzero_si128());
+    acc = _mm_min_epi32(acc, _mm_set1_epi32(PREMUL_MAX));
+    _mm_storel_epi64((__m128i*)px, _mm_packus_epi32(acc, acc));
+}
+
+/** Add intermediate pixel multiplied by weight to the accumulator. */
+__attribute__((target("sse4.1"))) static inline __m128i
+sse41_madd_vk(__m128i acc, const uint16_t* px, int16_t weight)
+{
+    const __m128i val = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)px));
+    return _mm_add_epi32(acc, _mm_mullo_epi32(val, _mm_set1_epi32(weight)));
+}
+
+/** Get the final color from the sums, see apply_vk for scalar version. */
+__attribute__((target("sse4.1"))) static inline argb_t
+sse41_finish_vk(__m128i acc)
+{
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d limit = _mm_set1_pd(255.0);
+    const __m128d half = _mm_set1_pd(0.5);
+    const int32_t sum_a = _mm_extract_epi32(acc, 3);
+    const double k = sum_a > 0 ? 255.0 / sum_a : 0.0;
+    __m128d lo = _mm_mul_pd(_mm_cvtepi32_pd(acc), _mm_set1_pd(k));
+    __m128d hi = _mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(acc, acc)),
+                            _mm_set_pd(ALPHA_SCALE, k));
+    lo = _mm_add_pd(_mm_min_pd(_mm_max_pd(lo, zero), limit), half);
+    hi = _mm_add_pd(_mm_min_pd(_mm_max_pd(hi, zero), limit), half);
+    __m128i res = _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+    res = _mm_packus_epi32(res, res);
+    res = _mm_packus_epi16(res, res);
+    return _mm_cvtsi128_si32(res);
+}
+
+__attribute__((target("sse4.1"))) static void
+apply_hk_sse41(const struct pixmap* src, struct pixmap16* dst,
+               const struct kernel* kernel, size_t y_low, size_t y_high,
+               size_t yoff)
+{
+    for (size_t y = y_low; y < y_high; ++y) {
+        const argb_t* src_line = &src->data[(y + yoff) * src->width];
+        uint16_t* dst_line = &dst->data[y * dst->width * 4];
+        for (size_t x = 0; x < dst->width; ++x) {
+            const struct output* output = &kernel->outputs[x];
+            const argb_t* in = &src_line[output->first];
+            const int16_t* weights = &kernel->weights[output->index];
+            __m128i acc = _mm_setzero_si128();
+            for (size_t i = 0; i < output->n; ++i) {
+                acc = sse41_madd(acc, in[i], weights[i]);
             }
+            sse41_store_hk(acc, &dst_line[x * 4]);
+        }
+    }
+}
 
-            const uint8_t ua = clamp(a >> FIXED_BITS, 0, 255);
-            if (a == 0) {
-                a = (1 << FIXED_BITS);
+__attribute__((target("sse4.1"))) static void
+apply_vk_sse41(const struct pixmap16* src, const struct scale_dst* dst,
+               const struct kernel* kernel, size_t y_low, size_t y_high,
+               size_t xoff, bool alpha)
+{
+    const size_t stride = src->width * 4;
+
+    for (size_t y = y_low; y < y_high; ++y) {
+        const struct output* output = &kernel->outputs[y];
+        const uint16_t* in =
+            &src->data[(output->first - kernel->start_in) * stride];
+        const int16_t* weights = &kernel->weights[output->index];
+        argb_t* dst_line = dst->origin +
+            (ssize_t)(y + kernel->start_out) * dst->row +
+            (ssize_t)xoff * dst->col;
+        for (size_t x = 0; x < src->width; ++x) {
+            __m128i acc = _mm_setzero_si128();
+            for (size_t i = 0; i < output->n; ++i) {
+                acc = sse41_madd_vk(acc, &in[i * stride + x * 4], weights[i]);
             }
-            const uint8_t ur = clamp(r / a, 0, 255);
-            const uint8_t ug = clamp(g / a, 0, 255);
-            const uint8_t ub = clamp(b / a, 0, 255);
-            const argb_t color = ARGB(ua, ur, ug, ub);
+            const argb_t color = sse41_finish_vk(acc);
             if (alpha) {
-                alpha_blend(color, &dst_line[x + xoff]);
+                alpha_blend(color, &dst_line[(ssize_t)x * dst->col]);
             } else {
-                dst_line[x + xoff] = color;
+                dst_line[(ssize_t)x * dst->col] = color;
+            }
+        }
+    }
+}
+
+/**
+ * Add two pixels multiplied by their alphas and weights to the accumulator.
+ * Low half of the vector is for the first pixel, high half for the second.
+ */
+__attribute__((target("avx2"))) static inline __m256i
+avx2_madd(__m256i acc, const argb_t* px2, __m256i weights)
+{
+    const __m256i alpha = _mm256_set1_epi32(255);
+    const __m256i px =
+        _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)px2));
+    const __m256i wa = _mm256_mullo_epi32(_mm256_shuffle_epi32(px, 0xff),
+                                          weights);
+    const __m256i val = _mm256_blend_epi32(px, alpha, 0x88);
+    return _mm256_add_epi32(acc, _mm256_mullo_epi32(val, wa));
+}
+
+__attribute__((target("avx2"))) static void
+apply_hk_avx2(const struct pixmap* src, struct pixmap16* dst,
+              const struct kernel* kernel, size_t y_low, size_t y_high,
+              size_t yoff)
+{
+    for (size_t y = y_low; y < y_high; ++y) {
+        const argb_t* src_line = &src->data[(y + yoff) * src->width];
+        uint16_t* dst_line = &dst->data[y * dst->width * 4];
+        for (size_t x = 0; x < dst->width; ++x) {
+            const struct output* output = &kernel->outputs[x];
+            const argb_t* in = &src_line[output->first];
+            const int16_t* weights = &kernel->weights[output->index];
+            // two neighboring inputs per step
+            __m256i acc2 = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 1 < output->n; i += 2) {
+                const __m256i w = _mm256_setr_epi32(
+                    weights[i], weights[i], weights[i], weights[i],
+                    weights[i + 1], weights[i + 1], weights[i + 1],
+                    weights[i + 1]);
+                acc2 = avx2_madd(acc2, &in[i], w);
             }
+            __m128i acc = _mm_add_epi32(_mm256_castsi256_si128(acc2),
+                                        _mm256_extracti128_si256(acc2, 1));
+            if (i < output->n) {
+                acc = sse41_madd(acc, in[i], weights[i]);
+            }
+            sse41_store_hk(acc, &dst_line[x * 4]);
         }
     }
 }
 
+__attribute__((target("avx2"))) static void
+apply_vk_avx2(const struct pixmap16* src, const struct scale_dst* dst,
+              const struct kernel* kernel, size_t y_low, size_t y_high,
+              size_t xoff, bool alpha)
+{
+    const size_t stride = src->width * 4;
+
+    for (size_t y = y_low; y < y_high; ++y) {
+        const struct output* output = &kernel->outputs[y];
+        const uint16_t* in =
+            &src->data[(output->first - kernel->start_in) * stride];
+        const int16_t* weights = &kernel->weights[output->index];
+        argb_t* dst_line = dst->origin +
+            (ssize_t)(y + kernel->start_out) * dst->row +
+            (ssize_t)xoff * dst->col;
+        size_t x = 0;
+        // two neighboring outputs per step, they share the same weights
+        for (; x + 1 < src->width; x += 2) {
+            __m256i acc = _mm256_setzero_si256();
+            for (size_t i = 0; i < output->n; ++i) {
+                const __m128i px =
+                    _mm_loadu_si128((const __m128i*)&in[i * stride + x * 4]);
+                const __m256i val = _mm256_cvtepu16_epi32(px);
+                const __m256i w = _mm256_set1_epi32(weights[i]);
+                acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(val, w));
+            }
+            const argb_t color0 = sse41_finish_vk(_mm256_castsi256_si128(acc));
+            const argb_t color1 =
+                sse41_finish_vk(_mm256_extracti128_si256(acc, 1));
+            if (alpha) {
+                alpha_blend(color0, &dst_line[(ssize_t)x * dst->col]);
+                alpha_blend(color1, &dst_line[(ssize_t)(x + 1) * dst->col]);
+            } else {
+                dst_line[(ssize_t)x * dst->col] = color0;
+                dst_line[(ssize_t)(x + 1) * dst->col] = color1;
+            }
+        }
+        if (x < src->width) {
+            __m128i acc = _mm_setzero_si128();
+            for (size_t i = 0; i < output->n; ++i) {
+                acc = sse41_madd_vk(acc, &in[i * stride + x * 4], weights[i]);
+            }
+            const argb_t color = sse41_finish_vk(acc);
+            if (alpha) {
+                alpha_blend(color, &dst_line[(ssize_t)x * dst->col]);
+            } else {
+                dst_line[(ssize_t)x * dst->col] = color;
+            }
+        }
+    }
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#include <arm_neon.h>
+
+#define SIMD_NEON
+
+/** Add pixel multiplied by its alpha and weight to the accumulator. */
+static inline int32x4_t neon_madd(int32x4_t acc, argb_t c, int16_t weight)
+{
+    const uint8x8_t px8 = vreinterpret_u8_u32(vdup_n_u32(c));
+    const uint32x4_t px = vmovl_u16(vget_low_u16(vmovl_u8(px8)));
+    const int32x4_t val = vsetq_lane_s32(255, vreinterpretq_s32_u32(px), 3);
+    return vmlaq_n_s32(acc, val, (int32_t)ARGB_GET_A(c) * weight);
+}
+
+/** Store horizontal pass sums, see premul_channel for scalar version. */
+static inline void neon_store_hk(int32x4_t acc, uint16_t* px)
+{
+    acc = vaddq_s32(acc, vdupq_n_s32(1 << (FIXED_BITS - 1)));
+    acc = vshrq_n_s32(acc, FIXED_BITS);
+    acc = vminq_s32(vmaxq_s32(acc, vdupq_n_s32(0)), vdupq_n_s32(PREMUL_MAX));
+    vst1_u16(px, vqmovun_s32(acc));
+}
+
+/** Add intermediate pixel multiplied by weight to the accumulator. */
+static inline int32x4_t neon_madd_vk(int32x4_t acc, const uint16_t* px,
+                                     int16_t weight)
+{
+    const int32x4_t val = vreinterpretq_s32_u32(vmovl_u16(vld1_u16(px)));
+    return vmlaq_n_s32(acc, val, weight);
+}
+
+/** Get the final color from the sums, see apply_vk for scalar version. */
+static inline argb_t neon_finish_vk(int32x4_t acc)
+{
+    const float64x2_t zero = vdupq_n_f64(0.0);
+    const float64x2_t limit = vdupq_n_f64(255.0);
+    const float64x2_t half = vdupq_n_f64(0.5);
+    const int32_t sum_a = vgetq_lane_s32(acc, 3);
+    const double k = sum_a > 0 ? 255.0 / sum_a : 0.0;
+    const float64x2_t k_hi = vsetq_lane_f64(ALPHA_SCALE, vdupq_n_f64(k), 1);
+    float64x2_t lo = vcvtq_f64_s64(vmovl_s32(vget_low_s32(acc)));
+    float64x2_t hi = vcvtq_f64_s64(vmovl_s32(vget_high_s32(acc)));
+    lo = vminq_f64(vmaxq_f64(vmulq_n_f64(lo, k), zero), limit);
+    hi = vminq_f64(vmaxq_f64(vmulq_f64(hi, k_hi), zero), limit);
+    lo = vaddq_f64(lo, half);
+    hi = vaddq_f64(hi, half);
+    const int32x4_t res = vcombine_s32(vmovn_s64(vcvtq_s64_f64(lo)),
+                                       vmovn_s64(vcvtq_s64_f64(hi)));
+    const uint16x4_t res16 = vqmovun_s32(res);
+    const uint8x8_t res8 = vqmovn_u16(vcombine_u16(res16, res16));
+    return vget_lane_u32(vreinterpret_u32_u8(res8), 0);
+}
+
+static void apply_hk_neon(const struct pixmap* src, struct pixmap16* dst,
+                          const struct kernel* kernel, size_t y_low,
+                          size_t y_high, size_t yoff)
+{
+    for (size_t y = y_low; y < y_high; ++y) {
+        const argb_t* src_line = &src->data[(y + yoff) * src->width];
+        uint16_t* dst_line = &dst->data[y * dst->width * 4];
+        for (size_t x = 0; x < dst->width; ++x) {
+            const struct output* output = &kernel->outputs[x];
+            const argb_t* in = &src_line[output->first];
+            const int16_t* weights = &kernel->weights[output->index];
+            int32x4_t acc = vdupq_n_s32(0);
+            for (size_t i = 0; i < output->n; ++i) {
+                acc = neon_madd(acc, in[i], weights[i]);
+            }
+            neon_store_hk(acc, &dst_line[x * 4]);
+        }
+    }
+}
+
+static void apply_vk_neon(const struct pixmap16* src,
+                          const struct scale_dst* dst,
+                          const struct kernel* kernel, size_t y_low,
+                          size_t y_high, size_t xoff, bool alpha)
+{
+    const size_t stride = src->width * 4;
+
+    for (size_t y = y_low; y < y_high; ++y) {
+        const struct output* output = &kernel->outputs[y];
+        const uint16_t* in =
+            &src->data[(output->first - kernel->start_in) * stride];
+        const int16_t* weights = &kernel->weights[output->index];
+        argb_t* dst_line = dst->origin +
+            (ssize_t)(y + kernel->start_out) * dst->row +
+            (ssize_t)xoff * dst->col;
+        for (size_t x = 0; x < src->width; ++x) {
+            int32x4_t acc = vdupq_n_s32(0);
+            for (size_t i = 0; i < output->n; ++i) {
+                acc = neon_madd_vk(acc, &in[i * stride + x * 4], weights[i]);
+            }
+            const argb_t color = neon_finish_vk(acc);
+            if (alpha) {
+                alpha_blend(color, &dst_line[(ssize_t)x * dst->col]);
+            } else {
+                dst_line[(ssize_t)x * dst->col] = color;
+            }
+        }
+    }
+}
+#endif
+
+/** Fastest implementations of the passes supported by current CPU. */
+static apply_hk_fn apply_hk_fast = apply_hk;
+static apply_vk_fn apply_vk_fast = apply_vk;
+static pthread_once_t apply_once = PTHREAD_ONCE_INIT;
+
+// Select kernel pass implementations, called once on first use
+static void apply_select(void)
+{
+#if defined(SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        apply_hk_fast = apply_hk_avx2;
+        apply_vk_fast = apply_vk_avx2;
+    } else if (__builtin_cpu_supports("sse4.1")) {
+        apply_hk_fast = apply_hk_sse41;
+        apply_vk_fast = apply_vk_sse41;
+    }
+#elif defined(SIMD_NEON)
+    apply_hk_fast = apply_hk_neon;
+    apply_vk_fast = apply_vk_neon;
+#endif
+}
+
+bool pixmap_scale_impl(enum scale_impl impl)
+{
+    pthread_once(&apply_once, apply_select);
+
+    switch (impl) {
+        case scale_impl_auto:
+            apply_hk_fast = apply_hk;
+            apply_vk_fast = apply_vk;
+            apply_select();
+            return true;
+        case scale_impl_scalar:
+            apply_hk_fast = apply_hk;
+            apply_vk_fast = apply_vk;
+            return true;
+#if defined(SIMD_X86)
+        case scale_impl_sse41:
+            if (__builtin_cpu_supports("sse4.1")) {
+                apply_hk_fast = apply_hk_sse41;
+                apply_vk_fast = apply_vk_sse41;
+                return true;
+            }
+            break;
+        case scale_impl_avx2:
+            if (__builtin_cpu_supports("avx2")) {
+                apply_hk_fast = apply_hk_avx2;
+                apply_vk_fast = apply_vk_avx2;
+                return true;
+            }
+            break;
+#elif defined(SIMD_NEON)
+        case scale_impl_neon:
+            apply_hk_fast = apply_hk_neon;
+            apply_vk_fast = apply_vk_neon;
+            return true;
+#endif
+        default:
+            break;
+    }
+
+    return false;
+}
+
 // See pixmap_scale for more details (also uses fixed point arithmetic)
-static void scale_nearest(const struct pixmap* src, struct pixmap* dst,
+static void scale_nearest(const struct pixmap* src, const struct scale_dst* dst,
                           size_t y_low, size_t y_high, size_t x_low,
                           size_t x_high, size_t num, uint8_t den_bits,
                           ssize_t x, ssize_t y, bool alpha)
 {
+    if (src->format == pixfmt_gray8) {
+        // always opaque, expanded to ARGB while drawing
+        const uint8_t* gray = (const uint8_t*)src->data;
+        for (size_t dst_y = y_low; dst_y < y_high; ++dst_y) {
+            const size_t src_y = ((dst_y - y) * num) >> den_bits;
+            const uint8_t* src_line = &gray[src_y * src->width];
+            argb_t* dst_line = dst->origin + (ssize_t)dst_y * dst->row;
+            for (size_t dst_x = x_low; dst_x < x_high; ++dst_x) {
+                const size_t src_x = ((dst_x - x) * num) >> den_bits;
+                const uint8_t v = src_line[src_x];
+                dst_line[(ssize_t)dst_x * dst->col] = ARGB(0xff, v, v, v);
+            }
+        }
+        return;
+    }
+
     for (size_t dst_y = y_low; dst_y < y_high; ++dst_y) {
         const size_t src_y = ((dst_y - y) * num) >> den_bits;
         const argb_t* src_line = &src->data[src_y * src->width];
-        argb_t* dst_line = &dst->data[dst_y * dst->width];
+        argb_t* dst_line = dst->origin + (ssize_t)dst_y * dst->row;
 
         for (size_t dst_x = x_low; dst_x < x_high; ++dst_x) {
             const size_t src_x = ((dst_x - x) * num) >> den_bits;
             const argb_t color = src_line[src_x];
+            argb_t* dst_px = &dst_line[(ssize_t)dst_x * dst->col];
 
             if (alpha) {
-                alpha_blend(color, &dst_line[dst_x]);
+                alpha_blend(color, dst_px);
             } else {
-                dst_line[dst_x] = ARGB_SET_A(0xff) | color;
+                *dst_px = ARGB_SET_A(0xff) | color;
             }
         }
     }
 }
 
-static void* nn_task(void* arg)
+static void nn_task(void* data, size_t low, size_t high)
 {
-    // Each thread simply handles a consecutive block of rows
-    struct task_nn_priv* priv = arg;
-    struct task_nn_shared* shared = priv->shared;
-    scale_nearest(shared->src, shared->dst, priv->y_low, priv->y_high,
-                  shared->x_low, shared->x_high, shared->num, shared->den_bits,
-                  shared->x, shared->y, shared->alpha);
-    return NULL;
+    // Each range is simply a consecutive block of rows
+    struct task_nn* task = data;
+    scale_nearest(task->src, &task->dst, task->y_low + low,
+                  task->y_low + high, task->x_low, task->x_high, task->num,
+                  task->den_bits, task->x, task->y, task->alpha);
 }
 
-static void* sc_task(void* arg)
+static void hk_task(void* data, size_t low, size_t high)
 {
-    // Each thread first handles a consecutive block of rows for the horizontal
-    // scale, synchronizes with the others, then handles a consecutive block of
-    // rows for the vertical scale
-    struct task_sc_priv* priv = arg;
-    struct task_sc_shared* shared = priv->shared;
+    struct task_sc* task = data;
+    apply_hk_fn hk = task->hk.narrow ? apply_hk_fast : apply_hk;
+    if (task->src->format == pixfmt_gray8) {
+        hk = apply_hk_gray8;
+    }
+    hk(task->src, &task->in, &task->hk, low, high, task->yoff);
+}
 
-    apply_hk(shared->src, &shared->in, &shared->hk, priv->hy_low, priv->hy_high,
-             shared->yoff, false);
+static void vk_task(void* data, size_t low, size_t high)
+{
+    struct task_sc* task = data;
+    const apply_vk_fn vk = task->vk.narrow ? apply_vk_fast : apply_vk;
+    vk(&task->in, &task->dst, &task->vk, low, high, task->xoff, task->alpha);
+}
 
-    pthread_mutex_lock(&shared->m);
-    ++shared->sync;
-    pthread_cond_broadcast(&shared->cv);
-    while (shared->sync != shared->threads) {
-        pthread_cond_wait(&shared->cv, &shared->m);
-    }
-    pthread_mutex_unlock(&shared->m);
+/**
+ * Get minimal number of rows for a single thread.
+ * @param width row width in pixels
+ * @return number of rows
+ */
+static inline size_t task_min_rows(size_t width)
+{
+    return width ? TASK_MIN_PIXELS / width : 1;
+}
 
-    apply_vk(&shared->in, shared->dst, &shared->vk, priv->vy_low, priv->vy_high,
-             shared->xoff, shared->alpha);
+/** Scaled image placement in the source orientation. */
+struct scale_place {
+    struct scale_dst dst; ///< Output mapping
+    size_t width;         ///< Output size along the source x axis (px)
+    size_t height;        ///< Output size along the source y axis (px)
+    ssize_t x;            ///< Output offset along the source x axis
+    ssize_t y;            ///< Output offset along the source y axis
+};
 
-    return NULL;
+/**
+ * Set up placement of the scaled image.
+ * @param src source pixmap
+ * @param dst destination pixmap
+ * @param x,y destination left top coordinates
+ * @param scale scale of source pixmap
+ * @param orient orientation transform
+ * @param place output placement
+ */
+static void scale_place(const struct pixmap* src, struct pixmap* dst,
+                        ssize_t x, ssize_t y, float scale,
+                        enum pixmap_orient orient, struct scale_place* place)
+{
+    const bool transpose = orient & orient_transpose;
+    const bool mirror_x = orient & (transpose ? orient_flip_y : orient_flip_x);
+    const bool mirror_y = orient & (transpose ? orient_flip_x : orient_flip_y);
+    const ssize_t col = transpose ? (ssize_t)dst->width : 1;
+    const ssize_t row = transpose ? 1 : (ssize_t)dst->width;
+
+    place->dst.origin = dst->data;
+    place->dst.col = col;
+    place->dst.row = row;
+    place->width = transpose ? dst->height : dst->width;
+    place->height = transpose ? dst->width : dst->height;
+    place->x = transpose ? y : x;
+    place->y = transpose ? x : y;
+
+    // mirrored image is drawn from the opposite edge of the destination
+    if (mirror_x) {
+        place->x = (ssize_t)place->width - place->x -
+            (ssize_t)(src->width * scale);
+        place->dst.origin += (ssize_t)(place->width - 1) * col;
+        place->dst.col = -col;
+    }
+    if (mirror_y) {
+        place->y = (ssize_t)place->height - place->y -
+            (ssize_t)(src->height * scale);
+        place->dst.origin += (ssize_t)(place->height - 1) * row;
+        place->dst.row = -row;
+    }
 }
 
-static void pixmap_scale_nn(size_t threads, const struct pixmap* src,
-                            struct pixmap* dst, ssize_t x, ssize_t y,
-                            float scale, bool alpha)
+static void pixmap_scale_nn(const struct pixmap* src,
+                            const struct scale_place* place, float scale,
+                            bool alpha)
 {
+    const ssize_t x = place->x;
+    const ssize_t y = place->y;
     const size_t left = max(0, x);
     const size_t top = max(0, y);
-    const size_t right = min(dst->width, (size_t)(x + scale * src->width));
-    const size_t bottom = min(dst->height, (size_t)(y + scale * src->height));
-    const size_t len = (bottom - top) / (threads + 1);
+    const size_t right = min(place->width, (size_t)(x + scale * src->width));
+    const size_t bottom =
+        min(place->height, (size_t)(y + scale * src->height));
 
     // Use fixed-point for efficiency (floating-point division becomes an
     // addition and a shift, since it's used in a loop anyway). The choices
@@ -503,11 +1182,12 @@ static void pixmap_scale_nn(size_t threads, const struct pixmap* src,
     const uint8_t den_bits = scale > 1.0 ? 32 : 25;
     const size_t num = (1.0 / scale) * (1UL << den_bits);
 
-    struct task_nn_shared task_shared = {
+    struct task_nn task = {
         .src = src,
-        .dst = dst,
+        .dst = place->dst,
         .x_low = left,
         .x_high = right,
+        .y_low = top,
         .num = num,
         .den_bits = den_bits,
         .x = x,
@@ -515,123 +1195,168 @@ static void pixmap_scale_nn(size_t threads, const struct pixmap* src,
         .alpha = alpha,
     };
 
-    struct task_nn_priv* task_priv = NULL;
-    if (threads) {
-        task_priv = malloc(threads * sizeof(*task_priv));
-    }
-    size_t row = top;
-    for (size_t i = 0; i < threads; ++i) {
-        task_priv[i].shared = &task_shared;
-        task_priv[i].y_low = row;
-        row += len;
-        task_priv[i].y_high = row;
-        pthread_create(&task_priv[i].id, NULL, nn_task, &task_priv[i]);
-    }
-    struct task_nn_priv task_first = {
-        .shared = &task_shared,
-        .y_low = row,
-        .y_high = bottom,
-    };
+    tpool_run(nn_task, &task, bottom - top, task_min_rows(right - left));
+}
 
-    nn_task(&task_first);
+static void pixmap_scale_aa(enum aa_mode scaler, const struct pixmap* src,
+                            const struct scale_place* place, float scale,
+                            bool alpha)
+{
+    pthread_once(&apply_once, apply_select);
 
-    for (size_t i = 0; i < threads; ++i) {
-        pthread_join(task_priv[i].id, NULL);
+    struct task_sc task = {
+        .src = src,
+        .dst = place->dst,
+        .alpha = alpha,
+    };
+    struct kernel_cache* hcache = get_kernel(scaler, &task.hk, src->width,
+                                             place->width, place->x, scale);
+    struct kernel_cache* vcache = get_kernel(scaler, &task.vk, src->height,
+                                             place->height, place->y, scale);
+    task.in.width = task.hk.n_out;
+    task.in.height = task.vk.n_in;
+    task.in.data = pxalloc(
+        task.in.width * task.in.height * 4 * sizeof(*task.in.data), false);
+    task.yoff = task.vk.start_in;
+    task.xoff = task.hk.start_out;
+
+    if (task.in.data) {
+        // horizontal pass must be completed before the vertical one starts
+        const size_t min_rows = task_min_rows(task.hk.n_out);
+        tpool_run(hk_task, &task, task.vk.n_in, min_rows);
+        tpool_run(vk_task, &task, task.vk.n_out, min_rows);
+        pxfree(task.in.data);
     }
 
-    free(task_priv);
+    put_kernel(&task.hk, hcache);
+    put_kernel(&task.vk, vcache);
 }
 
-static void pixmap_scale_aa(enum aa_mode scaler, size_t threads,
-                            const struct pixmap* src, struct pixmap* dst,
-                            ssize_t x, ssize_t y, float scale, bool alpha)
+/**
+ * Draw scaled and transformed pixmap, see `pixmap_scale` for details.
+ * @param orient orientation transform
+ */
+static void scale_orient(enum aa_mode scaler, const struct pixmap* src,
+                         struct pixmap* dst, ssize_t x, ssize_t y, float scale,
+                         bool alpha, enum pixmap_orient orient)
 {
-    struct task_sc_shared task_shared = {
-        .src = src,
-        .dst = dst,
-        .alpha = alpha,
-        .threads = threads + 1,
-        .sync = 0,
-        .m = PTHREAD_MUTEX_INITIALIZER,
-        .cv = PTHREAD_COND_INITIALIZER,
-    };
-    new_named_kernel(scaler, &task_shared.hk, src->width, dst->width, x, scale);
-    new_named_kernel(scaler, &task_shared.vk, src->height, dst->height, y,
-                     scale);
-    pixmap_create(&task_shared.in, task_shared.hk.n_out, task_shared.vk.n_in);
-    task_shared.yoff = task_shared.vk.start_in;
-    task_shared.xoff = task_shared.hk.start_out;
-
-    struct task_sc_priv* task_priv = NULL;
-    if (threads) {
-        task_priv = malloc(threads * sizeof(*task_priv));
-    }
-    const size_t hlen = task_shared.vk.n_in / (threads + 1);
-    const size_t vlen = task_shared.vk.n_out / (threads + 1);
-    size_t hrow = 0;
-    size_t vrow = 0;
-    for (size_t i = 0; i < threads; ++i) {
-        task_priv[i].shared = &task_shared;
-        task_priv[i].hy_low = hrow;
-        task_priv[i].vy_low = vrow;
-        hrow += hlen;
-        vrow += vlen;
-        task_priv[i].hy_high = hrow;
-        task_priv[i].vy_high = vrow;
-        pthread_create(&task_priv[i].id, NULL, sc_task, &task_priv[i]);
-    }
-    struct task_sc_priv task_first = {
-        .shared = &task_shared,
-        .hy_low = hrow,
-        .vy_low = vrow,
-        .hy_high = task_shared.vk.n_in,
-        .vy_high = task_shared.vk.n_out,
-    };
+    const uint64_t start = perf_now();
+    struct scale_place place;
 
-    sc_task(&task_first);
+    scale_place(src, dst, x, y, scale, orient, &place);
 
-    for (size_t i = 0; i < threads; ++i) {
-        pthread_join(task_priv[i].id, NULL);
+    // Do nothing if the scaled image won't appear on the destination pixmap
+    if (place.x >= (ssize_t)place.width ||
+        (ssize_t)(place.x + src->width * scale) <= 0 ||
+        place.y >= (ssize_t)place.height ||
+        (ssize_t)(place.y + src->height * scale) <= 0) {
+        return;
+    }
+
+    // grayscale is always opaque
+    if (src->format == pixfmt_gray8) {
+        alpha = false;
+    }
+
+    if (scaler == aa_nearest) {
+        pixmap_scale_nn(src, &place, scale, alpha);
+    } else {
+        pixmap_scale_aa(scaler, src, &place, scale, alpha);
     }
 
-    free(task_priv);
-    free_kernel(&task_shared.hk);
-    free_kernel(&task_shared.vk);
-    pixmap_free(&task_shared.in);
+    trace_span("scale", aa_name(scaler), start);
 }
 
 void pixmap_scale(enum aa_mode scaler, const struct pixmap* src,
                   struct pixmap* dst, ssize_t x, ssize_t y, float scale,
                   bool alpha)
 {
-    // Do nothing if the scaled image won't appear on the destination pixmap
-    if (x >= (ssize_t)dst->width || (ssize_t)(x + src->width * scale) <= 0 ||
-        y >= (ssize_t)dst->height || (ssize_t)(y + src->height * scale) <= 0) {
-        return;
-    }
+    scale_orient(scaler, src, dst, x, y, scale, alpha, orient_normal);
+}
 
-    // TODO in some cases (especially when scaling to small outputs), using
-    // threads is actually slower - it may be worth implementing some better
-    // heuristics here to avoid using as many (or any) threads in those cases.
-    // This is especially an issue with the gallery, which produces a lot of
-    // small images - it would probably be more efficient to spin up threads
-    // which each handle some thumbnails (on their own), rather than using
-    // multiple threads for each thumbnail
-
-    // get active CPUs
-#ifdef __FreeBSD__
-    uint32_t cpus = 0;
-    size_t cpus_len = sizeof(cpus);
-    sysctlbyname("hw.ncpu", &cpus, &cpus_len, 0, 0);
-#else
-    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
-#endif
-    // but limit background threads to at most 15
-    const size_t bthreads = clamp(cpus, 1, 16) - 1;
+void pixmap_scale_mipmap(enum aa_mode scaler, const struct pixmap* src,
+                         const struct pixmap* mipmap, size_t levels,
+                         struct pixmap* dst, ssize_t x, ssize_t y, float scale,
+                         bool alpha, enum pixmap_orient orient)
+{
+    // use the smallest level that is still not smaller than the output
+    size_t level = 0;
+    while (level < levels && scale * (1 << (level + 1)) <= 1.0) {
+        ++level;
+    }
 
-    if (scaler == aa_nearest) {
-        pixmap_scale_nn(bthreads, src, dst, x, y, scale, alpha);
+    const float level_scale = scale * (1 << level);
+    const struct pixmap* level_pm = level ? &mipmap[level - 1] : src;
+    if (level_scale == 1.0) {
+        if (orient == orient_normal) {
+            pixmap_copy(level_pm, dst, x, y, alpha);
+        } else {
+            // nearest-neighbor without scaling is an exact copy
+            scale_orient(aa_nearest, level_pm, dst, x, y, 1.0, alpha, orient);
+        }
     } else {
-        pixmap_scale_aa(scaler, bthreads, src, dst, x, y, scale, alpha);
+        scale_orient(scaler, level_pm, dst, x, y, level_scale, alpha, orient);
     }
 }
+
+/** Box reduce task. */
+struct task_reduce {
+    const struct pixmap* src; ///< Source pixmap
+    struct pixmap* dst;       ///< Destination pixmap
+};
+
+static void reduce_task(void* data, size_t low, size_t high)
+{
+    const struct task_reduce* task = data;
+    const struct pixmap* src = task->src;
+    struct pixmap* dst = task->dst;
+
+    for (size_t y = low; y < high; ++y) {
+        const size_t y0 = y * 2;
+        const size_t y1 = min(y0 + 1, src->height - 1);
+        const argb_t* src_line0 = &src->data[y0 * src->width];
+        const argb_t* src_line1 = &src->data[y1 * src->width];
+        argb_t* dst_line = &dst->data[y * dst->width];
+
+        for (size_t x = 0; x < dst->width; ++x) {
+            const size_t x0 = x * 2;
+            const size_t x1 = min(x0 + 1, src->width - 1);
+            const argb_t px[] = { src_line0[x0], src_line0[x1], src_line1[x0],
+                                  src_line1[x1] };
+            uint32_t a = 0, r = 0, g = 0, b = 0;
+
+            // colors are weighted by alpha, like in the kernel passes
+            for (size_t i = 0; i < ARRAY_SIZE(px); ++i) {
+                const uint32_t pa = ARGB_GET_A(px[i]);
+                a += pa;
+                r += ARGB_GET_R(px[i]) * pa;
+                g += ARGB_GET_G(px[i]) * pa;
+                b += ARGB_GET_B(px[i]) * pa;
+            }
+            if (a) {
+                r = (r + a / 2) / a;
+                g = (g + a / 2) / a;
+                b = (b + a / 2) / a;
+            }
+            dst_line[x] = ARGB((a + 2) / 4, r, g, b);
+        }
+    }
+}
+
+bool pixmap_reduce(const struct pixmap* src, struct pixmap* dst)
+{
+    const size_t width = (src->width + 1) / 2;
+    const size_t height = (src->height + 1) / 2;
+    struct task_reduce task = {
+        .src = src,
+        .dst = dst,
+    };
+
+    if (!pixmap_create(dst, width, height)) {
+        return false;
+    }
+
+    tpool_run(reduce_task, &task, height, task_min_rows(width));
+
+    return true;
+}
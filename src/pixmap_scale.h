@@ -16,6 +16,15 @@ enum aa_mode {
     aa_mks13,    ///< Magic Kernel with 2013 Sharp approximation
 };
 
+/** Implementations of the filter passes. */
+enum scale_impl {
+    scale_impl_auto,   ///< The fastest one supported by CPU
+    scale_impl_scalar, ///< Portable C code
+    scale_impl_sse41,  ///< x86 SSE4.1
+    scale_impl_avx2,   ///< x86 AVX2
+    scale_impl_neon,   ///< ARM NEON
+};
+
 /**
  * Get anti-aliasing mode from config.
  * @param cfg config instance
@@ -51,3 +60,40 @@ const char* aa_name(enum aa_mode aa);
 void pixmap_scale(enum aa_mode scaler, const struct pixmap* src,
                   struct pixmap* dst, ssize_t x, ssize_t y, float scale,
                   bool alpha);
+
+/**
+ * Draw scaled pixmap using the most suitable level of mipmap, optionally
+ * transformed to the specified orientation.
+ * @param scaler scale filter to use
+ * @param src source pixmap (level 0)
+ * @param mipmap array of reduced copies of the source, each level is 2x
+ *        smaller than the previous one, can be NULL
+ * @param levels number of levels in mipmap array
+ * @param dst destination pixmap
+ * @param x,y destination left top coordinates
+ * @param scale scale of source pixmap
+ * @param alpha flag to use alpha blending
+ * @param orient orientation transform applied to the source
+ */
+void pixmap_scale_mipmap(enum aa_mode scaler, const struct pixmap* src,
+                         const struct pixmap* mipmap, size_t levels,
+                         struct pixmap* dst, ssize_t x, ssize_t y, float scale,
+                         bool alpha, enum pixmap_orient orient);
+
+/**
+ * Create 2x reduced copy of the pixmap (box filter), used to build mipmaps.
+ * Odd size is rounded up, so each output pixel covers exactly 2x2 inputs
+ * of the source.
+ * @param src source pixmap
+ * @param dst destination pixmap to create
+ * @return true if pixmap was created
+ */
+bool pixmap_reduce(const struct pixmap* src, struct pixmap* dst);
+
+/**
+ * Force implementation of the filter passes, used to compare vectorized
+ * code with the scalar one. Must not be called while scaling is in progress.
+ * @param impl implementation to use
+ * @return false if implementation is not supported by current CPU
+ */
+bool pixmap_scale_impl(enum scale_impl impl);
@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: MIT
+// Scheduling priority of background threads.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+// SCHED_IDLE, CPU_SET() and pthread_setaffinity_np()
+#define _GNU_SOURCE
+
+#include "priority.h"
+
+#include "array.h"
+
+#include <string.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// I/O priority, see linux/ioprio.h
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_CLASS_BE    2
+#define IOPRIO_CLASS_IDLE  3
+#define IOPRIO_BE_LOWEST   7
+#define IOPRIO_VALUE(class, data) (((class) << IOPRIO_CLASS_SHIFT) | (data))
+#endif // __linux__
+
+// Nice value increment of low priority threads
+#define LOW_NICE 10
+// Max nice value
+#define MAX_NICE 19
+
+/** Priority of background threads. */
+enum priority_level {
+    prio_normal, ///< The same as the main thread
+    prio_low,    ///< Lowered nice value and I/O priority
+    prio_idle,   ///< Run only when CPU and disk are not used by others
+};
+
+// Names of priority levels
+static const char* level_names[] = {
+    [prio_normal] = "normal",
+    [prio_low] = "low",
+    [prio_idle] = "idle",
+};
+
+/** Background scheduling context. */
+struct priority {
+    enum priority_level level; ///< Priority of background threads
+#ifdef __linux__
+    cpu_set_t cpus; ///< CPU affinity mask
+    bool affinity;  ///< Affinity mask is set
+#endif
+};
+
+static struct priority ctx;
+
+#ifdef __linux__
+/**
+ * Parse list of CPUs.
+ * @param list comma separated CPU numbers or ranges, e.g. "0-3,6"
+ * @param cpus output CPU set
+ * @return false if list is invalid
+ */
+static bool parse_cpus(const char* list, cpu_set_t* cpus)
+{
+    CPU_ZERO(cpus);
+
+    while (*list) {
+        unsigned long first, last;
+        char* end;
+
+        first = strtoul(list, &end, 10);
+        if (end == list) {
+            return false;
+        }
+        last = first;
+        if (*end == '-') {
+            list = end + 1;
+            last = strtoul(list, &end, 10);
+            if (end == list || last < first) {
+                return false;
+            }
+        }
+        if (last >= CPU_SETSIZE) {
+            return false;
+        }
+        for (; first <= last; ++first) {
+            CPU_SET(first, cpus);
+        }
+
+        list = end;
+        if (*list == ',') {
+            ++list;
+        } else if (*list) {
+            return false;
+        }
+    }
+
+    return CPU_COUNT(cpus) != 0;
+}
+
+/**
+ * Set I/O priority of the calling thread (no wrapper in libc).
+ * @param prio I/O priority value
+ */
+static void set_ioprio(int prio)
+{
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, prio);
+}
+#endif // __linux__
+
+void priority_init(const struct config* cfg)
+{
+    const char* cpus;
+
+    memset(&ctx, 0, sizeof(ctx));
+
+    ctx.level = config_get_oneof(cfg, CFG_GENERAL, CFG_GNRL_BKG_PRIO,
+                                 level_names, ARRAY_SIZE(level_names));
+
+    cpus = config_get(cfg, CFG_GENERAL, CFG_GNRL_BKG_CPUS);
+    if (strcmp(cpus, "all") != 0) {
+#ifdef __linux__
+        ctx.affinity = parse_cpus(cpus, &ctx.cpus);
+        if (!ctx.affinity) {
+            config_error_val(CFG_GENERAL, CFG_GNRL_BKG_CPUS);
+        }
+#else
+        config_error_val(CFG_GENERAL, CFG_GNRL_BKG_CPUS);
+#endif
+    }
+}
+
+void priority_background(void)
+{
+#ifdef __linux__
+    const struct sched_param param = { 0 };
+    int nice;
+
+    // nice value and I/O priority are per-thread attributes in Linux
+    switch (ctx.level) {
+        case prio_normal:
+            break;
+        case prio_low:
+            // relative to the nice value inherited from the main thread
+            nice = getpriority(PRIO_PROCESS, 0) + LOW_NICE;
+            setpriority(PRIO_PROCESS, 0, nice < MAX_NICE ? nice : MAX_NICE);
+            set_ioprio(IOPRIO_VALUE(IOPRIO_CLASS_BE, IOPRIO_BE_LOWEST));
+            break;
+        case prio_idle:
+            pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+            set_ioprio(IOPRIO_VALUE(IOPRIO_CLASS_IDLE, 0));
+            break;
+    }
+
+    if (ctx.affinity) {
+        pthread_setaffinity_np(pthread_self(), sizeof(ctx.cpus), &ctx.cpus);
+    }
+#endif // __linux__
+}
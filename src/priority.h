@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: MIT
+// Scheduling priority of background threads.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include "config.h"
+
+/**
+ * Initialize scheduling parameters used by background threads.
+ * @param cfg config instance
+ */
+void priority_init(const struct config* cfg);
+
+/**
+ * Apply background scheduling parameters to the calling thread: CPU and I/O
+ * priority are lowered, so the thread doesn't compete with the foreground
+ * work (UI, redraw and scaling of the visible image), and the thread is bound
+ * to the configured set of CPUs.
+ */
+void priority_background(void);
@@ -0,0 +1,251 @@
+// SPDX-License-Identifier: MIT
+// Allocator of pixel buffers with reuse of freed ones.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+// MAP_ANONYMOUS and madvise()
+#define _DEFAULT_SOURCE
+
+#include "pxalloc.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Min size of buffer that is mapped directly instead of heap allocation
+#define LARGE_SIZE (2 * 1024 * 1024)
+// Size of the buffer header, keeps pixel data aligned for SIMD
+#define HEADER_SIZE 64
+// Max number of free buffers kept for reuse
+#define POOL_SLOTS 16
+// Max total size of free buffers kept in RAM (bytes)
+#define POOL_RESIDENT (64 * 1024 * 1024)
+
+// Freed pages of anonymous mapping are zero filled on the next access
+#ifdef __linux__
+#define HAVE_DONTNEED_ZERO
+#endif
+
+/** Header of the buffer. */
+struct header {
+    size_t size; ///< Total size of the buffer including header
+    bool mapped; ///< Buffer is mapped, otherwise allocated on the heap
+};
+
+/** Free buffer in the pool. */
+struct pool_entry {
+    struct header* buf; ///< Buffer address
+    size_t size;        ///< Total size of the buffer
+    bool mapped;        ///< Buffer is mapped
+    bool resident;      ///< Pages are in RAM and may contain garbage
+};
+
+/** Allocator context. */
+struct pxalloc_context {
+    pthread_mutex_t lock;               ///< Pool access lock
+    struct pool_entry pool[POOL_SLOTS]; ///< Free buffers, the oldest first
+    size_t pool_num;                    ///< Number of free buffers
+    size_t resident;                    ///< Size of resident free buffers
+    size_t hits;                        ///< Allocations served from pool
+    size_t misses;                      ///< Allocations of new buffers
+};
+
+/** Global allocator context. */
+static struct pxalloc_context ctx = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/**
+ * Get total size of the buffer.
+ * @param size size of the pixel data
+ * @param mapped flag of mapped buffer, size is aligned to page
+ * @return total size including header
+ */
+static size_t buffer_size(size_t size, bool mapped)
+{
+    size += HEADER_SIZE;
+    if (mapped) {
+        const size_t page = sysconf(_SC_PAGESIZE);
+        size = (size + page - 1) & ~(page - 1);
+    }
+    return size;
+}
+
+/**
+ * Allocate new buffer.
+ * @param size total size of the buffer
+ * @param mapped flag to map the buffer
+ * @param zero flag to fill the buffer with zeros
+ * @return pointer to the buffer or NULL if not enough memory
+ */
+static struct header* create_buffer(size_t size, bool mapped, bool zero)
+{
+    struct header* buf;
+
+    if (mapped) {
+        buf = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buf == MAP_FAILED) {
+            return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        // fewer page faults on the first access
+        madvise(buf, size, MADV_HUGEPAGE);
+#endif
+    } else {
+        buf = zero ? calloc(1, size) : malloc(size);
+    }
+
+    return buf;
+}
+
+/**
+ * Return buffer to the system.
+ * @param entry pool entry that describes the buffer
+ */
+static void release_buffer(const struct pool_entry* entry)
+{
+    if (entry->mapped) {
+        munmap(entry->buf, entry->size);
+    } else {
+        free(entry->buf);
+    }
+}
+
+/**
+ * Put free buffer to the pool, the oldest one is evicted from the full pool.
+ * Must be called with locked mutex.
+ * @param entry buffer to put
+ * @param evicted output evicted buffer, its size is 0 if nothing was evicted
+ */
+static void pool_put(const struct pool_entry* entry, struct pool_entry* evicted)
+{
+    evicted->size = 0;
+
+    if (ctx.pool_num == POOL_SLOTS) {
+        *evicted = ctx.pool[0];
+        if (evicted->resident) {
+            ctx.resident -= evicted->size;
+        }
+        --ctx.pool_num;
+        memmove(&ctx.pool[0], &ctx.pool[1],
+                ctx.pool_num * sizeof(struct pool_entry));
+    }
+
+    ctx.pool[ctx.pool_num++] = *entry;
+    if (entry->resident) {
+        ctx.resident += entry->size;
+    }
+}
+
+void* pxalloc(size_t size, bool zero)
+{
+    const bool mapped = size >= LARGE_SIZE;
+    struct pool_entry entry = { .size = buffer_size(size, mapped) };
+
+    pthread_mutex_lock(&ctx.lock);
+    for (size_t i = ctx.pool_num; i > 0; --i) {
+        if (ctx.pool[i - 1].size == entry.size &&
+            ctx.pool[i - 1].mapped == mapped) {
+            entry = ctx.pool[i - 1];
+            if (entry.resident) {
+                ctx.resident -= entry.size;
+            }
+            --ctx.pool_num;
+            memmove(&ctx.pool[i - 1], &ctx.pool[i],
+                    (ctx.pool_num - (i - 1)) * sizeof(struct pool_entry));
+            break;
+        }
+    }
+    if (entry.buf) {
+        ++ctx.hits;
+    } else {
+        ++ctx.misses;
+    }
+    pthread_mutex_unlock(&ctx.lock);
+
+    if (entry.buf) {
+        if (zero && entry.resident) {
+            memset((uint8_t*)entry.buf + HEADER_SIZE, 0, size);
+        }
+    } else {
+        entry.buf = create_buffer(entry.size, mapped, zero);
+        if (!entry.buf) {
+            return NULL;
+        }
+    }
+
+    entry.buf->size = entry.size;
+    entry.buf->mapped = mapped;
+
+    return (uint8_t*)entry.buf + HEADER_SIZE;
+}
+
+void pxfree(void* ptr)
+{
+    struct pool_entry entry, evicted;
+
+    if (!ptr) {
+        return;
+    }
+
+    entry.buf = (struct header*)((uint8_t*)ptr - HEADER_SIZE);
+    entry.size = entry.buf->size;
+    entry.mapped = entry.buf->mapped;
+    entry.resident = true;
+
+    pthread_mutex_lock(&ctx.lock);
+    if (ctx.resident + entry.size <= POOL_RESIDENT) {
+        pool_put(&entry, &evicted);
+        pthread_mutex_unlock(&ctx.lock);
+        if (evicted.size) {
+            release_buffer(&evicted);
+        }
+        return;
+    }
+    pthread_mutex_unlock(&ctx.lock);
+
+#ifdef HAVE_DONTNEED_ZERO
+    if (entry.mapped) {
+        // return pages to the system but keep the mapping for reuse
+        madvise(entry.buf, entry.size, MADV_DONTNEED);
+        entry.resident = false;
+        pthread_mutex_lock(&ctx.lock);
+        pool_put(&entry, &evicted);
+        pthread_mutex_unlock(&ctx.lock);
+        if (evicted.size) {
+            release_buffer(&evicted);
+        }
+        return;
+    }
+#endif
+
+    release_buffer(&entry);
+}
+
+void pxalloc_trim(void)
+{
+    struct pool_entry pool[POOL_SLOTS];
+    size_t num;
+
+    pthread_mutex_lock(&ctx.lock);
+    num = ctx.pool_num;
+    memcpy(pool, ctx.pool, num * sizeof(struct pool_entry));
+    ctx.pool_num = 0;
+    ctx.resident = 0;
+    pthread_mutex_unlock(&ctx.lock);
+
+    for (size_t i = 0; i < num; ++i) {
+        release_buffer(&pool[i]);
+    }
+}
+
+void pxalloc_stats(struct pxalloc_stats* stats)
+{
+    pthread_mutex_lock(&ctx.lock);
+    stats->pooled = ctx.pool_num;
+    stats->resident = ctx.resident;
+    stats->hits = ctx.hits;
+    stats->misses = ctx.misses;
+    pthread_mutex_unlock(&ctx.lock);
+}
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: MIT
+// Allocator of pixel buffers with reuse of freed ones.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Allocator statistics. */
+struct pxalloc_stats {
+    size_t pooled;   ///< Number of free buffers kept for reuse
+    size_t resident; ///< Size of free buffers that are still in RAM (bytes)
+    size_t hits;     ///< Number of allocations served from the pool
+    size_t misses;   ///< Number of allocations that required new buffer
+};
+
+/**
+ * Allocate pixel buffer, can be called from any thread.
+ * Large buffers are mapped directly (with transparent huge pages where
+ * available), buffers of the same size freed earlier are reused.
+ * @param size size of the buffer in bytes
+ * @param zero flag to fill the buffer with zeros
+ * @return pointer to the buffer or NULL if not enough memory
+ */
+void* pxalloc(size_t size, bool zero);
+
+/**
+ * Free pixel buffer, can be called from any thread.
+ * Memory of large buffers that don't fit the pool budget is returned to the
+ * system immediately.
+ * @param ptr pointer to the buffer allocated by `pxalloc`, can be NULL
+ */
+void pxfree(void* ptr);
+
+/**
+ * Release all free buffers kept for reuse.
+ */
+void pxalloc_trim(void);
+
+/**
+ * Get allocator statistics.
+ * @param stats output statistics
+ */
+void pxalloc_stats(struct pxalloc_stats* stats);
@@ -13,54 +13,6 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
-/**
- * Read stdout from child process.
- * @param fd stdout file descriptor
- * @param out pointer to stdout buffer, caller should free the buffer
- * @param sz size of output buffer
- * @return 0 on sucess or error code
- */
-static int read_stdout(int fd, uint8_t** out, size_t* sz)
-{
-    int rc = 0;
-    ssize_t read_sz;
-    uint8_t buf[4096];
-    uint8_t* tmp;
-
-    while (!rc) {
-        read_sz = read(fd, buf, sizeof(buf));
-        if (read_sz == 0) {
-            break;
-        }
-        if (read_sz == -1) {
-            if (errno == EAGAIN) {
-                continue;
-            } else {
-                rc = errno;
-                break;
-            }
-        }
-
-        tmp = realloc(*out, *sz + read_sz);
-        if (!tmp) {
-            rc = ENOMEM;
-            break;
-        }
-        memcpy(tmp + *sz, buf, read_sz);
-
-        *sz += read_sz;
-        *out = tmp;
-    }
-
-    if (rc && *sz) {
-        free(*out);
-        *out = NULL;
-        *sz = 0;
-    }
-
-    return rc;
-}
-
 /**
  * Execute command in child process.
  * @param cmd command to execute
@@ -121,7 +73,7 @@ int shellcmd_exec(const char* cmd, uint8_t** out, size_t* sz)
 
     // parent process handling
     close(pfd[1]);
-    read_stdout(pfd[0], out, sz);
+    fd_read_all(pfd[0], out, sz);
     close(pfd[0]);
 
     if (waitpid(pid, &rc, 0) == -1) {
@@ -165,21 +117,9 @@ int shellcmd_expr(const char* expr, const char* path, char** out)
         return EINVAL;
     }
 
+    // output buffer is already null-terminated
     rc = shellcmd_exec(cmd, (uint8_t**)out, &out_sz);
 
-    if (out_sz) {
-        // add last null
-        char* tmp = realloc(*out, out_sz + 1);
-        if (tmp) {
-            tmp[out_sz] = 0;
-            *out = tmp;
-        } else {
-            rc = ENOMEM;
-            free(*out);
-            *out = NULL;
-        }
-    }
-
     free(cmd);
 
     return rc;
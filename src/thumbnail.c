@@ -5,25 +5,41 @@
 #include "thumbnail.h"
 
 #include "array.h"
+#include "atlas.h"
 #include "buildcfg.h"
+#include "hashmap.h"
 #include "imagelist.h"
+#include "info.h"
+#include "loader.h"
+#include "memcache.h"
+#include "priority.h"
+#include "tpool.h"
+#include "tstore.h"
 
+#include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef HAVE_LIBPNG
-#define THUMBNAIL_PSTORE
+#include "fdthumb.h"
+#endif
+
+/** Modes of shared thumbnails. */
+enum shared_mode {
+    shared_no,    ///< Don't use shared thumbnails
+    shared_read,  ///< Load thumbnails created by other applications
+    shared_write, ///< Load and create shared thumbnails
+};
 
-#include "formats/png.h"
-#include "loader.h"
+// Names of shared thumbnails modes
+static const char* shared_names[] = { CFG_NO, "read", "write" };
 
-#include <errno.h>
-#include <fcntl.h>
-#include <pthread.h>
-#include <stdio.h>
-#include <string.h>
-#include <sys/stat.h>
-#include <unistd.h>
-#endif // HAVE_LIBPNG
+/** State of the persistent storage, it is opened on the first use. */
+enum pstore_state {
+    pstore_closed, ///< Not opened yet
+    pstore_ready,  ///< Opened, saver thread is running
+    pstore_failed, ///< Unable to open
+};
 
 /** Thumbnail context. */
 struct thumbnail_context {
@@ -31,8 +47,15 @@ struct thumbnail_context {
     bool fill;                ///< Scale mode (fill/fit)
     enum aa_mode aa_mode;     ///< Anti-aliasing mode
     struct thumbnail* thumbs; ///< List of thumbnails
+    struct hashmap index;     ///< Thumbnails by image index
+    struct atlas atlas;       ///< Pixels of thumbnails
+    bool meta;                ///< Meta info (EXIF) is displayed in gallery
 
     bool pstore;             ///< Use persistent storage for thumbnails
+    size_t pstore_limit;     ///< Max size of persistent storage in bytes
+    enum pstore_state state; ///< Persistent storage state
+    pthread_mutex_t open;    ///< Persistent storage opening lock
+    enum shared_mode shared; ///< Use of shared (freedesktop) thumbnails
     pthread_t tid;           ///< Background loader thread id
     struct thumbnail* queue; ///< Background thread loader queue
     pthread_cond_t signal;   ///< Queue notification
@@ -58,128 +81,131 @@ static struct thumbnail* allocate_entry(struct image* image, size_t width,
         entry->image = image;
         entry->width = width;
         entry->height = height;
+        entry->meta = NULL;
+        entry->meta_size = 0;
     }
 
     return entry;
 }
 
-#ifdef THUMBNAIL_PSTORE
 /**
- * Get path for the thumbnail on persistent storage.
- * @param source original image source
- * @return path or NULL if not applicable or in case of errors
+ * Free entry that is not linked to the cache.
+ * @param entry thumbnail entry to free
  */
-static char* pstore_path(const char* source)
+static void release_entry(struct thumbnail* entry)
 {
-    char* path = NULL;
-
-    if (strcmp(source, LDRSRC_STDIN) == 0 ||
-        strncmp(source, LDRSRC_EXEC, LDRSRC_EXEC_LEN) == 0) {
-        return NULL;
-    }
+    struct image* image = entry->image;
 
-    path = config_expand_path("XDG_CACHE_HOME", "/swayimg");
-    if (!path) {
-        path = config_expand_path("HOME", "/.cache/swayimg");
-    }
-    if (path) {
-        char state[16];
-        snprintf(state, sizeof(state), ".%04x%d%d", (uint16_t)ctx.size,
-                 ctx.fill ? 1 : 0, ctx.aa_mode);
-        str_append(source, 0, &path);
-        str_append(state, 0, &path);
+    if (image->num_frames &&
+        atlas_release(&ctx.atlas, image->frames[0].pm.data)) {
+        image->frames[0].pm.data = NULL;
     }
+    image_free(image);
+    free(entry->meta);
+    free(entry);
+}
 
-    return path;
+/**
+ * Remove entry from the list and free it.
+ * @param entry thumbnail entry to free
+ */
+static void free_entry(struct thumbnail* entry)
+{
+    ctx.thumbs = list_unlink(ctx.thumbs, entry);
+    hashmap_remove(&ctx.index, entry->image->index);
+    memcache_remove(entry->image);
+    release_entry(entry);
 }
 
 /**
- * Write thumbnail on persistent storage.
- * @param thumb thumbnail instance to save
+ * Pack thumbnail to save memory: meta info is serialized to a single block
+ * and pixels are moved to the atlas.
+ * @param entry thumbnail entry to pack
+ * @return false if not enough memory
  */
-static void pstore_save(const struct thumbnail* thumb)
+static bool pack_entry(struct thumbnail* entry)
 {
-    char* th_path;
-    char* delim;
+    struct image* image = entry->image;
+    struct image_frame* frame;
+    struct pixmap pm;
+    argb_t* slot;
 
-    th_path = pstore_path(thumb->image->source);
-    if (!th_path) {
-        return;
+    if (!image->num_frames ||
+        !image_pack_meta(image, &entry->meta, &entry->meta_size)) {
+        return false;
     }
+    image_free_meta(image);
 
-    // create path
-    delim = th_path;
-    while (true) {
-        delim = strchr(delim + 1, '/');
-        if (!delim) {
-            break;
-        }
-        *delim = '\0';
-        if (mkdir(th_path, S_IRWXU | S_IRWXG) && errno != EEXIST) {
-            free(th_path);
-            return;
-        }
-        *delim = '/';
+    // compact or larger than slot thumbnail stays on the heap
+    pm = image->frames[0].pm;
+    if (pm.format != pixfmt_argb ||
+        pm.width * pm.height > ctx.atlas.slot_size) {
+        return true;
+    }
+    slot = atlas_alloc(&ctx.atlas);
+    if (!slot) {
+        return true;
+    }
+    memcpy(slot, pm.data, pm.width * pm.height * sizeof(argb_t));
+    image_free_frames(image);
+    frame = image_create_frames(image, 1);
+    if (!frame) {
+        atlas_release(&ctx.atlas, slot);
+        return false;
     }
+    frame->pm.width = pm.width;
+    frame->pm.height = pm.height;
+    frame->pm.data = slot;
 
-    // save thumbnail
-    export_png(&thumb->image->frames[0].pm, thumb->image->info, th_path);
+    return true;
+}
 
-    free(th_path);
+/**
+ * Free entry of the pstore saving queue, the image is owned by the cache.
+ * @param entry queued entry to free
+ */
+static void free_queued(struct thumbnail* entry)
+{
+    free(entry->meta);
+    free(entry);
 }
 
 /**
- * Load thumbnail from persistent storage.
- * @param index image position in the image list
- * @return thumbnail instance or NULL if not found
+ * Get parameters of thumbnails in persistent storage.
+ * @return thumbnail parameters
  */
-const struct thumbnail* pstore_load(size_t index)
+static uint32_t pstore_params(void)
 {
-    struct thumbnail* entry;
-    struct image* thumb;
-    struct stat st_origin;
-    struct stat st_thumb;
-    char* path_thumb;
-    const char* path_origin;
-
-    path_origin = image_list_get(index);
-    if (!path_origin) {
-        return NULL;
-    }
-    path_thumb = pstore_path(path_origin);
-    if (!path_thumb) {
-        return NULL;
-    }
+    return (uint32_t)ctx.size | (ctx.fill ? 1 << 16 : 0) |
+        (uint32_t)__atomic_load_n(&ctx.aa_mode, __ATOMIC_RELAXED) << 17;
+}
 
-    // check modification time
-    if (stat(path_origin, &st_origin) == -1 ||
-        stat(path_thumb, &st_thumb) == -1 ||
-        st_origin.st_mtim.tv_sec > st_thumb.st_mtim.tv_sec) {
-        free(path_thumb);
-        return NULL;
-    }
+/**
+ * Get status of the original image file.
+ * @param source original image source
+ * @param st destination file status
+ * @return false if not applicable or in case of errors
+ */
+static bool source_stat(const char* source, struct stat* st)
+{
+    return strcmp(source, LDRSRC_STDIN) != 0 &&
+        strncmp(source, LDRSRC_EXEC, LDRSRC_EXEC_LEN) != 0 &&
+        stat(source, st) == 0;
+}
 
-    if (loader_from_source(path_thumb, &thumb) != ldr_success) {
-        free(path_thumb);
-        return NULL;
-    }
+/**
+ * Write thumbnail on persistent storage.
+ * @param image thumbnail image to save
+ * @param meta,meta_size packed meta info of the image
+ */
+static void pstore_save(const struct image* image, const char* meta,
+                        size_t meta_size)
+{
+    struct stat st;
 
-    // TODO: move to image instance
-    thumb->index = index;
-    str_dup(path_origin, &thumb->source);
-    thumb->name = strrchr(thumb->source, '/');
-    if (!thumb->name || strcmp(thumb->name, "/") == 0) {
-        thumb->name = thumb->source;
-    } else {
-        ++thumb->name; // skip slash
+    if (source_stat(image->source, &st)) {
+        tstore_save(image, meta, meta_size, &st, pstore_params());
     }
-
-    entry = allocate_entry(thumb, 0, 0);
-    ctx.thumbs = list_append(ctx.thumbs, entry);
-
-    free(path_thumb);
-
-    return entry;
 }
 
 /**
@@ -190,7 +216,7 @@ static void pstore_reset(bool stop)
 {
     pthread_mutex_lock(&ctx.lock);
     list_for_each(ctx.queue, struct thumbnail, it) {
-        free(it);
+        free_queued(it);
     }
     if (stop) {
         ctx.queue = list_append(NULL, allocate_entry(NULL, 0, 0));
@@ -201,11 +227,32 @@ static void pstore_reset(bool stop)
     pthread_mutex_unlock(&ctx.lock);
 }
 
+/**
+ * Remove thumbnail from pstore saving queue.
+ * @param image thumbnail image
+ */
+static void pstore_cancel(const struct image* image)
+{
+    pthread_mutex_lock(&ctx.lock);
+    list_for_each(ctx.queue, struct thumbnail, it) {
+        if (it->image == image) {
+            ctx.queue = list_remove(it);
+            free_queued(it);
+        }
+    }
+    pthread_mutex_unlock(&ctx.lock);
+}
+
 /** Thumbnail saver executed in background thread. */
 static void* pstore_saver_thread(__attribute__((unused)) void* data)
 {
     struct thumbnail* entry;
 
+    priority_background();
+
+    // remove garbage left by outdated thumbnails
+    tstore_compact(false);
+
     while (true) {
         pthread_mutex_lock(&ctx.lock);
         while (!ctx.queue) {
@@ -220,49 +267,283 @@ static void* pstore_saver_thread(__attribute__((unused)) void* data)
             break;
         }
 
-        pstore_save(entry);
+        pstore_save(entry->image, entry->meta, entry->meta_size);
 
-        free(entry);
+        free_queued(entry);
         pthread_mutex_unlock(&ctx.lock);
+
+        // evict old thumbnails if the size limit is exceeded
+        tstore_compact(false);
     }
 
     return NULL;
 }
-#endif // THUMBNAIL_PSTORE
+
+/**
+ * Open persistent storage and start saver thread on the first use, so
+ * viewer-only sessions don't spend any time on it.
+ * Can be called from any thread.
+ * @return true if persistent storage is available
+ */
+static bool pstore_open(void)
+{
+    enum pstore_state state;
+
+    if (!ctx.pstore) {
+        return false;
+    }
+
+    state = __atomic_load_n(&ctx.state, __ATOMIC_ACQUIRE);
+    if (state == pstore_closed) {
+        pthread_mutex_lock(&ctx.open);
+        state = __atomic_load_n(&ctx.state, __ATOMIC_ACQUIRE);
+        if (state == pstore_closed) {
+            state = pstore_failed;
+            if (tstore_init(ctx.pstore_limit)) {
+                if (pthread_create(&ctx.tid, NULL, pstore_saver_thread,
+                                   NULL) == 0) {
+                    state = pstore_ready;
+                } else {
+                    tstore_destroy();
+                }
+            }
+            __atomic_store_n(&ctx.state, state, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&ctx.open);
+    }
+
+    return state == pstore_ready;
+}
+
+/**
+ * Thumbnail eviction handler, see `memcache_evict_fn`.
+ * @param image thumbnail image
+ * @param pressure eviction is caused by memory pressure
+ */
+static void evict_thumbnail(struct image* image,
+                            __attribute__((unused)) bool pressure)
+{
+    struct thumbnail* entry;
+
+    if (ctx.pstore) {
+        pstore_cancel(image);
+    }
+
+    entry = hashmap_get(&ctx.index, image->index);
+    if (entry && entry->image == image) {
+        free_entry(entry);
+    }
+}
+
+/**
+ * Add entry to the cache, the previous thumbnail of the image is replaced.
+ * @param entry thumbnail entry to add
+ * @return false if not enough memory
+ */
+static bool insert_entry(struct thumbnail* entry)
+{
+    const size_t index = entry->image->index;
+    const struct thumbnail* old = hashmap_get(&ctx.index, index);
+
+    if (old) {
+        evict_thumbnail(old->image, false);
+    }
+    if (!hashmap_put(&ctx.index, index, entry)) {
+        return false;
+    }
+    ctx.thumbs = list_add(ctx.thumbs, entry);
+    memcache_put(entry->image, evict_thumbnail);
+
+    return true;
+}
+
+/**
+ * Reduce image to the thumbnail: the first frame is replaced with the scaled
+ * one, the real size of the image is kept in `full_width` and `full_height`.
+ * @param image image to reduce
+ * @return false on errors
+ */
+static bool create_thumbnail(struct image* image)
+{
+    struct pixmap thumb;
+    struct image_frame* frame;
+    ssize_t offset_x, offset_y;
+    const struct pixmap* full;
+    size_t width, height;
+    size_t thumb_width, thumb_height;
+    size_t real_width, real_height;
+    float scale_width, scale_height, scale;
+
+    if (!image->num_frames) {
+        return false;
+    }
+
+    // don't parse EXIF if it is never displayed
+    if (ctx.meta) {
+        loader_load_meta(image);
+    } else {
+        image_set_exif(image, NULL, 0);
+    }
+
+    full = &image->frames[0].pm;
+    width = image_get_width(image);
+    height = image_get_height(image);
+    scale_width = 1.0 / ((float)width / ctx.size);
+    scale_height = 1.0 / ((float)height / ctx.size);
+    scale = ctx.fill ? max(scale_width, scale_height)
+                     : min(scale_width, scale_height);
+    thumb_width = scale * width;
+    thumb_height = scale * height;
+    real_width = width;
+    real_height = height;
+
+    if (image->full_width) {
+        // image was reduced by decoder
+        const bool transpose = image->orient & orient_transpose;
+        real_width = transpose ? image->full_height : image->full_width;
+        real_height = transpose ? image->full_width : image->full_height;
+    }
+
+    if (ctx.fill) {
+        offset_x = ctx.size / 2 - thumb_width / 2;
+        offset_y = ctx.size / 2 - thumb_height / 2;
+        thumb_width = ctx.size;
+        thumb_height = ctx.size;
+    } else {
+        offset_x = 0;
+        offset_y = 0;
+    }
+
+    // create thumbnail from image (replace the first frame)
+    if (!pixmap_create(&thumb, thumb_width, thumb_height)) {
+        return false;
+    }
+    pixmap_scale_mipmap(__atomic_load_n(&ctx.aa_mode, __ATOMIC_RELAXED),
+                        full, NULL, 0, &thumb, offset_x, offset_y, scale,
+                        image->alpha, image->orient);
+    if (!image->alpha) {
+        pixmap_compact(&thumb); // grayscale takes 4x less memory
+    }
+    image_free_frames(image);
+    image->orient = orient_normal; // thumbnail is already transformed
+    frame = image_create_frames(image, 1);
+    if (!frame) {
+        pixmap_free(&thumb);
+        return false;
+    }
+    frame->pm = thumb;
+
+    image->full_width = real_width;
+    image->full_height = real_height;
+    image->thumbnail = true;
+
+    return true;
+}
+
+/**
+ * Reduce image to the thumbnail and put it to the persistent storage.
+ * @param image image to reduce
+ */
+static void reduce_image(struct image* image)
+{
+    char* meta;
+    size_t meta_size;
+
+    if (create_thumbnail(image) &&
+        (image->full_width > ctx.size || image->full_height > ctx.size) &&
+        pstore_open() && image_pack_meta(image, &meta, &meta_size)) {
+        pstore_save(image, meta, meta_size);
+        free(meta);
+    }
+}
+
+#ifdef HAVE_LIBPNG
+/**
+ * Create shared thumbnail for other applications.
+ * @param image original image
+ */
+static void shared_save(const struct image* image)
+{
+    const size_t max_size = fdthumb_size(ctx.size);
+    size_t width, height, real_width, real_height;
+    struct pixmap thumb;
+    struct stat st;
+    float scale;
+
+    if (!max_size || !image->num_frames ||
+        !source_stat(image->source, &st)) {
+        return;
+    }
+
+    width = image_get_width(image);
+    height = image_get_height(image);
+    scale = min((float)max_size / width, (float)max_size / height);
+    if (scale >= 1.0) {
+        return; // image is smaller than the thumbnail
+    }
+
+    real_width = width;
+    real_height = height;
+    if (image->full_width) {
+        // image was reduced by decoder
+        const bool transpose = image->orient & orient_transpose;
+        real_width = transpose ? image->full_height : image->full_width;
+        real_height = transpose ? image->full_width : image->full_height;
+    }
+
+    if (pixmap_create(&thumb, max(1, width * scale), max(1, height * scale))) {
+        pixmap_scale_mipmap(__atomic_load_n(&ctx.aa_mode, __ATOMIC_RELAXED),
+                            &image->frames[0].pm, NULL, 0, &thumb, 0, 0,
+                            scale, image->alpha, image->orient);
+        fdthumb_save(&thumb, image->source, &st, real_width, real_height);
+        pixmap_free(&thumb);
+    }
+}
+#endif // HAVE_LIBPNG
 
 void thumbnail_init(const struct config* cfg)
 {
     ctx.size = config_get_num(cfg, CFG_GALLERY, CFG_GLRY_SIZE, 1, 1024);
     ctx.fill = config_get_bool(cfg, CFG_GALLERY, CFG_GLRY_FILL);
     ctx.aa_mode = aa_init(cfg, CFG_GALLERY, CFG_GLRY_AA);
+    ctx.meta = info_has_field(cfg, CFG_MODE_GALLERY, info_exif);
+    atlas_init(&ctx.atlas, ctx.size * ctx.size);
+
+#ifdef HAVE_LIBPNG
+    ctx.shared = config_get_oneof(cfg, CFG_GALLERY, CFG_GLRY_SHARED,
+                                  shared_names, ARRAY_SIZE(shared_names));
+#endif // HAVE_LIBPNG
 
-#ifdef THUMBNAIL_PSTORE
     ctx.pstore = config_get_bool(cfg, CFG_GALLERY, CFG_GLRY_PSTORE);
     if (ctx.pstore) {
+        ctx.pstore_limit = config_get_num(cfg, CFG_GALLERY, CFG_GLRY_PSTORE_LM,
+                                          0, 1024 * 1024) *
+            1024 * 1024;
+        ctx.state = pstore_closed;
+        pthread_mutex_init(&ctx.open, NULL);
         pthread_mutex_init(&ctx.lock, NULL);
         pthread_cond_init(&ctx.signal, NULL);
-        pthread_create(&ctx.tid, NULL, pstore_saver_thread, NULL);
     }
-#endif // THUMBNAIL_PSTORE
 }
 
 void thumbnail_free(void)
 {
-#ifdef THUMBNAIL_PSTORE
     if (ctx.pstore) {
-        if (ctx.tid) {
+        if (ctx.state == pstore_ready) {
             pstore_reset(true);
             pthread_join(ctx.tid, NULL);
+            tstore_destroy();
         }
+        pthread_mutex_destroy(&ctx.open);
         pthread_mutex_destroy(&ctx.lock);
         pthread_cond_destroy(&ctx.signal);
     }
-#endif // THUMBNAIL_PSTORE
 
     list_for_each(ctx.thumbs, struct thumbnail, it) {
-        image_free(it->image);
-        free(it);
+        free_entry(it);
     }
+    hashmap_free(&ctx.index);
+    atlas_free(&ctx.atlas);
 }
 
 enum aa_mode thumbnail_get_aa(void)
@@ -272,126 +553,186 @@ enum aa_mode thumbnail_get_aa(void)
 
 enum aa_mode thumbnail_switch_aa(const char* opt)
 {
-    ctx.aa_mode = aa_switch(ctx.aa_mode, opt);
-    return ctx.aa_mode;
+    const enum aa_mode aa = aa_switch(ctx.aa_mode, opt);
+    __atomic_store_n(&ctx.aa_mode, aa, __ATOMIC_RELAXED);
+    return aa;
 }
 
-void thumbnail_add(struct image* image)
+void thumbnail_prepare(struct image* image)
 {
-    struct thumbnail* entry;
-    struct pixmap thumb;
-    struct image_frame* frame;
-    ssize_t offset_x, offset_y;
+    // decoders work in parallel, so the image is scaled in a single thread
+    tpool_set_serial(true);
+#ifdef HAVE_LIBPNG
+    if (ctx.shared == shared_write) {
+        shared_save(image);
+    }
+#endif // HAVE_LIBPNG
+    reduce_image(image);
+    tpool_set_serial(false);
+}
 
-    const struct pixmap* full = &image->frames[0].pm;
-    const size_t real_width = full->width;
-    const size_t real_height = full->height;
-    const float scale_width = 1.0 / ((float)real_width / ctx.size);
-    const float scale_height = 1.0 / ((float)real_height / ctx.size);
-    const float scale = ctx.fill ? max(scale_width, scale_height)
-                                 : min(scale_width, scale_height);
-    size_t thumb_width = scale * real_width;
-    size_t thumb_height = scale * real_height;
+bool thumbnail_stored(const char* source)
+{
+    struct stat st;
 
-    if (ctx.fill) {
-        offset_x = ctx.size / 2 - thumb_width / 2;
-        offset_y = ctx.size / 2 - thumb_height / 2;
-        thumb_width = ctx.size;
-        thumb_height = ctx.size;
-    } else {
-        offset_x = 0;
-        offset_y = 0;
+    return ctx.pstore && source_stat(source, &st) && pstore_open() &&
+        tstore_check(source, &st, pstore_params());
+}
+
+struct image* thumbnail_load(const char* source)
+{
+    struct image* thumb = NULL;
+    struct stat st;
+
+    if ((!ctx.pstore && ctx.shared == shared_no) ||
+        !source_stat(source, &st)) {
+        return NULL;
     }
 
-    // create thumbnail from image (replace the first frame)
-    if (!pixmap_create(&thumb, thumb_width, thumb_height)) {
-        image_free(image);
-        return;
+    if (pstore_open()) {
+        thumb = image_alloc();
+        if (thumb && tstore_load(thumb, source, &st, pstore_params())) {
+            image_set_source(thumb, source);
+        } else {
+            image_free(thumb);
+            thumb = NULL;
+        }
     }
-    pixmap_scale(ctx.aa_mode, full, &thumb, offset_x, offset_y, scale,
-                 image->alpha);
-    image_free_frames(image);
-    frame = image_create_frames(image, 1);
-    if (!frame) {
-        pixmap_free(&thumb);
+
+#ifdef HAVE_LIBPNG
+    if (!thumb && ctx.shared != shared_no) {
+        thumb = fdthumb_load(source, &st, ctx.size);
+        if (thumb) {
+            tpool_set_serial(true);
+            reduce_image(thumb);
+            tpool_set_serial(false);
+        }
+    }
+#endif // HAVE_LIBPNG
+
+    return thumb;
+}
+
+void thumbnail_add(struct image* image)
+{
+    struct thumbnail* entry;
+    const bool prepared = image->thumbnail;
+
+    if (!prepared && !create_thumbnail(image)) {
         image_free(image);
         return;
     }
-    frame->pm = thumb;
 
     // add entry to the list
-    entry = allocate_entry(image, real_width, real_height);
-    ctx.thumbs = list_append(ctx.thumbs, entry);
+    entry = allocate_entry(image, image->full_width, image->full_height);
+    if (!entry) {
+        image_free(image);
+        return;
+    }
+    if (!pack_entry(entry) || !insert_entry(entry)) {
+        release_entry(entry);
+        return;
+    }
 
-#ifdef THUMBNAIL_PSTORE
-    if (entry && ctx.pstore &&
-        (real_width > ctx.size || real_height > ctx.size)) {
-        // save thumbnail to persistent storage
+    if (!prepared && (entry->width > ctx.size || entry->height > ctx.size) &&
+        pstore_open()) {
+        // save thumbnail to persistent storage, the queued entry keeps its
+        // own copy of meta info as the cached one can be unpacked
         struct thumbnail* save_entry =
             allocate_entry(entry->image, entry->width, entry->height);
-        pthread_mutex_lock(&ctx.lock);
-        ctx.queue = list_append(ctx.queue, save_entry);
-        pthread_cond_signal(&ctx.signal);
-        pthread_mutex_unlock(&ctx.lock);
+        if (save_entry) {
+            save_entry->meta = malloc(entry->meta_size);
+            if (save_entry->meta) {
+                memcpy(save_entry->meta, entry->meta, entry->meta_size);
+                save_entry->meta_size = entry->meta_size;
+                pthread_mutex_lock(&ctx.lock);
+                ctx.queue = list_append(ctx.queue, save_entry);
+                pthread_cond_signal(&ctx.signal);
+                pthread_mutex_unlock(&ctx.lock);
+            } else {
+                free(save_entry);
+            }
+        }
     }
-#endif // THUMBNAIL_PSTORE
+
+    memcache_trim();
+}
+
+bool thumbnail_cached(size_t index)
+{
+    return hashmap_get(&ctx.index, index);
 }
 
 const struct thumbnail* thumbnail_get(size_t index)
 {
-    const struct thumbnail* thumb = NULL;
+    const struct thumbnail* thumb = hashmap_get(&ctx.index, index);
 
-    list_for_each(ctx.thumbs, struct thumbnail, it) {
-        if (it->image->index == index) {
-            thumb = it;
-            break;
-        }
+    if (thumb) {
+        memcache_touch(thumb->image);
     }
 
-#ifdef THUMBNAIL_PSTORE
-    if (!thumb && ctx.pstore) {
-        thumb = pstore_load(index);
+    return thumb;
+}
+
+const struct thumbnail* thumbnail_get_meta(size_t index)
+{
+    struct thumbnail* thumb = hashmap_get(&ctx.index, index);
+
+    if (thumb) {
+        if (thumb->meta) {
+            image_unpack_meta(thumb->image, thumb->image->source, thumb->meta,
+                              thumb->meta_size);
+            free(thumb->meta);
+            thumb->meta = NULL;
+            thumb->meta_size = 0;
+        }
+        memcache_touch(thumb->image);
     }
-#endif // THUMBNAIL_PSTORE
 
     return thumb;
 }
 
 void thumbnail_remove(size_t index)
 {
-#ifdef THUMBNAIL_PSTORE
+    struct thumbnail* entry;
+
     pstore_reset(false);
-#endif // THUMBNAIL_PSTORE
+
+    entry = hashmap_get(&ctx.index, index);
+    if (entry) {
+        free_entry(entry);
+    }
+}
+
+void thumbnail_remap(void)
+{
+    pstore_reset(false);
+
+    hashmap_free(&ctx.index);
 
     list_for_each(ctx.thumbs, struct thumbnail, it) {
-        if (it->image->index == index) {
-            ctx.thumbs = list_remove(it);
-            image_free(it->image);
-            free(it);
-            break;
+        struct image* img = it->image;
+        img->index = image_list_remap(img->index);
+        if (img->index == IMGLIST_INVALID ||
+            !hashmap_put(&ctx.index, img->index, it)) {
+            free_entry(it);
         }
     }
 }
 
 void thumbnail_clear(size_t min_id, size_t max_id)
 {
-#ifdef THUMBNAIL_PSTORE
     pstore_reset(false);
-#endif // THUMBNAIL_PSTORE
 
     if (min_id == IMGLIST_INVALID && max_id == IMGLIST_INVALID) {
         list_for_each(ctx.thumbs, struct thumbnail, it) {
-            ctx.thumbs = list_remove(it);
-            image_free(it->image);
-            free(it);
+            free_entry(it);
         }
     } else {
         list_for_each(ctx.thumbs, struct thumbnail, it) {
             if ((min_id != IMGLIST_INVALID && it->image->index < min_id) ||
                 (max_id != IMGLIST_INVALID && it->image->index > max_id)) {
-                ctx.thumbs = list_remove(it);
-                image_free(it->image);
-                free(it);
+                free_entry(it);
             }
         }
     }
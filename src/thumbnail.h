@@ -11,8 +11,10 @@
 /** List of thumbnails. */
 struct thumbnail {
     struct list list;     ///< Links to prev/next entry
-    struct image* image;  ///< Thumbnail image
+    struct image* image;  ///< Thumbnail image, pixels are stored in atlas
     size_t width, height; ///< Real image size
+    char* meta;           ///< Packed meta info, NULL if unpacked to image
+    size_t meta_size;     ///< Size of packed meta info
 };
 
 /**
@@ -39,12 +41,43 @@ enum aa_mode thumbnail_get_aa(void);
  */
 enum aa_mode thumbnail_switch_aa(const char* opt);
 
+/**
+ * Reduce the image to the thumbnail in the calling thread, used by background
+ * decoders (see `loader_hook`). Thumbnail is saved to the persistent storage
+ * here too, `thumbnail_add` only puts it to the cache.
+ * @param image original image, its frames are replaced by the thumbnail
+ */
+void thumbnail_prepare(struct image* image);
+
+/**
+ * Check if the persistent storage has the actual thumbnail of the image,
+ * the thumbnail is not loaded.
+ * @param source path to the original image
+ * @return true if thumbnail is stored
+ */
+bool thumbnail_stored(const char* source);
+
+/**
+ * Load thumbnail from the persistent storage, used by background decoders
+ * (see `loader_cache`).
+ * @param source path to the original image
+ * @return thumbnail image or NULL if not found
+ */
+struct image* thumbnail_load(const char* source);
+
 /**
  * Create new thumbnail from the image.
  * @param image original image, this instance will be replaced by thumbnail
  */
 void thumbnail_add(struct image* image);
 
+/**
+ * Check if thumbnail is in cache, doesn't affect its eviction priority.
+ * @param index image position in the image list
+ * @return true if thumbnail is cached
+ */
+bool thumbnail_cached(size_t index);
+
 /**
  * Get thumbnail.
  * @param index image position in the image list
@@ -52,6 +85,14 @@ void thumbnail_add(struct image* image);
  */
 const struct thumbnail* thumbnail_get(size_t index);
 
+/**
+ * Get thumbnail with meta info (format, EXIF etc), which is kept packed
+ * until it is requested for the first time.
+ * @param index image position in the image list
+ * @return thumbnail instance or NULL if not found
+ */
+const struct thumbnail* thumbnail_get_meta(size_t index);
+
 /**
  * Remove thumbnail from the cache.
  * @param index image position in the image list
@@ -63,3 +104,8 @@ void thumbnail_remove(size_t index);
  * @param min_id,max_id range of ids to save in cache
  */
 void thumbnail_clear(size_t min_id, size_t max_id);
+
+/**
+ * Update indices of cached thumbnails after the image list was changed.
+ */
+void thumbnail_remap(void);
@@ -0,0 +1,638 @@
+// SPDX-License-Identifier: MIT
+// Huge images decoded by tiles on demand.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "tiles.h"
+
+#include "application.h"
+#include "array.h"
+#include "list.h"
+#include "worker.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Min size of the image in bytes to decode it by tiles
+#define TILES_MIN_SIZE (256 * 1024 * 1024)
+
+// Max size of the overview (the first frame) in pixels
+#define TILES_OVERVIEW 2048
+
+// Max size of all cached tiles in bytes
+#define TILES_CACHE_SIZE (256 * 1024 * 1024)
+
+/** Level of the internal pyramid. */
+struct level {
+    struct tiles_level size; ///< Level size and tile size
+    size_t source;           ///< Index of the source level
+    size_t shift;            ///< Reduction of the source level (power of 2)
+};
+
+/** Cached tile. */
+struct tile {
+    struct list list; ///< Links to prev/next entry
+    size_t level;     ///< Level index
+    size_t col, row;  ///< Position of the tile in the grid
+    struct pixmap pm; ///< Tile pixels
+};
+
+/** Tile requested for decoding in background. */
+struct request {
+    struct list list; ///< Links to prev/next entry
+    size_t level;     ///< Level index
+    size_t col, row;  ///< Position of the tile in the grid
+};
+
+/** Tiled image context. */
+struct tiles {
+    struct tiles_source source; ///< Tile source
+    struct level levels[TILES_MAX_LEVELS * 2]; ///< Internal pyramid
+    size_t num_levels;                         ///< Number of levels
+    struct tile* cache;                        ///< Decoded tiles, MRU first
+    size_t cache_size;                         ///< Size of cached tiles
+
+    pthread_mutex_t lock;    ///< Cache and queue access lock
+    struct request* queue;   ///< Tiles to decode in background
+    struct request* active;  ///< Tile that is being decoded now
+    bool posted;             ///< Queue is processed by the worker
+    size_t generation;       ///< Generation of the image to notify
+};
+
+/**
+ * Build internal pyramid: source levels are complemented by virtual levels,
+ * so each level is not more than 2x smaller than the previous one and the
+ * last level fits the overview.
+ * @param ctx tiled image context
+ */
+static void build_pyramid(struct tiles* ctx)
+{
+    const struct tiles_source* src = &ctx->source;
+
+    for (size_t i = 0; i < src->num_levels; ++i) {
+        const struct tiles_level* sl = &src->levels[i];
+        const size_t next_width =
+            i + 1 < src->num_levels ? src->levels[i + 1].width : 0;
+
+        for (size_t shift = 0; ctx->num_levels < ARRAY_SIZE(ctx->levels);
+             ++shift) {
+            struct level* lvl = &ctx->levels[ctx->num_levels];
+            const size_t div = (size_t)1 << shift;
+
+            lvl->size.width = (sl->width + div - 1) / div;
+            lvl->size.height = (sl->height + div - 1) / div;
+            lvl->size.tile_width = sl->tile_width;
+            lvl->size.tile_height = sl->tile_height;
+            lvl->source = i;
+            lvl->shift = shift;
+
+            if (shift != 0 && lvl->size.width <= next_width) {
+                break; // next source level is better
+            }
+            ++ctx->num_levels;
+            if (next_width == 0 && lvl->size.width <= TILES_OVERVIEW &&
+                lvl->size.height <= TILES_OVERVIEW) {
+                break; // fits the overview
+            }
+        }
+    }
+}
+
+/**
+ * Decode tile of the internal pyramid.
+ * @param ctx tiled image context
+ * @param level index of the level
+ * @param col,row position of the tile in the grid
+ * @param pm destination pixmap with size of the tile
+ * @return true if tile was decoded
+ */
+static bool decode_tile(struct tiles* ctx, size_t level, size_t col,
+                        size_t row, struct pixmap* pm)
+{
+    const struct level* lvl = &ctx->levels[level];
+    const struct tiles_level* sl = &ctx->source.levels[lvl->source];
+    const size_t cols = (sl->width + sl->tile_width - 1) / sl->tile_width;
+    const size_t rows = (sl->height + sl->tile_height - 1) / sl->tile_height;
+    const size_t num = (size_t)1 << lvl->shift;
+    struct pixmap src;
+
+    if (lvl->shift == 0) {
+        return ctx->source.decode(ctx->source.data, lvl->source, col, row,
+                                  pm);
+    }
+
+    // virtual level: reduce source tiles covered by the tile
+    if (!pixmap_create(&src, sl->tile_width, sl->tile_height)) {
+        return false;
+    }
+    for (size_t dy = 0; dy < num; ++dy) {
+        const size_t src_row = row * num + dy;
+        for (size_t dx = 0; dx < num; ++dx) {
+            const size_t src_col = col * num + dx;
+            struct pixmap reduced = src;
+            if (src_col >= cols || src_row >= rows) {
+                continue;
+            }
+            memset(src.data, 0, src.width * src.height * sizeof(argb_t));
+            if (!ctx->source.decode(ctx->source.data, lvl->source, src_col,
+                                    src_row, &src)) {
+                continue;
+            }
+            for (size_t i = 0; i < lvl->shift; ++i) {
+                struct pixmap next;
+                if (!pixmap_reduce(&reduced, &next)) {
+                    break;
+                }
+                if (reduced.data != src.data) {
+                    pixmap_free(&reduced);
+                }
+                reduced = next;
+            }
+            pixmap_copy(&reduced, pm, dx * sl->tile_width / num,
+                        dy * sl->tile_height / num, false);
+            if (reduced.data != src.data) {
+                pixmap_free(&reduced);
+            }
+        }
+    }
+    pixmap_free(&src);
+
+    return true;
+}
+
+/**
+ * Find tile in the cache, must be called with locked mutex.
+ * @param ctx tiled image context
+ * @param level index of the level
+ * @param col,row position of the tile in the grid
+ * @return pointer to the tile or NULL if it is not decoded yet
+ */
+static const struct tile* find_tile(struct tiles* ctx, size_t level,
+                                    size_t col, size_t row)
+{
+    list_for_each(ctx->cache, struct tile, it) {
+        if (it->level == level && it->col == col && it->row == row) {
+            if (it != ctx->cache) {
+                ctx->cache = list_remove(it);
+                ctx->cache = list_add(ctx->cache, it);
+            }
+            return it;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Put decoded tile to the cache, must be called with locked mutex.
+ * @param ctx tiled image context
+ * @param tile tile to add
+ */
+static void put_tile(struct tiles* ctx, struct tile* tile)
+{
+    const size_t bytes = tile->pm.width * tile->pm.height * sizeof(argb_t);
+
+    // free the least recently used tiles
+    while (ctx->cache && ctx->cache_size + bytes > TILES_CACHE_SIZE) {
+        struct tile* last = list_get_last(ctx->cache);
+        ctx->cache = list_remove(last);
+        ctx->cache_size -= last->pm.width * last->pm.height * sizeof(argb_t);
+        pixmap_free(&last->pm);
+        free(last);
+    }
+
+    ctx->cache = list_add(ctx->cache, tile);
+    ctx->cache_size += bytes;
+}
+
+/**
+ * Drop tiles requested for decoding, must be called with locked mutex.
+ * @param ctx tiled image context
+ */
+static void drop_requests(struct tiles* ctx)
+{
+    list_for_each(ctx->queue, struct request, it) {
+        free(it);
+    }
+    ctx->queue = NULL;
+}
+
+/**
+ * Request tile decoding in background, must be called with locked mutex.
+ * @param ctx tiled image context
+ * @param level index of the level
+ * @param col,row position of the tile in the grid
+ */
+static void request_tile(struct tiles* ctx, size_t level, size_t col,
+                         size_t row)
+{
+    const struct request* active = ctx->active;
+    struct request* req;
+
+    if (active && active->level == level && active->col == col &&
+        active->row == row) {
+        return; // already being decoded
+    }
+
+    req = calloc(1, sizeof(*req));
+    if (req) {
+        req->level = level;
+        req->col = col;
+        req->row = row;
+        ctx->queue = list_append(ctx->queue, req);
+    }
+}
+
+/**
+ * Decode requested tiles, see `worker_fn`.
+ * @param data tiled image context
+ */
+static void decode_requests(void* data)
+{
+    struct tiles* ctx = data;
+
+    pthread_mutex_lock(&ctx->lock);
+    while (ctx->queue) {
+        struct request* req = ctx->queue;
+        const struct tiles_level* size = &ctx->levels[req->level].size;
+        const size_t generation = ctx->generation;
+        struct tile* tile;
+
+        ctx->queue = list_remove(req);
+        ctx->active = req;
+        pthread_mutex_unlock(&ctx->lock);
+
+        // tile that can't be decoded stays empty, so it is not requested
+        // again on each redraw
+        tile = calloc(1, sizeof(*tile));
+        if (tile &&
+            !pixmap_create(&tile->pm, size->tile_width, size->tile_height)) {
+            free(tile);
+            tile = NULL;
+        }
+        if (tile) {
+            tile->level = req->level;
+            tile->col = req->col;
+            tile->row = req->row;
+            decode_tile(ctx, req->level, req->col, req->row, &tile->pm);
+        }
+
+        pthread_mutex_lock(&ctx->lock);
+        ctx->active = NULL;
+        free(req);
+        if (tile) {
+            put_tile(ctx, tile);
+            app_on_update(generation);
+        }
+    }
+    ctx->posted = false;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * Fill area of the tile that is not decoded yet from the overview.
+ * @param ctx tiled image context
+ * @param overview reduced image
+ * @param level index of the level
+ * @param col,row position of the tile in the grid
+ * @param pm destination pixmap with size of the tile
+ */
+static void fill_tile(const struct tiles* ctx, const struct pixmap* overview,
+                      size_t level, size_t col, size_t row, struct pixmap* pm)
+{
+    const struct tiles_level* size = &ctx->levels[level].size;
+    const double scale = (double)size->width / overview->width;
+
+    pixmap_scale(aa_bilinear, overview, pm,
+                 -(ssize_t)(col * size->tile_width),
+                 -(ssize_t)(row * size->tile_height), scale, false);
+}
+
+/**
+ * Compose area of the level from tiles.
+ * @param ctx tiled image context
+ * @param level index of the level
+ * @param col,row position of the first tile in the grid
+ * @param pm destination pixmap, its size defines the number of tiles
+ * @param overview reduced image used for tiles that are not decoded yet,
+ *        NULL to decode all tiles right now without caching
+ * @return false if some tiles are not decoded yet
+ */
+static bool compose(struct tiles* ctx, size_t level, size_t col, size_t row,
+                    struct pixmap* pm, const struct pixmap* overview)
+{
+    const struct tiles_level* size = &ctx->levels[level].size;
+    const size_t cols = (pm->width + size->tile_width - 1) / size->tile_width;
+    const size_t rows =
+        (pm->height + size->tile_height - 1) / size->tile_height;
+    struct pixmap tmp;
+    bool complete = true;
+
+    if (!pixmap_create(&tmp, size->tile_width, size->tile_height)) {
+        return false;
+    }
+
+    for (size_t y = 0; y < rows; ++y) {
+        for (size_t x = 0; x < cols; ++x) {
+            const ssize_t dx = x * size->tile_width;
+            const ssize_t dy = y * size->tile_height;
+            if (overview) {
+                const struct tile* tile;
+                pthread_mutex_lock(&ctx->lock);
+                tile = find_tile(ctx, level, col + x, row + y);
+                if (tile) {
+                    pixmap_copy(&tile->pm, pm, dx, dy, false);
+                } else {
+                    request_tile(ctx, level, col + x, row + y);
+                    complete = false;
+                }
+                pthread_mutex_unlock(&ctx->lock);
+                if (tile) {
+                    continue;
+                }
+                fill_tile(ctx, overview, level, col + x, row + y, &tmp);
+            } else {
+                memset(tmp.data, 0,
+                       tmp.width * tmp.height * sizeof(argb_t));
+                decode_tile(ctx, level, col + x, row + y, &tmp);
+            }
+            pixmap_copy(&tmp, pm, dx, dy, false);
+        }
+    }
+
+    pixmap_free(&tmp);
+
+    return complete;
+}
+
+bool tiles_lazy(size_t width, size_t height)
+{
+    return width * height * sizeof(argb_t) > TILES_MIN_SIZE;
+}
+
+bool tiles_create(struct image* image, const struct tiles_source* source)
+{
+    struct tiles* ctx;
+    struct pixmap* pm;
+    const struct tiles_level* overview;
+
+    if (source->num_levels == 0) {
+        source->free(source->data);
+        return false;
+    }
+
+    ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) {
+        source->free(source->data);
+        return false;
+    }
+    ctx->source = *source;
+    pthread_mutex_init(&ctx->lock, NULL);
+    build_pyramid(ctx);
+
+    // the smallest level is used as overview
+    overview = &ctx->levels[ctx->num_levels - 1].size;
+    pm = image_allocate_frame(image, overview->width, overview->height);
+    if (!pm) {
+        ctx->source.free(ctx->source.data);
+        pthread_mutex_destroy(&ctx->lock);
+        free(ctx);
+        return false;
+    }
+    compose(ctx, ctx->num_levels - 1, 0, 0, pm, NULL);
+
+    image->full_width = source->levels[0].width;
+    image->full_height = source->levels[0].height;
+
+    if (image->size_hint || ctx->num_levels == 1) {
+        // thumbnail or the image is small enough
+        ctx->source.free(ctx->source.data);
+        pthread_mutex_destroy(&ctx->lock);
+        free(ctx);
+    } else {
+        image->tiles = ctx;
+    }
+
+    return true;
+}
+
+void tiles_free(struct image* image)
+{
+    struct tiles* ctx = image->tiles;
+
+    if (!ctx) {
+        return;
+    }
+
+    // stop decoding in background
+    pthread_mutex_lock(&ctx->lock);
+    drop_requests(ctx);
+    pthread_mutex_unlock(&ctx->lock);
+    worker_cancel(ctx);
+
+    list_for_each(ctx->cache, struct tile, it) {
+        pixmap_free(&it->pm);
+        free(it);
+    }
+    ctx->source.free(ctx->source.data);
+    pthread_mutex_destroy(&ctx->lock);
+    free(ctx);
+
+    image->tiles = NULL;
+}
+
+/**
+ * Transform rectangle from the source to the displayed orientation.
+ * @param rect rectangle to transform
+ * @param width,height size of the whole image in source orientation
+ * @param orient orientation transform
+ */
+static void orient_rect(struct pixmap_area* rect, size_t width, size_t height,
+                        enum pixmap_orient orient)
+{
+    if (orient & orient_transpose) {
+        const struct pixmap_area tr = *rect;
+        const size_t tmp = width;
+        rect->x = tr.y;
+        rect->y = tr.x;
+        rect->width = tr.height;
+        rect->height = tr.width;
+        width = height;
+        height = tmp;
+    }
+    if (orient & orient_flip_x) {
+        rect->x = width - rect->x - rect->width;
+    }
+    if (orient & orient_flip_y) {
+        rect->y = height - rect->y - rect->height;
+    }
+}
+
+/**
+ * Transform rectangle from the displayed to the source orientation.
+ * @param rect rectangle to transform
+ * @param width,height size of the whole image in source orientation
+ * @param orient orientation transform
+ */
+static void unorient_rect(struct pixmap_area* rect, size_t width,
+                          size_t height, enum pixmap_orient orient)
+{
+    const bool transpose = orient & orient_transpose;
+    const size_t disp_width = transpose ? height : width;
+    const size_t disp_height = transpose ? width : height;
+
+    if (orient & orient_flip_x) {
+        rect->x = disp_width - rect->x - rect->width;
+    }
+    if (orient & orient_flip_y) {
+        rect->y = disp_height - rect->y - rect->height;
+    }
+    if (transpose) {
+        const struct pixmap_area tr = *rect;
+        rect->x = tr.y;
+        rect->y = tr.x;
+        rect->width = tr.height;
+        rect->height = tr.width;
+    }
+}
+
+bool tiles_draw(struct image* image, enum aa_mode aa, struct pixmap* dst,
+                ssize_t x, ssize_t y, double scale)
+{
+    struct tiles* ctx = image->tiles;
+    const struct image_frame* frame = &image->frames[0];
+    const bool transpose = image->orient & orient_transpose;
+    const double full_width = ctx->levels[0].size.width;
+    const double full_height = ctx->levels[0].size.height;
+    const double disp_width = transpose ? full_height : full_width;
+    const double disp_height = transpose ? full_width : full_height;
+    const struct tiles_level* size;
+    double lvl_scale, x0, y0, x1, y1;
+    size_t level, col0, row0, col1, row1;
+    struct pixmap_area visible, composed;
+    struct pixmap area;
+    bool complete;
+
+    // overview is enough for small scales
+    lvl_scale = frame->pm.width / full_width;
+    if (scale <= lvl_scale) {
+        pixmap_scale_mipmap(aa, &frame->pm, frame->mipmap,
+                            frame->mipmap_levels, dst, x, y,
+                            scale / lvl_scale, image->alpha, image->orient);
+        return true;
+    }
+
+    // get the smallest level that has enough resolution
+    level = ctx->num_levels - 1;
+    while (level > 0 &&
+           ctx->levels[level].size.width / full_width < scale) {
+        --level;
+    }
+    size = &ctx->levels[level].size;
+    lvl_scale = size->width / full_width;
+
+    // visible area on the displayed level
+    x0 = max(0, -x / scale) * lvl_scale;
+    y0 = max(0, -y / scale) * lvl_scale;
+    x1 = min(disp_width, ((ssize_t)dst->width - x) / scale) * lvl_scale;
+    y1 = min(disp_height, ((ssize_t)dst->height - y) / scale) * lvl_scale;
+    x1 = min(ceil(x1), transpose ? size->height : size->width);
+    y1 = min(ceil(y1), transpose ? size->width : size->height);
+    if (x0 >= x1 || y0 >= y1) {
+        return true;
+    }
+    visible.x = x0;
+    visible.y = y0;
+    visible.width = (size_t)x1 - visible.x;
+    visible.height = (size_t)y1 - visible.y;
+
+    // tiles are stored in the source orientation
+    unorient_rect(&visible, size->width, size->height, image->orient);
+    col0 = visible.x / size->tile_width;
+    row0 = visible.y / size->tile_height;
+    col1 = (visible.x + visible.width - 1) / size->tile_width;
+    row1 = (visible.y + visible.height - 1) / size->tile_height;
+    composed.x = col0 * size->tile_width;
+    composed.y = row0 * size->tile_height;
+    composed.width =
+        min((col1 + 1) * size->tile_width, size->width) - composed.x;
+    composed.height =
+        min((row1 + 1) * size->tile_height, size->height) - composed.y;
+
+    // compose visible tiles and draw them at once, tiles requested for the
+    // previous view are not needed anymore
+    if (!pixmap_create(&area, composed.width, composed.height)) {
+        return true;
+    }
+    pthread_mutex_lock(&ctx->lock);
+    drop_requests(ctx);
+    ctx->generation = image->generation;
+    pthread_mutex_unlock(&ctx->lock);
+    complete = compose(ctx, level, col0, row0, &area, &frame->pm);
+    pthread_mutex_lock(&ctx->lock);
+    if (ctx->queue && !ctx->posted) {
+        ctx->posted = worker_post(decode_requests, ctx);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    orient_rect(&composed, size->width, size->height, image->orient);
+    pixmap_scale_mipmap(aa, &area, NULL, 0, dst,
+                        x + round(composed.x / lvl_scale * scale),
+                        y + round(composed.y / lvl_scale * scale),
+                        scale / lvl_scale, image->alpha, image->orient);
+    pixmap_free(&area);
+
+    return complete;
+}
+
+bool tiles_data_init(struct tiles_data* td, const struct image* image,
+                     const uint8_t* data, size_t size)
+{
+    struct stat st;
+    int fd;
+
+    td->map = NULL;
+
+    // map the source file, pages are not loaded until tiles are decoded
+    if (stat(image->source, &st) == 0 && S_ISREG(st.st_mode) &&
+        (size_t)st.st_size == size) {
+        fd = open(image->source, O_RDONLY | O_CLOEXEC);
+        if (fd != -1) {
+            void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (map != MAP_FAILED) {
+                if (memcmp(map, data, min(size, 4096)) == 0) {
+                    td->map = map;
+                    td->data = map;
+                    td->size = size;
+                    return true;
+                }
+                munmap(map, size);
+            }
+        }
+    }
+
+    // copy data of other sources
+    td->data = malloc(size);
+    if (!td->data) {
+        return false;
+    }
+    memcpy((uint8_t*)td->data, data, size);
+    td->size = size;
+
+    return true;
+}
+
+void tiles_data_free(struct tiles_data* td)
+{
+    if (td->map) {
+        munmap(td->map, td->size);
+    } else {
+        free((uint8_t*)td->data);
+    }
+    td->data = NULL;
+    td->map = NULL;
+}
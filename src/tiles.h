@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: MIT
+// Huge images decoded by tiles on demand.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include "image.h"
+#include "pixmap_scale.h"
+
+// Max number of pyramid levels
+#define TILES_MAX_LEVELS 16
+
+/** Pyramid level: the whole image at some resolution. */
+struct tiles_level {
+    size_t width, height;           ///< Size of the level in pixels
+    size_t tile_width, tile_height; ///< Size of a single tile
+};
+
+/**
+ * Decode single tile.
+ * @param data decoder specific data
+ * @param level index of the pyramid level
+ * @param col,row position of the tile in the level's grid
+ * @param pm destination pixmap, has the size of the tile
+ * @return false on errors
+ */
+typedef bool (*tiles_decode_fn)(void* data, size_t level, size_t col,
+                                size_t row, struct pixmap* pm);
+
+/**
+ * Free decoder specific data.
+ * @param data decoder specific data
+ */
+typedef void (*tiles_free_fn)(void* data);
+
+/** Tile source. */
+struct tiles_source {
+    tiles_decode_fn decode; ///< Tile decoder
+    tiles_free_fn free;     ///< Decoder destructor
+    void* data;             ///< Decoder specific data
+    struct tiles_level levels[TILES_MAX_LEVELS]; ///< Levels from full size
+    size_t num_levels;                           ///< Number of levels
+};
+
+/** Raw image data kept for the tile decoder. */
+struct tiles_data {
+    const uint8_t* data; ///< Image data
+    size_t size;         ///< Size of image data
+    void* map;           ///< Mapped file, NULL if data was copied
+};
+
+/**
+ * Check if image should be decoded by tiles on demand instead of decoding
+ * the whole image at once.
+ * @param width,height full size of the image
+ * @return true if tiled decoding should be used
+ */
+bool tiles_lazy(size_t width, size_t height);
+
+/**
+ * Setup tiled image: the first frame of the image becomes a reduced overview
+ * built from the smallest level, other levels are decoded on demand.
+ * The source is freed by the function in any case.
+ * @param image image context
+ * @param source tile source
+ * @return true if overview was created
+ */
+bool tiles_create(struct image* image, const struct tiles_source* source);
+
+/**
+ * Free tile source and cached tiles, the image keeps the overview.
+ * @param image image context
+ */
+void tiles_free(struct image* image);
+
+/**
+ * Draw the visible part of the scaled image.
+ * Tiles that are not cached yet are decoded in background, the overview is
+ * drawn in their place until the image is updated (see `app_on_update`).
+ * @param image image context
+ * @param aa scale filter to use
+ * @param dst destination pixmap
+ * @param x,y position of the full size image on the destination pixmap
+ * @param scale scale of the full size image
+ * @return false if some of the visible tiles are not decoded yet
+ */
+bool tiles_draw(struct image* image, enum aa_mode aa, struct pixmap* dst,
+                ssize_t x, ssize_t y, double scale);
+
+/**
+ * Keep raw image data available after loading: the source file is mapped
+ * to memory again, data from other sources is copied.
+ * @param td raw data descriptor to fill
+ * @param image image context
+ * @param data,size image data passed to the decoder
+ * @return true if data is available
+ */
+bool tiles_data_init(struct tiles_data* td, const struct image* image,
+                     const uint8_t* data, size_t size);
+
+/**
+ * Release raw image data.
+ * @param td raw data descriptor
+ */
+void tiles_data_free(struct tiles_data* td);
@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: MIT
+// Thread pool for parallel processing of row ranges.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "tpool.h"
+
+#include "list.h"
+#include "pixmap.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef __FreeBSD__
+#include <sys/sysctl.h>
+#endif
+
+// Max number of background threads
+#define MAX_THREADS 15
+
+/** Task in the queue. */
+struct tpool_task {
+    struct list list;        ///< Links to prev/next entry
+    tpool_fn fn;             ///< Task handler
+    void* data;              ///< User data for the handler
+    size_t rows;             ///< Total number of rows
+    size_t chunk;            ///< Number of rows in a single range
+    size_t next;             ///< Next row to process
+    size_t done;             ///< Number of processed rows
+    pthread_cond_t finished; ///< Task completion notification
+};
+
+/** Thread pool context. */
+struct tpool {
+    pthread_t* threads;       ///< Background threads
+    size_t num;               ///< Number of background threads
+    struct tpool_task* queue; ///< Tasks queue
+    pthread_mutex_t lock;     ///< Queue lock
+    pthread_cond_t wakeup;    ///< New task notification
+    bool stop;                ///< Stop flag
+};
+
+static struct tpool ctx = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wakeup = PTHREAD_COND_INITIALIZER,
+};
+
+// Key of the thread specific serial mode flag
+static pthread_key_t serial_key;
+static pthread_once_t serial_once = PTHREAD_ONCE_INIT;
+
+/** Create key of the serial mode flag. */
+static void create_serial_key(void)
+{
+    pthread_key_create(&serial_key, NULL);
+}
+
+/**
+ * Check if tasks of the calling thread must be processed serially.
+ * @return true if serial mode is enabled for the calling thread
+ */
+static bool is_serial(void)
+{
+    pthread_once(&serial_once, create_serial_key);
+    return pthread_getspecific(serial_key);
+}
+
+/**
+ * Process the next range of the task, must be called with locked mutex.
+ * @param task pointer to the task
+ */
+static void process_range(struct tpool_task* task)
+{
+    const size_t low = task->next;
+    const size_t high = min(task->rows, low + task->chunk);
+
+    task->next = high;
+    if (task->next >= task->rows) {
+        // all ranges are distributed, nothing more to get from the queue
+        ctx.queue = list_remove(task);
+    }
+
+    pthread_mutex_unlock(&ctx.lock);
+    task->fn(task->data, low, high);
+    pthread_mutex_lock(&ctx.lock);
+
+    task->done += high - low;
+    if (task->done >= task->rows) {
+        pthread_cond_signal(&task->finished);
+    }
+}
+
+/** Worker thread. */
+static void* worker(__attribute__((unused)) void* data)
+{
+    pthread_mutex_lock(&ctx.lock);
+    while (!ctx.stop) {
+        if (ctx.queue) {
+            process_range(ctx.queue);
+        } else {
+            pthread_cond_wait(&ctx.wakeup, &ctx.lock);
+        }
+    }
+    pthread_mutex_unlock(&ctx.lock);
+    return NULL;
+}
+
+bool tpool_init(size_t threads)
+{
+    if (threads == 0) {
+        // get active CPUs
+#ifdef __FreeBSD__
+        uint32_t cpus = 0;
+        size_t cpus_len = sizeof(cpus);
+        sysctlbyname("hw.ncpu", &cpus, &cpus_len, 0, 0);
+#else
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+        threads = cpus > 1 ? cpus - 1 : 0;
+    }
+    threads = min(threads, MAX_THREADS);
+    if (threads == 0) {
+        return false;
+    }
+
+    ctx.threads = malloc(threads * sizeof(*ctx.threads));
+    if (!ctx.threads) {
+        return false;
+    }
+
+    ctx.stop = false;
+    for (size_t i = 0; i < threads; ++i) {
+        if (pthread_create(&ctx.threads[i], NULL, worker, NULL) != 0) {
+            break;
+        }
+        ++ctx.num;
+    }
+
+    return ctx.num != 0;
+}
+
+void tpool_destroy(void)
+{
+    pthread_mutex_lock(&ctx.lock);
+    ctx.stop = true;
+    pthread_cond_broadcast(&ctx.wakeup);
+    pthread_mutex_unlock(&ctx.lock);
+
+    for (size_t i = 0; i < ctx.num; ++i) {
+        pthread_join(ctx.threads[i], NULL);
+    }
+
+    free(ctx.threads);
+    ctx.threads = NULL;
+    ctx.num = 0;
+}
+
+size_t tpool_threads(void)
+{
+    return ctx.num + 1;
+}
+
+void tpool_set_serial(bool enable)
+{
+    pthread_once(&serial_once, create_serial_key);
+    pthread_setspecific(serial_key, enable ? &ctx : NULL);
+}
+
+void tpool_run(tpool_fn fn, void* data, size_t rows, size_t min_rows)
+{
+    struct tpool_task task = {
+        .fn = fn,
+        .data = data,
+        .rows = rows,
+        .finished = PTHREAD_COND_INITIALIZER,
+    };
+
+    if (rows == 0) {
+        return;
+    }
+    if (ctx.num == 0 || rows <= min_rows || is_serial()) {
+        fn(data, 0, rows);
+        return;
+    }
+
+    task.chunk = rows / tpool_threads();
+    if (task.chunk < min_rows) {
+        task.chunk = min_rows;
+    } else if (task.chunk * tpool_threads() < rows) {
+        ++task.chunk;
+    }
+
+    pthread_mutex_lock(&ctx.lock);
+
+    ctx.queue = list_append(ctx.queue, &task);
+    pthread_cond_broadcast(&ctx.wakeup);
+
+    // process own task in the current thread too
+    while (task.next < task.rows) {
+        process_range(&task);
+    }
+    while (task.done < task.rows) {
+        pthread_cond_wait(&task.finished, &ctx.lock);
+    }
+
+    pthread_mutex_unlock(&ctx.lock);
+
+    pthread_cond_destroy(&task.finished);
+}
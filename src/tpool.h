@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: MIT
+// Thread pool for parallel processing of row ranges.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Task handler: process a range of rows.
+ * @param data user data passed to `tpool_run`
+ * @param low first row to process
+ * @param high one beyond the last row to process
+ */
+typedef void (*tpool_fn)(void* data, size_t low, size_t high);
+
+/**
+ * Start worker threads.
+ * @param threads number of background threads, 0 to use online CPUs count
+ * @return true if pool was created
+ */
+bool tpool_init(size_t threads);
+
+/**
+ * Stop worker threads.
+ */
+void tpool_destroy(void);
+
+/**
+ * Get number of threads that can process a task (including the caller).
+ * @return number of threads
+ */
+size_t tpool_threads(void);
+
+/**
+ * Set serial mode for the calling thread: its tasks are processed directly
+ * in this thread without the pool. It is used by threads that already run
+ * in parallel with each other, so splitting their tasks gives no benefit.
+ * @param enable flag to enable serial mode
+ */
+void tpool_set_serial(bool enable);
+
+/**
+ * Split task into row ranges and process them in parallel.
+ * This function blocks until all rows are processed. The calling thread also
+ * participates in processing, so it is safe to call it from a worker thread.
+ * If the pool is not started or the task is too small (not more than
+ * `min_rows`), the task is executed directly in the calling thread.
+ * @param fn task handler
+ * @param data user data to pass to the handler
+ * @param rows total number of rows
+ * @param min_rows minimal number of rows per single range
+ */
+void tpool_run(tpool_fn fn, void* data, size_t rows, size_t min_rows);
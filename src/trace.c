@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: MIT
+// Timeline tracing of the loader and render pipeline.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "trace.h"
+
+#include "perf.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Max number of recorded spans, the oldest ones are overwritten
+#define TRACE_EVENTS 65536
+
+/** Recorded span. */
+struct trace_event {
+    const char* name; ///< Span name
+    char arg[16];     ///< Span argument
+    uint64_t start;   ///< Start time (us)
+    uint64_t dur;     ///< Duration (us)
+    size_t tid;       ///< Thread id
+};
+
+/** Tracing context. */
+struct trace_context {
+    bool enabled;               ///< Tracing enabled flag
+    char* path;                 ///< Path to the output file
+    struct trace_event* events; ///< Ring buffer of spans
+    size_t total;               ///< Total number of recorded spans
+    pthread_mutex_t lock;       ///< Ring buffer access lock
+    pthread_key_t tid_key;      ///< Key of the thread specific id
+    size_t tid_last;            ///< Last assigned thread id
+};
+
+/** Global tracing context. */
+static struct trace_context ctx = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/**
+ * Get id of the calling thread, ids are assigned on the first use.
+ * Must be called with locked mutex.
+ * @return thread id
+ */
+static size_t thread_id(void)
+{
+    size_t tid = (size_t)pthread_getspecific(ctx.tid_key);
+
+    if (!tid) {
+        tid = ++ctx.tid_last;
+        pthread_setspecific(ctx.tid_key, (void*)tid);
+    }
+
+    return tid;
+}
+
+/**
+ * Write string as JSON value.
+ * @param fd output file
+ * @param str string to write
+ */
+static void write_string(FILE* fd, const char* str)
+{
+    fputc('"', fd);
+    for (; *str; ++str) {
+        if (*str == '"' || *str == '\\') {
+            fputc('\\', fd);
+            fputc(*str, fd);
+        } else if ((unsigned char)*str < ' ') {
+            fprintf(fd, "\\u%04x", *str);
+        } else {
+            fputc(*str, fd);
+        }
+    }
+    fputc('"', fd);
+}
+
+void trace_init(void)
+{
+    const char* path = getenv(TRACE_ENV);
+
+    if (!path || !*path) {
+        return;
+    }
+
+    ctx.events = calloc(TRACE_EVENTS, sizeof(*ctx.events));
+    ctx.path = strdup(path);
+    if (!ctx.events || !ctx.path || pthread_key_create(&ctx.tid_key, NULL)) {
+        free(ctx.events);
+        free(ctx.path);
+        ctx.events = NULL;
+        ctx.path = NULL;
+        return;
+    }
+
+    pthread_mutex_lock(&ctx.lock);
+    thread_id(); // the main thread is the first one
+    pthread_mutex_unlock(&ctx.lock);
+    __atomic_store_n(&ctx.enabled, true, __ATOMIC_RELEASE);
+}
+
+void trace_destroy(void)
+{
+    if (trace_enabled()) {
+        trace_dump();
+        __atomic_store_n(&ctx.enabled, false, __ATOMIC_RELEASE);
+        pthread_key_delete(ctx.tid_key);
+        free(ctx.events);
+        free(ctx.path);
+        ctx.events = NULL;
+        ctx.path = NULL;
+    }
+}
+
+bool trace_enabled(void)
+{
+    return __atomic_load_n(&ctx.enabled, __ATOMIC_ACQUIRE);
+}
+
+void trace_span(const char* name, const char* arg, uint64_t start)
+{
+    const uint64_t now = perf_now();
+    struct trace_event* event;
+
+    if (!trace_enabled()) {
+        return;
+    }
+
+    pthread_mutex_lock(&ctx.lock);
+
+    event = &ctx.events[ctx.total++ % TRACE_EVENTS];
+    event->name = name;
+    event->start = start;
+    event->dur = now - start;
+    event->tid = thread_id();
+    if (arg) {
+        strncpy(event->arg, arg, sizeof(event->arg) - 1);
+        event->arg[sizeof(event->arg) - 1] = 0;
+    } else {
+        event->arg[0] = 0;
+    }
+
+    pthread_mutex_unlock(&ctx.lock);
+}
+
+/**
+ * Write spans in Chrome trace event format.
+ * @param fd output file
+ * @param events ring buffer of spans
+ * @param total total number of spans recorded to the ring
+ */
+static void write_events(FILE* fd, const struct trace_event* events,
+                         size_t total)
+{
+    const int pid = getpid();
+    const size_t num = total < TRACE_EVENTS ? total : TRACE_EVENTS;
+
+    fprintf(fd, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(fd,
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":1,"
+            "\"args\":{\"name\":\"main\"}}",
+            pid);
+    for (size_t i = total - num; i < total; ++i) {
+        const struct trace_event* event = &events[i % TRACE_EVENTS];
+        fprintf(fd,
+                ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%zu,"
+                "\"ts\":%" PRIu64 ",\"dur\":%" PRIu64,
+                event->name, pid, event->tid, event->start, event->dur);
+        if (event->arg[0]) {
+            fprintf(fd, ",\"args\":{\"arg\":");
+            write_string(fd, event->arg);
+            fputc('}', fd);
+        }
+        fputc('}', fd);
+    }
+    fprintf(fd, "\n]}\n");
+}
+
+bool trace_dump(void)
+{
+    struct trace_event* events;
+    struct trace_event* fresh;
+    size_t total, num;
+    FILE* fd;
+
+    if (!trace_enabled()) {
+        return false;
+    }
+
+    fd = fopen(ctx.path, "w");
+    if (!fd) {
+        fprintf(stderr, "Unable to write trace %s: %s\n", ctx.path,
+                strerror(errno));
+        return false;
+    }
+    fresh = malloc(TRACE_EVENTS * sizeof(*fresh));
+    if (!fresh) {
+        fclose(fd);
+        return false;
+    }
+
+    // spans are recorded to the new buffer while the file is written
+    pthread_mutex_lock(&ctx.lock);
+    events = ctx.events;
+    total = ctx.total;
+    ctx.events = fresh;
+    ctx.total = 0;
+    pthread_mutex_unlock(&ctx.lock);
+
+    write_events(fd, events, total);
+    fclose(fd);
+
+    // put the spans recorded meanwhile to the end of the original buffer
+    pthread_mutex_lock(&ctx.lock);
+    num = ctx.total < TRACE_EVENTS ? ctx.total : TRACE_EVENTS;
+    for (size_t i = ctx.total - num; i < ctx.total; ++i) {
+        events[total++ % TRACE_EVENTS] = ctx.events[i % TRACE_EVENTS];
+    }
+    ctx.events = events;
+    ctx.total = total;
+    pthread_mutex_unlock(&ctx.lock);
+
+    free(fresh);
+
+    return true;
+}
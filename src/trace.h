@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: MIT
+// Timeline tracing of the loader and render pipeline.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Environment variable with path to the output trace file
+#define TRACE_ENV "SWAYIMG_TRACE"
+
+/**
+ * Initialize tracing, it is enabled only if the output file is set by the
+ * environment variable `TRACE_ENV`. Must be called from the main thread.
+ */
+void trace_init(void);
+
+/**
+ * Write the trace file and stop tracing.
+ */
+void trace_destroy(void);
+
+/**
+ * Check if tracing is enabled.
+ * @return true if spans are recorded
+ */
+bool trace_enabled(void);
+
+/**
+ * Record completed span, can be called from any thread.
+ * @param name span name, must be a static string
+ * @param arg optional argument of the span (e.g. image format), can be NULL
+ * @param start start time of the span, see `perf_now`
+ */
+void trace_span(const char* name, const char* arg, uint64_t start);
+
+/**
+ * Write recorded spans to the trace file (Chrome trace event format).
+ * @return true if file was written
+ */
+bool trace_dump(void);
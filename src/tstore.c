@@ -0,0 +1,908 @@
+// SPDX-License-Identifier: MIT
+// Packed persistent store of thumbnails.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "tstore.h"
+
+#include "array.h"
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// Store file signatures and format version
+static const uint8_t data_signature[] = { 's', 'w', 't', 'd' };
+static const uint8_t index_signature[] = { 's', 'w', 't', 'i' };
+static const uint8_t record_signature[] = { 's', 'w', 't', 'r' };
+#define VERSION 1
+
+// Names of the store files
+#define DATA_FILE  "/data"
+#define INDEX_FILE "/index"
+
+// Min number of slots in the index, must be a power of 2
+#define INDEX_MIN 1024
+
+// Part of the size limit kept on eviction (percent), the rest is left for
+// new thumbnails
+#define LIMIT_KEEP 75
+
+/**
+ * Data file header. Thumbnail records are appended to the file, each record
+ * starts at page boundary, so pixel data can be mapped directly: raw pixels,
+ * the record header and meta data (see `image_pack_meta`).
+ * The file is never truncated below the existing records: pages of the file
+ * can be mapped by any process, access to truncated ones raises SIGBUS, so
+ * the file is replaced by a new one on reset and compaction.
+ */
+struct tstore_header {
+    uint8_t magic[4]; ///< Signature
+    uint32_t version; ///< File format version
+    uint64_t page;    ///< Alignment of records
+    uint64_t gen;     ///< Generation of the data file
+};
+
+/** Record header, placed right after pixel data. */
+struct tstore_record {
+    uint8_t magic[4];     ///< Signature
+    uint32_t params;      ///< Parameters of the thumbnail
+    uint64_t src_size;    ///< Size of the source file
+    int64_t src_sec;      ///< Modification time of the source file
+    int64_t src_nsec;     ///< Modification time of the source file (ns)
+    uint64_t meta_size;   ///< Size of meta data
+    uint32_t width;       ///< Thumbnail width
+    uint32_t height;      ///< Thumbnail height
+    uint32_t full_width;  ///< Real width of the image
+    uint32_t full_height; ///< Real height of the image
+    uint32_t alpha;       ///< Alpha channel flag
+    uint32_t format;      ///< Pixel format (`enum pixmap_format`)
+};
+
+/**
+ * Index file header. The header is followed by the hash table of records
+ * (open addressing with linear probing).
+ */
+struct tstore_index {
+    uint8_t magic[4];  ///< Signature
+    uint32_t version;  ///< File format version
+    uint64_t gen;      ///< Generation of the data file
+    uint64_t capacity; ///< Number of slots, power of 2
+    uint64_t used;     ///< Number of used slots
+    uint64_t live;     ///< Size of indexed records in the data file
+    uint64_t dead;     ///< Size of garbage in the data file
+};
+
+/** Index slot. */
+struct tstore_slot {
+    uint64_t hash;   ///< Hash of the source path and thumbnail parameters
+    uint64_t offset; ///< Offset of the record header, 0 for empty slot
+};
+
+/** Thumbnail store context. */
+struct tstore {
+    char* dir;                  ///< Path to the store directory
+    int data_fd;                ///< Data file descriptor
+    size_t page;                ///< Alignment of records
+    size_t limit;               ///< Max size of records, 0 for unlimited
+    uint64_t gen;               ///< Generation of the data file
+    struct tstore_index* index; ///< Mapped index file
+    size_t index_size;          ///< Size of the mapped index file
+    bool compacting;            ///< Compaction is in progress
+    pthread_mutex_t lock;       ///< Store access lock
+};
+
+/** Global thumbnail store context. */
+static struct tstore ctx = { .data_fd = -1 };
+
+/**
+ * Get path to the store file.
+ * @param name file name
+ * @param tmp flag to get path to the temporary file
+ * @return path to the file, caller must free it
+ */
+static char* store_path(const char* name, bool tmp)
+{
+    char* path = NULL;
+
+    str_dup(ctx.dir, &path);
+    str_append(name, 0, &path);
+    if (tmp) {
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), ".%d", getpid());
+        str_append(suffix, 0, &path);
+    }
+
+    return path;
+}
+
+/**
+ * Generate new generation id for the data file.
+ * @return generation id
+ */
+static uint64_t new_gen(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec) ^
+        ((uint64_t)getpid() << 48);
+}
+
+/**
+ * Get hash of the record key (FNV-1a).
+ * @param source path to the original image file
+ * @param params parameters of the thumbnail
+ * @return hash value
+ */
+static uint64_t key_hash(const char* source, uint32_t params)
+{
+    uint8_t bytes[sizeof(params)];
+
+    // hash parameters in little-endian order to keep keys portable
+    for (size_t i = 0; i < sizeof(params); ++i) {
+        bytes[i] = (params >> (i * 8)) & 0xff;
+    }
+
+    return fnv1a(fnv1a(FNV1A_INIT, source, strlen(source)), bytes,
+                 sizeof(bytes));
+}
+
+/**
+ * Align offset in the data file to the page boundary.
+ * @param offset offset to align
+ * @return aligned offset
+ */
+static uint64_t align(uint64_t offset)
+{
+    return (offset + ctx.page - 1) / ctx.page * ctx.page;
+}
+
+/**
+ * Get size of the record pixel data.
+ * @param rec record header
+ * @return size in bytes
+ */
+static size_t record_pixels(const struct tstore_record* rec)
+{
+    return (size_t)rec->width * rec->height * pixmap_bpp(rec->format);
+}
+
+/**
+ * Get size of the record in the data file.
+ * @param rec record header
+ * @return size in bytes including the alignment
+ */
+static size_t record_size(const struct tstore_record* rec)
+{
+    return align(record_pixels(rec) + sizeof(*rec) + rec->meta_size);
+}
+
+/**
+ * Read and check record header.
+ * @param offset offset of the record header in the data file
+ * @param rec destination record header
+ * @return false if record is invalid
+ */
+static bool record_read(uint64_t offset, struct tstore_record* rec)
+{
+    size_t pixels;
+
+    if (pread(ctx.data_fd, rec, sizeof(*rec), offset) != sizeof(*rec) ||
+        memcmp(rec->magic, record_signature, sizeof(record_signature)) ||
+        rec->format > pixfmt_gray8) {
+        return false;
+    }
+
+    pixels = record_pixels(rec);
+
+    return pixels && offset >= pixels + ctx.page &&
+        (offset - pixels) % ctx.page == 0;
+}
+
+/**
+ * Write data to the file.
+ * @param fd file descriptor
+ * @param data data to write
+ * @param size size of the data
+ * @param offset position in the file
+ * @return true if all data was written
+ */
+static bool write_all(int fd, const void* data, size_t size, uint64_t offset)
+{
+    const uint8_t* ptr = data;
+
+    while (size) {
+        const ssize_t rc = pwrite(fd, ptr, size, offset);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        ptr += rc;
+        size -= rc;
+        offset += rc;
+    }
+
+    return true;
+}
+
+/**
+ * Lock/unlock the data file to prevent modification by other processes.
+ * @param type lock type (`F_WRLCK` or `F_UNLCK`)
+ * @return false if the file is locked by another process
+ */
+static bool data_lock(short type)
+{
+    struct flock lock;
+
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+
+    return fcntl(ctx.data_fd, F_SETLK, &lock) != -1;
+}
+
+/**
+ * Find slot for the key in the hash table.
+ * @param slots hash table
+ * @param capacity size of the hash table
+ * @param hash hash of the key
+ * @return pointer to the slot with the same key or to the empty slot
+ */
+static struct tstore_slot* slot_find(struct tstore_slot* slots,
+                                     size_t capacity, uint64_t hash)
+{
+    for (size_t i = 0; i < capacity; ++i) {
+        struct tstore_slot* slot = &slots[(hash + i) & (capacity - 1)];
+        if (!slot->offset || slot->hash == hash) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Get hash table of the mapped index.
+ * @return pointer to the first slot
+ */
+static struct tstore_slot* index_slots(void)
+{
+    return (struct tstore_slot*)(ctx.index + 1);
+}
+
+/**
+ * Create new index file.
+ * @param capacity number of slots, power of 2
+ * @param slots slots to put into the new index, can be NULL
+ * @param num number of slots to put
+ * @param live,dead size of live records and garbage in the data file
+ * @return false on errors
+ */
+static bool index_create(size_t capacity, const struct tstore_slot* slots,
+                         size_t num, uint64_t live, uint64_t dead)
+{
+    struct tstore_index* index;
+    const size_t size = sizeof(*index) + capacity * sizeof(*slots);
+    char* path = store_path(INDEX_FILE, false);
+    char* tmp = store_path(INDEX_FILE, true);
+    bool rc = false;
+    int fd;
+
+    index = calloc(1, size);
+    if (!index || !path || !tmp) {
+        goto done;
+    }
+
+    memcpy(index->magic, index_signature, sizeof(index_signature));
+    index->version = VERSION;
+    index->gen = ctx.gen;
+    index->capacity = capacity;
+    index->live = live;
+    index->dead = dead;
+    for (size_t i = 0; i < num; ++i) {
+        if (slots[i].offset) {
+            struct tstore_slot* slot = slot_find(
+                (struct tstore_slot*)(index + 1), capacity, slots[i].hash);
+            if (slot) {
+                index->used += slot->offset ? 0 : 1;
+                *slot = slots[i];
+            }
+        }
+    }
+
+    // write to temporary file and then replace the index file
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        goto done;
+    }
+    rc = write_all(fd, index, size, 0);
+    close(fd);
+    if (!rc || rename(tmp, path) == -1) {
+        unlink(tmp);
+        rc = false;
+    }
+
+done:
+    free(index);
+    free(path);
+    free(tmp);
+    return rc;
+}
+
+/**
+ * Map index file to memory, the previous mapping is replaced.
+ * @return false if index is not valid
+ */
+static bool index_open(void)
+{
+    const struct tstore_index* index;
+    struct stat st;
+    char* path;
+    void* map;
+    int fd;
+
+    path = store_path(INDEX_FILE, false);
+    if (!path) {
+        return false;
+    }
+    fd = open(path, O_RDWR | O_CLOEXEC);
+    free(path);
+    if (fd == -1) {
+        return false;
+    }
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(*index)) {
+        close(fd);
+        return false;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    index = map;
+    if (memcmp(index->magic, index_signature, sizeof(index_signature)) ||
+        index->version != VERSION || index->gen != ctx.gen ||
+        index->capacity < INDEX_MIN ||
+        (index->capacity & (index->capacity - 1)) ||
+        sizeof(*index) + index->capacity * sizeof(struct tstore_slot) !=
+            (size_t)st.st_size) {
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    if (ctx.index) {
+        munmap(ctx.index, ctx.index_size);
+    }
+    ctx.index = map;
+    ctx.index_size = st.st_size;
+
+    return true;
+}
+
+/**
+ * Create new empty data file.
+ * @param path path to the file
+ * @param hdr destination header of the new file
+ * @return file descriptor or -1 on errors
+ */
+static int data_create(const char* path, struct tstore_header* hdr)
+{
+    int fd;
+
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, data_signature, sizeof(data_signature));
+    hdr->version = VERSION;
+    hdr->page = ctx.page;
+    hdr->gen = new_gen();
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd != -1 && !write_all(fd, hdr, sizeof(*hdr), 0)) {
+        close(fd);
+        unlink(path);
+        fd = -1;
+    }
+
+    return fd;
+}
+
+/**
+ * Open data file, new store is created if the file is not valid.
+ * @return false on errors
+ */
+static bool data_open(void)
+{
+    struct tstore_header hdr;
+    char* path = store_path(DATA_FILE, false);
+    char* tmp = store_path(DATA_FILE, true);
+    bool rc = false;
+
+    ctx.page = sysconf(_SC_PAGESIZE);
+    if (!path || !tmp) {
+        goto done;
+    }
+    ctx.data_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (ctx.data_fd == -1) {
+        goto done;
+    }
+
+    if (pread(ctx.data_fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+        memcmp(hdr.magic, data_signature, sizeof(data_signature)) ||
+        hdr.version != VERSION || hdr.page != ctx.page) {
+        // reset the store: replace the file instead of truncating it
+        int fd = -1;
+        if (data_lock(F_WRLCK)) {
+            fd = data_create(tmp, &hdr);
+            if (fd != -1 && rename(tmp, path) == -1) {
+                close(fd);
+                unlink(tmp);
+                fd = -1;
+            }
+        }
+        close(ctx.data_fd); // unlocks the old data file
+        ctx.data_fd = fd;
+        if (fd == -1) {
+            goto done;
+        }
+    }
+
+    ctx.gen = hdr.gen;
+    rc = true;
+
+done:
+    free(path);
+    free(tmp);
+    return rc;
+}
+
+/**
+ * Close store files.
+ */
+static void store_close(void)
+{
+    if (ctx.index) {
+        munmap(ctx.index, ctx.index_size);
+        ctx.index = NULL;
+        ctx.index_size = 0;
+    }
+    if (ctx.data_fd != -1) {
+        close(ctx.data_fd);
+        ctx.data_fd = -1;
+    }
+}
+
+bool tstore_init(size_t limit)
+{
+    ctx.limit = limit;
+
+    ctx.dir = config_expand_path("XDG_CACHE_HOME", "/swayimg/thumbs");
+    if (!ctx.dir) {
+        ctx.dir = config_expand_path("HOME", "/.cache/swayimg/thumbs");
+    }
+    if (!ctx.dir) {
+        return false;
+    }
+
+    if (!make_dirs(ctx.dir)) {
+        goto fail;
+    }
+
+    if (!data_open()) {
+        goto fail;
+    }
+    if (!index_open()) {
+        // records of the data file are lost, all of them are garbage now
+        const off_t end = lseek(ctx.data_fd, 0, SEEK_END);
+        const uint64_t dead = end > (off_t)ctx.page ? end - ctx.page : 0;
+        const bool created = data_lock(F_WRLCK) &&
+            index_create(INDEX_MIN, NULL, 0, 0, dead) && index_open();
+        data_lock(F_UNLCK);
+        if (!created) {
+            goto fail;
+        }
+    }
+
+    pthread_mutex_init(&ctx.lock, NULL);
+
+    return true;
+
+fail:
+    store_close();
+    free(ctx.dir);
+    ctx.dir = NULL;
+    return false;
+}
+
+void tstore_destroy(void)
+{
+    if (ctx.dir) {
+        store_close();
+        pthread_mutex_destroy(&ctx.lock);
+        free(ctx.dir);
+        ctx.dir = NULL;
+    }
+}
+
+/**
+ * Find actual record of the thumbnail, must be called with the lock held.
+ * @param source path to the original image file
+ * @param st status of the original image file
+ * @param params parameters of the thumbnail
+ * @param rec destination record header
+ * @return offset of the record header, 0 if not found
+ */
+static uint64_t record_find(const char* source, const struct stat* st,
+                            uint32_t params, struct tstore_record* rec)
+{
+    const struct tstore_slot* slot;
+
+    if (!ctx.index) {
+        return 0;
+    }
+    slot = slot_find(index_slots(), ctx.index->capacity,
+                     key_hash(source, params));
+    if (!slot || !slot->offset || !record_read(slot->offset, rec) ||
+        rec->params != params || rec->src_size != (uint64_t)st->st_size ||
+        rec->src_sec != st->st_mtim.tv_sec ||
+        rec->src_nsec != st->st_mtim.tv_nsec) {
+        return 0;
+    }
+
+    return slot->offset;
+}
+
+bool tstore_check(const char* source, const struct stat* st, uint32_t params)
+{
+    struct tstore_record rec;
+    bool rc;
+
+    if (!ctx.dir) {
+        return false;
+    }
+
+    pthread_mutex_lock(&ctx.lock);
+    rc = record_find(source, st, params, &rec) != 0;
+    pthread_mutex_unlock(&ctx.lock);
+
+    return rc;
+}
+
+bool tstore_load(struct image* image, const char* source,
+                 const struct stat* st, uint32_t params)
+{
+    struct tstore_record rec;
+    struct image_frame* frame;
+    uint64_t offset;
+    size_t pixels;
+    char* meta = NULL;
+    bool rc = false;
+    void* data;
+
+    if (!ctx.dir) {
+        return false;
+    }
+
+    pthread_mutex_lock(&ctx.lock);
+    offset = record_find(source, st, params, &rec);
+    if (!offset) {
+        goto done;
+    }
+
+    // read meta data
+    meta = malloc(rec.meta_size);
+    if (!meta ||
+        pread(ctx.data_fd, meta, rec.meta_size, offset + sizeof(rec)) !=
+            (ssize_t)rec.meta_size ||
+        !image_unpack_meta(image, source, meta, rec.meta_size)) {
+        goto done;
+    }
+
+    // map pixel data
+    pixels = record_pixels(&rec);
+    data = mmap(NULL, pixels, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                ctx.data_fd, offset - pixels);
+    if (data == MAP_FAILED) {
+        goto done;
+    }
+    frame = image_create_frames(image, 1);
+    if (!frame) {
+        munmap(data, pixels);
+        goto done;
+    }
+    frame->pm.width = rec.width;
+    frame->pm.height = rec.height;
+    frame->pm.data = data;
+    frame->pm.format = rec.format;
+    frame->shm_size = pixels;
+    frame->shm_fd = -1;
+
+    image->alpha = rec.alpha;
+    image->full_width = rec.full_width;
+    image->full_height = rec.full_height;
+    image->thumbnail = true;
+    image->file_size = st->st_size;
+
+    rc = true;
+
+done:
+    pthread_mutex_unlock(&ctx.lock);
+    free(meta);
+    return rc;
+}
+
+bool tstore_save(const struct image* image, const char* meta,
+                 size_t meta_size, const struct stat* st, uint32_t params)
+{
+    const uint64_t hash = key_hash(image->source, params);
+    struct tstore_record rec;
+    struct tstore_slot* slot;
+    const struct pixmap* pm;
+    uint64_t start, offset;
+    size_t pixels;
+    off_t end;
+    bool rc = false;
+
+    if (!ctx.dir || image->num_frames != 1) {
+        return false;
+    }
+
+    pm = &image->frames[0].pm;
+    pixels = (size_t)pm->width * pm->height * pixmap_bpp(pm->format);
+    if (!pixels) {
+        return false;
+    }
+
+    memset(&rec, 0, sizeof(rec));
+    memcpy(rec.magic, record_signature, sizeof(record_signature));
+    rec.params = params;
+    rec.src_size = st->st_size;
+    rec.src_sec = st->st_mtim.tv_sec;
+    rec.src_nsec = st->st_mtim.tv_nsec;
+    rec.meta_size = meta_size;
+    rec.width = pm->width;
+    rec.height = pm->height;
+    rec.full_width = image->full_width;
+    rec.full_height = image->full_height;
+    rec.alpha = image->alpha;
+    rec.format = pm->format;
+
+    pthread_mutex_lock(&ctx.lock);
+    if (!ctx.index || ctx.compacting || !data_lock(F_WRLCK)) {
+        pthread_mutex_unlock(&ctx.lock);
+        return false;
+    }
+
+    // keep the hash table at most half full
+    if (ctx.index->used * 2 >= ctx.index->capacity &&
+        (!index_create(ctx.index->capacity * 2, index_slots(),
+                       ctx.index->capacity, ctx.index->live,
+                       ctx.index->dead) ||
+         !index_open())) {
+        goto done;
+    }
+    slot = slot_find(index_slots(), ctx.index->capacity, hash);
+    if (!slot) {
+        goto done;
+    }
+
+    // append record to the data file
+    end = lseek(ctx.data_fd, 0, SEEK_END);
+    if (end == -1) {
+        goto done;
+    }
+    start = align(end);
+    offset = start + pixels;
+    if (!write_all(ctx.data_fd, pm->data, pixels, start) ||
+        !write_all(ctx.data_fd, &rec, sizeof(rec), offset) ||
+        !write_all(ctx.data_fd, meta, meta_size, offset + sizeof(rec))) {
+        if (ftruncate(ctx.data_fd, end) == -1) {
+            ctx.index->dead += record_size(&rec);
+        }
+        goto done;
+    }
+
+    // update index, the previous record becomes garbage
+    if (slot->offset) {
+        struct tstore_record old;
+        if (record_read(slot->offset, &old)) {
+            const size_t size = record_size(&old);
+            ctx.index->live -= min(ctx.index->live, size);
+            ctx.index->dead += size;
+        }
+    } else {
+        ++ctx.index->used;
+    }
+    slot->hash = hash;
+    slot->offset = offset;
+    ctx.index->live += record_size(&rec);
+
+    rc = true;
+
+done:
+    data_lock(F_UNLCK);
+    pthread_mutex_unlock(&ctx.lock);
+    return rc;
+}
+
+/**
+ * Compare index slots by offset of the record, used by qsort.
+ */
+static int compare_offsets(const void* a, const void* b)
+{
+    const uint64_t off_a = ((const struct tstore_slot*)a)->offset;
+    const uint64_t off_b = ((const struct tstore_slot*)b)->offset;
+    return off_a < off_b ? -1 : (off_a > off_b ? 1 : 0);
+}
+
+/**
+ * Evict the oldest records which don't fit into the size limit.
+ * @param slots snapshot of the index, sorted by offset
+ * @param num number of slots
+ */
+static void evict_records(struct tstore_slot* slots, size_t num)
+{
+    const uint64_t keep = (uint64_t)ctx.limit * LIMIT_KEEP / 100;
+    uint64_t size = 0;
+
+    // records are appended, so the latest ones are at the end of the file
+    for (size_t i = num; i > 0; --i) {
+        struct tstore_slot* slot = &slots[i - 1];
+        struct tstore_record rec;
+        if (slot->offset) {
+            if (record_read(slot->offset, &rec)) {
+                size += record_size(&rec);
+            }
+            if (size > keep) {
+                slot->offset = 0;
+            }
+        }
+    }
+}
+
+/**
+ * Copy record to the new data file if its source file wasn't changed.
+ * @param fd new data file
+ * @param end pointer to the end of the new data file
+ * @param slot index slot of the record, offset is updated on success
+ * @return size of the copied record or 0 if record is dropped
+ */
+static size_t compact_record(int fd, uint64_t* end, struct tstore_slot* slot)
+{
+    struct tstore_record rec;
+    size_t pixels, size;
+    const char* source;
+    uint8_t* buf;
+    struct stat st;
+
+    if (!record_read(slot->offset, &rec)) {
+        return 0;
+    }
+    pixels = record_pixels(&rec);
+    size = pixels + sizeof(rec) + rec.meta_size;
+    buf = malloc(size);
+    if (!buf) {
+        return 0;
+    }
+    if (pread(ctx.data_fd, buf, size, slot->offset - pixels) !=
+            (ssize_t)size ||
+        rec.meta_size == 0 || buf[size - 1]) {
+        free(buf);
+        return 0;
+    }
+
+    // meta data starts from the source path
+    source = (const char*)buf + pixels + sizeof(rec);
+    if (stat(source, &st) == -1 || rec.src_size != (uint64_t)st.st_size ||
+        rec.src_sec != st.st_mtim.tv_sec ||
+        rec.src_nsec != st.st_mtim.tv_nsec ||
+        !write_all(fd, buf, size, *end)) {
+        free(buf);
+        return 0;
+    }
+    free(buf);
+
+    slot->offset = *end + pixels;
+    *end = align(*end + size);
+
+    return record_size(&rec);
+}
+
+void tstore_compact(bool force)
+{
+    struct tstore_header hdr;
+    struct tstore_slot* slots = NULL;
+    size_t capacity = 0;
+    size_t num = 0;
+    uint64_t live = 0;
+    bool copied;
+    char* path;
+    char* tmp;
+    uint64_t end;
+    int fd;
+
+    if (!ctx.dir) {
+        return;
+    }
+    path = store_path(DATA_FILE, false);
+    tmp = store_path(DATA_FILE, true);
+
+    pthread_mutex_lock(&ctx.lock);
+    if (ctx.index && path && tmp && !ctx.compacting &&
+        (force || ctx.index->dead > ctx.index->live ||
+         (ctx.limit && ctx.index->live + ctx.index->dead > ctx.limit)) &&
+        data_lock(F_WRLCK)) {
+        // snapshot of the index, the data file is not changed until the end
+        capacity = ctx.index->capacity;
+        slots = malloc(capacity * sizeof(*slots));
+        if (slots) {
+            memcpy(slots, index_slots(), capacity * sizeof(*slots));
+            ctx.compacting = true;
+        } else {
+            data_lock(F_UNLCK);
+        }
+    }
+    pthread_mutex_unlock(&ctx.lock);
+    if (!slots) {
+        free(path);
+        free(tmp);
+        return;
+    }
+
+    // keep the order of records, so the oldest ones are evicted first
+    qsort(slots, capacity, sizeof(*slots), compare_offsets);
+    if (ctx.limit) {
+        evict_records(slots, capacity);
+    }
+
+    // copy live records to the new data file
+    fd = data_create(tmp, &hdr);
+    copied = fd != -1;
+    end = ctx.page;
+    for (size_t i = 0; copied && i < capacity; ++i) {
+        if (slots[i].offset) {
+            const size_t size = compact_record(fd, &end, &slots[i]);
+            if (size) {
+                live += size;
+                ++num;
+            } else {
+                slots[i].offset = 0;
+            }
+        }
+    }
+
+    // replace the store files
+    pthread_mutex_lock(&ctx.lock);
+    if (copied && rename(tmp, path) == 0) {
+        size_t new_capacity = INDEX_MIN;
+        while (new_capacity <= num * 2) {
+            new_capacity *= 2;
+        }
+        close(ctx.data_fd); // unlocks the old data file
+        ctx.data_fd = fd;
+        ctx.gen = hdr.gen;
+        fd = -1;
+        if (!index_create(new_capacity, slots, capacity, live, 0) ||
+            !index_open()) {
+            store_close(); // index doesn't match the data file
+        }
+    } else {
+        data_lock(F_UNLCK);
+    }
+    ctx.compacting = false;
+    pthread_mutex_unlock(&ctx.lock);
+
+    if (fd != -1) {
+        close(fd);
+        unlink(tmp);
+    }
+    free(slots);
+    free(path);
+    free(tmp);
+}
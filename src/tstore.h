@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: MIT
+// Packed persistent store of thumbnails.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include "image.h"
+
+#include <sys/stat.h>
+
+/**
+ * Open the thumbnail store in the cache directory.
+ * @param limit max size of stored thumbnails in bytes, 0 for unlimited
+ * @return false if the store is not available
+ */
+bool tstore_init(size_t limit);
+
+/**
+ * Close the thumbnail store, loaded thumbnails stay valid.
+ */
+void tstore_destroy(void);
+
+/**
+ * Load thumbnail from the store: pixel data is mapped from the store file
+ * directly, without copying and decoding.
+ * @param image destination image
+ * @param source path to the original image file
+ * @param st status of the original image file
+ * @param params parameters of the thumbnail (size, scale mode etc)
+ * @return true if thumbnail was loaded
+ */
+bool tstore_load(struct image* image, const char* source,
+                 const struct stat* st, uint32_t params);
+
+/**
+ * Check if the store has the actual thumbnail, pixel data is not accessed.
+ * @param source path to the original image file
+ * @param st status of the original image file
+ * @param params parameters of the thumbnail (size, scale mode etc)
+ * @return true if thumbnail exists
+ */
+bool tstore_check(const char* source, const struct stat* st, uint32_t params);
+
+/**
+ * Append thumbnail to the store, the previous thumbnail of the same source
+ * and parameters becomes garbage.
+ * @param image thumbnail image with a single frame
+ * @param meta,meta_size packed meta info of the image, see `image_pack_meta`
+ * @param st status of the original image file
+ * @param params parameters of the thumbnail (size, scale mode etc)
+ * @return true if thumbnail was saved
+ */
+bool tstore_save(const struct image* image, const char* meta,
+                 size_t meta_size, const struct stat* st, uint32_t params);
+
+/**
+ * Compact the store if at least a half of it is garbage or the size limit is
+ * exceeded: live thumbnails of existing files are moved to the new store
+ * file, the oldest ones are evicted to fit into the limit. Thumbnails are not
+ * saved while compaction is in progress, but can be loaded.
+ * @param force flag to compact regardless of the amount of garbage
+ */
+void tstore_compact(bool force);
@@ -9,8 +9,15 @@
 #include "buildcfg.h"
 #include "font.h"
 #include "info.h"
+#include "perf.h"
+#include "pixmap_ablend.h"
+#include "trace.h"
 #include "wndbuf.h"
 
+#ifdef HAVE_EGL
+#include "gpu.h"
+#endif
+
 // autogenerated wayland headers
 #include "content-type-v1-client-protocol.h"
 #include "cursor-shape-v1-client-protocol.h"
@@ -19,6 +26,8 @@
 #include "xdg-decoration-unstable-v1-client-protocol.h"
 #include "xdg-shell-client-protocol.h"
 
+#include <math.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
@@ -43,8 +52,37 @@
 // Fractional scale denominator
 #define FRACTION_SCALE_DEN 120
 
-// Uncomment the following line to enable printing draw time
-// #define TRACE_DRAW_TIME
+// Max number of window buffers: the third one is allocated only if both are
+// still used by compositor at the time of redraw
+#define MAX_BUFFERS 3
+
+// Max size of the image layer, limited by compositor's texture size
+#define LAYER_MAX_SIZE 16384
+
+/** Damaged region of the window: bounding box of all changes. */
+struct damage {
+    ssize_t left;   ///< Left edge
+    ssize_t top;    ///< Top edge
+    ssize_t right;  ///< Right edge, region is empty if it is not after left
+    ssize_t bottom; ///< Bottom edge
+};
+
+/** Set of buffers attached to a surface. */
+struct buffers {
+    // each buffer keeps all changes made since it was drawn last time
+    struct wndbuf_pool pool;                ///< Shared memory pool
+    struct wl_buffer* buffers[MAX_BUFFERS]; ///< Buffer pool
+    struct damage damage[MAX_BUFFERS];      ///< Regions to repaint
+    size_t num;           ///< Number of allocated buffers
+    size_t current;       ///< Index of the last drawn buffer
+    ssize_t next;         ///< Index of the buffer to draw, -1 if not set
+    struct damage frame;  ///< Changes since the last commit
+    struct pixmap canvas; ///< Canvas for partial redraw
+    ssize_t canvas_x;     ///< Canvas position on the window
+    ssize_t canvas_y;     ///< Canvas position on the window
+    bool partial;         ///< Current redraw uses canvas
+    bool drawn;           ///< Buffer was drawn in the current frame
+};
 
 /** UI context */
 struct ui {
@@ -54,6 +92,7 @@ struct ui {
         struct wl_registry* registry;
         struct wl_shm* shm;
         struct wl_compositor* compositor;
+        struct wl_subcompositor* subcompositor;
         struct wl_seat* seat;
         struct wl_keyboard* keyboard;
         struct wl_pointer* pointer;
@@ -76,17 +115,41 @@ struct ui {
 
     // window buffers
     struct wnd {
-        struct wl_buffer* buffer0;
-        struct wl_buffer* buffer1;
-        struct wl_buffer* current;
         size_t width;
         size_t height;
         size_t scale;
-#ifdef TRACE_DRAW_TIME
-        struct timespec draw_time;
-#endif
+        struct buffers main;          ///< Window buffers
+        bool deferred;                ///< Redraw postponed until release
+        struct wl_callback* frame_cb; ///< Pending frame callback
+        uint64_t draw_start;          ///< Start time of the frame drawing
     } wnd;
 
+    // text overlay: transparent subsurface above the window and image layer,
+    // if compositor doesn't support subsurfaces, text is drawn on the window
+    struct overlay {
+        struct wl_surface* surface;       ///< Overlay surface
+        struct wl_subsurface* subsurface; ///< Overlay subsurface
+        struct wp_viewport* viewport;     ///< Viewport for fractional scale
+        struct buffers bufs;              ///< Overlay buffers
+    } overlay;
+
+    // image layer: subsurface scaled by compositor
+    struct layer {
+        struct wl_surface* surface;       ///< Layer surface
+        struct wl_subsurface* subsurface; ///< Layer subsurface
+        struct wp_viewport* viewport;     ///< Viewport to scale the image
+        struct wndbuf_pool pool;          ///< Shared memory pool
+        struct wl_buffer* buffers[2];     ///< Uploaded image buffers
+        struct wl_buffer* shared;         ///< Buffer of image shared memory
+        size_t current;                   ///< Index of the attached buffer
+        const argb_t* source;             ///< Uploaded pixels
+        size_t width, height;             ///< Size of the uploaded image
+        bool shown;                       ///< Layer is visible
+        bool used;                        ///< Layer is set in current frame
+        bool use_gpu;                     ///< GPU rendering is enabled
+        bool gpu;                         ///< Layer is drawn by GPU
+    } layer;
+
     // cross-desktop
     struct xdg {
         bool initialized;
@@ -127,6 +190,8 @@ struct ui {
 /** Global UI context instance. */
 static struct ui ctx = {
     .wnd.scale = FRACTION_SCALE_DEN,
+    .wnd.main.next = -1,
+    .overlay.bufs.next = -1,
     .repeat.fd = -1,
 };
 
@@ -142,28 +207,559 @@ static inline void set_timespec(struct timespec* ts, uint32_t ms)
 }
 
 /**
- * Recreate window buffers.
- * @return true if operation completed successfully
+ * Add rectangle to the damaged region.
+ * @param dmg damaged region to extend
+ * @param left,top,right,bottom edges of the rectangle
  */
-static bool recreate_buffers(void)
+static void damage_add(struct damage* dmg, ssize_t left, ssize_t top,
+                       ssize_t right, ssize_t bottom)
+{
+    if (dmg->right <= dmg->left || dmg->bottom <= dmg->top) {
+        dmg->left = left;
+        dmg->top = top;
+        dmg->right = right;
+        dmg->bottom = bottom;
+    } else {
+        dmg->left = min(dmg->left, left);
+        dmg->top = min(dmg->top, top);
+        dmg->right = max(dmg->right, right);
+        dmg->bottom = max(dmg->bottom, bottom);
+    }
+}
+
+/**
+ * Free all buffers of the set.
+ * @param bufs buffer set
+ */
+static void free_buffers(struct buffers* bufs)
+{
+    for (size_t i = 0; i < bufs->num; ++i) {
+        wndbuf_free(bufs->buffers[i]);
+        bufs->buffers[i] = NULL;
+    }
+    bufs->num = 0;
+    bufs->current = 0;
+    bufs->next = -1;
+    bufs->drawn = false;
+}
+
+/**
+ * Free buffer set and all its resources.
+ * @param bufs buffer set
+ */
+static void destroy_buffers(struct buffers* bufs)
+{
+    free_buffers(bufs);
+    wndbuf_pool_free(&bufs->pool);
+    pixmap_free(&bufs->canvas);
+    memset(&bufs->canvas, 0, sizeof(bufs->canvas));
+}
+
+/**
+ * Restart postponed redraw.
+ */
+static void resume_redraw(void)
+{
+    if (ctx.wnd.deferred) {
+        ctx.wnd.deferred = false;
+        app_redraw_area(0, 0, 0, 0); // damage is already recorded
+    }
+}
+
+/**
+ * Buffer release handler: draw the postponed frame.
+ */
+static void on_buffer_release(void)
+{
+    resume_redraw();
+}
+
+/**
+ * Add new buffer to the set.
+ * @param bufs buffer set
+ * @return true if buffer was created
+ */
+static bool add_buffer(struct buffers* bufs)
 {
+    const size_t idx = bufs->num;
     const size_t width = ui_get_width();
     const size_t height = ui_get_height();
+    struct wl_buffer* buffer;
+
+    if (idx >= MAX_BUFFERS) {
+        return false;
+    }
+
+    buffer = wndbuf_create(&bufs->pool, idx * width * height * sizeof(argb_t),
+                           width, height, on_buffer_release);
+    if (!buffer) {
+        return false;
+    }
+
+    // new buffer has no content
+    bufs->buffers[idx] = buffer;
+    memset(&bufs->damage[idx], 0, sizeof(bufs->damage[idx]));
+    damage_add(&bufs->damage[idx], 0, 0, width, height);
+    ++bufs->num;
+
+    return true;
+}
+
+/**
+ * Get buffer to draw on: free one with the least damage.
+ * @param bufs buffer set
+ * @return index of the buffer or -1 if all buffers are busy
+ */
+static ssize_t get_free_buffer(struct buffers* bufs)
+{
+    ssize_t found = -1;
+    size_t found_area = 0;
+
+    for (size_t i = 0; i < bufs->num; ++i) {
+        const struct damage* dmg = &bufs->damage[i];
+        size_t area = 0;
+        if (wndbuf_busy(bufs->buffers[i])) {
+            continue;
+        }
+        if (dmg->left < dmg->right && dmg->top < dmg->bottom) {
+            area = (dmg->right - dmg->left) * (dmg->bottom - dmg->top);
+        }
+        if (found < 0 || area < found_area) {
+            found = i;
+            found_area = area;
+        }
+    }
+
+    if (found < 0 && add_buffer(bufs)) {
+        found = bufs->num - 1;
+    }
+
+    return found;
+}
+
+/**
+ * Recreate buffers of the set for the current window size.
+ * @param bufs buffer set
+ * @return true if operation completed successfully
+ */
+static bool init_buffers(struct buffers* bufs)
+{
+    const size_t buffer_sz = ui_get_width() * ui_get_height() * sizeof(argb_t);
+    bool busy = false;
+
+    for (size_t i = 0; i < bufs->num; ++i) {
+        busy |= wndbuf_busy(bufs->buffers[i]);
+    }
+
+    free_buffers(bufs);
+    memset(&bufs->frame, 0, sizeof(bufs->frame));
+
+    if (busy) {
+        // compositor may still read the freed buffers, so the new ones are
+        // created in a fresh pool instead of overwriting the same offsets
+        wndbuf_pool_free(&bufs->pool);
+    }
+
+    // reserve space for all buffers, memory of the shared file is allocated
+    // on the first access, so the unused third buffer is almost free
+    if (!wndbuf_pool_reserve(&bufs->pool, ctx.wl.shm,
+                             MAX_BUFFERS * buffer_sz)) {
+        return false;
+    }
+
+    // start with double buffering
+    if (!add_buffer(bufs) || !add_buffer(bufs)) {
+        free_buffers(bufs);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Recreate window and overlay buffers.
+ * @return true if operation completed successfully
+ */
+static bool recreate_buffers(void)
+{
+    if (!init_buffers(&ctx.wnd.main)) {
+        return false;
+    }
+    if (ctx.overlay.surface && !init_buffers(&ctx.overlay.bufs)) {
+        free_buffers(&ctx.wnd.main);
+        return false;
+    }
+
+    ui_damage_all();
+
+    return true;
+}
+
+/**
+ * Add changed region to the buffer set.
+ * @param bufs buffer set
+ * @param x,y,width,height changed region in window coordinates
+ */
+static void damage_buffers(struct buffers* bufs, ssize_t x, ssize_t y,
+                           size_t width, size_t height)
+{
+    const ssize_t left = max(0, x);
+    const ssize_t top = max(0, y);
+    const ssize_t right = min((ssize_t)ui_get_width(), x + (ssize_t)width);
+    const ssize_t bottom = min((ssize_t)ui_get_height(), y + (ssize_t)height);
+
+    if (left < right && top < bottom) {
+        for (size_t i = 0; i < bufs->num; ++i) {
+            damage_add(&bufs->damage[i], left, top, right, bottom);
+        }
+        damage_add(&bufs->frame, left, top, right, bottom);
+    }
+}
+
+/**
+ * Get canvas to repaint the damaged region of the next buffer.
+ * @param bufs buffer set
+ * @param force_canvas flag to draw on the canvas even for full redraw
+ * @param x,y pointers to get position of the canvas on the window
+ * @return canvas pixmap or NULL if there is nothing to redraw
+ */
+static struct pixmap* draw_buffers(struct buffers* bufs, bool force_canvas,
+                                   ssize_t* x, ssize_t* y)
+{
+    struct damage* dmg;
+    struct pixmap* wnd;
+    ssize_t right, bottom;
+
+    if (bufs->next < 0) {
+        return NULL;
+    }
+
+    dmg = &bufs->damage[bufs->next];
+    wnd = wndbuf_pixmap(bufs->buffers[bufs->next]);
+    right = min((ssize_t)wnd->width, dmg->right);
+    bottom = min((ssize_t)wnd->height, dmg->bottom);
+    if (right <= dmg->left || bottom <= dmg->top) {
+        return NULL; // nothing changed
+    }
+
+    bufs->current = bufs->next;
+    bufs->next = -1;
+    bufs->drawn = true;
+    bufs->canvas_x = dmg->left;
+    bufs->canvas_y = dmg->top;
+    bufs->partial = force_canvas ||
+        (dmg->left != 0 || dmg->top != 0 || right != (ssize_t)wnd->width ||
+         bottom != (ssize_t)wnd->height);
+    memset(dmg, 0, sizeof(*dmg));
+
+    if (bufs->partial) {
+        // draw damaged region on the canvas, then put it to the buffer
+        const size_t width = right - bufs->canvas_x;
+        const size_t height = bottom - bufs->canvas_y;
+        if (bufs->canvas.width != width || bufs->canvas.height != height) {
+            pixmap_free(&bufs->canvas);
+            if (!pixmap_create(&bufs->canvas, width, height)) {
+                memset(&bufs->canvas, 0, sizeof(bufs->canvas));
+                bufs->partial = false;
+            }
+        }
+    }
+    if (!bufs->partial) {
+        // repaint the whole buffer
+        bufs->canvas_x = 0;
+        bufs->canvas_y = 0;
+    }
+
+    *x = bufs->canvas_x;
+    *y = bufs->canvas_y;
+
+    return bufs->partial ? &bufs->canvas : wnd;
+}
+
+/**
+ * Attach the drawn buffer to the surface.
+ * @param bufs buffer set
+ * @param surface target surface
+ * @param alpha true if surface has transparent pixels
+ * @return true if buffer was attached
+ */
+static bool commit_buffers(struct buffers* bufs, struct wl_surface* surface,
+                           bool alpha)
+{
+    struct wl_buffer* buffer = bufs->buffers[bufs->current];
+    struct pixmap* wnd = wndbuf_pixmap(buffer);
+    struct damage* frame = &bufs->frame;
+
+    if (!bufs->drawn) {
+        return false;
+    }
+    bufs->drawn = false;
+
+    if (bufs->partial) {
+        if (alpha) {
+            const struct pixmap* cnv = &bufs->canvas;
+            for (size_t y = 0; y < cnv->height; ++y) {
+                const size_t offset =
+                    (bufs->canvas_y + y) * wnd->width + bufs->canvas_x;
+                alpha_premultiply(&cnv->data[y * cnv->width],
+                                  &wnd->data[offset], cnv->width);
+            }
+        } else {
+            pixmap_copy(&bufs->canvas, wnd, bufs->canvas_x, bufs->canvas_y,
+                        false);
+        }
+    }
+
+    wl_surface_attach(surface, buffer, 0, 0);
+    if (frame->left < frame->right && frame->top < frame->bottom) {
+        // compositor needs only changes since the previous frame
+        wl_surface_damage_buffer(surface, frame->left, frame->top,
+                                 frame->right - frame->left,
+                                 frame->bottom - frame->top);
+    }
+    wndbuf_lock(buffer);
+
+    memset(frame, 0, sizeof(*frame));
+
+    return true;
+}
+
+/**
+ * Create surface for the text overlay.
+ */
+static void create_overlay(void)
+{
+    struct wl_region* region;
+
+    ctx.overlay.surface = wl_compositor_create_surface(ctx.wl.compositor);
+    if (!ctx.overlay.surface) {
+        return;
+    }
+    ctx.overlay.subsurface = wl_subcompositor_get_subsurface(
+        ctx.wl.subcompositor, ctx.overlay.surface, ctx.wl.surface);
+    ctx.overlay.viewport =
+        wp_viewporter_get_viewport(ctx.wp.viewporter, ctx.overlay.surface);
+
+    // pass all input events to the main surface
+    region = wl_compositor_create_region(ctx.wl.compositor);
+    wl_surface_set_input_region(ctx.overlay.surface, region);
+    wl_region_destroy(region);
+}
+
+/**
+ * Destroy text overlay surface.
+ */
+static void destroy_overlay(void)
+{
+    if (ctx.overlay.viewport) {
+        wp_viewport_destroy(ctx.overlay.viewport);
+    }
+    if (ctx.overlay.subsurface) {
+        wl_subsurface_destroy(ctx.overlay.subsurface);
+    }
+    if (ctx.overlay.surface) {
+        wl_surface_destroy(ctx.overlay.surface);
+    }
+    destroy_buffers(&ctx.overlay.bufs);
+    memset(&ctx.overlay, 0, sizeof(ctx.overlay));
+}
+
+/**
+ * Free image layer buffers.
+ */
+static void free_layer_buffers(void)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(ctx.layer.buffers); ++i) {
+        wndbuf_free(ctx.layer.buffers[i]);
+        ctx.layer.buffers[i] = NULL;
+    }
+    wndbuf_pool_free(&ctx.layer.pool);
+    if (ctx.layer.shared) {
+        wl_buffer_destroy(ctx.layer.shared);
+        ctx.layer.shared = NULL;
+    }
+    ctx.layer.source = NULL;
+    ctx.layer.width = 0;
+    ctx.layer.height = 0;
+}
+
+/**
+ * Create image layer surface.
+ * @return true if layer is ready to use
+ */
+static bool create_layer(void)
+{
+    struct wl_region* region;
+
+    if (ctx.layer.surface) {
+        return true;
+    }
+    if (!ctx.wl.subcompositor || !ctx.wp.viewporter) {
+        return false;
+    }
 
-    // recreate buffers
-    ctx.wnd.current = NULL;
-    wndbuf_free(ctx.wnd.buffer0);
-    wndbuf_free(ctx.wnd.buffer1);
-    ctx.wnd.buffer0 = wndbuf_create(ctx.wl.shm, width, height);
-    ctx.wnd.buffer1 = wndbuf_create(ctx.wl.shm, width, height);
-    if (!ctx.wnd.buffer0 || !ctx.wnd.buffer1) {
+    ctx.layer.surface = wl_compositor_create_surface(ctx.wl.compositor);
+    if (!ctx.layer.surface) {
         return false;
     }
-    ctx.wnd.current = ctx.wnd.buffer0;
+    ctx.layer.subsurface = wl_subcompositor_get_subsurface(
+        ctx.wl.subcompositor, ctx.layer.surface, ctx.wl.surface);
+    ctx.layer.viewport =
+        wp_viewporter_get_viewport(ctx.wp.viewporter, ctx.layer.surface);
+    if (ctx.overlay.subsurface) {
+        // keep the text above the image
+        wl_subsurface_place_below(ctx.layer.subsurface, ctx.overlay.surface);
+    }
+
+    // pass all input events to the main surface
+    region = wl_compositor_create_region(ctx.wl.compositor);
+    wl_surface_set_input_region(ctx.layer.surface, region);
+    wl_region_destroy(region);
+
+#ifdef HAVE_EGL
+    if (ctx.layer.use_gpu) {
+        ctx.layer.gpu = gpu_init(ctx.wl.display, ctx.layer.surface);
+        if (!ctx.layer.gpu) {
+            fprintf(stderr, "GPU rendering is not available\n");
+        }
+    }
+#endif
 
     return true;
 }
 
+/**
+ * Destroy image layer surface.
+ */
+static void destroy_layer(void)
+{
+#ifdef HAVE_EGL
+    if (ctx.layer.gpu) {
+        gpu_destroy();
+    }
+#endif
+    if (ctx.layer.viewport) {
+        wp_viewport_destroy(ctx.layer.viewport);
+    }
+    if (ctx.layer.subsurface) {
+        wl_subsurface_destroy(ctx.layer.subsurface);
+    }
+    if (ctx.layer.surface) {
+        wl_surface_destroy(ctx.layer.surface);
+    }
+    free_layer_buffers();
+    memset(&ctx.layer, 0, sizeof(ctx.layer));
+}
+
+/**
+ * Upload image to the layer buffer.
+ * @param pm image pixmap
+ * @param alpha true if image has transparent pixels
+ * @return true if image was uploaded
+ */
+static bool upload_layer(const struct pixmap* pm, bool alpha)
+{
+    const size_t buffer_sz = pm->width * pm->height * sizeof(argb_t);
+    struct wl_buffer* buffer;
+    struct pixmap* dst;
+    size_t idx;
+
+    if (ctx.layer.shared || ctx.layer.width != pm->width ||
+        ctx.layer.height != pm->height) {
+        // buffers are never reused for different size
+        free_layer_buffers();
+        if (!wndbuf_pool_reserve(&ctx.layer.pool, ctx.wl.shm,
+                                 ARRAY_SIZE(ctx.layer.buffers) * buffer_sz)) {
+            return false;
+        }
+        ctx.layer.width = pm->width;
+        ctx.layer.height = pm->height;
+    }
+
+    // use the buffer that is not attached now, the current one is reused
+    // only if compositor already released it
+    idx = ctx.layer.buffers[ctx.layer.current] ? !ctx.layer.current : 0;
+    if (ctx.layer.buffers[idx] && wndbuf_busy(ctx.layer.buffers[idx])) {
+        idx = !idx;
+        if (ctx.layer.buffers[idx] && wndbuf_busy(ctx.layer.buffers[idx])) {
+            return false;
+        }
+    }
+    if (!ctx.layer.buffers[idx]) {
+        ctx.layer.buffers[idx] =
+            wndbuf_create(&ctx.layer.pool, idx * buffer_sz, pm->width,
+                          pm->height, NULL);
+        if (!ctx.layer.buffers[idx]) {
+            return false;
+        }
+    }
+    buffer = ctx.layer.buffers[idx];
+    dst = wndbuf_pixmap(buffer);
+
+    if (alpha) {
+        alpha_premultiply(pm->data, dst->data, pm->width * pm->height);
+    } else {
+        memcpy(dst->data, pm->data, buffer_sz);
+    }
+
+    wl_surface_attach(ctx.layer.surface, buffer, 0, 0);
+    wl_surface_damage_buffer(ctx.layer.surface, 0, 0, pm->width, pm->height);
+    wndbuf_lock(buffer);
+    ctx.layer.current = idx;
+    ctx.layer.source = pm->data;
+
+    return true;
+}
+
+/**
+ * Attach image to the layer without copying: the compositor reads pixels
+ * directly from the shared memory of the image.
+ * @param pm image pixmap, must be opaque
+ * @param fd shared memory file of the pixmap data
+ * @return true if image was attached
+ */
+static bool attach_shared(const struct pixmap* pm, int fd)
+{
+    const size_t stride = pm->width * sizeof(argb_t);
+    struct wl_shm_pool* pool;
+
+    if (!ctx.layer.shared || ctx.layer.source != pm->data) {
+        free_layer_buffers();
+        pool = wl_shm_create_pool(ctx.wl.shm, fd, stride * pm->height);
+        if (!pool) {
+            return false;
+        }
+        // the buffer keeps memory of the destroyed pool referenced
+        ctx.layer.shared =
+            wl_shm_pool_create_buffer(pool, 0, pm->width, pm->height, stride,
+                                      WL_SHM_FORMAT_XRGB8888);
+        wl_shm_pool_destroy(pool);
+        if (!ctx.layer.shared) {
+            return false;
+        }
+        ctx.layer.source = pm->data;
+        ctx.layer.width = pm->width;
+        ctx.layer.height = pm->height;
+    }
+
+    wl_surface_attach(ctx.layer.surface, ctx.layer.shared, 0, 0);
+    wl_surface_damage_buffer(ctx.layer.surface, 0, 0, pm->width, pm->height);
+
+    return true;
+}
+
+/**
+ * Hide image layer.
+ */
+static void hide_layer(void)
+{
+    if (ctx.layer.shown) {
+        wl_surface_attach(ctx.layer.surface, NULL, 0, 0);
+        wl_surface_commit(ctx.layer.surface);
+        ctx.layer.shown = false;
+    }
+}
+
 // suppress unused parameter warnings
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
@@ -407,6 +1003,21 @@ static const struct wl_seat_listener seat_listener = {
     .name = on_seat_name,
 };
 
+/*******************************************************************************
+ * Surface frame handlers
+ ******************************************************************************/
+static void on_frame_done(void* data, struct wl_callback* callback,
+                          uint32_t time)
+{
+    wl_callback_destroy(callback);
+    ctx.wnd.frame_cb = NULL;
+    resume_redraw();
+}
+
+static const struct wl_callback_listener frame_listener = {
+    .done = on_frame_done,
+};
+
 /*******************************************************************************
  * XDG handlers
  ******************************************************************************/
@@ -418,8 +1029,12 @@ static void on_xdg_surface_configure(void* data, struct xdg_surface* surface,
     if (ctx.xdg.initialized) {
         app_redraw();
     } else {
-        wl_surface_attach(ctx.wl.surface, ctx.wnd.current, 0, 0);
+        struct wl_buffer* buffer = ctx.wnd.main.buffers[ctx.wnd.main.current];
+        wl_surface_attach(ctx.wl.surface, buffer, 0, 0);
         wl_surface_commit(ctx.wl.surface);
+        if (buffer) {
+            wndbuf_lock(buffer);
+        }
     }
 }
 
@@ -440,7 +1055,7 @@ static void handle_xdg_toplevel_configure(void* data, struct xdg_toplevel* lvl,
                                           int32_t width, int32_t height,
                                           struct wl_array* states)
 {
-    bool reset_buffers = (ctx.wnd.current == NULL);
+    bool reset_buffers = (ctx.wnd.main.num == 0);
 
     if (width > 0 && height > 0) {
         if (ctx.wnd.width != (size_t)width ||
@@ -452,6 +1067,9 @@ static void handle_xdg_toplevel_configure(void* data, struct xdg_toplevel* lvl,
         if (ctx.wp.viewport) {
             wp_viewport_set_destination(ctx.wp.viewport, width, height);
         }
+        if (ctx.overlay.viewport) {
+            wp_viewport_set_destination(ctx.overlay.viewport, width, height);
+        }
         ctx.xdg.initialized = true;
     }
 
@@ -510,6 +1128,12 @@ static void on_registry_global(void* data, struct wl_registry* registry,
             wl_registry_bind(registry, name, &wl_compositor_interface,
                              WL_SURFACE_DAMAGE_BUFFER_SINCE_VERSION);
 
+    } else if (strcmp(interface, wl_subcompositor_interface.name) == 0) {
+        // subsurfaces (image layer)
+        ctx.wl.subcompositor = wl_registry_bind(
+            registry, name, &wl_subcompositor_interface,
+            WL_SUBCOMPOSITOR_GET_SUBSURFACE_SINCE_VERSION);
+
     } else if (strcmp(interface, wl_shm_interface.name) == 0) {
         // wayland shared memory
         ctx.wl.shm = wl_registry_bind(registry, name, &wl_shm_interface,
@@ -649,6 +1273,9 @@ bool ui_init(const char* app_id, size_t width, size_t height, bool decor)
     if (ctx.wp.viewporter) {
         ctx.wp.viewport =
             wp_viewporter_get_viewport(ctx.wp.viewporter, ctx.wl.surface);
+        if (ctx.wl.subcompositor) {
+            create_overlay();
+        }
     }
 
     if (ctx.wp.ctype_manager) {
@@ -669,16 +1296,20 @@ bool ui_init(const char* app_id, size_t width, size_t height, bool decor)
 
     wl_surface_commit(ctx.wl.surface);
 
-    app_watch(wl_display_get_fd(ctx.wl.display), on_wayland_event, NULL);
+    app_watch(wl_display_get_fd(ctx.wl.display), POLLIN, on_wayland_event,
+              NULL);
 
     ctx.repeat.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-    app_watch(ctx.repeat.fd, on_key_repeat, NULL);
+    app_watch(ctx.repeat.fd, POLLIN, on_key_repeat, NULL);
 
     return true;
 }
 
 void ui_destroy(void)
 {
+    destroy_layer();
+    destroy_overlay();
+
     // free protocols
     if (ctx.wp.scale_manager) {
         if (ctx.wp.scale) {
@@ -734,8 +1365,10 @@ void ui_destroy(void)
     }
 
     // window buffers
-    wndbuf_free(ctx.wnd.buffer0);
-    wndbuf_free(ctx.wnd.buffer1);
+    if (ctx.wnd.frame_cb) {
+        wl_callback_destroy(ctx.wnd.frame_cb);
+    }
+    destroy_buffers(&ctx.wnd.main);
 
     // base wayland
     if (ctx.wl.seat) {
@@ -756,6 +1389,9 @@ void ui_destroy(void)
     if (ctx.wl.surface) {
         wl_surface_destroy(ctx.wl.surface);
     }
+    if (ctx.wl.subcompositor) {
+        wl_subcompositor_destroy(ctx.wl.subcompositor);
+    }
     if (ctx.wl.compositor) {
         wl_compositor_destroy(ctx.wl.compositor);
     }
@@ -785,43 +1421,267 @@ void ui_event_done(void)
     }
 }
 
-struct pixmap* ui_draw_begin(void)
+void ui_event_pump(void)
 {
-    if (!ctx.wnd.current) {
-        return NULL; // not yet initialized
+    struct pollfd fds = { .events = POLLIN };
+    const bool prepared = !ctx.event_handled; // read intent is held
+
+    if (!ctx.wl.display) {
+        return;
+    }
+
+    if (!prepared) {
+        while (wl_display_prepare_read(ctx.wl.display) != 0) {
+            wl_display_dispatch_pending(ctx.wl.display);
+        }
+    }
+    wl_display_flush(ctx.wl.display);
+
+    fds.fd = wl_display_get_fd(ctx.wl.display);
+    if (poll(&fds, 1, 0) > 0) {
+        wl_display_read_events(ctx.wl.display);
+    } else {
+        wl_display_cancel_read(ctx.wl.display);
+    }
+    wl_display_dispatch_pending(ctx.wl.display);
+
+    if (prepared) {
+        // restore read intent for the main loop
+        while (wl_display_prepare_read(ctx.wl.display) != 0) {
+            wl_display_dispatch_pending(ctx.wl.display);
+        }
     }
+}
+
+void ui_damage(ssize_t x, ssize_t y, size_t width, size_t height)
+{
+    damage_buffers(&ctx.wnd.main, x, y, width, height);
+}
 
-    // switch buffers
-    if (ctx.wnd.current == ctx.wnd.buffer0) {
-        ctx.wnd.current = ctx.wnd.buffer1;
+void ui_damage_overlay(ssize_t x, ssize_t y, size_t width, size_t height)
+{
+    if (ctx.overlay.surface) {
+        damage_buffers(&ctx.overlay.bufs, x, y, width, height);
     } else {
-        ctx.wnd.current = ctx.wnd.buffer0;
+        // text is drawn on the window surface
+        damage_buffers(&ctx.wnd.main, x, y, width, height);
     }
+}
 
-#ifdef TRACE_DRAW_TIME
-    clock_gettime(CLOCK_MONOTONIC, &ctx.wnd.draw_time);
-#endif
+void ui_damage_all(void)
+{
+    ui_damage(0, 0, ui_get_width(), ui_get_height());
+    ui_damage_overlay(0, 0, ui_get_width(), ui_get_height());
+}
+
+bool ui_draw_begin(void)
+{
+    if (ctx.wnd.main.num == 0) {
+        return false; // not yet initialized
+    }
+
+    // render at most once per frame, surface is not visible if compositor
+    // doesn't call the frame callback
+    if (ctx.wnd.frame_cb) {
+        ctx.wnd.deferred = true;
+        return false;
+    }
+
+    // get buffers that are not used by compositor
+    ctx.wnd.main.next = get_free_buffer(&ctx.wnd.main);
+    if (ctx.overlay.surface) {
+        ctx.overlay.bufs.next = get_free_buffer(&ctx.overlay.bufs);
+    }
+    if (ctx.wnd.main.next < 0 ||
+        (ctx.overlay.surface && ctx.overlay.bufs.next < 0)) {
+        ctx.wnd.main.next = -1;
+        ctx.overlay.bufs.next = -1;
+        ctx.wnd.deferred = true;
+        return false;
+    }
+
+    ctx.layer.used = false;
+    ctx.wnd.draw_start = perf_now();
+
+    return true;
+}
+
+struct pixmap* ui_draw_window(ssize_t* x, ssize_t* y)
+{
+    return draw_buffers(&ctx.wnd.main, false, x, y);
+}
+
+struct pixmap* ui_draw_overlay(ssize_t* x, ssize_t* y)
+{
+    struct pixmap* canvas;
+
+    if (!ctx.overlay.surface) {
+        // draw on top of the window canvas
+        struct buffers* bufs = &ctx.wnd.main;
+        if (!bufs->drawn) {
+            return NULL;
+        }
+        *x = bufs->canvas_x;
+        *y = bufs->canvas_y;
+        return bufs->partial ? &bufs->canvas
+                             : wndbuf_pixmap(bufs->buffers[bufs->current]);
+    }
+
+    canvas = draw_buffers(&ctx.overlay.bufs, true, x, y);
+    if (canvas) {
+        memset(canvas->data, 0, canvas->width * canvas->height * sizeof(argb_t));
+    }
 
-    return wndbuf_pixmap(ctx.wnd.current);
+    return canvas;
 }
 
 void ui_draw_commit(void)
 {
-    const struct pixmap* pm = wndbuf_pixmap(ctx.wnd.current);
+    const bool window = ctx.wnd.main.drawn;
+    bool overlay = false;
 
-#ifdef TRACE_DRAW_TIME
-    struct timespec curr;
-    clock_gettime(CLOCK_MONOTONIC, &curr);
-    const double ns = (curr.tv_sec * 1000000000 + curr.tv_nsec) -
-        (ctx.wnd.draw_time.tv_sec * 1000000000 + ctx.wnd.draw_time.tv_nsec);
-    printf("Rendered in %.6f sec\n", ns / 1000000000);
-#endif
+    ctx.wnd.main.next = -1;
+    ctx.overlay.bufs.next = -1;
+
+    if (window && !ctx.layer.used) {
+        hide_layer();
+    }
+
+    if (ctx.overlay.surface) {
+        overlay = commit_buffers(&ctx.overlay.bufs, ctx.overlay.surface, true);
+        if (overlay) {
+            // subsurface is synchronized: applied with the main surface
+            wl_surface_commit(ctx.overlay.surface);
+        }
+    }
+    commit_buffers(&ctx.wnd.main, ctx.wl.surface, false);
+
+    if (!window && !overlay) {
+        return; // nothing changed
+    }
+
+    if (window) {
+        perf_frame(ctx.wnd.draw_start);
+    }
+    trace_span("frame", window ? NULL : "overlay", ctx.wnd.draw_start);
 
-    wl_surface_attach(ctx.wl.surface, ctx.wnd.current, 0, 0);
-    wl_surface_damage_buffer(ctx.wl.surface, 0, 0, pm->width, pm->height);
+    ctx.wnd.frame_cb = wl_surface_frame(ctx.wl.surface);
+    wl_callback_add_listener(ctx.wnd.frame_cb, &frame_listener, NULL);
     wl_surface_commit(ctx.wl.surface);
 }
 
+void ui_layer_use_gpu(bool enable)
+{
+    ctx.layer.use_gpu = enable;
+}
+
+bool ui_layer_show(const struct pixmap* pm, int fd, bool alpha, bool changed,
+                   ssize_t x, ssize_t y, double scale, enum aa_mode aa)
+{
+    const double wnd_scale = (double)ctx.wnd.scale / FRACTION_SCALE_DEN;
+    const ssize_t width = scale * pm->width;
+    const ssize_t height = scale * pm->height;
+    size_t max_size = LAYER_MAX_SIZE;
+    wl_fixed_t src_x, src_y, src_w, src_h;
+    ssize_t left, top, right, bottom;
+    bool uploaded = false;
+
+    if (!create_layer()) {
+        return false;
+    }
+#ifdef HAVE_EGL
+    if (ctx.layer.gpu) {
+        max_size = gpu_max_size();
+    }
+#endif
+    if (pm->width > max_size || pm->height > max_size) {
+        return false;
+    }
+
+    // visible part of the image in surface coordinates
+    left = round(max(0, x) / wnd_scale);
+    top = round(max(0, y) / wnd_scale);
+    right = round(min((ssize_t)ui_get_width(), x + width) / wnd_scale);
+    bottom = round(min((ssize_t)ui_get_height(), y + height) / wnd_scale);
+    if (right <= left || bottom <= top) {
+        ctx.layer.used = true;
+        hide_layer();
+        return true; // image is out of window
+    }
+
+    if (ctx.layer.width != pm->width || ctx.layer.height != pm->height) {
+        changed = true;
+    }
+
+#ifdef HAVE_EGL
+    if (ctx.layer.gpu) {
+        // draw visible part of the image in real pixels
+        const size_t buf_width = round((right - left) * wnd_scale);
+        const size_t buf_height = round((bottom - top) * wnd_scale);
+        const double img_x = (left * wnd_scale - x) / scale;
+        const double img_y = (top * wnd_scale - y) / scale;
+        if (changed || ctx.layer.source != pm->data) {
+            if (!gpu_upload(pm, alpha)) {
+                return false;
+            }
+            ctx.layer.source = pm->data;
+            ctx.layer.width = pm->width;
+            ctx.layer.height = pm->height;
+        }
+        wp_viewport_set_destination(ctx.layer.viewport, right - left,
+                                    bottom - top);
+        wl_subsurface_set_position(ctx.layer.subsurface, left, top);
+        // swap commits the surface, it is applied with the main surface
+        if (!gpu_draw(buf_width, buf_height, img_x, img_y, scale, aa)) {
+            return false;
+        }
+        ctx.layer.shown = true;
+        ctx.layer.used = true;
+        return true;
+    }
+#endif // HAVE_EGL
+
+    if (changed || ctx.layer.source != pm->data) {
+        uploaded = fd != -1 && !alpha && attach_shared(pm, fd);
+        if (!uploaded && !upload_layer(pm, alpha)) {
+            return false;
+        }
+        uploaded = true;
+    }
+
+    // crop the visible part of the image, it must be inside the buffer
+    src_x = wl_fixed_from_double((left * wnd_scale - x) / scale);
+    src_y = wl_fixed_from_double((top * wnd_scale - y) / scale);
+    src_x = max(0, min(src_x, wl_fixed_from_int(pm->width) - 1));
+    src_y = max(0, min(src_y, wl_fixed_from_int(pm->height) - 1));
+    src_w = wl_fixed_from_double((right - left) * wnd_scale / scale);
+    src_h = wl_fixed_from_double((bottom - top) * wnd_scale / scale);
+    src_w = max(1, min(src_w, wl_fixed_from_int(pm->width) - src_x));
+    src_h = max(1, min(src_h, wl_fixed_from_int(pm->height) - src_y));
+
+    wp_viewport_set_source(ctx.layer.viewport, src_x, src_y, src_w, src_h);
+    wp_viewport_set_destination(ctx.layer.viewport, right - left,
+                                bottom - top);
+    wl_subsurface_set_position(ctx.layer.subsurface, left, top);
+    if (!ctx.layer.shown && !uploaded) {
+        // attach previously uploaded image
+        wl_surface_attach(ctx.layer.surface,
+                          ctx.layer.shared
+                              ? ctx.layer.shared
+                              : ctx.layer.buffers[ctx.layer.current],
+                          0, 0);
+        wl_surface_damage_buffer(ctx.layer.surface, 0, 0, pm->width,
+                                 pm->height);
+    }
+    // subsurface is synchronized: changes are applied with the main surface
+    wl_surface_commit(ctx.layer.surface);
+
+    ctx.layer.shown = true;
+    ctx.layer.used = true;
+
+    return true;
+}
+
 void ui_set_title(const char* name)
 {
     char* title = NULL;
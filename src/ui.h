@@ -4,7 +4,7 @@
 
 #pragma once
 
-#include "pixmap.h"
+#include "pixmap_scale.h"
 
 /**
  * Create global UI context.
@@ -35,17 +35,86 @@ void ui_event_prepare(void);
  */
 void ui_event_done(void);
 
+/**
+ * Process pending Wayland events without blocking, used to keep the window
+ * responsive while the main loop is busy (e.g. on image loading).
+ * Input events are only queued, they will be handled by the main loop.
+ */
+void ui_event_pump(void);
+
+/**
+ * Mark window region as changed, it will be repainted on the next redraw.
+ * @param x,y,width,height changed region in window coordinates
+ */
+void ui_damage(ssize_t x, ssize_t y, size_t width, size_t height);
+
+/**
+ * Mark text overlay region as changed.
+ * @param x,y,width,height changed region in window coordinates
+ */
+void ui_damage_overlay(ssize_t x, ssize_t y, size_t width, size_t height);
+
+/**
+ * Mark the whole window and text overlay as changed.
+ */
+void ui_damage_all(void);
+
 /**
  * Begin window redraw procedure.
- * @return window pixmap
+ * @return false if window can't be redrawn now, redraw will be resumed later
  */
-struct pixmap* ui_draw_begin(void);
+bool ui_draw_begin(void);
+
+/**
+ * Get canvas to redraw the window.
+ * Only the damaged part of the window is repainted: returned canvas covers
+ * the window region starting at (x,y), all window coordinates must be shifted
+ * by (-x,-y) while drawing on it.
+ * @param x,y pointers to get position of the canvas on the window
+ * @return canvas pixmap or NULL if window content is not changed
+ */
+struct pixmap* ui_draw_window(ssize_t* x, ssize_t* y);
+
+/**
+ * Get canvas to redraw the text overlay, must be called after window redraw.
+ * The overlay is a separate transparent layer above the window, so the text
+ * can be changed without repainting the window; if compositor doesn't
+ * support it, this is the same canvas as returned by ui_draw_window.
+ * @param x,y pointers to get position of the canvas on the window
+ * @return canvas pixmap or NULL if overlay content is not changed
+ */
+struct pixmap* ui_draw_overlay(ssize_t* x, ssize_t* y);
 
 /**
  * Finish window redraw procedure.
  */
 void ui_draw_commit(void);
 
+/**
+ * Use GPU to draw the image layer if it is supported.
+ * @param enable flag to enable GPU rendering
+ */
+void ui_layer_use_gpu(bool enable);
+
+/**
+ * Show image on a separate layer between the window and the text overlay,
+ * the image is uploaded once and then scaled and cropped by compositor or
+ * by GPU renderer.
+ * Must be called on each window redraw before ui_draw_commit, the layer is
+ * hidden if it was not set while the window was redrawn.
+ * @param pm image pixmap
+ * @param fd shared memory file of the opaque pixmap data to display it without
+ *           copying, -1 to upload a copy of the pixmap
+ * @param alpha true if image has transparent pixels
+ * @param changed true if pixmap content was changed since the last call
+ * @param x,y image position on the window
+ * @param scale image scale factor
+ * @param aa scale filter, used only by GPU renderer
+ * @return true if image is displayed on the layer
+ */
+bool ui_layer_show(const struct pixmap* pm, int fd, bool alpha, bool changed,
+                   ssize_t x, ssize_t y, double scale, enum aa_mode aa);
+
 /**
  * Set window title.
  * @param name file name of the current image
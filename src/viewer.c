@@ -4,21 +4,30 @@
 
 #include "viewer.h"
 
+#include "animation.h"
 #include "application.h"
 #include "array.h"
 #include "buildcfg.h"
 #include "fetcher.h"
+#include "grayscale.h"
 #include "imagelist.h"
 #include "info.h"
+#include "loader.h"
+#include "perf.h"
 #include "pixmap_scale.h"
+#include "tiles.h"
+#include "tpool.h"
 #include "ui.h"
+#include "worker.h"
 
 #ifdef HAVE_LIBPNG
 #include "formats/png.h"
 #endif
 
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/timerfd.h>
 #include <unistd.h>
@@ -34,6 +43,24 @@
 #define MIN_SCALE 10    // pixels
 #define MAX_SCALE 100.0 // factor
 
+// Margin of the scaled image cache (part of the window size)
+#define CACHE_MARGIN 8
+
+// Time to switch back to full quality after last move/zoom (ms)
+#define INTERACTIVE_TIMEOUT 150
+
+// Delay before the next try to switch animation frame that isn't ready (ms)
+#define ANIMATION_RETRY 10
+
+// Extra pixels redrawn around the changed area of animation frame
+#define FRAME_DAMAGE_MARGIN 4
+
+// Number of extra pixels around the visible area used by scale filters
+#define GRAYSCALE_MARGIN 4
+
+// No frame is requested to scale ahead
+#define ANIM_NONE SIZE_MAX
+
 /** Scaling operations. */
 enum fixed_scale {
     scale_fit_optimal, ///< Fit to window, but not more than 100%
@@ -81,6 +108,56 @@ static const char* position_names[] = {
 };
 // clang-format on
 
+/** Cache of the scaled image area, used to redraw without scaling on pan. */
+struct view_cache {
+    struct pixmap pm;   ///< Cached part of the scaled image
+    struct pixmap back; ///< Back buffer used to move the cached area
+    ssize_t x, y;       ///< Position of the cached area on the scaled image
+    double scale;       ///< Scale of the cached image
+    size_t frame;       ///< Index of the cached frame
+    bool valid;         ///< Cache state
+};
+
+/** Next slideshow image scaled in advance to the window size. */
+struct view_next {
+    pthread_mutex_t lock;      ///< Request and result lock
+    struct pixmap pm;          ///< Visible area of the scaled image
+    const struct image* image; ///< Pre-rendered image, owner of the job
+    size_t generation;         ///< Generation of the image, 0 if no request
+    size_t index;              ///< Index of the image in the image list
+    struct image_frame frame;  ///< Frame to scale
+    bool alpha;                ///< Frame has alpha channel
+    enum pixmap_orient orient; ///< Orientation applied on scaling
+    ssize_t x, y;              ///< Position of the image on the window
+    ssize_t vx, vy;            ///< Position of visible area on the image
+    size_t vw, vh;             ///< Size of visible area
+    double scale;              ///< Scale of the image
+    size_t width, height;      ///< Window size
+    enum aa_mode aa_mode;      ///< Anti-aliasing mode
+    bool valid;                ///< Pre-render state
+};
+
+/** Scaled frames of the animation, loops after the first one are blits. */
+struct view_anim {
+    struct pixmap* frames;     ///< Visible area of each scaled frame
+    size_t num;                ///< Number of frames
+    const struct image* image; ///< Animated image
+    size_t index;              ///< Index of the animated image
+    size_t generation;         ///< Generation of the animated image
+    ssize_t x, y;              ///< Position of the area on the scaled image
+    size_t width, height;      ///< Size of the area
+    double scale;              ///< Scale of the frames
+    enum aa_mode aa_mode;      ///< Anti-aliasing mode
+    size_t limit;              ///< Max size of all frames in bytes
+
+    pthread_t tid;         ///< Thread that scales the next frame ahead
+    pthread_mutex_t lock;  ///< Frames access lock
+    pthread_cond_t signal; ///< Request/completion notification
+    size_t request;        ///< Index of the frame to scale ahead
+    bool busy;             ///< Frame is being scaled ahead
+    bool stop;             ///< Thread stop flag
+};
+
 /** Viewer context. */
 struct viewer {
     ssize_t img_x, img_y; ///< Top left corner of the image
@@ -90,7 +167,11 @@ struct viewer {
     argb_t image_bkg;     ///< Image background mode/color
     argb_t window_bkg;    ///< Window background mode/color
     enum aa_mode aa_mode; ///< Anti-aliasing mode
+    enum aa_mode aa_fast; ///< Anti-aliasing mode used while moving/zooming
     bool fixed;           ///< Fix image position
+    size_t mipmap;        ///< Max size of mipmaps in bytes (0=disabled)
+    bool layer;           ///< Let compositor scale the image
+    bool layer_changed;   ///< Image content changed since last upload
 
     enum fixed_scale scale_init; ///< Initial scale
     bool keep_zoom;              ///< Keep absolute zoom across images
@@ -103,24 +184,249 @@ struct viewer {
     bool slideshow_enable; ///< Slideshow enable/disable
     int slideshow_fd;      ///< Slideshow timer
     size_t slideshow_time; ///< Slideshow image display time (seconds)
+
+    bool interactive; ///< Image is being moved or zoomed
+    bool degraded;    ///< Image was drawn with fast anti-aliasing mode
+    int interactive_fd; ///< Timer to leave interactive mode
+
+    struct view_cache cache; ///< Scaled image cache
+    struct view_next next;   ///< Pre-rendered next slideshow image
+    struct view_anim anim;   ///< Scaled animation frames
 };
 
 /** Global viewer context. */
 static struct viewer ctx;
 
 /**
- * Fix up image position.
+ * Drop scaled image cache, must be called when the image content is changed.
+ */
+static inline void reset_cache(void)
+{
+    ctx.cache.valid = false;
+    ctx.layer_changed = true;
+}
+
+/**
+ * Drop pre-rendered next slideshow image.
+ */
+static void reset_next(void)
+{
+    // the job in progress drops its result
+    pthread_mutex_lock(&ctx.next.lock);
+    ctx.next.generation = 0;
+    ctx.next.valid = false;
+    pixmap_free(&ctx.next.pm);
+    memset(&ctx.next.pm, 0, sizeof(ctx.next.pm));
+    pthread_mutex_unlock(&ctx.next.lock);
+}
+
+/**
+ * Drop scaled animation frames, must be called before the current image is
+ * changed: waits for the frame that is being scaled ahead.
+ */
+static void reset_anim(void)
+{
+    struct view_anim* anim = &ctx.anim;
+
+    pthread_mutex_lock(&anim->lock);
+    anim->request = ANIM_NONE;
+    while (anim->busy) {
+        pthread_cond_wait(&anim->signal, &anim->lock);
+    }
+    for (size_t i = 0; i < anim->num; ++i) {
+        pixmap_free(&anim->frames[i]);
+    }
+    free(anim->frames);
+    anim->frames = NULL;
+    anim->num = 0;
+    anim->image = NULL;
+    pthread_mutex_unlock(&anim->lock);
+}
+
+/**
+ * Scale animation frame to the cached area.
+ * @param frame source frame
+ * @param pm destination pixmap to create
+ * @return false on errors
+ */
+static bool anim_scale(const struct image_frame* frame, struct pixmap* pm)
+{
+    const struct view_anim* anim = &ctx.anim;
+
+    if (!pixmap_create(pm, anim->width, anim->height)) {
+        return false;
+    }
+    pixmap_scale_mipmap(anim->aa_mode, &frame->pm, frame->mipmap,
+                        frame->mipmap_levels, pm, -anim->x, -anim->y,
+                        anim->scale, anim->image->alpha, anim->image->orient);
+
+    return true;
+}
+
+/**
+ * Thread that scales the next animation frame ahead of the timer.
+ */
+static void* anim_thread(__attribute__((unused)) void* data)
+{
+    struct view_anim* anim = &ctx.anim;
+
+    // scale frames in this thread only, the pool is used by the main thread
+    tpool_set_serial(true);
+
+    pthread_mutex_lock(&anim->lock);
+    while (!anim->stop) {
+        struct pixmap pm;
+        size_t index;
+
+        if (anim->request == ANIM_NONE) {
+            pthread_cond_wait(&anim->signal, &anim->lock);
+            continue;
+        }
+        index = anim->request;
+        anim->request = ANIM_NONE;
+        anim->busy = true;
+        pthread_mutex_unlock(&anim->lock);
+
+        // the image and cache parameters are not changed while busy
+        if (!anim_scale(&anim->image->frames[index], &pm)) {
+            pm.data = NULL;
+        }
+
+        pthread_mutex_lock(&anim->lock);
+        if (anim->frames[index].data) {
+            pixmap_free(&pm); // already scaled by the main thread
+        } else if (pm.data) {
+            anim->frames[index] = pm;
+        }
+        anim->busy = false;
+        pthread_cond_broadcast(&anim->signal);
+    }
+    pthread_mutex_unlock(&anim->lock);
+
+    return NULL;
+}
+
+/**
+ * Put pre-rendered image to the scaled image cache if it matches the
+ * current state, so the first frame of the slide is drawn without scaling.
+ * @param img current image
+ */
+static void install_next(const struct image* img)
+{
+    struct view_next* next = &ctx.next;
+    struct pixmap tmp;
+
+    // the image can be reloaded at the same address, check the instance
+    pthread_mutex_lock(&next->lock);
+    if (next->valid && next->generation == img->generation &&
+        next->index == img->index && next->scale == ctx.scale &&
+        next->x == ctx.img_x &&
+        next->y == ctx.img_y && next->width == ui_get_width() &&
+        next->height == ui_get_height() && next->aa_mode == ctx.aa_mode) {
+        tmp = ctx.cache.pm;
+        ctx.cache.pm = next->pm;
+        next->pm = tmp;
+        ctx.cache.x = max(0, -ctx.img_x);
+        ctx.cache.y = max(0, -ctx.img_y);
+        ctx.cache.scale = ctx.scale;
+        ctx.cache.frame = 0;
+        ctx.cache.valid = true;
+    }
+
+    // not finished in time: the slide is scaled on drawing
+    next->generation = 0;
+    next->valid = false;
+    pthread_mutex_unlock(&next->lock);
+}
+
+/**
+ * Request redraw of the image area only.
+ */
+static void redraw_image(void)
+{
+    const struct image* img = fetcher_current();
+    const size_t width = ctx.scale * image_get_width(img);
+    const size_t height = ctx.scale * image_get_height(img);
+    app_redraw_area(ctx.img_x, ctx.img_y, width, height);
+}
+
+/**
+ * Request redraw of the area changed by the current animation frame.
+ * @param img image with the new frame displayed
+ * @param frame current image frame
+ */
+static void redraw_frame(const struct image* img,
+                         const struct image_frame* frame)
+{
+    struct pixmap_area area = frame->changed;
+    size_t width = frame->pm.width;
+    size_t height = frame->pm.height;
+    double margin;
+    ssize_t x0, y0, x1, y1;
+
+    if (!frame->partial || ctx.layer) {
+        redraw_image();
+        return;
+    }
+    if (area.width == 0) {
+        return; // frame is the same as the previous one
+    }
+
+    // transform the area to the displayed orientation
+    if (img->orient & orient_transpose) {
+        const struct pixmap_area tr = area;
+        area.x = tr.y;
+        area.y = tr.x;
+        area.width = tr.height;
+        area.height = tr.width;
+        width = frame->pm.height;
+        height = frame->pm.width;
+    }
+    if (img->orient & orient_flip_x) {
+        area.x = width - area.x - area.width;
+    }
+    if (img->orient & orient_flip_y) {
+        area.y = height - area.y - area.height;
+    }
+
+    // scaling filters blend neighboring pixels with the changed ones
+    margin = FRAME_DAMAGE_MARGIN * max(1.0, ctx.scale);
+    x0 = floor(area.x * ctx.scale - margin);
+    y0 = floor(area.y * ctx.scale - margin);
+    x1 = ceil((area.x + area.width) * ctx.scale + margin);
+    y1 = ceil((area.y + area.height) * ctx.scale + margin);
+
+    app_redraw_area(ctx.img_x + x0, ctx.img_y + y0, x1 - x0, y1 - y0);
+}
+
+/**
+ * Enter interactive mode or prolong it: use fast anti-aliasing while the
+ * image is moved or zoomed, full quality redraw is scheduled on idle.
+ * Scalable images are rendered at the final scale on idle too.
+ */
+static void interactive_start(void)
+{
+    if ((ctx.aa_fast < ctx.aa_mode || fetcher_current()->vector.render) &&
+        ctx.interactive_fd != -1) {
+        const struct itimerspec ts = {
+            .it_value.tv_sec = INTERACTIVE_TIMEOUT / 1000,
+            .it_value.tv_nsec = (INTERACTIVE_TIMEOUT % 1000) * 1000000,
+        };
+        ctx.interactive = true;
+        timerfd_settime(ctx.interactive_fd, 0, &ts, NULL);
+    }
+}
+
+/**
+ * Fix up position of the image with specified size.
+ * @param img_width,img_height size of the scaled image
  * @param force flag to force update position
  */
-static void fixup_position(bool force)
+static void place_image(ssize_t img_width, ssize_t img_height, bool force)
 {
     const ssize_t wnd_width = ui_get_width();
     const ssize_t wnd_height = ui_get_height();
 
-    const struct pixmap* pm = &fetcher_current()->frames[ctx.frame].pm;
-    const ssize_t img_width = ctx.scale * pm->width;
-    const ssize_t img_height = ctx.scale * pm->height;
-
     if (force || (ctx.fixed && img_width <= wnd_width)) {
         switch (ctx.position) {
             case position_top:
@@ -215,6 +521,17 @@ static void fixup_position(bool force)
     }
 }
 
+/**
+ * Fix up image position.
+ * @param force flag to force update position
+ */
+static void fixup_position(bool force)
+{
+    const struct image* img = fetcher_current();
+    place_image(ctx.scale * image_get_width(img),
+                ctx.scale * image_get_height(img), force);
+}
+
 /**
  * Move image (viewport).
  * @param horizontal axis along which to move (false for vertical)
@@ -240,6 +557,8 @@ static void move_image(bool horizontal, bool positive, const char* params)
         step = -step;
     }
 
+    interactive_start();
+
     if (horizontal) {
         ctx.img_x += (ui_get_width() / 100) * step;
     } else {
@@ -260,11 +579,12 @@ static void move_image(bool horizontal, bool positive, const char* params)
 static void rotate_image(bool clockwise)
 {
     struct image* img = fetcher_current();
-    const struct pixmap* pm = &img->frames[ctx.frame].pm;
-    const ssize_t diff = (ssize_t)pm->width - pm->height;
+    const ssize_t diff =
+        (ssize_t)image_get_width(img) - (ssize_t)image_get_height(img);
     const ssize_t shift = (ctx.scale * diff) / 2;
 
     image_rotate(img, clockwise ? 90 : 270);
+    reset_cache();
     ctx.img_x += shift;
     ctx.img_y -= shift;
     fixup_position(false);
@@ -273,42 +593,57 @@ static void rotate_image(bool clockwise)
 }
 
 /**
- * Set fixed scale for the image.
- * @param sc scale to set
+ * Get fixed scale factor for the image of specified size.
+ * @param sc fixed scale type
+ * @param width,height image size
+ * @return scale factor
  */
-static void set_scale(enum fixed_scale sc)
+static double get_fixed_scale(enum fixed_scale sc, size_t width, size_t height)
 {
-    const struct image* img = fetcher_current();
-    const struct pixmap* pm = &img->frames[ctx.frame].pm;
     const size_t wnd_width = ui_get_width();
     const size_t wnd_height = ui_get_height();
-    const float scale_w = 1.0 / ((float)pm->width / wnd_width);
-    const float scale_h = 1.0 / ((float)pm->height / wnd_height);
+    const float scale_w = 1.0 / ((float)width / wnd_width);
+    const float scale_h = 1.0 / ((float)height / wnd_height);
+    double scale = 1.0;
 
     switch (sc) {
         case scale_fit_optimal:
-            ctx.scale = min(scale_w, scale_h);
-            if (ctx.scale > 1.0) {
-                ctx.scale = 1.0;
+            scale = min(scale_w, scale_h);
+            if (scale > 1.0) {
+                scale = 1.0;
             }
             break;
         case scale_fit_window:
-            ctx.scale = min(scale_w, scale_h);
+            scale = min(scale_w, scale_h);
             break;
         case scale_fit_width:
-            ctx.scale = scale_w;
+            scale = scale_w;
             break;
         case scale_fit_height:
-            ctx.scale = scale_h;
+            scale = scale_h;
             break;
         case scale_fill_window:
-            ctx.scale = max(scale_w, scale_h);
+            scale = max(scale_w, scale_h);
             break;
         case scale_real_size:
-            ctx.scale = 1.0; // 100 %
+            scale = 1.0; // 100 %
             break;
     }
 
+    return scale;
+}
+
+/**
+ * Set fixed scale for the image.
+ * @param sc scale to set
+ */
+static void set_scale(enum fixed_scale sc)
+{
+    const struct image* img = fetcher_current();
+
+    ctx.scale =
+        get_fixed_scale(sc, image_get_width(img), image_get_height(img));
+
     fixup_position(true);
     info_update(info_scale, "%.0f%%", ctx.scale * 100);
 }
@@ -360,6 +695,7 @@ static void zoom_image(const char* params)
         set_scale(fixed_scale);
     } else if (str_to_num(params, 0, &percent, 0) && percent != 0 &&
                percent > -1000 && percent < 1000) {
+        interactive_start();
         // zoom in %
         const double wnd_half_w = (double)ui_get_width() / 2;
         const double wnd_half_h = (double)ui_get_height() / 2;
@@ -374,9 +710,8 @@ static void zoom_image(const char* params)
             }
         } else {
             const struct image* img = fetcher_current();
-            const struct pixmap* pm = &img->frames[ctx.frame].pm;
-            const float scale_w = (float)MIN_SCALE / pm->width;
-            const float scale_h = (float)MIN_SCALE / pm->height;
+            const float scale_w = (float)MIN_SCALE / image_get_width(img);
+            const float scale_h = (float)MIN_SCALE / image_get_height(img);
             const float scale_min = max(scale_w, scale_h);
             ctx.scale += step;
             if (ctx.scale < scale_min) {
@@ -396,6 +731,39 @@ static void zoom_image(const char* params)
     app_redraw();
 }
 
+/**
+ * Change window/level of grayscale image.
+ * @param params deltas for the window center and width, empty to reset
+ */
+static void window_level(const char* params)
+{
+    struct image* img = fetcher_current();
+    struct str_slice slices[2];
+    ssize_t center, width;
+
+    if (!img->gray) {
+        info_update(info_status, "Window/level is not supported");
+        app_redraw();
+        return;
+    }
+
+    if (!params || !*params) {
+        grayscale_reset(img);
+    } else if (str_split(params, ' ', slices, ARRAY_SIZE(slices)) == 2 &&
+               str_to_num(slices[0].value, slices[0].len, &center, 0) &&
+               str_to_num(slices[1].value, slices[1].len, &width, 0)) {
+        grayscale_adjust(img, center, width);
+    } else {
+        fprintf(stderr, "Invalid window/level: \"%s\"\n", params);
+        return;
+    }
+
+    grayscale_window(img, &center, &width);
+    info_update(info_status, "Window center %zd, width %zd", center, width);
+    reset_cache();
+    app_redraw();
+}
+
 /**
  * Toggle zoom keeping mode.
  */
@@ -403,7 +771,6 @@ static void toggle_keep_zoom(void)
 {
     ctx.keep_zoom = !ctx.keep_zoom;
     info_update(info_status, "Keep zoom %s", ctx.keep_zoom ? "ON" : "OFF");
-    app_redraw();
 }
 
 /**
@@ -417,13 +784,18 @@ static void animation_ctl(bool enable)
     if (enable) {
         const struct image* img = fetcher_current();
         const size_t duration = img->frames[ctx.frame].duration;
-        enable = (img->num_frames > 1 && duration);
+        enable = ((img->num_frames > 1 || img->anim) && duration);
         if (enable) {
             ts.it_value.tv_sec = duration / 1000;
             ts.it_value.tv_nsec = (duration % 1000) * 1000000;
         }
     }
 
+    if (!enable) {
+        // the frame that is being scaled ahead refers to the image frames
+        reset_anim();
+    }
+
     ctx.animation_enable = enable;
     timerfd_settime(ctx.animation_fd, 0, &ts, NULL);
 }
@@ -439,49 +811,91 @@ static void slideshow_ctl(bool enable)
     ctx.slideshow_enable = enable;
     if (enable) {
         ts.it_value.tv_sec = ctx.slideshow_time;
+    } else {
+        reset_next();
     }
 
     timerfd_settime(ctx.slideshow_fd, 0, &ts, NULL);
 }
 
+/**
+ * Reset info text for the current image.
+ */
+static void reset_info(void)
+{
+    struct image* img = fetcher_current();
+    const size_t total_img = image_list_size();
+
+    if (info_enabled()) {
+        // meta info is parsed only if it can be displayed
+        loader_load_meta(img);
+    }
+
+    info_reset(img);
+    info_update(info_scale, "%.0f%%", ctx.scale * 100);
+    if (total_img) {
+        info_update(info_index, "%zu of %zu", img->index + 1, total_img);
+    }
+}
+
 /**
  * Reset state to defaults.
  */
 static void reset_state(void)
 {
     const struct image* img = fetcher_current();
-    const size_t total_img = image_list_size();
 
     ctx.frame = 0;
+    reset_cache();
 
     if (!ctx.keep_zoom || ctx.scale == 0) {
         set_scale(ctx.scale_init);
     } else {
-        const ssize_t diff_w = ctx.img_w - img->frames[0].pm.width;
-        const ssize_t diff_h = ctx.img_h - img->frames[0].pm.height;
+        const ssize_t diff_w = ctx.img_w - image_get_width(img);
+        const ssize_t diff_h = ctx.img_h - image_get_height(img);
         ctx.img_x += floor(ctx.scale * diff_w) / 2.0;
         ctx.img_y += floor(ctx.scale * diff_h) / 2.0;
         fixup_position(true);
     }
 
-    ctx.img_w = img->frames[0].pm.width;
-    ctx.img_h = img->frames[0].pm.height;
+    ctx.img_w = image_get_width(img);
+    ctx.img_h = image_get_height(img);
+    install_next(img);
 
     ui_set_title(img->name);
     animation_ctl(true);
     slideshow_ctl(ctx.slideshow_enable);
 
-    info_reset(img);
-    info_update(info_scale, "%.0f%%", ctx.scale * 100);
-    if (total_img) {
-        info_update(info_index, "%zu of %zu", img->index + 1, total_img);
-    }
+    reset_info();
 
     ui_set_content_type_animated(ctx.animation_enable);
 
     app_redraw();
 }
 
+/**
+ * Replace preview of the current image with the full quality one: the
+ * displayed size and position of the image are preserved.
+ */
+static void update_image(void)
+{
+    const struct image* img = fetcher_current();
+    const size_t width = image_get_width(img);
+
+    if (width && ctx.img_w) {
+        ctx.scale = ctx.scale * ctx.img_w / width;
+    }
+    ctx.img_w = width;
+    ctx.img_h = image_get_height(img);
+    ctx.frame = 0;
+    reset_cache();
+    fixup_position(false);
+
+    reset_info();
+
+    app_redraw();
+}
+
 /**
  * Skip current image.
  * @return true if next image was loaded
@@ -491,6 +905,8 @@ static bool skip_image(void)
     size_t index;
     const size_t current = fetcher_current()->index;
 
+    reset_anim();
+
     index = image_list_skip(current);
     while (index != IMGLIST_INVALID && !fetcher_open(index)) {
         index = image_list_skip(index);
@@ -508,6 +924,8 @@ static bool next_image(enum action_type direction)
 {
     size_t index = fetcher_current()->index;
 
+    reset_anim();
+
     do {
         switch (direction) {
             case action_first_file:
@@ -533,7 +951,7 @@ static bool next_image(enum action_type direction)
                 index = image_list_next_file(index);
                 break;
             case action_rand_file:
-                index = image_list_rand_file(index);
+                index = fetcher_rand_file();
                 break;
             default:
                 break;
@@ -552,28 +970,58 @@ static bool next_image(enum action_type direction)
 /**
  * Switch to the next or previous frame.
  * @param forward switch direction
+ * @return true if frame was switched
  */
-static void next_frame(bool forward)
+static bool next_frame(bool forward)
 {
+    struct image* img = fetcher_current();
     size_t index = ctx.frame;
-    const struct image* img = fetcher_current();
-
-    if (forward) {
-        if (++index >= img->num_frames) {
-            index = 0;
+    size_t total = img->num_frames;
+
+    if (img->anim) {
+        // frames are decoded on demand one by one into the same image frame
+        total = animation_frames(img);
+        if (forward) {
+            if (!animation_next(img)) {
+                return false;
+            }
+        } else {
+            index = animation_index(img);
+            index = (index == 0 ? total : index) - 1;
+            if (!animation_seek(img, index)) {
+                return false;
+            }
         }
+        index = animation_index(img);
+        reset_cache();
     } else {
-        if (index-- == 0) {
-            index = img->num_frames - 1;
+        if (forward) {
+            if (++index >= img->num_frames) {
+                index = 0;
+            }
+        } else {
+            if (index-- == 0) {
+                index = img->num_frames - 1;
+            }
+        }
+        if (index == ctx.frame) {
+            return false;
         }
-    }
-    if (index != ctx.frame) {
         ctx.frame = index;
-        info_update(info_frame, "%zu of %zu", ctx.frame + 1, img->num_frames);
-        info_update(info_image_size, "%zux%zu", img->frames[ctx.frame].pm.width,
-                    img->frames[ctx.frame].pm.height);
-        app_redraw();
     }
+
+    info_update(info_frame, "%zu of %zu", index + 1, total);
+    info_update(info_image_size, "%zux%zu", image_get_width(img),
+                image_get_height(img));
+    if (forward) {
+        redraw_frame(img, &img->frames[ctx.frame]);
+    } else {
+        // changed area of the frame is relative to the previous frame, not
+        // to the one that has been displayed
+        redraw_image();
+    }
+
+    return true;
 }
 
 /**
@@ -581,8 +1029,32 @@ static void next_frame(bool forward)
  */
 static void on_animation_timer(__attribute__((unused)) void* data)
 {
-    next_frame(true);
-    animation_ctl(true);
+    if (next_frame(true) || !fetcher_current()->anim) {
+        animation_ctl(true);
+    } else {
+        // next frame is not decoded yet
+        const struct itimerspec ts = {
+            .it_value.tv_nsec = ANIMATION_RETRY * 1000000,
+        };
+        timerfd_settime(ctx.animation_fd, 0, &ts, NULL);
+    }
+}
+
+/**
+ * Interactive mode timer event handler.
+ */
+static void on_interactive_timer(__attribute__((unused)) void* data)
+{
+    const struct itimerspec ts = { 0 };
+    timerfd_settime(ctx.interactive_fd, 0, &ts, NULL);
+
+    ctx.interactive = false;
+    if (ctx.degraded) {
+        // redraw with full quality
+        ctx.degraded = false;
+        reset_cache();
+        redraw_image();
+    }
 }
 
 /**
@@ -594,37 +1066,364 @@ static void on_slideshow_timer(__attribute__((unused)) void* data)
 }
 
 /**
- * Draw image.
- * @param wnd pixel map of target window
+ * Apply window/level of grayscale image to the frame area that is visible
+ * on the destination pixmap.
+ * @param img grayscale image
+ * @param dst destination pixmap
+ * @param x,y image position on the destination pixmap
+ */
+static void update_grayscale(struct image* img, const struct pixmap* dst,
+                             ssize_t x, ssize_t y)
+{
+    const struct pixmap* pm = &img->frames[0].pm;
+    // scale filters read pixels around the visible area
+    const ssize_t margin = GRAYSCALE_MARGIN + GRAYSCALE_MARGIN / ctx.scale;
+    ssize_t x0 = 0, y0 = 0;
+    ssize_t x1 = pm->width, y1 = pm->height;
+
+    if (img->orient == orient_normal) {
+        x0 = max(x0, (ssize_t)(-x / ctx.scale) - margin);
+        y0 = max(y0, (ssize_t)(-y / ctx.scale) - margin);
+        x1 = min(x1, (ssize_t)((dst->width - x) / ctx.scale) + margin);
+        y1 = min(y1, (ssize_t)((dst->height - y) / ctx.scale) + margin);
+    }
+
+    if (x0 < x1 && y0 < y1) {
+        grayscale_update(img, x0, y0, x1 - x0, y1 - y0);
+    }
+}
+
+/**
+ * Draw scaled image.
+ * @param dst destination pixmap
+ * @param x,y image position on the destination pixmap
+ */
+static void draw_scaled(struct pixmap* dst, ssize_t x, ssize_t y)
+{
+    struct image* img = fetcher_current();
+    const struct image_frame* frame = &img->frames[ctx.frame];
+    const uint64_t start = perf_now();
+    enum aa_mode aa = ctx.aa_mode;
+
+    if (ctx.mipmap && ctx.scale <= 0.5 && !frame->mipmap && !img->anim &&
+        !img->gray && image_build_mipmap(img, ctx.mipmap)) {
+        // mipmaps are created in background, the base level is drawn until
+        // they are ready, frames scaled ahead use the mipmaps to be attached
+        reset_anim();
+        image_attach_mipmap(img);
+    }
+
+    if (ctx.interactive) {
+        aa = ctx.aa_fast;
+        ctx.degraded = true;
+    } else if (img->orient == orient_normal &&
+               image_render(img, dst, x, y, ctx.scale)) {
+        return; // scalable image rendered at the current scale
+    }
+
+    if (img->gray) {
+        update_grayscale(img, dst, x, y);
+    }
+
+    if (img->tiles) {
+        // huge image: draw visible tiles at the current scale
+        tiles_draw(img, aa, dst, x, y, ctx.scale);
+    } else {
+        pixmap_scale_mipmap(aa, &frame->pm, frame->mipmap,
+                            frame->mipmap_levels, dst, x, y, ctx.scale,
+                            img->alpha, img->orient);
+    }
+
+    perf_scale(aa, start);
+}
+
+/**
+ * Draw area of the scaled image to the cache.
+ * @param cache destination pixmap
+ * @param cx,cy position of the cache on the scaled image
+ * @param x,y,width,height area of the scaled image to draw
+ */
+static void cache_draw(struct pixmap* cache, ssize_t cx, ssize_t cy, ssize_t x,
+                       ssize_t y, size_t width, size_t height)
+{
+    if (width == 0 || height == 0) {
+        return;
+    }
+
+    if (width == cache->width) {
+        // full rows are drawn directly to the cache
+        struct pixmap rows = {
+            .width = width,
+            .height = height,
+            .data = &cache->data[(y - cy) * cache->width],
+        };
+        memset(rows.data, 0, width * height * sizeof(argb_t));
+        draw_scaled(&rows, -x, -y);
+    } else {
+        struct pixmap area;
+        if (pixmap_create(&area, width, height)) {
+            draw_scaled(&area, -x, -y);
+            pixmap_copy(&area, cache, x - cx, y - cy, false);
+            pixmap_free(&area);
+        }
+    }
+}
+
+/**
+ * Update cache of the scaled image to cover the visible area.
+ * @param width,height size of the scaled image
+ * @return true if cache is ready
+ */
+static bool cache_update(size_t width, size_t height)
+{
+    struct view_cache* cache = &ctx.cache;
+    const ssize_t wnd_width = ui_get_width();
+    const ssize_t wnd_height = ui_get_height();
+
+    // visible area of the scaled image
+    const ssize_t vx = max(0, -ctx.img_x);
+    const ssize_t vy = max(0, -ctx.img_y);
+    const ssize_t vw = min((ssize_t)width, wnd_width - ctx.img_x) - vx;
+    const ssize_t vh = min((ssize_t)height, wnd_height - ctx.img_y) - vy;
+
+    if (vw <= 0 || vh <= 0) {
+        return false;
+    }
+
+    if (cache->valid &&
+        (cache->scale != ctx.scale || cache->frame != ctx.frame)) {
+        cache->valid = false;
+    }
+
+    if (cache->valid) {
+        ssize_t x, y, w, h;
+        ssize_t ix0, iy0, ix1, iy1;
+
+        if (vx >= cache->x && vy >= cache->y &&
+            vx + vw <= cache->x + (ssize_t)cache->pm.width &&
+            vy + vh <= cache->y + (ssize_t)cache->pm.height) {
+            return true; // visible area is already in cache
+        }
+
+        // move cached area to the new position, add margins to avoid
+        // redrawing on each step while panning
+        x = max(0, vx - wnd_width / CACHE_MARGIN);
+        y = max(0, vy - wnd_height / CACHE_MARGIN);
+        w = min((ssize_t)width, vx + vw + wnd_width / CACHE_MARGIN) - x;
+        h = min((ssize_t)height, vy + vh + wnd_height / CACHE_MARGIN) - y;
+
+        // intersection with currently cached area
+        ix0 = max(x, cache->x);
+        iy0 = max(y, cache->y);
+        ix1 = min(x + w, cache->x + (ssize_t)cache->pm.width);
+        iy1 = min(y + h, cache->y + (ssize_t)cache->pm.height);
+
+        if (ix0 < ix1 && iy0 < iy1) {
+            struct pixmap tmp;
+
+            if (cache->back.width != (size_t)w ||
+                cache->back.height != (size_t)h) {
+                pixmap_free(&cache->back);
+                if (!pixmap_create(&cache->back, w, h)) {
+                    cache->back.data = NULL;
+                    cache->back.width = 0;
+                    cache->back.height = 0;
+                    return false;
+                }
+            }
+
+            // reuse already scaled part and draw the rest
+            pixmap_copy(&cache->pm, &cache->back, cache->x - x, cache->y - y,
+                        false);
+            cache_draw(&cache->back, x, y, x, y, w, iy0 - y);
+            cache_draw(&cache->back, x, y, x, iy1, w, y + h - iy1);
+            cache_draw(&cache->back, x, y, x, iy0, ix0 - x, iy1 - iy0);
+            cache_draw(&cache->back, x, y, ix1, iy0, x + w - ix1, iy1 - iy0);
+
+            tmp = cache->pm;
+            cache->pm = cache->back;
+            cache->back = tmp;
+            cache->x = x;
+            cache->y = y;
+
+            return true;
+        }
+    }
+
+    // draw visible area only, margins are added on the first move
+    if (cache->pm.width != (size_t)vw || cache->pm.height != (size_t)vh) {
+        pixmap_free(&cache->pm);
+        if (!pixmap_create(&cache->pm, vw, vh)) {
+            cache->pm.data = NULL;
+            cache->pm.width = 0;
+            cache->pm.height = 0;
+            cache->valid = false;
+            return false;
+        }
+    }
+    cache->x = vx;
+    cache->y = vy;
+    cache->scale = ctx.scale;
+    cache->frame = ctx.frame;
+    cache->valid = true;
+    cache_draw(&cache->pm, vx, vy, vx, vy, vw, vh);
+
+    return true;
+}
+
+/**
+ * Draw animation frame through the cache of scaled frames: each frame is
+ * scaled once, the next one is scaled ahead in background.
+ * @param wnd destination canvas
+ * @param x,y position of the image on the canvas
+ * @param width,height size of the scaled image
+ * @return false if the cache can't be used
  */
-static void draw_image(struct pixmap* wnd)
+static bool draw_anim(struct pixmap* wnd, ssize_t x, ssize_t y, size_t width,
+                      size_t height)
 {
+    struct view_anim* anim = &ctx.anim;
     const struct image* img = fetcher_current();
-    const struct pixmap* img_pm = &img->frames[ctx.frame].pm;
-    const size_t width = ctx.scale * img_pm->width;
-    const size_t height = ctx.scale * img_pm->height;
+    const size_t num = img->anim ? animation_frames(img) : img->num_frames;
+    const size_t index = img->anim ? animation_index(img) : ctx.frame;
+    const ssize_t wnd_width = ui_get_width();
+    const ssize_t wnd_height = ui_get_height();
+    struct pixmap pm;
+
+    // visible area of the scaled image
+    const ssize_t vx = max(0, -ctx.img_x);
+    const ssize_t vy = max(0, -ctx.img_y);
+    const ssize_t vw = min((ssize_t)width, wnd_width - ctx.img_x) - vx;
+    const ssize_t vh = min((ssize_t)height, wnd_height - ctx.img_y) - vy;
+
+    if (num < 2 || index >= num || ctx.interactive || img->tiles ||
+        img->gray || img->vector.render || vw <= 0 || vh <= 0 ||
+        (size_t)vw * vh * sizeof(argb_t) * num > anim->limit) {
+        reset_anim();
+        return false;
+    }
+
+    if (!anim->image || anim->index != img->index ||
+        anim->generation != img->generation || anim->num != num ||
+        anim->scale != ctx.scale ||
+        anim->aa_mode != ctx.aa_mode || anim->x != vx || anim->y != vy ||
+        anim->width != (size_t)vw || anim->height != (size_t)vh) {
+        struct pixmap* frames;
+        reset_anim();
+        frames = calloc(num, sizeof(*frames));
+        if (!frames) {
+            return false;
+        }
+        pthread_mutex_lock(&anim->lock);
+        anim->frames = frames;
+        anim->num = num;
+        anim->image = img;
+        anim->index = img->index;
+        anim->generation = img->generation;
+        anim->x = vx;
+        anim->y = vy;
+        anim->width = vw;
+        anim->height = vh;
+        anim->scale = ctx.scale;
+        anim->aa_mode = ctx.aa_mode;
+        pthread_mutex_unlock(&anim->lock);
+    }
+
+    pthread_mutex_lock(&anim->lock);
+    pm = anim->frames[index];
+    pthread_mutex_unlock(&anim->lock);
+
+    if (!pm.data) {
+        // first loop: frame is not scaled yet, frames decoded on demand are
+        // available only in the image buffer
+        if (!anim_scale(&img->frames[img->anim ? 0 : index], &pm)) {
+            return false;
+        }
+        pthread_mutex_lock(&anim->lock);
+        if (anim->frames[index].data) {
+            pixmap_free(&pm);
+            pm = anim->frames[index];
+        } else {
+            anim->frames[index] = pm;
+        }
+        pthread_mutex_unlock(&anim->lock);
+    }
+
+    pixmap_copy(&pm, wnd, x + vx, y + vy, img->alpha);
+
+    if (!img->anim && anim->tid) {
+        // scale the next frame ahead of the timer
+        const size_t next = (index + 1) % num;
+        pthread_mutex_lock(&anim->lock);
+        if (!anim->frames[next].data) {
+            anim->request = next;
+            pthread_cond_broadcast(&anim->signal);
+        }
+        pthread_mutex_unlock(&anim->lock);
+    }
+
+    return true;
+}
+
+/**
+ * Draw image.
+ * @param wnd destination canvas
+ * @param x,y position of the canvas on the window
+ */
+static void draw_image(struct pixmap* wnd, ssize_t x, ssize_t y)
+{
+    struct image* img = fetcher_current();
+    const struct image_frame* frame = &img->frames[ctx.frame];
+    const struct pixmap* img_pm = &frame->pm;
+    const int shm_fd = frame->shm_size ? frame->shm_fd : -1;
+    const size_t width = ctx.scale * image_get_width(img);
+    const size_t height = ctx.scale * image_get_height(img);
+    const ssize_t img_x = ctx.img_x - x;
+    const ssize_t img_y = ctx.img_y - y;
+    bool layer = false;
+
+    // try to pass the image to compositor, opaque image decoded into shared
+    // memory is displayed in real size without copying
+    if (img->orient == orient_normal && !img->tiles && !img->vector.render &&
+        !img->gray &&
+        (ctx.layer || (shm_fd != -1 && !img->alpha && ctx.scale == 1.0))) {
+        layer = ui_layer_show(img_pm, shm_fd, img->alpha, ctx.layer_changed,
+                              ctx.img_x, ctx.img_y, ctx.scale, ctx.aa_mode);
+        if (layer) {
+            ctx.layer_changed = false;
+        }
+    }
 
     // clear window background
-    pixmap_inverse_fill(wnd, ctx.img_x, ctx.img_y, width, height,
-                        ctx.window_bkg);
+    pixmap_inverse_fill(wnd, img_x, img_y, width, height, ctx.window_bkg);
 
     // clear image background
     if (img->alpha) {
         if (ctx.image_bkg == GRID_BKGID) {
-            pixmap_grid(wnd, ctx.img_x, ctx.img_y, width, height, GRID_STEP,
+            pixmap_grid(wnd, img_x, img_y, width, height, GRID_STEP,
                         GRID_COLOR1, GRID_COLOR2);
         } else {
-            pixmap_fill(wnd, ctx.img_x, ctx.img_y, width, height,
-                        ctx.image_bkg);
+            pixmap_fill(wnd, img_x, img_y, width, height, ctx.image_bkg);
         }
     }
 
     // put image on window surface
-    if (ctx.scale == 1.0) {
-        pixmap_copy(img_pm, wnd, ctx.img_x, ctx.img_y, img->alpha);
-    } else {
-        pixmap_scale(ctx.aa_mode, img_pm, wnd, ctx.img_x, ctx.img_y, ctx.scale,
-                     img->alpha);
+    if (layer) {
+        return; // image is drawn by compositor
+    }
+    if (ctx.scale == 1.0 && img->orient == orient_normal && !img->tiles) {
+        if (img->gray) {
+            update_grayscale(img, wnd, img_x, img_y);
+        }
+        pixmap_copy(img_pm, wnd, img_x, img_y, img->alpha);
+    } else if (ctx.animation_enable) {
+        // frames are changed too often to cache them separately
+        if (!draw_anim(wnd, img_x, img_y, width, height)) {
+            draw_scaled(wnd, img_x, img_y);
+        }
+    } else if (cache_update(width, height)) {
+        pixmap_copy(&ctx.cache.pm, wnd, img_x + ctx.cache.x,
+                    img_y + ctx.cache.y, img->alpha);
     }
 }
 
@@ -635,6 +1434,9 @@ static void reload(void)
 {
     const size_t index = fetcher_current()->index;
 
+    reset_next();
+    reset_anim();
+
     if (fetcher_reset(index, false)) {
         if (index == fetcher_current()->index) {
             info_update(info_status, "Image reloaded");
@@ -648,15 +1450,227 @@ static void reload(void)
     }
 }
 
+/**
+ * Scale the next slideshow image in background, see `worker_fn`.
+ * The image is not freed while the job is running: its frames are released
+ * only after jobs of the image are completed.
+ * @param data image to scale, owner of the job
+ */
+static void prerender_job(void* data)
+{
+    struct view_next* next = &ctx.next;
+    struct image_frame frame;
+    struct pixmap pm;
+    size_t generation;
+    ssize_t vx, vy;
+    size_t vw, vh;
+    double scale;
+    enum aa_mode aa;
+    enum pixmap_orient orient;
+    bool alpha;
+
+    pthread_mutex_lock(&next->lock);
+    if (next->image != data || next->generation == 0 || next->valid) {
+        pthread_mutex_unlock(&next->lock);
+        return; // request was reset or replaced
+    }
+    generation = next->generation;
+    frame = next->frame;
+    alpha = next->alpha;
+    orient = next->orient;
+    vx = next->vx;
+    vy = next->vy;
+    vw = next->vw;
+    vh = next->vh;
+    scale = next->scale;
+    aa = next->aa_mode;
+    pm = next->pm; // reuse buffer of the previous slide
+    memset(&next->pm, 0, sizeof(next->pm));
+    pthread_mutex_unlock(&next->lock);
+
+    if (pm.data && pm.width == vw && pm.height == vh) {
+        memset(pm.data, 0, vw * vh * sizeof(argb_t));
+    } else {
+        pixmap_free(&pm);
+        if (!pixmap_create(&pm, vw, vh)) {
+            return;
+        }
+    }
+
+    // the pool is used by the main thread
+    tpool_set_serial(true);
+    pixmap_scale_mipmap(aa, &frame.pm, frame.mipmap, frame.mipmap_levels, &pm,
+                        -vx, -vy, scale, alpha, orient);
+    tpool_set_serial(false);
+
+    pthread_mutex_lock(&next->lock);
+    if (next->image == data && next->generation == generation) {
+        pixmap_free(&next->pm);
+        next->pm = pm;
+        next->valid = true;
+    } else {
+        pixmap_free(&pm);
+    }
+    pthread_mutex_unlock(&next->lock);
+}
+
+/**
+ * Request scaling of the next slideshow image to the window size in
+ * background, so the slide is switched without scaling on the timer.
+ */
+static void prerender_next(void)
+{
+    struct view_next* next = &ctx.next;
+    const struct image* cur = fetcher_current();
+    const struct image* img;
+    const ssize_t wnd_width = ui_get_width();
+    const ssize_t wnd_height = ui_get_height();
+    const ssize_t cur_x = ctx.img_x;
+    const ssize_t cur_y = ctx.img_y;
+    ssize_t width, height;
+    ssize_t x, y, vx, vy, vw, vh;
+    size_t index;
+    double scale;
+    bool requested;
+
+    if (!ctx.slideshow_enable || ctx.keep_zoom || ctx.layer || !cur) {
+        return;
+    }
+
+    index = image_list_next_file(cur->index);
+    if (index == IMGLIST_INVALID || index == cur->index) {
+        return;
+    }
+
+    // only images drawn through the scaled image cache are supported
+    img = fetcher_peek(index);
+    if (!img || img->num_frames != 1 || img->anim || img->tiles ||
+        img->vector.render || img->gray || img->preview) {
+        return;
+    }
+    scale = get_fixed_scale(ctx.scale_init, image_get_width(img),
+                            image_get_height(img));
+    if (scale == 1.0 && img->orient == orient_normal) {
+        return; // will be copied without scaling
+    }
+
+    // initial position, same as set by reset_state()
+    width = scale * image_get_width(img);
+    height = scale * image_get_height(img);
+    place_image(width, height, true);
+    x = ctx.img_x;
+    y = ctx.img_y;
+    ctx.img_x = cur_x;
+    ctx.img_y = cur_y;
+
+    // visible area of the scaled image
+    vx = max(0, -x);
+    vy = max(0, -y);
+    vw = min(width, wnd_width - x) - vx;
+    vh = min(height, wnd_height - y) - vy;
+    if (vw <= 0 || vh <= 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&next->lock);
+    requested = next->generation == img->generation &&
+        next->index == index && next->scale == scale &&
+        next->width == (size_t)wnd_width &&
+        next->height == (size_t)wnd_height && next->aa_mode == ctx.aa_mode;
+    if (!requested) {
+        // frame is copied as mipmaps can be attached later by the main thread
+        next->image = img;
+        next->generation = img->generation;
+        next->index = index;
+        next->frame = img->frames[0];
+        next->alpha = img->alpha;
+        next->orient = img->orient;
+        next->x = x;
+        next->y = y;
+        next->vx = vx;
+        next->vy = vy;
+        next->vw = vw;
+        next->vh = vh;
+        next->scale = scale;
+        next->width = wnd_width;
+        next->height = wnd_height;
+        next->aa_mode = ctx.aa_mode;
+        next->valid = false;
+    }
+    pthread_mutex_unlock(&next->lock);
+
+    if (!requested && !worker_post(prerender_job, (void*)img)) {
+        reset_next();
+    }
+}
+
 /**
  * Redraw handler.
  */
 static void redraw(void)
 {
-    struct pixmap* window = ui_draw_begin();
-    if (window) {
-        draw_image(window);
-        info_print(window);
+    struct pixmap* canvas;
+    ssize_t x, y;
+
+    if (ui_draw_begin()) {
+        canvas = ui_draw_window(&x, &y);
+        if (canvas) {
+            draw_image(canvas, x, y);
+        }
+        canvas = ui_draw_overlay(&x, &y);
+        if (canvas) {
+            info_print(canvas, x, y);
+        }
+        ui_draw_commit();
+    }
+
+    // the slide is on the screen, prepare the next one
+    prerender_next();
+}
+
+/**
+ * Draw partially decoded image while it is being loaded.
+ * @param img image being decoded
+ * @param rows number of decoded rows of the first frame
+ */
+static void draw_progress(const struct image* img, size_t rows)
+{
+    const struct pixmap* pm;
+    struct pixmap part;
+    struct pixmap* canvas;
+    double scale;
+    ssize_t img_x, img_y;
+    ssize_t x, y;
+
+    if (img->num_frames == 0 || rows == 0) {
+        return;
+    }
+    pm = &img->frames[0].pm;
+
+    // the final scale and position are set when the image is loaded
+    if (ctx.keep_zoom && ctx.scale != 0) {
+        scale = ctx.scale;
+    } else {
+        scale = get_fixed_scale(ctx.scale_init, pm->width, pm->height);
+    }
+    img_x = (ssize_t)ui_get_width() / 2 - (ssize_t)(scale * pm->width) / 2;
+    img_y = (ssize_t)ui_get_height() / 2 - (ssize_t)(scale * pm->height) / 2;
+
+    part.width = pm->width;
+    part.height = min(rows, pm->height);
+    part.data = pm->data;
+
+    ui_damage_all();
+    if (ui_draw_begin()) {
+        canvas = ui_draw_window(&x, &y);
+        if (canvas) {
+            pixmap_fill(canvas, 0, 0, canvas->width, canvas->height,
+                        ctx.window_bkg);
+            // alpha channel is not known until the image is fully decoded
+            pixmap_scale(ctx.aa_fast, &part, canvas, img_x - x, img_y - y,
+                         scale, true);
+        }
+        ui_draw_overlay(&x, &y); // clear text of the previous image
         ui_draw_commit();
     }
 }
@@ -666,10 +1680,49 @@ static void redraw(void)
  */
 static void on_resize(void)
 {
+    reset_next();
     fixup_position(false);
     reset_state();
 }
 
+/**
+ * Image list change handler: update index of the current image.
+ */
+static void on_list_update(void)
+{
+    const struct image* img;
+    size_t prev;
+
+    if (!app_is_viewer()) {
+        return; // caches are reset on activation
+    }
+
+    img = fetcher_current();
+    prev = img ? img->index : IMGLIST_INVALID;
+
+    reset_next();
+    fetcher_remap();
+
+    img = fetcher_current();
+    if (img && img->index == IMGLIST_INVALID && prev != IMGLIST_INVALID) {
+        // current file was removed, switch to the nearest one
+        size_t index = image_list_remap_nearest(prev);
+        reset_anim();
+        while (index != IMGLIST_INVALID && !fetcher_open(index)) {
+            index = image_list_skip(index);
+        }
+        if (index != IMGLIST_INVALID) {
+            reset_state();
+            return;
+        }
+    }
+    if (img && img->index != IMGLIST_INVALID) {
+        info_update(info_index, "%zu of %zu", img->index + 1,
+                    image_list_size());
+        app_redraw();
+    }
+}
+
 /**
  * Apply action.
  * @param action pointer to the action being performed
@@ -738,17 +1791,23 @@ static void apply_action(const struct action* action)
             break;
         case action_flip_vertical:
             image_flip_vertical(fetcher_current());
+            reset_cache();
             app_redraw();
             break;
         case action_flip_horizontal:
             image_flip_horizontal(fetcher_current());
+            reset_cache();
             app_redraw();
             break;
         case action_antialiasing:
             ctx.aa_mode = aa_switch(ctx.aa_mode, action->params);
+            reset_cache();
             info_update(info_status, "Anti-aliasing: %s", aa_name(ctx.aa_mode));
             app_redraw();
             break;
+        case action_window_level:
+            window_level(action->params);
+            break;
         case action_reload:
             reload();
             break;
@@ -759,16 +1818,24 @@ static void apply_action(const struct action* action)
 #ifdef HAVE_LIBPNG
             if (!action->params || !*action->params) {
                 info_update(info_status, "Error: export path is not specified");
-            } else if (export_png(&fetcher_current()->frames[ctx.frame].pm,
-                                  NULL, action->params)) {
-                info_update(info_status, "Export completed");
             } else {
-                info_update(info_status, "Error: export failed");
+                struct image* img = fetcher_current();
+                // export the frame as it is displayed
+                if (img->gray) {
+                    grayscale_update(img, 0, 0, SIZE_MAX, SIZE_MAX);
+                }
+                reset_anim();
+                image_apply_orient(img);
+                if (export_png(&img->frames[ctx.frame].pm, NULL,
+                               action->params)) {
+                    info_update(info_status, "Export completed");
+                } else {
+                    info_update(info_status, "Error: export failed");
+                }
             }
 #else
             info_update(info_status, "Error: export to PNG is not supported");
 #endif // HAVE_LIBPNG
-            app_redraw();
             break;
         default:
             break;
@@ -784,6 +1851,8 @@ static void on_drag(int dx, int dy)
     const ssize_t old_x = ctx.img_x;
     const ssize_t old_y = ctx.img_y;
 
+    interactive_start();
+
     ctx.img_x += dx;
     ctx.img_y += dy;
 
@@ -796,12 +1865,21 @@ static void on_drag(int dx, int dy)
 void viewer_init(const struct config* cfg, struct image* image)
 {
     size_t history;
+    size_t history_mem;
+    size_t history_zip;
     size_t preload;
+    size_t prefetch;
     const char* value;
 
     ctx.fixed = config_get_bool(cfg, CFG_VIEWER, CFG_VIEW_FIXED);
     ctx.aa_mode = aa_init(cfg, CFG_VIEWER, CFG_VIEW_AA);
+    ctx.aa_fast = aa_init(cfg, CFG_VIEWER, CFG_VIEW_AA_FAST);
     ctx.window_bkg = config_get_color(cfg, CFG_VIEWER, CFG_VIEW_WINDOW);
+    ctx.layer = config_get_bool(cfg, CFG_VIEWER, CFG_VIEW_LAYER);
+    if (config_get_bool(cfg, CFG_VIEWER, CFG_VIEW_GPU)) {
+        ui_layer_use_gpu(true);
+        ctx.layer = true;
+    }
 
     // background for transparent images
     value = config_get(cfg, CFG_VIEWER, CFG_VIEW_TRANSP);
@@ -820,14 +1898,45 @@ void viewer_init(const struct config* cfg, struct image* image)
 
     // cache and preloads
     history = config_get_num(cfg, CFG_VIEWER, CFG_VIEW_HISTORY, 0, 1024);
+    history_mem = config_get_num(cfg, CFG_VIEWER, CFG_VIEW_HISTORY_M, 0,
+                                 1024 * 1024);
+    history_zip = config_get_num(cfg, CFG_VIEWER, CFG_VIEW_HISTORY_Z, 0,
+                                 1024 * 1024);
     preload = config_get_num(cfg, CFG_VIEWER, CFG_VIEW_PRELOAD, 0, 1024);
+    prefetch = config_get_num(cfg, CFG_VIEWER, CFG_VIEW_PREFETCH, 0, 1024);
+
+    // mipmaps for zooming out
+    if (config_get_bool(cfg, CFG_VIEWER, CFG_VIEW_MIPMAP)) {
+        const size_t mib = config_get_num(cfg, CFG_VIEWER, CFG_VIEW_MIPMAP_LM,
+                                          1, 1024 * 1024);
+        ctx.mipmap = mib * 1024 * 1024;
+    }
+    if (image) {
+        loader_set_shared(true);
+        loader_set_size_hint(0);
+        loader_set_hook(NULL);
+        loader_set_cache(NULL);
+    }
+
+    // cache of scaled animation frames
+    ctx.anim.limit = config_get_num(cfg, CFG_VIEWER, CFG_VIEW_ANIM_MEM, 0,
+                                    1024 * 1024) *
+        1024 * 1024;
+    ctx.anim.request = ANIM_NONE;
+    pthread_mutex_init(&ctx.next.lock, NULL);
+    pthread_mutex_init(&ctx.anim.lock, NULL);
+    pthread_cond_init(&ctx.anim.signal, NULL);
+    if (ctx.anim.limit &&
+        pthread_create(&ctx.anim.tid, NULL, anim_thread, NULL) != 0) {
+        ctx.anim.tid = 0;
+    }
 
     // setup animation timer
     ctx.animation_enable = true;
     ctx.animation_fd =
         timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
     if (ctx.animation_fd != -1) {
-        app_watch(ctx.animation_fd, on_animation_timer, NULL);
+        app_watch(ctx.animation_fd, POLLIN, on_animation_timer, NULL);
     }
     // setup slideshow timer
     ctx.slideshow_enable = config_get_bool(cfg, CFG_VIEWER, CFG_VIEW_SSHOW);
@@ -836,15 +1945,38 @@ void viewer_init(const struct config* cfg, struct image* image)
     ctx.slideshow_fd =
         timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
     if (ctx.slideshow_fd != -1) {
-        app_watch(ctx.slideshow_fd, on_slideshow_timer, NULL);
+        app_watch(ctx.slideshow_fd, POLLIN, on_slideshow_timer, NULL);
+    }
+    // setup interactive mode timer
+    ctx.interactive_fd =
+        timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (ctx.interactive_fd != -1) {
+        app_watch(ctx.interactive_fd, POLLIN, on_interactive_timer, NULL);
     }
 
-    fetcher_init(image, history, preload);
+    fetcher_init(image, history, history_mem * 1024 * 1024,
+                 history_zip * 1024 * 1024, preload, prefetch);
 }
 
 void viewer_destroy(void)
 {
-    fetcher_destroy();
+    reset_anim();
+    if (ctx.anim.tid) {
+        pthread_mutex_lock(&ctx.anim.lock);
+        ctx.anim.stop = true;
+        pthread_cond_broadcast(&ctx.anim.signal);
+        pthread_mutex_unlock(&ctx.anim.lock);
+        pthread_join(ctx.anim.tid, NULL);
+    }
+    pthread_mutex_destroy(&ctx.anim.lock);
+    pthread_cond_destroy(&ctx.anim.signal);
+
+    reset_next();
+    fetcher_destroy(); // waits for the pre-render job on freeing images
+    pthread_mutex_destroy(&ctx.next.lock);
+
+    pixmap_free(&ctx.cache.pm);
+    pixmap_free(&ctx.cache.back);
 
     if (ctx.animation_fd != -1) {
         close(ctx.animation_fd);
@@ -852,6 +1984,9 @@ void viewer_destroy(void)
     if (ctx.slideshow_fd != -1) {
         close(ctx.slideshow_fd);
     }
+    if (ctx.interactive_fd != -1) {
+        close(ctx.interactive_fd);
+    }
 }
 
 void viewer_handle(const struct event* event)
@@ -870,6 +2005,11 @@ void viewer_handle(const struct event* event)
             on_drag(event->param.drag.dx, event->param.drag.dy);
             break;
         case event_activate:
+            loader_set_shared(true);
+            loader_set_size_hint(0);
+            loader_set_hook(NULL);
+            loader_set_cache(NULL);
+            reset_anim();
             if (fetcher_reset(event->param.activate.index, false)) {
                 reset_state();
             } else {
@@ -877,7 +2017,41 @@ void viewer_handle(const struct event* event)
             }
             break;
         case event_load:
-            fetcher_attach(event->param.load.image, event->param.load.index);
+            if (fetcher_current() &&
+                fetcher_current()->index == event->param.load.index) {
+                reset_anim(); // current image can be replaced
+            }
+            if (fetcher_attach(event->param.load.image,
+                               event->param.load.index)) {
+                update_image();
+            } else {
+                prerender_next();
+            }
+            break;
+        case event_progress:
+            draw_progress(event->param.progress.image,
+                          event->param.progress.rows);
+            break;
+        case event_list:
+            on_list_update();
             break;
+        case event_update:
+            if (fetcher_current() &&
+                fetcher_current()->generation ==
+                    event->param.update.generation) {
+                reset_cache();
+                app_redraw();
+            }
+            break;
+    }
+}
+
+bool viewer_open(size_t index)
+{
+    reset_anim();
+    if (!fetcher_open(index)) {
+        return false;
     }
+    reset_state();
+    return true;
 }
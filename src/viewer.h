@@ -24,3 +24,10 @@ void viewer_destroy(void);
  * Event handler, see `event_handler` for details.
  */
 void viewer_handle(const struct event* event);
+
+/**
+ * Open image and make it the current one, preloaded images are reused.
+ * @param index index of the image in the image list
+ * @return true if image was opened
+ */
+bool viewer_open(size_t index);
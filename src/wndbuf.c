@@ -10,28 +10,42 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
-struct wl_buffer* wndbuf_create(struct wl_shm* shm, size_t width, size_t height)
+/** Buffer description. */
+struct wndbuf {
+    struct pixmap pm;             ///< Pixel map of the buffer
+    bool busy;                    ///< Buffer is used by compositor
+    wndbuf_release_fn on_release; ///< Release callback
+};
+
+/** Wayland handler: compositor doesn't use the buffer anymore. */
+static void on_buffer_release(void* data,
+                              __attribute__((unused)) struct wl_buffer* buffer)
 {
-    assert(shm);
-    assert(width > 0);
-    assert(height > 0);
+    struct wndbuf* wb = data;
+    wb->busy = false;
+    if (wb->on_release) {
+        wb->on_release();
+    }
+}
 
-    const size_t stride = width * sizeof(argb_t);
-    const size_t data_sz = stride * height;
-    const size_t buffer_sz = data_sz + sizeof(struct pixmap);
-
-    struct pixmap* pm;
-    struct wl_buffer* buffer;
-    struct wl_shm_pool* pool;
+static const struct wl_buffer_listener buffer_listener = {
+    .release = on_buffer_release,
+};
 
+/**
+ * Create shared memory file.
+ * @return file descriptor or -1 on errors
+ */
+static int create_shm(void)
+{
     static size_t counter = 0;
-    int fd = -1;
     char path[64];
-    void* data;
+    int fd;
 
     // generate unique file name
     snprintf(path, sizeof(path), "/" APP_NAME "_%x_%zx", getpid(), ++counter);
@@ -42,60 +56,161 @@ struct wl_buffer* wndbuf_create(struct wl_shm* shm, size_t width, size_t height)
         const int err = errno;
         fprintf(stderr, "Unable to create shared file %s: [%i] %s\n", path, err,
                 strerror(err));
-        return NULL;
+        return -1;
     }
     shm_unlink(path);
 
-    // set shared memory size
-    if (ftruncate(fd, buffer_sz) == -1) {
+    return fd;
+}
+
+/**
+ * Set size of the shared memory file and map it.
+ * @param pool buffer pool
+ * @param size new size of the pool
+ * @return true if operation completed successfully
+ */
+static bool map_shm(struct wndbuf_pool* pool, size_t size)
+{
+    void* data;
+
+    if (ftruncate(pool->fd, size) == -1) {
         const int err = errno;
-        fprintf(stderr, "Unable to truncate shared file %s: [%i] %s\n", path,
-                err, strerror(err));
-        close(fd);
-        return NULL;
+        fprintf(stderr, "Unable to truncate shared file: [%i] %s\n", err,
+                strerror(err));
+        return false;
     }
 
-    // get data pointer of the shared mem
-    data = mmap(NULL, buffer_sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, pool->fd, 0);
     if (data == MAP_FAILED) {
         const int err = errno;
-        fprintf(stderr, "Unable to map shared file %s: [%i] %s\n", path, err,
+        fprintf(stderr, "Unable to map shared file: [%i] %s\n", err,
                 strerror(err));
-        close(fd);
-        return NULL;
+        return false;
+    }
+
+    if (pool->data) {
+        munmap(pool->data, pool->size);
     }
+    pool->data = data;
+    pool->size = size;
 
-    // fill buffer user data
-    pm = (struct pixmap*)((uint8_t*)data + data_sz);
-    pm->width = width;
-    pm->height = height;
-    pm->data = data;
+    return true;
+}
 
-    // create wayland buffer
-    pool = wl_shm_create_pool(shm, fd, buffer_sz);
-    buffer = wl_shm_pool_create_buffer(pool, 0, width, height, stride,
-                                       WL_SHM_FORMAT_ARGB8888);
-    wl_buffer_set_user_data(buffer, pm);
+bool wndbuf_pool_reserve(struct wndbuf_pool* pool, struct wl_shm* shm,
+                         size_t size)
+{
+    assert(shm);
+    assert(size > 0);
+
+    if (pool->pool && size <= pool->size) {
+        if (size >= pool->size / 2) {
+            return true; // reuse existing pool
+        }
+        // too much unused space, tmpfs pages of the shared memory file can
+        // be released only by recreating it
+        wndbuf_pool_free(pool);
+    }
 
-    wl_shm_pool_destroy(pool);
-    close(fd);
+    if (pool->pool) {
+        // grow existing pool, wayland pool can't be shrunk
+        if (!map_shm(pool, size)) {
+            wndbuf_pool_free(pool);
+            return false;
+        }
+        wl_shm_pool_resize(pool->pool, size);
+        return true;
+    }
+
+    // create new pool
+    pool->fd = create_shm();
+    if (pool->fd == -1) {
+        return false;
+    }
+    if (!map_shm(pool, size)) {
+        close(pool->fd);
+        return false;
+    }
+    pool->pool = wl_shm_create_pool(shm, pool->fd, size);
+
+    return true;
+}
+
+void wndbuf_pool_free(struct wndbuf_pool* pool)
+{
+    if (pool->pool) {
+        wl_shm_pool_destroy(pool->pool);
+    }
+    if (pool->data) {
+        munmap(pool->data, pool->size);
+        close(pool->fd);
+    }
+    memset(pool, 0, sizeof(*pool));
+}
+
+struct wl_buffer* wndbuf_create(struct wndbuf_pool* pool, size_t offset,
+                                size_t width, size_t height,
+                                wndbuf_release_fn on_release)
+{
+    const size_t stride = width * sizeof(argb_t);
+    struct wl_buffer* buffer;
+    struct wndbuf* wb;
+
+    assert(pool->pool);
+    assert(width > 0);
+    assert(height > 0);
+    assert(offset + stride * height <= pool->size);
+
+    wb = malloc(sizeof(*wb));
+    if (!wb) {
+        return NULL;
+    }
+    wb->pm.width = width;
+    wb->pm.height = height;
+    wb->pm.data = (argb_t*)((uint8_t*)pool->data + offset);
+    wb->busy = false;
+    wb->on_release = on_release;
+
+    buffer = wl_shm_pool_create_buffer(pool->pool, offset, width, height,
+                                       stride, WL_SHM_FORMAT_ARGB8888);
+    if (!buffer) {
+        free(wb);
+        return NULL;
+    }
+    wl_buffer_add_listener(buffer, &buffer_listener, wb);
 
     return buffer;
 }
 
 struct pixmap* wndbuf_pixmap(struct wl_buffer* buffer)
 {
+    struct wndbuf* wb;
+    assert(buffer);
+    wb = wl_buffer_get_user_data(buffer);
+    return &wb->pm;
+}
+
+void wndbuf_lock(struct wl_buffer* buffer)
+{
+    struct wndbuf* wb;
+    assert(buffer);
+    wb = wl_buffer_get_user_data(buffer);
+    wb->busy = true;
+}
+
+bool wndbuf_busy(struct wl_buffer* buffer)
+{
+    const struct wndbuf* wb;
     assert(buffer);
-    return wl_buffer_get_user_data(buffer);
+    wb = wl_buffer_get_user_data(buffer);
+    return wb->busy;
 }
 
 void wndbuf_free(struct wl_buffer* buffer)
 {
     if (buffer) {
-        struct pixmap* pm = wl_buffer_get_user_data(buffer);
-        const size_t sz =
-            pm->width * pm->height * sizeof(argb_t) + sizeof(struct pixmap);
-        munmap(pm->data, sz);
+        struct wndbuf* wb = wl_buffer_get_user_data(buffer);
         wl_buffer_destroy(buffer);
+        free(wb);
     }
 }
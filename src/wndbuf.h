@@ -8,14 +8,47 @@
 
 #include <wayland-client-protocol.h>
 
+/** Shared memory pool for window buffers. */
+struct wndbuf_pool {
+    struct wl_shm_pool* pool; ///< Wayland shared memory pool
+    int fd;                   ///< Shared memory file, valid if mapped
+    void* data;               ///< Mapped shared memory
+    size_t size;              ///< Size of the pool in bytes
+};
+
 /**
- * Create window buffer.
+ * Buffer release callback.
+ */
+typedef void (*wndbuf_release_fn)(void);
+
+/**
+ * Reserve space in the pool: grow it if needed.
+ * All buffers created from the pool must be freed before this call.
+ * @param pool buffer pool, zero-initialized on the first call
  * @param shm wayland shared memory interface
+ * @param size required size in bytes
+ * @return true if pool is ready
+ */
+bool wndbuf_pool_reserve(struct wndbuf_pool* pool, struct wl_shm* shm,
+                         size_t size);
+
+/**
+ * Free buffer pool.
+ * @param pool buffer pool to free
+ */
+void wndbuf_pool_free(struct wndbuf_pool* pool);
+
+/**
+ * Create window buffer.
+ * @param pool buffer pool to use
+ * @param offset offset of the buffer data in the pool
  * @param width,height buffer size in pixels
+ * @param on_release callback called when compositor releases the buffer
  * @return wayland buffer on NULL on errors
  */
-struct wl_buffer* wndbuf_create(struct wl_shm* shm, size_t width,
-                                size_t height);
+struct wl_buffer* wndbuf_create(struct wndbuf_pool* pool, size_t offset,
+                                size_t width, size_t height,
+                                wndbuf_release_fn on_release);
 /**
  * Get pixel map assiciated with the buffer.
  * @param buffer wayland buffer
@@ -23,6 +56,19 @@ struct wl_buffer* wndbuf_create(struct wl_shm* shm, size_t width,
  */
 struct pixmap* wndbuf_pixmap(struct wl_buffer* buffer);
 
+/**
+ * Mark buffer as used by compositor, it stays busy until released.
+ * @param buffer wayland buffer attached to the surface
+ */
+void wndbuf_lock(struct wl_buffer* buffer);
+
+/**
+ * Check if the buffer is used by compositor.
+ * @param buffer wayland buffer
+ * @return true if buffer can't be changed now
+ */
+bool wndbuf_busy(struct wl_buffer* buffer);
+
 /**
  * Free window buffer.
  * @param buffer wayland buffer to free
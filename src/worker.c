@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: MIT
+// Background worker for jobs requested by the main thread.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "worker.h"
+
+#include "list.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+/** Job in the queue. */
+struct worker_job {
+    struct list list; ///< Links to prev/next entry
+    worker_fn fn;     ///< Job handler
+    void* data;       ///< User data for the handler
+};
+
+/** Worker context. */
+struct worker {
+    pthread_t tid;            ///< Worker thread
+    bool started;             ///< Thread is running
+    bool stop;                ///< Stop flag
+    struct worker_job* queue; ///< Jobs queue
+    const void* running;      ///< Owner of the running job
+    pthread_mutex_t lock;     ///< Queue lock
+    pthread_cond_t signal;    ///< Queue state notification
+};
+
+static struct worker ctx = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .signal = PTHREAD_COND_INITIALIZER,
+};
+
+/**
+ * Worker thread: execute queued jobs.
+ */
+static void* worker_thread(__attribute__((unused)) void* data)
+{
+    pthread_mutex_lock(&ctx.lock);
+    while (!ctx.stop) {
+        struct worker_job* job = ctx.queue;
+        if (!job) {
+            pthread_cond_wait(&ctx.signal, &ctx.lock);
+            continue;
+        }
+        ctx.queue = list_unlink(ctx.queue, job);
+        ctx.running = job->data;
+        pthread_mutex_unlock(&ctx.lock);
+
+        job->fn(job->data);
+        free(job);
+
+        pthread_mutex_lock(&ctx.lock);
+        ctx.running = NULL;
+        pthread_cond_broadcast(&ctx.signal);
+    }
+    pthread_mutex_unlock(&ctx.lock);
+
+    return NULL;
+}
+
+void worker_destroy(void)
+{
+    pthread_mutex_lock(&ctx.lock);
+    ctx.stop = true;
+    pthread_cond_broadcast(&ctx.signal);
+    pthread_mutex_unlock(&ctx.lock);
+
+    if (ctx.started) {
+        pthread_join(ctx.tid, NULL);
+        ctx.started = false;
+    }
+
+    list_for_each(ctx.queue, struct worker_job, it) {
+        free(it);
+    }
+    ctx.queue = NULL;
+    ctx.stop = false;
+}
+
+bool worker_post(worker_fn fn, void* data)
+{
+    struct worker_job* job = calloc(1, sizeof(*job));
+
+    if (!job) {
+        return false;
+    }
+    job->fn = fn;
+    job->data = data;
+
+    pthread_mutex_lock(&ctx.lock);
+    if (!ctx.started) {
+        ctx.started =
+            (pthread_create(&ctx.tid, NULL, worker_thread, NULL) == 0);
+    }
+    if (ctx.started) {
+        ctx.queue = list_append(ctx.queue, job);
+        pthread_cond_broadcast(&ctx.signal);
+    } else {
+        free(job);
+        job = NULL;
+    }
+    pthread_mutex_unlock(&ctx.lock);
+
+    return job;
+}
+
+void worker_cancel(const void* data)
+{
+    pthread_mutex_lock(&ctx.lock);
+    list_for_each(ctx.queue, struct worker_job, it) {
+        if (it->data == data) {
+            ctx.queue = list_unlink(ctx.queue, it);
+            free(it);
+        }
+    }
+    while (ctx.running == data) {
+        pthread_cond_wait(&ctx.signal, &ctx.lock);
+    }
+    pthread_mutex_unlock(&ctx.lock);
+}
@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: MIT
+// Background worker for jobs requested by the main thread.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include <stdbool.h>
+
+/**
+ * Job handler.
+ * @param data user data passed to `worker_post`
+ */
+typedef void (*worker_fn)(void* data);
+
+/**
+ * Stop the worker thread, queued jobs are dropped.
+ */
+void worker_destroy(void);
+
+/**
+ * Add job to the end of the queue, the worker thread is started on demand.
+ * Jobs are executed one by one in the order in which they were posted.
+ * @param fn job handler
+ * @param data user data to pass to the handler, identifies owner of the job
+ * @return false if the job can't be executed
+ */
+bool worker_post(worker_fn fn, void* data);
+
+/**
+ * Remove queued jobs of the owner and wait for the running one.
+ * @param data owner of the jobs passed to `worker_post`
+ */
+void worker_cancel(const void* data);
@@ -0,0 +1,574 @@
+// SPDX-License-Identifier: MIT
+// Compressed cache of previously viewed images.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#include "zcache.h"
+
+#include "hashmap.h"
+#include "priority.h"
+#include "tpool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Number of rows in a band, bands are compressed independently
+#define BAND_ROWS 64
+// Max size of a single compressed pixel
+#define MAX_PIXEL_SIZE 5
+
+// Chunk tags (QOI compatible)
+#define OP_INDEX 0x00
+#define OP_DIFF  0x40
+#define OP_LUMA  0x80
+#define OP_RUN   0xc0
+#define OP_RGB   0xfe
+#define OP_RGBA  0xff
+#define OP_MASK  0xc0
+
+// Max length of a single run
+#define MAX_RUN 62
+
+// Size of color map
+#define CLRMAP_SIZE 64
+// Calc color index in map
+#define CLRMAP_INDEX(c)                                           \
+    ((ARGB_GET_R(c) * 3 + ARGB_GET_G(c) * 5 + ARGB_GET_B(c) * 7 + \
+      ARGB_GET_A(c) * 11) %                                       \
+     CLRMAP_SIZE)
+
+/** State of the cache entry. */
+enum zstate {
+    zs_pending, ///< Waiting for compression
+    zs_busy,    ///< Compression in progress
+    zs_ready,   ///< Pixel data is compressed
+};
+
+/** Cache entry. */
+struct zentry {
+    struct list list;     ///< Links to older/newer entry
+    struct image* image;  ///< Cached image, without frames when compressed
+    enum zstate state;    ///< Entry state
+    size_t width, height; ///< Size of the frame
+    uint8_t* data;        ///< Compressed pixel data
+    size_t* bands;        ///< Offsets of the bands in compressed data
+    size_t size;          ///< Size of compressed data in bytes
+};
+
+/** Restore task. */
+struct zrestore {
+    const struct zentry* entry; ///< Source entry
+    struct pixmap* pm;          ///< Destination frame
+};
+
+/** Compressed cache context. */
+struct zcache {
+    size_t limit;          ///< Max size of compressed data
+    size_t used;           ///< Current size of compressed data
+    struct zentry* head;   ///< The newest entry
+    struct zentry* tail;   ///< The oldest entry
+    struct hashmap map;    ///< Entries by image index
+    bool stop;             ///< Flag to stop compression thread
+    pthread_t tid;         ///< Compression thread
+    pthread_mutex_t lock;  ///< Cache access lock
+    pthread_cond_t signal; ///< Queue and state notification
+};
+
+/** Global compressed cache context. */
+static struct zcache ctx;
+
+/**
+ * Compress pixels.
+ * @param src source pixels
+ * @param num number of pixels
+ * @param dst destination buffer, at least `num * MAX_PIXEL_SIZE` bytes
+ * @return size of compressed data
+ */
+static size_t encode_band(const argb_t* src, size_t num, uint8_t* dst)
+{
+    argb_t clrmap[CLRMAP_SIZE];
+    argb_t prev = ARGB(0xff, 0, 0, 0);
+    size_t run = 0;
+    size_t pos = 0;
+
+    memset(clrmap, 0, sizeof(clrmap));
+
+    for (size_t i = 0; i < num; ++i) {
+        const argb_t px = src[i];
+        const size_t idx = CLRMAP_INDEX(px);
+
+        if (px == prev) {
+            if (++run == MAX_RUN) {
+                dst[pos++] = OP_RUN | (run - 1);
+                run = 0;
+            }
+            continue;
+        }
+        if (run) {
+            dst[pos++] = OP_RUN | (run - 1);
+            run = 0;
+        }
+
+        if (clrmap[idx] == px) {
+            dst[pos++] = OP_INDEX | idx;
+        } else if (ARGB_GET_A(px) != ARGB_GET_A(prev)) {
+            dst[pos++] = OP_RGBA;
+            dst[pos++] = ARGB_GET_R(px);
+            dst[pos++] = ARGB_GET_G(px);
+            dst[pos++] = ARGB_GET_B(px);
+            dst[pos++] = ARGB_GET_A(px);
+        } else {
+            const int dr = (int8_t)(ARGB_GET_R(px) - ARGB_GET_R(prev));
+            const int dg = (int8_t)(ARGB_GET_G(px) - ARGB_GET_G(prev));
+            const int db = (int8_t)(ARGB_GET_B(px) - ARGB_GET_B(prev));
+            const int dr_dg = dr - dg;
+            const int db_dg = db - dg;
+            if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 &&
+                db <= 1) {
+                dst[pos++] =
+                    OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2);
+            } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 &&
+                       db_dg >= -8 && db_dg <= 7) {
+                dst[pos++] = OP_LUMA | (dg + 32);
+                dst[pos++] = (dr_dg + 8) << 4 | (db_dg + 8);
+            } else {
+                dst[pos++] = OP_RGB;
+                dst[pos++] = ARGB_GET_R(px);
+                dst[pos++] = ARGB_GET_G(px);
+                dst[pos++] = ARGB_GET_B(px);
+            }
+        }
+
+        clrmap[idx] = px;
+        prev = px;
+    }
+
+    if (run) {
+        dst[pos++] = OP_RUN | (run - 1);
+    }
+
+    return pos;
+}
+
+/**
+ * Decompress pixels.
+ * @param src compressed data
+ * @param dst destination buffer
+ * @param num number of pixels to decompress
+ */
+static void decode_band(const uint8_t* src, argb_t* dst, size_t num)
+{
+    argb_t clrmap[CLRMAP_SIZE];
+    uint8_t a = 0xff, r = 0, g = 0, b = 0;
+    size_t pos = 0;
+    size_t i = 0;
+
+    memset(clrmap, 0, sizeof(clrmap));
+
+    while (i < num) {
+        const uint8_t tag = src[pos++];
+        argb_t px;
+
+        if (tag == OP_RGB) {
+            r = src[pos++];
+            g = src[pos++];
+            b = src[pos++];
+        } else if (tag == OP_RGBA) {
+            r = src[pos++];
+            g = src[pos++];
+            b = src[pos++];
+            a = src[pos++];
+        } else if ((tag & OP_MASK) == OP_INDEX) {
+            px = clrmap[tag];
+            a = ARGB_GET_A(px);
+            r = ARGB_GET_R(px);
+            g = ARGB_GET_G(px);
+            b = ARGB_GET_B(px);
+        } else if ((tag & OP_MASK) == OP_DIFF) {
+            r += ((tag >> 4) & 3) - 2;
+            g += ((tag >> 2) & 3) - 2;
+            b += (tag & 3) - 2;
+        } else if ((tag & OP_MASK) == OP_LUMA) {
+            const int dg = (tag & 0x3f) - 32;
+            const uint8_t diff = src[pos++];
+            r += dg - 8 + (diff >> 4);
+            g += dg;
+            b += dg - 8 + (diff & 0x0f);
+        } else {
+            // OP_RUN: repeat the previous pixel
+            size_t run = (tag & 0x3f) + 1;
+            px = ARGB(a, r, g, b);
+            while (run-- && i < num) {
+                dst[i++] = px;
+            }
+            continue;
+        }
+
+        px = ARGB(a, r, g, b);
+        clrmap[CLRMAP_INDEX(px)] = px;
+        dst[i++] = px;
+    }
+}
+
+/** Band decompression handler, see `tpool_fn`. */
+static void restore_bands(void* data, size_t low, size_t high)
+{
+    const struct zrestore* task = data;
+    const struct zentry* entry = task->entry;
+    struct pixmap* pm = task->pm;
+
+    for (size_t i = low; i < high; ++i) {
+        const size_t y = i * BAND_ROWS;
+        const size_t rows = min(BAND_ROWS, pm->height - y);
+        decode_band(entry->data + entry->bands[i], &pm->data[y * pm->width],
+                    rows * pm->width);
+    }
+}
+
+/**
+ * Compress the first frame of the image.
+ * @param entry cache entry to fill
+ * @return true if frame was compressed
+ */
+static bool compress(struct zentry* entry)
+{
+    const struct pixmap* pm = &entry->image->frames[0].pm;
+    const size_t num_bands = (pm->height + BAND_ROWS - 1) / BAND_ROWS;
+    size_t capacity = 0;
+    uint8_t* band;
+
+    entry->bands = malloc(num_bands * sizeof(*entry->bands));
+    band = malloc(pm->width * BAND_ROWS * MAX_PIXEL_SIZE);
+    if (!entry->bands || !band) {
+        free(band);
+        return false;
+    }
+
+    for (size_t i = 0; i < num_bands; ++i) {
+        const size_t y = i * BAND_ROWS;
+        const size_t rows = min(BAND_ROWS, pm->height - y);
+        const size_t len =
+            encode_band(&pm->data[y * pm->width], rows * pm->width, band);
+
+        if (entry->size + len > capacity) {
+            uint8_t* data;
+            capacity = max(capacity * 2, entry->size + len);
+            data = realloc(entry->data, capacity);
+            if (!data) {
+                free(band);
+                return false;
+            }
+            entry->data = data;
+        }
+
+        memcpy(entry->data + entry->size, band, len);
+        entry->bands[i] = entry->size;
+        entry->size += len;
+    }
+    free(band);
+
+    entry->width = pm->width;
+    entry->height = pm->height;
+
+    return true;
+}
+
+/**
+ * Restore the first frame of the image.
+ * @param entry compressed cache entry
+ * @return true if frame was restored
+ */
+static bool restore(const struct zentry* entry)
+{
+    const size_t num_bands = (entry->height + BAND_ROWS - 1) / BAND_ROWS;
+    struct zrestore task = { .entry = entry };
+
+    task.pm = image_allocate_frame(entry->image, entry->width, entry->height);
+    if (!task.pm) {
+        return false;
+    }
+    tpool_run(restore_bands, &task, num_bands, 1);
+
+    return true;
+}
+
+/**
+ * Remove entry from the cache, must be called under the lock.
+ * @param entry entry to remove
+ */
+static void remove_entry(struct zentry* entry)
+{
+    if (ctx.tail == entry) {
+        ctx.tail = list_prev(entry);
+    }
+    ctx.head = list_unlink(ctx.head, entry);
+    hashmap_remove(&ctx.map, entry->image->index);
+    if (entry->state == zs_ready) {
+        ctx.used -= entry->size;
+    }
+}
+
+/**
+ * Free entry and its image.
+ * @param entry entry to free
+ */
+static void free_entry(struct zentry* entry)
+{
+    image_free(entry->image);
+    free(entry->data);
+    free(entry->bands);
+    free(entry);
+}
+
+/**
+ * Remove the oldest entries to fit into the limit, must be called under the
+ * lock.
+ */
+static void trim(void)
+{
+    list_for_each_back(ctx.tail, struct zentry, it) {
+        if (ctx.used <= ctx.limit) {
+            break;
+        }
+        if (it->state != zs_busy) {
+            remove_entry(it);
+            free_entry(it);
+        }
+    }
+}
+
+/**
+ * Remove all entries that are not busy, must be called under the lock.
+ * @return true if there are busy entries left
+ */
+static bool remove_all(void)
+{
+    bool busy = false;
+
+    list_for_each(ctx.head, struct zentry, it) {
+        if (it->state == zs_busy) {
+            busy = true;
+        } else {
+            remove_entry(it);
+            free_entry(it);
+        }
+    }
+
+    return busy;
+}
+
+/** Compression thread. */
+static void* compress_thread(__attribute__((unused)) void* data)
+{
+    priority_background();
+
+    pthread_mutex_lock(&ctx.lock);
+
+    while (!ctx.stop) {
+        struct zentry* entry = NULL;
+        bool success;
+
+        // the oldest pending entry
+        list_for_each_back(ctx.tail, struct zentry, it) {
+            if (it->state == zs_pending) {
+                entry = it;
+                break;
+            }
+        }
+        if (!entry) {
+            pthread_cond_wait(&ctx.signal, &ctx.lock);
+            continue;
+        }
+
+        entry->state = zs_busy;
+        pthread_mutex_unlock(&ctx.lock);
+
+        success = compress(entry);
+        if (success) {
+            image_free_frames(entry->image);
+        }
+
+        pthread_mutex_lock(&ctx.lock);
+        if (success) {
+            entry->state = zs_ready;
+            ctx.used += entry->size;
+        } else {
+            entry->state = zs_pending;
+            remove_entry(entry);
+            free_entry(entry);
+        }
+        trim();
+        pthread_cond_broadcast(&ctx.signal);
+    }
+
+    pthread_mutex_unlock(&ctx.lock);
+
+    return NULL;
+}
+
+void zcache_init(size_t limit)
+{
+    if (limit) {
+        pthread_mutex_init(&ctx.lock, NULL);
+        pthread_cond_init(&ctx.signal, NULL);
+        ctx.limit = limit;
+        if (pthread_create(&ctx.tid, NULL, compress_thread, NULL)) {
+            ctx.limit = 0;
+            pthread_mutex_destroy(&ctx.lock);
+            pthread_cond_destroy(&ctx.signal);
+        }
+    }
+}
+
+void zcache_destroy(void)
+{
+    if (ctx.limit) {
+        pthread_mutex_lock(&ctx.lock);
+        ctx.stop = true;
+        pthread_cond_broadcast(&ctx.signal);
+        pthread_mutex_unlock(&ctx.lock);
+        pthread_join(ctx.tid, NULL);
+
+        remove_all();
+        hashmap_free(&ctx.map);
+        pthread_mutex_destroy(&ctx.lock);
+        pthread_cond_destroy(&ctx.signal);
+        memset(&ctx, 0, sizeof(ctx));
+    }
+}
+
+bool zcache_put(struct image* image)
+{
+    struct zentry* entry;
+    struct zentry* old;
+
+    if (!ctx.limit || image->num_frames != 1 || image->anim ||
+        image->tiles || image->vector.render || image->gray ||
+        image->preview) {
+        return false;
+    }
+
+    entry = calloc(1, sizeof(*entry));
+    if (!entry) {
+        return false;
+    }
+    entry->image = image;
+    entry->state = zs_pending;
+
+    pthread_mutex_lock(&ctx.lock);
+
+    // replace the previous version of the image
+    while ((old = hashmap_get(&ctx.map, image->index)) &&
+           old->state == zs_busy) {
+        pthread_cond_wait(&ctx.signal, &ctx.lock);
+    }
+    if (old) {
+        remove_entry(old);
+        free_entry(old);
+    }
+
+    if (!hashmap_put(&ctx.map, image->index, entry)) {
+        pthread_mutex_unlock(&ctx.lock);
+        free(entry);
+        return false;
+    }
+    ctx.head = list_add(ctx.head, entry);
+    if (!ctx.tail) {
+        ctx.tail = entry;
+    }
+    pthread_cond_broadcast(&ctx.signal);
+
+    pthread_mutex_unlock(&ctx.lock);
+
+    return true;
+}
+
+struct image* zcache_take(size_t index)
+{
+    struct zentry* entry;
+    struct image* image;
+
+    if (!ctx.limit) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&ctx.lock);
+    while ((entry = hashmap_get(&ctx.map, index)) &&
+           entry->state == zs_busy) {
+        pthread_cond_wait(&ctx.signal, &ctx.lock);
+    }
+    if (entry) {
+        remove_entry(entry);
+    }
+    pthread_mutex_unlock(&ctx.lock);
+
+    if (!entry) {
+        return NULL;
+    }
+
+    image = entry->image;
+    if (entry->state == zs_ready && !restore(entry)) {
+        image_free(image);
+        image = NULL;
+    }
+    entry->image = NULL;
+    free_entry(entry);
+
+    return image;
+}
+
+bool zcache_has(size_t index)
+{
+    bool has = false;
+
+    if (ctx.limit) {
+        pthread_mutex_lock(&ctx.lock);
+        has = !!hashmap_get(&ctx.map, index);
+        pthread_mutex_unlock(&ctx.lock);
+    }
+
+    return has;
+}
+
+size_t zcache_size(void)
+{
+    size_t size = 0;
+
+    if (ctx.limit) {
+        pthread_mutex_lock(&ctx.lock);
+        size = ctx.used;
+        pthread_mutex_unlock(&ctx.lock);
+    }
+
+    return size;
+}
+
+void zcache_reset(void)
+{
+    if (ctx.limit) {
+        pthread_mutex_lock(&ctx.lock);
+        while (remove_all()) {
+            pthread_cond_wait(&ctx.signal, &ctx.lock);
+        }
+        pthread_mutex_unlock(&ctx.lock);
+    }
+}
+
+void zcache_shrink(size_t size)
+{
+    if (ctx.limit) {
+        size_t target;
+
+        pthread_mutex_lock(&ctx.lock);
+        target = ctx.used > size ? ctx.used - size : 0;
+        list_for_each_back(ctx.tail, struct zentry, it) {
+            // uncompressed frames of pending entries are the largest
+            if (it->state == zs_pending ||
+                (it->state == zs_ready && ctx.used > target)) {
+                remove_entry(it);
+                free_entry(it);
+            }
+        }
+        pthread_mutex_unlock(&ctx.lock);
+    }
+}
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: MIT
+// Compressed cache of previously viewed images.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include "image.h"
+
+/**
+ * Initialize compressed cache and start the compression thread.
+ * @param limit max size of compressed data in bytes, 0 to disable the cache
+ */
+void zcache_init(size_t limit);
+
+/**
+ * Stop the compression thread and free all cached images.
+ */
+void zcache_destroy(void);
+
+/**
+ * Put image to the cache, the pixel data is compressed in background.
+ * Only static images with a single frame can be cached.
+ * @param image image to put, the cache takes ownership on success
+ * @return false if image can not be cached
+ */
+bool zcache_put(struct image* image);
+
+/**
+ * Take out image from the cache and restore its pixel data.
+ * @param index index of the image in the image list
+ * @return image instance or NULL if image is not in cache
+ */
+struct image* zcache_take(size_t index);
+
+/**
+ * Check if image is in cache.
+ * @param index index of the image in the image list
+ * @return true if image is in cache
+ */
+bool zcache_has(size_t index);
+
+/**
+ * Get size of compressed data.
+ * @return size in bytes
+ */
+size_t zcache_size(void);
+
+/**
+ * Free all cached images.
+ */
+void zcache_reset(void);
+
+/**
+ * Release memory on pressure: images waiting for compression are freed,
+ * then the oldest compressed images until the specified amount is freed.
+ * @param size amount of compressed data to free in bytes
+ */
+void zcache_shrink(size_t size);
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "atlas.h"
+}
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+TEST(Atlas, AllocRelease)
+{
+    struct atlas atlas;
+    argb_t* a;
+    argb_t* b;
+
+    atlas_init(&atlas, 16);
+
+    a = atlas_alloc(&atlas);
+    b = atlas_alloc(&atlas);
+    ASSERT_TRUE(a);
+    ASSERT_TRUE(b);
+    EXPECT_EQ(b - a, 16);
+    EXPECT_EQ(atlas.used, 2U);
+
+    // released slot is reused
+    EXPECT_TRUE(atlas_release(&atlas, a));
+    EXPECT_EQ(atlas_alloc(&atlas), a);
+
+    // foreign pointer
+    argb_t foreign;
+    EXPECT_FALSE(atlas_release(&atlas, &foreign));
+
+    atlas_free(&atlas);
+    EXPECT_EQ(atlas.used, 0U);
+}
+
+TEST(Atlas, Slabs)
+{
+    struct atlas atlas;
+    std::vector<argb_t*> slots;
+
+    atlas_init(&atlas, 4);
+    for (size_t i = 0; i < atlas.slots * 3; ++i) {
+        argb_t* slot = atlas_alloc(&atlas);
+        ASSERT_TRUE(slot);
+        slot[0] = i;
+        slot[3] = i;
+        slots.push_back(slot);
+    }
+    EXPECT_EQ(atlas.used, slots.size());
+
+    // data is not overlapped
+    for (size_t i = 0; i < slots.size(); ++i) {
+        EXPECT_EQ(slots[i][0], i);
+        EXPECT_EQ(slots[i][3], i);
+    }
+
+    // empty slabs are freed
+    for (argb_t* slot : slots) {
+        EXPECT_TRUE(atlas_release(&atlas, slot));
+    }
+    EXPECT_EQ(atlas.used, 0U);
+    EXPECT_FALSE(atlas.slabs);
+
+    atlas_free(&atlas);
+}
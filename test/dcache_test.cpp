@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "dcache.h"
+}
+
+#include "tempdir.h"
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+class DCache : public TempDir {
+protected:
+    void SetUp() override
+    {
+        ASSERT_NO_FATAL_FAILURE(TempDir::SetUp());
+        setenv("XDG_CACHE_HOME", dir.c_str(), 1);
+        dcache_init(1024 * 1024);
+    }
+
+    void TearDown() override
+    {
+        dcache_destroy();
+        image_free(image);
+        image_free(cached);
+        unsetenv("XDG_CACHE_HOME");
+        TempDir::TearDown();
+    }
+
+    void Create(const char* source)
+    {
+        struct pixmap* pm;
+        image = image_alloc();
+        image_set_source(image, source);
+        image_set_format(image, "Test");
+        image_add_meta(image, "Key", "Value");
+        pm = image_allocate_frame(image, 16, 8);
+        for (size_t i = 0; i < 16 * 8; ++i) {
+            pm->data[i] = ARGB(0xff, i, i * 2, i * 3);
+        }
+        image->alpha = true;
+        image->orient = orient_transpose;
+        image->decode_time = 1000;
+    }
+
+    bool Load(const char* source)
+    {
+        struct stat st;
+        cached = image_alloc();
+        return stat(source, &st) == 0 && dcache_load(cached, source, &st);
+    }
+
+    struct image* image = nullptr;
+    struct image* cached = nullptr;
+};
+
+TEST_F(DCache, SaveLoad)
+{
+    const char* source = TEST_DATA_DIR "/image.bmp";
+
+    Create(source);
+    ASSERT_FALSE(Load(source));
+    image_free(cached);
+
+    dcache_save(image);
+    dcache_flush();
+    ASSERT_TRUE(Load(source));
+
+    ASSERT_EQ(cached->num_frames, 1U);
+    ASSERT_EQ(cached->frames[0].pm.width, 16U);
+    ASSERT_EQ(cached->frames[0].pm.height, 8U);
+    EXPECT_EQ(cached->frames[0].shm_fd, -1); // private mapping
+    EXPECT_EQ(memcmp(cached->frames[0].pm.data, image->frames[0].pm.data,
+                     16 * 8 * sizeof(argb_t)),
+              0);
+    EXPECT_STREQ(cached->format, "Test");
+    ASSERT_TRUE(cached->info);
+    EXPECT_STREQ(cached->info->key, "Key");
+    EXPECT_STREQ(cached->info->value, "Value");
+    EXPECT_TRUE(cached->alpha);
+    EXPECT_EQ(cached->orient, orient_transpose);
+}
+
+TEST_F(DCache, FastDecode)
+{
+    const char* source = TEST_DATA_DIR "/image.bmp";
+
+    Create(source);
+    image->decode_time = 0;
+    dcache_save(image);
+    dcache_flush();
+    EXPECT_FALSE(Load(source));
+}
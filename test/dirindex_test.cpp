@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "dirindex.h"
+}
+
+#include "tempdir.h"
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+
+class DirIndex : public TempDir {
+protected:
+    void SetUp() override
+    {
+        ASSERT_NO_FATAL_FAILURE(TempDir::SetUp());
+        setenv("XDG_CACHE_HOME", dir.c_str(), 1);
+    }
+
+    void TearDown() override
+    {
+        dirindex_free(&index);
+        unsetenv("XDG_CACHE_HOME");
+        TempDir::TearDown();
+    }
+
+    struct dirindex index = {};
+};
+
+TEST_F(DirIndex, SaveLoad)
+{
+    struct dirindex_dir dirs[] = {
+        { "/root", { 1, 2 }, DIRINDEX_ROOT },
+        { "/root/sub", { 3, 4 }, 0 },
+    };
+    struct dirindex_file files[] = {
+        { "/root/sub/b", 1, 10, 100 },
+        { "/root/a", 0, 20, 200 },
+    };
+    const struct dirindex src = { dirs, 2, files, 2, 42, nullptr, 0 };
+
+    ASSERT_FALSE(dirindex_load(&index, "/root"));
+    ASSERT_TRUE(dirindex_save(&src));
+    ASSERT_FALSE(dirindex_load(&index, "/another"));
+    ASSERT_TRUE(dirindex_load(&index, "/root"));
+
+    EXPECT_EQ(index.flags, 42U);
+    ASSERT_EQ(index.num_dirs, 2U);
+    EXPECT_STREQ(index.dirs[1].path, "/root/sub");
+    EXPECT_EQ(index.dirs[1].mtime.tv_sec, 3);
+    EXPECT_EQ(index.dirs[1].mtime.tv_nsec, 4);
+    EXPECT_EQ(index.dirs[1].parent, 0U);
+    EXPECT_EQ(index.dirs[0].parent, static_cast<size_t>(DIRINDEX_ROOT));
+    ASSERT_EQ(index.num_files, 2U);
+    EXPECT_STREQ(index.files[0].path, "/root/sub/b");
+    EXPECT_EQ(index.files[0].dir, 1U);
+    EXPECT_STREQ(index.files[1].path, "/root/a");
+    EXPECT_EQ(index.files[1].mtime, 20);
+    EXPECT_EQ(index.files[1].size, 200U);
+}
+
+TEST_F(DirIndex, Corrupted)
+{
+    struct dirindex_dir dirs[] = { { "/root", { 1, 2 }, DIRINDEX_ROOT } };
+    const struct dirindex src = { dirs, 1, nullptr, 0, 0, nullptr, 0 };
+
+    ASSERT_TRUE(dirindex_save(&src));
+    const std::string cmd =
+        "truncate -s -1 " + dir + "/swayimg/index/*.idx";
+    ASSERT_EQ(system(cmd.c_str()), 0);
+    EXPECT_FALSE(dirindex_load(&index, "/root"));
+}
@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "event.h"
+}
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+class EventRing : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        ring = new struct event_ring;
+        event_ring_init(ring);
+    }
+
+    void TearDown() override { delete ring; }
+
+    static struct event Load(size_t index)
+    {
+        struct event event;
+        memset(&event, 0, sizeof(event));
+        event.type = event_load;
+        event.param.load.index = index;
+        return event;
+    }
+
+    struct event_ring* ring;
+};
+
+TEST_F(EventRing, PushPop)
+{
+    struct event event;
+
+    EXPECT_FALSE(event_ring_pop(ring, &event));
+
+    // the ring is reused many times
+    for (size_t i = 0; i < EVENT_RING_SIZE * 3; ++i) {
+        event = Load(i);
+        ASSERT_TRUE(event_ring_push(ring, &event));
+        event = Load(i + 1);
+        ASSERT_TRUE(event_ring_push(ring, &event));
+        ASSERT_TRUE(event_ring_pop(ring, &event));
+        EXPECT_EQ(event.param.load.index, i);
+        ASSERT_TRUE(event_ring_pop(ring, &event));
+        EXPECT_EQ(event.param.load.index, i + 1);
+    }
+
+    EXPECT_FALSE(event_ring_pop(ring, &event));
+}
+
+TEST_F(EventRing, Full)
+{
+    struct event event;
+
+    for (size_t i = 0; i < EVENT_RING_SIZE; ++i) {
+        event = Load(i);
+        ASSERT_TRUE(event_ring_push(ring, &event));
+    }
+    EXPECT_FALSE(event_ring_push(ring, &event));
+
+    ASSERT_TRUE(event_ring_pop(ring, &event));
+    EXPECT_EQ(event.param.load.index, 0U);
+    EXPECT_TRUE(event_ring_push(ring, &event));
+}
+
+TEST_F(EventRing, Pending)
+{
+    struct event event = Load(1);
+
+    EXPECT_TRUE(event_ring_empty(ring));
+    ASSERT_TRUE(event_ring_push(ring, &event));
+    EXPECT_FALSE(event_ring_empty(ring));
+    ASSERT_TRUE(event_ring_pop(ring, &event));
+    EXPECT_TRUE(event_ring_empty(ring));
+
+    // slot is taken by producer, but the event is not published yet
+    ++ring->head;
+    EXPECT_FALSE(event_ring_pop(ring, &event));
+    EXPECT_FALSE(event_ring_empty(ring));
+}
+
+TEST_F(EventRing, Remove)
+{
+    struct event event;
+    size_t removed = 0;
+
+    for (size_t i = 0; i < 4; ++i) {
+        event = Load(i);
+        ASSERT_TRUE(event_ring_push(ring, &event));
+        event.type = event_redraw;
+        ASSERT_TRUE(event_ring_push(ring, &event));
+    }
+
+    event_ring_remove(ring, event_load, nullptr);
+
+    while (event_ring_pop(ring, &event)) {
+        EXPECT_EQ(event.type, event_redraw);
+        ++removed;
+    }
+    EXPECT_EQ(removed, 4U);
+}
+
+TEST_F(EventRing, Producers)
+{
+    const size_t producers = 4;
+    const size_t events = 10000;
+    std::vector<std::thread> threads;
+    std::vector<size_t> next(producers, 0);
+    size_t received = 0;
+    struct event event;
+
+    for (size_t i = 0; i < producers; ++i) {
+        threads.emplace_back([this, i, events]() {
+            for (size_t j = 0; j < events; ++j) {
+                struct event event = Load(j);
+                event.param.load.image =
+                    reinterpret_cast<struct image*>(i + 1);
+                while (!event_ring_push(ring, &event)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    // events of each producer come in order
+    while (received < producers * events) {
+        if (event_ring_pop(ring, &event)) {
+            const size_t producer =
+                reinterpret_cast<size_t>(event.param.load.image) - 1;
+            ASSERT_LT(producer, producers);
+            EXPECT_EQ(event.param.load.index, next[producer]++);
+            ++received;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    for (auto& it : threads) {
+        it.join();
+    }
+    EXPECT_FALSE(event_ring_pop(ring, &event));
+}
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "execcache.h"
+}
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+class ExecCache : public ::testing::Test {
+protected:
+    void TearDown() override { execcache_destroy(); }
+
+    static std::string Get(const char* cmd)
+    {
+        std::string out;
+        size_t size;
+        void* data;
+        int fd;
+
+        if (!execcache_get(cmd, &fd, &size)) {
+            return "<none>";
+        }
+        data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            return "<error>";
+        }
+        out.assign(static_cast<const char*>(data), size);
+        munmap(data, size);
+        return out;
+    }
+
+    static void Put(const char* cmd, const char* data)
+    {
+        execcache_put(cmd, reinterpret_cast<const uint8_t*>(data),
+                      strlen(data));
+    }
+};
+
+TEST_F(ExecCache, Disabled)
+{
+    execcache_init(0, 0);
+    Put("cmd", "data");
+    EXPECT_EQ(Get("cmd"), "<none>");
+}
+
+TEST_F(ExecCache, GetPut)
+{
+    execcache_init(1024, 0);
+    EXPECT_EQ(Get("cmd1"), "<none>");
+
+    Put("cmd1", "data1");
+    Put("cmd2", "data2");
+    EXPECT_EQ(Get("cmd1"), "data1");
+    EXPECT_EQ(Get("cmd2"), "data2");
+
+    Put("cmd1", "new data");
+    EXPECT_EQ(Get("cmd1"), "new data");
+}
+
+TEST_F(ExecCache, Limit)
+{
+    execcache_init(10, 0);
+
+    Put("cmd1", "1234");
+    Put("cmd2", "5678");
+    EXPECT_EQ(Get("cmd1"), "1234"); // cmd2 is the least recently used now
+    Put("cmd3", "9012");
+    EXPECT_EQ(Get("cmd1"), "1234");
+    EXPECT_EQ(Get("cmd2"), "<none>");
+    EXPECT_EQ(Get("cmd3"), "9012");
+
+    Put("cmd4", "too large data");
+    EXPECT_EQ(Get("cmd4"), "<none>");
+}
@@ -23,6 +23,13 @@ TEST_F(Exif, Read)
                                     (std::istreambuf_iterator<char>()));
 
     process_exif(image, data.data(), data.size());
+    EXPECT_FALSE(image->info);
+    ASSERT_TRUE(image->exif);
+
+    // meta info is parsed on demand
+    ASSERT_TRUE(exif_load_meta(image));
+    EXPECT_FALSE(image->exif);
+    EXPECT_FALSE(exif_load_meta(image));
 
     ASSERT_EQ(list_size(&image->info->list), static_cast<size_t>(7));
 
@@ -76,4 +83,22 @@ TEST_F(Exif, Fail)
 
     process_exif(image, reinterpret_cast<const uint8_t*>("abcd"), 4);
     EXPECT_EQ(list_size(&image->info->list), static_cast<size_t>(0));
+    EXPECT_FALSE(image->exif);
+    EXPECT_FALSE(exif_load_meta(image));
+}
+
+TEST_F(Exif, Orientation)
+{
+    // JPEG with APP1 segment that contains only orientation tag (6, rotate)
+    const uint8_t data[] = {
+        0xff, 0xd8, 0xff, 0xe1, 0x00, 0x22, 'E',  'x',  'i',  'f',
+        0x00, 0x00, 'M',  'M',  0x00, 0x2a, 0x00, 0x00, 0x00, 0x08,
+        0x00, 0x01, 0x01, 0x12, 0x00, 0x03, 0x00, 0x00, 0x00, 0x01,
+        0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xda,
+    };
+
+    process_exif(image, data, sizeof(data));
+    EXPECT_EQ(image->orient, orient_transpose | orient_flip_x);
+    ASSERT_TRUE(image->exif);
+    EXPECT_EQ(image->exif_size, static_cast<size_t>(32));
 }
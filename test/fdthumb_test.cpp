@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "fdthumb.h"
+}
+
+#include "tempdir.h"
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+class FdThumb : public TempDir {
+protected:
+    void SetUp() override
+    {
+        ASSERT_NO_FATAL_FAILURE(TempDir::SetUp());
+        setenv("XDG_CACHE_HOME", dir.c_str(), 1);
+        memset(&st, 0, sizeof(st));
+        st.st_mtime = 1234567890;
+        st.st_size = 42;
+    }
+
+    void TearDown() override
+    {
+        image_free(image);
+        unsetenv("XDG_CACHE_HOME");
+        TempDir::TearDown();
+    }
+
+    bool Save(const char* source)
+    {
+        struct pixmap pm;
+        bool rc;
+        if (!pixmap_create(&pm, 100, 50)) {
+            return false;
+        }
+        for (size_t i = 0; i < 100 * 50; ++i) {
+            pm.data[i] = ARGB(0xff, i, i * 2, i * 3);
+        }
+        rc = fdthumb_save(&pm, source, &st, 1000, 500);
+        pixmap_free(&pm);
+        return rc;
+    }
+
+    bool Exists(const char* path)
+    {
+        const std::string full = dir + "/thumbnails/" + path;
+        return access(full.c_str(), F_OK) == 0;
+    }
+
+    struct stat st;
+    struct image* image = nullptr;
+};
+
+TEST_F(FdThumb, SaveLoad)
+{
+    // example from the specification
+    const char* source = "/home/jens/photos/me.png";
+
+    ASSERT_FALSE(fdthumb_load(source, &st, 100));
+    ASSERT_TRUE(Save(source));
+    EXPECT_TRUE(Exists("normal/c6ee772d9e49320e97ec29a7eb5b1697.png"));
+
+    image = fdthumb_load(source, &st, 100);
+    ASSERT_TRUE(image);
+    EXPECT_STREQ(image->source, source);
+    EXPECT_FALSE(image->info);
+    ASSERT_EQ(image->num_frames, 1U);
+    EXPECT_EQ(image->frames[0].pm.width, 100U);
+    EXPECT_EQ(image->frames[0].pm.height, 50U);
+    EXPECT_EQ(image->frames[0].pm.data[1], ARGB(0xff, 1, 2, 3));
+    EXPECT_EQ(image->full_width, 1000U);
+    EXPECT_EQ(image->full_height, 500U);
+
+    // thumbnail is too small
+    EXPECT_FALSE(fdthumb_load(source, &st, 200));
+
+    // file was changed
+    st.st_mtime += 1;
+    EXPECT_FALSE(fdthumb_load(source, &st, 100));
+}
+
+TEST_F(FdThumb, Uri)
+{
+    ASSERT_TRUE(Save("/tmp/a b#.png"));
+    EXPECT_TRUE(Exists("normal/0a9bf79a86f34bb3d182682c8f1b0e3c.png"));
+    EXPECT_FALSE(Save("relative.png"));
+}
+
+TEST_F(FdThumb, Size)
+{
+    EXPECT_EQ(fdthumb_size(100), 128U);
+    EXPECT_EQ(fdthumb_size(200), 256U);
+    EXPECT_EQ(fdthumb_size(1024), 1024U);
+    EXPECT_EQ(fdthumb_size(2000), 0U);
+}
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "hashmap.h"
+}
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+TEST(HashMap, Empty)
+{
+    struct hashmap map = {};
+
+    EXPECT_EQ(hashmap_get(&map, 0), nullptr);
+    EXPECT_EQ(hashmap_remove(&map, 0), nullptr);
+
+    hashmap_free(&map);
+}
+
+TEST(HashMap, PutGet)
+{
+    struct hashmap map = {};
+    int a, b;
+
+    ASSERT_TRUE(hashmap_put(&map, 1, &a));
+    ASSERT_TRUE(hashmap_put(&map, 2, &b));
+    EXPECT_EQ(map.size, 2U);
+    EXPECT_EQ(hashmap_get(&map, 1), &a);
+    EXPECT_EQ(hashmap_get(&map, 2), &b);
+    EXPECT_EQ(hashmap_get(&map, 3), nullptr);
+
+    // replace
+    ASSERT_TRUE(hashmap_put(&map, 1, &b));
+    EXPECT_EQ(map.size, 2U);
+    EXPECT_EQ(hashmap_get(&map, 1), &b);
+
+    hashmap_free(&map);
+}
+
+TEST(HashMap, Remove)
+{
+    const size_t num = 1000;
+    std::vector<size_t> values(num);
+    struct hashmap map = {};
+
+    for (size_t i = 0; i < num; ++i) {
+        ASSERT_TRUE(hashmap_put(&map, i * 16, &values[i]));
+    }
+    EXPECT_EQ(map.size, num);
+
+    // remove even entries, the rest must be reachable
+    for (size_t i = 0; i < num; i += 2) {
+        EXPECT_EQ(hashmap_remove(&map, i * 16), &values[i]);
+    }
+    EXPECT_EQ(map.size, num / 2);
+    for (size_t i = 0; i < num; ++i) {
+        EXPECT_EQ(hashmap_get(&map, i * 16), i % 2 ? &values[i] : nullptr);
+    }
+
+    hashmap_free(&map);
+}
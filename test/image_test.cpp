@@ -2,11 +2,16 @@
 // Copyright (C) 2024 Artem Senichev <artemsen@gmail.com>
 
 extern "C" {
+#include "animation.h"
+#include "grayscale.h"
 #include "image.h"
+#include "tiles.h"
 }
 
 #include <gtest/gtest.h>
 
+#include <unistd.h>
+
 class Image : public ::testing::Test {
 protected:
     void SetUp() override
@@ -66,3 +71,419 @@ TEST_F(Image, SetSourceExec)
     EXPECT_STREQ(image->name, src);
     EXPECT_STREQ(image->parent_dir, "");
 }
+
+TEST_F(Image, Generation)
+{
+    const size_t generation = image->generation;
+
+    // reused allocation is still distinguished from the freed instance
+    image_free(image);
+    image = image_alloc();
+    ASSERT_TRUE(image);
+    EXPECT_NE(image->generation, generation);
+}
+
+TEST_F(Image, Mipmap)
+{
+    struct pixmap* pm = image_allocate_frame(image, 300, 200);
+    ASSERT_TRUE(pm);
+
+    // 150x100 and 75x50, but the latter is too small
+    EXPECT_TRUE(image_create_mipmap(image, SIZE_MAX));
+    ASSERT_EQ(image->frames[0].mipmap_levels, static_cast<size_t>(1));
+    EXPECT_EQ(image->frames[0].mipmap[0].width, static_cast<size_t>(150));
+    EXPECT_EQ(image->frames[0].mipmap[0].height, static_cast<size_t>(100));
+
+    // rotation doesn't change pixel data
+    image_rotate(image, 90);
+    EXPECT_NE(image->frames[0].mipmap, nullptr);
+    image_apply_orient(image);
+    EXPECT_EQ(image->frames[0].mipmap, nullptr);
+    EXPECT_EQ(image->frames[0].mipmap_levels, static_cast<size_t>(0));
+
+    // limit is less than the first level size
+    EXPECT_FALSE(image_create_mipmap(image, 1024));
+    EXPECT_EQ(image->frames[0].mipmap, nullptr);
+}
+
+TEST_F(Image, MipmapBackground)
+{
+    struct pixmap* pm = image_allocate_frame(image, 300, 200);
+    ASSERT_TRUE(pm);
+
+    // the first request starts creating in background
+    EXPECT_FALSE(image_build_mipmap(image, SIZE_MAX));
+    while (!image_build_mipmap(image, SIZE_MAX)) {
+        usleep(1000);
+    }
+    EXPECT_EQ(image->frames[0].mipmap, nullptr);
+
+    image_attach_mipmap(image);
+    ASSERT_EQ(image->frames[0].mipmap_levels, static_cast<size_t>(1));
+    EXPECT_EQ(image->frames[0].mipmap[0].width, static_cast<size_t>(150));
+    EXPECT_EQ(image->frames[0].mipmap[0].height, static_cast<size_t>(100));
+
+    // attached once
+    EXPECT_FALSE(image_build_mipmap(image, SIZE_MAX));
+
+    // pending request is cancelled
+    image_free_mipmap(image);
+    EXPECT_FALSE(image_build_mipmap(image, SIZE_MAX));
+    image_free_mipmap(image);
+    EXPECT_EQ(image->frames[0].mipmap, nullptr);
+}
+
+TEST_F(Image, Orient)
+{
+    struct pixmap expect;
+    struct pixmap* pm = image_allocate_frame(image, 3, 2);
+    ASSERT_TRUE(pm);
+    ASSERT_TRUE(pixmap_create(&expect, 3, 2));
+    for (size_t i = 0; i < 6; ++i) {
+        pm->data[i] = expect.data[i] = i;
+    }
+
+    // the same sequence as for EXIF orientation 7
+    image_flip_vertical(image);
+    image_rotate(image, 270);
+    pixmap_flip_vertical(&expect);
+    pixmap_rotate(&expect, 270);
+
+    // and some more transforms
+    image_rotate(image, 90);
+    image_flip_horizontal(image);
+    image_rotate(image, 180);
+    pixmap_rotate(&expect, 90);
+    pixmap_flip_horizontal(&expect);
+    pixmap_rotate(&expect, 180);
+
+    EXPECT_EQ(pm->width, static_cast<size_t>(3));
+    EXPECT_EQ(image_get_width(image), expect.width);
+    EXPECT_EQ(image_get_height(image), expect.height);
+
+    image_apply_orient(image);
+    EXPECT_EQ(image->orient, orient_normal);
+    ASSERT_EQ(pm->width, expect.width);
+    ASSERT_EQ(pm->height, expect.height);
+    for (size_t i = 0; i < 6; ++i) {
+        EXPECT_EQ(pm->data[i], expect.data[i]) << i;
+    }
+
+    pixmap_free(&expect);
+}
+
+TEST_F(Image, SharedFrame)
+{
+    image->shared = true;
+    struct pixmap* pm = image_allocate_frame(image, 3, 2);
+    ASSERT_TRUE(pm);
+    EXPECT_EQ(image->frames[0].shm_size, 3 * 2 * sizeof(argb_t));
+    for (size_t i = 0; i < 6; ++i) {
+        EXPECT_EQ(pm->data[i], static_cast<argb_t>(0));
+        pm->data[i] = i;
+    }
+
+    // transformation moves pixel data to the heap
+    image_rotate(image, 90);
+    image_apply_orient(image);
+    EXPECT_EQ(image->frames[0].shm_size, static_cast<size_t>(0));
+    ASSERT_EQ(pm->width, static_cast<size_t>(2));
+    ASSERT_EQ(pm->height, static_cast<size_t>(3));
+    EXPECT_EQ(pm->data[0], static_cast<argb_t>(3));
+    EXPECT_EQ(pm->data[1], static_cast<argb_t>(0));
+}
+
+TEST_F(Image, HintScale)
+{
+    EXPECT_EQ(image_hint_scale(image, 1000, 500), 1.0);
+    image->size_hint = 200;
+    EXPECT_EQ(image_hint_scale(image, 1000, 500), 0.4);
+    EXPECT_EQ(image_hint_scale(image, 100, 500), 1.0);
+    EXPECT_EQ(image_hint_scale(image, 200, 200), 1.0);
+}
+
+TEST_F(Image, Animation)
+{
+    // each frame is filled with its index
+    static size_t next;
+    static bool freed;
+    next = 0;
+    freed = false;
+    const struct anim_decoder decoder = {
+        .decode = [](void*, struct pixmap* pm, size_t* duration) {
+            for (size_t i = 0; i < pm->width * pm->height; ++i) {
+                pm->data[i] = next;
+            }
+            *duration = 10 + next;
+            next = (next + 1) % 10;
+            return true;
+        },
+        .seek = [](void*, size_t index) {
+            next = index;
+            return true;
+        },
+        .free = [](void*) { freed = true; },
+        .data = nullptr,
+    };
+
+    EXPECT_FALSE(animation_lazy(image, 4, 4, 1));
+    EXPECT_FALSE(animation_lazy(image, 4, 4, 10));
+    EXPECT_TRUE(animation_lazy(image, 10000, 10000, 10));
+
+    ASSERT_TRUE(animation_create(image, 4, 4, 10, &decoder));
+    ASSERT_TRUE(image->anim);
+    ASSERT_EQ(image->num_frames, 1U);
+    EXPECT_EQ(animation_frames(image), 10U);
+    EXPECT_EQ(animation_index(image), 0U);
+    EXPECT_EQ(image->frames[0].pm.data[0], 0U);
+    EXPECT_EQ(image->frames[0].duration, 10U);
+
+    for (size_t i = 1; i < 25; ++i) {
+        while (!animation_next(image)) { }
+        EXPECT_EQ(animation_index(image), i % 10);
+        EXPECT_EQ(image->frames[0].pm.data[15], i % 10);
+        EXPECT_EQ(image->frames[0].duration, 10 + i % 10);
+        EXPECT_TRUE(image->frames[0].partial);
+        EXPECT_EQ(image->frames[0].changed.width, 4U);
+        EXPECT_EQ(image->frames[0].changed.height, 4U);
+    }
+
+    ASSERT_TRUE(animation_seek(image, 2));
+    EXPECT_EQ(animation_index(image), 2U);
+    EXPECT_EQ(image->frames[0].pm.data[0], 2U);
+    EXPECT_FALSE(image->frames[0].partial);
+    while (!animation_next(image)) { }
+    EXPECT_EQ(animation_index(image), 3U);
+    EXPECT_EQ(image->frames[0].pm.data[0], 3U);
+    EXPECT_FALSE(animation_seek(image, 10));
+
+    animation_free(image);
+    EXPECT_FALSE(image->anim);
+    EXPECT_TRUE(freed);
+    EXPECT_EQ(image->frames[0].pm.data[0], 3U);
+}
+
+TEST_F(Image, AnimationOrient)
+{
+    // pixels of each frame are filled with frame index and pixel position
+    static size_t next;
+    next = 0;
+    const struct anim_decoder decoder = {
+        .decode = [](void*, struct pixmap* pm, size_t* duration) {
+            for (size_t i = 0; i < pm->width * pm->height; ++i) {
+                pm->data[i] = next * 10 + i;
+            }
+            *duration = 10;
+            next = (next + 1) % 10;
+            return true;
+        },
+        .seek = nullptr,
+        .free = [](void*) {},
+        .data = nullptr,
+    };
+
+    ASSERT_TRUE(animation_create(image, 2, 1, 10, &decoder));
+    ASSERT_TRUE(image->anim);
+
+    // animation keeps playing with rotated frames
+    image_rotate(image, 90);
+    image_apply_orient(image);
+    ASSERT_TRUE(image->anim);
+    const struct pixmap* pm = &image->frames[0].pm;
+    ASSERT_EQ(pm->width, 1U);
+    ASSERT_EQ(pm->height, 2U);
+    const argb_t top = pm->data[0];
+    const argb_t bottom = pm->data[1];
+    for (size_t i = 1; i < 12; ++i) {
+        while (!animation_next(image)) { }
+        ASSERT_EQ(pm->width, 1U);
+        ASSERT_EQ(pm->height, 2U);
+        EXPECT_EQ(pm->data[0], (i % 10) * 10 + top);
+        EXPECT_EQ(pm->data[1], (i % 10) * 10 + bottom);
+    }
+
+    // transforms are combined
+    image_rotate(image, 90);
+    image_apply_orient(image);
+    for (size_t i = 12; i < 24; ++i) {
+        while (!animation_next(image)) { }
+        ASSERT_EQ(pm->width, 2U);
+        ASSERT_EQ(pm->height, 1U);
+        EXPECT_EQ(pm->data[0], (i % 10) * 10 + 1);
+        EXPECT_EQ(pm->data[1], (i % 10) * 10);
+    }
+}
+
+TEST_F(Image, AnimationThumbnail)
+{
+    static bool freed;
+    freed = false;
+    const struct anim_decoder decoder = {
+        .decode = [](void*, struct pixmap*, size_t* duration) {
+            *duration = 10;
+            return true;
+        },
+        .seek = nullptr,
+        .free = [](void*) { freed = true; },
+        .data = nullptr,
+    };
+
+    image->size_hint = 100;
+    EXPECT_TRUE(animation_lazy(image, 4, 4, 2));
+    ASSERT_TRUE(animation_create(image, 4, 4, 2, &decoder));
+    EXPECT_FALSE(image->anim);
+    EXPECT_TRUE(freed);
+    EXPECT_EQ(image->num_frames, 1U);
+}
+
+TEST_F(Image, Threads)
+{
+    const bool cancel = false;
+    EXPECT_GE(image_threads(image), 1U);
+    image->cancel = &cancel;
+    EXPECT_EQ(image_threads(image), 1U);
+    image->cancel = nullptr;
+}
+
+/**
+ * Draw tiled image when all visible tiles are decoded in background.
+ */
+static void DrawTiles(struct image* image, struct pixmap* pm, ssize_t x,
+                      ssize_t y, double scale)
+{
+    while (!tiles_draw(image, aa_nearest, pm, x, y, scale)) {
+        usleep(1000);
+    }
+}
+
+TEST_F(Image, Tiles)
+{
+    // each pixel is filled with level and tile position
+    struct tiles_source source = {
+        .decode = [](void*, size_t level, size_t col, size_t row,
+                     struct pixmap* pm) {
+            const argb_t color = ARGB(0xff, level, col, row);
+            for (size_t i = 0; i < pm->width * pm->height; ++i) {
+                pm->data[i] = color;
+            }
+            return true;
+        },
+        .free = [](void*) {},
+        .data = nullptr,
+        .levels = { { 5000, 3000, 256, 256 } },
+        .num_levels = 1,
+    };
+    struct pixmap pm;
+
+    EXPECT_FALSE(tiles_lazy(4096, 4096));
+    EXPECT_TRUE(tiles_lazy(40000, 40000));
+
+    ASSERT_TRUE(tiles_create(image, &source));
+    ASSERT_TRUE(image->tiles);
+    ASSERT_EQ(image->num_frames, 1U);
+    EXPECT_LE(image->frames[0].pm.width, 2048U);
+    EXPECT_EQ(image_get_width(image), 5000U);
+    EXPECT_EQ(image_get_height(image), 3000U);
+
+    ASSERT_TRUE(pixmap_create(&pm, 100, 100));
+
+    // full size, tiles are not decoded yet
+    EXPECT_FALSE(tiles_draw(image, aa_nearest, &pm, -300, -600, 1.0));
+    DrawTiles(image, &pm, -300, -600, 1.0);
+    EXPECT_EQ(pm.data[0], ARGB(0xff, 0, 1, 2));
+    EXPECT_EQ(pm.data[99 * 100 + 99], ARGB(0xff, 0, 1, 2));
+
+    // virtual level, 2x reduced
+    DrawTiles(image, &pm, -300, -600, 0.5);
+    EXPECT_EQ(pm.data[0], ARGB(0xff, 0, 2, 4));
+
+    // tiles are transformed to the displayed orientation
+    image->orient = orient_flip_y;
+    DrawTiles(image, &pm, -300, -600, 1.0);
+    EXPECT_EQ(pm.data[0], ARGB(0xff, 0, 1, 9));
+    EXPECT_EQ(pm.data[99 * 100 + 99], ARGB(0xff, 0, 1, 8));
+    image->orient =
+        static_cast<enum pixmap_orient>(orient_transpose | orient_flip_x);
+    DrawTiles(image, &pm, -300, -600, 1.0);
+    EXPECT_EQ(pm.data[0], ARGB(0xff, 0, 2, 10));
+    EXPECT_EQ(pm.data[99 * 100 + 99], ARGB(0xff, 0, 2, 10));
+    image->orient = orient_normal;
+
+    pixmap_free(&pm);
+
+    tiles_free(image);
+    EXPECT_FALSE(image->tiles);
+    EXPECT_EQ(image_get_width(image), image->frames[0].pm.width);
+}
+
+TEST_F(Image, Render)
+{
+    static bool freed;
+    struct pixmap pm;
+
+    ASSERT_TRUE(image_allocate_frame(image, 10, 10));
+    ASSERT_TRUE(pixmap_create(&pm, 4, 4));
+
+    // no renderer
+    EXPECT_FALSE(image_render(image, &pm, 0, 0, 1.0));
+
+    // renderer fills pixel with the position of the document
+    freed = false;
+    image->vector.render = [](void*, struct pixmap* pm, ssize_t x, ssize_t y,
+                              double) {
+        pm->data[0] = ARGB(0xff, 0, x, y);
+        return true;
+    };
+    image->vector.free = [](void*) { freed = true; };
+
+    EXPECT_TRUE(image_render(image, &pm, -5, -6, 2.0));
+    EXPECT_EQ(pm.data[0], ARGB(0xff, 0, 0xfb, 0xfa));
+
+    // partially visible
+    EXPECT_TRUE(image_render(image, &pm, 2, 1, 1.0));
+    EXPECT_EQ(pm.data[1 * 4 + 2], ARGB(0xff, 0, 0, 0));
+
+    pixmap_free(&pm);
+
+    image_free_frames(image);
+    EXPECT_TRUE(freed);
+    EXPECT_FALSE(image->vector.render);
+}
+
+TEST_F(Image, Grayscale)
+{
+    const int16_t samples[] = { -100, 0, 100, 200 };
+    ssize_t center, width;
+
+    ASSERT_TRUE(grayscale_create(image, samples, 2, 2, -100, 200));
+    ASSERT_TRUE(image->gray);
+    ASSERT_EQ(image->num_frames, 1U);
+    const argb_t* data = image->frames[0].pm.data;
+    EXPECT_EQ(data[0], ARGB(0xff, 0, 0, 0));
+    EXPECT_EQ(data[2], ARGB(0xff, 170, 170, 170));
+    EXPECT_EQ(data[3], ARGB(0xff, 0xff, 0xff, 0xff));
+
+    grayscale_window(image, &center, &width);
+    EXPECT_EQ(center, 50);
+    EXPECT_EQ(width, 300);
+
+    // narrow window, only the first row is updated
+    grayscale_adjust(image, -50, -200);
+    grayscale_window(image, &center, &width);
+    EXPECT_EQ(center, 0);
+    EXPECT_EQ(width, 100);
+    grayscale_update(image, 0, 0, 2, 1);
+    EXPECT_EQ(data[0], ARGB(0xff, 0, 0, 0));
+    EXPECT_EQ(data[1], ARGB(0xff, 127, 127, 127));
+    EXPECT_EQ(data[2], ARGB(0xff, 170, 170, 170));
+
+    grayscale_update(image, 0, 0, SIZE_MAX, SIZE_MAX);
+    EXPECT_EQ(data[2], ARGB(0xff, 0xff, 0xff, 0xff));
+
+    grayscale_reset(image);
+    grayscale_update(image, 0, 0, SIZE_MAX, SIZE_MAX);
+    EXPECT_EQ(data[1], ARGB(0xff, 85, 85, 85));
+
+    image_free_frames(image);
+    EXPECT_FALSE(image->gray);
+}
@@ -2,15 +2,23 @@
 // Copyright (C) 2024 Artem Senichev <artemsen@gmail.com>
 
 extern "C" {
+#include "buildcfg.h"
 #include "imagelist.h"
+#include "tpool.h"
 }
 
+#include "tempdir.h"
+
 #include <gtest/gtest.h>
 
-class ImageList : public ::testing::Test {
+#include <unistd.h>
+#include <vector>
+
+class ImageList : public TempDir {
 protected:
     void SetUp() override
     {
+        ASSERT_NO_FATAL_FAILURE(TempDir::SetUp());
         unsetenv("XDG_CONFIG_HOME");
         unsetenv("XDG_CONFIG_DIRS");
         unsetenv("HOME");
@@ -22,6 +30,8 @@ protected:
     {
         image_list_destroy();
         config_free(config);
+        unsetenv("XDG_CACHE_HOME");
+        TempDir::TearDown();
     }
 
     struct config* config;
@@ -48,6 +58,94 @@ TEST_F(ImageList, Find)
     ASSERT_EQ(idx, static_cast<size_t>(1));
 }
 
+TEST_F(ImageList, Duplicates)
+{
+    image_list_init(config);
+    for (size_t i = 0; i < 1000; ++i) {
+        const std::string src = "exec://cmd" + std::to_string(i % 100);
+        image_list_add(src.c_str());
+    }
+    ASSERT_EQ(image_list_size(), static_cast<size_t>(100));
+    for (size_t i = 0; i < 100; ++i) {
+        const std::string src = "exec://cmd" + std::to_string(i);
+        ASSERT_EQ(image_list_find(src.c_str()), i);
+    }
+    image_list_skip(42);
+    EXPECT_EQ(image_list_find("exec://cmd42"),
+              static_cast<size_t>(IMGLIST_INVALID));
+    EXPECT_EQ(image_list_find("exec://cmd43"), static_cast<size_t>(43));
+}
+
+TEST_F(ImageList, Enqueue)
+{
+    image_list_init(config);
+    image_list_add("exec://cmd2");
+    image_list_add("exec://cmd3");
+    image_list_reorder();
+    EXPECT_FALSE(image_list_merge());
+
+    image_list_enqueue("exec://cmd1", nullptr);
+    image_list_enqueue("exec://cmd3", nullptr);
+    EXPECT_EQ(image_list_size(), static_cast<size_t>(2));
+
+    ASSERT_TRUE(image_list_merge());
+    ASSERT_EQ(image_list_size(), static_cast<size_t>(3));
+    EXPECT_EQ(image_list_find("exec://cmd1"), static_cast<size_t>(0));
+    EXPECT_EQ(image_list_remap(0), static_cast<size_t>(1));
+    EXPECT_EQ(image_list_remap(1), static_cast<size_t>(2));
+    EXPECT_FALSE(image_list_merge());
+}
+
+TEST_F(ImageList, MergeOrdered)
+{
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_ORDER, "numeric"));
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_REVERSE, "yes"));
+    image_list_init(config);
+    image_list_add("exec://f2");
+    image_list_add("exec://f10");
+    image_list_reorder();
+    EXPECT_EQ(image_list_find("exec://f10"), static_cast<size_t>(0));
+
+    image_list_enqueue("exec://f1", nullptr);
+    image_list_enqueue("exec://f11", nullptr);
+    image_list_enqueue("exec://f3", nullptr);
+    ASSERT_TRUE(image_list_merge());
+    ASSERT_EQ(image_list_size(), static_cast<size_t>(5));
+    EXPECT_STREQ(image_list_get(0), "exec://f11");
+    EXPECT_STREQ(image_list_get(1), "exec://f10");
+    EXPECT_STREQ(image_list_get(2), "exec://f3");
+    EXPECT_STREQ(image_list_get(3), "exec://f2");
+    EXPECT_STREQ(image_list_get(4), "exec://f1");
+    EXPECT_EQ(image_list_remap(0), static_cast<size_t>(1));
+    EXPECT_EQ(image_list_remap(1), static_cast<size_t>(3));
+}
+
+TEST_F(ImageList, MergeRandom)
+{
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_ORDER, "random"));
+    image_list_init(config);
+    for (size_t i = 0; i < 100; ++i) {
+        image_list_add(("exec://cmd" + std::to_string(i)).c_str());
+    }
+    image_list_reorder();
+    for (size_t i = 100; i < 150; ++i) {
+        const std::string src = "exec://cmd" + std::to_string(i);
+        image_list_enqueue(src.c_str(), nullptr);
+    }
+    ASSERT_TRUE(image_list_merge());
+    ASSERT_EQ(image_list_size(), static_cast<size_t>(150));
+
+    // existing entries are not shuffled again
+    for (size_t i = 1; i < 100; ++i) {
+        EXPECT_LT(image_list_remap(i - 1), image_list_remap(i));
+    }
+    for (size_t i = 0; i < 150; ++i) {
+        const std::string src = "exec://cmd" + std::to_string(i);
+        EXPECT_NE(image_list_find(src.c_str()),
+                  static_cast<size_t>(IMGLIST_INVALID));
+    }
+}
+
 TEST_F(ImageList, Skip)
 {
     image_list_init(config);
@@ -267,3 +365,267 @@ TEST_F(ImageList, GetPrevDir)
     ASSERT_EQ(image_list_prev_dir(2), static_cast<size_t>(1));
     ASSERT_EQ(image_list_prev_dir(3), static_cast<size_t>(1));
 }
+
+TEST_F(ImageList, ScanDir)
+{
+    const std::string cmd = "mkdir -p " + dir + "/sub/deep && touch " + dir +
+        "/a " + dir + "/sub/b " + dir + "/sub/deep/c " + dir + "/sub/deep/d";
+    ASSERT_EQ(system(cmd.c_str()), 0);
+
+    image_list_init(config);
+    image_list_add(dir.c_str());
+    EXPECT_EQ(image_list_size(), static_cast<size_t>(1));
+    EXPECT_NE(image_list_find((dir + "/a").c_str()),
+              static_cast<size_t>(IMGLIST_INVALID));
+    image_list_destroy();
+
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_RECURSIVE, "yes"));
+    image_list_init(config);
+    image_list_add(dir.c_str());
+    EXPECT_EQ(image_list_size(), static_cast<size_t>(4));
+    EXPECT_NE(image_list_find((dir + "/sub/deep/d").c_str()),
+              static_cast<size_t>(IMGLIST_INVALID));
+}
+
+static bool list_found;
+static void on_list_found(void)
+{
+    __atomic_store_n(&list_found, true, __ATOMIC_SEQ_CST);
+}
+
+TEST_F(ImageList, ScanAsync)
+{
+    const std::string cmd =
+        "touch " + dir + "/a " + dir + "/b " + dir + "/c " + dir + "/d";
+    ASSERT_EQ(system(cmd.c_str()), 0);
+
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_ALL, "yes"));
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_ORDER, "alpha"));
+    image_list_init(config);
+    image_list_add_async((dir + "/c").c_str(), on_list_found);
+    ASSERT_EQ(image_list_size(), static_cast<size_t>(1));
+
+    ASSERT_TRUE(image_list_scan_wait());
+    ASSERT_TRUE(image_list_merge());
+    ASSERT_EQ(image_list_size(), static_cast<size_t>(4));
+    EXPECT_EQ(image_list_remap(0), static_cast<size_t>(2));
+    EXPECT_EQ(image_list_find((dir + "/a").c_str()), static_cast<size_t>(0));
+    EXPECT_EQ(image_list_find((dir + "/d").c_str()), static_cast<size_t>(3));
+}
+
+TEST_F(ImageList, ScanWait)
+{
+    const std::string cmd = "touch " + dir + "/a " + dir + "/b " + dir + "/c";
+    ASSERT_EQ(system(cmd.c_str()), 0);
+
+    image_list_init(config);
+    image_list_add((dir + "/a").c_str());
+    EXPECT_FALSE(image_list_scan_wait());
+    image_list_destroy();
+
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_ALL, "yes"));
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_ORDER, "alpha"));
+    image_list_init(config);
+    image_list_add_async((dir + "/b").c_str(), on_list_found);
+    ASSERT_TRUE(image_list_scan_wait());
+    ASSERT_TRUE(image_list_merge());
+    ASSERT_EQ(image_list_size(), static_cast<size_t>(3));
+    EXPECT_EQ(image_list_remap(0), static_cast<size_t>(1));
+    EXPECT_FALSE(image_list_merge());
+}
+
+TEST_F(ImageList, EnqueueAsync)
+{
+    const std::string cmd = "touch " + dir + "/a " + dir + "/b " + dir + "/c";
+    ASSERT_EQ(system(cmd.c_str()), 0);
+
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_ALL, "yes"));
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_ORDER, "alpha"));
+    image_list_init(config);
+    image_list_add("exec://cmd");
+    image_list_reorder();
+
+    // the file is added at once, the rest of the directory later
+    image_list_enqueue((dir + "/b").c_str(), on_list_found);
+    ASSERT_TRUE(image_list_merge());
+    EXPECT_NE(image_list_find((dir + "/b").c_str()),
+              static_cast<size_t>(IMGLIST_INVALID));
+    ASSERT_TRUE(image_list_scan_wait());
+    ASSERT_TRUE(image_list_merge());
+    ASSERT_EQ(image_list_size(), static_cast<size_t>(4));
+    EXPECT_EQ(image_list_find((dir + "/a").c_str()), static_cast<size_t>(0));
+    EXPECT_EQ(image_list_find((dir + "/c").c_str()), static_cast<size_t>(2));
+
+    // finished scanner is replaced by the new one
+    image_list_enqueue((dir + "/a").c_str(), on_list_found);
+    EXPECT_TRUE(image_list_merge());
+    EXPECT_TRUE(image_list_scan_wait());
+    image_list_merge();
+    EXPECT_EQ(image_list_size(), static_cast<size_t>(4));
+}
+
+TEST_F(ImageList, Index)
+{
+    const std::string cmd = "mkdir -p " + dir + "/cache " + dir +
+        "/img/sub/deep && touch " + dir + "/img/b " + dir + "/img/sub/a " +
+        dir + "/img/sub/deep/c";
+    ASSERT_EQ(system(cmd.c_str()), 0);
+    setenv("XDG_CACHE_HOME", (dir + "/cache").c_str(), 1);
+
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_RECURSIVE, "yes"));
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_ORDER, "alpha"));
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_INDEX, "yes"));
+
+    // first scan creates the index
+    image_list_init(config);
+    image_list_add((dir + "/img").c_str());
+    image_list_reorder();
+    ASSERT_EQ(image_list_size(), static_cast<size_t>(3));
+    image_list_destroy();
+
+    // removed file, the directory is read again
+    ASSERT_EQ(unlink((dir + "/img/sub/deep/c").c_str()), 0);
+    ASSERT_EQ(system(("touch -d @1 " + dir + "/img/sub/deep").c_str()), 0);
+    image_list_init(config);
+    image_list_add((dir + "/img").c_str());
+    image_list_reorder();
+    ASSERT_EQ(image_list_size(), static_cast<size_t>(2));
+    image_list_destroy();
+
+    // new file in nested directory
+    ASSERT_EQ(system(("touch " + dir + "/img/sub/deep/0 && touch -d @2 " +
+                      dir + "/img/sub/deep")
+                         .c_str()),
+              0);
+    image_list_init(config);
+    image_list_add((dir + "/img").c_str());
+    image_list_reorder();
+    ASSERT_EQ(image_list_size(), static_cast<size_t>(3));
+    EXPECT_EQ(image_list_find((dir + "/img/b").c_str()),
+              static_cast<size_t>(0));
+    EXPECT_EQ(image_list_find((dir + "/img/sub/a").c_str()),
+              static_cast<size_t>(1));
+    EXPECT_EQ(image_list_find((dir + "/img/sub/deep/0").c_str()),
+              static_cast<size_t>(2));
+    image_list_destroy();
+
+    // directory with restored mtime is taken from the index
+    ASSERT_EQ(system(("touch " + dir + "/img/sub/deep/1 && touch -d @2 " +
+                      dir + "/img/sub/deep")
+                         .c_str()),
+              0);
+    image_list_init(config);
+    image_list_add((dir + "/img").c_str());
+    image_list_reorder();
+    EXPECT_EQ(image_list_size(), static_cast<size_t>(3));
+
+}
+
+#ifdef HAVE_INOTIFY
+TEST_F(ImageList, Watch)
+{
+    const std::string cmd = "touch " + dir + "/b " + dir + "/d";
+    ASSERT_EQ(system(cmd.c_str()), 0);
+
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_ORDER, "alpha"));
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_RECURSIVE, "yes"));
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_WATCH, "yes"));
+    image_list_init(config);
+    ASSERT_NE(image_list_watch_fd(), -1);
+    image_list_add(dir.c_str());
+    image_list_reorder();
+    ASSERT_EQ(image_list_size(), static_cast<size_t>(2));
+
+    ASSERT_EQ(system(("touch " + dir + "/a && mkdir " + dir + "/c && touch " +
+                      dir + "/c/x && rm " + dir + "/d")
+                         .c_str()),
+              0);
+    // new directory is scanned in background
+    __atomic_store_n(&list_found, false, __ATOMIC_SEQ_CST);
+    for (size_t i = 0; i < 100 && !__atomic_load_n(&list_found, 0); ++i) {
+        image_list_watch_read(on_list_found);
+        usleep(10000);
+    }
+    EXPECT_TRUE(__atomic_load_n(&list_found, 0));
+    usleep(50000);
+    image_list_watch_read(on_list_found);
+    ASSERT_TRUE(image_list_merge());
+
+    ASSERT_EQ(image_list_size(), static_cast<size_t>(3));
+    EXPECT_EQ(image_list_find((dir + "/a").c_str()), static_cast<size_t>(0));
+    EXPECT_EQ(image_list_find((dir + "/b").c_str()), static_cast<size_t>(1));
+    EXPECT_EQ(image_list_find((dir + "/c/x").c_str()), static_cast<size_t>(2));
+    EXPECT_EQ(image_list_remap(0), static_cast<size_t>(1));
+    EXPECT_EQ(image_list_remap(1), static_cast<size_t>(IMGLIST_INVALID));
+    EXPECT_EQ(image_list_remap_nearest(1), static_cast<size_t>(1));
+}
+#endif // HAVE_INOTIFY
+
+TEST_F(ImageList, JumpLarge)
+{
+    const size_t total = 1000;
+    std::vector<size_t> live;
+
+    image_list_init(config);
+    for (size_t i = 0; i < total; ++i) {
+        image_list_add(("exec://cmd" + std::to_string(i)).c_str());
+    }
+    for (size_t i = 0; i < total; ++i) {
+        if (i % 3 == 0 || i % 7 == 0) {
+            image_list_skip(i);
+        } else {
+            live.push_back(i);
+        }
+    }
+
+    for (size_t i = 0; i < live.size(); i += 17) {
+        const size_t fwd = std::min(i + 42, live.size() - 1);
+        const size_t back = i > 42 ? i - 42 : 0;
+        ASSERT_EQ(image_list_jump(live[i], 42, true), live[fwd]);
+        ASSERT_EQ(image_list_jump(live[i], 42, false), live[back]);
+        ASSERT_EQ(image_list_distance(live[i], live[fwd]), fwd - i);
+        ASSERT_EQ(image_list_distance(live[back], live[i]), i - back);
+    }
+    EXPECT_EQ(image_list_first(), live.front());
+    EXPECT_EQ(image_list_last(), live.back());
+    EXPECT_EQ(image_list_nearest(live.back(), true, true), live.front());
+    EXPECT_EQ(image_list_nearest(0, true, false), live.front());
+}
+
+TEST_F(ImageList, SortNumeric)
+{
+    const char* src[] = { "exec://a10", "exec://b", "exec://a2",
+                          "exec://a01", "exec://a2x", "exec://a" };
+    const char* expect[] = { "exec://a",  "exec://a01", "exec://a2",
+                             "exec://a2x", "exec://a10", "exec://b" };
+
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_ORDER, "numeric"));
+    image_list_init(config);
+    for (auto s : src) {
+        image_list_add(s);
+    }
+    image_list_reorder();
+    ASSERT_EQ(image_list_size(), sizeof(expect) / sizeof(expect[0]));
+    for (size_t i = 0; i < image_list_size(); ++i) {
+        EXPECT_STREQ(image_list_get(i), expect[i]);
+    }
+}
+
+TEST_F(ImageList, SortReverse)
+{
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_ORDER, "alpha"));
+    ASSERT_TRUE(config_set(config, CFG_LIST, CFG_LIST_REVERSE, "yes"));
+    image_list_init(config);
+    tpool_init(3); // sort in parallel
+    for (size_t i = 0; i < 100; ++i) {
+        image_list_add(("exec://" + std::to_string(i % 10) +
+                        std::to_string(i / 10))
+                           .c_str());
+    }
+    image_list_reorder();
+    tpool_destroy();
+    ASSERT_EQ(image_list_size(), static_cast<size_t>(100));
+    for (size_t i = 1; i < image_list_size(); ++i) {
+        EXPECT_GT(strcmp(image_list_get(i - 1), image_list_get(i)), 0);
+    }
+}
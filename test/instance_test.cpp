@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "instance.h"
+}
+
+#include "tempdir.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <future>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+class Instance : public TempDir {
+protected:
+    void SetUp() override
+    {
+        ASSERT_NO_FATAL_FAILURE(TempDir::SetUp());
+        setenv("XDG_RUNTIME_DIR", dir.c_str(), 1);
+        setenv("WAYLAND_DISPLAY", "test-0", 1);
+    }
+
+    void TearDown() override
+    {
+        if (fd != -1) {
+            close(fd);
+        }
+        instance_destroy();
+        unsetenv("XDG_RUNTIME_DIR");
+        TempDir::TearDown();
+    }
+
+    /**
+     * Accept connection and read sources as the main loop does.
+     * @param data output array of sources
+     * @param size output size of the array
+     * @return number of received sources
+     */
+    size_t receive(char** data, size_t* size)
+    {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+        size_t num = 0;
+
+        if (poll(&pfd, 1, 5000) != 1) {
+            return 0;
+        }
+        pfd.fd = instance_accept(fd);
+        if (pfd.fd == -1) {
+            return 0;
+        }
+        while (poll(&pfd, 1, 5000) == 1 &&
+               !instance_read(pfd.fd, data, size, &num)) { }
+        close(pfd.fd);
+
+        return num;
+    }
+
+    int fd = -1;
+};
+
+TEST_F(Instance, NoServer)
+{
+    const char* sources[] = { "exec://cmd" };
+    EXPECT_FALSE(instance_forward(sources, 1));
+}
+
+TEST_F(Instance, Forward)
+{
+    const char* sources[] = { "exec://cmd1", "/", "exec://cmd2" };
+    char* data = nullptr;
+    size_t size = 0;
+
+    fd = instance_listen();
+    ASSERT_NE(fd, -1);
+    EXPECT_TRUE(std::filesystem::exists(dir + "/swayimg-test-0.sock"));
+
+    auto client = std::async(std::launch::async, [&sources] {
+        return instance_forward(sources, 3);
+    });
+
+    ASSERT_EQ(receive(&data, &size), 3U);
+    EXPECT_TRUE(client.get());
+
+    ASSERT_EQ(size, sizeof("exec://cmd1\0/\0exec://cmd2"));
+    EXPECT_STREQ(data, "exec://cmd1");
+    EXPECT_STREQ(data + 12, "/");
+    EXPECT_STREQ(data + 14, "exec://cmd2");
+    free(data);
+
+    // the second server on the same display is not allowed, its probe
+    // connection without data is ignored
+    EXPECT_EQ(instance_listen(), -1);
+    EXPECT_EQ(receive(&data, &size), 0U);
+}
+
+TEST_F(Instance, SlowClient)
+{
+    const std::string path = dir + "/swayimg-test-0.sock";
+    struct sockaddr_un sa = {};
+    char* data = nullptr;
+    size_t size = 0;
+
+    fd = instance_listen();
+    ASSERT_NE(fd, -1);
+
+    // client sends a byte from time to time and never finishes
+    sa.sun_family = AF_UNIX;
+    strncpy(sa.sun_path, path.c_str(), sizeof(sa.sun_path) - 1);
+    const int client = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_NE(client, -1);
+    ASSERT_EQ(connect(client, reinterpret_cast<struct sockaddr*>(&sa),
+                      sizeof(sa)),
+              0);
+    auto sender = std::async(std::launch::async, [client] {
+        for (size_t i = 0; i < 20; ++i) {
+            if (send(client, "x", 1, MSG_NOSIGNAL) != 1) {
+                break;
+            }
+            usleep(150000);
+        }
+    });
+
+    // data is read without blocking, the client is dropped on timeout
+    struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+    ASSERT_EQ(poll(&pfd, 1, 5000), 1);
+    pfd.fd = instance_accept(fd);
+    ASSERT_NE(pfd.fd, -1);
+    const auto start = std::chrono::steady_clock::now();
+    bool finished = false;
+    size_t num = 0;
+    while (!finished && poll(&pfd, 1, 5000) == 1) {
+        const auto call = std::chrono::steady_clock::now();
+        finished = instance_read(pfd.fd, &data, &size, &num);
+        EXPECT_LT(std::chrono::steady_clock::now() - call,
+                  std::chrono::milliseconds(100));
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_TRUE(finished);
+    EXPECT_EQ(num, 0U);
+    EXPECT_LT(elapsed, std::chrono::milliseconds(2000));
+    close(pfd.fd);
+
+    sender.get();
+    close(client);
+}
+
+TEST_F(Instance, TooLarge)
+{
+    const std::string path = dir + "/swayimg-test-0.sock";
+    struct sockaddr_un sa = {};
+    char* data = nullptr;
+    size_t size = 0;
+
+    fd = instance_listen();
+    ASSERT_NE(fd, -1);
+
+    sa.sun_family = AF_UNIX;
+    strncpy(sa.sun_path, path.c_str(), sizeof(sa.sun_path) - 1);
+    const int client = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_NE(client, -1);
+    ASSERT_EQ(connect(client, reinterpret_cast<struct sockaddr*>(&sa),
+                      sizeof(sa)),
+              0);
+    // endless stream of data is cut off by the size limit
+    auto sender = std::async(std::launch::async, [client] {
+        const std::vector<char> chunk(64 * 1024, 'x');
+        while (send(client, chunk.data(), chunk.size(), MSG_NOSIGNAL) > 0) { }
+    });
+
+    EXPECT_EQ(receive(&data, &size), 0U);
+
+    sender.get();
+    close(client);
+}
+
+TEST_F(Instance, Stdin)
+{
+    const char* sources[] = { "-" };
+
+    fd = instance_listen();
+    ASSERT_NE(fd, -1);
+    EXPECT_FALSE(instance_forward(sources, 1));
+}
@@ -107,6 +107,33 @@ TEST(List, Remove)
     ASSERT_EQ(head, nullptr);
 }
 
+TEST(List, Unlink)
+{
+    struct list entry[3];
+    struct list* head = NULL;
+
+    memset(entry, 0xff, sizeof(entry)); // poison
+
+    for (auto& it : entry) {
+        head = list_add_head(head, &it);
+    }
+
+    head = list_unlink_entry(head, &entry[1]);
+    ASSERT_EQ(entry[1].next, nullptr);
+    ASSERT_EQ(entry[1].prev, nullptr);
+    ASSERT_EQ(head, &entry[2]);
+    ASSERT_EQ(head->next, &entry[0]);
+    ASSERT_EQ(entry[0].prev, &entry[2]);
+
+    head = list_unlink_entry(head, &entry[2]);
+    ASSERT_EQ(head, &entry[0]);
+    ASSERT_EQ(head->next, nullptr);
+    ASSERT_EQ(head->prev, nullptr);
+
+    head = list_unlink_entry(head, &entry[0]);
+    ASSERT_EQ(head, nullptr);
+}
+
 TEST(List, ForEach)
 {
     struct list entry[3];
@@ -5,15 +5,30 @@ extern "C" {
 #include "application.h"
 #include "buildcfg.h"
 #include "loader.h"
+#include "tiles.h"
+#include "tpool.h"
 #include "ui.h"
 #include "viewer.h"
 }
 
 #include <gtest/gtest.h>
 
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBJPEG
+// depends on stdio.h, uses FILE but doesn't include the header
+#include <jpeglib.h>
+#endif
+
 // stubs for linker (application and ui are not included to tests)
 extern "C" {
-void app_watch(int, fd_callback, void*) { }
+void app_watch(int, short, fd_callback, void*) { }
 void app_reload() { }
 void app_redraw() { }
 void app_on_resize() { }
@@ -21,6 +36,8 @@ void app_on_keyboard(xkb_keysym_t, uint8_t) { }
 void app_on_drag(int, int) { }
 void app_exit(int) { }
 void app_on_load(struct image*, size_t) { }
+void app_on_update(size_t) { }
+void app_on_progress(const struct image*, size_t) { }
 bool app_is_viewer()
 {
     return true;
@@ -50,6 +67,74 @@ TEST_F(Loader, External)
     ASSERT_NE(image, nullptr);
 }
 
+TEST_F(Loader, Queue)
+{
+    // indices are out of the image list, all entries fail to load
+    loader_init(4);
+    for (size_t i = 0; i < 100; ++i) {
+        loader_queue_append(i, i % 3);
+    }
+    loader_queue_reset();
+    loader_queue_append(0, 0);
+    loader_destroy();
+}
+
+TEST_F(Loader, Progress)
+{
+    static size_t rows;
+    std::ifstream file(TEST_DATA_DIR "/image.qoi", std::ios::binary);
+    const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                                    std::istreambuf_iterator<char>());
+
+    image = image_alloc();
+    ASSERT_NE(image, nullptr);
+    image->progress = [](const struct image*, size_t r) { rows = r; };
+    rows = 0;
+
+    ASSERT_EQ(loader_decode_embedded(image, data.data(), data.size()),
+              ldr_success);
+    EXPECT_EQ(rows, image->frames[0].pm.height);
+}
+
+TEST_F(Loader, BitfieldsArgb)
+{
+    // 2x2 bottom-up BMP with V5 header and masks in ARGB order
+    const argb_t pixels[] = { 0xff000001, 0x80000002, 0x00000003, 0xff000004 };
+    const uint32_t header[] = {
+        124, 2, 2, 1 | (32 << 16), 3, sizeof(pixels), 0, 0, 0, 0,
+        0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000
+    };
+    const size_t offset = 14 + 124;
+    std::vector<uint8_t> bmp(offset + sizeof(pixels));
+    char path[] = "/tmp/swayimg_loader_XXXXXX";
+    int fd;
+
+    bmp[0] = 'B';
+    bmp[1] = 'M';
+    bmp[2] = static_cast<uint8_t>(bmp.size());
+    bmp[10] = offset;
+    memcpy(&bmp[14], header, sizeof(header));
+    memcpy(&bmp[offset], pixels, sizeof(pixels));
+
+    fd = mkstemp(path);
+    ASSERT_NE(fd, -1);
+    ASSERT_EQ(write(fd, bmp.data(), bmp.size()),
+              static_cast<ssize_t>(bmp.size()));
+    close(fd);
+    EXPECT_EQ(loader_from_source(path, &image), ldr_success);
+    unlink(path);
+    ASSERT_NE(image, nullptr);
+
+    // unaligned pixel array is copied to the heap, rows are flipped
+    const struct image_frame* frame = &image->frames[0];
+    EXPECT_EQ(frame->shm_size, static_cast<size_t>(0));
+    EXPECT_TRUE(image->alpha);
+    EXPECT_EQ(frame->pm.data[0], pixels[2]);
+    EXPECT_EQ(frame->pm.data[1], pixels[3]);
+    EXPECT_EQ(frame->pm.data[2], pixels[0]);
+    EXPECT_EQ(frame->pm.data[3], pixels[1]);
+}
+
 #define TEST_LOADER(n)                    \
     TEST_F(Loader, n)                     \
     {                                     \
@@ -76,6 +161,89 @@ TEST_LOADER(avif);
 #endif
 #ifdef HAVE_LIBJPEG
 TEST_LOADER(jpg);
+
+#if defined(LIBJPEG_TURBO_VERSION_NUMBER) && \
+    LIBJPEG_TURBO_VERSION_NUMBER >= 1005000
+TEST_F(Loader, JpegTiles)
+{
+    // huge image is decoded by tiles, region crosses tile boundaries
+    const JDIMENSION size = 8200;
+    const size_t rx = 3000, ry = 6100, width = 256, height = 128;
+    char path[] = "/tmp/swayimg_loader_XXXXXX";
+    std::vector<uint8_t> line(size * 3);
+    struct jpeg_compress_struct enc;
+    struct jpeg_decompress_struct dec;
+    struct jpeg_error_mgr err;
+    struct pixmap pm;
+    uint8_t* row = line.data();
+    FILE* file;
+    int fd;
+
+    fd = mkstemp(path);
+    ASSERT_NE(fd, -1);
+    file = fdopen(fd, "wb");
+    ASSERT_NE(file, nullptr);
+    enc.err = jpeg_std_error(&err);
+    jpeg_create_compress(&enc);
+    jpeg_stdio_dest(&enc, file);
+    enc.image_width = size;
+    enc.image_height = size;
+    enc.input_components = 3;
+    enc.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&enc);
+    jpeg_start_compress(&enc, TRUE);
+    while (enc.next_scanline < size) {
+        const JDIMENSION y = enc.next_scanline;
+        for (JDIMENSION x = 0; x < size; ++x) {
+            line[x * 3 + 0] = x / 32;
+            line[x * 3 + 1] = y / 32;
+            line[x * 3 + 2] = (x + y) / 64;
+        }
+        jpeg_write_scanlines(&enc, &row, 1);
+    }
+    jpeg_finish_compress(&enc);
+    jpeg_destroy_compress(&enc);
+    fclose(file);
+
+    EXPECT_EQ(loader_from_source(path, &image), ldr_success);
+    ASSERT_NE(image, nullptr);
+    ASSERT_NE(image->tiles, nullptr);
+
+    ASSERT_TRUE(pixmap_create(&pm, width, height));
+    while (!tiles_draw(image, aa_nearest, &pm, -(ssize_t)rx, -(ssize_t)ry,
+                       1.0)) {
+        usleep(1000);
+    }
+
+    // reference: the same rows from the full decode
+    line.resize(size * sizeof(argb_t));
+    row = line.data();
+    file = fopen(path, "rb");
+    ASSERT_NE(file, nullptr);
+    dec.err = jpeg_std_error(&err);
+    jpeg_create_decompress(&dec);
+    jpeg_stdio_src(&dec, file);
+    jpeg_read_header(&dec, TRUE);
+    dec.out_color_space = JCS_EXT_BGRA;
+    jpeg_start_decompress(&dec);
+    while (dec.output_scanline < ry + height) {
+        const size_t y = dec.output_scanline;
+        jpeg_read_scanlines(&dec, &row, 1);
+        if (y >= ry) {
+            const argb_t* ref = reinterpret_cast<argb_t*>(row) + rx;
+            const argb_t* tile = &pm.data[(y - ry) * width];
+            for (size_t x = 0; x < width; ++x) {
+                ASSERT_EQ(tile[x], ref[x]) << x << "," << y - ry;
+            }
+        }
+    }
+    jpeg_abort_decompress(&dec);
+    jpeg_destroy_decompress(&dec);
+    fclose(file);
+    unlink(path);
+    pixmap_free(&pm);
+}
+#endif
 #endif
 #ifdef HAVE_LIBJXL
 TEST_LOADER(jxl);
@@ -88,6 +256,26 @@ TEST_LOADER(svg);
 #endif
 #ifdef HAVE_LIBTIFF
 TEST_LOADER(tiff);
+
+TEST_F(Loader, TiffTallTiles)
+{
+    // 32x8 image stored as two 16x16 tiles, decoded tile by tile in parallel
+    ASSERT_TRUE(tpool_init(2));
+    EXPECT_EQ(loader_from_source(TEST_DATA_DIR "/tiles.tiff", &image),
+              ldr_success);
+    tpool_destroy();
+    ASSERT_NE(image, nullptr);
+
+    const struct pixmap* pm = &image->frames[0].pm;
+    ASSERT_EQ(pm->width, static_cast<size_t>(32));
+    ASSERT_EQ(pm->height, static_cast<size_t>(8));
+    for (size_t y = 0; y < pm->height; ++y) {
+        for (size_t x = 0; x < pm->width; ++x) {
+            EXPECT_EQ(pm->data[y * pm->width + x],
+                      ARGB(0xff, x * 8, y * 32, 0x80));
+        }
+    }
+}
 #endif
 #ifdef HAVE_LIBSIXEL
 TEST_LOADER(six);
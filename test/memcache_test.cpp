@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "memcache.h"
+}
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+static std::vector<struct image*> evicted;
+static std::vector<bool> pressures;
+
+static void evict(struct image* image, bool pressure)
+{
+    evicted.push_back(image);
+    pressures.push_back(pressure);
+    image_free(image);
+}
+
+class MemCache : public ::testing::Test {
+protected:
+    void TearDown() override
+    {
+        memcache_destroy();
+        for (struct image* image : images) {
+            image_free(image);
+        }
+        evicted.clear();
+        pressures.clear();
+    }
+
+    struct image* Create(size_t size, size_t decode_time)
+    {
+        struct image* image = image_alloc();
+        image_allocate_frame(image, size, size);
+        image->decode_time = decode_time;
+        images.push_back(image);
+        return image;
+    }
+
+    void Evicted(struct image* image)
+    {
+        images.erase(std::find(images.begin(), images.end(), image));
+    }
+
+    std::vector<struct image*> images;
+};
+
+TEST_F(MemCache, Unlimited)
+{
+    struct memcache_stats stats;
+
+    memcache_init(0);
+    memcache_put(Create(100, 1), evict);
+    memcache_put(Create(100, 1), evict);
+    memcache_trim();
+
+    memcache_stats(&stats);
+    EXPECT_EQ(stats.entries, 2U);
+    EXPECT_EQ(stats.used, 2 * 100 * 100 * sizeof(argb_t));
+    EXPECT_EQ(stats.evictions, 0U);
+    EXPECT_TRUE(evicted.empty());
+}
+
+TEST_F(MemCache, Trim)
+{
+    const size_t size = 100 * 100 * sizeof(argb_t);
+    struct memcache_stats stats;
+    struct image* cheap;
+    struct image* costly;
+    struct image* last;
+
+    memcache_init(2 * size);
+    costly = Create(100, 1000);
+    cheap = Create(100, 1);
+    last = Create(100, 1);
+    memcache_put(costly, evict);
+    memcache_put(cheap, evict);
+    memcache_put(last, evict);
+    memcache_trim();
+
+    ASSERT_EQ(evicted.size(), 1U);
+    EXPECT_EQ(evicted[0], cheap);
+    EXPECT_FALSE(pressures[0]); // budget, may be moved to another cache
+    Evicted(cheap);
+
+    memcache_stats(&stats);
+    EXPECT_EQ(stats.entries, 2U);
+    EXPECT_EQ(stats.used, 2 * size);
+    EXPECT_EQ(stats.evictions, 1U);
+
+    memcache_remove(costly);
+    memcache_remove(last);
+    memcache_stats(&stats);
+    EXPECT_EQ(stats.entries, 0U);
+    EXPECT_EQ(stats.used, 0U);
+}
+
+TEST_F(MemCache, KeepLast)
+{
+    struct memcache_stats stats;
+
+    memcache_init(1);
+    memcache_put(Create(100, 1), evict);
+    memcache_trim();
+
+    memcache_stats(&stats);
+    EXPECT_EQ(stats.entries, 1U);
+    EXPECT_TRUE(evicted.empty());
+}
+
+TEST_F(MemCache, Shrink)
+{
+    const size_t size = 100 * 100 * sizeof(argb_t);
+    struct memcache_stats stats;
+    struct image* cheap;
+    struct image* costly;
+    struct image* last;
+
+    memcache_init(0);
+    costly = Create(100, 1000);
+    cheap = Create(100, 1);
+    last = Create(100, 1);
+    memcache_put(costly, evict);
+    memcache_put(cheap, evict);
+    memcache_put(last, evict);
+
+    memcache_shrink(size / 2);
+    ASSERT_EQ(evicted.size(), 1U);
+    EXPECT_EQ(evicted[0], cheap);
+    EXPECT_TRUE(pressures[0]); // must be freed
+    Evicted(cheap);
+
+    // the last image is kept even if more memory is requested
+    memcache_shrink(size * 10);
+    ASSERT_EQ(evicted.size(), 2U);
+    EXPECT_EQ(evicted[1], costly);
+    Evicted(costly);
+
+    memcache_stats(&stats);
+    EXPECT_EQ(stats.entries, 1U);
+    EXPECT_EQ(stats.used, size);
+    EXPECT_EQ(stats.evictions, 2U);
+    EXPECT_EQ(stats.shrinks, 2U);
+}
+
+TEST_F(MemCache, Account)
+{
+    struct memcache_stats stats;
+
+    memcache_init(0);
+    memcache_account(true);
+    memcache_account(false);
+    memcache_account(true);
+
+    memcache_stats(&stats);
+    EXPECT_EQ(stats.hits, 2U);
+    EXPECT_EQ(stats.misses, 1U);
+}
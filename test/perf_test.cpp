@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "perf.h"
+}
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+class Perf : public ::testing::Test {
+protected:
+    const struct perf_decode* Find(const struct perf_stats& stats,
+                                   const char* format)
+    {
+        for (size_t i = 0; i < stats.decode_num; ++i) {
+            if (strcmp(stats.decode[i].format, format) == 0) {
+                return &stats.decode[i];
+            }
+        }
+        return nullptr;
+    }
+
+    struct perf_stats stats;
+};
+
+TEST_F(Perf, Decode)
+{
+    const struct perf_decode* entry;
+    size_t num;
+
+    perf_decode("TestFormat", 42);
+    perf_collect(&stats);
+    entry = Find(stats, "TestFormat");
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(entry->time, 42U);
+    num = stats.decode_num;
+
+    perf_decode("TestFormat", 7);
+    perf_collect(&stats);
+    entry = Find(stats, "TestFormat");
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(entry->time, 7U);
+    EXPECT_EQ(stats.decode_num, num);
+
+    // the oldest formats are replaced
+    for (size_t i = 0; i < PERF_FORMATS * 2; ++i) {
+        const std::string format = "Format" + std::to_string(i);
+        perf_decode(format.c_str(), i);
+    }
+    perf_collect(&stats);
+    EXPECT_EQ(stats.decode_num, static_cast<size_t>(PERF_FORMATS));
+    EXPECT_FALSE(Find(stats, "TestFormat"));
+    entry = Find(stats, "Format15");
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(entry->time, 15U);
+}
+
+TEST_F(Perf, Frame)
+{
+    perf_collect(&stats); // start new period
+
+    perf_frame(perf_now() - 1000);
+    perf_frame(perf_now() - 3000);
+    perf_collect(&stats);
+    EXPECT_EQ(stats.frames, 2U);
+    EXPECT_GE(stats.frame_max, 3000U);
+    EXPECT_GE(stats.frame_avg, 2000U);
+    EXPECT_LT(stats.frame_avg, stats.frame_max);
+
+    perf_collect(&stats);
+    EXPECT_EQ(stats.frames, 0U);
+    EXPECT_EQ(stats.frame_avg, 0U);
+    EXPECT_EQ(stats.frame_max, 0U);
+}
+
+TEST_F(Perf, Scale)
+{
+    perf_scale(aa_bicubic, perf_now() - 500);
+    perf_collect(&stats);
+    EXPECT_EQ(stats.scale_aa, aa_bicubic);
+    EXPECT_GE(stats.scale_time, 500U);
+}
+
+TEST_F(Perf, Preload)
+{
+    size_t hits, misses;
+
+    perf_collect(&stats);
+    hits = stats.preload_hits;
+    misses = stats.preload_misses;
+
+    perf_preload(true);
+    perf_preload(true);
+    perf_preload(false);
+    perf_collect(&stats);
+    EXPECT_EQ(stats.preload_hits, hits + 2);
+    EXPECT_EQ(stats.preload_misses, misses + 1);
+}
+
+TEST_F(Perf, Startup)
+{
+    std::string report;
+
+    perf_startup("ignored"); // profiling is not active
+
+    perf_startup_begin(perf_now() - 1500);
+    perf_startup("config");
+    perf_startup("first image");
+
+    testing::internal::CaptureStderr();
+    perf_frame(perf_now());
+    report = testing::internal::GetCapturedStderr();
+    EXPECT_EQ(report.find("ignored"), std::string::npos);
+    EXPECT_NE(report.find("  config            1."), std::string::npos);
+    EXPECT_NE(report.find("  first image "), std::string::npos);
+    EXPECT_NE(report.find("  first frame "), std::string::npos);
+    EXPECT_NE(report.find("  total "), std::string::npos);
+
+    // report is printed only once
+    testing::internal::CaptureStderr();
+    perf_frame(perf_now());
+    EXPECT_TRUE(testing::internal::GetCapturedStderr().empty());
+
+    perf_collect(&stats);
+}
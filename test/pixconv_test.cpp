@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "pixconv.h"
+#include "tpool.h"
+}
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+class PixConv : public ::testing::Test {
+protected:
+    // odd number of pixels: SIMD body and scalar tail are both used
+    static constexpr size_t num = 37;
+
+    void SetUp() override
+    {
+        raw.resize(num * 8);
+        for (size_t i = 0; i < raw.size(); ++i) {
+            raw[i] = static_cast<uint8_t>(i * 7 + 3);
+        }
+        out.resize(num);
+    }
+
+    std::vector<uint8_t> raw;
+    std::vector<argb_t> out;
+};
+
+TEST_F(PixConv, Rgb24)
+{
+    pixconv_rgb24(out.data(), raw.data(), num);
+    for (size_t i = 0; i < num; ++i) {
+        const uint8_t* px = &raw[i * 3];
+        ASSERT_EQ(out[i], ARGB(0xff, px[0], px[1], px[2])) << i;
+    }
+}
+
+TEST_F(PixConv, Bgr24)
+{
+    pixconv_bgr24(out.data(), raw.data(), num);
+    for (size_t i = 0; i < num; ++i) {
+        const uint8_t* px = &raw[i * 3];
+        ASSERT_EQ(out[i], ARGB(0xff, px[2], px[1], px[0])) << i;
+    }
+}
+
+TEST_F(PixConv, Bgr32)
+{
+    pixconv_bgrx32(out.data(), raw.data(), num);
+    for (size_t i = 0; i < num; ++i) {
+        const uint8_t* px = &raw[i * 4];
+        ASSERT_EQ(out[i], ARGB(0xff, px[2], px[1], px[0])) << i;
+    }
+
+    pixconv_bgra32(out.data(), raw.data(), num);
+    for (size_t i = 0; i < num; ++i) {
+        const uint8_t* px = &raw[i * 4];
+        ASSERT_EQ(out[i], ARGB(px[3], px[2], px[1], px[0])) << i;
+    }
+}
+
+TEST_F(PixConv, Rgba64be)
+{
+    pixconv_rgba64be(out.data(), raw.data(), num);
+    for (size_t i = 0; i < num; ++i) {
+        const uint8_t* px = &raw[i * 8];
+        ASSERT_EQ(out[i], ARGB(px[6], px[0], px[2], px[4])) << i;
+    }
+}
+
+TEST_F(PixConv, Gray8)
+{
+    pixconv_gray8(out.data(), raw.data(), num);
+    for (size_t i = 0; i < num; ++i) {
+        ASSERT_EQ(out[i], ARGB(0xff, raw[i], raw[i], raw[i])) << i;
+    }
+}
+
+TEST_F(PixConv, Image)
+{
+    const size_t width = 1000;
+    const size_t height = 1000;
+    std::vector<uint8_t> gray(width * height);
+    struct image* img = image_alloc();
+    const struct pixmap* pm;
+
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < width; ++x) {
+            gray[y * width + x] = static_cast<uint8_t>(x + y);
+        }
+    }
+
+    ASSERT_TRUE(img);
+    pm = image_allocate_frame(img, width, height);
+    ASSERT_TRUE(pm);
+
+    // bottom-up in parallel
+    ASSERT_TRUE(tpool_init(3));
+    pixconv_image(img, &gray[(height - 1) * width], -(ssize_t)width,
+                  pixconv_gray8);
+    tpool_destroy();
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < width; ++x) {
+            const uint8_t v = static_cast<uint8_t>(x + height - 1 - y);
+            ASSERT_EQ(pm->data[y * width + x], ARGB(0xff, v, v, v));
+        }
+    }
+
+    image_free(img);
+}
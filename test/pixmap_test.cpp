@@ -3,6 +3,7 @@
 
 extern "C" {
 #include "pixmap.h"
+#include "pixmap_ablend.h"
 #include "pixmap_scale.h"
 }
 
@@ -39,6 +40,31 @@ protected:
         pixmap_free(&dst1);
         pixmap_free(&dst2);
     }
+
+    void Rotate(size_t width, size_t height, size_t angle)
+    {
+        struct pixmap pm;
+        ASSERT_TRUE(pixmap_create(&pm, width, height));
+        for (size_t i = 0; i < width * height; ++i) {
+            pm.data[i] = i;
+        }
+
+        pixmap_rotate(&pm, angle);
+        ASSERT_EQ(pm.width, height);
+        ASSERT_EQ(pm.height, width);
+
+        for (size_t y = 0; y < height; ++y) {
+            for (size_t x = 0; x < width; ++x) {
+                const size_t pos = angle == 90
+                    ? x * pm.width + (pm.width - y - 1)
+                    : (pm.height - x - 1) * pm.width + y;
+                ASSERT_EQ(pm.data[pos], y * width + x)
+                    << "x=" << x << ",y=" << y;
+            }
+        }
+
+        pixmap_free(&pm);
+    }
 };
 
 TEST_F(Pixmap, Create)
@@ -224,6 +250,27 @@ TEST_F(Pixmap, Grid)
     Compare(pm, expect);
 }
 
+TEST_F(Pixmap, GridPartial)
+{
+    const argb_t clr1 = 0x12345678;
+    const argb_t clr2 = 0x87654321;
+    argb_t full[8 * 8] = { 0 };
+    argb_t part[3 * 3] = { 0 };
+    argb_t expect[3 * 3];
+
+    // pattern of the partially drawn grid must match the full one
+    struct pixmap pm_full = { 8, 8, full };
+    struct pixmap pm_part = { 3, 3, part };
+    pixmap_grid(&pm_full, 1, 1, 6, 6, 2, clr1, clr2);
+    pixmap_grid(&pm_part, 1 - 4, 1 - 3, 6, 6, 2, clr1, clr2);
+    for (size_t y = 0; y < 3; ++y) {
+        for (size_t x = 0; x < 3; ++x) {
+            expect[y * 3 + x] = full[(y + 3) * 8 + x + 4];
+        }
+    }
+    Compare(pm_part, expect);
+}
+
 TEST_F(Pixmap, Mask)
 {
     const argb_t clr = 0xffaaaaaa;
@@ -476,6 +523,128 @@ TEST_F(Pixmap, CopyAlphaOutsideBL)
     Compare(pm_dst, expect);
 }
 
+TEST_F(Pixmap, Diff)
+{
+    // clang-format off
+    argb_t src_a[] = {
+        0x00, 0x01, 0x02, 0x03,
+        0x10, 0x11, 0x12, 0x13,
+        0x20, 0x21, 0x22, 0x23,
+        0x30, 0x31, 0x32, 0x33,
+    };
+    argb_t src_b[] = {
+        0x00, 0x01, 0x02, 0x03,
+        0x10, 0xaa, 0x12, 0x13,
+        0x20, 0x21, 0xbb, 0x23,
+        0x30, 0x31, 0x32, 0x33,
+    };
+    argb_t src_c[] = { 0x00, 0x01 };
+    // clang-format on
+
+    const struct pixmap a = { 4, 4, src_a };
+    const struct pixmap b = { 4, 4, src_b };
+    const struct pixmap c = { 2, 1, src_c };
+    struct pixmap_area area;
+
+    ASSERT_TRUE(pixmap_diff(&a, &b, &area));
+    EXPECT_EQ(area.x, 1U);
+    EXPECT_EQ(area.y, 1U);
+    EXPECT_EQ(area.width, 2U);
+    EXPECT_EQ(area.height, 2U);
+
+    ASSERT_TRUE(pixmap_diff(&a, &a, &area));
+    EXPECT_EQ(area.width, 0U);
+    EXPECT_EQ(area.height, 0U);
+
+    EXPECT_FALSE(pixmap_diff(&a, &c, &area));
+}
+
+TEST_F(Pixmap, BlendSpan)
+{
+    // reference implementation: straight alpha "over" operator
+    const auto blend = [](argb_t src, argb_t dst) -> argb_t {
+        const uint32_t a1 = ARGB_GET_A(src);
+        const uint32_t c1 = a1 * 255;
+        const uint32_t c2 = (255 - a1) * ARGB_GET_A(dst);
+        const uint32_t alpha = c1 + c2;
+        if (alpha == 0) {
+            return dst;
+        }
+        return ARGB(alpha / 255,
+                    (ARGB_GET_R(src) * c1 + ARGB_GET_R(dst) * c2) / alpha,
+                    (ARGB_GET_G(src) * c1 + ARGB_GET_G(dst) * c2) / alpha,
+                    (ARGB_GET_B(src) * c1 + ARGB_GET_B(dst) * c2) / alpha);
+    };
+
+    constexpr size_t len = 1027; // not multiple of vector size
+    argb_t src[len], dst[len], expect[len];
+    uint8_t mask[len];
+
+    srand(0);
+    for (size_t pass = 0; pass < 16; ++pass) {
+        // mix of opaque and translucent background, sometimes fully opaque
+        for (size_t i = 0; i < len; ++i) {
+            src[i] = (static_cast<uint32_t>(rand()) << 16) ^ rand();
+            dst[i] = (static_cast<uint32_t>(rand()) << 16) ^ rand();
+            mask[i] = pass & 1 ? rand() : (rand() & 1) * 0xff;
+            if (pass & 2 || rand() & 1) {
+                dst[i] |= 0xff000000;
+            }
+            if (pass & 4) {
+                src[i] &= 0x00ffffff; // alpha 0 or 255
+                src[i] |= ARGB_SET_A((rand() & 1) * 0xff);
+            }
+        }
+
+        // span
+        for (size_t i = 0; i < len; ++i) {
+            expect[i] = blend(src[i], dst[i]);
+        }
+        argb_t tmp[len];
+        memcpy(tmp, dst, sizeof(tmp));
+        alpha_blend_span(src, tmp, len);
+        for (size_t i = 0; i < len; ++i) {
+            ASSERT_EQ(tmp[i], expect[i]) << "span, pass=" << pass << ",i=" << i;
+        }
+
+        // fill
+        const argb_t color = src[pass];
+        for (size_t i = 0; i < len; ++i) {
+            expect[i] = blend(color, dst[i]);
+        }
+        memcpy(tmp, dst, sizeof(tmp));
+        alpha_blend_fill(color, tmp, len);
+        for (size_t i = 0; i < len; ++i) {
+            ASSERT_EQ(tmp[i], expect[i]) << "fill, pass=" << pass << ",i=" << i;
+        }
+
+        // mask
+        for (size_t i = 0; i < len; ++i) {
+            const uint8_t alpha = (mask[i] * ARGB_GET_A(color)) / 255;
+            expect[i] =
+                blend(ARGB_SET_A(alpha) | (color & 0x00ffffff), dst[i]);
+        }
+        memcpy(tmp, dst, sizeof(tmp));
+        alpha_blend_mask(color, mask, tmp, len);
+        for (size_t i = 0; i < len; ++i) {
+            ASSERT_EQ(tmp[i], expect[i]) << "mask, pass=" << pass << ",i=" << i;
+        }
+    }
+}
+
+TEST_F(Pixmap, Premultiply)
+{
+    const argb_t src[] = { 0xff123456, 0x80ff8040, 0x00ffffff, 0x40808080 };
+    const argb_t expect[] = { 0xff123456, 0x80804020, 0x00000000, 0x40202020 };
+    constexpr size_t len = sizeof(src) / sizeof(src[0]);
+    argb_t dst[len];
+
+    alpha_premultiply(src, dst, len);
+    for (size_t i = 0; i < len; ++i) {
+        EXPECT_EQ(dst[i], expect[i]) << "i=" << i;
+    }
+}
+
 TEST_F(Pixmap, Rect)
 {
     const argb_t clr = 0xff345678;
@@ -638,3 +807,215 @@ TEST_F(Pixmap, ScaleCopyDownPos)
     const struct pixmap pm = { 4, 4, src };
     ScaleCopy(aa_bilinear, pm, 2, 2, 0.5, 1, 1);
 }
+
+TEST_F(Pixmap, Reduce)
+{
+    // clang-format off
+    argb_t src[] = {
+        0xff000000, 0xff040404, 0xff080808,
+        0xff0c0c0c, 0xff101010, 0xff141414,
+        0xff181818, 0xff1c1c1c, 0xff202020,
+    };
+    const argb_t expect[] = {
+        0xff080808, 0xff0e0e0e,
+        0xff1a1a1a, 0xff202020,
+    };
+    // clang-format on
+
+    const struct pixmap pm = { 3, 3, src };
+    struct pixmap reduced;
+    ASSERT_TRUE(pixmap_reduce(&pm, &reduced));
+    EXPECT_EQ(reduced.width, static_cast<size_t>(2));
+    EXPECT_EQ(reduced.height, static_cast<size_t>(2));
+    Compare(reduced, expect);
+    pixmap_free(&reduced);
+}
+
+TEST_F(Pixmap, ReduceAlpha)
+{
+    // clang-format off
+    argb_t src[] = {
+        0x00ffffff, 0xff000000,
+        0xff000000, 0xff000000,
+    };
+    const argb_t expect[] = { 0xbf000000 };
+    // clang-format on
+
+    const struct pixmap pm = { 2, 2, src };
+    struct pixmap reduced;
+    ASSERT_TRUE(pixmap_reduce(&pm, &reduced));
+    Compare(reduced, expect);
+    pixmap_free(&reduced);
+}
+
+TEST_F(Pixmap, Rotate90)
+{
+    Rotate(3, 2, 90);
+    Rotate(131, 70, 90);
+}
+
+TEST_F(Pixmap, Rotate270)
+{
+    Rotate(2, 3, 270);
+    Rotate(70, 131, 270);
+}
+
+TEST_F(Pixmap, RotateSquare)
+{
+    Rotate(130, 130, 90);
+    Rotate(130, 130, 270);
+}
+
+TEST_F(Pixmap, ScaleOrient)
+{
+    struct pixmap src;
+    ASSERT_TRUE(pixmap_create(&src, 5, 3));
+    for (size_t i = 0; i < 15; ++i) {
+        src.data[i] = 0xff000000 | (i * 0x0f0d0b);
+    }
+
+    for (int orient = 0; orient < 8; ++orient) {
+        // reference: transform pixels first
+        struct pixmap ref;
+        ASSERT_TRUE(pixmap_create(&ref, src.width, src.height));
+        memcpy(ref.data, src.data, 15 * sizeof(argb_t));
+        bool flip_x = orient & orient_flip_x;
+        if (orient & orient_transpose) {
+            pixmap_rotate(&ref, 90);
+            flip_x = !flip_x;
+        }
+        if (flip_x) {
+            pixmap_flip_horizontal(&ref);
+        }
+        if (orient & orient_flip_y) {
+            pixmap_flip_vertical(&ref);
+        }
+
+        for (float scale : { 1.0f, 2.0f }) {
+            struct pixmap expect, real;
+            ASSERT_TRUE(pixmap_create(&expect, 12, 12));
+            ASSERT_TRUE(pixmap_create(&real, 12, 12));
+            pixmap_scale_mipmap(aa_bilinear, &ref, nullptr, 0, &expect, -1, 2,
+                                scale, false, orient_normal);
+            pixmap_scale_mipmap(aa_bilinear, &src, nullptr, 0, &real, -1, 2,
+                                scale, false,
+                                static_cast<enum pixmap_orient>(orient));
+            for (size_t i = 0; i < 12 * 12; ++i) {
+                ASSERT_EQ(real.data[i], expect.data[i])
+                    << "orient=" << orient << ",scale=" << scale
+                    << ",i=" << i;
+            }
+            pixmap_free(&expect);
+            pixmap_free(&real);
+        }
+
+        pixmap_free(&ref);
+    }
+
+    pixmap_free(&src);
+}
+
+TEST_F(Pixmap, ScaleImpl)
+{
+    // odd width reaches the tails of the vectorized loops
+    const size_t width = 301;
+    const size_t height = 97;
+    struct pixmap src;
+    ASSERT_TRUE(pixmap_create(&src, width, height));
+    srand(0);
+    for (size_t i = 0; i < width * height; ++i) {
+        src.data[i] = (static_cast<uint32_t>(rand()) << 16) ^ rand();
+        if (i % 3 == 0) {
+            src.data[i] |= 0xff000000;
+        }
+    }
+
+    for (const enum scale_impl impl :
+         { scale_impl_sse41, scale_impl_avx2, scale_impl_neon }) {
+        if (!pixmap_scale_impl(impl)) {
+            continue; // not supported by current CPU
+        }
+        for (const enum aa_mode aa :
+             { aa_box, aa_bilinear, aa_bicubic, aa_mks13 }) {
+            for (const float scale : { 0.37f, 0.5f, 1.7f }) {
+                for (const bool alpha : { false, true }) {
+                    const size_t w = width * scale + 3;
+                    const size_t h = height * scale + 3;
+                    struct pixmap expect, real;
+                    ASSERT_TRUE(pixmap_create(&expect, w, h));
+                    ASSERT_TRUE(pixmap_create(&real, w, h));
+                    ASSERT_TRUE(pixmap_scale_impl(scale_impl_scalar));
+                    pixmap_scale(aa, &src, &expect, 1, 2, scale, alpha);
+                    ASSERT_TRUE(pixmap_scale_impl(impl));
+                    pixmap_scale(aa, &src, &real, 1, 2, scale, alpha);
+                    for (size_t i = 0; i < w * h; ++i) {
+                        ASSERT_EQ(real.data[i], expect.data[i])
+                            << "impl=" << impl << ",aa=" << aa
+                            << ",scale=" << scale << ",alpha=" << alpha
+                            << ",i=" << i;
+                    }
+                    pixmap_free(&expect);
+                    pixmap_free(&real);
+                }
+            }
+        }
+    }
+
+    pixmap_scale_impl(scale_impl_auto);
+    pixmap_free(&src);
+}
+
+TEST_F(Pixmap, Compact)
+{
+    struct pixmap color, gray, argb, expect, real;
+
+    ASSERT_TRUE(pixmap_create(&gray, 19, 7));
+    for (size_t i = 0; i < 19 * 7; ++i) {
+        gray.data[i] = ARGB(0xff, i, i, i);
+    }
+    ASSERT_TRUE(pixmap_create(&argb, 19, 7));
+    memcpy(argb.data, gray.data, 19 * 7 * sizeof(argb_t));
+
+    // colored or transparent pixels are kept as is
+    ASSERT_TRUE(pixmap_create(&color, 2, 1));
+    color.data[0] = ARGB(0xff, 1, 1, 1);
+    color.data[1] = ARGB(0xff, 1, 2, 1);
+    EXPECT_FALSE(pixmap_compact(&color));
+    color.data[1] = ARGB(0xfe, 1, 1, 1);
+    EXPECT_FALSE(pixmap_compact(&color));
+    EXPECT_EQ(color.format, pixfmt_argb);
+    pixmap_free(&color);
+
+    ASSERT_TRUE(pixmap_compact(&gray));
+    EXPECT_EQ(gray.format, pixfmt_gray8);
+    EXPECT_EQ(pixmap_bpp(gray.format), 1U);
+    EXPECT_FALSE(pixmap_compact(&gray));
+
+    // copy
+    ASSERT_TRUE(pixmap_create(&expect, 16, 16));
+    ASSERT_TRUE(pixmap_create(&real, 16, 16));
+    pixmap_copy(&argb, &expect, -2, 3, false);
+    pixmap_copy(&gray, &real, -2, 3, true);
+    for (size_t i = 0; i < 16 * 16; ++i) {
+        ASSERT_EQ(real.data[i], expect.data[i]) << i;
+    }
+
+    // scale, grayscale is filtered without expanding to ARGB
+    for (const enum aa_mode aa : { aa_nearest, aa_bilinear, aa_mks13 }) {
+        for (const float scale : { 0.4f, 1.5f, 3.0f }) {
+            pixmap_fill(&expect, 0, 0, 16, 16, 0);
+            pixmap_fill(&real, 0, 0, 16, 16, 0);
+            pixmap_scale(aa, &argb, &expect, 1, -1, scale, false);
+            pixmap_scale(aa, &gray, &real, 1, -1, scale, true);
+            for (size_t i = 0; i < 16 * 16; ++i) {
+                ASSERT_EQ(real.data[i], expect.data[i])
+                    << aa << " " << scale << " " << i;
+            }
+        }
+    }
+
+    pixmap_free(&expect);
+    pixmap_free(&real);
+    pixmap_free(&argb);
+    pixmap_free(&gray);
+}
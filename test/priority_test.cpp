@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "priority.h"
+}
+
+#include <gtest/gtest.h>
+
+#include <sched.h>
+#include <sys/resource.h>
+
+#include <thread>
+
+class Priority : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        unsetenv("XDG_CONFIG_HOME");
+        unsetenv("XDG_CONFIG_DIRS");
+        unsetenv("HOME");
+        config = config_load();
+        ASSERT_TRUE(config);
+    }
+
+    void TearDown() override { config_free(config); }
+
+    struct config* config;
+};
+
+TEST_F(Priority, Low)
+{
+    const int base = getpriority(PRIO_PROCESS, 0);
+    int nice = base;
+
+    priority_init(config);
+    std::thread([&nice]() {
+        priority_background();
+        nice = getpriority(PRIO_PROCESS, 0);
+    }).join();
+
+    EXPECT_GT(nice, base);
+    EXPECT_EQ(getpriority(PRIO_PROCESS, 0), base); // main thread is not changed
+}
+
+TEST_F(Priority, Idle)
+{
+    int policy = -1;
+    cpu_set_t cpus;
+
+    ASSERT_TRUE(config_set(config, CFG_GENERAL, CFG_GNRL_BKG_PRIO, "idle"));
+    ASSERT_TRUE(config_set(config, CFG_GENERAL, CFG_GNRL_BKG_CPUS, "0"));
+    priority_init(config);
+    std::thread([&policy, &cpus]() {
+        priority_background();
+        policy = sched_getscheduler(0);
+        sched_getaffinity(0, sizeof(cpus), &cpus);
+    }).join();
+
+    EXPECT_EQ(policy, SCHED_IDLE);
+    EXPECT_EQ(CPU_COUNT(&cpus), 1);
+    EXPECT_TRUE(CPU_ISSET(0, &cpus));
+}
+
+TEST_F(Priority, InvalidCpus)
+{
+    cpu_set_t before, after;
+
+    ASSERT_TRUE(config_set(config, CFG_GENERAL, CFG_GNRL_BKG_PRIO, "normal"));
+    ASSERT_TRUE(config_set(config, CFG_GENERAL, CFG_GNRL_BKG_CPUS, "3-1"));
+    priority_init(config);
+    sched_getaffinity(0, sizeof(before), &before);
+    std::thread([&after]() {
+        priority_background();
+        sched_getaffinity(0, sizeof(after), &after);
+    }).join();
+
+    EXPECT_TRUE(CPU_EQUAL(&before, &after));
+}
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "pxalloc.h"
+}
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+class PxAlloc : public ::testing::Test {
+protected:
+    void SetUp() override { pxalloc_trim(); }
+    void TearDown() override { pxalloc_trim(); }
+
+    static bool IsZero(const void* ptr, size_t size)
+    {
+        const uint8_t* data = static_cast<const uint8_t*>(ptr);
+        for (size_t i = 0; i < size; ++i) {
+            if (data[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+TEST_F(PxAlloc, Reuse)
+{
+    const size_t size = 200 * 200 * 4;
+    struct pxalloc_stats stats;
+    void* ptr;
+    void* reused;
+
+    ptr = pxalloc(size, true);
+    ASSERT_TRUE(ptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % 16, 0U);
+    EXPECT_TRUE(IsZero(ptr, size));
+    memset(ptr, 0xaa, size);
+    pxfree(ptr);
+
+    pxalloc_stats(&stats);
+    EXPECT_EQ(stats.pooled, 1U);
+    EXPECT_GE(stats.resident, size);
+
+    reused = pxalloc(size, true);
+    EXPECT_EQ(reused, ptr);
+    EXPECT_TRUE(IsZero(reused, size));
+
+    pxalloc_stats(&stats);
+    EXPECT_EQ(stats.pooled, 0U);
+    EXPECT_EQ(stats.resident, 0U);
+    EXPECT_GE(stats.hits, 1U);
+
+    // other size is not taken from the pool
+    pxfree(reused);
+    ptr = pxalloc(size + 4, false);
+    EXPECT_NE(ptr, reused);
+    pxfree(ptr);
+
+    pxalloc_stats(&stats);
+    EXPECT_EQ(stats.pooled, 2U);
+}
+
+TEST_F(PxAlloc, Large)
+{
+    const size_t size = 8000 * 6000 * 4; // doesn't fit the pool budget
+    struct pxalloc_stats stats;
+    uint8_t* ptr;
+
+    ptr = static_cast<uint8_t*>(pxalloc(size, true));
+    ASSERT_TRUE(ptr);
+    EXPECT_EQ(ptr[0], 0);
+    EXPECT_EQ(ptr[size - 1], 0);
+    memset(ptr, 0x55, size);
+    pxfree(ptr);
+
+    pxalloc_stats(&stats);
+    EXPECT_EQ(stats.resident, 0U);
+
+    ptr = static_cast<uint8_t*>(pxalloc(size, true));
+    ASSERT_TRUE(ptr);
+    EXPECT_EQ(ptr[0], 0);
+    EXPECT_EQ(ptr[size / 2], 0);
+    EXPECT_EQ(ptr[size - 1], 0);
+    pxfree(ptr);
+}
+
+TEST_F(PxAlloc, Trim)
+{
+    struct pxalloc_stats stats;
+
+    for (size_t i = 1; i <= 32; ++i) {
+        pxfree(pxalloc(i * 1024, false));
+    }
+    pxalloc_stats(&stats);
+    EXPECT_EQ(stats.pooled, 16U);
+
+    pxalloc_trim();
+    pxalloc_stats(&stats);
+    EXPECT_EQ(stats.pooled, 0U);
+    EXPECT_EQ(stats.resident, 0U);
+}
@@ -5,9 +5,14 @@ extern "C" {
 #include "array.h"
 }
 
+#include "tempdir.h"
+
 #include <gtest/gtest.h>
 
+#include <sys/stat.h>
+
 #include <fstream>
+#include <vector>
 
 TEST(String, Duplicate)
 {
@@ -90,3 +95,51 @@ TEST(String, SearchIndex)
     ASSERT_EQ(str_index(array, "param22", 0), -1);
     ASSERT_EQ(str_index(array, "param22", 6), 1);
 }
+
+TEST(String, ReadAll)
+{
+    std::vector<uint8_t> src(300 * 1024);
+    for (size_t i = 0; i < src.size(); ++i) {
+        src[i] = static_cast<uint8_t>(i * 7);
+    }
+    FILE* tmp = tmpfile();
+    ASSERT_NE(tmp, nullptr);
+    ASSERT_EQ(fwrite(src.data(), 1, src.size(), tmp), src.size());
+    fflush(tmp);
+    rewind(tmp);
+
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    EXPECT_EQ(fd_read_all(fileno(tmp), &data, &size), 0);
+    ASSERT_NE(data, nullptr);
+    ASSERT_EQ(size, src.size());
+    EXPECT_EQ(memcmp(data, src.data(), size), 0);
+    EXPECT_EQ(data[size], 0);
+
+    free(data);
+    fclose(tmp);
+}
+
+TEST(String, Fnv1a)
+{
+    EXPECT_EQ(fnv1a(FNV1A_INIT, "", 0), FNV1A_INIT);
+    EXPECT_EQ(fnv1a(FNV1A_INIT, "a", 1), 0xaf63dc4c8601ec8cULL);
+    EXPECT_EQ(fnv1a(fnv1a(FNV1A_INIT, "ab", 2), "cd", 2),
+              fnv1a(FNV1A_INIT, "abcd", 4));
+}
+
+class MakeDirs : public TempDir {};
+
+TEST_F(MakeDirs, Create)
+{
+    const std::string path = dir + "/a/b/c";
+    struct stat st;
+    EXPECT_TRUE(make_dirs(path.c_str()));
+    ASSERT_EQ(stat(path.c_str(), &st), 0);
+    EXPECT_TRUE(S_ISDIR(st.st_mode));
+    EXPECT_TRUE(make_dirs(path.c_str()));
+
+    const std::string file = dir + "/file";
+    std::ofstream(file).put('x');
+    EXPECT_FALSE(make_dirs((file + "/dir").c_str()));
+}
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: MIT
+// Test fixture with temporary directory.
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <stdlib.h>
+#include <string>
+
+/** Fixture base: temporary directory is removed even if the test failed. */
+class TempDir : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        char tmpl[] = "/tmp/swayimg_test_XXXXXX";
+        ASSERT_TRUE(mkdtemp(tmpl));
+        dir = tmpl;
+    }
+
+    void TearDown() override
+    {
+        if (!dir.empty()) {
+            std::filesystem::remove_all(dir);
+        }
+    }
+
+    std::string dir; ///< Path to the temporary directory
+};
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "tpool.h"
+}
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static void mark_rows(void* data, size_t low, size_t high)
+{
+    std::vector<std::atomic<int>>* rows =
+        static_cast<std::vector<std::atomic<int>>*>(data);
+    for (size_t i = low; i < high; ++i) {
+        ++(*rows)[i];
+    }
+}
+
+static void check_rows(size_t num, size_t min_rows)
+{
+    std::vector<std::atomic<int>> rows(num);
+    tpool_run(mark_rows, &rows, num, min_rows);
+    for (size_t i = 0; i < num; ++i) {
+        ASSERT_EQ(rows[i], 1) << "row " << i;
+    }
+}
+
+TEST(ThreadPool, Inline)
+{
+    EXPECT_EQ(tpool_threads(), static_cast<size_t>(1));
+    check_rows(0, 0);
+    check_rows(123, 0);
+}
+
+TEST(ThreadPool, Parallel)
+{
+    ASSERT_TRUE(tpool_init(3));
+    EXPECT_EQ(tpool_threads(), static_cast<size_t>(4));
+    check_rows(1, 0);
+    check_rows(3, 0);
+    check_rows(1001, 0);
+    check_rows(1001, 100);
+    check_rows(1001, 2000);
+    tpool_destroy();
+    EXPECT_EQ(tpool_threads(), static_cast<size_t>(1));
+}
+
+TEST(ThreadPool, Concurrent)
+{
+    ASSERT_TRUE(tpool_init(2));
+    std::vector<std::thread> callers;
+    for (size_t i = 0; i < 4; ++i) {
+        callers.emplace_back([] {
+            for (size_t j = 0; j < 50; ++j) {
+                check_rows(97 + j, 1);
+            }
+        });
+    }
+    for (auto& it : callers) {
+        it.join();
+    }
+    tpool_destroy();
+}
+
+static void count_calls(void* data, size_t low, size_t high)
+{
+    std::atomic<size_t>* calls = static_cast<std::atomic<size_t>*>(data);
+    EXPECT_EQ(low, static_cast<size_t>(0));
+    EXPECT_EQ(high, static_cast<size_t>(1000));
+    ++(*calls);
+}
+
+TEST(ThreadPool, Serial)
+{
+    std::atomic<size_t> calls(0);
+
+    ASSERT_TRUE(tpool_init(3));
+    std::thread worker([&calls] {
+        tpool_set_serial(true);
+        tpool_run(count_calls, &calls, 1000, 0);
+        tpool_set_serial(false);
+        check_rows(1000, 0);
+    });
+    worker.join();
+    tpool_destroy();
+
+    EXPECT_EQ(calls, static_cast<size_t>(1));
+}
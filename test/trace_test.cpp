@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "perf.h"
+#include "trace.h"
+}
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <unistd.h>
+
+class Trace : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        char path[] = "/tmp/swayimg_trace_XXXXXX";
+        const int fd = mkstemp(path);
+        ASSERT_NE(fd, -1);
+        close(fd);
+        file = path;
+        setenv(TRACE_ENV, path, 1);
+        trace_init();
+    }
+
+    void TearDown() override
+    {
+        trace_destroy();
+        unsetenv(TRACE_ENV);
+        unlink(file.c_str());
+    }
+
+    std::string Read() const
+    {
+        std::ifstream stream(file);
+        return std::string((std::istreambuf_iterator<char>(stream)),
+                           std::istreambuf_iterator<char>());
+    }
+
+    std::string file;
+};
+
+TEST_F(Trace, Dump)
+{
+    std::string json;
+
+    ASSERT_TRUE(trace_enabled());
+
+    trace_span("decode", "PNG", perf_now() - 1000);
+    std::thread([] { trace_span("scale", "bi\"linear", perf_now()); }).join();
+
+    ASSERT_TRUE(trace_dump());
+    json = Read();
+    EXPECT_NE(json.find("\"traceEvents\""), std::string::npos);
+    EXPECT_NE(json.find("\"name\":\"decode\",\"ph\":\"X\""), std::string::npos);
+    EXPECT_NE(json.find("\"tid\":1"), std::string::npos);
+    EXPECT_NE(json.find("\"tid\":2"), std::string::npos);
+    EXPECT_NE(json.find("\"args\":{\"arg\":\"PNG\"}"), std::string::npos);
+    EXPECT_NE(json.find("\"arg\":\"bi\\\"linear\""), std::string::npos);
+    EXPECT_EQ(json.substr(json.size() - 4), "\n]}\n");
+
+    // spans are kept after dump
+    trace_span("render", nullptr, perf_now());
+    ASSERT_TRUE(trace_dump());
+    json = Read();
+    EXPECT_NE(json.find("\"name\":\"decode\""), std::string::npos);
+    EXPECT_NE(json.find("\"name\":\"render\""), std::string::npos);
+}
+
+TEST_F(Trace, Disabled)
+{
+    trace_destroy();
+    EXPECT_FALSE(trace_enabled());
+    EXPECT_FALSE(trace_dump());
+    trace_span("decode", nullptr, perf_now()); // must not crash
+
+    unsetenv(TRACE_ENV);
+    trace_init();
+    EXPECT_FALSE(trace_enabled());
+}
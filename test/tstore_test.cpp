@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "tstore.h"
+}
+
+#include "tempdir.h"
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+class TStore : public TempDir {
+protected:
+    void SetUp() override
+    {
+        ASSERT_NO_FATAL_FAILURE(TempDir::SetUp());
+        setenv("XDG_CACHE_HOME", dir.c_str(), 1);
+        ASSERT_TRUE(tstore_init(0));
+    }
+
+    void TearDown() override
+    {
+        tstore_destroy();
+        image_free(image);
+        image_free(cached);
+        unsetenv("XDG_CACHE_HOME");
+        TempDir::TearDown();
+    }
+
+    std::string Source(const char* name)
+    {
+        const std::string path = dir + "/" + name;
+        const std::string cmd = "touch " + path;
+        EXPECT_EQ(system(cmd.c_str()), 0);
+        return path;
+    }
+
+    void Create(const char* source, argb_t color)
+    {
+        struct pixmap* pm;
+        image_free(image);
+        image = image_alloc();
+        image_set_source(image, source);
+        image_set_format(image, "Test");
+        image_add_meta(image, "Key", "Value");
+        pm = image_allocate_frame(image, 16, 8);
+        for (size_t i = 0; i < 16 * 8; ++i) {
+            pm->data[i] = color + i;
+        }
+        image->alpha = true;
+        image->full_width = 160;
+        image->full_height = 80;
+    }
+
+    bool Save(uint32_t params = 1)
+    {
+        struct stat st;
+        char* meta;
+        size_t size;
+        bool rc;
+        if (!image_pack_meta(image, &meta, &size)) {
+            return false;
+        }
+        rc = stat(image->source, &st) == 0 &&
+            tstore_save(image, meta, size, &st, params);
+        free(meta);
+        return rc;
+    }
+
+    bool Load(const char* source, uint32_t params = 1)
+    {
+        struct stat st;
+        image_free(cached);
+        cached = image_alloc();
+        return stat(source, &st) == 0 &&
+            tstore_load(cached, source, &st, params);
+    }
+
+    size_t DataSize()
+    {
+        struct stat st;
+        const std::string path = dir + "/swayimg/thumbs/data";
+        return stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+    }
+
+    struct image* image = nullptr;
+    struct image* cached = nullptr;
+};
+
+TEST_F(TStore, SaveLoad)
+{
+    const std::string source = Source("image");
+
+    Create(source.c_str(), ARGB(0xff, 1, 2, 3));
+    ASSERT_FALSE(Load(source.c_str()));
+    ASSERT_TRUE(Save());
+
+    struct stat st;
+    ASSERT_EQ(stat(source.c_str(), &st), 0);
+    EXPECT_TRUE(tstore_check(source.c_str(), &st, 1));
+    EXPECT_FALSE(tstore_check(source.c_str(), &st, 2));
+
+    ASSERT_TRUE(Load(source.c_str()));
+    ASSERT_EQ(cached->num_frames, 1U);
+    ASSERT_EQ(cached->frames[0].pm.width, 16U);
+    ASSERT_EQ(cached->frames[0].pm.height, 8U);
+    EXPECT_EQ(memcmp(cached->frames[0].pm.data, image->frames[0].pm.data,
+                     16 * 8 * sizeof(argb_t)),
+              0);
+    EXPECT_STREQ(cached->format, "Test");
+    ASSERT_TRUE(cached->info);
+    EXPECT_STREQ(cached->info->key, "Key");
+    EXPECT_STREQ(cached->info->value, "Value");
+    EXPECT_TRUE(cached->alpha);
+    EXPECT_TRUE(cached->thumbnail);
+    EXPECT_EQ(cached->full_width, 160U);
+    EXPECT_EQ(cached->full_height, 80U);
+
+    // other thumbnail parameters
+    EXPECT_FALSE(Load(source.c_str(), 2));
+
+    // reopen the store
+    tstore_destroy();
+    ASSERT_TRUE(tstore_init(0));
+    EXPECT_TRUE(Load(source.c_str()));
+
+    // source file was changed
+    const std::string cmd = "echo 1 > " + source;
+    ASSERT_EQ(system(cmd.c_str()), 0);
+    EXPECT_FALSE(Load(source.c_str()));
+}
+
+TEST_F(TStore, Compact)
+{
+    const std::string source = Source("image");
+    const std::string removed = Source("removed");
+    size_t size;
+
+    Create(removed.c_str(), ARGB(0xff, 4, 5, 6));
+    ASSERT_TRUE(Save());
+    for (argb_t i = 0; i < 4; ++i) {
+        Create(source.c_str(), ARGB(0xff, i, i, i));
+        ASSERT_TRUE(Save());
+    }
+    ASSERT_TRUE(Load(removed.c_str()));
+    ASSERT_EQ(unlink(removed.c_str()), 0);
+
+    size = DataSize();
+    tstore_compact(false);
+    EXPECT_LT(DataSize(), size);
+
+    // the latest thumbnail is still available, the mapped one stays valid
+    struct image* mapped = cached;
+    cached = nullptr;
+    EXPECT_EQ(mapped->frames[0].pm.data[0], ARGB(0xff, 4, 5, 6));
+    image_free(mapped);
+    ASSERT_TRUE(Load(source.c_str()));
+    EXPECT_EQ(cached->frames[0].pm.data[1], ARGB(0xff, 3, 3, 3) + 1);
+
+    // nothing to compact
+    size = DataSize();
+    tstore_compact(false);
+    EXPECT_EQ(DataSize(), size);
+}
+
+TEST_F(TStore, Gray)
+{
+    const std::string source = Source("image");
+    struct pixmap* pm;
+
+    Create(source.c_str(), ARGB(0xff, 0, 0, 0));
+    pm = &image->frames[0].pm;
+    for (size_t i = 0; i < 16 * 8; ++i) {
+        pm->data[i] = ARGB(0xff, i, i, i);
+    }
+    ASSERT_TRUE(pixmap_compact(pm));
+    ASSERT_TRUE(Save());
+
+    ASSERT_TRUE(Load(source.c_str()));
+    pm = &cached->frames[0].pm;
+    EXPECT_EQ(pm->format, pixfmt_gray8);
+    for (size_t i = 0; i < 16 * 8; ++i) {
+        ASSERT_EQ(reinterpret_cast<const uint8_t*>(pm->data)[i], i);
+    }
+}
+
+TEST_F(TStore, Limit)
+{
+    std::string sources[10];
+
+    // each record takes a page, 6 of 8 pages are kept on eviction
+    tstore_destroy();
+    ASSERT_TRUE(tstore_init(8 * sysconf(_SC_PAGESIZE)));
+    for (size_t i = 0; i < 10; ++i) {
+        sources[i] = Source(std::to_string(i).c_str());
+        Create(sources[i].c_str(), ARGB(0xff, i, i, i));
+        ASSERT_TRUE(Save());
+    }
+    tstore_compact(false);
+    EXPECT_LE(DataSize(), static_cast<size_t>(8 * sysconf(_SC_PAGESIZE)));
+
+    EXPECT_FALSE(Load(sources[0].c_str()));
+    EXPECT_FALSE(Load(sources[3].c_str()));
+    for (size_t i = 4; i < 10; ++i) {
+        ASSERT_TRUE(Load(sources[i].c_str())) << i;
+        EXPECT_EQ(cached->frames[0].pm.data[0], ARGB(0xff, i, i, i));
+    }
+}
+
+TEST_F(TStore, Reset)
+{
+    const std::string source = Source("image");
+    const std::string path = dir + "/swayimg/thumbs/data";
+
+    Create(source.c_str(), ARGB(0xff, 1, 2, 3));
+    ASSERT_TRUE(Save());
+    ASSERT_TRUE(Load(source.c_str()));
+
+    // invalid store is replaced, the mapped thumbnail stays valid
+    FILE* fd = fopen(path.c_str(), "r+");
+    ASSERT_TRUE(fd);
+    fputs("bad!", fd);
+    fclose(fd);
+    tstore_destroy();
+    ASSERT_TRUE(tstore_init(0));
+    EXPECT_LT(DataSize(), static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+    EXPECT_EQ(cached->frames[0].pm.data[0], ARGB(0xff, 1, 2, 3));
+    EXPECT_FALSE(Load(source.c_str()));
+}
@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2025 Artem Senichev <artemsen@gmail.com>
+
+extern "C" {
+#include "zcache.h"
+}
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+class ZCache : public ::testing::Test {
+protected:
+    void TearDown() override { zcache_destroy(); }
+
+    struct image* Create(size_t index, size_t width, size_t height)
+    {
+        struct image* image = image_alloc();
+        struct pixmap* pm = image_allocate_frame(image, width, height);
+        image->index = index;
+        // mix of flat areas, gradients, noise and transparency
+        for (size_t y = 0; y < height; ++y) {
+            for (size_t x = 0; x < width; ++x) {
+                argb_t color;
+                if (y < height / 4) {
+                    color = ARGB(0xff, 0x10, 0x20, 0x30);
+                } else if (y < height / 2) {
+                    color = ARGB(0xff, x, y, x + y);
+                } else if (y < height * 3 / 4) {
+                    color = ARGB(0xff, rand(), rand(), rand());
+                } else {
+                    color = ARGB(x, rand(), y, 0);
+                }
+                pm->data[y * width + x] = color;
+            }
+        }
+        return image;
+    }
+
+    void WaitCompressed()
+    {
+        for (size_t i = 0; i < 500 && zcache_size() == 0; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        ASSERT_NE(zcache_size(), 0U);
+    }
+};
+
+TEST_F(ZCache, Disabled)
+{
+    struct image* image = Create(1, 4, 4);
+
+    zcache_init(0);
+    EXPECT_FALSE(zcache_put(image));
+    EXPECT_FALSE(zcache_has(1));
+    EXPECT_EQ(zcache_take(1), nullptr);
+
+    image_free(image);
+}
+
+TEST_F(ZCache, Restore)
+{
+    const size_t width = 123;
+    const size_t height = 321;
+    struct image* image = Create(42, width, height);
+    const struct pixmap* pm = &image->frames[0].pm;
+    const std::vector<argb_t> origin(pm->data, pm->data + width * height);
+
+    zcache_init(1024 * 1024);
+    ASSERT_TRUE(zcache_put(image));
+    EXPECT_TRUE(zcache_has(42));
+    WaitCompressed();
+    EXPECT_LT(zcache_size(), width * height * sizeof(argb_t));
+
+    EXPECT_EQ(zcache_take(1), nullptr);
+    image = zcache_take(42);
+    ASSERT_NE(image, nullptr);
+    EXPECT_FALSE(zcache_has(42));
+    EXPECT_EQ(zcache_size(), 0U);
+
+    ASSERT_EQ(image->num_frames, 1U);
+    pm = &image->frames[0].pm;
+    ASSERT_EQ(pm->width, width);
+    ASSERT_EQ(pm->height, height);
+    for (size_t i = 0; i < width * height; ++i) {
+        ASSERT_EQ(pm->data[i], origin[i]) << "pixel " << i;
+    }
+
+    image_free(image);
+}
+
+TEST_F(ZCache, Limit)
+{
+    zcache_init(1);
+    ASSERT_TRUE(zcache_put(Create(1, 64, 64)));
+    for (size_t i = 0; i < 500 && zcache_has(1); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_FALSE(zcache_has(1));
+    EXPECT_EQ(zcache_size(), 0U);
+}
+
+TEST_F(ZCache, Reset)
+{
+    zcache_init(1024 * 1024);
+    ASSERT_TRUE(zcache_put(Create(1, 64, 64)));
+    ASSERT_TRUE(zcache_put(Create(2, 64, 64)));
+    zcache_reset();
+    EXPECT_FALSE(zcache_has(1));
+    EXPECT_FALSE(zcache_has(2));
+}
+
+TEST_F(ZCache, Shrink)
+{
+    size_t size;
+
+    zcache_init(1024 * 1024);
+    ASSERT_TRUE(zcache_put(Create(1, 64, 64)));
+    WaitCompressed();
+    size = zcache_size();
+    ASSERT_TRUE(zcache_put(Create(2, 64, 64)));
+    for (size_t i = 0; i < 500 && zcache_size() == size; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_NE(zcache_size(), size);
+
+    // the oldest image is freed first
+    zcache_shrink(1);
+    EXPECT_FALSE(zcache_has(1));
+    EXPECT_TRUE(zcache_has(2));
+}